@@ -13,8 +13,10 @@
 #include <QPainter>
 #include <QPainterPath>
 #include <QPolygonF>
+#include <QScrollBar>
 #include <QTimer>
 #include <QToolTip>
+#include <QWheelEvent>
 
 #include <algorithm>
 
@@ -28,11 +30,11 @@ constexpr int kPreviewBtnSize = 22;
 constexpr int kPreviewLeadMs = 6000;   // audition starts this long before the segue
 constexpr int kPreviewTailMs = 4000;   // and keeps playing this long into the next track
 constexpr double kPreviewVolume = 0.85;
+// Ctrl+wheel zoom of the transition strips: at the top a default 25 s
+// window spans well under a second, a few pixels per 5 ms bucket
+constexpr double kMaxStripZoom = 64.0;
 
-// Auto-mix silence scanning: a moment counts as "loud" only as part of a
-// run of kSustainPeaks consecutive peaks at/above the threshold, so a
-// click in an otherwise faded tail doesn't count as the song still going.
-constexpr int kSustainPeaks = 3; // 3 × 20 ms
+// Auto-mix silence scanning (WaveformData::quietHeadMs/TailMs).
 // Tracks whose loudest peak sits below this (≈ -30 dBFS) are all quiet.
 constexpr int kMinLoudPeak = 8;
 
@@ -127,33 +129,31 @@ void applySegmentDelta(QVector<QPointF> &points, int first, int last,
         points[i].setY(startGains[i - first] + delta);
 }
 
+// One vertical line per pixel column, from the column's lowest to its
+// highest sample; the pyramid level read matches the column width, so the
+// cost follows the rect's width, not the span of audio it covers.
 void paintWaveform(QPainter *painter, const QRect &rect, const WaveformData &data,
                    qint64 fromMs, qint64 toMs, const QColor &color)
 {
     if (!data.ready() || rect.width() <= 0 || toMs <= fromMs)
         return;
 
-    const double msPerPx = double(toMs - fromMs) / rect.width();
     const double midY = rect.center().y() + 0.5;
     const double halfH = rect.height() / 2.0 - 1.0;
+    QVector<qint8> columns(rect.width() * 2);
+    data.reduceColumns(fromMs, toMs, rect.width(), columns.data());
 
     QVector<QLineF> lines;
     lines.reserve(rect.width());
     for (int x = 0; x < rect.width(); ++x) {
-        const qint64 msStart = fromMs + qint64(x * msPerPx);
-        const qint64 msEnd = fromMs + qint64((x + 1) * msPerPx);
-        int i0 = int(msStart / WaveformStore::MsPerPeak);
-        int i1 = int(msEnd / WaveformStore::MsPerPeak);
-        i1 = qMax(i1, i0 + 1);
-        if (i0 < 0 || i0 >= data.peaks.size())
-            continue;
-        i1 = qMin(i1, int(data.peaks.size()));
-        int peak = 0;
-        for (int i = i0; i < i1; ++i)
-            peak = qMax(peak, int(data.peaks[i]));
-        const double amp = qMax(0.6, halfH * peak / 255.0);
+        const int lo = columns[x * 2];
+        const int hi = columns[x * 2 + 1];
+        if (lo > hi)
+            continue; // past the end of the audio
+        const double top = qMin(midY - 0.6, midY - halfH * hi / 128.0);
+        const double bottom = qMax(midY + 0.6, midY - halfH * lo / 128.0);
         const double px = rect.left() + x + 0.5;
-        lines.append(QLineF(px, midY - amp, px, midY + amp));
+        lines.append(QLineF(px, top, px, bottom));
     }
     painter->setPen(QPen(color, 1.0));
     painter->drawLines(lines);
@@ -270,35 +270,13 @@ double PlaylistWaveView::envelopeGainAt(const QVector<QPointF> &points, qint64 p
 qint64 PlaylistWaveView::quietHeadMs(const WaveformData &data, int thresholdPercent)
 {
     const int threshold = autoMixThreshold(data, thresholdPercent);
-    if (threshold < 0)
-        return data.durationMs;
-    int run = 0;
-    for (int i = 0; i < data.peaks.size(); ++i) {
-        run = data.peaks[i] >= threshold ? run + 1 : 0;
-        if (run >= kSustainPeaks)
-            return qint64(i - kSustainPeaks + 1) * WaveformStore::MsPerPeak;
-    }
-    return data.durationMs;
+    return threshold < 0 ? data.durationMs : data.quietHeadMs(threshold);
 }
 
 qint64 PlaylistWaveView::quietTailMs(const WaveformData &data, int thresholdPercent)
 {
     const int threshold = autoMixThreshold(data, thresholdPercent);
-    if (threshold < 0)
-        return data.durationMs;
-    int run = 0;
-    for (int i = data.peaks.size() - 1; i >= 0; --i) {
-        run = data.peaks[i] >= threshold ? run + 1 : 0;
-        if (run >= kSustainPeaks) {
-            // Scanning backwards, so this is the last sustained-loud run in
-            // the track and it ends just before peak index i + kSustainPeaks.
-            // Any rounding remainder past the peak buffer is quiet too.
-            const qint64 loudEndMs =
-                qint64(i + kSustainPeaks) * WaveformStore::MsPerPeak;
-            return qMax(qint64(0), data.durationMs - loudEndMs);
-        }
-    }
-    return data.durationMs;
+    return threshold < 0 ? data.durationMs : data.quietTailMs(threshold);
 }
 
 PlaylistWaveView::PlaylistWaveView(QListWidget *list, WaveformStore *store, QObject *parent)
@@ -319,18 +297,31 @@ PlaylistWaveView::PlaylistWaveView(QListWidget *list, WaveformStore *store, QObj
     });
 
     // New rows appear all the time (auto mode, drag & drop, context menus):
-    // give them the tall size hint and fetch their waveforms.
+    // give them the tall size hint and queue their waveforms.
     connect(m_list->model(), &QAbstractItemModel::rowsInserted, this,
             [this](const QModelIndex &, int first, int last) {
         if (!m_active)
             return;
         applyRowSizeHints(first, last);
+        prefetchRows(first, last);
         requestVisibleWaveforms();
     });
+    // Rows scrolled into view go to the front of the extraction queue. Only
+    // those: the rest of the playlist was queued when it was inserted.
+    connect(m_list->verticalScrollBar(), &QScrollBar::valueChanged, this, [this]() {
+        if (m_active)
+            requestVisibleWaveforms();
+    });
     const auto cancelPreviewOnChange = [this]() { stopPreview(); };
     connect(m_list->model(), &QAbstractItemModel::rowsRemoved, this, cancelPreviewOnChange);
     connect(m_list->model(), &QAbstractItemModel::rowsMoved, this, cancelPreviewOnChange);
-    connect(m_list->model(), &QAbstractItemModel::modelReset, this, cancelPreviewOnChange);
+    connect(m_list->model(), &QAbstractItemModel::modelReset, this, [this]() {
+        stopPreview();
+        if (!m_active)
+            return;
+        prefetchRows(0, m_list->count() - 1);
+        requestVisibleWaveforms();
+    });
 
     // Transition audition players. Kept FX-free (passthrough) — this is a
     // local cue/preview, not the on-air chain.
@@ -355,6 +346,7 @@ void PlaylistWaveView::setActive(bool active)
     if (active) {
         m_hadMouseTracking = m_list->viewport()->hasMouseTracking();
         m_list->viewport()->setMouseTracking(true);
+        prefetchRows(0, m_list->count() - 1);
         requestVisibleWaveforms();
     } else {
         stopPreview();
@@ -401,13 +393,32 @@ void PlaylistWaveView::applyRowSizeHints(int first, int last) const
 
 void PlaylistWaveView::requestVisibleWaveforms()
 {
-    for (int row = 0; row < m_list->count(); ++row)
-        m_store->fetch(m_list->item(row)->text());
+    // The track on air and the rows on screen jump the extraction queue
     if (m_nowPlaying) {
         const QString playing = m_nowPlaying();
         if (!playing.isEmpty())
-            m_store->fetch(playing);
+            m_store->fetch(playing, WaveformStore::Priority::Visible);
     }
+    const int count = m_list->count();
+    int first = m_list->indexAt(QPoint(0, 0)).row();
+    int last = m_list->indexAt(QPoint(0, m_list->viewport()->height() - 1)).row();
+    if (first < 0)
+        first = 0;
+    if (last < 0)
+        last = count - 1;
+    for (int row = first; row <= last && row < count; ++row)
+        m_store->fetch(m_list->item(row)->text(), WaveformStore::Priority::Visible);
+}
+
+void PlaylistWaveView::prefetchRows(int first, int last)
+{
+    // Rows off screen follow in the background. prefetch() looks every path
+    // up on disk, so this runs per inserted range, never per scroll step.
+    QStringList paths;
+    for (int row = qMax(first, 0); row <= last && row < m_list->count(); ++row)
+        paths.append(m_list->item(row)->text());
+    if (!paths.isEmpty())
+        m_store->prefetch(paths);
 }
 
 QString PlaylistWaveView::previousTrackPath(int row) const
@@ -438,7 +449,8 @@ PlaylistWaveView::StripGeometry PlaylistWaveView::stripGeometry(const QRect &ite
     g.wave = g.strip.adjusted(kPreviewBtnSize + 8, 1, -1, -1);
     g.prevEndX = g.wave.left() + int(g.wave.width() * 0.45);
     // Lower bound keeps the scale finite when the playlist is very narrow
-    g.pxPerMs = qMax(1e-4, double(g.prevEndX - g.wave.left()) / double(maxOverlapMs()));
+    g.pxPerMs = qMax(1e-4, double(g.prevEndX - g.wave.left()) / double(maxOverlapMs()))
+                * m_stripZoom;
     return g;
 }
 
@@ -1079,6 +1091,28 @@ bool PlaylistWaveView::eventFilter(QObject *watched, QEvent *event)
         }
         return false;
     }
+    case QEvent::Wheel: {
+        // Ctrl+wheel over a transition strip zooms its time axis (every row
+        // shares it) for fine overlap placement
+        auto *we = static_cast<QWheelEvent *>(event);
+        if (!(we->modifiers() & Qt::ControlModifier) || we->angleDelta().y() == 0)
+            return false;
+        const QPoint pos = we->position().toPoint();
+        QListWidgetItem *item = m_list->itemAt(pos);
+        if (!item || !stripGeometry(m_list->visualItemRect(item)).strip.contains(pos))
+            return false;
+        const double zoom = qBound(1.0, m_stripZoom * (we->angleDelta().y() > 0 ? 2.0 : 0.5),
+                                   kMaxStripZoom);
+        if (zoom != m_stripZoom) {
+            m_stripZoom = zoom;
+            m_list->viewport()->update();
+        }
+        QToolTip::showText(we->globalPosition().toPoint(),
+                           tr("Transition window: %1 s")
+                               .arg(maxOverlapMs() / 1000.0 / m_stripZoom, 0, 'f', 2),
+                           m_list->viewport());
+        return true;
+    }
     case QEvent::Leave:
         m_list->viewport()->unsetCursor();
         return false;
@@ -1217,7 +1251,7 @@ void NowPlayingWaveStrip::setTrack(const QString &filePath)
     m_segLast = -1;
     m_segStartGains.clear();
     if (!m_path.isEmpty())
-        m_store->fetch(m_path);
+        m_store->fetch(m_path, WaveformStore::Priority::Visible);
     update();
 }
 
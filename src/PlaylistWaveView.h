@@ -29,6 +29,7 @@ struct WaveformData;
  *    and the head of this track on a shared time axis. Dragging this
  *    track's wave horizontally sets how many seconds before the end of
  *    the previous track it should start (the crossfade overlap).
+ *    Ctrl+wheel over a strip zooms its time axis in for precise placement.
  *
  * The overlap is stored on each playlist item under OverlapRole, saved
  * into playlist XML files, and honoured by the segue playback in
@@ -118,6 +119,7 @@ private:
     QString previousTrackPath(int row) const;
     void applyRowSizeHints(int first, int last) const;
     void requestVisibleWaveforms();
+    void prefetchRows(int first, int last);
     qint64 clampedOverlap(int row, qint64 overlapMs) const;
     void setRowOverlap(int row, qint64 overlapMs);
 
@@ -137,6 +139,7 @@ private:
     int m_dragStartX = 0;
     qint64 m_dragStartOverlap = 0;
     int m_pressedPreviewRow = -1;
+    double m_stripZoom = 1.0; // transition strip time axis, Ctrl+wheel
 
     // Volume line editing (Sonar-style envelope over the full waveform)
     int m_envDragRow = -1;
@@ -1,6 +1,8 @@
 #include "add_full_dir.h"
 #include "ui_add_full_dir.h"
 #include "addgenre.h"
+#include "audio/FxEngine.h"
+#include "services/LibraryRescanner.h"
 #include <QDirIterator>
 #include <QFileDialog>
 #include <QDebug>
@@ -46,6 +48,21 @@ add_full_dir::add_full_dir(QWidget *parent) :
         ui->f_cbox_country->addItem(QLocale::countryToString(locale.country()));
     }
 
+    // Durations come from the same probe the player uses (libav, else
+    // ffprobe/ffmpeg), run on the importer's extractor threads
+    importer = new LibraryImporter(QSqlDatabase::database("xfb_connection"), this);
+    importer->setDurationProbe([](const QString &filePath) {
+        qint64 durationMs = 0;
+        bool is432 = false;
+        FxEngine::probeFile(filePath, &durationMs, &is432);
+        return durationMs;
+    });
+    connect(importer, &LibraryImporter::progress, this, &add_full_dir::importProgress);
+    connect(importer, &LibraryImporter::finished, this, &add_full_dir::importFinished);
+    connect(importer, &LibraryImporter::importError, this, [this](const QString &error) {
+        QMessageBox::warning(this, tr("Add directory"), error);
+    });
+
 
 
 
@@ -72,124 +89,76 @@ void add_full_dir::on_f_bt_add_clicked()
     if(dir.isEmpty())
     {
         QMessageBox::information(this,tr("Path?"),tr("Please select a folder to add."));
+        return;
+    }
+
+    LibraryImporter::Options options;
+    options.directory = dir;
+    options.artist = ui->txt_artistName->text();
+    options.genre1 = ui->f_cbox_genre1->currentText();
+    options.genre2 = ui->f_cbox_genre2->currentText();
+    options.country = "Other country / language";
+    options.publishedDate = ui->f_date->date().toString("yyyy/MM/dd");
+
+    qDebug() << "Importing directory: " << dir;
+
+    if(importer->start(options)){
+        setControlsEnabled(false);
     }
 
-    QDirIterator it(dir, QStringList() << "*.mp3" << "*.wav" << "*.ogg" << "*.flac" << "*.aac" << "*.m4a" << "*.wma" << "*.opus", QDir::Files, QDirIterator::Subdirectories);
-    while (it.hasNext()) {
-
-        QString filewpath = it.next();
-        qDebug() << "Adding track: " << filewpath;
-
-        QString nomeficheiro = QDir(dir).relativeFilePath(filewpath);
-
-        //nomeficheiro.replace("_"," ");
-
-        QString txtArtist = ui->txt_artistName->text();
-        QString artist;
-        QStringList divide_nome = nomeficheiro.split( "-" );
-        if(!txtArtist.isEmpty()){
-            artist = txtArtist;
-        } else {
-            artist = divide_nome.value(0).replace("_"," ").replace(".mp3","").replace(".mp4","").replace(".ogg","").replace(".wav","").replace(".flac","").trimmed();
-
-        }
-
-        QString song = divide_nome.value(1).replace("_"," ").replace(".mp3","").replace(".mp4","").replace(".ogg","").replace(".wav","").replace(".flac","").trimmed();
-        if(song.isEmpty()){
-            song="-";
-        }
-
-         QString g1 = ui->f_cbox_genre1->currentText();
-         QString g2 = ui->f_cbox_genre2->currentText();
-
-         QString country = "Other country / language";
-
-         QString pub_date = ui->f_date->date().toString("yyyy/MM/dd");
-
-         qDebug() << "Got! artist: "<<artist<<" and song: "<<song<<" from file: "<<nomeficheiro;
-
-
-
-      //check if it's already in db
-
-     int dbhasmusic=0;
-         QSqlDatabase db = QSqlDatabase::database("xfb_connection");
-         QSqlQuery query(db);
-     query.prepare("SELECT path FROM musics WHERE path=:path");
-     query.bindValue(":path",filewpath);
-     query.exec();
-     while (query.next()){
-         QString thispath = query.value(0).toString();
-         qDebug() << "Skipping: "<<thispath;
-         dbhasmusic=1;
-     }
-     qDebug()<<"dbhasmusic value is: "<<dbhasmusic;
-
-     if(dbhasmusic==0){
-         //add to db
-
-         QProcess cmd;
-         QString time;
-         // Argument list instead of a shell string (file names must never be
-         // shell-interpreted); the old "| grep Duration" is done in C++ below.
-         cmd.start("exiftool", QStringList() << filewpath);
-         cmd.waitForFinished();
-         QString cmdOut;
-         const QStringList exifLines = QString::fromLocal8Bit(cmd.readAll()).split('\n');
-         for (const QString &exifLine : exifLines) {
-             if (exifLine.contains("Duration")) {
-                 cmdOut = exifLine + "\n";
-                 break;
-             }
-         }
-         qDebug()<<"Output of exiftool: "<<cmdOut;
-         cmd.close();
-
-         QStringList arraycmd = cmdOut.split(" ");
-         if(arraycmd.count()>25){
-             QStringList splitarray = arraycmd[25].split("\n");
-             qDebug()<<"Total track time is: "<<splitarray[0];
-             time = splitarray[0];
-
-         } else {
-             qDebug()<<"-------------->>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>     !!!!!!!!    An exception happend !? ... outputing details of this track: ";
-             for(int i=0;i<arraycmd.count();i++){
-                 qDebug()<< "The array position "<<i<<" has: "<<arraycmd[i];
-                }
-
-            }
-         int played = 0;
-         QString last = "";
-         QSqlQuery sql(db);
-         sql.prepare("insert into musics values(NULL,:artist,:song,:g1,:g2,:country,:pub_date,:file,:time,:played,:last)");
-         sql.bindValue(":artist",artist);
-         sql.bindValue(":song",song);
-         sql.bindValue(":g1",g1);
-         sql.bindValue(":g2",g2);
-         sql.bindValue(":country",country);
-         sql.bindValue(":pub_date",pub_date);
-         sql.bindValue(":file",filewpath);
-         sql.bindValue(":time",time);
-         sql.bindValue(":played",played);
-         sql.bindValue(":last",last);
-
-         if(sql.exec())
-         {
-             qDebug() << "last sql: " << sql.lastQuery();
-         } else {
-           //  QMessageBox::critical(this,tr("Error"),sql.lastError().text());
-             qDebug() << "last sql: " << sql.lastQuery();
-         }
-
-
-     }
+}
 
+void add_full_dir::importProgress(int processed, int found, double filesPerSecond)
+{
+    ui->f_bt_add->setText(tr("%1 / %2 (%3 files/s)").arg(processed).arg(found)
+                          .arg(QString::number(filesPerSecond, 'f', 0)));
 }
 
+void add_full_dir::importFinished(const LibraryImporter::Statistics &statistics)
+{
+    setControlsEnabled(true);
+    ui->f_bt_add->setText(tr("Add"));
+
+    if(statistics.cancelled){
+        return;
+    }
+
+    // "Rescan the library" walks the folders that were imported
+    LibraryRescanner::addLibraryRoot(QSqlDatabase::database("xfb_connection"), ui->txt_path->text());
+
+    QMessageBox::information(this,tr("Add directory"),
+                             tr("All done! Have a nice day!\n\n"
+                                "Added: %1\nAlready in the library: %2\nFailed: %3\n"
+                                "%4 files in %5 s (%6 files/s)")
+                             .arg(statistics.imported)
+                             .arg(statistics.duplicates)
+                             .arg(statistics.failed)
+                             .arg(statistics.filesFound)
+                             .arg(QString::number(statistics.elapsedMs / 1000.0, 'f', 1))
+                             .arg(QString::number(statistics.filesPerSecond(), 'f', 0)));
+    this->hide();
+}
 
-   QMessageBox::information(this,tr("Add directory"),tr("All done! Have a nice day!"));
-   this->hide();
+void add_full_dir::reject()
+{
+    // Rows already committed stay in the library
+    if(importer->isRunning()){
+        importer->cancel();
+        importer->waitForFinished();
+    }
+    QDialog::reject();
+}
 
+void add_full_dir::setControlsEnabled(bool enabled)
+{
+    ui->f_bt_add->setEnabled(enabled);
+    ui->f_bt_browse->setEnabled(enabled);
+    ui->f_bt_manageGenres->setEnabled(enabled);
+    ui->txt_path->setEnabled(enabled);
+    ui->txt_artistName->setEnabled(enabled);
+    ui->f_cbox_genre1->setEnabled(enabled);
+    ui->f_cbox_genre2->setEnabled(enabled);
+    ui->f_date->setEnabled(enabled);
 }
 
 void add_full_dir::on_f_bt_manageGenres_clicked()
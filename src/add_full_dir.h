@@ -2,6 +2,7 @@
 #define ADD_FULL_DIR_H
 
 #include <QDialog>
+#include "services/LibraryImporter.h"
 
 namespace Ui {
 class add_full_dir;
@@ -15,14 +16,22 @@ public:
     explicit add_full_dir(QWidget *parent = 0);
     ~add_full_dir();
 
+public slots:
+    void reject() override;
+
 private slots:
     void on_f_bt_browse_clicked();
     void on_f_bt_add_clicked();
     void on_f_bt_manageGenres_clicked();
     void updateGenres();
+    void importProgress(int processed, int found, double filesPerSecond);
+    void importFinished(const LibraryImporter::Statistics &statistics);
 
 private:
+    void setControlsEnabled(bool enabled);
+
     Ui::add_full_dir *ui;
+    LibraryImporter *importer;
 };
 
 #endif // ADD_FULL_DIR_H
@@ -126,7 +126,7 @@ void add_program::on_pushButton_4_clicked()
         //prepare the query
 
             QSqlQuery qry_add(db);
-            qry_add.prepare("INSERT INTO scheduler VALUES (?, ?, ?, ?, ?, ?, '1', NULL, NULL, NULL, NULL, NULL, NULL, NULL, '1')");
+            qry_add.prepare("INSERT INTO scheduler (id, ano, mes, dia, hora, min, tipo, is_program) VALUES (?, ?, ?, ?, ?, ?, '1', '1')");
             qry_add.addBindValue(programs_id);
             qry_add.addBindValue(ano1);
             qry_add.addBindValue(mes1);
@@ -219,7 +219,7 @@ void add_program::on_pushButton_6_clicked()
     qDebug()<<"Array splitted hours: "<<hora<<" and minutes: "<<min;
 
     QSqlQuery Qr_add(db);
-    Qr_add.prepare("INSERT INTO scheduler VALUES (?, NULL, NULL, NULL, ?, ?, '2', ?, NULL, NULL, NULL, NULL, NULL, NULL, '1')");
+    Qr_add.prepare("INSERT INTO scheduler (id, hora, min, tipo, week_day, is_program) VALUES (?, ?, ?, '2', ?, '1')");
     Qr_add.addBindValue(thisprogramsId);
     Qr_add.addBindValue(hora);
     Qr_add.addBindValue(min);
@@ -138,7 +138,7 @@ void add_pub::on_pushButton_4_clicked()
         //prepare the query (parameterized to prevent SQL injection)
 
             QSqlQuery qry_add(db);
-            qry_add.prepare("INSERT INTO scheduler VALUES (?, ?, ?, ?, ?, ?, '1', NULL, NULL, NULL, NULL, NULL, NULL, NULL, '0')");
+            qry_add.prepare("INSERT INTO scheduler (id, ano, mes, dia, hora, min, tipo, is_program) VALUES (?, ?, ?, ?, ?, ?, '1', '0')");
             qry_add.addBindValue(pub_id);
             qry_add.addBindValue(ano1);
             qry_add.addBindValue(mes1);
@@ -254,7 +254,7 @@ QSqlQuery Q(db);
     qDebug()<<"Array splitted hours: "<<hora<<" and minutes: "<<min;
 
     QSqlQuery Qr_add(db);
-    Qr_add.prepare("INSERT INTO scheduler VALUES (?, NULL, NULL, NULL, ?, ?, '2', ?, NULL, NULL, NULL, NULL, NULL, NULL, '0')");
+    Qr_add.prepare("INSERT INTO scheduler (id, hora, min, tipo, week_day, is_program) VALUES (?, ?, ?, '2', ?, '0')");
     Qr_add.addBindValue(thisPubId);
     Qr_add.addBindValue(hora);
     Qr_add.addBindValue(min);
@@ -0,0 +1,164 @@
+#include "FrameRing.h"
+
+#include <algorithm>
+#include <cstring>
+
+template <typename Sample>
+BasicFrameRing<Sample>::BasicFrameRing(int channels)
+    : m_channels(std::max(1, channels))
+{
+}
+
+template <typename Sample>
+void BasicFrameRing<Sample>::reset(size_t capacityFrames)
+{
+    size_t cap = 1;
+    while (cap < capacityFrames)
+        cap <<= 1;
+    m_storage.assign(cap * static_cast<size_t>(m_channels), Sample());
+    m_mask = cap - 1;
+    m_write.store(0, std::memory_order_relaxed);
+    m_read.store(0, std::memory_order_relaxed);
+}
+
+template <typename Sample>
+void BasicFrameRing<Sample>::clear()
+{
+    m_read.store(m_write.load(std::memory_order_acquire), std::memory_order_release);
+}
+
+template <typename Sample>
+void BasicFrameRing<Sample>::swap(BasicFrameRing &other)
+{
+    std::swap(m_channels, other.m_channels);
+    std::swap(m_mask, other.m_mask);
+    m_storage.swap(other.m_storage);
+    const size_t w = m_write.load(std::memory_order_relaxed);
+    const size_t r = m_read.load(std::memory_order_relaxed);
+    m_write.store(other.m_write.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    m_read.store(other.m_read.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    other.m_write.store(w, std::memory_order_relaxed);
+    other.m_read.store(r, std::memory_order_relaxed);
+}
+
+template <typename Sample>
+size_t BasicFrameRing<Sample>::prepareWrite(size_t maxFrames, Region &first, Region &second)
+{
+    first = Region();
+    second = Region();
+    const size_t n = std::min(maxFrames, freeFrames());
+    if (n == 0)
+        return 0;
+
+    const size_t start = m_write.load(std::memory_order_relaxed) & m_mask;
+    const size_t toEnd = capacityFrames() - start;
+    first.data = m_storage.data() + start * static_cast<size_t>(m_channels);
+    first.frames = std::min(n, toEnd);
+    if (n > first.frames) {
+        second.data = m_storage.data();
+        second.frames = n - first.frames;
+    }
+    return n;
+}
+
+template <typename Sample>
+size_t BasicFrameRing<Sample>::write(const Sample *interleaved, size_t frames)
+{
+    Region a, b;
+    const size_t n = prepareWrite(frames, a, b);
+    const size_t ch = static_cast<size_t>(m_channels);
+    if (a.frames)
+        std::memcpy(a.data, interleaved, a.frames * ch * sizeof(Sample));
+    if (b.frames)
+        std::memcpy(b.data, interleaved + a.frames * ch, b.frames * ch * sizeof(Sample));
+    commitWrite(n);
+    return n;
+}
+
+template <typename Sample>
+size_t BasicFrameRing<Sample>::peek(size_t maxFrames, Region &first, Region &second) const
+{
+    first = Region();
+    second = Region();
+    const size_t n = std::min(maxFrames, availableFrames());
+    if (n == 0)
+        return 0;
+
+    // The consumer only ever reads published frames, so handing out
+    // non-const pointers lets callers process the audio in place.
+    Sample *base = const_cast<Sample *>(m_storage.data());
+    const size_t start = m_read.load(std::memory_order_relaxed) & m_mask;
+    const size_t toEnd = capacityFrames() - start;
+    first.data = base + start * static_cast<size_t>(m_channels);
+    first.frames = std::min(n, toEnd);
+    if (n > first.frames) {
+        second.data = base;
+        second.frames = n - first.frames;
+    }
+    return n;
+}
+
+template <typename Sample>
+size_t BasicFrameRing<Sample>::read(Sample *interleaved, size_t frames)
+{
+    Region a, b;
+    const size_t n = peek(frames, a, b);
+    const size_t ch = static_cast<size_t>(m_channels);
+    if (a.frames)
+        std::memcpy(interleaved, a.data, a.frames * ch * sizeof(Sample));
+    if (b.frames)
+        std::memcpy(interleaved + a.frames * ch, b.data, b.frames * ch * sizeof(Sample));
+    commitRead(n);
+    return n;
+}
+
+template <typename Sample>
+size_t BasicFrameRing<Sample>::discard(size_t frames)
+{
+    const size_t n = std::min(frames, availableFrames());
+    commitRead(n);
+    return n;
+}
+
+template <typename Sample>
+size_t BasicFrameRing<Sample>::copyOut(size_t offset, Sample *interleaved, size_t frames) const
+{
+    const size_t avail = availableFrames();
+    if (offset >= avail)
+        return 0;
+    const size_t n = std::min(frames, avail - offset);
+    const size_t ch = static_cast<size_t>(m_channels);
+    const size_t start = (m_read.load(std::memory_order_relaxed) + offset) & m_mask;
+    const size_t first = std::min(n, capacityFrames() - start);
+    std::memcpy(interleaved, m_storage.data() + start * ch, first * ch * sizeof(Sample));
+    if (n > first)
+        std::memcpy(interleaved + first * ch, m_storage.data(), (n - first) * ch * sizeof(Sample));
+    return n;
+}
+
+template <typename Sample>
+void BasicFrameRing<Sample>::dropNewest(size_t frames)
+{
+    const size_t n = std::min(frames, availableFrames());
+    m_write.store(m_write.load(std::memory_order_relaxed) - n, std::memory_order_release);
+}
+
+template <typename Sample>
+void BasicFrameRing<Sample>::writeOverwrite(const Sample *interleaved, size_t frames)
+{
+    const size_t cap = capacityFrames();
+    if (cap == 0 || frames == 0)
+        return;
+    if (frames > cap) {
+        // Only the newest capacity's worth can survive anyway
+        interleaved += (frames - cap) * static_cast<size_t>(m_channels);
+        frames = cap;
+    }
+    const size_t free = freeFrames();
+    if (frames > free)
+        discard(frames - free);
+    write(interleaved, frames);
+}
+
+template class BasicFrameRing<float>;
+template class BasicFrameRing<int16_t>;
@@ -0,0 +1,127 @@
+#ifndef FRAMERING_H
+#define FRAMERING_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/**
+ * Fixed-capacity single-producer / single-consumer ring of interleaved
+ * frames: float (FrameRing) on the audio path, s16 (FrameRing16) where an
+ * Int16 sink is fed already converted samples.
+ *
+ * Replaces the `std::vector` FIFOs the FxEngine used to consume with
+ * `erase(begin, begin + n)`: with a fast-bursting decoder those held
+ * seconds of audio, so every pump memmoved the whole backlog. Here a
+ * consume is an index bump, whatever the buffered duration.
+ *
+ * The producer side (prepareWrite/commitWrite/write) and the consumer side
+ * (peek/commitRead/read/discard) may run on two different threads without
+ * locks. Members documented as "owner only" rearrange both indices and are
+ * only valid while no other thread touches the ring (the engine thread
+ * calls them between pumps). Capacity is rounded up to a power of two
+ * frames; allocation happens in reset() only, never on the audio path.
+ */
+template <typename Sample>
+class BasicFrameRing
+{
+public:
+    /** Up to two contiguous spans cover any readable/writable range. */
+    struct Region
+    {
+        Sample *data = nullptr;
+        size_t frames = 0;
+    };
+
+    explicit BasicFrameRing(int channels = 2);
+
+    BasicFrameRing(const BasicFrameRing &) = delete;
+    BasicFrameRing &operator=(const BasicFrameRing &) = delete;
+
+    /** Owner only: (re)allocate for at least capacityFrames and empty it. */
+    void reset(size_t capacityFrames);
+    /** Owner only: drop all buffered frames, keeping the storage. */
+    void clear();
+    /** Owner only: exchange storage and contents with another ring. */
+    void swap(BasicFrameRing &other);
+
+    int channels() const { return m_channels; }
+    size_t capacityFrames() const { return m_storage.empty() ? 0 : m_mask + 1; }
+
+    size_t availableFrames() const
+    {
+        return m_write.load(std::memory_order_acquire)
+               - m_read.load(std::memory_order_acquire);
+    }
+    size_t freeFrames() const { return capacityFrames() - availableFrames(); }
+    bool isEmpty() const { return availableFrames() == 0; }
+
+    // --- producer ---------------------------------------------------------
+
+    /** Writable space for up to maxFrames; returns the total frames offered. */
+    size_t prepareWrite(size_t maxFrames, Region &first, Region &second);
+    /** Publish frames written into the regions of the last prepareWrite(). */
+    void commitWrite(size_t frames)
+    {
+        m_write.store(m_write.load(std::memory_order_relaxed) + frames,
+                      std::memory_order_release);
+    }
+    /** Copy in as many frames as fit; returns the frames written. */
+    size_t write(const Sample *interleaved, size_t frames);
+
+    // --- consumer ---------------------------------------------------------
+
+    /** Zero-copy view of up to maxFrames of the oldest buffered frames. */
+    size_t peek(size_t maxFrames, Region &first, Region &second) const;
+    /** Release frames obtained through peek(). */
+    void commitRead(size_t frames)
+    {
+        m_read.store(m_read.load(std::memory_order_relaxed) + frames,
+                     std::memory_order_release);
+    }
+    /** Copy out and consume up to frames; returns the frames read. */
+    size_t read(Sample *interleaved, size_t frames);
+    /** Consume up to frames without copying them anywhere. */
+    size_t discard(size_t frames);
+    /** Copy frames [offset, offset+frames) of the readable range, not consuming. */
+    size_t copyOut(size_t offset, Sample *interleaved, size_t frames) const;
+
+    /**
+     * Random access to the i-th readable frame (0 = oldest). A frame never
+     * straddles the wrap point, so the pointer covers all its channels.
+     */
+    const Sample *frame(size_t i) const
+    {
+        const size_t idx = (m_read.load(std::memory_order_relaxed) + i) & m_mask;
+        return m_storage.data() + idx * static_cast<size_t>(m_channels);
+    }
+
+    // --- owner only -------------------------------------------------------
+
+    /** Drop the newest frames (auto-cue tail trim once the decoder is done). */
+    void dropNewest(size_t frames);
+    /**
+     * Append, evicting the oldest frames when full: a rolling window of the
+     * most recent capacityFrames() (the scratch history).
+     */
+    void writeOverwrite(const Sample *interleaved, size_t frames);
+
+private:
+    int m_channels;
+    size_t m_mask = 0;
+    std::vector<Sample> m_storage;
+    // Monotonic frame counters; the slot is counter & m_mask. Kept on
+    // separate cache lines so producer and consumer don't false-share.
+    alignas(64) std::atomic<size_t> m_write{0};
+    alignas(64) std::atomic<size_t> m_read{0};
+};
+
+// Instantiated in FrameRing.cpp
+extern template class BasicFrameRing<float>;
+extern template class BasicFrameRing<int16_t>;
+
+using FrameRing = BasicFrameRing<float>;
+using FrameRing16 = BasicFrameRing<int16_t>;
+
+#endif // FRAMERING_H
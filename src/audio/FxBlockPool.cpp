@@ -0,0 +1,56 @@
+#include "FxBlockPool.h"
+
+#include <algorithm>
+
+FxBlockPool::FxBlockPool(int channels, size_t blockFrames)
+    : m_channels(std::max(1, channels))
+    , m_blockFrames(std::max<size_t>(1, blockFrames))
+{
+}
+
+FxBlockPool::~FxBlockPool() = default;
+
+FxBlockPool::Block *FxBlockPool::acquire(int refs)
+{
+    Block *block = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!m_free.empty()) {
+            block = m_free.back();
+            m_free.pop_back();
+        } else {
+            m_blocks.push_back(std::make_unique<Block>());
+            block = m_blocks.back().get();
+            block->samples.resize(m_blockFrames * static_cast<size_t>(m_channels));
+            block->pool = this;
+            m_free.reserve(m_blocks.size());
+        }
+    }
+    block->frames = 0;
+    block->refs.store(std::max(1, refs), std::memory_order_release);
+    return block;
+}
+
+void FxBlockPool::release(Block *block)
+{
+    if (block && block->refs.fetch_sub(1, std::memory_order_acq_rel) == 1)
+        block->pool->recycle(block);
+}
+
+void FxBlockPool::recycle(Block *block)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_free.push_back(block);
+}
+
+size_t FxBlockPool::allocatedBlocks() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_blocks.size();
+}
+
+size_t FxBlockPool::freeBlocks() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_free.size();
+}
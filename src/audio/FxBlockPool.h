@@ -0,0 +1,62 @@
+#ifndef FXBLOCKPOOL_H
+#define FXBLOCKPOOL_H
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+/**
+ * @brief Recycled, reference-counted blocks of interleaved float PCM.
+ *
+ * One rendered block is read by several consumers at once (the stream
+ * encoders of FxEncodeFanout): acquire() hands it out with one reference
+ * per consumer, each consumer calls release() when done, and the last
+ * release puts it back on the free list. Blocks are allocated on demand
+ * and then reused, so a steady stream allocates nothing.
+ *
+ * acquire() and release() may be called from any thread; the free list is
+ * behind a mutex, which is fine as long as the audio thread never touches
+ * the pool. The pool must outlive every block it handed out.
+ */
+class FxBlockPool
+{
+public:
+    struct Block
+    {
+        std::vector<float> samples; // blockFrames() * channels
+        size_t frames = 0;          // valid frames in samples
+        std::atomic<int> refs{0};
+        FxBlockPool *pool = nullptr;
+    };
+
+    FxBlockPool(int channels, size_t blockFrames);
+    ~FxBlockPool();
+
+    FxBlockPool(const FxBlockPool &) = delete;
+    FxBlockPool &operator=(const FxBlockPool &) = delete;
+
+    int channels() const { return m_channels; }
+    size_t blockFrames() const { return m_blockFrames; }
+
+    /** A free block holding refs references (at least one). */
+    Block *acquire(int refs);
+    /** Drop one reference; the last one returns the block to its pool. */
+    static void release(Block *block);
+
+    /** Blocks ever allocated, and of those the ones currently free. */
+    size_t allocatedBlocks() const;
+    size_t freeBlocks() const;
+
+private:
+    void recycle(Block *block);
+
+    const int m_channels;
+    const size_t m_blockFrames;
+    mutable std::mutex m_mutex;
+    std::vector<std::unique_ptr<Block>> m_blocks;
+    std::vector<Block *> m_free;
+};
+
+#endif // FXBLOCKPOOL_H
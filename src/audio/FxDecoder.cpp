@@ -0,0 +1,81 @@
+#include "FxDecoder.h"
+
+#include "FrameRing.h"
+
+#include <QProcess>
+
+#include <algorithm>
+
+ProcessDecoder::ProcessDecoder(QProcess *proc)
+    : m_proc(proc)
+{
+}
+
+ProcessDecoder::~ProcessDecoder()
+{
+    if (!m_proc)
+        return;
+    // Reap asynchronously: decoders are dropped from inside the pump
+    // (handoffs, seeks, superseded preloads) and waiting for the kill here
+    // would starve it.
+    m_proc->disconnect();
+    if (m_proc->state() != QProcess::NotRunning) {
+        QObject::connect(m_proc, &QProcess::finished, m_proc, &QObject::deleteLater);
+        m_proc->kill(); // SIGKILL: finished always follows and deletes it
+    } else {
+        m_proc->deleteLater();
+    }
+}
+
+size_t ProcessDecoder::drainInto(FrameRing &ring)
+{
+    // Only whole frames are read: a sub-frame remainder stays in the
+    // process buffer until the rest of it arrives, and whatever does not
+    // fit in the ring waits there for the next pump.
+    const qint64 bytesPerFrame = qint64(sizeof(float)) * ring.channels();
+    const qint64 availFrames = m_proc->bytesAvailable() / bytesPerFrame;
+    if (availFrames <= 0) {
+        // A decoder that died mid-frame leaves a remainder that can never
+        // complete; drop it so end-of-stream is detected.
+        if (m_proc->state() == QProcess::NotRunning && m_proc->bytesAvailable() > 0)
+            m_proc->readAll();
+        return 0;
+    }
+
+    FrameRing::Region a, b;
+    if (ring.prepareWrite(static_cast<size_t>(availFrames), a, b) == 0)
+        return 0; // ring full
+
+    const qint64 firstBytes = static_cast<qint64>(a.frames) * bytesPerFrame;
+    qint64 got = m_proc->read(reinterpret_cast<char *>(a.data), firstBytes);
+    if (got == firstBytes && b.frames > 0) {
+        const qint64 more = m_proc->read(reinterpret_cast<char *>(b.data),
+                                         static_cast<qint64>(b.frames) * bytesPerFrame);
+        got += std::max<qint64>(0, more);
+    }
+    const size_t frames = static_cast<size_t>(std::max<qint64>(0, got) / bytesPerFrame);
+    ring.commitWrite(frames);
+    return frames;
+}
+
+bool ProcessDecoder::running() const
+{
+    return m_proc->state() != QProcess::NotRunning;
+}
+
+bool ProcessDecoder::hasPendingOutput() const
+{
+    return m_proc->bytesAvailable() > 0;
+}
+
+bool ProcessDecoder::failed() const
+{
+    return m_proc->state() == QProcess::NotRunning
+           && (m_proc->exitCode() != 0 || m_proc->error() == QProcess::FailedToStart);
+}
+
+QString ProcessDecoder::errorString() const
+{
+    const QString err = QString::fromLocal8Bit(m_proc->readAllStandardError()).trimmed();
+    return err.isEmpty() ? m_proc->errorString() : err;
+}
@@ -0,0 +1,68 @@
+#ifndef FXDECODER_H
+#define FXDECODER_H
+
+#include <QString>
+#include <QtGlobal>
+
+#include <cstddef>
+
+#include "FrameRing.h"
+
+class QObject;
+class QProcess;
+
+/**
+ * @brief One running decode of an audio source into 48 kHz stereo float.
+ *
+ * The FxEngine only talks to this interface, so the main deck, the gapless
+ * preload and the crossfade tail do not care whether the PCM comes from an
+ * `ffmpeg` child process (ProcessDecoder, always available) or from libav
+ * in-process (LibavDecoder, when XFB is built with XFB_HAVE_LIBAV).
+ *
+ * Decoders are owned and driven by the engine thread. Destroying one stops
+ * it without blocking that thread.
+ */
+class FxDecoder
+{
+public:
+    virtual ~FxDecoder() = default;
+
+    /** Move as many decoded frames as fit into the ring; returns frames added. */
+    virtual size_t drainInto(FrameRing &ring) = 0;
+    /** True while the decoder may still produce more frames. */
+    virtual bool running() const = 0;
+    /** True when decoded output is waiting that the ring could not take yet. */
+    virtual bool hasPendingOutput() const = 0;
+    /** Ended with an error (only meaningful once running() is false). */
+    virtual bool failed() const = 0;
+    /** Human-readable detail for failed(). */
+    virtual QString errorString() const = 0;
+
+    /** Finished and fully drained: nothing more will ever arrive. */
+    bool exhausted() const { return !running() && !hasPendingOutput(); }
+};
+
+/**
+ * Decoder backed by an `ffmpeg ... -f f32le -` child process whose stdout
+ * is read in whole frames. Takes ownership of the (already started)
+ * process; destruction kills it and reaps it asynchronously.
+ */
+class ProcessDecoder : public FxDecoder
+{
+public:
+    explicit ProcessDecoder(QProcess *proc);
+    ~ProcessDecoder() override;
+
+    size_t drainInto(FrameRing &ring) override;
+    bool running() const override;
+    bool hasPendingOutput() const override;
+    bool failed() const override;
+    QString errorString() const override;
+
+    QProcess *process() const { return m_proc; }
+
+private:
+    QProcess *m_proc;
+};
+
+#endif // FXDECODER_H
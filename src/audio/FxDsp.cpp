@@ -4,6 +4,14 @@
 #include <cmath>
 #include <cstring>
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define FXDSP_SSE2 1
+#include <emmintrin.h>
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#define FXDSP_NEON 1
+#include <arm_neon.h>
+#endif
+
 namespace fxdsp
 {
 
@@ -14,6 +22,22 @@ constexpr double kPi = 3.14159265358979323846;
 
 inline double dbToLin(double db) { return std::pow(10.0, db / 20.0); }
 inline double linToDb(double lin) { return 20.0 * std::log10(std::max(lin, 1e-9)); }
+
+/** linToDb on a fast log2 (IEEE-754 exponent + rational fit of the
+    mantissa, ~1e-4 abs error in log2): good to ~0.001 dB for a detector. */
+inline float fastLinToDb(float lin)
+{
+    const float x = std::max(lin, 1e-9f);
+    uint32_t bits;
+    std::memcpy(&bits, &x, sizeof(bits));
+    const uint32_t mantBits = (bits & 0x007FFFFFu) | 0x3F000000u;
+    float mant;
+    std::memcpy(&mant, &mantBits, sizeof(mant));
+    const float log2x = static_cast<float>(bits) * 1.1920928955078125e-7f
+                        - 124.22551499f - 1.498030302f * mant
+                        - 1.72587999f / (0.3520887068f + mant);
+    return 6.0205999f * log2x; // 20 * log10(2)
+}
 }
 
 // ---------------------------------------------------------------- BiquadPeak
@@ -52,6 +76,72 @@ void BiquadPeak::reset()
     m_x1r = m_x2r = m_y1r = m_y2r = 0.0;
 }
 
+void BiquadPeak::processBlock(float *interleaved, int frames)
+{
+#if defined(FXDSP_SSE2)
+    // Lane 0 = left, lane 1 = right
+    const __m128d b0 = _mm_set1_pd(m_b0);
+    const __m128d b1 = _mm_set1_pd(m_b1);
+    const __m128d b2 = _mm_set1_pd(m_b2);
+    const __m128d a1 = _mm_set1_pd(m_a1);
+    const __m128d a2 = _mm_set1_pd(m_a2);
+    __m128d x1 = _mm_set_pd(m_x1r, m_x1l);
+    __m128d x2 = _mm_set_pd(m_x2r, m_x2l);
+    __m128d y1 = _mm_set_pd(m_y1r, m_y1l);
+    __m128d y2 = _mm_set_pd(m_y2r, m_y2l);
+
+    for (int i = 0; i < frames; ++i) {
+        float *p = interleaved + 2 * i;
+        const __m128d in = _mm_cvtps_pd(
+            _mm_castsi128_ps(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(p))));
+        __m128d out = _mm_mul_pd(b0, in);
+        out = _mm_add_pd(out, _mm_mul_pd(b1, x1));
+        out = _mm_add_pd(out, _mm_mul_pd(b2, x2));
+        out = _mm_sub_pd(out, _mm_mul_pd(a1, y1));
+        out = _mm_sub_pd(out, _mm_mul_pd(a2, y2));
+        x2 = x1; x1 = in;
+        y2 = y1; y1 = out;
+        _mm_storel_epi64(reinterpret_cast<__m128i *>(p), _mm_castps_si128(_mm_cvtpd_ps(out)));
+    }
+
+    _mm_storel_pd(&m_x1l, x1); _mm_storeh_pd(&m_x1r, x1);
+    _mm_storel_pd(&m_x2l, x2); _mm_storeh_pd(&m_x2r, x2);
+    _mm_storel_pd(&m_y1l, y1); _mm_storeh_pd(&m_y1r, y1);
+    _mm_storel_pd(&m_y2l, y2); _mm_storeh_pd(&m_y2r, y2);
+#elif defined(FXDSP_NEON)
+    const float64x2_t b0 = vdupq_n_f64(m_b0);
+    const float64x2_t b1 = vdupq_n_f64(m_b1);
+    const float64x2_t b2 = vdupq_n_f64(m_b2);
+    const float64x2_t a1 = vdupq_n_f64(m_a1);
+    const float64x2_t a2 = vdupq_n_f64(m_a2);
+    const double x1s[2] = {m_x1l, m_x1r}, x2s[2] = {m_x2l, m_x2r};
+    const double y1s[2] = {m_y1l, m_y1r}, y2s[2] = {m_y2l, m_y2r};
+    float64x2_t x1 = vld1q_f64(x1s), x2 = vld1q_f64(x2s);
+    float64x2_t y1 = vld1q_f64(y1s), y2 = vld1q_f64(y2s);
+
+    for (int i = 0; i < frames; ++i) {
+        float *p = interleaved + 2 * i;
+        const float64x2_t in = vcvt_f64_f32(vld1_f32(p));
+        float64x2_t out = vmulq_f64(b0, in);
+        out = vaddq_f64(out, vmulq_f64(b1, x1));
+        out = vaddq_f64(out, vmulq_f64(b2, x2));
+        out = vsubq_f64(out, vmulq_f64(a1, y1));
+        out = vsubq_f64(out, vmulq_f64(a2, y2));
+        x2 = x1; x1 = in;
+        y2 = y1; y1 = out;
+        vst1_f32(p, vcvt_f32_f64(out));
+    }
+
+    m_x1l = vgetq_lane_f64(x1, 0); m_x1r = vgetq_lane_f64(x1, 1);
+    m_x2l = vgetq_lane_f64(x2, 0); m_x2r = vgetq_lane_f64(x2, 1);
+    m_y1l = vgetq_lane_f64(y1, 0); m_y1r = vgetq_lane_f64(y1, 1);
+    m_y2l = vgetq_lane_f64(y2, 0); m_y2r = vgetq_lane_f64(y2, 1);
+#else
+    for (int i = 0; i < frames; ++i)
+        processFrame(interleaved[2 * i], interleaved[2 * i + 1]);
+#endif
+}
+
 // ----------------------------------------------------------------- Equalizer
 
 void Equalizer::configure(double sampleRate, const FxParams &p)
@@ -88,6 +178,25 @@ void Equalizer::process(float *interleaved, int frames)
     }
 }
 
+void Equalizer::processVectorized(float *interleaved, int frames)
+{
+    if (!m_active)
+        return;
+
+    // Band-outer order: each biquad keeps its state in registers for the
+    // whole block. The result matches process(), which rounds to float
+    // between bands too.
+    const float preamp = static_cast<float>(m_preampLin);
+    if (preamp != 1.0f) {
+        for (int i = 0; i < frames * 2; ++i)
+            interleaved[i] *= preamp;
+    }
+    for (auto &b : m_bands) {
+        if (!b.isIdentity())
+            b.processBlock(interleaved, frames);
+    }
+}
+
 // ---------------------------------------------------------------- Compressor
 
 void Compressor::configure(double sampleRate, const FxParams &p)
@@ -107,6 +216,21 @@ void Compressor::reset()
 {
     m_envDb = -120.0;
     m_gainReductionDb = 0.0;
+    m_blockGain = m_makeupLin;
+}
+
+double Compressor::gainFor(double envDb) const
+{
+    // Soft-knee gain computer
+    const double overDb = envDb - m_thresholdDb;
+    double reductionDb = 0.0;
+    if (overDb >= m_kneeDb / 2.0) {
+        reductionDb = overDb * (1.0 - 1.0 / m_ratio);
+    } else if (overDb > -m_kneeDb / 2.0) {
+        const double t = overDb + m_kneeDb / 2.0;
+        reductionDb = (1.0 - 1.0 / m_ratio) * t * t / (2.0 * m_kneeDb);
+    }
+    return dbToLin(-reductionDb) * m_makeupLin;
 }
 
 void Compressor::process(float *interleaved, int frames)
@@ -129,22 +253,44 @@ void Compressor::process(float *interleaved, int frames)
         else
             m_envDb = m_releaseCoef * m_envDb + (1.0 - m_releaseCoef) * levelDb;
 
-        // Soft-knee gain computer
-        const double overDb = m_envDb - m_thresholdDb;
-        double reductionDb = 0.0;
-        if (overDb >= m_kneeDb / 2.0) {
-            reductionDb = overDb * (1.0 - 1.0 / m_ratio);
-        } else if (overDb > -m_kneeDb / 2.0) {
-            const double t = overDb + m_kneeDb / 2.0;
-            reductionDb = (1.0 - 1.0 / m_ratio) * t * t / (2.0 * m_kneeDb);
-        }
-
-        const double gain = dbToLin(-reductionDb) * m_makeupLin;
+        const double gain = gainFor(m_envDb);
         l = static_cast<float>(l * gain);
         r = static_cast<float>(r * gain);
     }
 }
 
+void Compressor::processBlockRate(float *interleaved, int frames)
+{
+    if (!m_active)
+        return;
+
+    for (int start = 0; start < frames; start += kGainBlock) {
+        const int n = std::min(kGainBlock, frames - start);
+        float *block = interleaved + 2 * start;
+
+        // Same detector as process(), on the cheap log
+        for (int i = 0; i < n; ++i) {
+            const float level = std::max(std::fabs(block[2 * i]), std::fabs(block[2 * i + 1]));
+            const double levelDb = fastLinToDb(level);
+            if (levelDb > m_envDb)
+                m_envDb = m_attackCoef * m_envDb + (1.0 - m_attackCoef) * levelDb;
+            else
+                m_envDb = m_releaseCoef * m_envDb + (1.0 - m_releaseCoef) * levelDb;
+        }
+
+        // Ramp from the previous block's gain to this one's
+        const float target = static_cast<float>(gainFor(m_envDb));
+        float g = static_cast<float>(m_blockGain);
+        const float step = (target - g) / static_cast<float>(n);
+        for (int i = 0; i < n; ++i) {
+            g += step;
+            block[2 * i] *= g;
+            block[2 * i + 1] *= g;
+        }
+        m_blockGain = target;
+    }
+}
+
 // ------------------------------------------------------------------ DjFilter
 
 void DjFilter::setup(double sampleRate)
@@ -263,12 +409,331 @@ void Echo::process(float *interleaved, int frames)
     }
 }
 
+// -------------------------------------------------------------- GainEnvelope
+
+void GainEnvelope::setPoints(std::vector<Point> points)
+{
+    std::stable_sort(points.begin(), points.end(),
+                     [](const Point &a, const Point &b) { return a.frame < b.frame; });
+    m_points = std::move(points);
+}
+
+double GainEnvelope::gainAt(int64_t frame) const
+{
+    if (m_points.empty())
+        return m_trim;
+    const auto next = std::upper_bound(m_points.begin(), m_points.end(), frame,
+                                       [](int64_t f, const Point &p) { return f < p.frame; });
+    if (next == m_points.begin())
+        return next->gain * m_trim;
+    if (next == m_points.end())
+        return m_points.back().gain * m_trim;
+    const Point &a = *(next - 1);
+    const double t = double(frame - a.frame) / double(next->frame - a.frame);
+    return (a.gain + t * (next->gain - a.gain)) * m_trim;
+}
+
+void GainEnvelope::apply(float *interleaved, int frames, int64_t startFrame) const
+{
+    if (isEmpty() || frames <= 0)
+        return;
+    if (m_points.empty()) {
+        // No line, only the normalization trim
+        const float g = static_cast<float>(m_trim);
+        for (int i = 0; i < frames * 2; ++i)
+            interleaved[i] *= g;
+        return;
+    }
+
+    // Walk the chunk one segment at a time: inside a segment the gain is a
+    // straight line, so each sample costs one multiply-add. The gain is
+    // evaluated from the segment start (not accumulated), so long segments
+    // do not drift.
+    auto next = std::upper_bound(m_points.begin(), m_points.end(), startFrame,
+                                 [](int64_t f, const Point &p) { return f < p.frame; });
+    float *p = interleaved;
+    int done = 0;
+    while (done < frames) {
+        const int64_t pos = startFrame + done;
+        while (next != m_points.end() && next->frame <= pos)
+            ++next;
+
+        int run = frames - done;
+        double g0, slope = 0.0;
+        if (next == m_points.begin()) {
+            g0 = next->gain; // before the first point: held flat
+            run = static_cast<int>(std::min<int64_t>(run, next->frame - pos));
+        } else if (next == m_points.end()) {
+            g0 = m_points.back().gain; // after the last point: held flat
+        } else {
+            const Point &a = *(next - 1);
+            slope = (next->gain - a.gain) / double(next->frame - a.frame);
+            g0 = a.gain + slope * double(pos - a.frame);
+            run = static_cast<int>(std::min<int64_t>(run, next->frame - pos));
+        }
+        g0 *= m_trim;
+        slope *= m_trim;
+
+        for (int i = 0; i < run; ++i) {
+            const float g = static_cast<float>(g0 + slope * i);
+            p[0] *= g;
+            p[1] *= g;
+            p += 2;
+        }
+        done += run;
+    }
+}
+
+// ------------------------------------------------------------- LoudnessMeter
+
+void LoudnessMeter::setup(double sampleRate)
+{
+    // BS.1770 K-weighting, designed for the actual rate (the standard's
+    // tabulated coefficients are the 48 kHz case of these formulas)
+    {
+        const double f0 = 1681.974450955533;
+        const double gainDb = 3.999843853973347;
+        const double q = 0.7071752369554196;
+        const double k = std::tan(kPi * f0 / sampleRate);
+        const double vh = std::pow(10.0, gainDb / 20.0);
+        const double vb = std::pow(vh, 0.4996667741545416);
+        const double a0 = 1.0 + k / q + k * k;
+        m_shelf.b0 = (vh + vb * k / q + k * k) / a0;
+        m_shelf.b1 = 2.0 * (k * k - vh) / a0;
+        m_shelf.b2 = (vh - vb * k / q + k * k) / a0;
+        m_shelf.a1 = 2.0 * (k * k - 1.0) / a0;
+        m_shelf.a2 = (1.0 - k / q + k * k) / a0;
+    }
+    {
+        const double f0 = 38.13547087602444;
+        const double q = 0.5003270373238773;
+        const double k = std::tan(kPi * f0 / sampleRate);
+        const double a0 = 1.0 + k / q + k * k;
+        m_highPass.b0 = 1.0;
+        m_highPass.b1 = -2.0;
+        m_highPass.b2 = 1.0;
+        m_highPass.a1 = 2.0 * (k * k - 1.0) / a0;
+        m_highPass.a2 = (1.0 - k / q + k * k) / a0;
+    }
+    m_subBlockFrames = std::max(1, static_cast<int>(std::lround(sampleRate / 10.0)));
+
+    // True-peak interpolator: phase p estimates the point p/4 of a sample
+    // after the centre of the tap window, Hann-windowed sinc, unity DC gain
+    const double half = kTpTaps / 2;
+    for (int p = 0; p < kTpPhases; ++p) {
+        double sum = 0.0;
+        for (int k = 0; k < kTpTaps; ++k) {
+            const double x = (half - k) - double(p) / kTpPhases;
+            const double sinc = x == 0.0 ? 1.0 : std::sin(kPi * x) / (kPi * x);
+            const double window = 0.5 * (1.0 + std::cos(kPi * x / half));
+            m_tpCoef[p][k] = sinc * window;
+            sum += m_tpCoef[p][k];
+        }
+        for (int k = 0; k < kTpTaps; ++k)
+            m_tpCoef[p][k] /= sum;
+    }
+    reset();
+}
+
+void LoudnessMeter::reset()
+{
+    for (Biquad *f : {&m_shelf, &m_highPass}) {
+        for (int ch = 0; ch < 2; ++ch)
+            f->x1[ch] = f->x2[ch] = f->y1[ch] = f->y2[ch] = 0.0;
+    }
+    m_subBlockFill = 0;
+    m_subBlockSum = 0.0;
+    m_subBlocks.clear();
+    std::memset(m_tpHistory, 0, sizeof(m_tpHistory));
+    m_truePeak = 0.0;
+}
+
+void LoudnessMeter::process(const float *interleaved, int frames)
+{
+    const float *p = interleaved;
+    for (int i = 0; i < frames; ++i, p += 2) {
+        for (int ch = 0; ch < 2; ++ch) {
+            const double k = m_highPass.run(ch, m_shelf.run(ch, p[ch]));
+            m_subBlockSum += k * k;
+
+            float *h = m_tpHistory[ch];
+            std::memmove(h + 1, h, (kTpTaps - 1) * sizeof(float));
+            h[0] = p[ch];
+            double peak = std::abs(double(p[ch]));
+            for (int ph = 1; ph < kTpPhases; ++ph) {
+                double acc = 0.0;
+                for (int t = 0; t < kTpTaps; ++t)
+                    acc += m_tpCoef[ph][t] * h[t];
+                peak = std::max(peak, std::abs(acc));
+            }
+            m_truePeak = std::max(m_truePeak, peak);
+        }
+        if (++m_subBlockFill == m_subBlockFrames) {
+            m_subBlocks.push_back(m_subBlockSum / m_subBlockFrames);
+            m_subBlockFill = 0;
+            m_subBlockSum = 0.0;
+        }
+    }
+}
+
+double LoudnessMeter::momentaryLufs(size_t block) const
+{
+    if (block >= blocks())
+        return kSilenceLufs;
+    const double z = (m_subBlocks[block] + m_subBlocks[block + 1]
+                      + m_subBlocks[block + 2] + m_subBlocks[block + 3]) / 4.0;
+    return z > 0.0 ? std::max(kSilenceLufs, -0.691 + 10.0 * std::log10(z)) : kSilenceLufs;
+}
+
+double LoudnessMeter::integratedLufs() const
+{
+    const size_t n = blocks();
+    const auto energy = [this](size_t j) {
+        return (m_subBlocks[j] + m_subBlocks[j + 1] + m_subBlocks[j + 2] + m_subBlocks[j + 3]) / 4.0;
+    };
+    const auto lufs = [](double z) { return -0.691 + 10.0 * std::log10(z); };
+
+    // Absolute gate, then the relative gate from what passed it
+    const double absGate = std::pow(10.0, (-70.0 + 0.691) / 10.0);
+    double sum = 0.0;
+    size_t count = 0;
+    for (size_t j = 0; j < n; ++j) {
+        const double z = energy(j);
+        if (z > absGate) {
+            sum += z;
+            ++count;
+        }
+    }
+    if (count == 0)
+        return kSilenceLufs;
+    const double relGate = std::pow(10.0, (lufs(sum / count) - 10.0 + 0.691) / 10.0);
+
+    sum = 0.0;
+    count = 0;
+    for (size_t j = 0; j < n; ++j) {
+        const double z = energy(j);
+        if (z > absGate && z > relGate) {
+            sum += z;
+            ++count;
+        }
+    }
+    return count ? lufs(sum / count) : kSilenceLufs;
+}
+
+double LoudnessMeter::truePeakDb() const
+{
+    return m_truePeak > 0.0 ? linToDb(m_truePeak) : kSilenceLufs;
+}
+
 // -------------------------------------------------------------------- Common
 
+int peakAbsS16(const int16_t *samples, int count)
+{
+    int i = 0;
+    int peak = 0;
+
+#if defined(FXDSP_SSE2)
+    // |x| as max(x, 0 - x) with saturation: -32768 becomes 32767
+    const __m128i zero = _mm_setzero_si128();
+    __m128i acc = zero;
+    for (; i + 8 <= count; i += 8) {
+        const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(samples + i));
+        acc = _mm_max_epi16(acc, _mm_max_epi16(v, _mm_subs_epi16(zero, v)));
+    }
+    acc = _mm_max_epi16(acc, _mm_srli_si128(acc, 8));
+    acc = _mm_max_epi16(acc, _mm_srli_si128(acc, 4));
+    acc = _mm_max_epi16(acc, _mm_srli_si128(acc, 2));
+    peak = static_cast<int16_t>(_mm_cvtsi128_si32(acc));
+#elif defined(FXDSP_NEON)
+    int16x8_t acc = vdupq_n_s16(0);
+    for (; i + 8 <= count; i += 8)
+        acc = vmaxq_s16(acc, vqabsq_s16(vld1q_s16(samples + i)));
+    peak = vmaxvq_s16(acc);
+#endif
+
+    for (; i < count; ++i)
+        peak = std::max(peak, std::min(std::abs(int(samples[i])), 32767));
+    return peak;
+}
+
 void clampBuffer(float *interleaved, int frames)
 {
     for (int i = 0; i < frames * 2; ++i)
         interleaved[i] = std::clamp(interleaved[i], -1.0f, 1.0f);
 }
 
+void finishOutput(float *interleaved, int frames, float &peakL, float &peakR,
+                  int16_t *s16)
+{
+    const int n = frames * 2;
+    int i = 0;
+
+#if defined(FXDSP_SSE2)
+    // 4 lanes = two stereo frames: [L, R, L, R]
+    const __m128 hi = _mm_set1_ps(1.0f);
+    const __m128 lo = _mm_set1_ps(-1.0f);
+    const __m128 absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+    const __m128 scale = _mm_set1_ps(32767.0f);
+    __m128 peak = _mm_setzero_ps();
+    for (; i + 8 <= n; i += 8) {
+        __m128 v0 = _mm_loadu_ps(interleaved + i);
+        __m128 v1 = _mm_loadu_ps(interleaved + i + 4);
+        v0 = _mm_min_ps(_mm_max_ps(v0, lo), hi);
+        v1 = _mm_min_ps(_mm_max_ps(v1, lo), hi);
+        _mm_storeu_ps(interleaved + i, v0);
+        _mm_storeu_ps(interleaved + i + 4, v1);
+        peak = _mm_max_ps(peak, _mm_and_ps(v0, absMask));
+        peak = _mm_max_ps(peak, _mm_and_ps(v1, absMask));
+        if (s16) {
+            // Truncating conversion, like static_cast<int16_t>(x * 32767)
+            const __m128i i0 = _mm_cvttps_epi32(_mm_mul_ps(v0, scale));
+            const __m128i i1 = _mm_cvttps_epi32(_mm_mul_ps(v1, scale));
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(s16 + i), _mm_packs_epi32(i0, i1));
+        }
+    }
+    alignas(16) float lanes[4];
+    _mm_store_ps(lanes, peak);
+    peakL = std::max(peakL, std::max(lanes[0], lanes[2]));
+    peakR = std::max(peakR, std::max(lanes[1], lanes[3]));
+#elif defined(FXDSP_NEON)
+    const float32x4_t hi = vdupq_n_f32(1.0f);
+    const float32x4_t lo = vdupq_n_f32(-1.0f);
+    const float32x4_t scale = vdupq_n_f32(32767.0f);
+    float32x4_t peak = vdupq_n_f32(0.0f);
+    for (; i + 8 <= n; i += 8) {
+        float32x4_t v0 = vld1q_f32(interleaved + i);
+        float32x4_t v1 = vld1q_f32(interleaved + i + 4);
+        v0 = vminq_f32(vmaxq_f32(v0, lo), hi);
+        v1 = vminq_f32(vmaxq_f32(v1, lo), hi);
+        vst1q_f32(interleaved + i, v0);
+        vst1q_f32(interleaved + i + 4, v1);
+        peak = vmaxq_f32(peak, vabsq_f32(v0));
+        peak = vmaxq_f32(peak, vabsq_f32(v1));
+        if (s16) {
+            const int32x4_t i0 = vcvtq_s32_f32(vmulq_f32(v0, scale));
+            const int32x4_t i1 = vcvtq_s32_f32(vmulq_f32(v1, scale));
+            vst1q_s16(s16 + i, vcombine_s16(vqmovn_s32(i0), vqmovn_s32(i1)));
+        }
+    }
+    float lanes[4];
+    vst1q_f32(lanes, peak);
+    peakL = std::max(peakL, std::max(lanes[0], lanes[2]));
+    peakR = std::max(peakR, std::max(lanes[1], lanes[3]));
+#endif
+
+    // Scalar path / remainder (i stays frame-aligned)
+    for (; i < n; i += 2) {
+        const float l = std::clamp(interleaved[i], -1.0f, 1.0f);
+        const float r = std::clamp(interleaved[i + 1], -1.0f, 1.0f);
+        interleaved[i] = l;
+        interleaved[i + 1] = r;
+        peakL = std::max(peakL, std::fabs(l));
+        peakR = std::max(peakR, std::fabs(r));
+        if (s16) {
+            s16[i] = static_cast<int16_t>(l * 32767.0f);
+            s16[i + 1] = static_cast<int16_t>(r * 32767.0f);
+        }
+    }
+}
+
 } // namespace fxdsp
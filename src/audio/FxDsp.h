@@ -2,6 +2,7 @@
 #define FXDSP_H
 
 #include <cstddef>
+#include <cstdint>
 #include <vector>
 #include "FxParams.h"
 
@@ -11,6 +12,12 @@
  * All processors work on interleaved stereo float frames at a fixed
  * sample rate. They are real-time safe (no allocation in process paths)
  * and are only ever touched from the engine's worker thread.
+ *
+ * The plain per-frame process() paths are the reference implementation.
+ * The engine runs the vectorized variants (processVectorized,
+ * processBlockRate, finishOutput): SSE2 on x86-64, NEON on ARM64, with a
+ * scalar fallback elsewhere. They are checked against the reference by
+ * TestFxDsp (tests/unit/audio).
  */
 namespace fxdsp
 {
@@ -37,6 +44,14 @@ public:
         r = static_cast<float>(outR);
     }
 
+    /**
+     * Whole-block variant of processFrame: L and R share one 2-lane double
+     * vector, so each frame costs one vector recursion instead of two
+     * scalar ones. Same operation order and float rounding as the scalar
+     * path.
+     */
+    void processBlock(float *interleaved, int frames);
+
 private:
     double m_b0 = 1.0, m_b1 = 0.0, m_b2 = 0.0, m_a1 = 0.0, m_a2 = 0.0;
     double m_x1l = 0, m_x2l = 0, m_y1l = 0, m_y2l = 0;
@@ -51,6 +66,8 @@ public:
     void configure(double sampleRate, const FxParams &p);
     void reset();
     void process(float *interleaved, int frames);
+    /** Band-by-band over the whole block with vectorized biquads. */
+    void processVectorized(float *interleaved, int frames);
 
 private:
     BiquadPeak m_bands[FxParams::kBands];
@@ -65,8 +82,19 @@ public:
     void configure(double sampleRate, const FxParams &p);
     void reset();
     void process(float *interleaved, int frames);
+    /**
+     * Block-rate gain computer: the level detector still runs per sample,
+     * but on a fast log2 approximation instead of log10, and the soft-knee
+     * gain (the exp) is computed once per kGainBlock frames and ramped
+     * linearly across the block so no zipper steps are audible.
+     */
+    void processBlockRate(float *interleaved, int frames);
+
+    static constexpr int kGainBlock = 16;
 
 private:
+    double gainFor(double envDb) const;
+
     bool m_active = false;
     double m_thresholdDb = -18.0;
     double m_ratio = 3.0;
@@ -76,6 +104,7 @@ private:
     double m_releaseCoef = 0.0;
     double m_envDb = -120.0;      // level detector state (dBFS)
     double m_gainReductionDb = 0.0;
+    double m_blockGain = 1.0;     // block-rate path: gain the last block ended on
 };
 
 /**
@@ -122,9 +151,117 @@ private:
     double m_amount = 0.0;
 };
 
+/**
+ * Volume line of one track: linear gain breakpoints on the track's input
+ * timeline (frame 0 = start of the file), linearly interpolated in
+ * between and held flat before the first and after the last point — the
+ * same shape PlaylistWaveView::envelopeGainAt() draws, evaluated per
+ * sample instead of per GUI position tick. An empty envelope is unity.
+ */
+class GainEnvelope
+{
+public:
+    struct Point
+    {
+        int64_t frame = 0;
+        double gain = 1.0;
+    };
+
+    /** Points in any order; they are sorted by frame. */
+    void setPoints(std::vector<Point> points);
+    /**
+     * Flat gain the whole line is scaled by: the track's loudness
+     * normalization, so one pass applies both. 1 = none.
+     */
+    void setTrim(double gain) { m_trim = gain; }
+    double trim() const { return m_trim; }
+    void clear() { m_points.clear(); m_trim = 1.0; }
+    bool isEmpty() const { return m_points.empty() && m_trim == 1.0; }
+    double gainAt(int64_t frame) const;
+    /** Scale frames that start at input frame startFrame. */
+    void apply(float *interleaved, int frames, int64_t startFrame) const;
+
+private:
+    std::vector<Point> m_points;
+    double m_trim = 1.0;
+};
+
+/**
+ * Programme loudness and true peak of a stereo signal per ITU-R BS.1770-4
+ * / EBU R128: K-weighting, 400 ms blocks on a 100 ms hop, absolute gate at
+ * -70 LUFS and relative gate 10 LU below the ungated level. The true peak
+ * is read from a 4x oversampled copy of the signal (windowed-sinc
+ * interpolator), so inter-sample overs are caught.
+ *
+ * Meant for offline analysis of whole files: per-block energies are kept
+ * (8 bytes per 100 ms), so process() allocates as the programme grows.
+ */
+class LoudnessMeter
+{
+public:
+    static constexpr double kSilenceLufs = -120.0; // "no gated block" result
+
+    void setup(double sampleRate);
+    void reset();
+    void process(const float *interleaved, int frames);
+
+    /** Gated integrated loudness (LUFS); kSilenceLufs when all is gated out. */
+    double integratedLufs() const;
+    /** Highest oversampled sample magnitude, in dBTP. */
+    double truePeakDb() const;
+
+    /** Momentary (400 ms) loudness of the window starting at block * 100 ms. */
+    double momentaryLufs(size_t block) const;
+    /** Complete 400 ms windows measured so far. */
+    size_t blocks() const { return m_subBlocks.size() >= 4 ? m_subBlocks.size() - 3 : 0; }
+
+private:
+    static constexpr int kTpPhases = 4;
+    static constexpr int kTpTaps = 12;
+
+    struct Biquad
+    {
+        double b0 = 1, b1 = 0, b2 = 0, a1 = 0, a2 = 0;
+        double x1[2] = {0, 0}, x2[2] = {0, 0}, y1[2] = {0, 0}, y2[2] = {0, 0};
+        inline double run(int ch, double x)
+        {
+            const double y = b0 * x + b1 * x1[ch] + b2 * x2[ch] - a1 * y1[ch] - a2 * y2[ch];
+            x2[ch] = x1[ch]; x1[ch] = x;
+            y2[ch] = y1[ch]; y1[ch] = y;
+            return y;
+        }
+    };
+
+    Biquad m_shelf;              // stage 1: head-related high shelf
+    Biquad m_highPass;           // stage 2: RLB high-pass
+    int m_subBlockFrames = 4800; // 100 ms
+    int m_subBlockFill = 0;
+    double m_subBlockSum = 0.0;  // K-weighted energy, channels summed
+    std::vector<double> m_subBlocks; // mean square of each finished 100 ms
+
+    double m_tpCoef[kTpPhases][kTpTaps] = {};
+    float m_tpHistory[2][kTpTaps] = {}; // newest sample first
+    double m_truePeak = 0.0;
+};
+
+/**
+ * Largest |sample| of a block of s16 PCM (0..32767; -32768 saturates to
+ * 32767). The waveform extractor's peak reducer: 8 samples per SSE2 /
+ * NEON instruction instead of one compare per sample.
+ */
+int peakAbsS16(const int16_t *samples, int count);
+
 /** Hard safety clamp to [-1, 1] applied after the FX chain. */
 void clampBuffer(float *interleaved, int frames);
 
+/**
+ * Final output pass fused into one sweep over the chunk: the safety clamp,
+ * the per-channel peak meter (peakL/peakR are raised, never lowered) and,
+ * when s16 is non-null, the float -> s16 conversion for Int16 sinks.
+ */
+void finishOutput(float *interleaved, int frames, float &peakL, float &peakR,
+                  int16_t *s16);
+
 } // namespace fxdsp
 
 #endif // FXDSP_H
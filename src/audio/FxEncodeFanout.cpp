@@ -0,0 +1,288 @@
+#include "FxEncodeFanout.h"
+
+#include <QThread>
+#include <QTimer>
+
+#include <algorithm>
+#include <atomic>
+#include <ctime>
+#include <mutex>
+
+namespace
+{
+constexpr int kDrainIntervalMs = 10;
+
+qint64 threadCpuTimeUs()
+{
+#if defined(Q_OS_UNIX) && defined(CLOCK_THREAD_CPUTIME_ID)
+    timespec ts;
+    if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) == 0)
+        return qint64(ts.tv_sec) * 1000000 + ts.tv_nsec / 1000;
+#endif
+    return -1;
+}
+
+/**
+ * Lock-free single-producer / single-consumer queue of block pointers:
+ * the owner pushes, the lane thread pops (the owner too, once the lane
+ * thread has stopped).
+ */
+class BlockQueue
+{
+public:
+    explicit BlockQueue(size_t capacity)
+        : m_capacity(std::max<size_t>(1, capacity))
+    {
+        size_t slots = 1;
+        while (slots < m_capacity)
+            slots <<= 1;
+        m_slots.assign(slots, nullptr);
+        m_mask = slots - 1;
+    }
+
+    bool push(FxBlockPool::Block *block)
+    {
+        const size_t w = m_write.load(std::memory_order_relaxed);
+        if (w - m_read.load(std::memory_order_acquire) >= m_capacity)
+            return false;
+        m_slots[w & m_mask] = block;
+        m_write.store(w + 1, std::memory_order_release);
+        return true;
+    }
+
+    FxBlockPool::Block *pop()
+    {
+        const size_t r = m_read.load(std::memory_order_relaxed);
+        if (r == m_write.load(std::memory_order_acquire))
+            return nullptr;
+        FxBlockPool::Block *block = m_slots[r & m_mask];
+        m_read.store(r + 1, std::memory_order_release);
+        return block;
+    }
+
+    size_t size() const
+    {
+        return m_write.load(std::memory_order_acquire) - m_read.load(std::memory_order_acquire);
+    }
+
+private:
+    const size_t m_capacity;
+    std::vector<FxBlockPool::Block *> m_slots;
+    size_t m_mask = 0;
+    alignas(64) std::atomic<size_t> m_write{0};
+    alignas(64) std::atomic<size_t> m_read{0};
+};
+} // namespace
+
+struct FxEncodeFanout::Lane
+{
+    Lane(int laneId, const FxEncoder::Settings &laneSettings, size_t queueBlocks)
+        : id(laneId)
+        , settings(laneSettings)
+        , queue(queueBlocks)
+    {
+    }
+
+    /** Lane thread: replace the encoder, keeping what the old one still had. */
+    void reopen(const EncoderFactory &factory)
+    {
+        QByteArray tail;
+        if (encoder)
+            encoder->takeEncoded(tail);
+        encoder.reset();
+        QString error;
+        encoder = factory(settings, &error);
+
+        std::lock_guard<std::mutex> lock(outMutex);
+        out.bytes += tail;
+        if (encoder) {
+            out.restartOffset = out.bytes.size();
+        } else {
+            out.failed = true;
+            out.error = error;
+        }
+    }
+
+    /** Lane thread: encode what is queued and publish the output. */
+    void drain(const EncoderFactory &factory)
+    {
+        const qint64 cpuStart = threadCpuTimeUs();
+        if (restartRequested.exchange(false))
+            reopen(factory);
+
+        while (FxBlockPool::Block *block = queue.pop()) {
+            size_t accepted = 0;
+            if (encoder)
+                accepted = encoder->write(block->samples.data(), block->frames);
+            if (accepted < block->frames)
+                droppedFrames.fetch_add(block->frames - accepted, std::memory_order_relaxed);
+            FxBlockPool::release(block);
+        }
+
+        QByteArray bytes;
+        bool died = false;
+        QString error;
+        if (encoder) {
+            encoder->takeEncoded(bytes);
+            encoderQueued.store(encoder->queuedFrames(), std::memory_order_relaxed);
+            if (encoder->failed()) {
+                died = true;
+                error = encoder->errorString();
+                encoder.reset();
+            }
+        }
+        if (!bytes.isEmpty() || died) {
+            encodedBytes.fetch_add(bytes.size(), std::memory_order_relaxed);
+            std::lock_guard<std::mutex> lock(outMutex);
+            out.bytes += bytes;
+            if (died) {
+                out.failed = true;
+                out.error = error.isEmpty() ? QStringLiteral("encoder stopped") : error;
+            }
+        }
+        if (cpuStart >= 0)
+            cpuTimeUs.fetch_add(threadCpuTimeUs() - cpuStart, std::memory_order_relaxed);
+    }
+
+    const int id;
+    const FxEncoder::Settings settings;
+    BlockQueue queue;
+    QThread thread;
+    QObject *context = nullptr;            // lives on thread, owns its timer
+    std::unique_ptr<FxEncoder> encoder;    // lane thread only
+
+    std::atomic<bool> restartRequested{false};
+    std::atomic<quint64> droppedFrames{0};
+    std::atomic<qint64> encoderQueued{0};
+    std::atomic<qint64> encodedBytes{0};
+    std::atomic<qint64> cpuTimeUs{0};
+
+    std::mutex outMutex;
+    Output out;
+};
+
+FxEncodeFanout::FxEncodeFanout(int channels, int sampleRate, EncoderFactory encoderFactory)
+    : m_channels(std::max(1, channels))
+    , m_sampleRate(sampleRate)
+    , m_encoderFactory(std::move(encoderFactory))
+    , m_pool(m_channels, kBlockFrames)
+{
+}
+
+FxEncodeFanout::~FxEncodeFanout()
+{
+    clear();
+}
+
+int FxEncodeFanout::addLane(const FxEncoder::Settings &settings)
+{
+    const size_t queueBlocks = static_cast<size_t>(m_sampleRate) * kQueueMs / 1000 / kBlockFrames + 1;
+    m_lanes.push_back(std::make_unique<Lane>(m_nextId++, settings, queueBlocks));
+    Lane *l = m_lanes.back().get();
+
+    l->context = new QObject;
+    l->context->moveToThread(&l->thread);
+    QObject::connect(&l->thread, &QThread::started, l->context, [this, l]() {
+        l->reopen(m_encoderFactory);
+        auto *timer = new QTimer(l->context);
+        timer->setTimerType(Qt::PreciseTimer);
+        QObject::connect(timer, &QTimer::timeout, l->context, [this, l]() { l->drain(m_encoderFactory); });
+        timer->start(kDrainIntervalMs);
+    });
+    QObject::connect(&l->thread, &QThread::finished, l->context, &QObject::deleteLater);
+    l->thread.setObjectName(QStringLiteral("FxEncodeLane%1").arg(l->id));
+    l->thread.start();
+    return l->id;
+}
+
+void FxEncodeFanout::removeLane(int id)
+{
+    auto it = std::find_if(m_lanes.begin(), m_lanes.end(),
+                           [id](const std::unique_ptr<Lane> &l) { return l->id == id; });
+    if (it == m_lanes.end())
+        return;
+    Lane *l = it->get();
+    // The encoder (and an ffmpeg process) belongs to the lane thread
+    QMetaObject::invokeMethod(l->context, [l]() { l->encoder.reset(); }, Qt::BlockingQueuedConnection);
+    l->thread.quit();
+    l->thread.wait();
+    while (FxBlockPool::Block *block = l->queue.pop())
+        FxBlockPool::release(block);
+    m_lanes.erase(it);
+}
+
+void FxEncodeFanout::clear()
+{
+    while (!m_lanes.empty())
+        removeLane(m_lanes.back()->id);
+}
+
+void FxEncodeFanout::restartLane(int id)
+{
+    if (Lane *l = lane(id))
+        l->restartRequested.store(true);
+}
+
+void FxEncodeFanout::push(const float *interleaved, size_t frames)
+{
+    if (m_lanes.empty())
+        return;
+    const int refs = static_cast<int>(m_lanes.size());
+    const size_t channels = static_cast<size_t>(m_channels);
+    while (frames > 0) {
+        const size_t n = std::min(frames, kBlockFrames);
+        FxBlockPool::Block *block = m_pool.acquire(refs);
+        std::copy(interleaved, interleaved + n * channels, block->samples.begin());
+        block->frames = n;
+        for (auto &l : m_lanes) {
+            // A lane that is behind loses this block; nobody else waits for it
+            if (!l->queue.push(block)) {
+                l->droppedFrames.fetch_add(n, std::memory_order_relaxed);
+                FxBlockPool::release(block);
+            }
+        }
+        interleaved += n * channels;
+        frames -= n;
+    }
+}
+
+bool FxEncodeFanout::takeOutput(int id, Output &out)
+{
+    Lane *l = lane(id);
+    if (!l)
+        return false;
+    out.bytes.clear();
+    std::lock_guard<std::mutex> lock(l->outMutex);
+    out.bytes.swap(l->out.bytes);
+    out.restartOffset = l->out.restartOffset;
+    out.failed = l->out.failed;
+    out.error = l->out.error;
+    l->out.restartOffset = -1;
+    l->out.failed = false;
+    l->out.error.clear();
+    return true;
+}
+
+FxEncodeFanout::LaneStats FxEncodeFanout::laneStats(int id) const
+{
+    LaneStats stats;
+    Lane *l = lane(id);
+    if (!l)
+        return stats;
+    stats.settings = l->settings;
+    stats.queuedFrames = static_cast<qint64>(l->queue.size() * kBlockFrames)
+                         + l->encoderQueued.load(std::memory_order_relaxed);
+    stats.droppedFrames = l->droppedFrames.load(std::memory_order_relaxed);
+    stats.encodedBytes = l->encodedBytes.load(std::memory_order_relaxed);
+    stats.cpuTimeUs = threadCpuTimeUs() < 0 ? -1 : l->cpuTimeUs.load(std::memory_order_relaxed);
+    return stats;
+}
+
+FxEncodeFanout::Lane *FxEncodeFanout::lane(int id) const
+{
+    for (const auto &l : m_lanes) {
+        if (l->id == id)
+            return l.get();
+    }
+    return nullptr;
+}
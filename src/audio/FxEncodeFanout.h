@@ -0,0 +1,93 @@
+#ifndef FXENCODEFANOUT_H
+#define FXENCODEFANOUT_H
+
+#include "FxBlockPool.h"
+#include "FxEncoder.h"
+
+#include <QByteArray>
+#include <QString>
+
+#include <functional>
+#include <memory>
+#include <vector>
+
+/**
+ * @brief Encodes one PCM stream at several bitrates at once.
+ *
+ * Each encoder (a "lane") runs on a thread of its own. push() cuts the
+ * stream into blocks from one FxBlockPool and queues every block for all
+ * lanes by reference, so adding a bitrate costs that encoder's CPU and
+ * nothing else: no second capture, no copy per lane. A lane's queue is
+ * bounded (kQueueMs of audio); a lane that falls behind drops its own
+ * blocks, counted in its stats, while the others and the caller carry on.
+ *
+ * The owner (one thread) adds and removes lanes, pushes PCM and collects
+ * each lane's encoded output with takeOutput(). Lanes may be restarted:
+ * the encoder is reopened, so its output continues with a fresh container
+ * header (a new link in a chained Ogg stream), which is where a listener
+ * connection that needs the header can join.
+ */
+class FxEncodeFanout
+{
+public:
+    using EncoderFactory = std::function<std::unique_ptr<FxEncoder>(const FxEncoder::Settings &, QString *)>;
+
+    static constexpr size_t kBlockFrames = 1024;
+    // Audio a lane may queue before it drops blocks
+    static constexpr int kQueueMs = 2000;
+
+    /** Encoded output of one lane since the previous takeOutput(). */
+    struct Output
+    {
+        QByteArray bytes;
+        // Offset in bytes where the restarted encoder's output begins, -1 if none
+        qsizetype restartOffset = -1;
+        bool failed = false;        // the encoder died, or could not be reopened, since the last call
+        QString error;
+    };
+
+    struct LaneStats
+    {
+        FxEncoder::Settings settings;
+        qint64 queuedFrames = 0;    // blocks waiting plus the encoder's own queue
+        quint64 droppedFrames = 0;  // blocks the lane had no room for, plus refused frames
+        qint64 encodedBytes = 0;
+        qint64 cpuTimeUs = 0;       // thread CPU time spent encoding (-1 if unavailable)
+    };
+
+    FxEncodeFanout(int channels, int sampleRate, EncoderFactory encoderFactory);
+    ~FxEncodeFanout();
+
+    FxEncodeFanout(const FxEncodeFanout &) = delete;
+    FxEncodeFanout &operator=(const FxEncodeFanout &) = delete;
+
+    /** Start an encoder on its own thread; returns its lane id. */
+    int addLane(const FxEncoder::Settings &settings);
+    /** Stop and remove a lane; its queued blocks are released. */
+    void removeLane(int id);
+    void clear();
+    /** Reopen the lane's encoder (see Output::restartOffset). */
+    void restartLane(int id);
+    int laneCount() const { return static_cast<int>(m_lanes.size()); }
+
+    /** Queue interleaved frames for every lane. */
+    void push(const float *interleaved, size_t frames);
+    /** Move the lane's encoded output into out; false for an unknown lane. */
+    bool takeOutput(int id, Output &out);
+    LaneStats laneStats(int id) const;
+
+    const FxBlockPool &pool() const { return m_pool; }
+
+private:
+    struct Lane;
+    Lane *lane(int id) const;
+
+    const int m_channels;
+    const int m_sampleRate;
+    EncoderFactory m_encoderFactory;
+    FxBlockPool m_pool;
+    std::vector<std::unique_ptr<Lane>> m_lanes;
+    int m_nextId = 1;
+};
+
+#endif // FXENCODEFANOUT_H
@@ -0,0 +1,134 @@
+#include "FxEncoder.h"
+
+#ifdef XFB_HAVE_LIBAV
+#include "LibavEncoder.h"
+#endif
+
+#include <QCoreApplication>
+#include <QDebug>
+#include <QProcess>
+
+std::unique_ptr<FxEncoder> FxEncoder::open(const Settings &settings, const QString &ffmpeg,
+                                           QString *error)
+{
+#ifdef XFB_HAVE_LIBAV
+    QString avError;
+    if (auto enc = LibavEncoder::open(settings, &avError))
+        return enc;
+    qDebug() << "FxEncoder: libav cannot encode" << codecName(settings.codec) << avError
+             << "- falling back to ffmpeg";
+#endif
+    if (ffmpeg.isEmpty()) {
+        if (error)
+            *error = QCoreApplication::translate("FxEncoder", "ffmpeg not found — cannot encode the stream");
+        return nullptr;
+    }
+    return ProcessEncoder::start(ffmpeg, settings, error);
+}
+
+// ------------------------------------------------------------ ProcessEncoder
+
+ProcessEncoder::ProcessEncoder(QProcess *proc, const Settings &settings)
+    : m_proc(proc)
+    , m_settings(settings)
+{
+}
+
+ProcessEncoder::~ProcessEncoder()
+{
+    // Reaped right here, unlike ProcessDecoder: each encoder has a thread of
+    // its own (FxEncodeFanout), which may quit before a deferred reap ran.
+    // Waiting for a killed ffmpeg stalls only this encoder.
+    m_proc->disconnect();
+    if (m_proc->state() != QProcess::NotRunning) {
+        m_proc->kill();
+        m_proc->waitForFinished(1000);
+    }
+    delete m_proc;
+}
+
+std::unique_ptr<ProcessEncoder> ProcessEncoder::start(const QString &ffmpeg, const Settings &settings,
+                                                      QString *error)
+{
+    QStringList args;
+    args << "-hide_banner" << "-loglevel" << "error"
+         << "-f" << "f32le"
+         << "-ar" << QString::number(settings.sampleRate)
+         << "-ac" << QString::number(settings.channels)
+         << "-i" << "pipe:0";
+    switch (settings.codec) {
+    case Codec::Opus:
+        args << "-c:a" << "libopus" << "-f" << "ogg";
+        break;
+    case Codec::Mp3:
+        // No ID3 tag or Xing header: listeners join mid-stream anyway
+        args << "-c:a" << "libmp3lame" << "-write_xing" << "0" << "-id3v2_version" << "0"
+             << "-f" << "mp3";
+        break;
+    case Codec::Aac:
+        args << "-c:a" << "aac" << "-f" << "adts";
+        break;
+    }
+    args << "-b:a" << QStringLiteral("%1k").arg(settings.bitrateKbps)
+         << "-flush_packets" << "1" << "pipe:1";
+
+    auto *proc = new QProcess;
+    proc->start(ffmpeg, args);
+    if (!proc->waitForStarted(3000)) {
+        if (error)
+            *error = proc->errorString();
+        proc->deleteLater();
+        return nullptr;
+    }
+    return std::unique_ptr<ProcessEncoder>(new ProcessEncoder(proc, settings));
+}
+
+size_t ProcessEncoder::write(const float *interleaved, size_t frames)
+{
+    if (m_finished || m_proc->state() != QProcess::Running)
+        return 0;
+    const qint64 bytesPerFrame = qint64(sizeof(float)) * m_settings.channels;
+    const qint64 maxQueued = qint64(m_settings.sampleRate) * kMaxQueuedSeconds * bytesPerFrame;
+    if (m_proc->bytesToWrite() > maxQueued)
+        return 0; // ffmpeg is not keeping up: refuse rather than buffer without bound
+    m_proc->write(reinterpret_cast<const char *>(interleaved),
+                  static_cast<qint64>(frames) * bytesPerFrame);
+    return frames;
+}
+
+qint64 ProcessEncoder::takeEncoded(QByteArray &out)
+{
+    const QByteArray bytes = m_proc->readAllStandardOutput();
+    out += bytes;
+    return bytes.size();
+}
+
+void ProcessEncoder::finish()
+{
+    if (m_finished || m_proc->state() != QProcess::Running)
+        return;
+    m_finished = true;
+    // EOF on stdin: ffmpeg drains, writes the trailer and exits; its output
+    // stays readable after that
+    m_proc->closeWriteChannel();
+    if (!m_proc->waitForFinished(10000))
+        qWarning() << "FxEncoder: ffmpeg did not finish the encode in time";
+}
+
+qint64 ProcessEncoder::queuedFrames() const
+{
+    return m_proc->bytesToWrite() / (qint64(sizeof(float)) * m_settings.channels);
+}
+
+bool ProcessEncoder::failed() const
+{
+    if (m_finished)
+        return m_proc->exitStatus() != QProcess::NormalExit || m_proc->exitCode() != 0;
+    return m_proc->state() == QProcess::NotRunning;
+}
+
+QString ProcessEncoder::errorString() const
+{
+    const QString err = QString::fromLocal8Bit(m_proc->readAllStandardError()).trimmed();
+    return err.isEmpty() ? m_proc->errorString() : err;
+}
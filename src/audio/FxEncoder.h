@@ -0,0 +1,138 @@
+#ifndef FXENCODER_H
+#define FXENCODER_H
+
+#include <QByteArray>
+#include <QString>
+#include <QtGlobal>
+
+#include <cstddef>
+#include <memory>
+
+class QProcess;
+
+/**
+ * @brief One running encode of 48 kHz stereo float into a streamable
+ * container (Ogg/Opus, MP3 or ADTS/AAC).
+ *
+ * The counterpart of FxDecoder for the stream source: libav in-process
+ * (LibavEncoder, when XFB is built with XFB_HAVE_LIBAV) or an `ffmpeg`
+ * child process (ProcessEncoder, always available). Output is a byte
+ * stream a listener can join at any point after the container header,
+ * which comes first. Not thread-safe: owned by one thread.
+ */
+class FxEncoder
+{
+public:
+    enum class Codec { Opus, Mp3, Aac };
+
+    struct Settings
+    {
+        Codec codec = Codec::Mp3;
+        int bitrateKbps = 128;
+        int sampleRate = 48000;
+        int channels = 2;
+    };
+
+    virtual ~FxEncoder() = default;
+
+    /**
+     * Queue interleaved frames for encoding. Returns the frames accepted:
+     * fewer than offered when the encoder is that far behind.
+     */
+    virtual size_t write(const float *interleaved, size_t frames) = 0;
+    /** Append encoded bytes produced so far to out; returns the bytes added. */
+    virtual qint64 takeEncoded(QByteArray &out) = 0;
+    /**
+     * End of input: encode what is queued and close the container, so the
+     * output is a complete file once takeEncoded() collected the rest. May
+     * block for a moment. Nothing can be written afterwards.
+     */
+    virtual void finish() = 0;
+    /** Frames accepted but not encoded yet (the encoder's share of the lag). */
+    virtual qint64 queuedFrames() const = 0;
+    /** The encode died; nothing more will come out. */
+    virtual bool failed() const = 0;
+    virtual QString errorString() const = 0;
+
+    /** MIME type of the stream, for Content-Type. */
+    static QString contentType(Codec codec)
+    {
+        switch (codec) {
+        case Codec::Opus: return QStringLiteral("audio/ogg");
+        case Codec::Aac: return QStringLiteral("audio/aac");
+        case Codec::Mp3: break;
+        }
+        return QStringLiteral("audio/mpeg");
+    }
+
+    /** "opus", "mp3", "aac" (the names used in xfb.conf). */
+    static QString codecName(Codec codec)
+    {
+        switch (codec) {
+        case Codec::Opus: return QStringLiteral("opus");
+        case Codec::Aac: return QStringLiteral("aac");
+        case Codec::Mp3: break;
+        }
+        return QStringLiteral("mp3");
+    }
+
+    static Codec codecFromName(const QString &name, Codec fallback = Codec::Mp3)
+    {
+        const QString n = name.trimmed().toLower();
+        if (n == QLatin1String("opus") || n == QLatin1String("ogg"))
+            return Codec::Opus;
+        if (n == QLatin1String("mp3"))
+            return Codec::Mp3;
+        if (n == QLatin1String("aac"))
+            return Codec::Aac;
+        return fallback;
+    }
+
+    /**
+     * MP3 and ADTS are runs of self-synchronising frames a listener can
+     * join anywhere; Ogg needs its header pages first.
+     */
+    static bool joinableMidStream(Codec codec) { return codec != Codec::Opus; }
+
+    /**
+     * Start an encoder: libav in-process when built with it, else the
+     * ffmpeg CLI at ffmpeg (FxEngine::ffmpegExecutable()). Null with error
+     * set on failure. Thread-safe.
+     */
+    static std::unique_ptr<FxEncoder> open(const Settings &settings, const QString &ffmpeg,
+                                           QString *error);
+};
+
+/**
+ * Encoder backed by an `ffmpeg -f f32le -i pipe:0 ... pipe:1` child
+ * process. Refuses frames once more than kMaxQueuedSeconds of PCM waits
+ * in its stdin. Destruction kills and reaps it.
+ */
+class ProcessEncoder : public FxEncoder
+{
+public:
+    static constexpr int kMaxQueuedSeconds = 2;
+
+    ~ProcessEncoder() override;
+
+    static std::unique_ptr<ProcessEncoder> start(const QString &ffmpeg, const Settings &settings,
+                                                 QString *error);
+
+    size_t write(const float *interleaved, size_t frames) override;
+    qint64 takeEncoded(QByteArray &out) override;
+    void finish() override;
+    qint64 queuedFrames() const override;
+    bool failed() const override;
+    QString errorString() const override;
+
+    QProcess *process() const { return m_proc; }
+
+private:
+    ProcessEncoder(QProcess *proc, const Settings &settings);
+
+    QProcess *m_proc;
+    Settings m_settings;
+    bool m_finished = false;
+};
+
+#endif // FXENCODER_H
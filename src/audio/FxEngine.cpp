@@ -1,17 +1,26 @@
 #include "FxEngine.h"
+#include "FxMixer.h"
+#include "FxStreamTap.h"
+
+#ifdef XFB_HAVE_LIBAV
+#include "LibavDecoder.h"
+#endif
 
 #include <QAudioSink>
 #include <QDebug>
 #include <QFile>
 #include <QFileInfo>
+#include <QFutureWatcher>
 #include <QIODevice>
 #include <QMediaDevices>
 #include <QProcess>
 #include <QRegularExpression>
 #include <QStandardPaths>
 #include <QTimer>
+#include <QtConcurrent>
 
 #include <algorithm>
+#include <cmath>
 #include <cstring>
 
 namespace
@@ -51,6 +60,17 @@ void parseProbeOutput(const QString &out, qint64 *durationMs, bool *is432)
             *durationMs = static_cast<qint64>(secs * 1000.0);
     }
 }
+
+#ifdef XFB_HAVE_LIBAV
+// LibavDecoder::probe() of a preload, run on a pool thread
+struct LibavProbe
+{
+    bool ok = false;
+    qint64 durationMs = 0;
+    bool is432 = false;
+};
+#endif
+
 } // namespace
 
 FxEngine::FxEngine(QObject *parent)
@@ -58,6 +78,10 @@ FxEngine::FxEngine(QObject *parent)
 {
     m_chunk.resize(kChunkFrames * kChannels);
     m_chunk16.resize(kChunkFrames * kChannels);
+    m_output = new FxOutput(kChannels, this);
+    m_fifo.reset(static_cast<size_t>(kFifoSeconds) * kSampleRate);
+    m_tailFifo.reset(static_cast<size_t>(kFifoSeconds) * kSampleRate);
+    m_history.reset(static_cast<size_t>(kHistorySeconds) * kSampleRate);
     m_djFilter.setup(kSampleRate);
     m_echo.setup(kSampleRate);
 
@@ -79,7 +103,7 @@ FxEngine::FxEngine(QObject *parent)
 
 FxEngine::~FxEngine()
 {
-    stopProcess();
+    stopDecoder();
     teardownSink();
 }
 
@@ -100,17 +124,32 @@ bool FxEngine::available()
     return !ffmpegExecutable().isEmpty();
 }
 
+fxdsp::GainEnvelope FxEngine::volumeEnvelope(const QVector<QPointF> &points)
+{
+    std::vector<fxdsp::GainEnvelope::Point> frames;
+    frames.reserve(static_cast<size_t>(points.size()));
+    for (const QPointF &p : points)
+        frames.push_back({static_cast<int64_t>(std::llround(p.x() * kSampleRate / 1000.0)), p.y()});
+    fxdsp::GainEnvelope envelope;
+    envelope.setPoints(std::move(frames));
+    return envelope;
+}
+
 // ------------------------------------------------------------------ transport
 
-void FxEngine::setSource(const QString &pathOrUrl)
+void FxEngine::setSource(const QString &pathOrUrl, const TrackAnalysis &analysis,
+                         const TrackCue &cue)
 {
     // Gapless handoff: the upcoming track was preloaded and its decoder is
     // already running — adopt it instead of cold-starting a new one. A
     // short track's decoder may have exited already with all of its PCM
     // still buffered, which is just as usable.
-    if (!pathOrUrl.isEmpty() && pathOrUrl == m_nextPath && m_nextProc
-            && (m_nextProc->state() == QProcess::Running
-                || m_nextProc->bytesAvailable() > 0)) {
+    if (!pathOrUrl.isEmpty() && pathOrUrl == m_nextPath && m_nextDecoder
+            && !m_nextDecoder->exhausted()) {
+        // Measured while it was preloading: the gain can still use it, the
+        // running decoder keeps the cue it was spawned with
+        if (analysis.ready() && !m_nextAnalysis.ready())
+            m_nextAnalysis = analysis;
         adoptPreloaded();
         return;
     }
@@ -118,6 +157,9 @@ void FxEngine::setSource(const QString &pathOrUrl)
     cancelPreload();
     stop();
     m_path = pathOrUrl;
+    takePendingEnvelope();
+    m_analysis = analysis;
+    m_cue = cue;
     m_durationMs = 0;
     m_sourceIs432 = false;
     m_isLive = m_path.startsWith(QStringLiteral("http://"), Qt::CaseInsensitive)
@@ -134,6 +176,7 @@ void FxEngine::setSource(const QString &pathOrUrl)
     }
 
     probeLocalSource(m_path);
+    applyTrackGain();
     emit durationChanged(m_durationMs);
 }
 
@@ -149,13 +192,12 @@ void FxEngine::play()
         return;
     }
 
-    if (m_procPreloaded && startAt == 0 && m_proc
-            && m_proc->state() == QProcess::Running) {
-        // Adopted preloaded decoder: already decoding from position 0
-        m_procPreloaded = false;
+    if (m_decoderPreloaded && startAt == 0 && m_decoder && m_decoder->running()) {
+        // Adopted preloaded decoder: already decoding from the cue
+        m_decoderPreloaded = false;
     } else {
         startProcessAt(startAt);
-        if (!m_proc)
+        if (!m_decoder)
             return; // failTrack already emitted
     }
 
@@ -163,10 +205,15 @@ void FxEngine::play()
 
     if (!m_pumpTimer) {
         m_pumpTimer = new QTimer(this);
-        m_pumpTimer->setInterval(15);
+        m_pumpTimer->setTimerType(Qt::PreciseTimer);
         connect(m_pumpTimer, &QTimer::timeout, this, &FxEngine::pump);
     }
+    m_pumpTimer->setInterval(pumpIntervalMs());
     m_pumpTimer->start();
+    // Emission rates are wall-clock based: the pump interval follows the
+    // configured latency
+    m_positionClock.start();
+    m_meterClock.start();
 }
 
 void FxEngine::pause()
@@ -182,30 +229,20 @@ void FxEngine::pause()
         m_scratchBuf.clear();
         if (m_pumpTimer)
             m_pumpTimer->stop();
-        if (m_sink)
-            m_sink->reset();
-        m_io = nullptr;
+        resetSinkStream();
         m_state = State::Paused;
         return;
     }
 
     // Position the resume point at what the listener actually heard:
     // subtract audio still queued in the sink from the decode position.
-    qint64 bufferedMs = 0;
-    if (m_sink && m_io) {
-        const int bytesPerFrame = m_sinkIsFloat ? 8 : 4;
-        const qint64 bufferedBytes = m_sink->bufferSize() - m_sink->bytesFree();
-        bufferedMs = (bufferedBytes / bytesPerFrame) * 1000 / kSampleRate;
-    }
-    m_pausedPosMs = std::max<qint64>(0, currentPositionMs() - bufferedMs);
+    m_pausedPosMs = std::max<qint64>(0, currentPositionMs() - queuedOutputMs());
 
     stopTailMix(); // pausing mid-crossfade drops the fading tail
-    stopProcess();
+    stopDecoder();
     if (m_pumpTimer)
         m_pumpTimer->stop();
-    if (m_sink)
-        m_sink->reset();
-    m_io = nullptr;
+    resetSinkStream();
     m_state = State::Paused;
 }
 
@@ -213,8 +250,8 @@ void FxEngine::stop()
 {
     cancelPreload();
     stopTailMix();
-    stopProcess();
-    m_procPreloaded = false;
+    stopDecoder();
+    m_decoderPreloaded = false;
     m_finishEmitted = false;
     m_nextCrossfadeMs = 0;
     m_scratchActive = false;
@@ -223,9 +260,7 @@ void FxEngine::stop()
     m_history.clear();
     if (m_pumpTimer)
         m_pumpTimer->stop();
-    if (m_sink)
-        m_sink->reset();
-    m_io = nullptr;
+    resetSinkStream();
     m_state = State::Stopped;
     m_baseMs = 0;
     m_framesTaken = 0;
@@ -247,13 +282,11 @@ void FxEngine::seek(qint64 positionMs)
         positionMs = std::min(positionMs, m_durationMs);
 
     if (m_state == State::Playing) {
-        stopProcess();
-        if (m_sink)
-            m_sink->reset();
-        m_io = nullptr;
+        stopDecoder();
+        resetSinkStream();
         startProcessAt(positionMs);
-        if (m_proc && m_sink)
-            m_io = m_sink->start();
+        if (m_decoder && hasOutput())
+            startSinkStream();
     } else {
         m_pausedPosMs = positionMs;
         m_baseMs = positionMs;
@@ -266,10 +299,40 @@ void FxEngine::seek(qint64 positionMs)
 void FxEngine::setVolume(float linearVolume)
 {
     m_volume = std::clamp(linearVolume, 0.0f, 1.0f);
+    m_output->setGain(m_volume); // applied by the mix bus, when mixing
     if (m_sink)
         m_sink->setVolume(m_volume);
 }
 
+void FxEngine::setVolumeEnvelope(const QString &path, const fxdsp::GainEnvelope &envelope)
+{
+    if (!path.isEmpty() && path == m_path) {
+        m_envelope = envelope; // live edit, or sent right after setSource()
+        applyTrackGain();
+    } else {
+        m_pendingEnvelope = envelope;
+        m_pendingEnvelopePath = path;
+    }
+}
+
+void FxEngine::takePendingEnvelope()
+{
+    if (!m_path.isEmpty() && m_path == m_pendingEnvelopePath)
+        m_envelope = std::move(m_pendingEnvelope);
+    else
+        m_envelope.clear();
+    m_pendingEnvelope.clear();
+    m_pendingEnvelopePath.clear();
+}
+
+void FxEngine::applyTrackGain()
+{
+    const double gainDb = m_params.normalize
+                              ? m_analysis.normalizationGainDb(m_params.normalizeTargetLufs)
+                              : 0.0;
+    m_envelope.setTrim(std::pow(10.0, gainDb / 20.0));
+}
+
 void FxEngine::setParams(const FxParams &params)
 {
     // A preloaded decoder was spawned with the previous filter chain; a
@@ -280,6 +343,7 @@ void FxEngine::setParams(const FxParams &params)
     m_params = params;
     m_eq.configure(kSampleRate, m_params);
     m_comp.configure(kSampleRate, m_params);
+    applyTrackGain();
 
     // The retune runs inside the ffmpeg filter chain, so toggling it live
     // requires a decoder restart at the current position. Sources that are
@@ -290,13 +354,11 @@ void FxEngine::setParams(const FxParams &params)
         m_retuneOn = m_params.retune432;
         if (m_state == State::Playing && effectiveBefore != effectiveAfter) {
             const qint64 pos = currentPositionMs();
-            stopProcess();
-            if (m_sink)
-                m_sink->reset();
-            m_io = nullptr;
+            stopDecoder();
+            resetSinkStream();
             startProcessAt(pos);
-            if (m_proc && m_sink)
-                m_io = m_sink->start();
+            if (m_decoder && hasOutput())
+                startSinkStream();
         }
     }
 }
@@ -309,10 +371,40 @@ void FxEngine::shutdown()
 
 // ------------------------------------------------------------------- internals
 
-QProcess *FxEngine::spawnDecoder(const QString &path, qint64 positionMs,
-                                 bool retune, bool isLive, bool waitForStart,
-                                 QString *error)
+std::unique_ptr<FxDecoder> FxEngine::spawnDecoder(const QString &path, qint64 positionMs,
+                                                  bool retune, bool isLive,
+                                                  bool waitForStart, QString *error)
 {
+    DecodeRequest request;
+    request.path = path;
+    request.positionMs = positionMs;
+    request.retune = retune;
+    request.isLive = isLive;
+    request.waitForStart = waitForStart;
+    return openDecoder(request, this, error);
+}
+
+std::unique_ptr<FxDecoder> FxEngine::openDecoder(const DecodeRequest &request, QObject *owner,
+                                                 QString *error)
+{
+    const QString &path = request.path;
+    const qint64 positionMs = request.positionMs;
+    const bool retune = request.retune;
+    const bool isLive = request.isLive;
+
+#ifdef XFB_HAVE_LIBAV
+    // In-process first: no fork/exec, no pipe copies, sample-accurate seek.
+    // Live streams (network reads would block the pump) and the retune
+    // (needs ffmpeg's filter chain) stay on the CLI path.
+    if (!isLive && !retune) {
+        QString avError;
+        if (auto dec = LibavDecoder::open(path, positionMs, kSampleRate, kChannels, &avError))
+            return dec;
+        qDebug() << "FxEngine: libav cannot decode" << path << avError
+                 << "- falling back to ffmpeg";
+    }
+#endif
+
     const QString ffmpeg = ffmpegExecutable();
     if (ffmpeg.isEmpty()) {
         if (error)
@@ -333,7 +425,7 @@ QProcess *FxEngine::spawnDecoder(const QString &path, qint64 positionMs,
         args << "-reconnect" << "1"
              << "-reconnect_streamed" << "1"
              << "-reconnect_delay_max" << "5";
-    } else {
+    } else if (request.realtime) {
         args << "-re"; // decode paced at realtime: keeps process buffering bounded
         // Plain -re leaves the pipeline (and so the sink) only as full as
         // ffmpeg's small startup burst, so scheduling hiccups and track
@@ -349,9 +441,9 @@ QProcess *FxEngine::spawnDecoder(const QString &path, qint64 positionMs,
         // to chop long encoded outro silences (YouTube rips) off the fifo.
         if (haveInitialBurst)
             args << "-readrate_initial_burst" << "12";
-        if (positionMs > 0)
-            args << "-ss" << QString::number(positionMs / 1000.0, 'f', 3);
     }
+    if (!isLive && positionMs > 0)
+        args << "-ss" << QString::number(positionMs / 1000.0, 'f', 3);
     args << "-i" << path
          << "-vn" << "-sn" << "-dn";
     if (retune) {
@@ -376,34 +468,39 @@ QProcess *FxEngine::spawnDecoder(const QString &path, qint64 positionMs,
          << "-ar" << QString::number(kSampleRate)
          << "-";
 
-    QProcess *proc = new QProcess(this);
+    QProcess *proc = new QProcess(owner);
     proc->setReadChannel(QProcess::StandardOutput);
     proc->start(ffmpeg, args);
-    if (waitForStart && !proc->waitForStarted(3000)) {
+    if (request.waitForStart && !proc->waitForStarted(3000)) {
         if (error)
             *error = tr("ffmpeg did not start (FX playback)");
         proc->kill();
         proc->deleteLater();
         return nullptr;
     }
-    return proc;
+    return std::make_unique<ProcessDecoder>(proc);
 }
 
 void FxEngine::startProcessAt(qint64 positionMs)
 {
-    stopProcess();
+    stopDecoder();
     stopTailMix(); // a timeline jump ends any crossfade still fading
-    m_procPreloaded = false;
+    m_decoderPreloaded = false;
 
-    m_baseMs = m_isLive ? 0 : positionMs;
-    m_framesTaken = 0;
-    m_partialFrame.clear();
-    m_fifo.clear();
     // Auto-cue: skip encoded leading silence only when the track starts
     // from the top (a user seek must land exactly where asked), and trim
-    // the encoded trailing silence for any local decode.
+    // the encoded trailing silence for any local decode. When the track's
+    // cue knows where the audio starts, the decode begins right there
+    // instead of scanning its way through the silence.
     m_leadSkipped = m_isLive || positionMs > 0;
-    m_tailTrimmed = m_isLive;
+    if (!m_leadSkipped && m_cue.startKnown) {
+        positionMs = m_cue.startMs;
+        m_leadSkipped = true;
+    }
+    m_tailTrimmed = m_isLive || m_cue.endKnown();
+    m_baseMs = m_isLive ? 0 : positionMs;
+    m_framesTaken = 0;
+    m_fifo.clear();
     // The timeline jumps: played-audio history and any scratch in progress
     // are no longer valid.
     m_history.clear();
@@ -412,31 +509,23 @@ void FxEngine::startProcessAt(qint64 positionMs)
     resetDspState();
 
     QString error;
-    m_proc = spawnDecoder(m_path, positionMs, m_retuneOn && !m_sourceIs432,
-                          m_isLive, /*waitForStart*/ true, &error);
-    if (!m_proc)
+    m_decoder = spawnDecoder(m_path, positionMs, m_retuneOn && !m_sourceIs432,
+                             m_isLive, /*waitForStart*/ true, &error);
+    if (!m_decoder)
         failTrack(error);
 }
 
-void FxEngine::stopProcess()
+void FxEngine::stopDecoder()
 {
-    if (!m_proc)
-        return;
-    QProcess *proc = m_proc;
-    m_proc = nullptr;
-    proc->disconnect(this);
-    if (proc->state() != QProcess::NotRunning) {
-        proc->kill();
-        proc->waitForFinished(1000);
-    }
-    proc->deleteLater();
+    m_decoder.reset(); // a process decoder is killed and reaped asynchronously
 }
 
 // ------------------------------------------------------------ gapless preload
 
-void FxEngine::preloadNext(const QString &path)
+void FxEngine::preloadNext(const QString &path, const TrackAnalysis &analysis,
+                           const TrackCue &cue)
 {
-    if (!path.isEmpty() && path == m_nextPath && (m_nextProc || m_nextProbe))
+    if (!path.isEmpty() && path == m_nextPath && (m_nextDecoder || m_nextProbe || m_nextLibavProbe))
         return; // this track is already being preloaded
 
     cancelPreload();
@@ -446,9 +535,46 @@ void FxEngine::preloadNext(const QString &path)
 
     m_nextPath = path;
     m_nextDurationMs = 0;
+    m_nextAnalysis = analysis;
+    m_nextCue = cue;
     m_nextIs432 = QFileInfo(path).completeBaseName()
                       .endsWith(QStringLiteral("_432Hz"));
 
+#ifdef XFB_HAVE_LIBAV
+    // An in-process probe only reads the file's header and spares the
+    // ffprobe process, but even that read can wait on a slow or sleeping
+    // disk: it runs on a pool thread and the decoder spawns once it is in.
+    auto *watcher = new QFutureWatcher<LibavProbe>(this);
+    m_nextLibavProbe = watcher;
+    connect(watcher, &QFutureWatcher<LibavProbe>::finished, this, [this, watcher, path]() {
+        watcher->deleteLater();
+        if (watcher != m_nextLibavProbe || path != m_nextPath)
+            return; // canceled or superseded meanwhile
+        m_nextLibavProbe = nullptr;
+        const LibavProbe probe = watcher->result();
+        if (!probe.ok) {
+            probeNextWithFfprobe();
+            return;
+        }
+        m_nextDurationMs = probe.durationMs;
+        m_nextIs432 = probe.is432;
+        spawnPreloadDecoder();
+    });
+    const bool nameIs432 = m_nextIs432;
+    watcher->setFuture(QtConcurrent::run([path, nameIs432]() {
+        LibavProbe probe;
+        probe.is432 = nameIs432;
+        probe.ok = LibavDecoder::probe(path, &probe.durationMs, &probe.is432);
+        return probe;
+    }));
+#else
+    probeNextWithFfprobe();
+#endif
+}
+
+void FxEngine::probeNextWithFfprobe()
+{
+    const QString path = m_nextPath;
     const QString ffprobe = ffprobeExecutable();
     if (ffprobe.isEmpty()) {
         spawnPreloadDecoder(); // no duration metadata, but still gapless
@@ -503,36 +629,34 @@ void FxEngine::cancelPreload()
     m_nextProbe = nullptr;
     reap(probe);
 
-    QProcess *proc = m_nextProc;
-    m_nextProc = nullptr;
-    reap(proc);
+    // A pool-thread probe cannot be interrupted: let it finish unheard
+    if (m_nextLibavProbe) {
+        m_nextLibavProbe->disconnect(this);
+        m_nextLibavProbe->deleteLater();
+        m_nextLibavProbe = nullptr;
+    }
+
+    m_nextDecoder.reset();
 }
 
 void FxEngine::spawnPreloadDecoder()
 {
-    if (m_nextPath.isEmpty() || m_nextProc)
+    if (m_nextPath.isEmpty() || m_nextDecoder)
         return;
     QString error;
     const bool retune = m_params.retune432 && !m_nextIs432;
     // No waitForStarted here: the current track is still playing and a
-    // blocked engine thread would starve the pump (audible dropout).
-    m_nextProc = spawnDecoder(m_nextPath, 0, retune, false,
-                              /*waitForStart*/ false, &error);
-    if (!m_nextProc) {
+    // blocked engine thread would starve the pump (audible dropout). The
+    // decode opens at the cue, as a cold start of the track would.
+    m_nextDecoder = spawnDecoder(m_nextPath, m_nextCue.startMs, retune, false,
+                                 /*waitForStart*/ false, &error);
+    if (!m_nextDecoder) {
         qWarning() << "FxEngine: gapless preload failed:" << error;
         m_nextPath.clear(); // setSource() will fall back to a cold start
         return;
     }
-    QProcess *proc = m_nextProc;
-    connect(proc, &QProcess::errorOccurred, this,
-            [this, proc](QProcess::ProcessError err) {
-        if (err == QProcess::FailedToStart && proc == m_nextProc) {
-            qWarning() << "FxEngine: preload ffmpeg failed to start";
-            m_nextProc = nullptr;
-            m_nextPath.clear();
-            proc->deleteLater();
-        }
-    });
+    // A preload ffmpeg that fails to start simply stays exhausted():
+    // setSource() then takes the cold-start path.
     qDebug() << "FxEngine: preload decoder ready for" << m_nextPath;
 }
 
@@ -546,44 +670,44 @@ void FxEngine::adoptPreloaded()
     // the tail mix and fades out inside the same stream — no cut either.
     const bool crossfade = !seamless && m_state == State::Playing
                            && m_nextCrossfadeMs > 0 && !m_scratchActive
-                           && (m_proc || !m_fifo.empty());
+                           && (m_decoder || !m_fifo.isEmpty());
     qDebug() << "FxEngine: adopting preloaded decoder for" << m_nextPath
              << "seamless=" << seamless << "crossfade=" << crossfade
              << "state=" << int(m_state);
 
     if (crossfade) {
         stopTailMix();
-        m_tailProc = m_proc; // keeps decoding; drained by mixTail()
-        m_proc = nullptr;
-        if (m_tailProc)
-            m_tailProc->disconnect(this);
-        m_tailPartial = m_partialFrame;
-        m_tailFifo = std::move(m_fifo);
-        m_fifo = std::vector<float>();
+        m_tailDecoder = std::move(m_decoder); // keeps decoding; drained by mixTail()
+        m_tailFifo.swap(m_fifo); // hand the buffered PCM over, no copy
         m_tailGain = 1.0;
         m_tailGainStep = 1000.0 / (double(qMax(qint64(200), m_nextCrossfadeMs))
                                    * kSampleRate);
+        // The outgoing volume line keeps shaping the tail under the fade
+        m_tailEnvelope = m_envelope;
+        m_tailFrame = inputFramePosition();
     } else {
-        stopProcess(); // the old decoder (already exited after a natural end)
+        stopDecoder(); // the old decoder (already exited after a natural end)
         if (!seamless) {
             // Mid-play cut (manual skip) or engine already stopped: the
             // sink content belongs to the old track — start a clean stream.
-            if (m_sink)
-                m_sink->reset();
-            m_io = (m_state == State::Playing && m_sink) ? m_sink->start() : nullptr;
+            resetSinkStream();
+            if (m_state == State::Playing && hasOutput())
+                startSinkStream();
         }
     }
     m_nextCrossfadeMs = 0;
 
-    m_proc = m_nextProc;
-    m_nextProc = nullptr;
+    m_decoder = std::move(m_nextDecoder);
     m_path = m_nextPath;
     m_nextPath.clear();
+    takePendingEnvelope();
+    m_analysis = m_nextAnalysis;
+    m_cue = m_nextCue; // the decoder was spawned at its start
+    applyTrackGain();
     m_durationMs = m_nextDurationMs;
     m_sourceIs432 = m_nextIs432;
     m_isLive = false;
 
-    m_partialFrame.clear();
     m_fifo.clear();
     m_history.clear();
     m_scratchActive = false;
@@ -597,24 +721,32 @@ void FxEngine::adoptPreloaded()
         resetDspState();
     }
 
-    m_baseMs = 0;
+    m_baseMs = m_cue.startMs;
     m_framesTaken = 0;
     m_pausedPosMs = 0;
     m_producedAudio = false;
     m_finishEmitted = false;
-    m_procPreloaded = true; // play() must not respawn the decoder
+    m_decoderPreloaded = true; // play() must not respawn the decoder
 
-    // Auto-cue the adopted track. During a crossfade the chunk-drop skip
-    // would discard mixed tail audio, and the overlap was computed from
-    // the real waveform anyway — so only non-crossfade starts skip.
-    m_leadSkipped = crossfade;
-    m_tailTrimmed = false;
+    // Auto-cue the adopted track. A known cue already placed its decoder
+    // past the leading silence. Otherwise only non-crossfade starts scan:
+    // during a crossfade the chunk-drop skip would discard mixed tail
+    // audio, and the overlap was computed from the real waveform anyway.
+    m_leadSkipped = crossfade || m_cue.startKnown;
+    m_tailTrimmed = m_cue.endKnown();
 
     emit durationChanged(m_durationMs);
 }
 
 bool FxEngine::ensureSink()
 {
+    // Mixed output: the shared bus owns the device, joining it is all
+    if (m_mixer) {
+        if (!m_io)
+            startSinkStream();
+        return m_io != nullptr;
+    }
+
     // A sink opened on a device that is no longer the default is stale:
     // rebuild on the current default instead of writing into the void.
     if (m_sink) {
@@ -643,13 +775,16 @@ bool FxEngine::ensureSink()
 
         m_sink = new QAudioSink(device, fmt, this);
         m_sinkDeviceId = device.id();
+        // The latency budget is split between the device buffer and the
+        // render-ahead ring the sink pulls from
         const int bytesPerFrame = m_sinkIsFloat ? 8 : 4;
-        m_sink->setBufferSize(kSampleRate * bytesPerFrame * 350 / 1000); // ~350 ms
+        m_sink->setBufferSize(sinkBufferFrames() * bytesPerFrame);
+        configureOutputRing();
     }
 
     m_sink->setVolume(m_volume);
     if (!m_io)
-        m_io = m_sink->start();
+        startSinkStream();
     return m_io != nullptr;
 }
 
@@ -660,12 +795,141 @@ void FxEngine::teardownSink()
         delete m_sink;
         m_sink = nullptr;
     }
+    if (m_mixer)
+        m_mixer->detach(m_output);
     m_io = nullptr;
+    m_output->clear();
     m_sinkDeviceId.clear();
 }
 
+bool FxEngine::startSinkStream()
+{
+    // Pull mode: from here on the sink's (or the mix bus's) audio thread
+    // reads m_output
+    m_output->clear();
+    if (m_mixer) {
+        m_io = m_mixer->attach(m_output) ? m_output : nullptr;
+        return m_io != nullptr;
+    }
+    m_sink->start(m_output);
+    m_io = (m_sink->error() == QAudio::NoError) ? m_output : nullptr;
+    return m_io != nullptr;
+}
+
+void FxEngine::resetSinkStream()
+{
+    // Both stop the pulls before the ring is emptied
+    if (m_mixer)
+        m_mixer->detach(m_output);
+    else if (m_sink)
+        m_sink->reset();
+    m_io = nullptr;
+    m_output->clear();
+}
+
+void FxEngine::configureOutputRing()
+{
+    // Headroom beyond the fill target, so a late pump can catch up in one
+    // go; the bus always mixes float
+    m_output->configure(static_cast<size_t>(renderAheadFrames()) * 4,
+                        m_mixer ? true : m_sinkIsFloat);
+}
+
+void FxEngine::setMixer(FxMixBus *bus)
+{
+    if (bus == m_mixer)
+        return;
+    const bool wasActive = (m_state == State::Playing && m_io);
+    resetSinkStream();
+    teardownSink();
+    m_mixer = bus;
+    if (m_mixer)
+        configureOutputRing(); // a private sink configures it when opened
+    if (wasActive && !ensureSink())
+        failTrack(tr("No usable audio output device for the FX engine"));
+}
+
+void FxEngine::setStreamTap(FxStreamTap *tap)
+{
+    m_streamTap = tap;
+}
+
+int FxEngine::sinkBufferFrames() const
+{
+    if (m_mixer)
+        return m_mixer->deviceBufferFrames();
+    return std::max(kSampleRate * m_latencyMs.load(std::memory_order_relaxed) / 2000, 64);
+}
+
+int FxEngine::renderAheadFrames() const
+{
+    return std::max(kSampleRate * m_latencyMs.load(std::memory_order_relaxed) / 1000 - sinkBufferFrames(),
+                    64);
+}
+
+qint64 FxEngine::queuedOutputMs() const
+{
+    if (!m_io)
+        return 0;
+    // Rendered but unheard: the ring plus the (always topped-up) device buffer
+    const qint64 frames = static_cast<qint64>(m_output->bufferedFrames()) + sinkBufferFrames();
+    return frames * 1000 / kSampleRate;
+}
+
+int FxEngine::outputFramesWanted() const
+{
+    const int queued = static_cast<int>(m_output->bufferedFrames());
+    return std::min(kChunkFrames, renderAheadFrames() - queued);
+}
+
+void FxEngine::setOutputLatency(int latencyMs)
+{
+    latencyMs = std::clamp(latencyMs, kMinLatencyMs, kMaxLatencyMs);
+    if (latencyMs == m_latencyMs.load(std::memory_order_relaxed))
+        return;
+    m_latencyMs.store(latencyMs, std::memory_order_relaxed);
+    qDebug() << "FxEngine: output latency" << latencyMs << "ms";
+    if (m_pumpTimer)
+        m_pumpTimer->setInterval(pumpIntervalMs());
+    // Buffer sizes are fixed once a sink is open: reopen it (a short gap
+    // when this happens mid-track)
+    if (m_sink) {
+        rebuildSink();
+    } else if (m_mixer) {
+        const bool wasActive = (m_state == State::Playing && m_io);
+        resetSinkStream();
+        configureOutputRing();
+        if (wasActive)
+            startSinkStream();
+    }
+}
+
+int FxEngine::pumpIntervalMs() const
+{
+    // Several pumps per render-ahead window, so one late wakeup never
+    // empties the ring
+    return std::clamp(m_latencyMs.load(std::memory_order_relaxed) / 4, 2, 15);
+}
+
+FxOutputStats FxEngine::outputStats() const
+{
+    FxOutputStats s = m_output->stats();
+    s.latencyMs = m_latencyMs.load(std::memory_order_relaxed);
+    return s;
+}
+
+void FxEngine::resetOutputStats()
+{
+    m_output->resetStats(); // reportUnderruns() notices the counter going back
+}
+
 void FxEngine::rebuildSink()
 {
+    if (m_mixer) {
+        // The device belongs to the shared bus
+        QMetaObject::invokeMethod(m_mixer, &FxMixBus::rebuildSink, Qt::QueuedConnection);
+        return;
+    }
     qDebug() << "FxEngine: rebuilding audio sink on request";
     const bool wasActive = (m_state == State::Playing && m_io);
     teardownSink();
@@ -686,10 +950,19 @@ void FxEngine::resetDspState()
 
 void FxEngine::probeLocalSource(const QString &filePath)
 {
-    m_durationMs = 0;
+    probeFile(filePath, &m_durationMs, &m_sourceIs432);
+}
+
+void FxEngine::probeFile(const QString &filePath, qint64 *durationMs, bool *is432)
+{
+    *durationMs = 0;
     // Copy-mode conversions carry the marker in the file name
-    m_sourceIs432 = QFileInfo(filePath).completeBaseName()
-                        .endsWith(QStringLiteral("_432Hz"));
+    *is432 = QFileInfo(filePath).completeBaseName().endsWith(QStringLiteral("_432Hz"));
+
+#ifdef XFB_HAVE_LIBAV
+    if (LibavDecoder::probe(filePath, durationMs, is432))
+        return;
+#endif
 
     const QString ffprobe = ffprobeExecutable();
     if (!ffprobe.isEmpty()) {
@@ -699,8 +972,8 @@ void FxEngine::probeLocalSource(const QString &filePath)
                               "-of", "default=noprint_wrappers=1", filePath});
         if (probe.waitForFinished(5000)) {
             parseProbeOutput(QString::fromLocal8Bit(probe.readAllStandardOutput()),
-                             &m_durationMs, &m_sourceIs432);
-            if (m_durationMs > 0)
+                             durationMs, is432);
+            if (*durationMs > 0)
                 return;
         } else {
             probe.kill();
@@ -717,7 +990,7 @@ void FxEngine::probeLocalSource(const QString &filePath)
             const QRegularExpression re(QStringLiteral("Duration:\\s*(\\d+):(\\d+):(\\d+)\\.(\\d+)"));
             const QRegularExpressionMatch m = re.match(err);
             if (m.hasMatch()) {
-                m_durationMs = m.captured(1).toLongLong() * 3600000
+                *durationMs = m.captured(1).toLongLong() * 3600000
                              + m.captured(2).toLongLong() * 60000
                              + m.captured(3).toLongLong() * 1000
                              + m.captured(4).toLongLong() * 10;
@@ -733,6 +1006,11 @@ qint64 FxEngine::inputFramesConsumed() const
     return m_framesTaken;
 }
 
+qint64 FxEngine::inputFramePosition() const
+{
+    return m_baseMs * kSampleRate / 1000 + inputFramesConsumed();
+}
+
 qint64 FxEngine::currentPositionMs() const
 {
     return m_baseMs + inputFramesConsumed() * 1000 / kSampleRate;
@@ -740,39 +1018,17 @@ qint64 FxEngine::currentPositionMs() const
 
 namespace
 {
-/** Move decoded PCM from a decoder process into a float FIFO, keeping
-    sub-frame leftovers in `partial` between reads. */
-void drainDecoder(QProcess *proc, QByteArray &partial, std::vector<float> &fifo)
+/** Move whatever the decoder has ready into its frame ring. */
+void drainDecoder(FxDecoder *decoder, FrameRing &fifo)
 {
-    if (!proc)
-        return;
-
-    QByteArray data = proc->readAllStandardOutput();
-    if (data.isEmpty())
-        return;
-
-    if (!partial.isEmpty()) {
-        data.prepend(partial);
-        partial.clear();
-    }
-
-    constexpr int bytesPerInFrame = sizeof(float) * 2; // kChannels
-    const int completeBytes = (data.size() / bytesPerInFrame) * bytesPerInFrame;
-    if (completeBytes < data.size()) {
-        partial = data.mid(completeBytes);
-        data.truncate(completeBytes);
-    }
-    if (data.isEmpty())
-        return;
-
-    const float *samples = reinterpret_cast<const float *>(data.constData());
-    fifo.insert(fifo.end(), samples, samples + completeBytes / sizeof(float));
+    if (decoder)
+        decoder->drainInto(fifo);
 }
 } // namespace
 
 void FxEngine::readProcessOutput()
 {
-    drainDecoder(m_proc, m_partialFrame, m_fifo);
+    drainDecoder(m_decoder.get(), m_fifo);
 }
 
 void FxEngine::setNextCrossfade(qint64 fadeMs)
@@ -782,63 +1038,52 @@ void FxEngine::setNextCrossfade(qint64 fadeMs)
 
 void FxEngine::mixTail(float *out, int frames)
 {
-    if (!m_tailProc && m_tailFifo.empty())
+    if (!m_tailDecoder && m_tailFifo.isEmpty())
         return;
 
-    drainDecoder(m_tailProc, m_tailPartial, m_tailFifo);
-
-    const int avail = static_cast<int>(m_tailFifo.size() / kChannels);
-    const int n = std::min(frames, avail);
-    for (int i = 0; i < n * kChannels; i += kChannels) {
-        const float g = static_cast<float>(m_tailGain);
-        out[i] += m_tailFifo[i] * g;
-        out[i + 1] += m_tailFifo[i + 1] * g;
-        m_tailGain = std::max(0.0, m_tailGain - m_tailGainStep);
+    drainDecoder(m_tailDecoder.get(), m_tailFifo);
+
+    // Mix straight out of the ring: no intermediate copy of the tail
+    FrameRing::Region regions[2];
+    const size_t n = m_tailFifo.peek(static_cast<size_t>(frames), regions[0], regions[1]);
+    float *dst = out;
+    for (const FrameRing::Region &r : regions) {
+        // In place: these frames are consumed by this very pass
+        m_tailEnvelope.apply(r.data, static_cast<int>(r.frames), m_tailFrame);
+        m_tailFrame += static_cast<qint64>(r.frames);
+        const size_t samples = r.frames * kChannels;
+        for (size_t i = 0; i < samples; i += kChannels) {
+            const float g = static_cast<float>(m_tailGain);
+            dst[i] += r.data[i] * g;
+            dst[i + 1] += r.data[i + 1] * g;
+            m_tailGain = std::max(0.0, m_tailGain - m_tailGainStep);
+        }
+        dst += samples;
     }
-    if (n > 0)
-        m_tailFifo.erase(m_tailFifo.begin(), m_tailFifo.begin() + n * kChannels);
+    m_tailFifo.commitRead(n);
 
-    const bool exhausted = m_tailFifo.empty()
-        && (!m_tailProc || m_tailProc->state() == QProcess::NotRunning)
-        && (!m_tailProc || m_tailProc->bytesAvailable() == 0);
+    const bool exhausted = m_tailFifo.isEmpty()
+        && (!m_tailDecoder || m_tailDecoder->exhausted());
     if (m_tailGain <= 0.0 || exhausted)
         stopTailMix();
 }
 
 void FxEngine::stopTailMix()
 {
-    if (m_tailProc) {
-        QProcess *proc = m_tailProc;
-        m_tailProc = nullptr;
-        proc->disconnect(this);
-        if (proc->state() != QProcess::NotRunning) {
-            connect(proc, &QProcess::finished, proc, &QObject::deleteLater);
-            proc->kill(); // async reap: never block the pump
-        } else {
-            proc->deleteLater();
-        }
-    }
-    m_tailPartial.clear();
+    m_tailDecoder.reset(); // async reap: never blocks the pump
     m_tailFifo.clear();
     m_tailGain = 0.0;
     m_tailGainStep = 0.0;
+    m_tailEnvelope.clear();
+    m_tailFrame = 0;
 }
 
 int FxEngine::fillChunk(float *out, int maxFrames)
 {
-    const int availFrames = static_cast<int>(m_fifo.size() / kChannels);
-    const int n = std::min(maxFrames, availFrames);
+    const int n = static_cast<int>(m_fifo.read(out, static_cast<size_t>(maxFrames)));
     if (n > 0) {
-        std::memcpy(out, m_fifo.data(), n * kChannels * sizeof(float));
-
         // Feed the scratch history with everything that gets played
-        m_history.insert(m_history.end(), m_fifo.begin(), m_fifo.begin() + n * kChannels);
-        const size_t maxHistory = static_cast<size_t>(kHistorySeconds) * kSampleRate * kChannels;
-        if (m_history.size() > maxHistory)
-            m_history.erase(m_history.begin(),
-                            m_history.begin() + (m_history.size() - maxHistory));
-
-        m_fifo.erase(m_fifo.begin(), m_fifo.begin() + n * kChannels);
+        m_history.writeOverwrite(out, static_cast<size_t>(n));
         m_framesTaken += n;
     }
     return n;
@@ -846,36 +1091,31 @@ int FxEngine::fillChunk(float *out, int maxFrames)
 
 void FxEngine::applyFxChain(float *chunk, int frames)
 {
-    m_eq.process(chunk, frames);
-    m_comp.process(chunk, frames);
+    // Clamping happens in the fused output pass of writeChunkToSink()
+    m_eq.processVectorized(chunk, frames);
+    m_comp.processBlockRate(chunk, frames);
     m_djFilter.process(chunk, frames);
     m_echo.process(chunk, frames);
-    fxdsp::clampBuffer(chunk, frames);
 }
 
-void FxEngine::writeChunkToSink(const float *chunk, int frames)
+void FxEngine::writeChunkToSink(float *chunk, int frames)
 {
-    // Feed the level meter from the final samples actually sent out
-    for (int i = 0; i < frames * kChannels; i += kChannels) {
-        m_meterPeakL = std::max(m_meterPeakL, std::abs(chunk[i]));
-        m_meterPeakR = std::max(m_meterPeakR, std::abs(chunk[i + 1]));
-    }
-
-    if (m_sinkIsFloat) {
-        m_io->write(reinterpret_cast<const char *>(chunk),
-                    static_cast<qint64>(frames) * kChannels * sizeof(float));
-    } else {
-        for (int i = 0; i < frames * kChannels; ++i)
-            m_chunk16[i] = static_cast<qint16>(chunk[i] * 32767.0f);
-        m_io->write(reinterpret_cast<const char *>(m_chunk16.data()),
-                    static_cast<qint64>(frames) * kChannels * sizeof(qint16));
-    }
+    // One pass clamps, feeds the level meter from the final samples and,
+    // for an Int16 sink, converts them; the sink then only copies
+    int16_t *s16 = m_output->sinkIsFloat() ? nullptr : m_chunk16.data();
+    fxdsp::finishOutput(chunk, frames, m_meterPeakL, m_meterPeakR, s16);
+    if (s16)
+        m_output->push(s16, static_cast<size_t>(frames));
+    else
+        m_output->push(chunk, static_cast<size_t>(frames));
+    if (m_streamTap)
+        m_streamTap->push(chunk, static_cast<size_t>(frames), m_volume);
     m_producedAudio = true;
 }
 
 void FxEngine::pump()
 {
-    if (m_state != State::Playing || !m_sink || !m_io)
+    if (m_state != State::Playing || !m_io)
         return;
 
     if (m_scratchActive) {
@@ -889,41 +1129,59 @@ void FxEngine::pump()
     // the encoded trailing silence off the fifo so the track finishes where
     // its audio does (YouTube rips carry seconds of outro silence, which a
     // gapless handoff would otherwise play in full).
-    if (!m_tailTrimmed && m_proc && m_proc->state() == QProcess::NotRunning
-            && m_proc->bytesAvailable() == 0) {
+    if (!m_tailTrimmed && m_decoder && m_decoder->exhausted()) {
         m_tailTrimmed = true;
-        size_t end = m_fifo.size();
-        while (end >= static_cast<size_t>(kChannels)
-               && std::abs(m_fifo[end - 1]) <= kSilenceFloor
-               && std::abs(m_fifo[end - 2]) <= kSilenceFloor) {
-            end -= kChannels;
+        const size_t avail = m_fifo.availableFrames();
+        size_t end = avail;
+        while (end > 0) {
+            const float *f = m_fifo.frame(end - 1);
+            if (std::abs(f[0]) > kSilenceFloor || std::abs(f[1]) > kSilenceFloor)
+                break;
+            --end;
         }
-        if (end < m_fifo.size()) {
+        if (end < avail) {
             qDebug() << "FxEngine: auto-cue trimmed"
-                     << (m_fifo.size() - end) / kChannels * 1000 / kSampleRate
+                     << (avail - end) * 1000 / kSampleRate
                      << "ms of trailing silence";
-            m_fifo.resize(end);
+            m_fifo.dropNewest(avail - end);
         }
     }
 
-    const int bytesPerOutFrame = m_sinkIsFloat ? 8 : 4;
-
+    QElapsedTimer renderTimer;
     while (true) {
-        const int freeFrames = static_cast<int>(m_sink->bytesFree()) / bytesPerOutFrame;
-        const int wantFrames = std::min(kChunkFrames, freeFrames);
+        const int wantFrames = outputFramesWanted();
         if (wantFrames <= 0)
             break;
 
-        const int got = fillChunk(m_chunk.data(), wantFrames);
+        renderTimer.start();
+        const qint64 chunkFrame = inputFramePosition();
+        // Cue, tail side: the track ends where its audio does, whatever
+        // silence the file still holds after that
+        int takeFrames = wantFrames;
+        if (m_cue.endMs > 0) {
+            const qint64 left = m_cue.endMs * kSampleRate / 1000 - chunkFrame;
+            if (left <= 0) {
+                if (m_decoder) {
+                    stopDecoder();
+                    m_fifo.clear();
+                }
+                maybeFinish();
+                break;
+            }
+            takeFrames = int(std::min<qint64>(takeFrames, left));
+        }
+        const int got = fillChunk(m_chunk.data(), takeFrames);
         if (got <= 0) {
             maybeFinish();
             break;
         }
-
         // Auto-cue, head side: drop whole-silent chunks until the first
-        // audible frame so the track starts where its audio does.
+        // audible frame so the track starts where its audio does. Judged
+        // on the decoded samples: a volume line that opens near zero must
+        // not make an audible intro read as silence.
+        int firstLoud = 0;
         if (!m_leadSkipped) {
-            int firstLoud = -1;
+            firstLoud = -1;
             for (int i = 0; i < got * kChannels; ++i) {
                 if (std::abs(m_chunk[i]) > kSilenceFloor) {
                     firstLoud = i / kChannels;
@@ -941,22 +1199,24 @@ void FxEngine::pump()
                              m_chunk.data() + firstLoud * kChannels,
                              (got - firstLoud) * kChannels * sizeof(float));
             }
-            const int audible = got - firstLoud;
-            mixTail(m_chunk.data(), audible);
-            applyFxChain(m_chunk.data(), audible);
-            writeChunkToSink(m_chunk.data(), audible);
-            continue;
         }
+        const int audible = got - firstLoud;
 
-        mixTail(m_chunk.data(), got); // fading crossfade tail, when active
-        applyFxChain(m_chunk.data(), got);
-        writeChunkToSink(m_chunk.data(), got);
+        // Volume line, sample-accurate on the input timeline. Ahead of the
+        // tail mix and the FX chain: it is this track's fader, and the
+        // chain processes the programme as a whole.
+        m_envelope.apply(m_chunk.data(), audible, chunkFrame + firstLoud);
+
+        mixTail(m_chunk.data(), audible); // fading crossfade tail, when active
+        applyFxChain(m_chunk.data(), audible);
+        writeChunkToSink(m_chunk.data(), audible);
+        m_output->recordRenderTime(renderTimer.nsecsElapsed());
     }
 
     // Level meter: emit the accumulated output peaks ~22 times per second,
     // scaled by the sink volume so the LEDs track what is actually audible.
-    if (++m_meterEmitDivider >= 3) {
-        m_meterEmitDivider = 0;
+    if (m_meterClock.elapsed() >= 45) {
+        m_meterClock.restart();
         emit levels(std::min(1.0f, m_meterPeakL * m_volume),
                     std::min(1.0f, m_meterPeakR * m_volume));
         m_meterPeakL = 0.0f;
@@ -964,45 +1224,51 @@ void FxEngine::pump()
     }
 
     // Emit the playback position roughly four times per second. Report the
-    // audible position: the decode position runs up to a full sink buffer
-    // (~350 ms) ahead of the speakers, which made the volume line, the
-    // crossfade trigger and the tail handoff all act early.
-    if (++m_positionEmitDivider >= 16) {
-        m_positionEmitDivider = 0;
-        qint64 bufferedMs = 0;
-        if (m_sink && m_io) {
-            const qint64 bufferedBytes = m_sink->bufferSize() - m_sink->bytesFree();
-            bufferedMs = (bufferedBytes / bytesPerOutFrame) * 1000 / kSampleRate;
-        }
-        emit positionChanged(std::max<qint64>(0, currentPositionMs() - bufferedMs));
+    // audible position: the decode position runs a full output latency
+    // ahead of the speakers, which made the volume line, the crossfade
+    // trigger and the tail handoff all act early.
+    if (m_positionClock.elapsed() >= 250) {
+        m_positionClock.restart();
+        emit positionChanged(std::max<qint64>(0, currentPositionMs() - queuedOutputMs()));
+        reportUnderruns();
     }
 }
 
+void FxEngine::reportUnderruns()
+{
+    const FxOutputStats s = m_output->stats();
+    if (s.underruns < m_reportedUnderruns)
+        m_reportedUnderruns = 0; // counters were reset meanwhile
+    if (s.underruns == m_reportedUnderruns)
+        return;
+    qWarning() << "FxEngine: output underrun," << s.underruns - m_reportedUnderruns
+               << "new (" << s.underruns << "total," << s.underrunFrames * 1000 / kSampleRate
+               << "ms of silence) at" << m_latencyMs.load(std::memory_order_relaxed) << "ms latency";
+    m_reportedUnderruns = s.underruns;
+}
+
 void FxEngine::maybeFinish()
 {
-    const bool procDone = !m_proc || m_proc->state() == QProcess::NotRunning;
-    if (!procDone)
+    const bool decodeDone = !m_decoder || !m_decoder->running();
+    if (!decodeDone)
         return; // just waiting for more data (realtime-paced decode)
 
     // Pull any bytes that arrived after the process exited
     readProcessOutput();
-    if (m_fifo.size() >= static_cast<size_t>(kChannels))
+    if (!m_fifo.isEmpty())
         return;
 
-    if (m_proc && m_proc->exitCode() != 0 && !m_producedAudio) {
-        failTrack(tr("ffmpeg could not decode: %1")
-                      .arg(QString::fromLocal8Bit(m_proc->readAllStandardError()).trimmed()));
+    if (m_decoder && m_decoder->failed() && !m_producedAudio) {
+        failTrack(tr("ffmpeg could not decode: %1").arg(m_decoder->errorString()));
         return;
     }
 
     // Early finish: when the next track is already preloaded, announce the
     // end while the sink is still draining the tail. The handoff then
     // adopts the new decoder under the live sink and playback is gapless.
-    if (!m_finishEmitted && m_nextProc
-            && (m_nextProc->state() == QProcess::Running
-                || m_nextProc->bytesAvailable() > 0)) {
+    if (!m_finishEmitted && m_nextDecoder && !m_nextDecoder->exhausted()) {
         m_finishEmitted = true;
-        stopProcess();
+        stopDecoder();
         qDebug() << "FxEngine: early finish, handoff armed for" << m_nextPath;
         const qint64 finalPos = (m_durationMs > 0) ? m_durationMs : currentPositionMs();
         emit positionChanged(finalPos);
@@ -1010,16 +1276,19 @@ void FxEngine::maybeFinish()
         return; // the pump keeps ticking until the handoff (or full drain)
     }
 
-    // Wait for the sink to drain what has already been written
-    if (m_sink && m_sink->bytesFree() < m_sink->bufferSize())
+    // Wait for the sink to play out what has already been rendered: the
+    // ring must empty, then a device buffer's worth of end padding must
+    // have been pulled behind it
+    if (m_output->bufferedFrames() > 0)
+        return;
+    m_output->markEndOfStream();
+    if (m_io && m_output->framesPaddedAtEnd() < static_cast<quint64>(sinkBufferFrames()))
         return;
 
-    stopProcess();
+    stopDecoder();
     if (m_pumpTimer)
         m_pumpTimer->stop();
-    if (m_sink)
-        m_sink->reset();
-    m_io = nullptr;
+    resetSinkStream();
     m_state = State::Stopped;
 
     const qint64 finalPos = (m_durationMs > 0) ? m_durationMs : currentPositionMs();
@@ -1045,20 +1314,20 @@ bool FxEngine::enterScratchMode()
 {
     if (m_scratchActive)
         return true;
-    if (m_state != State::Playing || m_isLive || !m_sink || !m_io)
+    if (m_state != State::Playing || m_isLive || !m_io)
         return false;
 
     // Freeze the decoder: while scratching, audio comes from the snapshot
-    stopProcess();
+    stopDecoder();
 
     const qint64 nowFrame = m_baseMs * kSampleRate / 1000 + m_framesTaken;
-    const qint64 historyFrames = static_cast<qint64>(m_history.size() / kChannels);
+    const size_t historyFrames = m_history.availableFrames();
+    const size_t aheadFrames = m_fifo.availableFrames();
 
-    m_scratchBuf.clear();
-    m_scratchBuf.reserve(m_history.size() + m_fifo.size());
-    m_scratchBuf.insert(m_scratchBuf.end(), m_history.begin(), m_history.end());
-    m_scratchBuf.insert(m_scratchBuf.end(), m_fifo.begin(), m_fifo.end());
-    m_scratchBufStartFrame = nowFrame - historyFrames;
+    m_scratchBuf.resize((historyFrames + aheadFrames) * kChannels);
+    m_history.copyOut(0, m_scratchBuf.data(), historyFrames);
+    m_fifo.copyOut(0, m_scratchBuf.data() + historyFrames * kChannels, aheadFrames);
+    m_scratchBufStartFrame = nowFrame - static_cast<qint64>(historyFrames);
 
     m_scratchPos = static_cast<double>(nowFrame);
     m_scratchVel = 1.0;
@@ -1093,12 +1362,10 @@ void FxEngine::scratchEnd()
     m_scratchBuf.clear();
 
     // Resume normal decoding from where the record was released
-    if (m_sink)
-        m_sink->reset();
-    m_io = nullptr;
+    resetSinkStream();
     startProcessAt(resumeMs);
-    if (m_proc && m_sink)
-        m_io = m_sink->start();
+    if (m_decoder && hasOutput())
+        startSinkStream();
     emit positionChanged(resumeMs);
 }
 
@@ -1164,21 +1431,21 @@ void FxEngine::renderScratch(float *out, int frames)
 
 void FxEngine::pumpScratch()
 {
-    const int bytesPerOutFrame = m_sinkIsFloat ? 8 : 4;
-
+    QElapsedTimer renderTimer;
     while (true) {
-        const int freeFrames = static_cast<int>(m_sink->bytesFree()) / bytesPerOutFrame;
-        const int wantFrames = std::min(kChunkFrames, freeFrames);
+        const int wantFrames = outputFramesWanted();
         if (wantFrames <= 0)
             break;
 
+        renderTimer.start();
         renderScratch(m_chunk.data(), wantFrames);
         applyFxChain(m_chunk.data(), wantFrames);
         writeChunkToSink(m_chunk.data(), wantFrames);
+        m_output->recordRenderTime(renderTimer.nsecsElapsed());
     }
 
-    if (++m_positionEmitDivider >= 16) {
-        m_positionEmitDivider = 0;
+    if (m_positionClock.elapsed() >= 250) {
+        m_positionClock.restart();
         emit positionChanged(scratchPosMs());
     }
 
@@ -1209,9 +1476,7 @@ void FxEngine::stopFromScratch()
 
     if (m_pumpTimer)
         m_pumpTimer->stop();
-    if (m_sink)
-        m_sink->reset();
-    m_io = nullptr;
+    resetSinkStream();
     m_state = State::Stopped;
     m_baseMs = 0;
     m_framesTaken = 0;
@@ -1224,12 +1489,10 @@ void FxEngine::stopFromScratch()
 void FxEngine::failTrack(const QString &message)
 {
     qWarning() << "FxEngine:" << message;
-    stopProcess();
+    stopDecoder();
     if (m_pumpTimer)
         m_pumpTimer->stop();
-    if (m_sink)
-        m_sink->reset();
-    m_io = nullptr;
+    resetSinkStream();
     m_state = State::Stopped;
     m_baseMs = 0;
     m_framesTaken = 0;
@@ -4,12 +4,25 @@
 #include <QObject>
 #include <QString>
 #include <QAudioFormat>
+#include <QElapsedTimer>
+#include <QPointF>
+#include <QVector>
+#include <atomic>
+#include <memory>
 #include <vector>
 
+#include "FrameRing.h"
+#include "FxDecoder.h"
 #include "FxDsp.h"
+#include "FxOutput.h"
 #include "FxParams.h"
+#include "TrackAnalysisStore.h"
+#include "TrackCue.h"
 
+class FxMixBus;
+class FxStreamTap;
 class QProcess;
+class QFutureWatcherBase;
 class QAudioSink;
 class QIODevice;
 class QTimer;
@@ -17,12 +30,24 @@ class QTimer;
 /**
  * @brief Worker-thread playback engine with a real DSP chain.
  *
- * Decodes any audio file through the ffmpeg CLI (already a runtime
- * dependency of XFB's conversion features) into 48 kHz stereo float PCM
- * (optionally retuned to A=432 Hz with tempo preserved, via ffmpeg's
- * asetrate/aresample/atempo filters), runs it through the in-process FX
+ * Decodes any audio file into 48 kHz stereo float PCM — in-process through
+ * libav when XFB is built with it (LibavDecoder), otherwise through the
+ * ffmpeg CLI (already a runtime dependency of XFB's conversion features).
+ * The CLI also remains the fallback for live streams, the A=432 Hz retune
+ * (ffmpeg's asetrate/aresample/atempo filters, tempo preserved) and files
+ * libav cannot open. The PCM then runs through the in-process FX
  * chain (10-band EQ -> compressor -> safety clamp) and renders it with
- * QAudioSink.
+ * QAudioSink. Tracks already measured by TrackAnalysisStore are loudness
+ * normalised; every local track starts and ends at its TrackCue (analysis
+ * or stored silence trim, passed to setSource/preloadNext by FxPlayer).
+ * Without one the auto-cue scans for the leading and trailing silence.
+ *
+ * Output is pull mode: the pump renders a few milliseconds ahead into
+ * FxOutput and the sink reads from there on its own audio thread. The
+ * output latency (device buffer plus render-ahead) is configurable down to
+ * ~20 ms; underruns and per-chunk render times are counted so a latency
+ * can be validated before going on air. With setMixer() the engine plays
+ * into the shared FxMixBus instead of opening a sink of its own.
  *
  * The engine lives in its own thread (owned by FxPlayer), so playback
  * keeps running even when the GUI thread is busy. All public slots must
@@ -43,17 +68,73 @@ public:
     /** True when the FX engine can be used on this system. */
     static bool available();
 
+    /**
+     * Convert a volume line as the playlist stores it (x = ms, y = linear
+     * gain, see PlaylistWaveView::parseEnvelope) to engine frames.
+     */
+    static fxdsp::GainEnvelope volumeEnvelope(const QVector<QPointF> &points);
+
+    /** Output health counters. Thread-safe: may be called from any thread. */
+    FxOutputStats outputStats() const;
+    /** Thread-safe: zero the output counters. */
+    void resetOutputStats();
+
+    static constexpr int kMinLatencyMs = 10;
+    static constexpr int kMaxLatencyMs = 350;
+
+    // Engine PCM format, shared with the offline renderer (FxRenderer)
+    static constexpr int kSampleRate = 48000;
+    static constexpr int kChannels = 2;
+    // Decode FIFO capacity: the 12 s initial burst plus pacing slack. Audio
+    // beyond this waits in the decoder pipe until the pump drains the ring.
+    static constexpr int kFifoSeconds = 20;
+    // Auto-cue: silence floor (~-50 dBFS) and the most leading silence a
+    // track may have skipped before playback proceeds normally.
+    static constexpr float kSilenceFloor = 0.0032f;
+    static constexpr qint64 kLeadSkipCapMs = 15000;
+
+    /** What openDecoder() should decode, and how. */
+    struct DecodeRequest
+    {
+        QString path;
+        qint64 positionMs = 0;
+        bool retune = false;       // A=432 Hz through the ffmpeg filter chain
+        bool isLive = false;       // http(s) stream: no seek, server-paced
+        bool realtime = true;      // CLI decode paced at 1x; false = as fast as it goes
+        bool waitForStart = false; // block until an ffmpeg child is running
+    };
+    /**
+     * Start decoding a source to engine PCM: libav in-process when built
+     * with it, else (or for live streams and the retune) the ffmpeg CLI,
+     * whose QProcess is parented to owner. Null with error set on failure.
+     */
+    static std::unique_ptr<FxDecoder> openDecoder(const DecodeRequest &request, QObject *owner,
+                                                  QString *error);
+    /**
+     * Duration and 432 Hz marker of a local file (libav, else ffprobe,
+     * else ffmpeg -i). Blocking; durationMs stays 0 when unknown.
+     */
+    static void probeFile(const QString &filePath, qint64 *durationMs, bool *is432);
+
 public slots:
-    /** Accepts a local file path or an http(s) stream URL (live mode). */
-    void setSource(const QString &pathOrUrl);
+    /**
+     * Accepts a local file path or an http(s) stream URL (live mode).
+     * analysis/cue: the file's cached analysis and where its audio starts
+     * and ends, resolved by the caller (FxPlayer) — both are disk reads
+     * this thread must not wait on. Defaults = unknown.
+     */
+    void setSource(const QString &pathOrUrl, const TrackAnalysis &analysis = TrackAnalysis(),
+                   const TrackCue &cue = TrackCue());
     /**
      * Gapless: probe the next local file and spawn its decoder ahead of
      * time. When the following setSource() names the same file it adopts
      * the running decoder instead of cold-starting one, and — after a
      * natural end of the current track — keeps the sink alive so the
-     * audio stream never breaks.
+     * audio stream never breaks. analysis/cue are as for setSource(); the
+     * preloaded decoder opens at the cue.
      */
-    void preloadNext(const QString &path);
+    void preloadNext(const QString &path, const TrackAnalysis &analysis = TrackAnalysis(),
+                     const TrackCue &cue = TrackCue());
     /** Drop any preloaded next track (probe and decoder). */
     void cancelPreload();
     /**
@@ -75,7 +156,32 @@ public slots:
     void stop();
     void seek(qint64 positionMs);
     void setVolume(float linearVolume);
+    /**
+     * Volume line of the track at path, applied per sample on the input
+     * timeline before the FX chain (the volume slider stays the level it
+     * scales). May arrive before or after the setSource() naming that
+     * path; it follows the track into the crossfade tail. An empty
+     * envelope removes the line.
+     */
+    void setVolumeEnvelope(const QString &path, const fxdsp::GainEnvelope &envelope);
     void setParams(const FxParams &params);
+    /**
+     * Total output latency in ms (clamped to kMinLatencyMs..kMaxLatencyMs),
+     * split evenly between the device buffer and the render-ahead ring.
+     * Reopens the sink when one is open.
+     */
+    void setOutputLatency(int latencyMs);
+    /**
+     * Play into a shared mix bus (one device for all decks) instead of a
+     * private sink; nullptr returns to the private sink. The bus must
+     * outlive the engine.
+     */
+    void setMixer(FxMixBus *bus);
+    /**
+     * Also push every output block (volume applied) into tap, for the
+     * stream source; nullptr stops. The tap must outlive the engine.
+     */
+    void setStreamTap(FxStreamTap *tap);
     void shutdown();
 
     // --- DJ performance controls (LP decks) ---
@@ -106,19 +212,38 @@ private slots:
     void pump();
 
 private:
-    QProcess *spawnDecoder(const QString &path, qint64 positionMs,
-                           bool retune, bool isLive, bool waitForStart,
-                           QString *error);
+    std::unique_ptr<FxDecoder> spawnDecoder(const QString &path, qint64 positionMs,
+                                            bool retune, bool isLive, bool waitForStart,
+                                            QString *error);
     void spawnPreloadDecoder();
+    /** Preload, no in-process probe: ffprobe, asynchronously, then the decoder. */
+    void probeNextWithFfprobe();
     void adoptPreloaded();
     void startProcessAt(qint64 positionMs);
-    void stopProcess();
+    void stopDecoder();
     bool ensureSink();
     void teardownSink();
+    bool hasOutput() const { return m_sink || m_mixer; }
+    bool startSinkStream();
+    void resetSinkStream();
+    void configureOutputRing();
+    int sinkBufferFrames() const;
+    int renderAheadFrames() const;
+    int outputFramesWanted() const;
+    int pumpIntervalMs() const;
+    /** Audio rendered but not heard yet (ring + device buffer). */
+    qint64 queuedOutputMs() const;
+    void reportUnderruns();
     void resetDspState();
-    /** One ffprobe pass: fills m_durationMs and m_sourceIs432. */
+    /** One probe pass (libav or ffprobe): fills m_durationMs and m_sourceIs432. */
     void probeLocalSource(const QString &filePath);
     qint64 inputFramesConsumed() const;
+    /** Input-timeline frame the next chunk taken from m_fifo starts at. */
+    qint64 inputFramePosition() const;
+    /** Install the envelope queued for m_path, or none. */
+    void takePendingEnvelope();
+    /** Loudness normalization of the current track, folded into m_envelope. */
+    void applyTrackGain();
     qint64 currentPositionMs() const;
     int fillChunk(float *out, int maxFrames);
     void readProcessOutput();
@@ -127,20 +252,14 @@ private:
     void maybeFinish();
     void failTrack(const QString &message);
     void applyFxChain(float *chunk, int frames);
-    void writeChunkToSink(const float *chunk, int frames);
+    void writeChunkToSink(float *chunk, int frames);
     bool enterScratchMode();
     void pumpScratch();
     void renderScratch(float *out, int frames);
     void stopFromScratch();
     qint64 scratchPosMs() const;
 
-    static constexpr int kSampleRate = 48000;
-    static constexpr int kChannels = 2;
     static constexpr int kChunkFrames = 2048;
-    // Auto-cue: silence floor (~-50 dBFS) and the most leading silence a
-    // track may have skipped before playback proceeds normally.
-    static constexpr float kSilenceFloor = 0.0032f;
-    static constexpr qint64 kLeadSkipCapMs = 15000;
 
     // Transport
     enum class State { Stopped, Playing, Paused };
@@ -155,17 +274,17 @@ private:
     float m_volume = 1.0f;
     bool m_producedAudio = false;
 
-    // Decode process
-    QProcess *m_proc = nullptr;
-    QByteArray m_partialFrame;    // leftover bytes (< one PCM frame) between reads
+    // Decoder of the current track
+    std::unique_ptr<FxDecoder> m_decoder;
 
     // Gapless preload of the upcoming track
     QString m_nextPath;
-    QProcess *m_nextProc = nullptr;  // decoder already running ahead of time
+    std::unique_ptr<FxDecoder> m_nextDecoder; // decoder already running ahead of time
     QProcess *m_nextProbe = nullptr; // async ffprobe (a blocking probe would starve the pump)
+    QFutureWatcherBase *m_nextLibavProbe = nullptr; // in-process probe on a pool thread
     qint64 m_nextDurationMs = 0;
     bool m_nextIs432 = false;
-    bool m_procPreloaded = false;    // m_proc was adopted, already decoding from 0
+    bool m_decoderPreloaded = false; // m_decoder was adopted, already decoding from the cue
     bool m_finishEmitted = false;    // playbackFinished sent early, handoff pending
     bool m_leadSkipped = true;       // auto-cue: leading silence already handled
     bool m_tailTrimmed = true;       // auto-cue: trailing silence already handled
@@ -173,17 +292,40 @@ private:
     // Engine-internal crossfade: at an overlap handoff the outgoing decoder
     // moves here and keeps feeding the mix (faded out per sample) while the
     // adopted track continues the same sink stream.
-    QProcess *m_tailProc = nullptr;
-    QByteArray m_tailPartial;
-    std::vector<float> m_tailFifo;
+    std::unique_ptr<FxDecoder> m_tailDecoder;
+    FrameRing m_tailFifo{kChannels};
     double m_tailGain = 0.0;
     double m_tailGainStep = 0.0;     // per-frame decrement
     qint64 m_nextCrossfadeMs = 0;    // armed by setNextCrossfade()
+    fxdsp::GainEnvelope m_tailEnvelope; // volume line of the outgoing track
+    qint64 m_tailFrame = 0;          // its input frame at the tail ring's read side
+
+    // Volume line of the current track, and one received for a path that
+    // is not current yet (set before the matching setSource/handoff)
+    fxdsp::GainEnvelope m_envelope;
+    fxdsp::GainEnvelope m_pendingEnvelope;
+    QString m_pendingEnvelopePath;
+
+    // Cached analysis (TrackAnalysisStore) of the current and the preloaded
+    // track: the normalization gain. Not ready() = unknown.
+    TrackAnalysis m_analysis;
+    TrackAnalysis m_nextAnalysis;
+
+    // Where the current and the preloaded track start and end, from the
+    // analysis and the stored trim (setSource/preloadNext)
+    TrackCue m_cue;
+    TrackCue m_nextCue;
 
-    // Output
+    // Output: m_io is the pull device while a sink stream runs, else null
     QAudioSink *m_sink = nullptr;
     QIODevice *m_io = nullptr;
+    FxOutput *m_output = nullptr;
+    FxMixBus *m_mixer = nullptr;  // shared output, replaces m_sink when set
+    FxStreamTap *m_streamTap = nullptr;
     bool m_sinkIsFloat = true;
+    // Written on the engine thread, read by outputStats() from any thread
+    std::atomic<int> m_latencyMs{FxSettings::kDefaultOutputLatencyMs};
+    quint64 m_reportedUnderruns = 0;
     QByteArray m_sinkDeviceId;    // device the sink was opened on
 
     // DSP (the 432 Hz retune itself runs inside the ffmpeg filter chain so
@@ -194,15 +336,15 @@ private:
     fxdsp::DjFilter m_djFilter;
     fxdsp::Echo m_echo;
     bool m_retuneOn = false;
-    std::vector<float> m_fifo;    // interleaved float input (non-retune path)
+    FrameRing m_fifo{kChannels};  // decoded input, interleaved float
     std::vector<float> m_chunk;
-    std::vector<qint16> m_chunk16;
+    std::vector<int16_t> m_chunk16; // m_chunk converted for an Int16 sink
 
     // Scratch mode: a rolling history of played audio lets the read head
     // move backwards; while scratching the decoder is frozen and playback
     // is rendered from the snapshot at a mouse-driven variable rate.
     static constexpr int kHistorySeconds = 8;
-    std::vector<float> m_history;      // recently consumed input (interleaved)
+    FrameRing m_history{kChannels};    // recently consumed input (rolling)
     bool m_scratchActive = false;
     int m_scratchMode = 0;             // 0=manual, 1=brake, 2=backspin
     std::vector<float> m_scratchBuf;   // history+future snapshot
@@ -212,12 +354,12 @@ private:
     double m_scratchTargetVel = 0.0;
 
     QTimer *m_pumpTimer = nullptr;
-    int m_positionEmitDivider = 0;
+    QElapsedTimer m_positionClock;
 
     // Output level meter accumulation (peaks between emissions)
     float m_meterPeakL = 0.0f;
     float m_meterPeakR = 0.0f;
-    int m_meterEmitDivider = 0;
+    QElapsedTimer m_meterClock;
 };
 
 #endif // FXENGINE_H
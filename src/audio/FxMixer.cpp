@@ -0,0 +1,240 @@
+#include "FxMixer.h"
+
+#include "FxDsp.h"
+#include "FxOutput.h"
+#include "FxStreamTap.h"
+
+#include <QAudioDevice>
+#include <QAudioFormat>
+#include <QAudioSink>
+#include <QDebug>
+#include <QMediaDevices>
+
+#include <algorithm>
+#include <cstring>
+#include <thread>
+
+FxMixBus::FxMixBus(QObject *parent)
+    : QIODevice(parent)
+{
+    for (auto &slot : m_sources)
+        slot.store(nullptr, std::memory_order_relaxed);
+    m_mix.resize(static_cast<size_t>(kMixBlockFrames) * kChannels);
+    m_mix16.resize(static_cast<size_t>(kMixBlockFrames) * kChannels);
+    m_deviceBufferFrames.store(kSampleRate * m_latencyMs / 1000, std::memory_order_relaxed);
+    // Unbuffered: the sink may pull from its own audio thread
+    open(QIODevice::ReadOnly | QIODevice::Unbuffered);
+
+    // Same device-follow rule as a standalone engine sink
+    QMediaDevices *devices = new QMediaDevices(this);
+    connect(devices, &QMediaDevices::audioOutputsChanged, this, [this]() {
+        const QAudioDevice def = QMediaDevices::defaultAudioOutput();
+        if (!m_sink || def.isNull() || def.id() == m_sinkDeviceId)
+            return;
+        qDebug() << "FxMixBus: default audio output changed, rebuilding sink";
+        rebuildSink();
+    });
+}
+
+FxMixBus::~FxMixBus()
+{
+    teardownSink();
+}
+
+bool FxMixBus::attach(FxOutput *source)
+{
+    for (auto &slot : m_sources) {
+        if (slot.load() == source)
+            return true;
+    }
+    for (auto &slot : m_sources) {
+        FxOutput *expected = nullptr;
+        if (slot.compare_exchange_strong(expected, source)) {
+            // First source: make sure the stream is running (mixer thread)
+            QMetaObject::invokeMethod(this, &FxMixBus::ensureRunning, Qt::QueuedConnection);
+            return true;
+        }
+    }
+    qWarning() << "FxMixBus: all" << kMaxSources << "mixer inputs are in use";
+    return false;
+}
+
+void FxMixBus::detach(FxOutput *source)
+{
+    bool found = false;
+    for (auto &slot : m_sources) {
+        FxOutput *expected = source;
+        if (slot.compare_exchange_strong(expected, nullptr))
+            found = true;
+    }
+    if (!found)
+        return;
+    waitForMixPass();
+}
+
+void FxMixBus::setStreamTap(FxStreamTap *tap)
+{
+    if (m_streamTap.exchange(tap) != nullptr)
+        waitForMixPass();
+}
+
+void FxMixBus::waitForMixPass()
+{
+    // A mix pass that loaded a pointer before it was cleared may still be
+    // using it: wait for that pass (never for a later one) to end.
+    const quint64 seq = m_mixSeq.load();
+    if (seq & 1) {
+        while (m_mixSeq.load() == seq)
+            std::this_thread::yield();
+    }
+}
+
+int FxMixBus::activeSources() const
+{
+    int n = 0;
+    for (const auto &slot : m_sources) {
+        if (slot.load(std::memory_order_relaxed))
+            ++n;
+    }
+    return n;
+}
+
+void FxMixBus::ensureRunning()
+{
+    if (m_sink && m_sink->state() != QAudio::StoppedState)
+        return;
+    if (m_sink)
+        teardownSink();
+
+    const QAudioDevice device = QMediaDevices::defaultAudioOutput();
+    if (device.isNull()) {
+        qWarning() << "FxMixBus: no audio output device";
+        return;
+    }
+
+    QAudioFormat fmt;
+    fmt.setSampleRate(kSampleRate);
+    fmt.setChannelCount(kChannels);
+    fmt.setSampleFormat(QAudioFormat::Float);
+    m_sinkIsFloat = true;
+    if (!device.isFormatSupported(fmt)) {
+        fmt.setSampleFormat(QAudioFormat::Int16);
+        m_sinkIsFloat = false;
+        if (!device.isFormatSupported(fmt)) {
+            qWarning() << "FxMixBus: device supports neither float nor s16 stereo at" << kSampleRate;
+            return;
+        }
+    }
+
+    m_sink = new QAudioSink(device, fmt, this);
+    m_sinkDeviceId = device.id();
+    const int frames = kSampleRate * m_latencyMs / 1000;
+    m_sink->setBufferSize(frames * (m_sinkIsFloat ? 8 : 4));
+    m_deviceBufferFrames.store(frames, std::memory_order_relaxed);
+    // Runs for as long as the mixer lives: a jingle fired over silence
+    // then starts without a device start-up
+    m_sink->start(this);
+    qDebug() << "FxMixBus: shared output running," << m_latencyMs << "ms device buffer";
+}
+
+void FxMixBus::setLatency(int latencyMs)
+{
+    latencyMs = std::clamp(latencyMs, 5, 200);
+    if (latencyMs == m_latencyMs)
+        return;
+    m_latencyMs = latencyMs;
+    m_deviceBufferFrames.store(kSampleRate * m_latencyMs / 1000, std::memory_order_relaxed);
+    if (m_sink)
+        rebuildSink();
+}
+
+void FxMixBus::rebuildSink()
+{
+    teardownSink();
+    ensureRunning();
+}
+
+void FxMixBus::shutdown()
+{
+    teardownSink();
+}
+
+void FxMixBus::teardownSink()
+{
+    if (!m_sink)
+        return;
+    m_sink->stop();
+    delete m_sink;
+    m_sink = nullptr;
+    m_sinkDeviceId.clear();
+}
+
+qint64 FxMixBus::readData(char *data, qint64 maxSize)
+{
+    const size_t sampleBytes = m_sinkIsFloat ? sizeof(float) : sizeof(qint16);
+    const size_t frameBytes = sampleBytes * kChannels;
+    size_t remaining = static_cast<size_t>(maxSize) / frameBytes;
+    const qint64 total = static_cast<qint64>(remaining * frameBytes);
+
+    m_mixSeq.fetch_add(1); // odd: sources are being read
+    FxStreamTap *tap = m_streamTap.load();
+    char *dst = data;
+    float peakL = 0.0f, peakR = 0.0f; // per-source meters live in the engines
+    while (remaining > 0) {
+        const size_t n = std::min(remaining, static_cast<size_t>(kMixBlockFrames));
+        std::fill(m_mix.begin(), m_mix.begin() + n * kChannels, 0.0f);
+        for (auto &slot : m_sources) {
+            if (FxOutput *source = slot.load())
+                source->mixInto(m_mix.data(), n);
+        }
+
+        // Sources are clamped individually; their sum needs it again
+        fxdsp::finishOutput(m_mix.data(), static_cast<int>(n), peakL, peakR,
+                            m_sinkIsFloat ? nullptr : m_mix16.data());
+        if (tap)
+            tap->push(m_mix.data(), n);
+        if (m_sinkIsFloat)
+            std::memcpy(dst, m_mix.data(), n * frameBytes);
+        else
+            std::memcpy(dst, m_mix16.data(), n * frameBytes);
+        dst += n * frameBytes;
+        remaining -= n;
+    }
+    m_mixSeq.fetch_add(1); // even: no source pointer is held any more
+    return total;
+}
+
+qint64 FxMixBus::writeData(const char *, qint64)
+{
+    return -1; // pulled by the sink only
+}
+
+// ------------------------------------------------------------------ FxMixer
+
+FxMixer::FxMixer(QObject *parent)
+    : QObject(parent)
+{
+    m_bus = new FxMixBus();
+    m_bus->moveToThread(&m_thread);
+    connect(&m_thread, &QThread::finished, m_bus, &QObject::deleteLater);
+    m_thread.setObjectName(QStringLiteral("FxMixerThread"));
+    m_thread.start(QThread::TimeCriticalPriority);
+}
+
+FxMixer::~FxMixer()
+{
+    QMetaObject::invokeMethod(m_bus, &FxMixBus::shutdown, Qt::BlockingQueuedConnection);
+    m_thread.quit();
+    m_thread.wait(3000);
+}
+
+void FxMixer::setLatency(int latencyMs)
+{
+    QMetaObject::invokeMethod(m_bus, [bus = m_bus, latencyMs]() { bus->setLatency(latencyMs); },
+                              Qt::QueuedConnection);
+}
+
+void FxMixer::rebuildSink()
+{
+    QMetaObject::invokeMethod(m_bus, &FxMixBus::rebuildSink, Qt::QueuedConnection);
+}
@@ -0,0 +1,122 @@
+#ifndef FXMIXER_H
+#define FXMIXER_H
+
+#include <QIODevice>
+#include <QObject>
+#include <QThread>
+
+#include <array>
+#include <atomic>
+#include <vector>
+
+class FxOutput;
+class FxStreamTap;
+class QAudioSink;
+
+/**
+ * @brief Summing bus: the one QAudioSink every attached source plays into.
+ *
+ * Each source is an FxOutput (the render-ahead ring of one FxEngine, so it
+ * brings its own decoder and FX chain). The sink pulls the bus, and the bus
+ * pulls all attached sources in the same callback, applying each source's
+ * gain ramp, so they are summed sample-aligned into one stream and no deck
+ * opens a device of its own. The sum gets the safety clamp (and the Int16
+ * conversion where the device needs it).
+ *
+ * attach()/detach() are thread-safe and lock-free for the audio side;
+ * detach() returns only once no mix pass can still be reading the source.
+ * Everything else runs on the mixer thread (see FxMixer).
+ */
+class FxMixBus : public QIODevice
+{
+    Q_OBJECT
+
+public:
+    static constexpr int kMaxSources = 8;
+
+    explicit FxMixBus(QObject *parent = nullptr);
+    ~FxMixBus() override;
+
+    /** Any thread: add a source to the mix; false when all slots are taken. */
+    bool attach(FxOutput *source);
+    /** Any thread: remove a source; afterwards the caller owns its ring again. */
+    void detach(FxOutput *source);
+
+    /** Any thread: frames the device buffer holds (part of every source's latency). */
+    int deviceBufferFrames() const { return m_deviceBufferFrames.load(std::memory_order_relaxed); }
+    int activeSources() const;
+
+    /**
+     * Any thread: also push the finished mix into tap (the stream source
+     * then carries everything on air, crossfade tails and LP decks
+     * included); nullptr stops, waiting like detach() for a mix pass still
+     * using the old tap.
+     */
+    void setStreamTap(FxStreamTap *tap);
+
+    bool isSequential() const override { return true; }
+
+public slots:
+    /** Open the sink on the default device if it is not running yet. */
+    void ensureRunning();
+    void setLatency(int latencyMs);
+    /** Reopen the sink on the current default device. */
+    void rebuildSink();
+    void shutdown();
+
+protected:
+    qint64 readData(char *data, qint64 maxSize) override;
+    qint64 writeData(const char *data, qint64 maxSize) override;
+
+private:
+    void teardownSink();
+    void waitForMixPass();
+
+    static constexpr int kSampleRate = 48000;
+    static constexpr int kChannels = 2;
+    static constexpr int kMixBlockFrames = 1024;
+
+    std::array<std::atomic<FxOutput *>, kMaxSources> m_sources{};
+    std::atomic<FxStreamTap *> m_streamTap{nullptr};
+    // Odd while a mix pass runs: detach() waits for the pass it raced with
+    std::atomic<quint64> m_mixSeq{0};
+
+    QAudioSink *m_sink = nullptr;
+    QByteArray m_sinkDeviceId;
+    bool m_sinkIsFloat = true;
+    int m_latencyMs = 40;
+    std::atomic<int> m_deviceBufferFrames{0};
+
+    // Audio side only
+    std::vector<float> m_mix;
+    std::vector<qint16> m_mix16;
+};
+
+/**
+ * @brief Owner of the shared mix bus and its high-priority thread.
+ *
+ * Created once by the main window; FxPlayer::setMixer() routes a player's
+ * engine into it instead of a private sink. Must outlive every player
+ * attached to it.
+ */
+class FxMixer : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit FxMixer(QObject *parent = nullptr);
+    ~FxMixer() override;
+
+    FxMixBus *bus() const { return m_bus; }
+
+    /** Device buffer of the shared sink, in ms (the engines add their own render-ahead). */
+    void setLatency(int latencyMs);
+    void rebuildSink();
+    void setStreamTap(FxStreamTap *tap) { m_bus->setStreamTap(tap); }
+
+private:
+    QThread m_thread;
+    FxMixBus *m_bus = nullptr;
+};
+
+#endif // FXMIXER_H
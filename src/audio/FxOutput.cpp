@@ -0,0 +1,190 @@
+#include "FxOutput.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace
+{
+// Copy up to frames out of ring to *dst, advancing it; returns the frames
+template <typename Sample>
+size_t copyFrames(BasicFrameRing<Sample> &ring, size_t frames, char **dst)
+{
+    typename BasicFrameRing<Sample>::Region regions[2];
+    const size_t got = ring.peek(frames, regions[0], regions[1]);
+    const size_t ch = static_cast<size_t>(ring.channels());
+    for (const auto &r : regions) {
+        if (r.frames == 0)
+            continue;
+        const size_t bytes = r.frames * ch * sizeof(Sample);
+        std::memcpy(*dst, r.data, bytes);
+        *dst += bytes;
+    }
+    ring.commitRead(got);
+    return got;
+}
+} // namespace
+
+FxOutput::FxOutput(int channels, QObject *parent)
+    : QIODevice(parent)
+    , m_ring(channels)
+    , m_ring16(channels)
+{
+    resetStats();
+    // Unbuffered: QIODevice's own read buffer is not thread-safe, and the
+    // sink reads from its audio thread while the engine pushes.
+    open(QIODevice::ReadOnly | QIODevice::Unbuffered);
+}
+
+void FxOutput::configure(size_t capacityFrames, bool sinkIsFloat)
+{
+    // Only the ring matching the sink format holds storage
+    m_ring.reset(sinkIsFloat ? capacityFrames : 0);
+    m_ring16.reset(sinkIsFloat ? 0 : capacityFrames);
+    m_sinkIsFloat = sinkIsFloat;
+    clear();
+}
+
+void FxOutput::clear()
+{
+    m_ring.clear();
+    m_ring16.clear();
+    // Nothing rendered yet: the pulls until the first push() are the
+    // stream starting up, not underruns
+    m_paddedAtEnd.store(0, std::memory_order_release);
+    m_endOfStream.store(true, std::memory_order_release);
+}
+
+size_t FxOutput::push(const float *interleaved, size_t frames)
+{
+    if (!m_sinkIsFloat)
+        return 0;
+    const size_t n = m_ring.write(interleaved, frames);
+    leaveEndOfStream(n);
+    return n;
+}
+
+size_t FxOutput::push(const int16_t *interleaved, size_t frames)
+{
+    if (m_sinkIsFloat)
+        return 0;
+    const size_t n = m_ring16.write(interleaved, frames);
+    leaveEndOfStream(n);
+    return n;
+}
+
+void FxOutput::leaveEndOfStream(size_t pushed)
+{
+    // Called once the audio is published, so a pull in between never sees
+    // "streaming" with an empty ring (a false underrun). This also resumes
+    // a stream whose end was marked, for a gapless handoff.
+    if (pushed > 0 && m_endOfStream.load(std::memory_order_relaxed))
+        m_endOfStream.store(false, std::memory_order_release);
+}
+
+void FxOutput::markEndOfStream()
+{
+    if (m_endOfStream.load(std::memory_order_relaxed))
+        return; // already draining: keep counting from the first mark
+    m_paddedAtEnd.store(0, std::memory_order_release);
+    m_endOfStream.store(true, std::memory_order_release);
+}
+
+void FxOutput::recordRenderTime(qint64 nanoseconds)
+{
+    const qint64 us = nanoseconds / 1000;
+    int bucket = 0;
+    while (bucket < FxOutputStats::kRenderBuckets - 1 && us >= FxOutputStats::bucketUpperUs(bucket))
+        ++bucket;
+    m_renderHistogram[bucket].fetch_add(1, std::memory_order_relaxed);
+}
+
+FxOutputStats FxOutput::stats() const
+{
+    FxOutputStats s;
+    s.callbacks = m_callbacks.load(std::memory_order_relaxed);
+    s.underruns = m_underruns.load(std::memory_order_relaxed);
+    s.underrunFrames = m_underrunFrames.load(std::memory_order_relaxed);
+    s.bufferedFrames = static_cast<int>(bufferedFrames());
+    for (int i = 0; i < FxOutputStats::kRenderBuckets; ++i)
+        s.renderHistogram[i] = m_renderHistogram[i].load(std::memory_order_relaxed);
+    return s;
+}
+
+void FxOutput::resetStats()
+{
+    m_callbacks.store(0, std::memory_order_relaxed);
+    m_underruns.store(0, std::memory_order_relaxed);
+    m_underrunFrames.store(0, std::memory_order_relaxed);
+    for (auto &bucket : m_renderHistogram)
+        bucket.store(0, std::memory_order_relaxed);
+}
+
+qint64 FxOutput::bytesAvailable() const
+{
+    const qint64 bytesPerFrame = qint64(m_ring.channels())
+                                 * (m_sinkIsFloat ? qint64(sizeof(float)) : qint64(sizeof(qint16)));
+    return qint64(bufferedFrames()) * bytesPerFrame + QIODevice::bytesAvailable();
+}
+
+qint64 FxOutput::readData(char *data, qint64 maxSize)
+{
+    const size_t ch = static_cast<size_t>(m_ring.channels());
+    const size_t sampleBytes = m_sinkIsFloat ? sizeof(float) : sizeof(qint16);
+    const size_t wanted = static_cast<size_t>(maxSize) / (ch * sampleBytes);
+    if (wanted == 0)
+        return 0;
+
+    // Already in the sink's format: the engine's output pass converted it
+    char *dst = data;
+    const size_t got = m_sinkIsFloat ? copyFrames(m_ring, wanted, &dst) : copyFrames(m_ring16, wanted, &dst);
+    m_callbacks.fetch_add(1, std::memory_order_relaxed);
+
+    // Always hand the sink a full buffer: returning short would make it
+    // go idle, and resuming from idle costs far more than the silence.
+    if (got < wanted) {
+        std::memset(dst, 0, (wanted - got) * ch * sampleBytes);
+        accountShortfall(wanted - got);
+    }
+    return static_cast<qint64>(wanted * ch * sampleBytes);
+}
+
+void FxOutput::mixInto(float *acc, size_t frames)
+{
+    const size_t ch = static_cast<size_t>(m_ring.channels());
+    const float target = m_gainTarget.load(std::memory_order_relaxed);
+    const float step = (frames > 0) ? (target - m_gain) / static_cast<float>(frames) : 0.0f;
+    float g = m_gain;
+
+    FrameRing::Region regions[2];
+    const size_t got = m_ring.peek(frames, regions[0], regions[1]);
+    float *dst = acc;
+    for (const FrameRing::Region &r : regions) {
+        for (size_t f = 0; f < r.frames; ++f) {
+            g += step;
+            for (size_t c = 0; c < ch; ++c)
+                dst[c] += r.data[f * ch + c] * g;
+            dst += ch;
+        }
+    }
+    m_ring.commitRead(got);
+    m_gain = target; // a short block still lands on the target
+    m_callbacks.fetch_add(1, std::memory_order_relaxed);
+
+    if (got < frames)
+        accountShortfall(frames - got);
+}
+
+void FxOutput::accountShortfall(size_t missing)
+{
+    if (m_endOfStream.load(std::memory_order_acquire)) {
+        m_paddedAtEnd.fetch_add(missing, std::memory_order_release);
+    } else {
+        m_underruns.fetch_add(1, std::memory_order_relaxed);
+        m_underrunFrames.fetch_add(missing, std::memory_order_relaxed);
+    }
+}
+
+qint64 FxOutput::writeData(const char *, qint64)
+{
+    return -1; // read-only: the engine feeds it through push()
+}
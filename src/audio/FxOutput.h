@@ -0,0 +1,124 @@
+#ifndef FXOUTPUT_H
+#define FXOUTPUT_H
+
+#include <QIODevice>
+
+#include <array>
+#include <atomic>
+
+#include "FrameRing.h"
+
+/**
+ * @brief Snapshot of the FX engine's real-time output health.
+ *
+ * Underruns are counted on the audio side (the sink asked for audio the
+ * engine had not rendered yet); the render histogram is filled on the
+ * engine side with the wall time each output chunk took to produce
+ * (decode drain, FX chain and output conversion).
+ */
+struct FxOutputStats
+{
+    static constexpr int kRenderBuckets = 12;
+
+    quint64 callbacks = 0;      // sink pulls served
+    quint64 underruns = 0;      // pulls that could not be served in full
+    quint64 underrunFrames = 0; // silence frames inserted by those pulls
+    int bufferedFrames = 0;     // rendered audio waiting for the sink right now
+    int latencyMs = 0;          // configured output latency
+    // Bucket i counts chunks rendered in under bucketUpperUs(i) microseconds
+    // (and at least the previous bound); the last bucket is open-ended.
+    std::array<quint64, kRenderBuckets> renderHistogram{};
+
+    static qint64 bucketUpperUs(int i) { return qint64(64) << i; }
+};
+
+/**
+ * @brief Pull-mode output device for the FxEngine's QAudioSink.
+ *
+ * The engine renders post-FX audio into a small lock-free ring and the
+ * sink pulls it through readData() on whatever thread its backend uses,
+ * so how much audio is queued is set by the configured latency rather
+ * than by how often the engine's pump timer happens to fire. A pull that
+ * finds the ring short is padded with silence and counted as an underrun,
+ * except between clear() and the first push() (stream starting) and after
+ * markEndOfStream(), when the silence is the expected drain of a finished
+ * track.
+ *
+ * The ring holds frames in the sink's format: clamped float, or s16 the
+ * engine converted in its fused output pass (fxdsp::finishOutput), so a
+ * pull is a plain copy either way. Instead of a sink of its own, the
+ * device can also be a source of the shared FxMixBus, which pulls float
+ * frames through mixInto() with the same accounting.
+ */
+class FxOutput : public QIODevice
+{
+    Q_OBJECT
+
+public:
+    explicit FxOutput(int channels, QObject *parent = nullptr);
+
+    /** Engine thread, stream stopped: size the ring and pick the sink format. */
+    void configure(size_t capacityFrames, bool sinkIsFloat);
+    /** Engine thread, stream stopped: drop everything queued (ends the stream). */
+    void clear();
+
+    // --- engine (producer) side ------------------------------------------
+
+    /** True when push() takes float frames, false for s16 ones. */
+    bool sinkIsFloat() const { return m_sinkIsFloat; }
+    /** Queue rendered frames in the sink's format; returns the frames that fit. */
+    size_t push(const float *interleaved, size_t frames);
+    size_t push(const int16_t *interleaved, size_t frames);
+    // The ring not in use stays empty, so this needs no format check and
+    // is safe from any thread
+    size_t bufferedFrames() const { return m_ring.availableFrames() + m_ring16.availableFrames(); }
+    size_t freeFrames() const { return m_sinkIsFloat ? m_ring.freeFrames() : m_ring16.freeFrames(); }
+    /** No more audio is coming: following short pulls are not underruns. */
+    void markEndOfStream();
+    /** Silence frames served since markEndOfStream() (sink drain progress). */
+    quint64 framesPaddedAtEnd() const { return m_paddedAtEnd.load(std::memory_order_acquire); }
+    /** Record how long one output chunk took to render. */
+    void recordRenderTime(qint64 nanoseconds);
+    /**
+     * Any thread: linear gain the mix bus applies to this source. Changes
+     * are ramped across the next mix block, so automation (fades, ducking)
+     * never steps.
+     */
+    void setGain(float gain) { m_gainTarget.store(gain, std::memory_order_relaxed); }
+
+    // --- mix bus (consumer) side -----------------------------------------
+
+    /** Add up to frames of this source, gain-ramped, onto acc; pads like readData(). */
+    void mixInto(float *acc, size_t frames);
+
+    /** Thread-safe snapshot of the counters. */
+    FxOutputStats stats() const;
+    /** Thread-safe: zero the counters and the histogram. */
+    void resetStats();
+
+    bool isSequential() const override { return true; }
+    qint64 bytesAvailable() const override;
+
+protected:
+    qint64 readData(char *data, qint64 maxSize) override;
+    qint64 writeData(const char *data, qint64 maxSize) override;
+
+private:
+    void accountShortfall(size_t missing);
+    void leaveEndOfStream(size_t pushed);
+
+    FrameRing m_ring;     // float sink or mix bus
+    FrameRing16 m_ring16; // Int16 sink
+    bool m_sinkIsFloat = true;
+    std::atomic<bool> m_endOfStream{false};
+    std::atomic<float> m_gainTarget{1.0f};
+    float m_gain = 1.0f; // consumer side: where the last ramp ended
+
+    std::atomic<quint64> m_callbacks{0};
+    std::atomic<quint64> m_underruns{0};
+    std::atomic<quint64> m_underrunFrames{0};
+    std::atomic<quint64> m_paddedAtEnd{0};
+    std::array<std::atomic<quint64>, FxOutputStats::kRenderBuckets> m_renderHistogram{};
+};
+
+#endif // FXOUTPUT_H
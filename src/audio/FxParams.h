@@ -8,9 +8,10 @@
 /**
  * @brief Parameters for one player channel of the XFB audio FX chain.
  *
- * Covers the 432 Hz retune mode, a 10-band graphic equalizer and a
- * broadcast-style dynamic range compressor. Values are persisted in the
- * same xfb.conf INI file used by the rest of the application.
+ * Covers the 432 Hz retune mode, loudness normalization, a 10-band
+ * graphic equalizer and a broadcast-style dynamic range compressor.
+ * Values are persisted in the same xfb.conf INI file used by the rest of
+ * the application.
  */
 struct FxParams
 {
@@ -24,6 +25,11 @@ struct FxParams
     // Global: play everything retuned from A=440 Hz to A=432 Hz
     bool retune432 = false;
 
+    // Global: loudness normalization from the track analysis cache
+    // (TrackAnalysisStore), EBU R128 integrated loudness
+    bool normalize = false;
+    double normalizeTargetLufs = -16.0;
+
     // Equalizer
     bool eqEnabled = false;
     double eqGainDb[kBands] = {0, 0, 0, 0, 0, 0, 0, 0, 0, 0};
@@ -37,7 +43,7 @@ struct FxParams
     double compReleaseMs = 150.0;
     double compMakeupDb = 0.0;
 
-    bool anyActive() const { return retune432 || eqEnabled || compEnabled; }
+    bool anyActive() const { return retune432 || normalize || eqEnabled || compEnabled; }
 
     bool eqIsFlat() const
     {
@@ -54,8 +60,8 @@ struct FxParams
  * @brief Load/save FxParams from the shared xfb.conf configuration file.
  *
  * Channel names used by XFB: "Main", "LP1", "LP2". The 432 Hz retune flag
- * is global (one switch for the whole application) while EQ and compressor
- * settings are stored per channel.
+ * and loudness normalization are global (one switch for the whole
+ * application) while EQ and compressor settings are stored per channel.
  */
 namespace FxSettings
 {
@@ -65,6 +71,28 @@ inline QString configFilePath()
     return base + "/xfb.conf";
 }
 
+// Total FX engine output latency (device buffer + render-ahead), global
+constexpr int kDefaultOutputLatencyMs = 60;
+
+inline int loadOutputLatencyMs()
+{
+    QSettings s(configFilePath(), QSettings::IniFormat);
+    return s.value("Fx/OutputLatencyMs", kDefaultOutputLatencyMs).toInt();
+}
+
+inline void saveOutputLatencyMs(int ms)
+{
+    QSettings s(configFilePath(), QSettings::IniFormat);
+    s.setValue("Fx/OutputLatencyMs", ms);
+}
+
+// On-air decks mix into one shared output device instead of one sink each
+inline bool loadSharedOutput()
+{
+    QSettings s(configFilePath(), QSettings::IniFormat);
+    return s.value("Fx/SharedOutput", true).toBool();
+}
+
 inline bool loadRetune432()
 {
     QSettings s(configFilePath(), QSettings::IniFormat);
@@ -77,11 +105,34 @@ inline void saveRetune432(bool on)
     s.setValue("Fx/Retune432", on);
 }
 
+// Loudness normalization is global like the retune: every deck plays at
+// the same target, or the LP decks would jump out of the main programme
+inline bool loadNormalize()
+{
+    QSettings s(configFilePath(), QSettings::IniFormat);
+    return s.value("Fx/Normalize", false).toBool();
+}
+
+inline double loadNormalizeTargetLufs()
+{
+    QSettings s(configFilePath(), QSettings::IniFormat);
+    return s.value("Fx/NormalizeTargetLufs", -16.0).toDouble();
+}
+
+inline void saveNormalize(bool on, double targetLufs)
+{
+    QSettings s(configFilePath(), QSettings::IniFormat);
+    s.setValue("Fx/Normalize", on);
+    s.setValue("Fx/NormalizeTargetLufs", targetLufs);
+}
+
 inline FxParams loadChannel(const QString &channel)
 {
     QSettings s(configFilePath(), QSettings::IniFormat);
     FxParams p;
     p.retune432 = s.value("Fx/Retune432", false).toBool();
+    p.normalize = s.value("Fx/Normalize", false).toBool();
+    p.normalizeTargetLufs = s.value("Fx/NormalizeTargetLufs", -16.0).toDouble();
     const QString prefix = "Fx/" + channel + "/";
     p.eqEnabled = s.value(prefix + "EqEnabled", false).toBool();
     p.preampDb = s.value(prefix + "PreampDb", 0.0).toDouble();
@@ -98,8 +149,9 @@ inline FxParams loadChannel(const QString &channel)
 
 inline void saveChannel(const QString &channel, const FxParams &p)
 {
-    // Note: the global Fx/Retune432 key is only ever written by
-    // saveRetune432() (Options dialog) — channel saves must not touch it.
+    // Note: the global Fx/Retune432 and Fx/Normalize* keys are only ever
+    // written by saveRetune432() / saveNormalize() (Options dialog) —
+    // channel saves must not touch them.
     QSettings s(configFilePath(), QSettings::IniFormat);
     const QString prefix = "Fx/" + channel + "/";
     s.setValue(prefix + "EqEnabled", p.eqEnabled);
@@ -6,6 +6,15 @@
 #include <utility>
 
 #include "FxEngine.h"
+#include "FxMixer.h"
+#include "TrackAnalysisStore.h"
+#include "TrackCue.h"
+
+namespace
+{
+// Set and called on the GUI thread, like the players themselves
+FxPlayer::TrimLookup s_trimLookup;
+} // namespace
 
 FxPlayer::FxPlayer(QObject *parent)
     : QObject(parent)
@@ -19,7 +28,11 @@ FxPlayer::FxPlayer(QObject *parent)
     m_engine->moveToThread(&m_engineThread);
     connect(&m_engineThread, &QThread::finished, m_engine, &QObject::deleteLater);
     m_engineThread.setObjectName(QStringLiteral("FxEngineThread"));
-    m_engineThread.start();
+    // The engine renders the audio the sink pulls a few ms later: it must
+    // win against GUI and disk work for the CPU
+    m_engineThread.start(QThread::TimeCriticalPriority);
+    const int latencyMs = FxSettings::loadOutputLatencyMs();
+    engineCall([latencyMs](FxEngine *e) { e->setOutputLatency(latencyMs); });
 
     connect(m_engine, &FxEngine::positionChanged, this, [this](qint64 p) {
         if (m_mode == Mode::Fx) {
@@ -124,6 +137,24 @@ bool FxPlayer::fxAvailable()
     return FxEngine::available();
 }
 
+void FxPlayer::setTrimLookup(TrimLookup lookup)
+{
+    s_trimLookup = std::move(lookup);
+}
+
+void FxPlayer::lookupCue(const QString &path, TrackAnalysis *analysis, TrackCue *cue)
+{
+    qint64 trimStartMs = 0;
+    qint64 trimEndMs = 0;
+    if (s_trimLookup && !s_trimLookup(path, &trimStartMs, &trimEndMs)) {
+        trimStartMs = 0;
+        trimEndMs = 0;
+    }
+    *analysis = TrackAnalysis();
+    TrackAnalysisStore::loadCached(path, analysis);
+    *cue = TrackCue::resolve(*analysis, trimStartMs, trimEndMs);
+}
+
 namespace
 {
 bool isStreamUrl(const QUrl &url)
@@ -142,7 +173,7 @@ bool FxPlayer::wantFxFor(const QUrl &url) const
     // (stuck in LoadingMedia), while the ffmpeg CLI handles them fine.
     if (isStreamUrl(url))
         return true;
-    return (m_params.anyActive() || m_preferEngine) && url.isLocalFile();
+    return (m_params.anyActive() || m_preferEngine || m_mixer || m_streamTap) && url.isLocalFile();
 }
 
 void FxPlayer::setAudioOutput(QAudioOutput *output)
@@ -184,9 +215,16 @@ void FxPlayer::setSource(const QUrl &source)
         m_mode = Mode::Fx;
         m_fxState = QMediaPlayer::StoppedState;
         const QString path = source.isLocalFile() ? source.toLocalFile() : source.toString();
+        TrackAnalysis analysis;
+        TrackCue cue;
+        if (source.isLocalFile())
+            lookupCue(path, &analysis, &cue);
         // The engine adopts its preloaded decoder when one is armed for
         // this path; otherwise this is the normal cold start.
-        engineCall([path](FxEngine *e) { e->setSource(path); });
+        engineCall([path, analysis, cue](FxEngine *e) {
+            e->setSource(path, analysis, cue);
+        });
+        forwardEnvelope();
 
         emit sourceChanged(m_source);
         emit mediaStatusChanged(QMediaPlayer::LoadingMedia);
@@ -233,10 +271,16 @@ void FxPlayer::prepareNext(const QUrl &url)
 
     // Decide where the preload lives from what setSource() will pick for
     // this track (m_fxFailedForTrack is per-track state, so ignore it).
-    const bool nextWantsFx = fxAvailable() && (m_params.anyActive() || m_preferEngine);
+    const bool nextWantsFx = fxAvailable()
+                             && (m_params.anyActive() || m_preferEngine || m_mixer || m_streamTap);
     if (nextWantsFx) {
         const QString path = url.toLocalFile();
-        engineCall([path](FxEngine *e) { e->preloadNext(path); });
+        TrackAnalysis analysis;
+        TrackCue cue;
+        lookupCue(path, &analysis, &cue);
+        engineCall([path, analysis, cue](FxEngine *e) {
+            e->preloadNext(path, analysis, cue);
+        });
         m_preparedInEngine = true;
     } else {
         if (!m_qtStandby) {
@@ -371,6 +415,54 @@ void FxPlayer::setFxParams(const FxParams &params)
     }
 }
 
+void FxPlayer::setMixer(FxMixer *mixer)
+{
+    m_mixer = mixer;
+    FxMixBus *bus = mixer ? mixer->bus() : nullptr;
+    engineCall([bus](FxEngine *e) { e->setMixer(bus); });
+}
+
+void FxPlayer::setStreamTap(FxStreamTap *tap)
+{
+    m_streamTap = tap;
+    engineCall([tap](FxEngine *e) { e->setStreamTap(tap); });
+}
+
+void FxPlayer::setVolumeEnvelope(const QUrl &source, const QVector<QPointF> &points)
+{
+    m_envelopeSource = source;
+    m_envelope = FxEngine::volumeEnvelope(points);
+    // Sent even in passthrough: the engine keeps a line for a path that
+    // is not playing yet and installs it when that path starts there
+    const QString path = source.isLocalFile() ? source.toLocalFile() : source.toString();
+    const fxdsp::GainEnvelope envelope = m_envelope;
+    engineCall([path, envelope](FxEngine *e) { e->setVolumeEnvelope(path, envelope); });
+}
+
+void FxPlayer::forwardEnvelope()
+{
+    if (m_envelopeSource.isEmpty() || m_envelopeSource != m_source)
+        return;
+    const QString path = m_source.isLocalFile() ? m_source.toLocalFile() : m_source.toString();
+    const fxdsp::GainEnvelope envelope = m_envelope;
+    engineCall([path, envelope](FxEngine *e) { e->setVolumeEnvelope(path, envelope); });
+}
+
+void FxPlayer::setOutputLatency(int latencyMs)
+{
+    engineCall([latencyMs](FxEngine *e) { e->setOutputLatency(latencyMs); });
+}
+
+FxOutputStats FxPlayer::outputStats() const
+{
+    return m_engine->outputStats(); // atomics only: safe across threads
+}
+
+void FxPlayer::resetOutputStats()
+{
+    m_engine->resetOutputStats();
+}
+
 void FxPlayer::setDjFx(double filterAmount, double echoAmount)
 {
     engineCall([filterAmount, echoAmount](FxEngine *e) {
@@ -420,7 +512,14 @@ void FxPlayer::switchToFx(QMediaPlayer::PlaybackState resumeState, qint64 resume
     m_fxState = resumeState;
 
     const QString path = m_source.isLocalFile() ? m_source.toLocalFile() : m_source.toString();
-    engineCall([path](FxEngine *e) { e->setSource(path); });
+    TrackAnalysis analysis;
+    TrackCue cue;
+    if (m_source.isLocalFile())
+        lookupCue(path, &analysis, &cue);
+    engineCall([path, analysis, cue](FxEngine *e) {
+        e->setSource(path, analysis, cue);
+    });
+    forwardEnvelope(); // the engine dropped it when it went passthrough
     if (resumeState == QMediaPlayer::PlayingState) {
         engineCall([resumePos](FxEngine *e) {
             if (resumePos > 0)
@@ -3,13 +3,23 @@
 
 #include <QMediaPlayer>
 #include <QObject>
+#include <QPointF>
 #include <QThread>
 #include <QUrl>
+#include <QVector>
 
+#include <functional>
+
+#include "FxDsp.h"
+#include "FxOutput.h"
 #include "FxParams.h"
 
 class QAudioOutput;
 class FxEngine;
+class FxMixer;
+class FxStreamTap;
+struct TrackAnalysis;
+struct TrackCue;
 
 /**
  * @brief Drop-in player used by the XFB main window.
@@ -83,6 +93,41 @@ public:
     bool fxEngineActive() const { return m_mode == Mode::Fx; }
     static bool fxAvailable();
 
+    /**
+     * Stored silence trim of a local file (TrackTrimmer): where its audio
+     * starts and ends, in ms; false when the file has none. Called on the
+     * thread that sets the source — never on the engine thread, which
+     * renders audio and must not wait on the database.
+     */
+    using TrimLookup = std::function<bool(const QString &path, qint64 *startMs, qint64 *endMs)>;
+    /** Install the lookup for every player; an empty one turns trims off. */
+    static void setTrimLookup(TrimLookup lookup);
+    /**
+     * Cached analysis and cue of a local file (the stored trim through the
+     * lookup), unknown when there are none. Reads the trim store and the
+     * analysis cache: never call it on the engine thread. The offline
+     * renderer cues its tracks with it too.
+     */
+    static void lookupCue(const QString &path, TrackAnalysis *analysis, TrackCue *cue);
+
+    /**
+     * Volume line (x = ms, y = linear gain) of source, applied per sample
+     * inside the FX engine whenever that source plays there — including
+     * as the outgoing side of an engine crossfade. Plain playback cannot
+     * do that: while fxEngineActive() is false the caller still drives
+     * the line through the output volume.
+     */
+    void setVolumeEnvelope(const QUrl &source, const QVector<QPointF> &points);
+
+    /**
+     * FX engine output latency in ms (device buffer + render-ahead). The
+     * default comes from Fx/OutputLatencyMs in xfb.conf.
+     */
+    void setOutputLatency(int latencyMs);
+    /** Underrun counters and render-time histogram of the FX engine output. */
+    FxOutputStats outputStats() const;
+    void resetOutputStats();
+
     /**
      * Route local files through the FX engine even when no FX are enabled.
      * Used by the LP decks so scratching and the DJ effects are always
@@ -90,6 +135,22 @@ public:
      */
     void setPreferEngineAlways(bool on) { m_preferEngine = on; }
 
+    /**
+     * Play through the shared mixer (one device for all decks, summed
+     * sample-aligned) instead of a private sink; nullptr reverts. Local
+     * files then always take the engine path, since a passthrough
+     * QMediaPlayer cannot join the mix. The mixer must outlive the player.
+     */
+    void setMixer(FxMixer *mixer);
+
+    /**
+     * Feed the stream source with this player's output (post-FX, volume
+     * applied); nullptr stops. Like the mixer this implies the engine path
+     * for local files, from the next track on. The tap must outlive the
+     * player.
+     */
+    void setStreamTap(FxStreamTap *tap);
+
     // DJ performance controls — active only while the engine drives playback
     void setDjFx(double filterAmount, double echoAmount);
     void scratchBegin();
@@ -113,6 +174,7 @@ private:
 
     template <typename F> void engineCall(F &&f);
     bool wantFxFor(const QUrl &url) const;
+    void forwardEnvelope();
     void connectPassthrough(QMediaPlayer *p);
     void discardPrepared();
     void switchToFx(QMediaPlayer::PlaybackState resumeState, qint64 resumePos);
@@ -131,9 +193,13 @@ private:
     bool m_switching = false;        // suppress signal forwarding during internal mode switches
     bool m_fxFailedForTrack = false; // engine gave up on the current track
     bool m_preferEngine = false;     // LP decks: engine even without FX params
+    FxMixer *m_mixer = nullptr;      // shared output (implies the engine path)
+    FxStreamTap *m_streamTap = nullptr; // stream source feed (implies the engine path)
 
     QUrl m_source;
     FxParams m_params;
+    QUrl m_envelopeSource;           // track the last volume line belongs to
+    fxdsp::GainEnvelope m_envelope;
     QMediaPlayer::PlaybackState m_fxState = QMediaPlayer::StoppedState;
     qint64 m_fxPos = 0;
     qint64 m_fxDuration = 0;
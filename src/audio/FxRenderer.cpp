@@ -0,0 +1,628 @@
+#include "FxRenderer.h"
+
+#include "FrameRing.h"
+#include "FxDecoder.h"
+#include "FxDsp.h"
+#include "FxEngine.h"
+#include "TrackAnalysisStore.h"
+
+#include <QElapsedTimer>
+#include <QFile>
+#include <QMutex>
+#include <QProcess>
+#include <QThread>
+#include <QWaitCondition>
+#include <QtEndian>
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+namespace
+{
+constexpr int kSampleRate = FxEngine::kSampleRate;
+constexpr int kChannels = FxEngine::kChannels;
+constexpr int kChunkFrames = 2048;
+// Decoded audio a track keeps ahead of the mix before its end is known:
+// the engine's 12 s initial burst, so the auto-cue tail trim sees as much
+// trailing silence as it does on air
+constexpr size_t kTrimLookaheadFrames = size_t(12) * kSampleRate;
+
+qint64 framesToMs(qint64 frames)
+{
+    return frames * 1000 / kSampleRate;
+}
+
+/**
+ * One playlist entry being decoded on a thread of its own into a frame
+ * ring, as fast as the decoder goes; the render thread is the ring's
+ * consumer. Neither side polls: each waits on m_changed until the other
+ * has moved the ring (or a state flag), so a feed running ahead sleeps
+ * once its ring is full. Destruction stops the decode and joins the
+ * thread.
+ */
+class TrackFeed
+{
+public:
+    TrackFeed(const FxRenderer::Track &track, const FxParams &params)
+        : m_path(track.path)
+        , m_params(params)
+        , m_cue(track.cue)
+        , m_envelope(FxEngine::volumeEnvelope(track.volumeLine))
+    {
+        // The engine's FIFO: a feed running ahead of the mix decodes this
+        // much and then sleeps, so lookahead covers each track's probe,
+        // analysis, decoder start and first seconds, not the whole track
+        m_ring.reset(static_cast<size_t>(FxEngine::kFifoSeconds) * kSampleRate);
+        m_thread = QThread::create([this]() { run(); });
+        m_thread->start();
+    }
+
+    ~TrackFeed()
+    {
+        m_stop.store(true);
+        notify();
+        m_thread->wait();
+        delete m_thread;
+    }
+
+    /** Blocks until the track is probed and its decoder opened; false on failure. */
+    bool waitReady() const
+    {
+        QMutexLocker locker(&m_lock);
+        while (!m_ready.load(std::memory_order_acquire))
+            m_changed.wait(&m_lock);
+        return !m_failed.load(std::memory_order_acquire);
+    }
+
+    qint64 durationMs() const { return m_durationMs; }
+    const TrackCue &cue() const { return m_cue; }
+    /** Input frame the decode opened at: the cued start. */
+    qint64 startFrame() const { return m_cue.startMs * kSampleRate / 1000; }
+    QString errorString() const { return m_error; }
+    const QString &path() const { return m_path; }
+    const fxdsp::GainEnvelope &envelope() const { return m_envelope; }
+    bool decodeDone() const { return m_done.load(std::memory_order_acquire); }
+
+    /**
+     * Fill frames, waiting for the decoder; short only at the end of the
+     * track. While the decode runs, keepAhead frames stay buffered so the
+     * tail trim gets to see them (see trimTrailingSilence()).
+     */
+    size_t readFull(float *out, size_t frames, size_t keepAhead)
+    {
+        size_t got = 0;
+        while (got < frames) {
+            const bool done = decodeDone();
+            if (!done && m_ring.availableFrames() < frames - got + keepAhead) {
+                QMutexLocker locker(&m_lock);
+                if (!decodeDone() && m_ring.availableFrames() < frames - got + keepAhead)
+                    m_changed.wait(&m_lock);
+                continue;
+            }
+            const size_t n = m_ring.read(out + got * kChannels, frames - got);
+            got += n;
+            if (n > 0)
+                notify(); // the decoder may be waiting for room
+            if (n == 0 && done)
+                break;
+        }
+        return got;
+    }
+
+    /**
+     * Auto-cue, tail side, exactly as the engine does it once its decoder
+     * is exhausted: chop the encoded trailing silence off what is buffered.
+     * Only valid once decodeDone() (the ring then has no producer).
+     */
+    void trimTrailingSilence()
+    {
+        const size_t avail = m_ring.availableFrames();
+        size_t end = avail;
+        while (end > 0) {
+            const float *f = m_ring.frame(end - 1);
+            if (std::abs(f[0]) > FxEngine::kSilenceFloor || std::abs(f[1]) > FxEngine::kSilenceFloor)
+                break;
+            --end;
+        }
+        if (end < avail)
+            m_ring.dropNewest(avail - end);
+    }
+
+private:
+    void run()
+    {
+        bool is432 = false;
+        FxEngine::probeFile(m_path, &m_durationMs, &is432);
+        if (m_params.normalize) {
+            // Same gain the engine applies on air; a file not analysed yet
+            // is measured here first (one extra decode, on this thread)
+            const TrackAnalysis analysis = TrackAnalysisStore::analyze(m_path, &m_stop);
+            const double gainDb = analysis.normalizationGainDb(m_params.normalizeTargetLufs);
+            m_envelope.setTrim(std::pow(10.0, gainDb / 20.0));
+        }
+
+        // Every track plays from the top, so it opens at its cue the way
+        // the engine's cold start and preload do
+        FxEngine::DecodeRequest request;
+        request.path = m_path;
+        request.positionMs = m_cue.startMs;
+        request.retune = m_params.retune432 && !is432;
+        request.realtime = false;
+        request.waitForStart = true;
+        // No owner: the ffmpeg child (if any) lives in this thread
+        std::unique_ptr<FxDecoder> decoder = FxEngine::openDecoder(request, nullptr, &m_error);
+        if (!decoder) {
+            m_failed.store(true, std::memory_order_release);
+            m_done.store(true, std::memory_order_release);
+            m_ready.store(true, std::memory_order_release);
+            notify();
+            return;
+        }
+        m_ready.store(true, std::memory_order_release);
+        notify();
+
+        // This thread runs no event loop: a CLI decoder's pipe is only
+        // read when we wait on it explicitly
+        auto *process = dynamic_cast<ProcessDecoder *>(decoder.get());
+        while (!m_stop.load(std::memory_order_relaxed)) {
+            if (decoder->drainInto(m_ring) > 0) {
+                notify();
+                continue;
+            }
+            if (decoder->exhausted())
+                break;
+            if (m_ring.freeFrames() == 0) {
+                // The mix is behind (or this feed runs ahead): sleep until
+                // it reads
+                QMutexLocker locker(&m_lock);
+                if (m_ring.freeFrames() == 0 && !m_stop.load(std::memory_order_relaxed))
+                    m_changed.wait(&m_lock);
+            } else if (process) {
+                QProcess *proc = process->process();
+                if (!proc->waitForReadyRead(50) && proc->state() != QProcess::NotRunning)
+                    proc->waitForFinished(10);
+            }
+        }
+
+        if (!m_stop.load() && decoder->failed()) {
+            m_error = decoder->errorString();
+            m_failed.store(true, std::memory_order_release);
+        }
+        if (process && process->running()) {
+            // Stopped early: reap it here, the decoder's asynchronous reap
+            // needs an event loop
+            process->process()->kill();
+            process->process()->waitForFinished(1000);
+        }
+        decoder.reset();
+        m_done.store(true, std::memory_order_release);
+        notify();
+    }
+
+    /** Wake the other side; under the lock, so a waiter that has just
+        checked the ring cannot miss it. */
+    void notify() const
+    {
+        QMutexLocker locker(&m_lock);
+        m_changed.wakeAll();
+    }
+
+    QString m_path;
+    FxParams m_params;
+    TrackCue m_cue;
+    fxdsp::GainEnvelope m_envelope;
+    FrameRing m_ring{kChannels};
+    QThread *m_thread = nullptr;
+
+    // Written by the decode thread before m_ready / m_done are published
+    qint64 m_durationMs = 0;
+    QString m_error;
+    std::atomic<bool> m_ready{false};
+    std::atomic<bool> m_failed{false};
+    std::atomic<bool> m_done{false};
+    std::atomic<bool> m_stop{false};
+
+    mutable QMutex m_lock;
+    mutable QWaitCondition m_changed; // ring moved, or ready / done / stop
+};
+
+// ------------------------------------------------------------------ sinks
+
+/** Where the rendered PCM goes (48 kHz stereo float, clamped). */
+class RenderSink
+{
+public:
+    virtual ~RenderSink() = default;
+    virtual bool write(const float *interleaved, int frames) = 0;
+    /** Flush and close; false when the output is incomplete. */
+    virtual bool finish() = 0;
+    QString errorString() const { return m_error; }
+
+protected:
+    QString m_error;
+};
+
+class NullSink : public RenderSink
+{
+public:
+    bool write(const float *, int) override { return true; }
+    bool finish() override { return true; }
+};
+
+/** 32-bit float WAV, header patched with the sizes on finish(). */
+class WavSink : public RenderSink
+{
+public:
+    explicit WavSink(const QString &path)
+        : m_file(path)
+    {
+    }
+
+    bool open()
+    {
+        if (!m_file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+            m_error = m_file.errorString();
+            return false;
+        }
+        return writeHeader();
+    }
+
+    bool write(const float *interleaved, int frames) override
+    {
+        const qint64 bytes = qint64(frames) * kChannels * qint64(sizeof(float));
+        if (m_dataBytes + bytes > kMaxDataBytes) {
+            m_error = QStringLiteral("WAV output exceeds 4 GiB; use a compressed format");
+            return false;
+        }
+        if (m_file.write(reinterpret_cast<const char *>(interleaved), bytes) != bytes) {
+            m_error = m_file.errorString();
+            return false;
+        }
+        m_dataBytes += bytes;
+        return true;
+    }
+
+    bool finish() override
+    {
+        const bool ok = m_file.seek(0) && writeHeader();
+        if (!ok && m_error.isEmpty())
+            m_error = m_file.errorString();
+        m_file.close();
+        return ok;
+    }
+
+private:
+    static constexpr qint64 kHeaderBytes = 58;
+    static constexpr qint64 kMaxDataBytes = 0xFFFFFFFFLL - kHeaderBytes;
+
+    bool writeHeader()
+    {
+        // RIFF/WAVE with a WAVE_FORMAT_IEEE_FLOAT fmt chunk and the fact
+        // chunk non-PCM formats require
+        char h[kHeaderBytes];
+        const auto put32 = [&h](int at, quint32 v) { qToLittleEndian<quint32>(v, h + at); };
+        const auto put16 = [&h](int at, quint16 v) { qToLittleEndian<quint16>(v, h + at); };
+        const quint32 frames = quint32(m_dataBytes / (kChannels * qint64(sizeof(float))));
+        std::memcpy(h, "RIFF", 4);
+        put32(4, quint32(kHeaderBytes - 8 + m_dataBytes));
+        std::memcpy(h + 8, "WAVEfmt ", 8);
+        put32(16, 18);
+        put16(20, 3); // IEEE float
+        put16(22, kChannels);
+        put32(24, kSampleRate);
+        put32(28, kSampleRate * kChannels * quint32(sizeof(float)));
+        put16(32, kChannels * quint16(sizeof(float)));
+        put16(34, 32);
+        put16(36, 0);
+        std::memcpy(h + 38, "fact", 4);
+        put32(42, 4);
+        put32(46, frames);
+        std::memcpy(h + 50, "data", 4);
+        put32(54, quint32(m_dataBytes));
+        if (m_file.write(h, kHeaderBytes) != kHeaderBytes) {
+            m_error = m_file.errorString();
+            return false;
+        }
+        return true;
+    }
+
+    QFile m_file;
+    qint64 m_dataBytes = 0;
+};
+
+/** Any other format: raw float PCM piped into an ffmpeg encoder. */
+class EncoderSink : public RenderSink
+{
+public:
+    bool open(const QString &path)
+    {
+        const QString ffmpeg = FxEngine::ffmpegExecutable();
+        if (ffmpeg.isEmpty()) {
+            m_error = QStringLiteral("ffmpeg not found (needed to encode %1)").arg(path);
+            return false;
+        }
+        m_proc.setProcessChannelMode(QProcess::SeparateChannels);
+        m_proc.start(ffmpeg, {"-nostdin", "-loglevel", "error", "-y",
+                              "-f", "f32le", "-ar", QString::number(kSampleRate),
+                              "-ac", QString::number(kChannels), "-i", "-",
+                              "-vn", path});
+        if (!m_proc.waitForStarted(5000)) {
+            m_error = QStringLiteral("ffmpeg did not start: %1").arg(m_proc.errorString());
+            return false;
+        }
+        return true;
+    }
+
+    bool write(const float *interleaved, int frames) override
+    {
+        const qint64 bytes = qint64(frames) * kChannels * qint64(sizeof(float));
+        m_proc.write(reinterpret_cast<const char *>(interleaved), bytes);
+        // Bounded pipe backlog: the encoder runs in parallel, a few chunks
+        // behind at most
+        while (m_proc.bytesToWrite() > kMaxBacklogBytes) {
+            if (!m_proc.waitForBytesWritten(1000) && m_proc.state() == QProcess::NotRunning) {
+                m_error = encoderError();
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool finish() override
+    {
+        while (m_proc.bytesToWrite() > 0 && m_proc.state() != QProcess::NotRunning)
+            m_proc.waitForBytesWritten(1000);
+        m_proc.closeWriteChannel();
+        m_proc.waitForFinished(-1);
+        if (m_proc.exitStatus() != QProcess::NormalExit || m_proc.exitCode() != 0) {
+            m_error = encoderError();
+            return false;
+        }
+        return true;
+    }
+
+private:
+    static constexpr qint64 kMaxBacklogBytes = qint64(1) << 20;
+
+    QString encoderError()
+    {
+        const QString err = QString::fromLocal8Bit(m_proc.readAllStandardError()).trimmed();
+        return QStringLiteral("ffmpeg encoder failed: %1")
+            .arg(err.isEmpty() ? m_proc.errorString() : err);
+    }
+
+    QProcess m_proc;
+};
+
+std::unique_ptr<RenderSink> openSink(const QString &outputPath, QString *error)
+{
+    if (outputPath == QLatin1String("null"))
+        return std::make_unique<NullSink>();
+    if (outputPath.endsWith(QLatin1String(".wav"), Qt::CaseInsensitive)) {
+        auto wav = std::make_unique<WavSink>(outputPath);
+        if (!wav->open()) {
+            *error = wav->errorString();
+            return nullptr;
+        }
+        return wav;
+    }
+    auto encoder = std::make_unique<EncoderSink>();
+    if (!encoder->open(outputPath)) {
+        *error = encoder->errorString();
+        return nullptr;
+    }
+    return encoder;
+}
+
+/** The outgoing track of an overlap, fading under the incoming one. */
+struct CrossfadeTail
+{
+    std::unique_ptr<TrackFeed> feed;
+    double gain = 0.0;
+    double step = 0.0;  // per-frame decrement
+    qint64 frame = 0;   // input frame of the next tail frame (volume line)
+};
+} // namespace
+
+FxRenderer::FxRenderer(const FxParams &params)
+    : m_params(params)
+{
+}
+
+int FxRenderer::effectiveLookahead() const
+{
+    if (m_lookahead > 0)
+        return m_lookahead;
+    // One decode thread per core the mix thread leaves free
+    return std::clamp(QThread::idealThreadCount() - 1, 1, 8);
+}
+
+bool FxRenderer::render(const QList<Track> &tracks, const QString &outputPath, Result *result,
+                        QString *error)
+{
+    QElapsedTimer wall;
+    wall.start();
+    Result res;
+    QString err;
+
+    if (tracks.isEmpty()) {
+        *error = QStringLiteral("nothing to render: the playlist is empty");
+        return false;
+    }
+    std::unique_ptr<RenderSink> sink = openSink(outputPath, &err);
+    if (!sink) {
+        *error = err;
+        return false;
+    }
+
+    fxdsp::Equalizer eq;
+    fxdsp::Compressor comp;
+    eq.configure(kSampleRate, m_params);
+    comp.configure(kSampleRate, m_params);
+    float peakL = 0.0f, peakR = 0.0f; // finishOutput() wants a meter
+
+    // Feeds run ahead of the track being mixed, one decode thread each
+    const int count = static_cast<int>(tracks.size());
+    const int lookahead = effectiveLookahead();
+    std::vector<std::unique_ptr<TrackFeed>> feeds(static_cast<size_t>(count));
+    const auto startFeeds = [&](int from) {
+        for (int i = from; i < std::min(count, from + 1 + lookahead); ++i) {
+            if (!feeds[i])
+                feeds[i] = std::make_unique<TrackFeed>(tracks[i], m_params);
+        }
+    };
+
+    std::vector<float> chunk(static_cast<size_t>(kChunkFrames) * kChannels);
+    std::vector<float> tailBuf(chunk.size());
+    CrossfadeTail tail;
+    int cur = 0;
+    qint64 curFrame = 0;        // frames of the current track consumed since its cue
+    bool leadSkipped = tracks[0].cue.startKnown; // auto-cue: leading silence handled
+    bool tailTrimmed = tracks[0].cue.endKnown(); // auto-cue: trailing silence handled
+    qint64 renderedFrames = 0;
+    qint64 nextProgress = 0;
+    bool ok = true;
+    startFeeds(0);
+
+    const auto mixTail = [&](float *out, int frames) {
+        if (!tail.feed)
+            return;
+        const size_t n = tail.feed->readFull(tailBuf.data(), static_cast<size_t>(frames), 0);
+        tail.feed->envelope().apply(tailBuf.data(), static_cast<int>(n), tail.frame);
+        tail.frame += static_cast<qint64>(n);
+        for (size_t i = 0; i < n * kChannels; i += kChannels) {
+            const float g = static_cast<float>(tail.gain);
+            out[i] += tailBuf[i] * g;
+            out[i + 1] += tailBuf[i + 1] * g;
+            tail.gain = std::max(0.0, tail.gain - tail.step);
+        }
+        if (tail.gain <= 0.0 || n < static_cast<size_t>(frames))
+            tail.feed.reset();
+    };
+
+    while (ok) {
+        TrackFeed &feed = *feeds[cur];
+        if (curFrame == 0 && !feed.waitReady()) {
+            err = QStringLiteral("%1: %2").arg(feed.path(), feed.errorString());
+            ok = false;
+            break;
+        }
+        if (!tailTrimmed && feed.decodeDone()) {
+            tailTrimmed = true;
+            feed.trimTrailingSilence();
+        }
+
+        // Input timeline of the track (the volume line's), which starts
+        // at its cue
+        const qint64 chunkFrame = feed.startFrame() + curFrame;
+
+        // Overlap segue: the next track starts overlapMs before this one
+        // ends (by its probed duration, as the playlist times it on air)
+        int want = kChunkFrames;
+        const int next = cur + 1;
+        if (next < count && tracks[next].overlapMs > 0 && feed.durationMs() > 0) {
+            const qint64 startMs = std::max<qint64>(0, feed.durationMs() - tracks[next].overlapMs);
+            const qint64 triggerFrame = startMs * kSampleRate / 1000;
+            if (chunkFrame >= triggerFrame) {
+                startFeeds(next);
+                const qint64 fadeMs = std::clamp(feed.durationMs() - framesToMs(chunkFrame),
+                                                 qint64(200), qint64(600000));
+                tail.feed = std::move(feeds[cur]);
+                tail.gain = 1.0;
+                tail.step = 1000.0 / (double(fadeMs) * kSampleRate);
+                tail.frame = chunkFrame;
+                cur = next;
+                curFrame = 0;
+                leadSkipped = true; // a crossfaded start keeps its head
+                tailTrimmed = tracks[cur].cue.endKnown();
+                continue;
+            }
+            want = static_cast<int>(std::min<qint64>(want, triggerFrame - chunkFrame));
+        }
+        // Cue, tail side: the track ends where its audio does, whatever
+        // silence the file still holds after that
+        if (feed.cue().endMs > 0) {
+            const qint64 left = feed.cue().endMs * kSampleRate / 1000 - chunkFrame;
+            want = static_cast<int>(std::clamp<qint64>(left, 0, want));
+        }
+
+        const int got = want <= 0 ? 0 : static_cast<int>(
+            feed.readFull(chunk.data(), static_cast<size_t>(want),
+                          tailTrimmed ? 0 : kTrimLookaheadFrames));
+        if (got <= 0) {
+            // Track over: gapless handoff to the next one, cold-start cued
+            feeds[cur].reset();
+            if (next >= count)
+                break;
+            cur = next;
+            curFrame = 0;
+            leadSkipped = tracks[cur].cue.startKnown;
+            tailTrimmed = tracks[cur].cue.endKnown();
+            startFeeds(cur);
+            continue;
+        }
+        curFrame += got;
+        if (curFrame == got)
+            ++res.tracks;
+
+        // Lead skip on the decoded samples, then the volume line, as in
+        // FxEngine::pump
+        int offset = 0;
+        int frames = got;
+        if (!leadSkipped) {
+            int firstLoud = -1;
+            for (int i = 0; i < got * kChannels; ++i) {
+                if (std::abs(chunk[i]) > FxEngine::kSilenceFloor) {
+                    firstLoud = i / kChannels;
+                    break;
+                }
+            }
+            if (firstLoud < 0) {
+                if (framesToMs(curFrame) > FxEngine::kLeadSkipCapMs)
+                    leadSkipped = true; // quiet piece, stop scanning
+                continue;
+            }
+            leadSkipped = true;
+            offset = firstLoud;
+            frames = got - firstLoud;
+        }
+        float *out = chunk.data() + static_cast<size_t>(offset) * kChannels;
+        feed.envelope().apply(out, frames, chunkFrame + offset);
+
+        mixTail(out, frames);
+        eq.processVectorized(out, frames);
+        comp.processBlockRate(out, frames);
+        fxdsp::finishOutput(out, frames, peakL, peakR, nullptr);
+        if (!sink->write(out, frames)) {
+            err = sink->errorString();
+            ok = false;
+            break;
+        }
+
+        renderedFrames += frames;
+        if (m_progress && renderedFrames >= nextProgress) {
+            nextProgress = renderedFrames + kSampleRate;
+            m_progress(cur, framesToMs(renderedFrames));
+        }
+    }
+
+    // Joins the decode threads still running ahead
+    tail.feed.reset();
+    feeds.clear();
+
+    if (!sink->finish() && ok) {
+        err = sink->errorString();
+        ok = false;
+    }
+    res.renderedMs = framesToMs(renderedFrames);
+    res.elapsedMs = wall.elapsed();
+    if (result)
+        *result = res;
+    if (!ok)
+        *error = err;
+    return ok;
+}
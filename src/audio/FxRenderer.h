@@ -0,0 +1,76 @@
+#ifndef FXRENDERER_H
+#define FXRENDERER_H
+
+#include <QList>
+#include <QPointF>
+#include <QString>
+#include <QVector>
+
+#include <functional>
+
+#include "FxParams.h"
+#include "TrackCue.h"
+
+/**
+ * @brief Offline bounce of a playlist through the FX engine's signal path.
+ *
+ * Renders a whole playlist to one file as it would sound on air: the same
+ * decoders, volume lines, auto-cue (each track opens and ends at its
+ * cue; without one, leading silence is skipped on cold starts and
+ * trailing silence trimmed), gapless segues, overlap crossfades
+ * (the outgoing track fades linearly under the incoming one, as the
+ * engine's crossfade tail does), loudness normalization when the params
+ * ask for it, and the EQ / compressor / safety clamp chain. There is no
+ * QAudioSink and no pacing: decode runs as fast as it can, each upcoming
+ * track on a thread of its own, while the calling thread mixes, processes
+ * and hands the result to the encoder. A track decoded ahead fills one
+ * engine FIFO (FxEngine::kFifoSeconds) and then waits for the mix.
+ *
+ * Output: ".wav" is written directly (32-bit float, 48 kHz stereo); any
+ * other extension is encoded by an ffmpeg child process, format chosen
+ * from the extension. The path "null" discards the audio (benchmarks).
+ *
+ * render() blocks; use it from a worker thread or a command-line run.
+ */
+class FxRenderer
+{
+public:
+    struct Track
+    {
+        QString path;
+        qint64 overlapMs = 0;         // starts this long before the previous track ends
+        QVector<QPointF> volumeLine;  // x = ms, y = linear gain (PlaylistWaveView format)
+        TrackCue cue;                 // as the engine gets it (FxPlayer::lookupCue)
+    };
+
+    struct Result
+    {
+        int tracks = 0;            // tracks that contributed audio
+        qint64 renderedMs = 0;     // length of the bounce
+        qint64 elapsedMs = 0;      // wall time it took
+        double speed() const { return elapsedMs > 0 ? double(renderedMs) / elapsedMs : 0.0; }
+    };
+
+    /** Called on the rendering thread, about once per rendered second. */
+    using ProgressCallback = std::function<void(int trackIndex, qint64 renderedMs)>;
+
+    explicit FxRenderer(const FxParams &params);
+
+    /** Tracks opened and decoded ahead of the one being mixed, each up to
+        one FIFO of audio; 0 = one per spare core. */
+    void setLookahead(int tracks) { m_lookahead = tracks; }
+    void setProgressCallback(ProgressCallback callback) { m_progress = std::move(callback); }
+
+    /** Bounce tracks to outputPath. False with error set when it fails. */
+    bool render(const QList<Track> &tracks, const QString &outputPath, Result *result,
+                QString *error);
+
+private:
+    int effectiveLookahead() const;
+
+    FxParams m_params;
+    int m_lookahead = 0;
+    ProgressCallback m_progress;
+};
+
+#endif // FXRENDERER_H
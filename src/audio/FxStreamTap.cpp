@@ -0,0 +1,29 @@
+#include "FxStreamTap.h"
+
+#include <algorithm>
+
+FxStreamTap::FxStreamTap()
+    : m_ring(kChannels)
+{
+    m_ring.reset(static_cast<size_t>(kSampleRate) * kCapacityMs / 1000);
+}
+
+void FxStreamTap::push(const float *interleaved, size_t frames, float gain)
+{
+    if (frames == 0 || !isEnabled())
+        return;
+
+    FrameRing::Region a, b;
+    const size_t n = m_ring.prepareWrite(frames, a, b);
+    if (n < frames)
+        m_dropped.fetch_add(frames - n, std::memory_order_relaxed);
+    if (n == 0)
+        return;
+
+    const size_t firstSamples = a.frames * kChannels;
+    std::transform(interleaved, interleaved + firstSamples, a.data,
+                   [gain](float s) { return s * gain; });
+    std::transform(interleaved + firstSamples, interleaved + n * kChannels, b.data,
+                   [gain](float s) { return s * gain; });
+    m_ring.commitWrite(n);
+}
@@ -0,0 +1,60 @@
+#ifndef FXSTREAMTAP_H
+#define FXSTREAMTAP_H
+
+#include "FrameRing.h"
+
+#include <QtGlobal>
+
+#include <atomic>
+#include <cstddef>
+
+/**
+ * @brief Copy of the on-air output for the stream encoders.
+ *
+ * The audio side (FxEngine::writeChunkToSink() for a deck with its own
+ * sink, FxMixBus::readData() for the shared output) pushes each finished
+ * block here, at the level the listeners in the studio hear. The stream
+ * source drains it on its own thread. Both sides are lock-free: when the
+ * consumer falls behind the newest frames are dropped and counted, the
+ * audio path never waits for the network.
+ *
+ * Exactly one producer may push at a time.
+ */
+class FxStreamTap
+{
+public:
+    static constexpr int kChannels = 2;
+    static constexpr int kSampleRate = 48000;
+    // Consumer slack before frames are dropped
+    static constexpr int kCapacityMs = 2000;
+
+    FxStreamTap();
+
+    FxStreamTap(const FxStreamTap &) = delete;
+    FxStreamTap &operator=(const FxStreamTap &) = delete;
+
+    /** Any thread: push() does nothing while disabled (the default). */
+    void setEnabled(bool enabled) { m_enabled.store(enabled, std::memory_order_release); }
+    bool isEnabled() const { return m_enabled.load(std::memory_order_acquire); }
+
+    // --- producer ---------------------------------------------------------
+
+    /** Copy frames in, scaled by gain; whatever does not fit is dropped. */
+    void push(const float *interleaved, size_t frames, float gain = 1.0f);
+
+    // --- consumer ---------------------------------------------------------
+
+    size_t read(float *interleaved, size_t frames) { return m_ring.read(interleaved, frames); }
+    size_t availableFrames() const { return m_ring.availableFrames(); }
+    /** Drop everything buffered (stale audio from before a start). */
+    void discardAll() { m_ring.discard(m_ring.availableFrames()); }
+    /** Frames lost to a full ring since construction. */
+    quint64 droppedFrames() const { return m_dropped.load(std::memory_order_relaxed); }
+
+private:
+    FrameRing m_ring;
+    std::atomic<bool> m_enabled{false};
+    std::atomic<quint64> m_dropped{0};
+};
+
+#endif // FXSTREAMTAP_H
@@ -0,0 +1,289 @@
+#include "LibavDecoder.h"
+
+#include "FrameRing.h"
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+#include <libavformat/avformat.h>
+#include <libavutil/channel_layout.h>
+#include <libavutil/dict.h>
+#include <libswresample/swresample.h>
+}
+
+#include <algorithm>
+
+namespace
+{
+QString avErrorText(int err)
+{
+    char buf[AV_ERROR_MAX_STRING_SIZE] = {0};
+    av_strerror(err, buf, sizeof(buf));
+    return QString::fromUtf8(buf);
+}
+
+/** Same marker the ffprobe path looks for: files converted by XFB carry
+    an embedded tuning tag and must not be retuned a second time. */
+bool hasTuningMarker(const AVDictionary *dict)
+{
+    const AVDictionaryEntry *e = nullptr;
+    while ((e = av_dict_get(dict, "", e, AV_DICT_IGNORE_SUFFIX))) {
+        const QString key = QString::fromUtf8(e->key);
+        const QString value = QString::fromUtf8(e->value);
+        if ((key.compare(QStringLiteral("xfb_tuning"), Qt::CaseInsensitive) == 0
+             && value.startsWith(QStringLiteral("432")))
+            || value.contains(QStringLiteral("XFB-432Hz"), Qt::CaseInsensitive)) {
+            return true;
+        }
+    }
+    return false;
+}
+} // namespace
+
+LibavDecoder::~LibavDecoder()
+{
+    av_frame_free(&m_frame);
+    av_packet_free(&m_packet);
+    swr_free(&m_swr);
+    avcodec_free_context(&m_codec);
+    avformat_close_input(&m_fmt);
+}
+
+std::unique_ptr<LibavDecoder> LibavDecoder::open(const QString &path, qint64 positionMs,
+                                                 int sampleRate, int channels,
+                                                 QString *error)
+{
+    std::unique_ptr<LibavDecoder> dec(new LibavDecoder);
+    dec->m_sampleRate = sampleRate;
+    dec->m_channels = channels;
+
+    const auto bail = [&](const QString &what, int err) {
+        if (error)
+            *error = QStringLiteral("%1: %2").arg(what, avErrorText(err));
+        return nullptr;
+    };
+
+    int err = avformat_open_input(&dec->m_fmt, path.toUtf8().constData(), nullptr, nullptr);
+    if (err < 0)
+        return bail(QStringLiteral("open"), err);
+    err = avformat_find_stream_info(dec->m_fmt, nullptr);
+    if (err < 0)
+        return bail(QStringLiteral("stream info"), err);
+
+    const AVCodec *codec = nullptr;
+    dec->m_stream = av_find_best_stream(dec->m_fmt, AVMEDIA_TYPE_AUDIO, -1, -1, &codec, 0);
+    if (dec->m_stream < 0 || !codec)
+        return bail(QStringLiteral("no audio stream"), dec->m_stream);
+    // Cover art and other streams: don't even demux them
+    for (unsigned i = 0; i < dec->m_fmt->nb_streams; ++i) {
+        if (int(i) != dec->m_stream)
+            dec->m_fmt->streams[i]->discard = AVDISCARD_ALL;
+    }
+
+    AVStream *stream = dec->m_fmt->streams[dec->m_stream];
+    dec->m_codec = avcodec_alloc_context3(codec);
+    if (!dec->m_codec)
+        return bail(QStringLiteral("codec context"), AVERROR(ENOMEM));
+    err = avcodec_parameters_to_context(dec->m_codec, stream->codecpar);
+    if (err < 0)
+        return bail(QStringLiteral("codec parameters"), err);
+    dec->m_codec->pkt_timebase = stream->time_base;
+    err = avcodec_open2(dec->m_codec, codec, nullptr);
+    if (err < 0)
+        return bail(QStringLiteral("codec open"), err);
+
+    AVChannelLayout inLayout;
+    if (dec->m_codec->ch_layout.order == AV_CHANNEL_ORDER_UNSPEC)
+        av_channel_layout_default(&inLayout, dec->m_codec->ch_layout.nb_channels);
+    else
+        av_channel_layout_copy(&inLayout, &dec->m_codec->ch_layout);
+    AVChannelLayout outLayout;
+    av_channel_layout_default(&outLayout, channels);
+    err = swr_alloc_set_opts2(&dec->m_swr, &outLayout, AV_SAMPLE_FMT_FLT, sampleRate,
+                              &inLayout, dec->m_codec->sample_fmt,
+                              dec->m_codec->sample_rate, 0, nullptr);
+    av_channel_layout_uninit(&inLayout);
+    av_channel_layout_uninit(&outLayout);
+    if (err < 0 || (err = swr_init(dec->m_swr)) < 0)
+        return bail(QStringLiteral("resampler"), err);
+
+    dec->m_packet = av_packet_alloc();
+    dec->m_frame = av_frame_alloc();
+    if (!dec->m_packet || !dec->m_frame)
+        return bail(QStringLiteral("frame"), AVERROR(ENOMEM));
+
+    // Room for a generous decoded frame, so the pump never reallocates
+    dec->m_pending.reserve(static_cast<size_t>(sampleRate) * channels);
+
+    if (positionMs > 0) {
+        if (!dec->seek(positionMs))
+            return bail(QStringLiteral("seek"), AVERROR(EINVAL));
+    } else {
+        dec->m_targetFrame = 0;
+        dec->m_nextFrame = 0;
+    }
+    return dec;
+}
+
+bool LibavDecoder::probe(const QString &path, qint64 *durationMs, bool *is432)
+{
+    AVFormatContext *fmt = nullptr;
+    if (avformat_open_input(&fmt, path.toUtf8().constData(), nullptr, nullptr) < 0)
+        return false;
+
+    bool ok = avformat_find_stream_info(fmt, nullptr) >= 0;
+    if (ok) {
+        if (fmt->duration != AV_NOPTS_VALUE && fmt->duration > 0)
+            *durationMs = fmt->duration / (AV_TIME_BASE / 1000);
+        bool marked = hasTuningMarker(fmt->metadata);
+        for (unsigned i = 0; i < fmt->nb_streams && !marked; ++i)
+            marked = hasTuningMarker(fmt->streams[i]->metadata);
+        if (marked)
+            *is432 = true;
+        ok = *durationMs > 0;
+    }
+    avformat_close_input(&fmt);
+    return ok;
+}
+
+bool LibavDecoder::seek(qint64 positionMs)
+{
+    AVStream *stream = m_fmt->streams[m_stream];
+    int64_t ts = av_rescale_q(positionMs, AVRational{1, 1000}, stream->time_base);
+    if (stream->start_time != AV_NOPTS_VALUE)
+        ts += stream->start_time;
+
+    // Land on the packet at or before the target; decodeMore() then drops
+    // the audio in between, so playback resumes on the exact frame.
+    if (av_seek_frame(m_fmt, m_stream, ts, AVSEEK_FLAG_BACKWARD) < 0)
+        return false;
+    avcodec_flush_buffers(m_codec);
+    swr_close(m_swr);
+    swr_init(m_swr);
+
+    m_targetFrame = positionMs * m_sampleRate / 1000;
+    m_nextFrame = -1;
+    m_pending.clear();
+    m_pendingPos = 0;
+    m_eof = false;
+    m_inputDone = false;
+    return true;
+}
+
+size_t LibavDecoder::drainInto(FrameRing &ring)
+{
+    const size_t budget = std::min(ring.freeFrames(),
+                                   static_cast<size_t>(kMaxSecondsPerDrain) * m_sampleRate);
+    const size_t ch = static_cast<size_t>(m_channels);
+    size_t added = 0;
+
+    while (added < budget) {
+        if (hasPendingOutput()) {
+            const size_t want = std::min((m_pending.size() - m_pendingPos) / ch, budget - added);
+            const size_t n = ring.write(m_pending.data() + m_pendingPos, want);
+            m_pendingPos += n * ch;
+            added += n;
+            if (n < want)
+                break; // ring full
+            continue;
+        }
+        if (m_eof || !decodeMore())
+            break;
+    }
+    return added;
+}
+
+bool LibavDecoder::decodeMore()
+{
+    while (true) {
+        int err = avcodec_receive_frame(m_codec, m_frame);
+        if (err == 0) {
+            convertFrame(m_frame);
+            av_frame_unref(m_frame);
+            return !m_failed;
+        }
+        if (err == AVERROR_EOF) {
+            convertFrame(nullptr); // flush what the resampler still holds
+            m_eof = true;
+            return hasPendingOutput();
+        }
+        if (err != AVERROR(EAGAIN)) {
+            fail(QStringLiteral("decode"), err);
+            return false;
+        }
+
+        err = av_read_frame(m_fmt, m_packet);
+        if (err == AVERROR_EOF) {
+            if (m_inputDone) {
+                m_eof = true;
+                return false;
+            }
+            m_inputDone = true;
+            avcodec_send_packet(m_codec, nullptr); // enter draining mode
+            continue;
+        }
+        if (err < 0) {
+            fail(QStringLiteral("read"), err);
+            return false;
+        }
+        if (m_packet->stream_index == m_stream) {
+            err = avcodec_send_packet(m_codec, m_packet);
+            // A corrupt packet is skipped, like the CLI does
+            if (err < 0 && err != AVERROR(EAGAIN) && err != AVERROR_INVALIDDATA) {
+                av_packet_unref(m_packet);
+                fail(QStringLiteral("decode"), err);
+                return false;
+            }
+        }
+        av_packet_unref(m_packet);
+    }
+}
+
+void LibavDecoder::convertFrame(const AVFrame *frame)
+{
+    if (frame && m_nextFrame < 0) {
+        // First audio after a seek: place it on the output timeline
+        const AVStream *stream = m_fmt->streams[m_stream];
+        int64_t pts = frame->best_effort_timestamp;
+        if (pts == AV_NOPTS_VALUE) {
+            m_nextFrame = m_targetFrame; // unknown: trust the container seek
+        } else {
+            if (stream->start_time != AV_NOPTS_VALUE)
+                pts -= stream->start_time;
+            m_nextFrame = av_rescale_q(pts, stream->time_base, AVRational{1, m_sampleRate});
+        }
+    }
+
+    const int inSamples = frame ? frame->nb_samples : 0;
+    const int maxOut = swr_get_out_samples(m_swr, inSamples);
+    if (maxOut <= 0)
+        return;
+
+    // Only called once the previous output was fully handed to the ring
+    m_pending.resize(static_cast<size_t>(maxOut) * m_channels);
+    m_pendingPos = 0;
+    uint8_t *out = reinterpret_cast<uint8_t *>(m_pending.data());
+    const int got = swr_convert(m_swr, &out, maxOut,
+                                frame ? const_cast<const uint8_t **>(frame->extended_data) : nullptr,
+                                inSamples);
+    if (got < 0) {
+        m_pending.clear();
+        fail(QStringLiteral("resample"), got);
+        return;
+    }
+    m_pending.resize(static_cast<size_t>(got) * m_channels);
+
+    // Sample-accurate seek: drop whatever precedes the requested frame
+    if (m_nextFrame >= 0 && m_nextFrame < m_targetFrame) {
+        const qint64 drop = std::min<qint64>(got, m_targetFrame - m_nextFrame);
+        m_pendingPos = static_cast<size_t>(drop) * m_channels;
+    }
+    if (m_nextFrame >= 0)
+        m_nextFrame += got;
+}
+
+void LibavDecoder::fail(const QString &what, int err)
+{
+    m_failed = true;
+    m_eof = true;
+    m_error = QStringLiteral("%1: %2").arg(what, avErrorText(err));
+}
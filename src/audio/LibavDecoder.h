@@ -0,0 +1,90 @@
+#ifndef LIBAVDECODER_H
+#define LIBAVDECODER_H
+
+#include "FxDecoder.h"
+
+#include <memory>
+#include <vector>
+
+struct AVCodecContext;
+struct AVFormatContext;
+struct AVFrame;
+struct AVPacket;
+struct SwrContext;
+
+/**
+ * @brief In-process decoder on libavformat / libavcodec / libswresample.
+ *
+ * Only built when XFB_HAVE_LIBAV is defined. Compared to the ffmpeg CLI
+ * pipe it costs no fork/exec per track, probes without a second process
+ * and seeks sample-accurately: after the container seek lands on the
+ * preceding packet, the decoded audio up to the exact target frame is
+ * dropped.
+ *
+ * Decoding is pulled: drainInto() decodes on the caller's (engine) thread
+ * only as much as the ring can take, capped per call so a cold start
+ * spreads its burst over a few pumps instead of stalling one.
+ */
+class LibavDecoder : public FxDecoder
+{
+public:
+    ~LibavDecoder() override;
+
+    /**
+     * Open a local file and position it at positionMs. Returns nullptr and
+     * sets error when the file cannot be decoded in-process; the engine
+     * then falls back to the ffmpeg CLI.
+     */
+    static std::unique_ptr<LibavDecoder> open(const QString &path, qint64 positionMs,
+                                              int sampleRate, int channels,
+                                              QString *error);
+
+    /**
+     * Duration and XFB 432 Hz tuning marker of a local file, read from the
+     * container in-process (the ffprobe replacement). False when unreadable.
+     */
+    static bool probe(const QString &path, qint64 *durationMs, bool *is432);
+
+    size_t drainInto(FrameRing &ring) override;
+    bool running() const override { return !m_eof; }
+    bool hasPendingOutput() const override { return m_pendingPos < m_pending.size(); }
+    bool failed() const override { return m_failed; }
+    QString errorString() const override { return m_error; }
+
+    /** Reposition in place (no reopen); the next frames start exactly there. */
+    bool seek(qint64 positionMs);
+
+    // Decode at most ~1 s of audio per drainInto() call
+    static constexpr int kMaxSecondsPerDrain = 1;
+
+private:
+    LibavDecoder() = default;
+    bool decodeMore();
+    void convertFrame(const AVFrame *frame);
+    void fail(const QString &what, int err);
+
+    AVFormatContext *m_fmt = nullptr;
+    AVCodecContext *m_codec = nullptr;
+    SwrContext *m_swr = nullptr;
+    AVPacket *m_packet = nullptr;
+    AVFrame *m_frame = nullptr;
+    int m_stream = -1;
+    int m_sampleRate = 48000;
+    int m_channels = 2;
+
+    bool m_eof = false;
+    bool m_inputDone = false;     // demuxer drained, decoder being flushed
+    bool m_failed = false;
+    QString m_error;
+
+    // Sample-accurate seek: absolute output frame the caller asked for, and
+    // the output frame the next decoded audio starts at (-1 = not yet known)
+    qint64 m_targetFrame = 0;
+    qint64 m_nextFrame = -1;
+
+    // Converted frames the ring had no room for
+    std::vector<float> m_pending;
+    size_t m_pendingPos = 0;
+};
+
+#endif // LIBAVDECODER_H
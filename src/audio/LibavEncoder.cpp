@@ -0,0 +1,282 @@
+#include "LibavEncoder.h"
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+#include <libavformat/avformat.h>
+#include <libavutil/channel_layout.h>
+#include <libavutil/dict.h>
+#include <libswresample/swresample.h>
+}
+
+#include <array>
+
+namespace
+{
+QString avErrorText(int err)
+{
+    char buf[AV_ERROR_MAX_STRING_SIZE] = {0};
+    av_strerror(err, buf, sizeof(buf));
+    return QString::fromUtf8(buf);
+}
+
+constexpr int kIoBufferSize = 16 * 1024;
+
+// AVIO write callback: muxed bytes land in the encoder's output buffer
+#if LIBAVFORMAT_VERSION_MAJOR >= 61
+int appendOutput(void *opaque, const uint8_t *buf, int size)
+#else
+int appendOutput(void *opaque, uint8_t *buf, int size)
+#endif
+{
+    static_cast<QByteArray *>(opaque)->append(reinterpret_cast<const char *>(buf), size);
+    return size;
+}
+
+/** Sample format to encode in: float when the codec takes it, else the first it offers. */
+AVSampleFormat encoderSampleFormat(const AVCodec *codec)
+{
+    const AVSampleFormat *formats = nullptr;
+    int count = 0;
+#if LIBAVCODEC_VERSION_INT >= AV_VERSION_INT(61, 13, 100)
+    const void *configs = nullptr;
+    if (avcodec_get_supported_config(nullptr, codec, AV_CODEC_CONFIG_SAMPLE_FORMAT, 0,
+                                     &configs, &count) < 0)
+        count = 0;
+    formats = static_cast<const AVSampleFormat *>(configs);
+#else
+    formats = codec->sample_fmts;
+    while (formats && formats[count] != AV_SAMPLE_FMT_NONE)
+        ++count;
+#endif
+    if (!formats || count == 0)
+        return AV_SAMPLE_FMT_FLT;
+    const std::array<AVSampleFormat, 4> preferred = {AV_SAMPLE_FMT_FLT, AV_SAMPLE_FMT_FLTP,
+                                                     AV_SAMPLE_FMT_S16, AV_SAMPLE_FMT_S16P};
+    for (AVSampleFormat want : preferred) {
+        for (int i = 0; i < count; ++i) {
+            if (formats[i] == want)
+                return want;
+        }
+    }
+    return formats[0];
+}
+} // namespace
+
+LibavEncoder::~LibavEncoder()
+{
+    av_frame_free(&m_frame);
+    av_packet_free(&m_packet);
+    swr_free(&m_swr);
+    avcodec_free_context(&m_codec);
+    if (m_io) {
+        av_freep(&m_io->buffer);
+        avio_context_free(&m_io);
+    }
+    avformat_free_context(m_mux);
+}
+
+std::unique_ptr<LibavEncoder> LibavEncoder::open(const Settings &settings, QString *error)
+{
+    std::unique_ptr<LibavEncoder> enc(new LibavEncoder);
+    enc->m_channels = settings.channels;
+
+    const auto bail = [&](const QString &what, int err) {
+        if (error)
+            *error = QStringLiteral("%1: %2").arg(what, avErrorText(err));
+        return nullptr;
+    };
+
+    const char *codecName = "libmp3lame";
+    const char *muxerName = "mp3";
+    if (settings.codec == Codec::Opus) {
+        codecName = "libopus";
+        muxerName = "ogg";
+    } else if (settings.codec == Codec::Aac) {
+        codecName = "aac";
+        muxerName = "adts";
+    }
+
+    const AVCodec *codec = avcodec_find_encoder_by_name(codecName);
+    if (!codec)
+        return bail(QStringLiteral("no %1 encoder").arg(QLatin1String(codecName)),
+                    AVERROR_ENCODER_NOT_FOUND);
+    int err = avformat_alloc_output_context2(&enc->m_mux, nullptr, muxerName, nullptr);
+    if (err < 0 || !enc->m_mux)
+        return bail(QStringLiteral("muxer"), err < 0 ? err : AVERROR_MUXER_NOT_FOUND);
+
+    enc->m_codec = avcodec_alloc_context3(codec);
+    if (!enc->m_codec)
+        return bail(QStringLiteral("codec context"), AVERROR(ENOMEM));
+    enc->m_codec->bit_rate = static_cast<int64_t>(settings.bitrateKbps) * 1000;
+    enc->m_codec->sample_rate = settings.sampleRate;
+    enc->m_codec->sample_fmt = encoderSampleFormat(codec);
+    enc->m_codec->time_base = AVRational{1, settings.sampleRate};
+    av_channel_layout_default(&enc->m_codec->ch_layout, settings.channels);
+    if (enc->m_mux->oformat->flags & AVFMT_GLOBALHEADER)
+        enc->m_codec->flags |= AV_CODEC_FLAG_GLOBAL_HEADER;
+    err = avcodec_open2(enc->m_codec, codec, nullptr);
+    if (err < 0)
+        return bail(QStringLiteral("codec open"), err);
+    if (enc->m_codec->frame_size > 0)
+        enc->m_frameSize = enc->m_codec->frame_size;
+
+    AVChannelLayout inLayout;
+    av_channel_layout_default(&inLayout, settings.channels);
+    err = swr_alloc_set_opts2(&enc->m_swr, &enc->m_codec->ch_layout, enc->m_codec->sample_fmt,
+                              settings.sampleRate, &inLayout, AV_SAMPLE_FMT_FLT,
+                              settings.sampleRate, 0, nullptr);
+    av_channel_layout_uninit(&inLayout);
+    if (err < 0 || (err = swr_init(enc->m_swr)) < 0)
+        return bail(QStringLiteral("resampler"), err);
+
+    enc->m_stream = avformat_new_stream(enc->m_mux, nullptr);
+    if (!enc->m_stream)
+        return bail(QStringLiteral("stream"), AVERROR(ENOMEM));
+    err = avcodec_parameters_from_context(enc->m_stream->codecpar, enc->m_codec);
+    if (err < 0)
+        return bail(QStringLiteral("codec parameters"), err);
+    enc->m_stream->time_base = enc->m_codec->time_base;
+
+    auto *buffer = static_cast<unsigned char *>(av_malloc(kIoBufferSize));
+    enc->m_io = avio_alloc_context(buffer, kIoBufferSize, 1, &enc->m_encoded, nullptr,
+                                   appendOutput, nullptr);
+    if (!enc->m_io) {
+        av_free(buffer);
+        return bail(QStringLiteral("output"), AVERROR(ENOMEM));
+    }
+    enc->m_mux->pb = enc->m_io;
+    enc->m_mux->flags |= AVFMT_FLAG_CUSTOM_IO | AVFMT_FLAG_FLUSH_PACKETS;
+
+    // No ID3 tag or Xing header in a stream listeners join mid-way
+    AVDictionary *options = nullptr;
+    if (settings.codec == Codec::Mp3) {
+        av_dict_set(&options, "write_xing", "0", 0);
+        av_dict_set(&options, "id3v2_version", "0", 0);
+    }
+    err = avformat_write_header(enc->m_mux, &options);
+    av_dict_free(&options);
+    if (err < 0)
+        return bail(QStringLiteral("header"), err);
+    avio_flush(enc->m_io);
+
+    enc->m_frame = av_frame_alloc();
+    enc->m_packet = av_packet_alloc();
+    if (!enc->m_frame || !enc->m_packet)
+        return bail(QStringLiteral("frame"), AVERROR(ENOMEM));
+    enc->m_frame->format = enc->m_codec->sample_fmt;
+    enc->m_frame->sample_rate = settings.sampleRate;
+    enc->m_frame->nb_samples = enc->m_frameSize;
+    av_channel_layout_copy(&enc->m_frame->ch_layout, &enc->m_codec->ch_layout);
+    err = av_frame_get_buffer(enc->m_frame, 0);
+    if (err < 0)
+        return bail(QStringLiteral("frame"), err);
+
+    enc->m_pending.reserve(static_cast<size_t>(enc->m_frameSize) * settings.channels * 2);
+    return enc;
+}
+
+size_t LibavEncoder::write(const float *interleaved, size_t frames)
+{
+    if (m_failed || m_finished)
+        return 0;
+    m_pending.insert(m_pending.end(), interleaved, interleaved + frames * m_channels);
+
+    // Encode every whole codec frame; the remainder waits for the next write
+    const size_t frameSamples = static_cast<size_t>(m_frameSize) * m_channels;
+    size_t done = 0;
+    while (m_pending.size() - done >= frameSamples && encodeFrame(m_pending.data() + done))
+        done += frameSamples;
+    m_pending.erase(m_pending.begin(), m_pending.begin() + static_cast<std::ptrdiff_t>(done));
+    return frames;
+}
+
+bool LibavEncoder::encodeFrame(const float *interleaved)
+{
+    int err = av_frame_make_writable(m_frame);
+    if (err < 0) {
+        fail(QStringLiteral("frame"), err);
+        return false;
+    }
+    const uint8_t *in[] = {reinterpret_cast<const uint8_t *>(interleaved)};
+    const int got = swr_convert(m_swr, m_frame->data, m_frameSize, in, m_frameSize);
+    if (got < 0) {
+        fail(QStringLiteral("resample"), got);
+        return false;
+    }
+    m_frame->nb_samples = got;
+    m_frame->pts = m_nextPts;
+    m_nextPts += got;
+
+    err = avcodec_send_frame(m_codec, m_frame);
+    if (err < 0) {
+        fail(QStringLiteral("encode"), err);
+        return false;
+    }
+    err = muxPackets();
+    if (m_failed)
+        return false;
+    if (err != AVERROR(EAGAIN)) {
+        fail(QStringLiteral("encode"), err);
+        return false;
+    }
+    return true;
+}
+
+/** Mux every packet the codec has ready; returns what stopped it (EAGAIN, EOF or an error). */
+int LibavEncoder::muxPackets()
+{
+    int err;
+    while ((err = avcodec_receive_packet(m_codec, m_packet)) >= 0) {
+        av_packet_rescale_ts(m_packet, m_codec->time_base, m_stream->time_base);
+        m_packet->stream_index = m_stream->index;
+        err = av_write_frame(m_mux, m_packet);
+        av_packet_unref(m_packet);
+        if (err < 0) {
+            fail(QStringLiteral("mux"), err);
+            return err;
+        }
+    }
+    return err;
+}
+
+void LibavEncoder::finish()
+{
+    if (m_failed || m_finished)
+        return;
+    m_finished = true;
+    // The last partial codec frame goes out padded with silence
+    if (!m_pending.empty()) {
+        m_pending.resize(static_cast<size_t>(m_frameSize) * m_channels, 0.0f);
+        const bool ok = encodeFrame(m_pending.data());
+        m_pending.clear();
+        if (!ok)
+            return;
+    }
+    int err = avcodec_send_frame(m_codec, nullptr);
+    if (err >= 0)
+        err = muxPackets();
+    if (m_failed)
+        return;
+    if (err != AVERROR_EOF) {
+        fail(QStringLiteral("flush"), err);
+        return;
+    }
+    err = av_write_trailer(m_mux);
+    avio_flush(m_io);
+    if (err < 0)
+        fail(QStringLiteral("trailer"), err);
+}
+
+qint64 LibavEncoder::takeEncoded(QByteArray &out)
+{
+    const qint64 n = m_encoded.size();
+    out += m_encoded;
+    m_encoded.clear();
+    return n;
+}
+
+void LibavEncoder::fail(const QString &what, int err)
+{
+    m_failed = true;
+    m_error = QStringLiteral("%1: %2").arg(what, avErrorText(err));
+}
@@ -0,0 +1,72 @@
+#ifndef LIBAVENCODER_H
+#define LIBAVENCODER_H
+
+#include "FxEncoder.h"
+
+#include <memory>
+#include <vector>
+
+struct AVCodecContext;
+struct AVFormatContext;
+struct AVFrame;
+struct AVIOContext;
+struct AVPacket;
+struct AVStream;
+struct SwrContext;
+
+/**
+ * @brief In-process stream encoder on libavcodec / libavformat /
+ * libswresample.
+ *
+ * Only built when XFB_HAVE_LIBAV is defined. Encodes on the caller's
+ * thread as soon as a whole codec frame is queued and muxes into memory
+ * through a custom AVIO writer, flushed after every packet, so the bytes
+ * are ready for the socket in the same call with no pipe or process in
+ * between.
+ */
+class LibavEncoder : public FxEncoder
+{
+public:
+    ~LibavEncoder() override;
+
+    /**
+     * Open the codec and write the container header. Returns nullptr and
+     * sets error when the codec is not available in this libav build;
+     * FxEncoder::open() then falls back to the ffmpeg CLI.
+     */
+    static std::unique_ptr<LibavEncoder> open(const Settings &settings, QString *error);
+
+    size_t write(const float *interleaved, size_t frames) override;
+    qint64 takeEncoded(QByteArray &out) override;
+    void finish() override;
+    qint64 queuedFrames() const override { return qint64(m_pending.size() / size_t(m_channels)); }
+    bool failed() const override { return m_failed; }
+    QString errorString() const override { return m_error; }
+
+private:
+    LibavEncoder() = default;
+    bool encodeFrame(const float *interleaved);
+    int muxPackets();
+    void fail(const QString &what, int err);
+
+    AVCodecContext *m_codec = nullptr;
+    AVFormatContext *m_mux = nullptr;
+    AVIOContext *m_io = nullptr;
+    AVStream *m_stream = nullptr;
+    SwrContext *m_swr = nullptr;
+    AVFrame *m_frame = nullptr;
+    AVPacket *m_packet = nullptr;
+    int m_channels = 2;
+    int m_frameSize = 1024;
+    qint64 m_nextPts = 0;
+
+    bool m_failed = false;
+    bool m_finished = false;
+    QString m_error;
+
+    // Input short of a whole codec frame, and muxed output not taken yet
+    std::vector<float> m_pending;
+    QByteArray m_encoded;
+};
+
+#endif // LIBAVENCODER_H
@@ -0,0 +1,266 @@
+#include "TrackAnalysisStore.h"
+
+#include "FrameRing.h"
+#include "FxDecoder.h"
+#include "FxDsp.h"
+#include "FxEngine.h"
+
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDateTime>
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QFutureWatcher>
+#include <QProcess>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <QThread>
+#include <QtConcurrent>
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+namespace
+{
+constexpr int kSampleRate = FxEngine::kSampleRate;
+constexpr int kChannels = FxEngine::kChannels;
+constexpr int kChunkFrames = 4096;
+constexpr int kMaxParallelJobs = 2; // playback and waveforms need the CPU too
+constexpr quint32 kCacheMagic = 0x58465441; // "XFTA"
+constexpr quint16 kCacheVersion = 2;
+
+qint64 framesToMs(qint64 frames)
+{
+    return frames * 1000 / kSampleRate;
+}
+
+QString cacheFileFor(const QString &filePath)
+{
+    const QFileInfo info(filePath);
+    const QByteArray key = QString(filePath + QLatin1Char('|')
+                                   + QString::number(info.size()) + QLatin1Char('|')
+                                   + QString::number(info.lastModified().toSecsSinceEpoch()))
+                               .toUtf8();
+    const QString dir = QStandardPaths::writableLocation(QStandardPaths::CacheLocation)
+                        + QStringLiteral("/analysis");
+    return dir + QLatin1Char('/')
+           + QString::fromLatin1(QCryptographicHash::hash(key, QCryptographicHash::Sha1).toHex())
+           + QStringLiteral(".ta");
+}
+
+void saveToDisk(const QString &filePath, const TrackAnalysis &data)
+{
+    const QString cachePath = cacheFileFor(filePath);
+    QDir().mkpath(QFileInfo(cachePath).absolutePath());
+
+    // Atomic replace: the engine may read the entry while it is written
+    QSaveFile file(cachePath);
+    if (!file.open(QIODevice::WriteOnly))
+        return;
+    QDataStream out(&file);
+    out << kCacheMagic << kCacheVersion << data.durationMs << data.integratedLufs
+        << data.truePeakDb << data.audioStartMs << data.audioEndMs;
+    file.commit();
+}
+} // namespace
+
+double TrackAnalysis::normalizationGainDb(double targetLufs, double ceilingDbtp) const
+{
+    if (!ready() || integratedLufs <= fxdsp::LoudnessMeter::kSilenceLufs)
+        return 0.0;
+    // Boosts stop where the true peak would cross the ceiling; the
+    // compressor and the safety clamp are not a limiter to lean on
+    const double gain = targetLufs - integratedLufs;
+    return std::min(gain, std::max(0.0, ceilingDbtp - truePeakDb));
+}
+
+TrackAnalysisStore::TrackAnalysisStore(QObject *parent)
+    : QObject(parent)
+{
+}
+
+TrackAnalysisStore::~TrackAnalysisStore()
+{
+    // Running analyses stop at their next chunk; they hold their own
+    // reference to the flag
+    m_cancel->store(true);
+}
+
+const TrackAnalysis *TrackAnalysisStore::peek(const QString &filePath) const
+{
+    const auto it = m_cache.constFind(filePath);
+    return it == m_cache.constEnd() ? nullptr : &it.value();
+}
+
+const TrackAnalysis *TrackAnalysisStore::fetch(const QString &filePath)
+{
+    if (const TrackAnalysis *known = peek(filePath))
+        return known;
+    if (filePath.isEmpty() || m_pending.contains(filePath))
+        return nullptr;
+
+    TrackAnalysis cached;
+    if (loadCached(filePath, &cached)) {
+        m_cache.insert(filePath, cached);
+        return peek(filePath);
+    }
+
+    m_pending.insert(filePath);
+    m_queue.append(filePath);
+    startNext();
+    return nullptr;
+}
+
+void TrackAnalysisStore::startNext()
+{
+    while (m_running < kMaxParallelJobs && !m_queue.isEmpty()) {
+        const QString path = m_queue.takeFirst();
+        if (!QFile::exists(path)) {
+            TrackAnalysis failed;
+            failed.failed = true;
+            m_cache.insert(path, failed);
+            m_pending.remove(path);
+            emit analysisReady(path);
+            continue;
+        }
+
+        ++m_running;
+        auto *watcher = new QFutureWatcher<TrackAnalysis>(this);
+        connect(watcher, &QFutureWatcher<TrackAnalysis>::finished, this, [this, watcher, path]() {
+            m_cache.insert(path, watcher->result());
+            m_pending.remove(path);
+            watcher->deleteLater();
+            --m_running;
+            emit analysisReady(path);
+            startNext();
+        });
+        watcher->setFuture(QtConcurrent::run([path, cancel = m_cancel]() {
+            return analyze(path, cancel.get());
+        }));
+    }
+}
+
+bool TrackAnalysisStore::loadCached(const QString &filePath, TrackAnalysis *out)
+{
+    QFile file(cacheFileFor(filePath));
+    if (!file.open(QIODevice::ReadOnly))
+        return false;
+
+    QDataStream in(&file);
+    quint32 magic = 0;
+    quint16 version = 0;
+    in >> magic >> version;
+    if (magic != kCacheMagic || version != kCacheVersion)
+        return false;
+
+    TrackAnalysis a;
+    in >> a.durationMs >> a.integratedLufs >> a.truePeakDb >> a.audioStartMs >> a.audioEndMs;
+    if (in.status() != QDataStream::Ok || a.durationMs <= 0)
+        return false;
+    *out = a;
+    return true;
+}
+
+TrackAnalysis TrackAnalysisStore::analyze(const QString &filePath, const std::atomic<bool> *cancel)
+{
+    TrackAnalysis result;
+    if (loadCached(filePath, &result))
+        return result;
+    result.failed = true;
+
+    FxEngine::DecodeRequest request;
+    request.path = filePath;
+    request.realtime = false;
+    request.waitForStart = true;
+    QString error;
+    // No owner: the ffmpeg child (if any) lives in this thread
+    std::unique_ptr<FxDecoder> decoder = FxEngine::openDecoder(request, nullptr, &error);
+    if (!decoder) {
+        qWarning() << "TrackAnalysisStore: cannot decode" << filePath << error;
+        return result;
+    }
+
+    fxdsp::LoudnessMeter meter;
+    meter.setup(kSampleRate);
+    FrameRing ring(kChannels);
+    ring.reset(static_cast<size_t>(kSampleRate));
+    std::vector<float> chunk(static_cast<size_t>(kChunkFrames) * kChannels);
+    qint64 frames = 0;
+    qint64 firstLoud = -1;
+    qint64 lastLoud = -1;
+
+    const auto consume = [&]() {
+        size_t n;
+        while ((n = ring.read(chunk.data(), kChunkFrames)) > 0) {
+            meter.process(chunk.data(), static_cast<int>(n));
+            for (size_t i = 0; i < n; ++i) {
+                const float *f = chunk.data() + i * kChannels;
+                if (std::abs(f[0]) > FxEngine::kSilenceFloor
+                        || std::abs(f[1]) > FxEngine::kSilenceFloor) {
+                    if (firstLoud < 0)
+                        firstLoud = frames + qint64(i);
+                    lastLoud = frames + qint64(i);
+                }
+            }
+            frames += qint64(n);
+        }
+    };
+
+    // No event loop on a pool thread: a CLI decoder's pipe is only read
+    // when we wait on it explicitly (as FxRenderer's decode threads do)
+    auto *process = dynamic_cast<ProcessDecoder *>(decoder.get());
+    bool canceled = false;
+    while (true) {
+        if (cancel && cancel->load(std::memory_order_relaxed)) {
+            canceled = true;
+            break;
+        }
+        if (decoder->drainInto(ring) > 0) {
+            consume();
+            continue;
+        }
+        if (decoder->exhausted())
+            break;
+        if (process) {
+            QProcess *proc = process->process();
+            if (!proc->waitForReadyRead(50) && proc->state() != QProcess::NotRunning)
+                proc->waitForFinished(10);
+        } else {
+            QThread::usleep(200);
+        }
+    }
+    consume();
+
+    const bool failed = canceled || decoder->failed() || frames == 0;
+    if (decoder->failed())
+        qWarning() << "TrackAnalysisStore: decode failed for" << filePath << decoder->errorString();
+    if (process && process->running()) {
+        // Stopped early: reap it here, the decoder's asynchronous reap
+        // needs an event loop
+        process->process()->kill();
+        process->process()->waitForFinished(1000);
+    }
+    decoder.reset();
+    if (failed)
+        return result;
+
+    result.failed = false;
+    result.durationMs = framesToMs(frames);
+    result.integratedLufs = meter.integratedLufs();
+    result.truePeakDb = meter.truePeakDb();
+    if (firstLoud >= 0) {
+        // Rounded outwards: a cue never cuts into audible audio
+        result.audioStartMs = framesToMs(firstLoud);
+        result.audioEndMs = std::min(result.durationMs,
+                                     (lastLoud + 1) * 1000 / kSampleRate + 1);
+    } else {
+        result.audioStartMs = 0;
+        result.audioEndMs = result.durationMs;
+    }
+
+    saveToDisk(filePath, result);
+    return result;
+}
@@ -0,0 +1,89 @@
+#ifndef TRACKANALYSISSTORE_H
+#define TRACKANALYSISSTORE_H
+
+#include <QHash>
+#include <QObject>
+#include <QSet>
+#include <QStringList>
+
+#include <atomic>
+#include <memory>
+
+/**
+ * Loudness and cue points of one audio file, measured once on the engine's
+ * own decode (48 kHz stereo float), so playback never has to scan for them.
+ */
+struct TrackAnalysis
+{
+    qint64 durationMs = 0;         // decoded length
+    double integratedLufs = -120.0; // EBU R128 programme loudness
+    double truePeakDb = -120.0;     // dBTP, 4x oversampled
+    qint64 audioStartMs = 0;       // first frame above FxEngine::kSilenceFloor
+    qint64 audioEndMs = 0;         // just past the last such frame
+    bool failed = false;
+
+    bool ready() const { return durationMs > 0 && !failed; }
+
+    /**
+     * Gain (dB) that brings the track to targetLufs, limited so its true
+     * peak stays under ceilingDbtp. 0 when the track is not analysed or
+     * has no gated programme (silence).
+     */
+    double normalizationGainDb(double targetLufs, double ceilingDbtp = -1.0) const;
+};
+
+/**
+ * Asynchronous, persistent provider of TrackAnalysis for local audio files.
+ *
+ * Each file is decoded once on the thread pool through the FX engine's
+ * decoder (FxEngine::openDecoder, unpaced) and measured in a single pass:
+ * BS.1770 loudness and true peak, and head/tail silence against the
+ * auto-cue floor. Results are cached in memory and on disk
+ * (CacheLocation/analysis, keyed by path + size + mtime), the same way
+ * WaveformStore caches waveforms.
+ *
+ * FxPlayer reads the disk cache (loadCached()) when it hands a track to
+ * the FX engine, so a track analysed while it sat in the playlist starts
+ * normalised and plays from its first to its last audible frame.
+ */
+class TrackAnalysisStore : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit TrackAnalysisStore(QObject *parent = nullptr);
+    ~TrackAnalysisStore() override;
+
+    /** Returns the analysis if already known (possibly a failed marker). */
+    const TrackAnalysis *peek(const QString &filePath) const;
+
+    /** Like peek(), but schedules a background analysis when unknown. */
+    const TrackAnalysis *fetch(const QString &filePath);
+
+    /** Disk cache lookup only. Thread-safe; false when not analysed yet. */
+    static bool loadCached(const QString &filePath, TrackAnalysis *out);
+
+    /**
+     * Decode and measure filePath (blocking, any thread) and store the
+     * result in the disk cache. A cached result is returned as is; setting
+     * *cancel abandons the decode with a failed result that is not cached.
+     */
+    static TrackAnalysis analyze(const QString &filePath,
+                                 const std::atomic<bool> *cancel = nullptr);
+
+signals:
+    /** Emitted when an analysis finishes, successfully or not. */
+    void analysisReady(const QString &filePath);
+
+private:
+    void startNext();
+
+    QHash<QString, TrackAnalysis> m_cache;
+    QStringList m_queue;
+    QSet<QString> m_pending; // queued or currently analysing
+    int m_running = 0;
+    // Shared with the pool tasks, which may outlive the store
+    std::shared_ptr<std::atomic<bool>> m_cancel = std::make_shared<std::atomic<bool>>(false);
+};
+
+#endif // TRACKANALYSISSTORE_H
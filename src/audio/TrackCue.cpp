@@ -0,0 +1,19 @@
+#include "TrackCue.h"
+
+#include "FxEngine.h"
+#include "TrackAnalysisStore.h"
+
+TrackCue TrackCue::resolve(const TrackAnalysis &analysis, qint64 trimStartMs, qint64 trimEndMs)
+{
+    TrackCue cue;
+    const qint64 startMs = analysis.ready() ? analysis.audioStartMs : trimStartMs;
+    if (startMs > 0 && startMs <= FxEngine::kLeadSkipCapMs) {
+        cue.startMs = startMs;
+        cue.startKnown = true;
+    }
+    const qint64 endMs = trimEndMs > 0 ? trimEndMs
+                                       : analysis.ready() ? analysis.audioEndMs : 0;
+    if (endMs > cue.startMs)
+        cue.endMs = endMs;
+    return cue;
+}
@@ -0,0 +1,34 @@
+#ifndef TRACKCUE_H
+#define TRACKCUE_H
+
+#include <QtGlobal>
+
+struct TrackAnalysis;
+
+/**
+ * Where a local track's audio starts and ends when it plays from the top.
+ *
+ * Resolved from the cached analysis (TrackAnalysisStore) and the file's
+ * stored silence trim, and shared by every path that starts a track — the
+ * cold start, the gapless preload and the offline renderer — so they all
+ * cut the same audio. Both inputs live on disk: callers resolve the cue
+ * before handing the track to the engine thread.
+ */
+struct TrackCue
+{
+    qint64 startMs = 0;      // decode opens here; 0 = the top
+    qint64 endMs = 0;        // decode stops here; 0 = the file's end
+    bool startKnown = false; // the head needs no leading-silence scan
+
+    /** The tail needs no trailing-silence trim either. */
+    bool endKnown() const { return endMs > 0; }
+
+    /**
+     * The analysed audio start, else trimStartMs; a start past
+     * FxEngine::kLeadSkipCapMs is not cued (the head scan gives up there
+     * too). The end is trimEndMs, else the analysed audio end.
+     */
+    static TrackCue resolve(const TrackAnalysis &analysis, qint64 trimStartMs, qint64 trimEndMs);
+};
+
+#endif // TRACKCUE_H
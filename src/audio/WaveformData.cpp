@@ -0,0 +1,121 @@
+#include "WaveformData.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+constexpr int kLevelFactor = 4; // LevelMs[k + 1] / LevelMs[k]
+} // namespace
+
+int WaveformData::bucketsAt(int level, int finestBuckets)
+{
+    int buckets = finestBuckets;
+    for (int k = 0; k < level; ++k)
+        buckets = (buckets + kLevelFactor - 1) / kLevelFactor;
+    return buckets;
+}
+
+void WaveformData::buildLevels()
+{
+    if (levels.isEmpty())
+        return;
+    levels.resize(LevelCount);
+    for (int k = 1; k < LevelCount; ++k) {
+        const QVector<qint8> &fine = levels[k - 1].minMax;
+        const int fineBuckets = levels[k - 1].buckets();
+        const int buckets = bucketsAt(1, fineBuckets);
+        QVector<qint8> &coarse = levels[k].minMax;
+        coarse.resize(buckets * 2);
+        for (int b = 0; b < buckets; ++b) {
+            const int first = b * kLevelFactor;
+            const int last = std::min(first + kLevelFactor, fineBuckets);
+            qint8 lo = fine[first * 2];
+            qint8 hi = fine[first * 2 + 1];
+            for (int i = first + 1; i < last; ++i) {
+                lo = std::min(lo, fine[i * 2]);
+                hi = std::max(hi, fine[i * 2 + 1]);
+            }
+            coarse[b * 2] = lo;
+            coarse[b * 2 + 1] = hi;
+        }
+    }
+}
+
+int WaveformData::levelFor(double msPerPx) const
+{
+    int level = 0;
+    while (level + 1 < levels.size() && LevelMs[level + 1] <= msPerPx)
+        ++level;
+    return level;
+}
+
+void WaveformData::reduceColumns(qint64 fromMs, qint64 toMs, int columns, qint8 *out) const
+{
+    if (columns <= 0)
+        return;
+    const double msPerPx = double(toMs - fromMs) / columns;
+
+    // Without a pyramid (never built): the 20 ms peaks, mirrored
+    const bool pyramid = !levels.isEmpty();
+    const int level = pyramid ? levelFor(msPerPx) : 0;
+    const double msPerBucket = pyramid ? LevelMs[level] : MsPerPeak;
+    const int buckets = pyramid ? levels[level].buckets() : int(peaks.size());
+    const qint8 *minMax = pyramid ? levels[level].minMax.constData() : nullptr;
+
+    for (int x = 0; x < columns; ++x) {
+        const double msStart = fromMs + x * msPerPx;
+        const double msEnd = fromMs + (x + 1) * msPerPx;
+        const int i0 = int(std::floor(msStart / msPerBucket));
+        const int i1 = std::min(std::max(int(std::ceil(msEnd / msPerBucket)), i0 + 1), buckets);
+        qint8 lo = 127;
+        qint8 hi = -128;
+        for (int i = std::max(i0, 0); i < i1; ++i) {
+            if (minMax) {
+                lo = std::min(lo, minMax[i * 2]);
+                hi = std::max(hi, minMax[i * 2 + 1]);
+            } else {
+                const qint8 p = qint8(peaks[i] >> 1);
+                lo = std::min(lo, qint8(-p));
+                hi = std::max(hi, p);
+            }
+        }
+        out[x * 2] = lo;
+        out[x * 2 + 1] = hi;
+    }
+}
+
+qint64 WaveformData::quietHeadMs(int threshold) const
+{
+    int run = 0;
+    for (int i = 0; i < peaks.size(); ++i) {
+        run = peaks[i] >= threshold ? run + 1 : 0;
+        if (run >= SustainPeaks)
+            return qint64(i - SustainPeaks + 1) * MsPerPeak;
+    }
+    return durationMs;
+}
+
+qint64 WaveformData::quietTailMs(int threshold) const
+{
+    int run = 0;
+    for (int i = int(peaks.size()) - 1; i >= 0; --i) {
+        run = peaks[i] >= threshold ? run + 1 : 0;
+        if (run >= SustainPeaks) {
+            // Scanning backwards, so this is the last sustained-loud run in
+            // the track and it ends just before peak index i + SustainPeaks.
+            // Any rounding remainder past the peak buffer is quiet too.
+            const qint64 loudEndMs = qint64(i + SustainPeaks) * MsPerPeak;
+            return std::max(qint64(0), durationMs - loudEndMs);
+        }
+    }
+    return durationMs;
+}
+
+qint64 WaveformData::residentBytes() const
+{
+    qint64 bytes = peaks.size();
+    for (const Level &level : levels)
+        bytes += level.minMax.size();
+    return bytes;
+}
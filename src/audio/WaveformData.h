@@ -0,0 +1,70 @@
+#ifndef WAVEFORMDATA_H
+#define WAVEFORMDATA_H
+
+#include <QVector>
+#include <QtGlobal>
+
+/**
+ * Amplitude envelope ("sound wave") of one audio file.
+ *
+ * peaks holds one 0..255 peak value per MsPerPeak milliseconds; the
+ * auto-mix and library silence scans work on it (quietHeadMs/TailMs).
+ * For drawing there is a min/max pyramid: levels[k] keeps, per
+ * LevelMs[k] bucket, the lowest and highest sample in 1/128 of full
+ * scale, each level four times coarser than the one before. A painter
+ * reads the level matching its pixel density, so a column costs a
+ * handful of buckets whatever the track's length.
+ */
+struct WaveformData
+{
+    static constexpr int MsPerPeak = 20;
+    static constexpr int LevelCount = 5;
+    static constexpr int LevelMs[LevelCount] = {5, 20, 80, 320, 1280};
+    // A moment counts as "loud" only as part of a run of SustainPeaks
+    // peaks at/above the threshold, so a click in an otherwise faded tail
+    // doesn't count as the song still going.
+    static constexpr int SustainPeaks = 3; // 3 × 20 ms
+
+    struct Level
+    {
+        QVector<qint8> minMax; // min, max interleaved per bucket
+
+        int buckets() const { return int(minMax.size() / 2); }
+    };
+
+    qint64 durationMs = 0;
+    QVector<quint8> peaks;
+    QVector<Level> levels; // finest first; empty or LevelCount long
+    bool failed = false;
+
+    bool ready() const { return !peaks.isEmpty(); }
+
+    /** Bucket count of every level above the finest one, from the finest. */
+    static int bucketsAt(int level, int finestBuckets);
+
+    /** Fills levels[1..] from levels[0]. */
+    void buildLevels();
+
+    /** Coarsest level whose buckets are no wider than msPerPx. */
+    int levelFor(double msPerPx) const;
+
+    /**
+     * Min/max of [fromMs, toMs) split into columns equal slices, written
+     * as columns (min, max) pairs into out. Columns past the end of the
+     * audio get min > max. O(columns).
+     */
+    void reduceColumns(qint64 fromMs, qint64 toMs, int columns, qint8 *out) const;
+
+    /**
+     * How long the track stays quiet (below threshold, in peak units) at
+     * its head / tail, in whole peaks: rounded so no loud peak is counted
+     * as quiet. A track that never gets loud returns durationMs.
+     */
+    qint64 quietHeadMs(int threshold) const;
+    qint64 quietTailMs(int threshold) const;
+
+    /** Heap bytes held by peaks and levels. */
+    qint64 residentBytes() const;
+};
+
+#endif // WAVEFORMDATA_H
@@ -0,0 +1,131 @@
+#include "WaveformScanner.h"
+
+#include "FxDsp.h"
+
+#include <QElapsedTimer>
+#include <QProcess>
+
+#include <algorithm>
+
+namespace
+{
+constexpr int kSampleRate = WaveformScanner::SampleRate;
+constexpr int kSamplesPerPeak = kSampleRate * WaveformData::MsPerPeak / 1000;
+constexpr int kBytesPerPeak = kSamplesPerPeak * 2; // s16le
+constexpr int kSamplesPerBucket = kSampleRate * WaveformData::LevelMs[0] / 1000;
+static_assert(kSamplesPerPeak % kSamplesPerBucket == 0, "peaks must span whole buckets");
+
+constexpr int kPollMs = 50;
+constexpr int kScanTimeoutMs = 10 * 60 * 1000;
+} // namespace
+
+void WaveformScanner::consume(const QByteArray &pcm)
+{
+    m_carry.append(pcm);
+    const char *data = m_carry.constData();
+    int offset = 0;
+    while (m_carry.size() - offset >= kBytesPerPeak) {
+#if Q_BYTE_ORDER == Q_LITTLE_ENDIAN
+        // s16le is the native layout: reduce in place, vectorized
+        const auto *samples = reinterpret_cast<const int16_t *>(data + offset);
+        const int peak = fxdsp::peakAbsS16(samples, kSamplesPerPeak);
+        for (int b = 0; b < kSamplesPerPeak; b += kSamplesPerBucket) {
+            const auto range = std::minmax_element(samples + b, samples + b + kSamplesPerBucket);
+            m_minMax.append(qint8(*range.first >> 8));
+            m_minMax.append(qint8(*range.second >> 8));
+        }
+#else
+        int peak = 0;
+        int lo = 32767, hi = -32768;
+        for (int i = 0; i < kSamplesPerPeak; ++i) {
+            const int idx = offset + i * 2;
+            const qint16 sample = qint16(quint8(data[idx]) | (quint8(data[idx + 1]) << 8));
+            peak = qMax(peak, qMin(qAbs(int(sample)), 32767));
+            lo = qMin(lo, int(sample));
+            hi = qMax(hi, int(sample));
+            if ((i + 1) % kSamplesPerBucket == 0) {
+                m_minMax.append(qint8(lo >> 8));
+                m_minMax.append(qint8(hi >> 8));
+                lo = 32767;
+                hi = -32768;
+            }
+        }
+#endif
+        m_peaks.append(quint8(qMin(peak >> 7, 255)));
+        offset += kBytesPerPeak;
+    }
+    m_carry.remove(0, offset);
+}
+
+WaveformData WaveformScanner::take()
+{
+    WaveformData result;
+    result.peaks = std::move(m_peaks);
+    result.durationMs = qint64(result.peaks.size()) * WaveformData::MsPerPeak;
+    result.levels.resize(1);
+    result.levels[0].minMax = std::move(m_minMax);
+    result.buildLevels();
+
+    m_carry.clear();
+    m_peaks.clear();
+    m_minMax.clear();
+    return result;
+}
+
+QStringList WaveformScanner::ffmpegArguments(const QString &path)
+{
+    return {QStringLiteral("-v"), QStringLiteral("error"),
+            QStringLiteral("-nostdin"),
+            QStringLiteral("-i"), path,
+            QStringLiteral("-vn"),
+            QStringLiteral("-ac"), QStringLiteral("1"),
+            QStringLiteral("-ar"), QString::number(kSampleRate),
+            QStringLiteral("-f"), QStringLiteral("s16le"),
+            QStringLiteral("-")};
+}
+
+WaveformData WaveformScanner::scanFile(const QString &ffmpeg, const QString &path,
+                                       const std::atomic<bool> *cancel, QString *error)
+{
+    WaveformData failed;
+    failed.failed = true;
+
+    QProcess process;
+    process.start(ffmpeg, ffmpegArguments(path));
+    if (!process.waitForStarted()) {
+        if (error)
+            *error = process.errorString();
+        return failed;
+    }
+
+    // No event loop on a pool thread: the pipe is read by waiting on it
+    WaveformScanner scanner;
+    QElapsedTimer clock;
+    clock.start();
+    while (process.state() != QProcess::NotRunning) {
+        const bool cancelled = cancel && cancel->load(std::memory_order_relaxed);
+        if (cancelled || clock.elapsed() > kScanTimeoutMs) {
+            process.kill();
+            process.waitForFinished(1000);
+            if (error)
+                *error = cancelled ? QStringLiteral("cancelled") : QStringLiteral("ffmpeg timed out");
+            return failed;
+        }
+        if (process.waitForReadyRead(kPollMs))
+            scanner.consume(process.readAllStandardOutput());
+        else if (process.state() != QProcess::NotRunning)
+            process.waitForFinished(10);
+    }
+    scanner.consume(process.readAllStandardOutput());
+
+    if (process.exitStatus() != QProcess::NormalExit || process.exitCode() != 0
+            || scanner.isEmpty()) {
+        if (error) {
+            *error = QString::fromLocal8Bit(process.readAllStandardError()).trimmed();
+            if (error->isEmpty())
+                *error = QStringLiteral("ffmpeg exited with code %1").arg(process.exitCode());
+        }
+        return failed;
+    }
+    return scanner.take();
+}
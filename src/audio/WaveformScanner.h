@@ -0,0 +1,50 @@
+#ifndef WAVEFORMSCANNER_H
+#define WAVEFORMSCANNER_H
+
+#include "WaveformData.h"
+
+#include <QByteArray>
+#include <QStringList>
+#include <QVector>
+
+#include <atomic>
+
+/**
+ * Reduces the low-rate mono PCM of a waveform decode (s16le at SampleRate,
+ * see ffmpegArguments()) to a WaveformData: one peak per MsPerPeak
+ * (fxdsp::peakAbsS16) and the min/max pyramid. Chunks may be cut anywhere;
+ * the raw samples never accumulate in memory.
+ *
+ * WaveformStore feeds it from its asynchronous ffmpeg processes; the
+ * library silence scan (TrackTrimmer) runs scanFile() on pool threads, so
+ * both see the same peaks.
+ */
+class WaveformScanner
+{
+public:
+    static constexpr int SampleRate = 4000; // decode rate; plenty for a visual envelope
+
+    void consume(const QByteArray &pcm);
+    bool isEmpty() const { return m_peaks.isEmpty(); }
+
+    /** The waveform consumed so far, pyramid built; the scanner starts over. */
+    WaveformData take();
+
+    /** ffmpeg arguments decoding path to the PCM consume() expects, on stdout. */
+    static QStringList ffmpegArguments(const QString &path);
+
+    /**
+     * Blocking decode of path with ffmpeg, for worker threads. Gives up
+     * soon after cancel turns true. On failure the result is failed and
+     * error set.
+     */
+    static WaveformData scanFile(const QString &ffmpeg, const QString &path,
+                                 const std::atomic<bool> *cancel, QString *error);
+
+private:
+    QByteArray m_carry;
+    QVector<quint8> m_peaks;
+    QVector<qint8> m_minMax;
+};
+
+#endif // WAVEFORMSCANNER_H
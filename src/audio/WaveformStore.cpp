@@ -1,126 +1,171 @@
 #include "WaveformStore.h"
 
 #include "FxEngine.h"
+#include "WaveformScanner.h"
 
 #include <QCryptographicHash>
-#include <QDataStream>
 #include <QDateTime>
 #include <QDebug>
 #include <QDir>
-#include <QFile>
 #include <QFileInfo>
 #include <QProcess>
 #include <QStandardPaths>
+#include <QThread>
+#include <QTimer>
+#include <QtEndian>
+
+#include <algorithm>
+#include <cstring>
+#include <utility>
+#include <vector>
 
 namespace
 {
-constexpr int kSampleRate = 4000; // decode rate; plenty for a visual envelope
-constexpr int kSamplesPerPeak = kSampleRate * WaveformStore::MsPerPeak / 1000;
-constexpr int kBytesPerPeak = kSamplesPerPeak * 2; // s16le
-constexpr int kMaxParallelJobs = 2;
-constexpr quint32 kCacheMagic = 0x58465756; // "XFWV"
-constexpr quint16 kCacheVersion = 1;
-
-// Per-decode state: PCM is reduced to peaks incrementally so the raw
-// samples never accumulate in memory.
-struct DecodeJob
-{
-    QByteArray carry;
-    QVector<quint8> peaks;
-};
-
-void consumePcm(DecodeJob &job, const QByteArray &chunk)
-{
-    job.carry.append(chunk);
-    const char *data = job.carry.constData();
-    int offset = 0;
-    while (job.carry.size() - offset >= kBytesPerPeak) {
-        int peak = 0;
-        for (int i = 0; i < kSamplesPerPeak; ++i) {
-            const int idx = offset + i * 2;
-            const qint16 sample = qint16(quint8(data[idx]) | (quint8(data[idx + 1]) << 8));
-            peak = qMax(peak, qAbs(int(sample)));
-        }
-        job.peaks.append(quint8(qMin(peak >> 7, 255)));
-        offset += kBytesPerPeak;
-    }
-    job.carry.remove(0, offset);
+// Pack file: an 8-byte header, then appended records of
+//   key (SHA-1 of path|size|mtime, 20 bytes), durationMs (i64 LE),
+//   peak count (u32 LE), finest level bucket count (u32 LE),
+//   peaks (count bytes), then each pyramid level, finest first, as
+//   min/max pairs (2 bytes per bucket)
+// A newer record for a key supersedes older ones.
+constexpr quint32 kPackMagic = 0x58465750; // "XFWP"
+constexpr quint16 kPackVersion = 2;
+constexpr qint64 kPackHeaderBytes = 8;
+constexpr int kKeyBytes = 20;
+constexpr qint64 kRecordHeaderBytes = kKeyBytes + 8 + 4 + 4;
+// Superseded records are never reclaimed: past this the pack starts over
+constexpr qint64 kMaxPackBytes = qint64(1) << 30;
+
+qint64 levelBytes(int level, quint32 finestBuckets)
+{
+    return qint64(WaveformData::bucketsAt(level, int(finestBuckets))) * 2;
+}
+
+qint64 payloadBytes(quint32 count, quint32 finestBuckets)
+{
+    qint64 bytes = count;
+    for (int k = 0; k < WaveformData::LevelCount; ++k)
+        bytes += levelBytes(k, finestBuckets);
+    return bytes;
 }
 } // namespace
 
 WaveformStore::WaveformStore(QObject *parent)
     : QObject(parent)
 {
+    // ffmpeg decodes are single-threaded: one per core, leaving one for
+    // the GUI and the audio engine
+    m_maxJobs = std::clamp(QThread::idealThreadCount() - 1, 2, 8);
+}
+
+WaveformStore::~WaveformStore()
+{
+    if (m_map)
+        m_pack.unmap(m_map);
 }
 
 const WaveformData *WaveformStore::peek(const QString &filePath) const
 {
-    const auto it = m_cache.constFind(filePath);
-    return it == m_cache.constEnd() ? nullptr : &it.value();
+    const auto it = m_cache.find(filePath);
+    if (it == m_cache.end())
+        return nullptr;
+    Entry &entry = it.value();
+    if (!entry.data.failed && entry.data.peaks.isEmpty() && entry.ref.offset >= 0) {
+        // Evicted: back from the map (a page fault at worst)
+        if (!readRecord(entry.ref, entry.data)) {
+            entry.data.peaks.clear();
+            entry.data.levels.clear();
+            entry.data.failed = true;
+        }
+        m_residentBytes += entry.data.residentBytes();
+        scheduleTrim();
+    }
+    touch(entry);
+    return &entry.data;
 }
 
-const WaveformData *WaveformStore::fetch(const QString &filePath)
+const WaveformData *WaveformStore::fetch(const QString &filePath, Priority priority)
 {
     if (const WaveformData *known = peek(filePath))
         return known;
-    if (filePath.isEmpty() || m_pending.contains(filePath))
+    if (filePath.isEmpty())
         return nullptr;
+    if (m_pending.contains(filePath)) {
+        // Scrolled into view while waiting: move it up
+        if (priority == Priority::Visible && m_queue.removeOne(filePath))
+            m_urgent.append(filePath);
+        return nullptr;
+    }
 
-    WaveformData cached;
+    Entry cached;
     if (loadFromDisk(filePath, cached)) {
+        m_residentBytes += cached.data.residentBytes();
         m_cache.insert(filePath, cached);
+        scheduleTrim();
         return peek(filePath);
     }
 
     m_pending.insert(filePath);
-    m_queue.append(filePath);
+    (priority == Priority::Visible ? m_urgent : m_queue).append(filePath);
     startNext();
     return nullptr;
 }
 
+void WaveformStore::prefetch(const QStringList &filePaths)
+{
+    const bool packed = openPack();
+    for (const QString &path : filePaths) {
+        if (path.isEmpty() || m_cache.contains(path) || m_pending.contains(path))
+            continue;
+        const auto it = packed ? m_packIndex.constFind(cacheKey(path)) : m_packIndex.constEnd();
+        if (it != m_packIndex.constEnd()) {
+            Entry entry; // evicted state: peek() maps the peaks in
+            entry.ref = it.value();
+            entry.data.durationMs = entry.ref.durationMs;
+            m_cache.insert(path, entry);
+            continue;
+        }
+        fetch(path);
+    }
+    scheduleTrim();
+}
+
 void WaveformStore::startNext()
 {
-    while (m_running < kMaxParallelJobs && !m_queue.isEmpty()) {
-        const QString path = m_queue.takeFirst();
+    while (m_running < m_maxJobs && (!m_urgent.isEmpty() || !m_queue.isEmpty())) {
+        const QString path = !m_urgent.isEmpty() ? m_urgent.takeFirst() : m_queue.takeFirst();
 
         const QString ffmpeg = FxEngine::ffmpegExecutable();
         if (ffmpeg.isEmpty() || !QFile::exists(path)) {
             WaveformData failed;
             failed.failed = true;
-            m_cache.insert(path, failed);
-            m_pending.remove(path);
-            emit waveformReady(path);
+            finishJob(path, failed);
             continue;
         }
 
         ++m_running;
         auto *proc = new QProcess(this);
-        auto *job = new DecodeJob;
+        auto *job = new WaveformScanner;
 
         connect(proc, &QProcess::readyReadStandardOutput, this, [proc, job]() {
-            consumePcm(*job, proc->readAllStandardOutput());
+            job->consume(proc->readAllStandardOutput());
         });
         connect(proc, &QProcess::finished, this,
                 [this, proc, job, path](int exitCode, QProcess::ExitStatus status) {
-            consumePcm(*job, proc->readAllStandardOutput());
+            job->consume(proc->readAllStandardOutput());
 
             WaveformData result;
-            if (status == QProcess::NormalExit && exitCode == 0 && !job->peaks.isEmpty()) {
-                result.peaks = job->peaks;
-                result.durationMs = qint64(job->peaks.size()) * MsPerPeak;
-                saveToDisk(path, result);
+            if (status == QProcess::NormalExit && exitCode == 0 && !job->isEmpty()) {
+                result = job->take();
             } else {
                 qWarning() << "WaveformStore: ffmpeg decode failed for" << path
                            << proc->readAllStandardError();
                 result.failed = true;
             }
-            m_cache.insert(path, result);
-            m_pending.remove(path);
 
             delete job;
             proc->deleteLater();
             --m_running;
-            emit waveformReady(path);
+            finishJob(path, result);
             startNext();
         });
         connect(proc, &QProcess::errorOccurred, this,
@@ -129,78 +174,253 @@ void WaveformStore::startNext()
                 return; // finished() will handle it
             WaveformData failed;
             failed.failed = true;
-            m_cache.insert(path, failed);
-            m_pending.remove(path);
             delete job;
             proc->deleteLater();
             --m_running;
-            emit waveformReady(path);
+            finishJob(path, failed);
             startNext();
         });
 
-        proc->start(ffmpeg,
-                    {QStringLiteral("-v"), QStringLiteral("error"),
-                     QStringLiteral("-nostdin"),
-                     QStringLiteral("-i"), path,
-                     QStringLiteral("-vn"),
-                     QStringLiteral("-ac"), QStringLiteral("1"),
-                     QStringLiteral("-ar"), QString::number(kSampleRate),
-                     QStringLiteral("-f"), QStringLiteral("s16le"),
-                     QStringLiteral("-")});
+        proc->start(ffmpeg, WaveformScanner::ffmpegArguments(path));
+    }
+}
+
+void WaveformStore::finishJob(const QString &path, const WaveformData &result)
+{
+    Entry entry;
+    entry.data = result;
+    if (result.ready()) {
+        entry.ref = appendToPack(cacheKey(path), result);
+        m_residentBytes += result.residentBytes();
     }
+    m_cache.insert(path, entry);
+    scheduleTrim();
+    m_pending.remove(path);
+    emit waveformReady(path);
 }
 
-QString WaveformStore::cacheFileFor(const QString &filePath) const
+QByteArray WaveformStore::cacheKey(const QString &filePath)
 {
     const QFileInfo info(filePath);
     const QByteArray key = QString(filePath + QLatin1Char('|')
                                    + QString::number(info.size()) + QLatin1Char('|')
                                    + QString::number(info.lastModified().toSecsSinceEpoch()))
                                .toUtf8();
-    const QString dir = QStandardPaths::writableLocation(QStandardPaths::CacheLocation)
-                        + QStringLiteral("/waveforms");
-    return dir + QLatin1Char('/')
-           + QString::fromLatin1(QCryptographicHash::hash(key, QCryptographicHash::Sha1).toHex())
-           + QStringLiteral(".wf");
+    return QCryptographicHash::hash(key, QCryptographicHash::Sha1);
 }
 
-bool WaveformStore::loadFromDisk(const QString &filePath, WaveformData &out) const
+bool WaveformStore::loadFromDisk(const QString &filePath, Entry &out)
 {
-    QFile file(cacheFileFor(filePath));
-    if (!file.open(QIODevice::ReadOnly))
+    if (!openPack())
         return false;
+    const QByteArray key = cacheKey(filePath);
 
-    QDataStream in(&file);
-    quint32 magic = 0;
-    quint16 version = 0;
-    in >> magic >> version;
-    if (magic != kCacheMagic || version != kCacheVersion)
+    const auto it = m_packIndex.constFind(key);
+    if (it == m_packIndex.constEnd())
         return false;
+    out.ref = it.value();
+    out.data.durationMs = out.ref.durationMs;
+    return readRecord(out.ref, out.data);
+}
+
+// ------------------------------------------------------------------ pack file
 
-    qint64 durationMs = 0;
-    QByteArray peaks;
-    in >> durationMs >> peaks;
-    if (in.status() != QDataStream::Ok || peaks.isEmpty() || durationMs <= 0)
+bool WaveformStore::openPack()
+{
+    if (m_packTried)
+        return m_pack.isOpen();
+    m_packTried = true;
+
+    const QString dir = QStandardPaths::writableLocation(QStandardPaths::CacheLocation)
+                        + QStringLiteral("/waveforms");
+    QDir().mkpath(dir);
+    m_pack.setFileName(dir + QStringLiteral("/peaks.pack"));
+    if (!m_pack.open(QIODevice::ReadWrite)) {
+        qWarning() << "WaveformStore: cannot open" << m_pack.fileName() << m_pack.errorString();
         return false;
+    }
 
-    out.durationMs = durationMs;
-    out.peaks.resize(peaks.size());
-    memcpy(out.peaks.data(), peaks.constData(), size_t(peaks.size()));
-    out.failed = false;
+    char header[kPackHeaderBytes];
+    const bool valid = m_pack.size() >= kPackHeaderBytes && m_pack.size() <= kMaxPackBytes
+                       && m_pack.read(header, kPackHeaderBytes) == kPackHeaderBytes
+                       && qFromLittleEndian<quint32>(header) == kPackMagic
+                       && qFromLittleEndian<quint16>(header + 4) == kPackVersion;
+    if (!valid) {
+        // New, foreign, outdated or full: start over. One-file-per-track
+        // caches from before the pack go too; they hold no pyramid.
+        const QStringList legacy = QDir(dir).entryList({QStringLiteral("*.wf")}, QDir::Files);
+        for (const QString &name : legacy)
+            QFile::remove(dir + QLatin1Char('/') + name);
+        qToLittleEndian<quint32>(kPackMagic, header);
+        qToLittleEndian<quint16>(kPackVersion, header + 4);
+        qToLittleEndian<quint16>(0, header + 6);
+        if (!m_pack.resize(0) || !m_pack.seek(0)
+                || m_pack.write(header, kPackHeaderBytes) != kPackHeaderBytes) {
+            m_pack.close();
+            return false;
+        }
+        m_pack.flush();
+    }
+    mapPack();
+
+    // Index the records: only their headers are touched
+    const qint64 size = m_pack.size();
+    qint64 pos = kPackHeaderBytes;
+    char rec[kRecordHeaderBytes];
+    while (pos + kRecordHeaderBytes <= size) {
+        if (!readPack(pos, rec, kRecordHeaderBytes))
+            break;
+        PackRef ref;
+        ref.durationMs = qFromLittleEndian<qint64>(rec + kKeyBytes);
+        ref.count = qFromLittleEndian<quint32>(rec + kKeyBytes + 8);
+        ref.buckets = qFromLittleEndian<quint32>(rec + kKeyBytes + 12);
+        ref.offset = pos + kRecordHeaderBytes;
+        const qint64 end = ref.offset + payloadBytes(ref.count, ref.buckets);
+        if (end > size)
+            break;
+        m_packIndex.insert(QByteArray(rec, kKeyBytes), ref);
+        pos = end;
+    }
+    if (pos < size) {
+        // A record cut short (crash mid-append): drop it
+        if (m_map) {
+            m_pack.unmap(m_map);
+            m_map = nullptr;
+        }
+        m_pack.resize(pos);
+        mapPack();
+    }
     return true;
 }
 
-void WaveformStore::saveToDisk(const QString &filePath, const WaveformData &data) const
+void WaveformStore::mapPack()
+{
+    if (m_map)
+        m_pack.unmap(m_map);
+    m_mapSize = m_pack.size();
+    m_map = m_mapSize > 0 ? m_pack.map(0, m_mapSize) : nullptr;
+}
+
+WaveformStore::PackRef WaveformStore::appendToPack(const QByteArray &key, const WaveformData &data)
 {
-    const QString cachePath = cacheFileFor(filePath);
-    QDir().mkpath(QFileInfo(cachePath).absolutePath());
+    PackRef ref;
+    if (!openPack() || key.size() != kKeyBytes)
+        return ref;
+
+    if (data.levels.size() != WaveformData::LevelCount)
+        return ref;
+    const quint32 buckets = quint32(data.levels[0].buckets());
+    const qint64 pos = m_pack.size();
+    if (pos + kRecordHeaderBytes + payloadBytes(quint32(data.peaks.size()), buckets) > kMaxPackBytes)
+        return ref; // full: kept in memory only, the pack restarts next run
+
+    char rec[kRecordHeaderBytes];
+    memcpy(rec, key.constData(), kKeyBytes);
+    qToLittleEndian<qint64>(data.durationMs, rec + kKeyBytes);
+    qToLittleEndian<quint32>(quint32(data.peaks.size()), rec + kKeyBytes + 8);
+    qToLittleEndian<quint32>(buckets, rec + kKeyBytes + 12);
+    bool written = m_pack.seek(pos)
+                   && m_pack.write(rec, kRecordHeaderBytes) == kRecordHeaderBytes
+                   && m_pack.write(reinterpret_cast<const char *>(data.peaks.constData()),
+                                   data.peaks.size()) == data.peaks.size();
+    for (int k = 0; written && k < WaveformData::LevelCount; ++k) {
+        const QVector<qint8> &minMax = data.levels[k].minMax;
+        written = m_pack.write(reinterpret_cast<const char *>(minMax.constData()),
+                               minMax.size()) == minMax.size();
+    }
+    if (!written) {
+        qWarning() << "WaveformStore: cannot append to" << m_pack.fileName()
+                   << m_pack.errorString();
+        m_pack.resize(pos);
+        return ref;
+    }
+    m_pack.flush();
+    // Remapping the whole pack per record would cost a munmap/mmap pair
+    // per extraction; the tail is read through the file until it is worth
+    // it
+    if (m_pack.size() - m_mapSize >= kMapChunkBytes)
+        mapPack();
 
-    QFile file(cachePath);
-    if (!file.open(QIODevice::WriteOnly))
+    ref.offset = pos + kRecordHeaderBytes;
+    ref.count = quint32(data.peaks.size());
+    ref.buckets = buckets;
+    ref.durationMs = data.durationMs;
+    m_packIndex.insert(key, ref);
+    return ref;
+}
+
+bool WaveformStore::readPack(qint64 offset, void *out, qint64 bytes) const
+{
+    if (m_map && offset + bytes <= m_mapSize) {
+        memcpy(out, m_map + offset, size_t(bytes));
+        return true;
+    }
+    return m_pack.isOpen() && m_pack.seek(offset)
+           && m_pack.read(static_cast<char *>(out), bytes) == bytes;
+}
+
+bool WaveformStore::readRecord(const PackRef &ref, WaveformData &out) const
+{
+    out.peaks.resize(ref.count);
+    if (!readPack(ref.offset, out.peaks.data(), ref.count))
+        return false;
+    qint64 offset = ref.offset + ref.count;
+    out.levels.resize(WaveformData::LevelCount);
+    for (int k = 0; k < WaveformData::LevelCount; ++k) {
+        const qint64 bytes = levelBytes(k, ref.buckets);
+        out.levels[k].minMax.resize(bytes);
+        if (!readPack(offset, out.levels[k].minMax.data(), bytes))
+            return false;
+        offset += bytes;
+    }
+    return true;
+}
+
+// ------------------------------------------------- resident peak and entry budget
+
+void WaveformStore::scheduleTrim() const
+{
+    if (m_trimScheduled || (m_residentBytes <= kMaxResidentBytes && m_cache.size() <= kMaxCachedFiles))
+        return;
+    m_trimScheduled = true;
+    // Deferred: pointers handed out by peek() stay valid until then
+    QTimer::singleShot(0, const_cast<WaveformStore *>(this), &WaveformStore::trimResident);
+}
+
+void WaveformStore::trimResident()
+{
+    m_trimScheduled = false;
+    const bool overBytes = m_residentBytes > kMaxResidentBytes;
+    const bool overFiles = m_cache.size() > kMaxCachedFiles;
+    if (!overBytes && !overFiles)
         return;
 
-    QDataStream outStream(&file);
-    outStream << kCacheMagic << kCacheVersion << data.durationMs
-              << QByteArray(reinterpret_cast<const char *>(data.peaks.constData()),
-                            data.peaks.size());
+    // Oldest first, down to 3/4 of the budget so the next few loads do not
+    // trigger another pass. Keys, not iterators: erasing moves QHash
+    // entries around.
+    std::vector<std::pair<quint64, QString>> byAge;
+    byAge.reserve(size_t(m_cache.size()));
+    for (auto it = m_cache.cbegin(); it != m_cache.cend(); ++it)
+        byAge.emplace_back(it->lastUse, it.key());
+    std::sort(byAge.begin(), byAge.end());
+
+    for (const auto &aged : byAge) {
+        const bool trimBytes = overBytes && m_residentBytes > kMaxResidentBytes * 3 / 4;
+        const bool trimFiles = overFiles && m_cache.size() > kMaxCachedFiles * 3 / 4;
+        if (!trimBytes && !trimFiles)
+            break;
+        const auto it = m_cache.find(aged.second);
+        Entry &entry = it.value();
+        if (trimFiles || (entry.ref.offset < 0 && !entry.data.peaks.isEmpty())) {
+            // Forgotten: fetch() finds it in the pack index again, or
+            // extracts it anew if the pack could not take it
+            m_residentBytes -= entry.data.residentBytes();
+            m_cache.erase(it);
+        } else if (!entry.data.peaks.isEmpty()) {
+            // Evicted: peek() maps the peaks back in
+            m_residentBytes -= entry.data.residentBytes();
+            entry.data.peaks = QVector<quint8>();
+            entry.data.levels = QVector<WaveformData::Level>();
+        }
+    }
 }
@@ -1,63 +1,121 @@
 #ifndef WAVEFORMSTORE_H
 #define WAVEFORMSTORE_H
 
+#include "WaveformData.h"
+
+#include <QByteArray>
+#include <QFile>
 #include <QHash>
 #include <QObject>
 #include <QSet>
 #include <QStringList>
-#include <QVector>
-
-/**
- * Amplitude envelope ("sound wave") of one audio file: one 0..255 peak
- * value per MsPerPeak milliseconds of audio.
- */
-struct WaveformData
-{
-    qint64 durationMs = 0;
-    QVector<quint8> peaks;
-    bool failed = false;
-
-    bool ready() const { return !peaks.isEmpty(); }
-};
 
 /**
  * Asynchronous provider of waveforms for local audio files.
  *
  * Files are decoded with the same ffmpeg executable the FX engine uses
- * (FxEngine::ffmpegExecutable) to low-rate mono PCM and reduced to one
- * peak per 20 ms. Results are cached in memory and on disk
- * (CacheLocation/waveforms, keyed by path + size + mtime), so a playlist
- * only pays the decode cost once per file.
+ * (FxEngine::ffmpegExecutable) to low-rate mono PCM and reduced by a
+ * WaveformScanner to one peak per 20 ms plus the min/max pyramid, from
+ * 5 ms buckets up. Extractions run on a pool of ffmpeg
+ * processes scaled to the core count; rows on screen jump the queue, and
+ * a file is only ever extracted once however often it is asked for.
+ *
+ * Results live in one memory-mapped pack file (CacheLocation/waveforms,
+ * entries keyed by path + size + mtime): a playlist only pays the decode
+ * cost once per file, and reloading it costs page faults, not file opens.
+ * The pyramid is stored with the peaks, so a reload never rebuilds it.
+ * The map is extended once kMapChunkBytes have been appended past it;
+ * newer records are read through the file meanwhile.
+ * In memory, peaks are kept for at most kMaxResidentBytes worth of tracks;
+ * the least recently used are dropped and re-read from the map on demand.
+ * At most kMaxCachedFiles files are remembered at all: past that the
+ * least recently used are forgotten and looked up in the pack again.
+ *
+ * Pointers returned by peek() / fetch() stay valid until control returns
+ * to the event loop (eviction is deferred to it).
  */
 class WaveformStore : public QObject
 {
     Q_OBJECT
 
 public:
-    static constexpr int MsPerPeak = 20;
+    static constexpr int MsPerPeak = WaveformData::MsPerPeak;
+    static constexpr qint64 kMaxResidentBytes = qint64(64) << 20;
+    static constexpr int kMaxCachedFiles = 16384;
+    static constexpr qint64 kMapChunkBytes = qint64(8) << 20;
+
+    /** Queue position of an extraction: on-screen rows go first. */
+    enum class Priority { Background, Visible };
 
     explicit WaveformStore(QObject *parent = nullptr);
+    ~WaveformStore() override;
 
     /** Returns the waveform if already known (possibly a failed marker). */
     const WaveformData *peek(const QString &filePath) const;
 
     /** Like peek(), but schedules a background extraction when unknown. */
-    const WaveformData *fetch(const QString &filePath);
+    const WaveformData *fetch(const QString &filePath, Priority priority = Priority::Background);
+
+    /**
+     * Make filePaths known without loading anything: packed waveforms are
+     * only indexed (peaks are read on the first peek()), the rest queued
+     * for background extraction.
+     */
+    void prefetch(const QStringList &filePaths);
 
 signals:
     /** Emitted when an extraction finishes, successfully or not. */
     void waveformReady(const QString &filePath);
 
 private:
+    // Where an entry's peaks and pyramid sit in the pack file
+    struct PackRef
+    {
+        qint64 offset = -1; // of the peak bytes; -1 = not in the pack
+        quint32 count = 0;   // peaks
+        quint32 buckets = 0; // finest pyramid level
+        qint64 durationMs = 0;
+    };
+    struct Entry
+    {
+        WaveformData data;  // peaks and levels empty while evicted
+        PackRef ref;
+        quint64 lastUse = 0;
+    };
+
     void startNext();
-    QString cacheFileFor(const QString &filePath) const;
-    bool loadFromDisk(const QString &filePath, WaveformData &out) const;
-    void saveToDisk(const QString &filePath, const WaveformData &data) const;
+    void finishJob(const QString &path, const WaveformData &result);
+    static QByteArray cacheKey(const QString &filePath);
+    bool loadFromDisk(const QString &filePath, Entry &out);
 
-    QHash<QString, WaveformData> m_cache;
+    // Pack file
+    bool openPack();
+    void mapPack();
+    PackRef appendToPack(const QByteArray &key, const WaveformData &data);
+    bool readPack(qint64 offset, void *out, qint64 bytes) const;
+    bool readRecord(const PackRef &ref, WaveformData &out) const;
+
+    // Resident peak and entry budget
+    void touch(Entry &entry) const { entry.lastUse = ++m_useClock; }
+    void scheduleTrim() const;
+    void trimResident();
+
+    mutable QHash<QString, Entry> m_cache;
+    QStringList m_urgent;     // queued visible rows, served first
     QStringList m_queue;
-    QSet<QString> m_pending; // queued or currently decoding
+    QSet<QString> m_pending;  // queued or currently decoding
     int m_running = 0;
+    int m_maxJobs = 2;
+
+    mutable QFile m_pack;     // read through when the map is unavailable
+    uchar *m_map = nullptr;
+    qint64 m_mapSize = 0;
+    bool m_packTried = false;
+    QHash<QByteArray, PackRef> m_packIndex; // key -> newest record
+
+    mutable qint64 m_residentBytes = 0;
+    mutable quint64 m_useClock = 0;
+    mutable bool m_trimScheduled = false;
 };
 
 #endif // WAVEFORMSTORE_H
@@ -212,9 +212,12 @@ void FxChannelPanel::applyAndSave()
     if (m_loading)
         return;
 
-    // The 432 Hz switch lives in the Options dialog; always take the
-    // current global value so an EQ tweak can never apply a stale one.
+    // The 432 Hz and normalization switches live in the Options dialog;
+    // always take the current global values so an EQ tweak can never apply
+    // stale ones.
     m_params.retune432 = FxSettings::loadRetune432();
+    m_params.normalize = FxSettings::loadNormalize();
+    m_params.normalizeTargetLufs = FxSettings::loadNormalizeTargetLufs();
 
     m_params.eqEnabled = m_eqEnable->isChecked();
     m_params.preampDb = m_preampSlider->value();
@@ -238,7 +241,9 @@ void FxChannelPanel::applyAndSave()
 void FxChannelPanel::resetChannel()
 {
     m_params = FxParams();
-    m_params.retune432 = FxSettings::loadRetune432(); // global flag is not reset here
+    m_params.retune432 = FxSettings::loadRetune432(); // global flags are not reset here
+    m_params.normalize = FxSettings::loadNormalize();
+    m_params.normalizeTargetLufs = FxSettings::loadNormalizeTargetLufs();
     loadIntoUi();
     m_presetBox->setCurrentIndex(0);
     FxSettings::saveChannel(m_channelKey, m_params);
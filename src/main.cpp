@@ -1,5 +1,11 @@
 #include "player.h"
+#include "PlaylistWaveView.h"
 #include "ThemeManager.h"
+#include "audio/FxPlayer.h"
+#include "audio/FxRenderer.h"
+#include "audio/TrackAnalysisStore.h"
+#include "services/DatabaseAccess.h"
+#include "services/TrackTrimmer.h"
 
 #include <QApplication>
 #include <QCoreApplication>
@@ -19,6 +25,10 @@
 #include <QLibraryInfo>
 #include <QEvent>
 #include <QFont>
+#include <QCommandLineParser>
+#include <QTextStream>
+#include <QTime>
+#include <QXmlStreamReader>
 #include "services/TorrentTypes.h"
 
 #include <csignal>
@@ -353,10 +363,141 @@ private:
     double m_scale;
 };
 
+// Tracks of a saved XFB playlist (Playlist > Save), with the overlap and
+// volume line attributes the wave view stores on each entry
+static QList<FxRenderer::Track> loadRenderPlaylist(const QString &path, QString *error)
+{
+    QList<FxRenderer::Track> tracks;
+    QFile file(path);
+    if (!file.open(QFile::ReadOnly | QFile::Text)) {
+        *error = QStringLiteral("cannot open %1: %2").arg(path, file.errorString());
+        return tracks;
+    }
+    QXmlStreamReader xml(&file);
+    bool isPlaylist = false;
+    while (!xml.atEnd()) {
+        if (!xml.readNextStartElement())
+            continue;
+        if (xml.name() == QLatin1String("XFBPlaylist")) {
+            isPlaylist = true;
+        } else if (xml.name() == QLatin1String("track")) {
+            FxRenderer::Track track;
+            // Same sanity bound as loading the playlist in the GUI
+            track.overlapMs = qBound(qint64(0),
+                qint64(xml.attributes().value(QStringLiteral("overlap")).toLongLong()),
+                qint64(600000));
+            track.volumeLine = PlaylistWaveView::parseEnvelope(
+                xml.attributes().value(QStringLiteral("volenv")).toString());
+            track.path = xml.readElementText().trimmed();
+            if (!track.path.isEmpty()) {
+                // Cued as on air: the stored trim and the cached analysis
+                TrackAnalysis analysis;
+                FxPlayer::lookupCue(track.path, &analysis, &track.cue);
+                tracks.append(track);
+            }
+        }
+    }
+    if (xml.hasError() || !isPlaylist) {
+        *error = QStringLiteral("%1 is not an XFB playlist%2").arg(path,
+            xml.hasError() ? QStringLiteral(" (%1)").arg(xml.errorString()) : QString());
+        tracks.clear();
+    }
+    return tracks;
+}
+
+// Headless bounce of a playlist through the FX engine chain; runs without
+// a display, before any GUI object exists
+static int runRenderCommand(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("XFB");
+    QCoreApplication::setApplicationVersion(XFB_VERSION);
+    QCoreApplication::setOrganizationName("Netpack - Online Solutions");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Render an XFB playlist to one audio file, as it plays on air.");
+    parser.addHelpOption();
+    QCommandLineOption renderOpt("render", "XFB playlist (.xml) to render.", "playlist");
+    QCommandLineOption outputOpt({"o", "output"},
+        "Output file: .wav is written directly, other extensions are encoded by ffmpeg, "
+        "\"null\" discards the audio (benchmark).", "file");
+    QCommandLineOption noFxOpt("no-fx", "Bypass the Main channel EQ, compressor and 432 Hz retune.");
+    QCommandLineOption threadsOpt("threads", "Tracks decoded ahead in parallel (default: cores - 1).", "n");
+    parser.addOptions({renderOpt, outputOpt, noFxOpt, threadsOpt});
+    parser.process(app);
+
+    QTextStream out(stdout);
+    QTextStream err(stderr);
+    const QString playlistPath = parser.value(renderOpt);
+    const QString outputPath = parser.value(outputOpt);
+    if (playlistPath.isEmpty() || outputPath.isEmpty()) {
+        err << "Usage: XFB --render <playlist.xml> --output <file> [--no-fx] [--threads n]\n";
+        return 2;
+    }
+
+    // The trims Auto-Trim stored live in the library, where the GUI keeps
+    // it; a library that is not there yet only leaves them out
+    const QString libraryPath = QStandardPaths::writableLocation(QStandardPaths::AppDataLocation)
+                                + "/" + QCoreApplication::applicationName() + "/adb.db";
+    const QString libraryConnection = QStringLiteral("xfb_render");
+    const bool hasLibrary = QFile::exists(libraryPath);
+    if (hasLibrary) {
+        const QSqlDatabase library = DatabaseAccess::openConnection(libraryConnection,
+                                                                    "QSQLITE", libraryPath);
+        if (library.isOpen()) {
+            FxPlayer::setTrimLookup([library](const QString &path, qint64 *startMs, qint64 *endMs) {
+                return TrackTrimmer::storedCut(library, path, startMs, endMs);
+            });
+        }
+    }
+    QString error;
+    const QList<FxRenderer::Track> tracks = loadRenderPlaylist(playlistPath, &error);
+    if (hasLibrary) {
+        FxPlayer::setTrimLookup(FxPlayer::TrimLookup()); // drops its handle first
+        DatabaseAccess::closeConnection(libraryConnection);
+    }
+    if (tracks.isEmpty()) {
+        err << "XFB render: " << (error.isEmpty() ? QStringLiteral("the playlist is empty") : error) << "\n";
+        return 1;
+    }
+
+    const FxParams params = parser.isSet(noFxOpt) ? FxParams()
+                                                  : FxSettings::loadChannel(QStringLiteral("Main"));
+    FxRenderer renderer(params);
+    renderer.setLookahead(parser.value(threadsOpt).toInt());
+    renderer.setProgressCallback([&err, &tracks](int trackIndex, qint64 renderedMs) {
+        err << QStringLiteral("\r[%1/%2] %3 rendered")
+                   .arg(trackIndex + 1).arg(tracks.size())
+                   .arg(QTime(0, 0).addMSecs(int(renderedMs)).toString("hh:mm:ss"));
+        err.flush();
+    });
+
+    FxRenderer::Result result;
+    const bool ok = renderer.render(tracks, outputPath, &result, &error);
+    err << "\n";
+    if (!ok) {
+        err << "XFB render failed: " << error << "\n";
+        return 1;
+    }
+    out << QStringLiteral("Rendered %1 track(s), %2 of audio in %3 s (%4x real time) to %5\n")
+               .arg(result.tracks)
+               .arg(QTime(0, 0).addMSecs(int(result.renderedMs)).toString("hh:mm:ss"))
+               .arg(result.elapsedMs / 1000.0, 0, 'f', 1)
+               .arg(result.speed(), 0, 'f', 1)
+               .arg(outputPath);
+    return 0;
+}
+
 int main(int argc, char *argv[])
 {
     qDebug() << "XFB main() starting...";
 
+    // Offline render is a pure command-line run: no QApplication, no display
+    for (int i = 1; i < argc; ++i) {
+        if (qstrcmp(argv[i], "--render") == 0 || qstrncmp(argv[i], "--render=", 9) == 0)
+            return runRenderCommand(argc, argv);
+    }
+
     // 1. Platform setup (before QApplication)
     setupPlatformPluginPath(argc, argv);
     setupMultimediaEnvironment();
@@ -395,6 +536,8 @@ int main(int argc, char *argv[])
         qDebug() << "  --help, -h       Show this help";
         qDebug() << "  --minimal        Start in minimal mode";
         qDebug() << "  --no-dialogs     Disable popup dialogs";
+        qDebug() << "  --render <playlist.xml> --output <file> [--no-fx] [--threads n]";
+        qDebug() << "                   Render a playlist offline to one audio file";
         return 0;
     }
 
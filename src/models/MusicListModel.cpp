@@ -1,75 +1,103 @@
 #include "MusicListModel.h"
 #include "../repositories/MusicRepository.h"
+#include "../services/DatabaseAccess.h"
+#include "../services/QueryProfiler.h"
+#include <QSqlDatabase>
 #include <QSqlQuery>
 #include <QSqlError>
-#include <QDateTime>
+#include <QColor>
+#include <QSet>
 #include <QDebug>
-#include <QApplication>
 #include <QtConcurrent>
-#include <QThread>
 #include <algorithm>
 
+namespace {
+// Selected in enum order after the rowid, so value(1 + column) is column
+const QString kSelectColumns = QStringLiteral(
+    "rowid, id, artist, song, genre1, genre2, country, published_date, "
+    "path, time, played_times, last_played");
+
+constexpr int kMaxUrgentPages = 8;   // older on-screen requests have been scrolled past
+constexpr int kMaxPreloadPages = 16;
+constexpr int kRefreshDelayMs = 200; // coalesces bursts of repository signals
+} // namespace
+
 // Static member definitions
 const QStringList MusicListModel::s_columnHeaders = {
-    QObject::tr("ID"),
-    QObject::tr("Title"),
-    QObject::tr("Artist"),
-    QObject::tr("Album"),
-    QObject::tr("Genre"),
-    QObject::tr("Duration"),
-    QObject::tr("Path"),
-    QObject::tr("Date Added"),
-    QObject::tr("Play Count"),
-    QObject::tr("Last Played")
+    QT_TRANSLATE_NOOP("MusicListModel", "ID"),
+    QT_TRANSLATE_NOOP("MusicListModel", "Artist"),
+    QT_TRANSLATE_NOOP("MusicListModel", "Song"),
+    QT_TRANSLATE_NOOP("MusicListModel", "Genre 1"),
+    QT_TRANSLATE_NOOP("MusicListModel", "Genre 2"),
+    QT_TRANSLATE_NOOP("MusicListModel", "Country"),
+    QT_TRANSLATE_NOOP("MusicListModel", "Published"),
+    QT_TRANSLATE_NOOP("MusicListModel", "Path"),
+    QT_TRANSLATE_NOOP("MusicListModel", "Time"),
+    QT_TRANSLATE_NOOP("MusicListModel", "Played"),
+    QT_TRANSLATE_NOOP("MusicListModel", "Last Played")
 };
 
 const QStringList MusicListModel::s_sqlColumnNames = {
     "id",
-    "song",
     "artist",
-    "album",
+    "song",
     "genre1",
-    "duration",
+    "genre2",
+    "country",
+    "published_date",
     "path",
-    "date_added",
-    "play_count",
+    "time",
+    "played_times",
     "last_played"
 };
 
 MusicListModel::MusicListModel(MusicRepository* repository, QObject* parent)
     : QAbstractTableModel(parent)
     , m_repository(repository)
-    , m_itemCache(1000) // Default cache size
+    , m_pages(5000)
     , m_totalCount(0)
-    , m_loadedCount(0)
     , m_batchSize(100)
+    , m_generation(0)
+    , m_liveGeneration(std::make_shared<std::atomic<int>>(0))
+    , m_countPending(false)
+    , m_anchorsPending(false)
+    , m_runningPage(-1)
+    , m_runningUrgent(false)
+    , m_lastJobFailed(false)
     , m_loadingState(Idle)
-    , m_loadingWatcher(new QFutureWatcher<QList<MusicItem>>(this))
+    , m_loadingWatcher(new QFutureWatcher<JobResult>(this))
     , m_cacheCleanupTimer(new QTimer(this))
     , m_preloadTimer(new QTimer(this))
+    , m_refreshTimer(new QTimer(this))
+    , m_lastRequestedRow(-1)
     , m_sortColumn(ColumnTitle)
     , m_sortOrder(Qt::AscendingOrder)
-    , m_maxCacheSize(1000)
+    , m_maxCacheSize(5000)
     , m_preloadRadius(50)
     , m_cacheCleanupInterval(30000) // 30 seconds
 {
-    // Setup cache
-    m_itemCache.setMaxCost(m_maxCacheSize);
-    
+    // One worker thread that keeps its connection for the model's lifetime
+    m_worker.setMaxThreadCount(1);
+    m_worker.setExpiryTimeout(-1);
+
     // Setup timers
     m_cacheCleanupTimer->setInterval(m_cacheCleanupInterval);
     m_cacheCleanupTimer->setSingleShot(false);
     connect(m_cacheCleanupTimer, &QTimer::timeout, this, &MusicListModel::onCacheCleanupTimer);
     m_cacheCleanupTimer->start();
-    
+
     m_preloadTimer->setInterval(100); // 100ms delay for preloading
     m_preloadTimer->setSingleShot(true);
     connect(m_preloadTimer, &QTimer::timeout, this, &MusicListModel::onPreloadTimer);
-    
+
+    m_refreshTimer->setInterval(kRefreshDelayMs);
+    m_refreshTimer->setSingleShot(true);
+    connect(m_refreshTimer, &QTimer::timeout, this, &MusicListModel::refresh);
+
     // Setup async loading
-    connect(m_loadingWatcher, &QFutureWatcher<QList<MusicItem>>::finished,
+    connect(m_loadingWatcher, &QFutureWatcher<JobResult>::finished,
             this, &MusicListModel::onDataLoadingFinished);
-    
+
     // Connect to repository signals if available
     if (m_repository) {
         connect(m_repository, &MusicRepository::musicAdded,
@@ -78,33 +106,43 @@ MusicListModel::MusicListModel(MusicRepository* repository, QObject* parent)
                 this, &MusicListModel::onMusicItemUpdated);
         connect(m_repository, &MusicRepository::musicDeleted,
                 this, &MusicListModel::onMusicItemRemoved);
-        
-        // Initialize total count
-        updateTotalCount();
+
+        // Count and index in the background
+        invalidate(false, true);
     }
-    
-    qDebug() << "MusicListModel: Initialized with batch size" << m_batchSize 
+
+    qDebug() << "MusicListModel: Initialized with batch size" << m_batchSize
              << "and cache size" << m_maxCacheSize;
 }
 
 MusicListModel::~MusicListModel()
 {
-    // Cancel any ongoing loading
-    if (m_loadingWatcher && m_loadingWatcher->isRunning()) {
-        m_loadingWatcher->cancel();
-        m_loadingWatcher->waitForFinished();
-    }
+    // Stop an anchor scan early, then let the worker drop its connection
+    m_liveGeneration->store(-1);
+    disconnect(m_loadingWatcher, nullptr, this, nullptr);
+    m_loadingWatcher->waitForFinished();
+
+    const QString connectionName = currentState().connectionName;
+    QtConcurrent::run(&m_worker, [connectionName]() {
+        if (QSqlDatabase::contains(connectionName))
+            DatabaseAccess::closeConnection(connectionName);
+    }).waitForFinished();
+    m_worker.waitForDone();
 }
 
 int MusicListModel::rowCount(const QModelIndex& parent) const
 {
-    Q_UNUSED(parent)
+    if (parent.isValid()) {
+        return 0;
+    }
     return m_totalCount;
 }
 
 int MusicListModel::columnCount(const QModelIndex& parent) const
 {
-    Q_UNUSED(parent)
+    if (parent.isValid()) {
+        return 0;
+    }
     return ColumnCount;
 }
 
@@ -113,16 +151,23 @@ QVariant MusicListModel::data(const QModelIndex& index, int role) const
     if (!index.isValid() || index.row() >= m_totalCount || index.column() >= ColumnCount) {
         return QVariant();
     }
-    
-    // Check if we need to load more data
-    if (!isItemCached(index.row())) {
-        // Trigger loading for this range
-        const_cast<MusicListModel*>(this)->loadDataBatch(
-            (index.row() / m_batchSize) * m_batchSize, 
-            m_batchSize
-        );
-        
-        // Return loading indicator for now
+
+    const int row = index.row();
+    const int page = row / m_batchSize;
+    const Page* loaded = m_pages.object(page);
+    if (!loaded || loaded->generation != m_generation) {
+        requestPage(page, true);
+        m_lastRequestedRow = row;
+        m_preloadTimer->start();
+    }
+
+    const int offset = row - page * m_batchSize;
+    if (!loaded || offset >= loaded->items.size()) {
+        // Id and path stay empty so code reading them (drag, context
+        // menu) never acts on a placeholder
+        if (index.column() == ColumnId || index.column() == ColumnPath) {
+            return QVariant();
+        }
         if (role == Qt::DisplayRole) {
             return tr("Loading...");
         } else if (role == Qt::ForegroundRole) {
@@ -130,68 +175,87 @@ QVariant MusicListModel::data(const QModelIndex& index, int role) const
         }
         return QVariant();
     }
-    
-    auto item = getCachedItem(index.row());
-    if (!item) {
-        return QVariant();
-    }
-    
+
+    const MusicItem& item = loaded->items.at(offset);
+
     switch (role) {
     case Qt::DisplayRole:
     case Qt::EditRole:
-        return getDisplayData(*item, index.column());
-        
+        return getDisplayData(item, index.column());
+
     case Qt::ToolTipRole:
-        return getTooltipData(*item, index.column());
-        
+        return getTooltipData(item, index.column());
+
     case Qt::TextAlignmentRole:
         return getAlignmentData(index.column());
-        
+
     case Qt::UserRole:
-        return QVariant::fromValue(*item);
-        
+        return QVariant::fromValue(item);
+
     case Qt::UserRole + 1: // Music ID role
-        return item->id;
-        
+        return item.id;
+
     default:
         return QVariant();
     }
 }
 
-QVariant MusicListModel::headerData(int section, Qt::Orientation orientation, int role) const
+bool MusicListModel::setData(const QModelIndex& index, const QVariant& value, int role)
 {
-    if (orientation != Qt::Horizontal || section >= ColumnCount) {
-        return QVariant();
+    if (role != Qt::EditRole || !m_repository || index.column() == ColumnId) {
+        return false;
     }
-    
-    switch (role) {
-    case Qt::DisplayRole:
-        return s_columnHeaders.at(section);
-        
-    case Qt::ToolTipRole:
-        return getHeaderTooltip(section);
-        
+
+    const MusicItem* current = itemAt(index.row());
+    if (!current) {
+        return false;
+    }
+
+    MusicItem item = *current;
+    switch (index.column()) {
+    case ColumnArtist:      item.artist = value.toString(); break;
+    case ColumnTitle:       item.song = value.toString(); break;
+    case ColumnGenre1:      item.genre1 = value.toString(); break;
+    case ColumnGenre2:      item.genre2 = value.toString(); break;
+    case ColumnCountry:     item.country = value.toString(); break;
+    case ColumnPublished:   item.publishedDate = value.toString(); break;
+    case ColumnPath:        item.path = value.toString(); break;
+    case ColumnTime:        item.time = value.toString(); break;
+    case ColumnPlayedTimes: item.playedTimes = value.toInt(); break;
+    case ColumnLastPlayed:  item.lastPlayed = value.toString(); break;
     default:
-        return QVariant();
+        return false;
     }
+
+    // musicUpdated patches the loaded rows (onMusicItemUpdated)
+    return m_repository->updateMusic(item);
 }
 
-bool MusicListModel::canFetchMore(const QModelIndex& parent) const
+Qt::ItemFlags MusicListModel::flags(const QModelIndex& index) const
 {
-    Q_UNUSED(parent)
-    return m_loadedCount < m_totalCount && m_loadingState != Loading;
+    Qt::ItemFlags result = QAbstractTableModel::flags(index);
+    if (index.isValid() && index.column() != ColumnId) {
+        result |= Qt::ItemIsEditable;
+    }
+    return result;
 }
 
-void MusicListModel::fetchMore(const QModelIndex& parent)
+QVariant MusicListModel::headerData(int section, Qt::Orientation orientation, int role) const
 {
-    Q_UNUSED(parent)
-    
-    if (m_loadingState == Loading || m_loadedCount >= m_totalCount) {
-        return;
+    if (orientation != Qt::Horizontal || section < 0 || section >= ColumnCount) {
+        return QVariant();
+    }
+
+    switch (role) {
+    case Qt::DisplayRole:
+        return tr(s_columnHeaders.at(section).toUtf8().constData());
+
+    case Qt::ToolTipRole:
+        return getHeaderTooltip(section);
+
+    default:
+        return QVariant();
     }
-    
-    // Load next batch
-    loadDataBatch(m_loadedCount, m_batchSize);
 }
 
 void MusicListModel::sort(int column, Qt::SortOrder order)
@@ -199,26 +263,17 @@ void MusicListModel::sort(int column, Qt::SortOrder order)
     if (column < 0 || column >= ColumnCount) {
         return;
     }
-    
+
     if (m_sortColumn == column && m_sortOrder == order) {
         return; // No change needed
     }
-    
-    emit layoutAboutToBeChanged();
-    
+
     m_sortColumn = column;
     m_sortOrder = order;
-    
-    // Clear cache and reload data with new sorting
-    m_itemCache.clear();
-    m_loadedRanges.clear();
-    m_loadedCount = 0;
-    
-    emit layoutChanged();
-    
-    // Trigger reload of visible data
-    loadDataBatch(0, m_batchSize);
-    
+
+    // Same rows, new order: the count stands
+    invalidate(true, false);
+
     qDebug() << "MusicListModel: Sorted by column" << column << "order" << order;
 }
 
@@ -226,6 +281,16 @@ void MusicListModel::setBatchSize(int batchSize)
 {
     if (batchSize > 0 && batchSize != m_batchSize) {
         m_batchSize = batchSize;
+
+        // Page numbers change meaning; the keys are per row and stay valid
+        m_pages.clear();
+        m_pages.setMaxCost(std::max(m_maxCacheSize, m_batchSize));
+        m_urgentPages.clear();
+        m_preloadPages.clear();
+        m_runningPage = -1;
+        if (m_totalCount > 0) {
+            emit dataChanged(index(0, 0), index(m_totalCount - 1, ColumnCount - 1));
+        }
         qDebug() << "MusicListModel: Batch size set to" << batchSize;
     }
 }
@@ -239,7 +304,8 @@ void MusicListModel::setCacheSize(int maxItems)
 {
     if (maxItems > 0 && maxItems != m_maxCacheSize) {
         m_maxCacheSize = maxItems;
-        m_itemCache.setMaxCost(maxItems);
+        // Never below one page, or no page could ever be kept
+        m_pages.setMaxCost(std::max(maxItems, m_batchSize));
         qDebug() << "MusicListModel: Cache size set to" << maxItems;
     }
 }
@@ -254,112 +320,49 @@ void MusicListModel::setSearchFilter(const QString& searchText, const QList<int>
     if (m_searchText == searchText && m_searchColumns == columns) {
         return; // No change
     }
-    
-    beginResetModel();
-    
+
     m_searchText = searchText;
     m_searchColumns = columns;
-    
-    // Clear cache and reload
-    m_itemCache.clear();
-    m_loadedRanges.clear();
-    m_loadedCount = 0;
-    
-    updateTotalCount();
-    
-    endResetModel();
-    
-    // Load first batch with new filter
-    if (m_totalCount > 0) {
-        loadDataBatch(0, m_batchSize);
-    }
-    
-    emit filterResultsChanged(m_totalCount);
-    
-    qDebug() << "MusicListModel: Search filter set to" << searchText 
-             << "in columns" << columns << "- found" << m_totalCount << "results";
+    m_fullText = !searchText.isEmpty() && m_repository
+        && MusicRepository::hasSearchIndex(m_repository->database());
+    invalidate(true, true);
+
+    qDebug() << "MusicListModel: Search filter set to" << searchText << "in columns" << columns;
 }
 
-void MusicListModel::setGenreFilter(const QString& genre)
+void MusicListModel::setGenreFilter(const QString& genre1, const QString& genre2)
 {
-    if (m_genreFilter == genre) {
+    if (m_genre1Filter == genre1 && m_genre2Filter == genre2) {
         return; // No change
     }
-    
-    beginResetModel();
-    
-    m_genreFilter = genre;
-    
-    // Clear cache and reload
-    m_itemCache.clear();
-    m_loadedRanges.clear();
-    m_loadedCount = 0;
-    
-    updateTotalCount();
-    
-    endResetModel();
-    
-    // Load first batch with new filter
-    if (m_totalCount > 0) {
-        loadDataBatch(0, m_batchSize);
-    }
-    
-    emit filterResultsChanged(m_totalCount);
-    
-    qDebug() << "MusicListModel: Genre filter set to" << genre 
-             << "- found" << m_totalCount << "results";
+
+    m_genre1Filter = genre1;
+    m_genre2Filter = genre2;
+    invalidate(true, true);
+
+    qDebug() << "MusicListModel: Genre filter set to" << genre1 << genre2;
 }
 
 void MusicListModel::clearFilters()
 {
-    if (m_searchText.isEmpty() && m_genreFilter.isEmpty()) {
+    if (m_searchText.isEmpty() && m_genre1Filter.isEmpty() && m_genre2Filter.isEmpty()) {
         return; // No filters to clear
     }
-    
-    beginResetModel();
-    
+
     m_searchText.clear();
     m_searchColumns.clear();
-    m_genreFilter.clear();
-    
-    // Clear cache and reload
-    m_itemCache.clear();
-    m_loadedRanges.clear();
-    m_loadedCount = 0;
-    
-    updateTotalCount();
-    
-    endResetModel();
-    
-    // Load first batch
-    if (m_totalCount > 0) {
-        loadDataBatch(0, m_batchSize);
-    }
-    
-    emit filterResultsChanged(m_totalCount);
-    
-    qDebug() << "MusicListModel: Filters cleared - total count" << m_totalCount;
+    m_fullText = false;
+    m_genre1Filter.clear();
+    m_genre2Filter.clear();
+    invalidate(true, true);
+
+    qDebug() << "MusicListModel: Filters cleared";
 }
 
 void MusicListModel::refresh()
 {
-    beginResetModel();
-    
-    // Clear all cached data
-    m_itemCache.clear();
-    m_loadedRanges.clear();
-    m_loadedCount = 0;
-    
-    updateTotalCount();
-    
-    endResetModel();
-    
-    // Reload first batch
-    if (m_totalCount > 0) {
-        loadDataBatch(0, m_batchSize);
-    }
-    
-    qDebug() << "MusicListModel: Refreshed - total count" << m_totalCount;
+    m_refreshTimer->stop();
+    invalidate(false, true);
 }
 
 int MusicListModel::totalItemCount() const
@@ -369,7 +372,7 @@ int MusicListModel::totalItemCount() const
 
 int MusicListModel::loadedItemCount() const
 {
-    return m_loadedCount;
+    return int(m_pages.totalCost());
 }
 
 MusicListModel::LoadingState MusicListModel::loadingState() const
@@ -379,46 +382,95 @@ MusicListModel::LoadingState MusicListModel::loadingState() const
 
 std::shared_ptr<MusicItem> MusicListModel::getMusicItem(const QModelIndex& index) const
 {
-    if (!index.isValid() || index.row() >= m_totalCount) {
+    if (!index.isValid()) {
         return nullptr;
     }
-    
-    return getCachedItem(index.row());
+
+    const MusicItem* item = itemAt(index.row());
+    return item ? std::make_shared<MusicItem>(*item) : nullptr;
 }
 
 std::shared_ptr<MusicItem> MusicListModel::getMusicItemById(int musicId) const
 {
-    // QCache doesn't support iteration, so we'll query the repository directly
-    // This is a simplified implementation - in a real scenario, you might want
-    // to maintain a separate index for ID-based lookups
+    const QList<int> pages = m_pages.keys();
+    for (int page : pages) {
+        for (const MusicItem& item : m_pages.object(page)->items) {
+            if (item.id == musicId) {
+                return std::make_shared<MusicItem>(item);
+            }
+        }
+    }
+
     if (m_repository) {
-        // Query repository for the specific music item by ID
-        // This would need to be implemented in MusicRepository
-        // For now, return nullptr to avoid blocking the UI
+        const MusicItem item = m_repository->getMusicById(musicId);
+        if (item.id > 0) {
+            return std::make_shared<MusicItem>(item);
+        }
     }
     return nullptr;
 }
 
 void MusicListModel::preloadAround(const QModelIndex& index, int radius)
 {
-    if (!index.isValid() || radius <= 0) {
+    if (!index.isValid() || radius <= 0 || m_totalCount == 0) {
         return;
     }
-    
-    int centerRow = index.row();
-    int startRow = std::max(0, centerRow - radius);
-    int endRow = std::min(m_totalCount - 1, centerRow + radius);
-    
-    // Check which ranges need loading
-    for (int row = startRow; row <= endRow; row += m_batchSize) {
-        int batchStart = (row / m_batchSize) * m_batchSize;
-        int batchEnd = std::min(batchStart + m_batchSize - 1, m_totalCount - 1);
-        
-        if (!isRangeLoaded(batchStart, batchEnd)) {
-            // Schedule this batch for loading
-            QTimer::singleShot(0, this, [this, batchStart]() {
-                loadDataBatch(batchStart, m_batchSize);
-            });
+
+    const int firstPage = std::max(0, index.row() - radius) / m_batchSize;
+    const int lastPage = std::min(m_totalCount - 1, index.row() + radius) / m_batchSize;
+    for (int page = firstPage; page <= lastPage; ++page) {
+        const Page* loaded = m_pages.object(page);
+        if (!loaded || loaded->generation != m_generation) {
+            requestPage(page, false);
+        }
+    }
+}
+
+void MusicListModel::ensureLoaded(const QModelIndexList& indexes)
+{
+    if (!m_repository) {
+        return;
+    }
+
+    QSet<int> wanted;
+    for (const QModelIndex& index : indexes) {
+        if (index.isValid() && index.row() < m_totalCount) {
+            wanted.insert(index.row() / m_batchSize);
+        }
+    }
+    QList<int> pages = wanted.values();
+    std::sort(pages.begin(), pages.end());
+
+    // Room for all of them at once; cleanupCache() shrinks back
+    m_pages.setMaxCost(std::max(m_pages.maxCost(),
+                                m_pages.totalCost() + int(pages.size()) * m_batchSize));
+
+    const QueryState state = currentState();
+    for (int page : pages) {
+        const Page* loaded = m_pages.object(page);
+        if (loaded && loaded->generation == m_generation) {
+            continue;
+        }
+
+        const int start = page * m_batchSize;
+        int keyRow = 0;
+        const SortKey* key = keyBefore(start, &keyRow);
+        const JobResult result = runPage(m_repository->database(), state, m_batchSize,
+                                         key, start - keyRow);
+        if (!result.error.isEmpty()) {
+            qWarning() << "MusicListModel: Loading error:" << result.error;
+            emit loadingError(result.error);
+            return;
+        }
+
+        m_pages.insert(page, new Page{result.items, m_generation},
+                       std::max(1, int(result.items.size())));
+        if (!result.keys.isEmpty()) {
+            m_keys.insert(start + int(result.items.size()), result.keys.last());
+        }
+        const int end = std::min(start + int(result.items.size()), m_totalCount);
+        if (end > start) {
+            emit dataChanged(this->index(start, 0), this->index(end - 1, ColumnCount - 1));
         }
     }
 }
@@ -438,82 +490,111 @@ int MusicListModel::getColumnIndex(const QString& name)
 
 void MusicListModel::onRepositoryDataChanged()
 {
-    refresh();
+    scheduleRefresh();
 }
 
 void MusicListModel::onMusicItemAdded(const MusicItem& musicItem)
 {
-    // For now, just refresh the model
-    // In a more sophisticated implementation, we could insert the item
-    // at the correct position based on current sorting
-    refresh();
+    Q_UNUSED(musicItem)
+    scheduleRefresh();
 }
 
 void MusicListModel::onMusicItemUpdated(const MusicItem& musicItem)
 {
-    // QCache doesn't support iteration, so we'll need to refresh the model
-    // In a real implementation, you'd maintain a separate index for ID-based lookups
-    // For now, just refresh the entire model
-    // Clear cache and reload data
-    m_itemCache.clear();
-    m_loadedRanges.clear();
-    beginResetModel();
-    endResetModel();
+    // Patch the loaded rows in place; a changed sort value only moves the
+    // row on the next refresh
+    const QList<int> pages = m_pages.keys();
+    for (int page : pages) {
+        QList<MusicItem>& items = m_pages.object(page)->items;
+        for (int i = 0; i < items.size(); ++i) {
+            if (items.at(i).id != musicItem.id) {
+                continue;
+            }
+            items[i] = musicItem;
+            const int row = page * m_batchSize + i;
+            if (row < m_totalCount) {
+                emit dataChanged(index(row, 0), index(row, ColumnCount - 1));
+            }
+        }
+    }
 }
 
 void MusicListModel::onMusicItemRemoved(int musicId)
 {
-    // QCache doesn't support iteration, so we'll clear the cache and refresh
-    // In a real implementation, you'd maintain a separate index for ID-based lookups
-    m_itemCache.clear();
-    
-    // Refresh to get accurate count
-    refresh();
+    Q_UNUSED(musicId)
+    scheduleRefresh();
 }
 
 void MusicListModel::onDataLoadingFinished()
 {
-    if (!m_loadingWatcher->isFinished()) {
+    const JobResult result = m_loadingWatcher->result();
+    m_runningPage = -1;
+    m_runningUrgent = false;
+
+    // Filters, order or table changed while it ran. A re-sort does not
+    // queue a count of its own, so a dropped count is queued again.
+    if (result.generation != m_generation) {
+        if (result.kind == JobKind::Count) {
+            m_countPending = true;
+        }
+        startNextJob();
         return;
     }
-    
-    try {
-        QList<MusicItem> items = m_loadingWatcher->result();
-        
-        // Cache the loaded items
-        int startIndex = m_loadedCount;
-        for (int i = 0; i < items.size(); ++i) {
-            auto item = std::make_shared<MusicItem>(items.at(i));
-            cacheItem(startIndex + i, item);
-        }
-        
-        // Update loaded count
-        int oldLoadedCount = m_loadedCount;
-        m_loadedCount += items.size();
-        
-        // Mark range as loaded
-        markRangeLoaded(startIndex, startIndex + items.size() - 1);
-        
-        // Emit data changed for the loaded range
-        if (items.size() > 0) {
-            QModelIndex topLeft = index(startIndex, 0);
-            QModelIndex bottomRight = index(startIndex + items.size() - 1, ColumnCount - 1);
-            emit dataChanged(topLeft, bottomRight);
-        }
-        
-        m_loadingState = Idle;
-        emit loadingStateChanged(m_loadingState);
-        emit dataLoaded(items.size());
-        
-        qDebug() << "MusicListModel: Loaded" << items.size() << "items, total loaded:" << m_loadedCount;
-        
-    } catch (const std::exception& e) {
-        m_loadingState = Error;
-        emit loadingStateChanged(m_loadingState);
-        emit loadingError(QString("Failed to load data: %1").arg(e.what()));
-        
-        qWarning() << "MusicListModel: Loading error:" << e.what();
+
+    if (!result.error.isEmpty()) {
+        m_lastJobFailed = true;
+        qWarning() << "MusicListModel: Loading error:" << result.error;
+        emit loadingError(result.error);
+        startNextJob();
+        return;
+    }
+    m_lastJobFailed = false;
+
+    switch (result.kind) {
+    case JobKind::Count: {
+        const int oldCount = m_totalCount;
+        if (result.count > oldCount) {
+            beginInsertRows(QModelIndex(), oldCount, result.count - 1);
+            m_totalCount = result.count;
+            endInsertRows();
+        } else if (result.count < oldCount) {
+            beginRemoveRows(QModelIndex(), result.count, oldCount - 1);
+            m_totalCount = result.count;
+            endRemoveRows();
+        }
+        if (m_totalCount != oldCount) {
+            emit totalCountChanged(m_totalCount);
+        }
+        emit filterResultsChanged(m_totalCount);
+        break;
+    }
+
+    case JobKind::Anchors:
+        for (int i = 0; i < result.keys.size(); ++i) {
+            m_keys.insert((i + 1) * kAnchorStride, result.keys.at(i));
+        }
+        break;
+
+    case JobKind::Page: {
+        if (result.batch != m_batchSize) {
+            break; // read with the old page size
+        }
+        const int start = result.page * m_batchSize;
+        m_pages.insert(result.page, new Page{result.items, m_generation},
+                       std::max(1, int(result.items.size())));
+        if (!result.keys.isEmpty()) {
+            m_keys.insert(start + int(result.items.size()), result.keys.last());
+        }
+        const int end = std::min(start + int(result.items.size()), m_totalCount);
+        if (end > start) {
+            emit dataChanged(index(start, 0), index(end - 1, ColumnCount - 1));
+        }
+        emit dataLoaded(result.items.size());
+        break;
+    }
     }
+
+    startNextJob();
 }
 
 void MusicListModel::onCacheCleanupTimer()
@@ -523,208 +604,476 @@ void MusicListModel::onCacheCleanupTimer()
 
 void MusicListModel::onPreloadTimer()
 {
-    // This could implement intelligent preloading based on scroll patterns
-    // For now, it's just a placeholder
+    // Pages around where the view last asked, once scrolling pauses
+    if (m_lastRequestedRow >= 0 && m_lastRequestedRow < m_totalCount) {
+        preloadAround(index(m_lastRequestedRow, 0), std::max(m_preloadRadius, m_batchSize));
+    }
 }
 
-void MusicListModel::loadDataBatch(int offset, int count)
+void MusicListModel::requestPage(int page, bool urgent) const
 {
-    if (m_loadingState == Loading || !m_repository) {
+    if (page < 0 || page * m_batchSize >= m_totalCount || page == m_runningPage) {
         return;
     }
-    
-    // Check if this range is already loaded
-    if (isRangeLoaded(offset, offset + count - 1)) {
-        return;
+
+    if (urgent) {
+        if (!m_urgentPages.isEmpty() && m_urgentPages.first() == page) {
+            return;
+        }
+        m_urgentPages.removeOne(page);
+        m_preloadPages.removeOne(page);
+        m_urgentPages.prepend(page);
+        while (m_urgentPages.size() > kMaxUrgentPages) {
+            m_urgentPages.removeLast();
+        }
+    } else if (!m_urgentPages.contains(page) && !m_preloadPages.contains(page)) {
+        m_preloadPages.append(page);
+        while (m_preloadPages.size() > kMaxPreloadPages) {
+            m_preloadPages.removeFirst();
+        }
     }
-    
-    m_loadingState = Loading;
-    emit loadingStateChanged(m_loadingState);
-    
-    // Load data asynchronously
-    loadDataAsync(offset, count);
-}
 
-void MusicListModel::loadDataAsync(int offset, int count)
-{
-    // Create the query in the main thread
-    QString query = buildQuery();
-    query += QString(" LIMIT %1 OFFSET %2").arg(count).arg(offset);
-    
-    // Run the query in a separate thread
-    QFuture<QList<MusicItem>> future = QtConcurrent::run([this, query]() -> QList<MusicItem> {
-        if (!m_repository) {
-            return QList<MusicItem>();
-        }
-        
-        // This would need to be implemented in MusicRepository
-        // For now, return empty list
-        return QList<MusicItem>();
-    });
-    
-    m_loadingWatcher->setFuture(future);
+    const_cast<MusicListModel*>(this)->startNextJob();
 }
 
-void MusicListModel::updateTotalCount()
+void MusicListModel::startNextJob()
 {
-    if (!m_repository) {
-        m_totalCount = 0;
+    if (!m_repository || m_loadingWatcher->isRunning()) {
+        updateLoadingState();
         return;
     }
-    
-    // Build count query
-    QString countQuery = "SELECT COUNT(*) FROM musics";
-    QString whereClause = buildWhereClause();
-    if (!whereClause.isEmpty()) {
-        countQuery += " WHERE " + whereClause;
+
+    const QueryState state = currentState();
+    const int generation = m_generation;
+
+    // Next page from a queue that is not loaded for this generation yet
+    auto takePage = [this](QList<int>& queue) {
+        while (!queue.isEmpty()) {
+            const int page = queue.takeFirst();
+            const Page* loaded = m_pages.object(page);
+            if (page * m_batchSize < m_totalCount
+                && (!loaded || loaded->generation != m_generation)) {
+                return page;
+            }
+        }
+        return -1;
+    };
+
+    QFuture<JobResult> future;
+    int page = -1;
+    if (m_countPending) {
+        m_countPending = false;
+        m_runningUrgent = true;
+        future = QtConcurrent::run(&m_worker, [state, generation]() {
+            JobResult result = runCount(state);
+            result.generation = generation;
+            return result;
+        });
+    } else if ((page = takePage(m_urgentPages)) >= 0) {
+        m_runningUrgent = true;
+    } else if (m_anchorsPending) {
+        m_anchorsPending = false;
+        const std::shared_ptr<std::atomic<int>> live = m_liveGeneration;
+        future = QtConcurrent::run(&m_worker, [state, generation, live]() {
+            JobResult result = runAnchors(state, live.get(), generation);
+            result.generation = generation;
+            return result;
+        });
+    } else {
+        page = takePage(m_preloadPages);
     }
-    
-    // Execute count query (this should be done asynchronously in production)
-    // For now, we'll use a placeholder value
-    int oldCount = m_totalCount;
-    // m_totalCount = m_repository->getCount(countQuery);
-    m_totalCount = 1000; // Placeholder
-    
-    if (oldCount != m_totalCount) {
-        emit totalCountChanged(m_totalCount);
+
+    if (page >= 0) {
+        const int start = page * m_batchSize;
+        int keyRow = 0;
+        const SortKey* key = keyBefore(start, &keyRow);
+        const bool hasKey = key != nullptr;
+        const SortKey after = hasKey ? *key : SortKey();
+        const int offset = start - keyRow;
+        const int batch = m_batchSize;
+        m_runningPage = page;
+        future = QtConcurrent::run(&m_worker, [state, generation, page, batch, hasKey, after, offset]() {
+            JobResult result = runPage(workerConnection(state), state, batch,
+                                       hasKey ? &after : nullptr, offset);
+            result.generation = generation;
+            result.page = page;
+            result.batch = batch;
+            return result;
+        });
+    }
+
+    if (future.isValid()) {
+        m_loadingWatcher->setFuture(future);
     }
+    updateLoadingState();
 }
 
-QString MusicListModel::buildQuery() const
+void MusicListModel::invalidate(bool dropPages, bool recount)
 {
-    QString query = "SELECT " + s_sqlColumnNames.join(", ") + " FROM musics";
-    
-    QString whereClause = buildWhereClause();
-    if (!whereClause.isEmpty()) {
-        query += " WHERE " + whereClause;
-    }
-    
-    QString orderByClause = buildOrderByClause();
-    if (!orderByClause.isEmpty()) {
-        query += " ORDER BY " + orderByClause;
+    ++m_generation;
+    m_liveGeneration->store(m_generation);
+    m_keys.clear();
+    m_urgentPages.clear();
+    m_preloadPages.clear();
+    m_runningPage = -1;
+    m_anchorsPending = true;
+    m_countPending = m_countPending || recount;
+    m_lastJobFailed = false;
+
+    if (dropPages) {
+        beginResetModel();
+        m_pages.clear();
+        if (recount) {
+            m_totalCount = 0; // rows come back with the count
+        }
+        endResetModel();
+    } else if (m_totalCount > 0) {
+        // Stale rows stay on screen; repainting re-requests them
+        emit dataChanged(index(0, 0), index(m_totalCount - 1, ColumnCount - 1));
     }
-    
-    return query;
+
+    startNextJob();
 }
 
-QString MusicListModel::buildWhereClause() const
+void MusicListModel::scheduleRefresh()
 {
-    QStringList conditions;
-    
-    // Search filter
-    if (!m_searchText.isEmpty()) {
-        QStringList searchConditions;
-        QList<int> columnsToSearch = m_searchColumns.isEmpty() ? 
-            QList<int>{ColumnTitle, ColumnArtist, ColumnAlbum} : m_searchColumns;
-        
-        for (int column : columnsToSearch) {
-            QString columnName = getSqlColumnName(column);
-            if (!columnName.isEmpty()) {
-                searchConditions << QString("%1 LIKE '%%2%'").arg(columnName, m_searchText);
-            }
-        }
-        
-        if (!searchConditions.isEmpty()) {
-            conditions << "(" + searchConditions.join(" OR ") + ")";
-        }
+    m_refreshTimer->start();
+}
+
+void MusicListModel::updateLoadingState()
+{
+    // Preloads and the anchor scan run quietly in the background
+    const bool busy = m_countPending || !m_urgentPages.isEmpty()
+                      || (m_runningUrgent && m_loadingWatcher->isRunning());
+    const LoadingState state = busy ? Loading : (m_lastJobFailed ? Error : Idle);
+    if (state != m_loadingState) {
+        m_loadingState = state;
+        emit loadingStateChanged(m_loadingState);
     }
-    
-    // Genre filter
-    if (!m_genreFilter.isEmpty()) {
-        conditions << QString("genre1 = '%1'").arg(m_genreFilter);
+}
+
+MusicListModel::QueryState MusicListModel::currentState() const
+{
+    QueryState state;
+    if (m_repository) {
+        const QSqlDatabase& db = m_repository->database();
+        state.driver = db.driverName();
+        state.databaseName = db.databaseName();
     }
-    
-    return conditions.join(" AND ");
+    state.connectionName = QStringLiteral("xfb_musiclist_%1").arg(quintptr(this), 0, 16);
+    state.searchText = m_searchText;
+    state.searchColumns = m_searchColumns;
+    state.fullText = m_fullText;
+    state.genre1 = m_genre1Filter;
+    state.genre2 = m_genre2Filter;
+    state.sortColumn = m_sortColumn;
+    state.sortOrder = m_sortOrder;
+    return state;
 }
 
-QString MusicListModel::buildOrderByClause() const
+const MusicListModel::SortKey* MusicListModel::keyBefore(int row, int* keyRow) const
 {
-    QString columnName = getSqlColumnName(m_sortColumn);
-    if (columnName.isEmpty()) {
-        return QString();
+    auto it = m_keys.upperBound(row);
+    if (it == m_keys.constBegin()) {
+        *keyRow = 0;
+        return nullptr;
     }
-    
-    QString orderDirection = (m_sortOrder == Qt::AscendingOrder) ? "ASC" : "DESC";
-    return QString("%1 %2").arg(columnName, orderDirection);
+    --it;
+    *keyRow = it.key();
+    return &it.value();
 }
 
-QString MusicListModel::getSqlColumnName(int column) const
+QSqlDatabase MusicListModel::workerConnection(const QueryState& state)
 {
-    if (column >= 0 && column < s_sqlColumnNames.size()) {
-        return s_sqlColumnNames.at(column);
+    // Only ever used from m_worker's single thread, which opened it
+    if (QSqlDatabase::contains(state.connectionName)) {
+        {
+            QSqlDatabase db = QSqlDatabase::database(state.connectionName, false);
+            if (db.isOpen() && db.databaseName() == state.databaseName) {
+                return db;
+            }
+        }
+        // Another database, or it went down: start over
+        DatabaseAccess::closeConnection(state.connectionName);
     }
-    return QString();
+
+    QSqlDatabase db = DatabaseAccess::openConnection(state.connectionName, state.driver,
+                                                     state.databaseName);
+    if (!db.isOpen()) {
+        qWarning() << "MusicListModel: Worker connection failed:" << db.lastError().text();
+    }
+    return db;
 }
 
-void MusicListModel::cacheItem(int index, std::shared_ptr<MusicItem> item)
+MusicListModel::JobResult MusicListModel::runCount(const QueryState& state)
 {
-    if (item) {
-        m_itemCache.insert(index, new MusicItem(*item));
+    JobResult result;
+    result.kind = JobKind::Count;
+
+    QSqlDatabase db = workerConnection(state);
+    QVariantList binds;
+    const QString where = buildWhereClause(state, &binds);
+
+    QSqlQuery query(db);
+    query.prepare("SELECT COUNT(*) FROM musics" + (where.isEmpty() ? QString() : " WHERE " + where));
+    for (const QVariant& bind : binds) {
+        query.addBindValue(bind);
+    }
+    if (!QueryProfiler::exec(query) || !query.next()) {
+        result.error = query.lastError().text();
+        return result;
     }
+    result.count = query.value(0).toInt();
+    return result;
 }
 
-std::shared_ptr<MusicItem> MusicListModel::getCachedItem(int index) const
+MusicListModel::JobResult MusicListModel::runAnchors(const QueryState& state,
+                                                     const std::atomic<int>* generation,
+                                                     int jobGeneration)
 {
-    MusicItem* item = m_itemCache.object(index);
-    if (item) {
-        return std::make_shared<MusicItem>(*item);
+    JobResult result;
+    result.kind = JobKind::Anchors;
+
+    QSqlDatabase db = workerConnection(state);
+    const QString column = getSqlColumnName(state.sortColumn);
+
+    // SQLite numbers the rows and hands back only every kAnchorStride-th
+    // key: unfiltered, the walk stays on the column's index (a library
+    // migration) and only the anchors cross into Qt
+    QVariantList binds;
+    const QString where = buildWhereClause(state, &binds);
+    QSqlQuery query(db);
+    query.setForwardOnly(true);
+    query.prepare(QString("SELECT rowid, %1 FROM (SELECT rowid, %1, ROW_NUMBER() OVER (ORDER BY %3) AS position "
+                          "FROM musics%2) WHERE position % ? = 0 ORDER BY position")
+                      .arg(column, where.isEmpty() ? QString() : " WHERE " + where,
+                           sortExpression(state)));
+    for (const QVariant& bind : binds) {
+        query.addBindValue(bind);
     }
-    return nullptr;
+    query.addBindValue(kAnchorStride);
+    if (!QueryProfiler::exec(query)) {
+        result.error = query.lastError().text();
+        return result;
+    }
+
+    while (query.next()) {
+        result.keys.append({query.value(1), query.value(0).toLongLong()});
+        if (generation->load() != jobGeneration) {
+            return result; // stale, dropped by the GUI thread
+        }
+    }
+    return result;
 }
 
-bool MusicListModel::isItemCached(int index) const
+MusicListModel::JobResult MusicListModel::runPage(QSqlDatabase db, const QueryState& state,
+                                                  int limit, const SortKey* after, int offset)
 {
-    return m_itemCache.contains(index);
+    JobResult result;
+    result.kind = JobKind::Page;
+    if (!db.isOpen()) {
+        result.error = db.lastError().text();
+        return result;
+    }
+
+    const QString column = getSqlColumnName(state.sortColumn);
+    const bool ascending = state.sortOrder == Qt::AscendingOrder;
+    QVariantList filterBinds;
+    const QString filter = buildWhereClause(state, &filterBinds);
+
+    // The rows after the key, as runs read in order. SQLite sorts NULL
+    // first and NULL never compares, so NULL and non-NULL sort values are
+    // separate runs, each a seek on the (column, rowid) index.
+    struct Run {
+        QString condition;
+        QVariantList binds;
+    };
+    QList<Run> runs;
+    if (!after) {
+        runs.append({QString(), {}});
+    } else if (after->value.isNull()) {
+        runs.append({QString("%1 IS NULL AND rowid %2 ?").arg(column, ascending ? ">" : "<"),
+                     {after->rowid}});
+        if (ascending) {
+            runs.append({column + " IS NOT NULL", {}});
+        }
+    } else {
+        runs.append({QString("(%1, rowid) %2 (?, ?)").arg(column, ascending ? ">" : "<"),
+                     {after->value, after->rowid}});
+        if (!ascending) {
+            runs.append({column + " IS NULL", {}});
+        }
+    }
+
+    const QString order = " ORDER BY " + sortExpression(state);
+    QVariant lastValue;
+    qint64 lastRowid = 0;
+    for (const Run& run : runs) {
+        const int wanted = limit - int(result.items.size());
+        if (wanted <= 0) {
+            break;
+        }
+
+        QStringList conditions;
+        if (!filter.isEmpty()) {
+            conditions << filter;
+        }
+        if (!run.condition.isEmpty()) {
+            conditions << run.condition;
+        }
+        const QString where = conditions.isEmpty() ? QString() : " WHERE " + conditions.join(" AND ");
+        const QVariantList binds = filterBinds + run.binds;
+
+        QSqlQuery query(db);
+        query.setForwardOnly(true);
+        query.prepare("SELECT " + kSelectColumns + " FROM musics" + where + order + " LIMIT ? OFFSET ?");
+        for (const QVariant& bind : binds) {
+            query.addBindValue(bind);
+        }
+        query.addBindValue(wanted);
+        query.addBindValue(offset);
+        if (!QueryProfiler::exec(query)) {
+            result.error = query.lastError().text();
+            return result;
+        }
+
+        const int before = int(result.items.size());
+        while (query.next()) {
+            MusicItem item;
+            item.id = query.value(1 + ColumnId).toInt();
+            item.artist = query.value(1 + ColumnArtist).toString();
+            item.song = query.value(1 + ColumnTitle).toString();
+            item.genre1 = query.value(1 + ColumnGenre1).toString();
+            item.genre2 = query.value(1 + ColumnGenre2).toString();
+            item.country = query.value(1 + ColumnCountry).toString();
+            item.publishedDate = query.value(1 + ColumnPublished).toString();
+            item.path = query.value(1 + ColumnPath).toString();
+            item.time = query.value(1 + ColumnTime).toString();
+            item.playedTimes = query.value(1 + ColumnPlayedTimes).toInt();
+            item.lastPlayed = query.value(1 + ColumnLastPlayed).toString();
+            result.items.append(item);
+            lastRowid = query.value(0).toLongLong();
+            lastValue = query.value(1 + state.sortColumn);
+        }
+
+        if (int(result.items.size()) > before || offset == 0) {
+            offset = 0;
+            continue;
+        }
+
+        // The offset skipped this whole run: carry the rest into the next
+        QSqlQuery count(db);
+        count.prepare("SELECT COUNT(*) FROM musics" + where);
+        for (const QVariant& bind : binds) {
+            count.addBindValue(bind);
+        }
+        if (!QueryProfiler::exec(count) || !count.next()) {
+            result.error = count.lastError().text();
+            return result;
+        }
+        offset = std::max(0, offset - count.value(0).toInt());
+    }
+
+    if (!result.items.isEmpty()) {
+        result.keys.append({lastValue, lastRowid});
+    }
+    return result;
 }
 
-void MusicListModel::cleanupCache()
+QString MusicListModel::buildWhereClause(const QueryState& state, QVariantList* binds)
 {
-    // The QCache will automatically remove least recently used items
-    // when it exceeds the maximum cost. This method could implement
-    // additional cleanup logic if needed.
-    
-    qDebug() << "MusicListModel: Cache cleanup - current size:" << m_itemCache.size();
+    QStringList conditions;
+
+    // Search filter: one indexed MATCH when the columns are all in musics_fts
+    const QString match = state.fullText ? fullTextMatch(state) : QString();
+    if (!match.isEmpty()) {
+        conditions << "rowid IN (SELECT rowid FROM musics_fts WHERE musics_fts MATCH ?)";
+        binds->append(match);
+    } else if (!state.searchText.isEmpty()) {
+        QStringList searchConditions;
+        const QList<int> columnsToSearch = state.searchColumns.isEmpty() ?
+            QList<int>{ColumnArtist, ColumnTitle} : state.searchColumns;
+
+        for (int column : columnsToSearch) {
+            const QString columnName = getSqlColumnName(column);
+            if (!columnName.isEmpty()) {
+                searchConditions << columnName + " LIKE ?";
+                binds->append("%" + state.searchText + "%");
+            }
+        }
+
+        if (!searchConditions.isEmpty()) {
+            conditions << "(" + searchConditions.join(" OR ") + ")";
+        }
+    }
+
+    // Genre filters
+    if (!state.genre1.isEmpty()) {
+        conditions << "genre1 = ?";
+        binds->append(state.genre1);
+    }
+    if (!state.genre2.isEmpty()) {
+        conditions << "genre2 = ?";
+        binds->append(state.genre2);
+    }
+
+    return conditions.join(" AND ");
 }
 
-QString MusicListModel::formatDuration(qint64 durationMs) const
+QString MusicListModel::fullTextMatch(const QueryState& state)
 {
-    if (durationMs <= 0) {
-        return "0:00";
+    static const QSet<QString> indexed = {"artist", "song", "genre1", "genre2", "country", "path"};
+
+    QStringList columns;
+    for (int column : state.searchColumns) {
+        const QString columnName = getSqlColumnName(column);
+        if (!indexed.contains(columnName)) {
+            return QString(); // not in the index: LIKE it is
+        }
+        columns << columnName;
     }
-    
-    int totalSeconds = static_cast<int>(durationMs / 1000);
-    int minutes = totalSeconds / 60;
-    int seconds = totalSeconds % 60;
-    
-    return QString("%1:%2").arg(minutes).arg(seconds, 2, 10, QChar('0'));
+    return MusicRepository::searchMatchExpression(state.searchText, columns);
 }
 
-QString MusicListModel::formatDate(const QDateTime& dateTime) const
+QString MusicListModel::sortExpression(const QueryState& state)
 {
-    if (!dateTime.isValid()) {
-        return QString();
+    const QString direction = (state.sortOrder == Qt::AscendingOrder) ? "ASC" : "DESC";
+    return QString("%1 %2, rowid %2").arg(getSqlColumnName(state.sortColumn), direction);
+}
+
+QString MusicListModel::getSqlColumnName(int column)
+{
+    if (column >= 0 && column < s_sqlColumnNames.size()) {
+        return s_sqlColumnNames.at(column);
     }
-    
-    return dateTime.toString("yyyy-MM-dd hh:mm");
+    return QString();
 }
 
-bool MusicListModel::isRangeLoaded(int startIndex, int endIndex) const
+const MusicItem* MusicListModel::itemAt(int row) const
 {
-    // Simplified check - in practice this would be more sophisticated
-    for (int i = startIndex; i <= endIndex; ++i) {
-        if (!isItemCached(i)) {
-            return false;
-        }
+    if (row < 0 || row >= m_totalCount) {
+        return nullptr;
     }
-    return true;
+    const int page = row / m_batchSize;
+    const Page* loaded = m_pages.object(page);
+    const int offset = row - page * m_batchSize;
+    if (!loaded || offset >= loaded->items.size()) {
+        return nullptr;
+    }
+    return &loaded->items.at(offset);
 }
 
-void MusicListModel::markRangeLoaded(int startIndex, int endIndex)
+void MusicListModel::cleanupCache()
 {
-    // Mark the range as loaded in our tracking set
-    for (int i = startIndex; i <= endIndex; ++i) {
-        m_loadedRanges.insert(i);
+    // Give back what ensureLoaded() borrowed; QCache drops the least
+    // recently used pages down to the limit
+    const int maxCost = std::max(m_maxCacheSize, m_batchSize);
+    if (m_pages.maxCost() != maxCost) {
+        m_pages.setMaxCost(maxCost);
     }
+
+    qDebug() << "MusicListModel: Cache cleanup - loaded rows:" << m_pages.totalCost()
+             << "in" << m_pages.size() << "pages," << m_keys.size() << "keys";
 }
 
 QVariant MusicListModel::getDisplayData(const MusicItem& item, int column) const
@@ -732,24 +1081,26 @@ QVariant MusicListModel::getDisplayData(const MusicItem& item, int column) const
     switch (column) {
     case ColumnId:
         return item.id;
-    case ColumnTitle:
-        return item.song;
     case ColumnArtist:
         return item.artist;
-    case ColumnAlbum:
-        return QString(); // Album not available in current MusicItem structure
-    case ColumnGenre:
+    case ColumnTitle:
+        return item.song;
+    case ColumnGenre1:
         return item.genre1;
-    case ColumnDuration:
-        return item.time; // Use time field instead of duration
+    case ColumnGenre2:
+        return item.genre2;
+    case ColumnCountry:
+        return item.country;
+    case ColumnPublished:
+        return item.publishedDate;
     case ColumnPath:
         return item.path;
-    case ColumnDateAdded:
-        return QString(); // Date added not available in current MusicItem structure
-    case ColumnPlayCount:
+    case ColumnTime:
+        return item.time;
+    case ColumnPlayedTimes:
         return item.playedTimes;
     case ColumnLastPlayed:
-        return item.lastPlayed; // lastPlayed is already a QString
+        return item.lastPlayed;
     default:
         return QVariant();
     }
@@ -771,10 +1122,10 @@ QVariant MusicListModel::getAlignmentData(int column) const
 {
     switch (column) {
     case ColumnId:
-    case ColumnDuration:
-    case ColumnPlayCount:
+    case ColumnTime:
+    case ColumnPlayedTimes:
         return QVariant(Qt::AlignRight | Qt::AlignVCenter);
-    case ColumnDateAdded:
+    case ColumnPublished:
     case ColumnLastPlayed:
         return Qt::AlignCenter;
     default:
@@ -787,21 +1138,23 @@ QVariant MusicListModel::getHeaderTooltip(int section) const
     switch (section) {
     case ColumnId:
         return tr("Unique identifier for the music item");
-    case ColumnTitle:
-        return tr("Song title");
     case ColumnArtist:
         return tr("Artist name");
-    case ColumnAlbum:
-        return tr("Album name");
-    case ColumnGenre:
-        return tr("Music genre");
-    case ColumnDuration:
-        return tr("Song duration (mm:ss)");
+    case ColumnTitle:
+        return tr("Song title");
+    case ColumnGenre1:
+        return tr("Main genre");
+    case ColumnGenre2:
+        return tr("Secondary genre");
+    case ColumnCountry:
+        return tr("Country of origin");
+    case ColumnPublished:
+        return tr("Publication date");
     case ColumnPath:
         return tr("File path on disk");
-    case ColumnDateAdded:
-        return tr("Date when the song was added to the library");
-    case ColumnPlayCount:
+    case ColumnTime:
+        return tr("Song duration");
+    case ColumnPlayedTimes:
         return tr("Number of times the song has been played");
     case ColumnLastPlayed:
         return tr("Date and time when the song was last played");
@@ -6,8 +6,11 @@
 #include <QCache>
 #include <QFuture>
 #include <QFutureWatcher>
+#include <QMap>
 #include <QSortFilterProxyModel>
+#include <QThreadPool>
 #include <QDate>
+#include <atomic>
 #include <memory>
 
 // Forward declarations
@@ -16,20 +19,24 @@ struct MusicItem;
 class QSqlDatabase;
 
 /**
- * @brief High-performance model for large music collections with lazy loading
- * 
- * This model implements virtual scrolling and progressive loading to handle
- * large music collections efficiently. It loads data in batches as needed
- * and provides search and filtering capabilities.
- * 
- * Features:
- * - Lazy loading with configurable batch sizes
- * - Virtual scrolling for smooth performance
- * - Intelligent caching with memory management
- * - Asynchronous data loading
- * - Search and filtering support
- * - Sort support for all columns
- * 
+ * @brief Virtualized model over the musics table for very large libraries
+ *
+ * The model reports the full row count up front and loads rows in pages
+ * of batchSize() as the view asks for them. Every query runs on a private
+ * worker thread with its own database connection, so neither counting nor
+ * paging ever blocks the GUI thread; rows not loaded yet show a
+ * placeholder until their page arrives.
+ *
+ * Pages are read with keyset pagination: ordered by the sort column with
+ * the rowid as tie-breaker, each page starts after the last key of the one
+ * before it instead of at an OFFSET. A background scan records a key every
+ * kAnchorStride rows, so a jump anywhere in the library is a short seek
+ * from the nearest known key. Loaded pages live in an LRU cache bounded
+ * by cacheSize() rows.
+ *
+ * Columns follow the musics table, so code addressing the view by column
+ * (0 = id, 7 = path) works unchanged.
+ *
  * @since XFB 2.0
  */
 class MusicListModel : public QAbstractTableModel
@@ -38,18 +45,19 @@ class MusicListModel : public QAbstractTableModel
 
 public:
     /**
-     * @brief Column definitions for the music table
+     * @brief Column definitions, in musics table order
      */
     enum Column {
         ColumnId = 0,
-        ColumnTitle,
         ColumnArtist,
-        ColumnAlbum,
-        ColumnGenre,
-        ColumnDuration,
+        ColumnTitle,
+        ColumnGenre1,
+        ColumnGenre2,
+        ColumnCountry,
+        ColumnPublished,
         ColumnPath,
-        ColumnDateAdded,
-        ColumnPlayCount,
+        ColumnTime,
+        ColumnPlayedTimes,
         ColumnLastPlayed,
         ColumnCount // Must be last
     };
@@ -63,6 +71,9 @@ public:
         Error
     };
 
+    /** Rows between two keys recorded by the background anchor scan. */
+    static constexpr int kAnchorStride = 1000;
+
     explicit MusicListModel(MusicRepository* repository, QObject* parent = nullptr);
     ~MusicListModel();
 
@@ -70,9 +81,9 @@ public:
     int rowCount(const QModelIndex& parent = QModelIndex()) const override;
     int columnCount(const QModelIndex& parent = QModelIndex()) const override;
     QVariant data(const QModelIndex& index, int role = Qt::DisplayRole) const override;
+    bool setData(const QModelIndex& index, const QVariant& value, int role = Qt::EditRole) override;
+    Qt::ItemFlags flags(const QModelIndex& index) const override;
     QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const override;
-    bool canFetchMore(const QModelIndex& parent) const override;
-    void fetchMore(const QModelIndex& parent) override;
     void sort(int column, Qt::SortOrder order = Qt::AscendingOrder) override;
 
     /**
@@ -102,15 +113,20 @@ public:
     /**
      * @brief Set search filter
      * @param searchText Text to search for
-     * @param columns Columns to search in (empty = all columns)
+     * @param columns Columns to search in (empty = every indexed column
+     *        with the full-text index, artist and title without it)
+     *
+     * With the musics_fts index, each word matches as a word prefix,
+     * ignoring case and accents; otherwise searchText is a substring.
      */
     void setSearchFilter(const QString& searchText, const QList<int>& columns = QList<int>());
 
     /**
      * @brief Set genre filter
-     * @param genre Genre to filter by (empty = no filter)
+     * @param genre1 Genre 1 to filter by (empty = no filter)
+     * @param genre2 Genre 2 to filter by (empty = no filter)
      */
-    void setGenreFilter(const QString& genre);
+    void setGenreFilter(const QString& genre1, const QString& genre2 = QString());
 
     /**
      * @brief Clear all filters
@@ -118,7 +134,10 @@ public:
     void clearFilters();
 
     /**
-     * @brief Refresh the model data
+     * @brief Reload after the table changed
+     *
+     * Rows keep showing their current data until the reloaded pages
+     * arrive; the count is re-read in the background.
      */
     void refresh();
 
@@ -150,7 +169,8 @@ public:
     /**
      * @brief Get music item by ID
      * @param musicId Music ID
-     * @return Music item (may be null if not found/loaded)
+     * @return Music item from the loaded pages, else from the repository
+     *         (null if not found)
      */
     std::shared_ptr<MusicItem> getMusicItemById(int musicId) const;
 
@@ -161,6 +181,15 @@ public:
      */
     void preloadAround(const QModelIndex& index, int radius = 50);
 
+    /**
+     * @brief Load the pages holding indexes now, on the calling thread
+     *
+     * For bulk actions on a selection that may reach beyond the loaded
+     * pages. Blocks on the GUI connection; the cache grows to hold them
+     * until the next cleanup.
+     */
+    void ensureLoaded(const QModelIndexList& indexes);
+
     /**
      * @brief Get column name for the specified column
      * @param column Column index
@@ -232,7 +261,7 @@ signals:
 
 private slots:
     /**
-     * @brief Handle completion of asynchronous data loading
+     * @brief Handle completion of a background job
      */
     void onDataLoadingFinished();
 
@@ -248,119 +277,137 @@ private slots:
 
 private:
     /**
-     * @brief Load data batch starting at the specified offset
-     * @param offset Starting offset
-     * @param count Number of items to load
+     * @brief Position of a row in the current order: sort value + rowid
      */
-    void loadDataBatch(int offset, int count);
+    struct SortKey {
+        QVariant value;
+        qint64 rowid = 0;
+    };
 
     /**
-     * @brief Load data asynchronously
-     * @param offset Starting offset
-     * @param count Number of items to load
+     * @brief Snapshot of what a query selects, taken when a job is queued
      */
-    void loadDataAsync(int offset, int count);
+    struct QueryState {
+        QString driver;
+        QString databaseName;
+        QString connectionName; // worker thread connection
+        QString searchText;
+        QList<int> searchColumns;
+        bool fullText = false;  // search through musics_fts
+        QString genre1;
+        QString genre2;
+        int sortColumn = ColumnTitle;
+        Qt::SortOrder sortOrder = Qt::AscendingOrder;
+    };
 
+private:
     /**
-     * @brief Update total count from repository
+     * @brief A loaded page of rows
      */
-    void updateTotalCount();
+    struct Page {
+        QList<MusicItem> items;
+        int generation = 0; // older than m_generation = stale, shown until replaced
+    };
 
-    /**
-     * @brief Build SQL query with current filters and sorting
-     * @return SQL query string
-     */
-    QString buildQuery() const;
+    enum class JobKind { Count, Anchors, Page };
 
     /**
-     * @brief Build WHERE clause for current filters
-     * @return WHERE clause string
+     * @brief Result of one background job
      */
-    QString buildWhereClause() const;
+    struct JobResult {
+        JobKind kind = JobKind::Page;
+        int generation = 0;
+        int page = -1;
+        int batch = 0;             // page size the page was read with
+        int count = 0;
+        QList<MusicItem> items;
+        QList<SortKey> keys;       // Page: its last row; Anchors: every kAnchorStride rows
+        QString error;
+    };
 
     /**
-     * @brief Build ORDER BY clause for current sorting
-     * @return ORDER BY clause string
+     * @brief Queue a page for loading
+     * @param page Page index
+     * @param urgent On screen now: served before preloads
      */
-    QString buildOrderByClause() const;
+    void requestPage(int page, bool urgent) const;
 
     /**
-     * @brief Get column name for SQL queries
-     * @param column Column index
-     * @return SQL column name
+     * @brief Start the next queued job if the worker is free
      */
-    QString getSqlColumnName(int column) const;
+    void startNextJob();
 
     /**
-     * @brief Cache music item
-     * @param index Row index
-     * @param item Music item to cache
+     * @brief Drop what no longer matches and queue the jobs to rebuild it
+     * @param dropPages Order or filters changed: loaded rows are wrong,
+     *        not merely stale
+     * @param recount Rows may have come or gone
      */
-    void cacheItem(int index, std::shared_ptr<MusicItem> item);
+    void invalidate(bool dropPages, bool recount);
 
     /**
-     * @brief Get cached music item
-     * @param index Row index
-     * @return Cached music item (null if not cached)
+     * @brief Queue a refresh, coalescing bursts of repository signals
      */
-    std::shared_ptr<MusicItem> getCachedItem(int index) const;
+    void scheduleRefresh();
 
     /**
-     * @brief Check if item is cached
-     * @param index Row index
-     * @return true if item is cached
+     * @brief Update the loading state from the queues
      */
-    bool isItemCached(int index) const;
+    void updateLoadingState();
 
-    /**
-     * @brief Clean up old cache entries
-     */
-    void cleanupCache();
+    QueryState currentState() const;
 
     /**
-     * @brief Format duration for display
-     * @param durationMs Duration in milliseconds
-     * @return Formatted duration string
+     * @brief Nearest known key at or before row
+     * @param row Row the page starts at
+     * @param keyRow Receives the row the key precedes (0 = no key)
      */
-    QString formatDuration(qint64 durationMs) const;
+    const SortKey* keyBefore(int row, int* keyRow) const;
+
+    // Worker side: thread-safe, work only on their arguments
+    static QSqlDatabase workerConnection(const QueryState& state);
+    static JobResult runCount(const QueryState& state);
+    static JobResult runAnchors(const QueryState& state, const std::atomic<int>* generation,
+                                int jobGeneration);
+    static JobResult runPage(QSqlDatabase db, const QueryState& state, int limit,
+                             const SortKey* after, int offset);
+
+    static QString buildWhereClause(const QueryState& state, QVariantList* binds);
+    static QString fullTextMatch(const QueryState& state);
+    static QString sortExpression(const QueryState& state);
 
     /**
-     * @brief Format date for display
-     * @param dateTime Date/time to format
-     * @return Formatted date string
+     * @brief Get column name for SQL queries
+     * @param column Column index
+     * @return SQL column name
      */
-    QString formatDate(const QDateTime& dateTime) const;
+    static QString getSqlColumnName(int column);
 
     /**
-     * @brief Check if the specified range is loaded
-     * @param startIndex Start index
-     * @param endIndex End index
-     * @return true if range is fully loaded
+     * @brief Get the item at row, or null when its page is not loaded
      */
-    bool isRangeLoaded(int startIndex, int endIndex) const;
+    const MusicItem* itemAt(int row) const;
 
     /**
-     * @brief Mark range as loaded
-     * @param startIndex Start index
-     * @param endIndex End index
+     * @brief Clean up old cache entries
      */
-    void markRangeLoaded(int startIndex, int endIndex);
-    
+    void cleanupCache();
+
     /**
      * @brief Get display data for a specific item and column
      */
     QVariant getDisplayData(const MusicItem& item, int column) const;
-    
+
     /**
      * @brief Get tooltip data for a specific item and column
      */
     QVariant getTooltipData(const MusicItem& item, int column) const;
-    
+
     /**
      * @brief Get alignment data for a specific column
      */
     QVariant getAlignmentData(int column) const;
-    
+
     /**
      * @brief Get header tooltip for a specific section
      */
@@ -368,32 +415,46 @@ private:
 
 private:
     MusicRepository* m_repository;
-    
+
     // Data management
-    mutable QCache<int, MusicItem> m_itemCache;
-    QSet<int> m_loadedRanges; // Tracks which ranges have been loaded
+    mutable QCache<int, Page> m_pages;          // page index -> rows, cost = row count
+    QMap<int, SortKey> m_keys;                  // row r -> key of row r - 1
     int m_totalCount;
-    int m_loadedCount;
     int m_batchSize;
-    
-    // Loading state
+    int m_generation;
+    // Read by the anchor scan to stop early once its result is stale
+    std::shared_ptr<std::atomic<int>> m_liveGeneration;
+
+    // Job queue (GUI thread); one job runs at a time on m_worker
+    mutable QList<int> m_urgentPages;           // newest request first
+    mutable QList<int> m_preloadPages;
+    bool m_countPending;
+    bool m_anchorsPending;
+    int m_runningPage;
+    bool m_runningUrgent;                       // count or on-screen page
+    bool m_lastJobFailed;
     LoadingState m_loadingState;
-    QFutureWatcher<QList<MusicItem>>* m_loadingWatcher;
+    QThreadPool m_worker;
+    QFutureWatcher<JobResult>* m_loadingWatcher;
     QTimer* m_cacheCleanupTimer;
     QTimer* m_preloadTimer;
-    
+    QTimer* m_refreshTimer;
+    mutable int m_lastRequestedRow;
+
     // Filtering and sorting
     QString m_searchText;
     QList<int> m_searchColumns;
-    QString m_genreFilter;
+    bool m_fullText = false;
+    QString m_genre1Filter;
+    QString m_genre2Filter;
     int m_sortColumn;
     Qt::SortOrder m_sortOrder;
-    
+
     // Performance settings
     int m_maxCacheSize;
     int m_preloadRadius;
     int m_cacheCleanupInterval;
-    
+
     // Column headers
     static const QStringList s_columnHeaders;
     static const QStringList s_sqlColumnNames;
@@ -97,6 +97,7 @@ optionsDialog::optionsDialog(QWidget *parent) :
     ui->combo_levelMeterPos->setCurrentIndex(
         settings.value("LevelMeterPlacement", "volume").toString() == "side" ? 1 : 0);
     ui->checkBox_retune432->setChecked(FxSettings::loadRetune432());
+    ui->checkBox_normalizeLoudness->setChecked(FxSettings::loadNormalize());
 
     // Application font size. 0/unset means "use the current default"; fall back
     // to the running app's point size, then to 10 pt.
@@ -267,6 +268,8 @@ void optionsDialog::saveSettings2Db()
     settings.setValue("LevelMeterPlacement",
                       ui->combo_levelMeterPos->currentIndex() == 1 ? "side" : "volume");
     FxSettings::saveRetune432(ui->checkBox_retune432->isChecked());
+    FxSettings::saveNormalize(ui->checkBox_normalizeLoudness->isChecked(),
+                              FxSettings::loadNormalizeTargetLufs());
 
     // Application font size — persist and apply immediately (a restart ensures
     // every already-open view picks it up fully).
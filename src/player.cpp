@@ -16,12 +16,27 @@ Enjoy! . Frédéric Bogaerts 2015 @ Netpack - Online Solutions!.
 #include "externaldownloader.h"
 #include "aboutus.h"
 #include "audio/FxEngine.h"
+#include "audio/TrackAnalysisStore.h"
 #include "audio/WaveformStore.h"
 #include "ArtworkStore.h"
 #include "PlaylistWaveView.h"
 #include "LevelMeter.h"
 #include "ThemeManager.h"
 #include "dialogs/AudioFxDialog.h"
+#include "models/MusicListModel.h"
+#include "repositories/LibraryMigrations.h"
+#include "repositories/MusicRepository.h"
+#include "services/LibraryRescanner.h"
+#include "services/TranscodeQueue.h"
+#include "services/TrackTrimmer.h"
+#include "services/DatabaseAccess.h"
+#include "services/SchedulerEngine.h"
+#include "services/RotationEngine.h"
+#include "services/PlayLog.h"
+#include "services/StreamSource.h"
+#include "services/ProgramRecorder.h"
+#include "services/DatabaseOptimizer.h"
+#include "services/DatabaseService.h"
 #include "secretstore.h"
 #include "services/NgrokTunnelService.h"
 #include "services/UpdateCheckService.h"
@@ -44,7 +59,6 @@ Enjoy! . Frédéric Bogaerts 2015 @ Netpack - Online Solutions!.
 #include <QSqlTableModel>
 #include <QFileInfo>
 #include <QMediaDevices>
-#include <QAudioInput>
 #include <QAudioOutput>
 #include <QNetworkAccessManager>
 #include <QNetworkInformation>
@@ -62,6 +76,7 @@ Enjoy! . Frédéric Bogaerts 2015 @ Netpack - Online Solutions!.
 #include <QCloseEvent>
 #include <QDesktopServices>
 
+#include <algorithm>
 #include <cstdlib> // _exit()
 #ifdef Q_OS_MAC
 #include <unistd.h>
@@ -98,6 +113,9 @@ Enjoy! . Frédéric Bogaerts 2015 @ Netpack - Online Solutions!.
 #include <QDockWidget>
 #include <QMenu>
 #include <QSignalBlocker>
+#include <QDateEdit>
+#include <QDialogButtonBox>
+#include <QFormLayout>
 
 #ifdef XFB_HAS_WEBENGINE
 #include <QtWebEngineQuick>
@@ -559,10 +577,12 @@ player::player(QWidget *parent) :
         playlistVbox->insertWidget(1, m_nowPlayingWave);
         connect(m_nowPlayingWave, &NowPlayingWaveStrip::envelopeEdited,
                 this, [this](const QVector<QPointF> &points) {
-            // Live edit of the on-air track's line: onPositionChanged
-            // applies it on the next tick
+            // Live edit of the on-air track's line: the engine takes it
+            // at once, plain playback on the next position tick
             m_activeEnvelope = points;
             m_activeEnvelopePath = m_nowPlayingWave->track();
+            if (Xplayer)
+                Xplayer->setVolumeEnvelope(QUrl::fromLocalFile(m_activeEnvelopePath), points);
         });
 
         connect(m_waveViewToggle, &QToolButton::toggled,
@@ -581,6 +601,18 @@ player::player(QWidget *parent) :
         });
         connect(m_artStore, &ArtworkStore::artworkReady,
                 this, &player::onArtworkReady);
+
+        // Loudness / cue analysis: every playlist track is measured once in
+        // the background (cached on disk), so the FX engine can normalise it
+        // and cue past its leading silence without scanning on air.
+        m_analysisStore = new TrackAnalysisStore(this);
+        connect(ui->playlist->model(), &QAbstractItemModel::rowsInserted, this,
+                [this](const QModelIndex &, int first, int last) {
+            for (int row = first; row <= last; ++row) {
+                if (const QListWidgetItem *item = ui->playlist->item(row))
+                    m_analysisStore->fetch(item->text());
+            }
+        });
     }
     
     // Verify UI was properly initialized
@@ -754,6 +786,41 @@ player::player(QWidget *parent) :
         lp1_Xplayer->setPreferEngineAlways(true);
         lp2_Xplayer->setPreferEngineAlways(true);
 
+        // One shared output for the on-air decks: main, overlap tail and
+        // both LPs are summed sample-aligned into a single device stream
+        // instead of four sinks contending for it. Created after the
+        // players so it is also destroyed after them.
+        if (FxPlayer::fxAvailable() && FxSettings::loadSharedOutput()) {
+            m_mixer = new FxMixer(this);
+            m_mixer->setLatency(FxSettings::loadOutputLatencyMs() / 2);
+            for (FxPlayer *deck : {Xplayer, lp1_Xplayer, lp2_Xplayer, m_tailPlayer})
+                deck->setMixer(m_mixer);
+        }
+
+        // In-process stream source instead of butt capturing the sound
+        // card: fed from the shared mix when there is one (crossfades and
+        // LPs included), else from the main deck. Created after the
+        // players and the mixer so it outlives them.
+        if (FxPlayer::fxAvailable() && !StreamSource::loadMounts().isEmpty()) {
+            const QString ffmpeg = FxEngine::ffmpegExecutable();
+            m_streamSource = new StreamSource(
+                [ffmpeg](const FxEncoder::Settings &settings, QString *error) {
+                    return FxEncoder::open(settings, ffmpeg, error);
+                },
+                this);
+            if (m_mixer)
+                m_mixer->setStreamTap(m_streamSource->tap());
+            else
+                Xplayer->setStreamTap(m_streamSource->tap());
+            connect(m_streamSource, &StreamSource::mountStateChanged, this,
+                    [this](const QString &name, StreamSource::MountState state, const QString &detail) {
+                        m_streamMountsUp[name] = (state == StreamSource::Streaming);
+                        if (state == StreamSource::Retrying)
+                            m_streamLastError = name + ": " + detail;
+                        updateStreamSourceStatus();
+                    });
+        }
+
         // Streaming client: FxPlayer routes http(s) URLs through the
         // ffmpeg-CLI engine (plain QMediaPlayer cannot play live streams).
         RadioPlayerOutput = new QAudioOutput(this);
@@ -809,22 +876,36 @@ player::player(QWidget *parent) :
     ui->led_rec->hide();
     ui->txt_loading->hide();
 
-    // Initialize Qt6 media recording components with error handling
-    qDebug() << "Initializing media recording components";
-    try {
-        captureSession = new QMediaCaptureSession(this);
-        audioRecorder = new QMediaRecorder(this);
-        audioInput = new QAudioInput(this);
-
-        captureSession->setRecorder(audioRecorder);
-        captureSession->setAudioInput(audioInput);
-        qDebug() << "Media recording components initialized successfully";
-    } catch (const std::exception& e) {
-        qCritical() << "Exception initializing media recording:" << e.what();
-        // Don't throw here, recording is not critical for basic functionality
-        captureSession = nullptr;
-        audioRecorder = nullptr;
-        audioInput = nullptr;
+    // Program recorder: captures on its own thread and writes fsync'd
+    // segments as it goes, so a crash costs one segment at most
+    {
+        const QString ffmpeg = FxEngine::ffmpegExecutable();
+        m_programRecorder = new ProgramRecorder(
+            [ffmpeg](const FxEncoder::Settings &settings, QString *error) {
+                return FxEncoder::open(settings, ffmpeg, error);
+            },
+            this);
+        connect(m_programRecorder, &ProgramRecorder::segmentFinished, this,
+                [](const QString &path, int index) {
+            qDebug() << "Recording segment" << index << "ready:" << path;
+        });
+        connect(m_programRecorder, &ProgramRecorder::finished, this, [this](const QString &path) {
+            saveFile = path;
+            aExtencaoDesteCoiso = QFileInfo(path).suffix();
+            qDebug() << "Recording saved to" << path;
+        });
+        connect(m_programRecorder, &ProgramRecorder::recovered, this, [this](const QString &path) {
+            auto *box = new QMessageBox(QMessageBox::Information, tr("Recording recovered"),
+                                        tr("A recording that was interrupted was saved to:\n%1").arg(path),
+                                        QMessageBox::Ok, this);
+            box->setAttribute(Qt::WA_DeleteOnClose);
+            box->open();
+        });
+        connect(m_programRecorder, &ProgramRecorder::errorOccurred, this, [this](const QString &errorString) {
+            qDebug() << "Recording error: " << errorString;
+            ui->led_rec->setStyleSheet("background-color:#FF0010;border-radius:8px;");
+            QMessageBox::warning(this, tr("Recording Error"), errorString);
+        });
     }
 
     // List available audio input devices
@@ -833,24 +914,6 @@ player::player(QWidget *parent) :
         qDebug() << "Audio Hardware on this system: " << device.description();
     }
 
-    // Get supported audio codecs using mediaFormat() in Qt6
-    const QList<QMediaFormat::AudioCodec> supportedCodecs = audioRecorder->mediaFormat().supportedAudioCodecs(QMediaFormat::Encode);
-    for (const QMediaFormat::AudioCodec &codec : supportedCodecs) {
-        qDebug() << "Audio Codecs on this system: " << QMediaFormat::audioCodecName(codec);
-    }
-
-    // Get supported containers (file formats) in Qt6
-    const QList<QMediaFormat::FileFormat> supportedContainers = audioRecorder->mediaFormat().supportedFileFormats(QMediaFormat::Encode);
-    for (const QMediaFormat::FileFormat &format : supportedContainers) {
-        qDebug() << "Audio Containers on this system: " << QMediaFormat::fileFormatName(format);
-    }
-
-    // Get supported sample rates - in Qt6 we need to check available quality settings
-    QMediaRecorder::EncodingMode mode = audioRecorder->encodingMode();
-    QMediaRecorder::Quality quality = audioRecorder->quality();
-    qDebug() << "Current encoding mode: " << mode << ", quality: " << quality;
-    qDebug() << "Audio Sample Rates are handled through quality settings in Qt6";
-
     // Connect media player signals with error handling
     qDebug() << "Connecting media player signals";
     try {
@@ -997,9 +1060,18 @@ player::player(QWidget *parent) :
 
     if(Role=="Server"){
 
-        QTimer *schedulerTimer = new QTimer(this);
-        connect(schedulerTimer, &QTimer::timeout, this, &player::run_scheduler);
-        schedulerTimer->start(60000);
+        // Scheduled pubs and programs fire from an in-memory queue at
+        // their time instead of a once-a-minute scan of the table
+        if (checkDbOpen()) {
+            m_scheduler = new SchedulerEngine(QSqlDatabase::database("xfb_connection"), this);
+            QSettings settings(QStandardPaths::writableLocation(QStandardPaths::AppConfigLocation)
+                                   + "/xfb.conf", QSettings::IniFormat);
+            m_scheduler->setPreRoll(settings.value("SchedulerPreRollSeconds", 0).toInt() * 1000);
+            connect(m_scheduler, &SchedulerEngine::ruleDue, this, [this](const SchedulerEngine::Event &event) {
+                run_scheduler(event.rule.id, event.rule.isProgram, event.rule.type == SchedulerEngine::Once);
+            });
+            m_scheduler->start();
+        }
 
         run_server_scheduler(); //run at startup
 
@@ -1026,15 +1098,199 @@ player::player(QWidget *parent) :
                 qCritical() << "Database connection invalid for music table";
             } else {
                 dbAvailable = true;
-                QSqlTableModel *model = new QSqlTableModel(this, db);
-                model->setTable("musics");
-                if (!model->select()) {
-                    qWarning() << "Failed to select from musics table:" << model->lastError().text();
-                } else {
-                    qDebug() << "Music table model created successfully";
+                m_libraryDb = db;
+                m_databaseAccess = new DatabaseAccess(m_libraryDb.databaseName(), this);
+                if (m_scheduler)
+                    m_scheduler->setWriter(m_databaseAccess);
+                m_playLog = new PlayLog(m_databaseAccess, this);
+
+                // Library statements are timed through QueryProfiler; every
+                // report lists the indexes the slow ones would have used,
+                // which the operator applies from the Database menu
+                m_databaseOptimizer = new DatabaseOptimizer(m_libraryDb, this);
+
+                // The scheduler's rules are keyed by rule_id, which a VACUUM
+                // keeps; after an optimize the engine still reads the table
+                // again rather than trust what it had
+                connect(m_databaseOptimizer, &DatabaseOptimizer::optimizationCompleted, this,
+                        [this](const QString &operation, bool success) {
+                    if (success && operation == QLatin1String("vacuumDatabase") && m_scheduler)
+                        m_scheduler->reload();
+                });
+                ServiceContainer *container = ServiceContainer::instance();
+                if (container && container->isRegistered<DatabaseService>()) {
+                    connect(container->resolve<DatabaseService>(), &DatabaseService::optimizationCompleted, this,
+                            [this](bool success) {
+                        if (success && m_scheduler)
+                            m_scheduler->reload();
+                    });
+                }
+                if (m_databaseOptimizer->initialize()) {
+                    m_databaseOptimizer->startQueryMonitoring(100);
+                    connect(m_databaseOptimizer, &DatabaseOptimizer::performanceReport, this, [this](const QString &report) {
+                        qDebug().noquote() << "Library query report:" << report;
+                        const int recommended = recommendedLibraryIndexes().size();
+                        ui->actionApply_the_recommended_library_indexes->setEnabled(recommended > 0);
+                        if (recommended > 0)
+                            qInfo() << recommended << "library indexes recommended for slow queries";
+                    });
+                    m_databaseOptimizer->setReportInterval(10 * 60 * 1000, 10);
                 }
 
-                ui->musicView->setModel(model);
+                // Auto mode draws from rotations shuffled in the background;
+                // a load tops the playlist up when auto mode is waiting on it
+                m_rotation = new RotationEngine(m_libraryDb, this);
+                connect(m_rotation, &RotationEngine::ready, this, [this]() {
+                    if (autoMode == 1)
+                        autoModeGetMoreSongs();
+                });
+                connect(m_rotation, &RotationEngine::rotationError, this, [](const QString &error) {
+                    qWarning() << "Auto mode rotation:" << error;
+                });
+                m_rotation->reload();
+                m_musicRepository = new MusicRepository(m_libraryDb, this);
+                m_musicModel = new MusicListModel(m_musicRepository, this);
+                connect(m_musicModel, &MusicListModel::loadingError, this, [](const QString &error) {
+                    qWarning() << "Failed to load from musics table:" << error;
+                });
+
+                ui->musicView->setModel(m_musicModel);
+
+                // Search as you type: the full-text index answers in a few
+                // milliseconds, so only coalesce a burst of keystrokes. One
+                // or two letters match much of a library; those wait for
+                // Return like before.
+                m_searchTypingTimer = new QTimer(this);
+                m_searchTypingTimer->setSingleShot(true);
+                m_searchTypingTimer->setInterval(60);
+                connect(m_searchTypingTimer, &QTimer::timeout, this, &player::applyLibrarySearch);
+                connect(ui->txt_search, &QLineEdit::textEdited, this, [this](const QString &text) {
+                    if (text.isEmpty() || text.trimmed().size() >= 3)
+                        m_searchTypingTimer->start();
+                    else
+                        m_searchTypingTimer->stop();
+                });
+
+                // Library rescans run in the background; a watched folder
+                // change refreshes the view without any dialog
+                m_libraryRescanner = new LibraryRescanner(m_libraryDb, this);
+                m_libraryRescanner->setDurationProbe([](const QString &filePath) {
+                    qint64 durationMs = 0;
+                    bool is432 = false;
+                    FxEngine::probeFile(filePath, &durationMs, &is432);
+                    return durationMs;
+                });
+                connect(m_libraryRescanner, &LibraryRescanner::progress, this, [this](int scanned, int changes) {
+                    if (m_rescanInteractive)
+                        ui->statusBar->showMessage(tr("Rescanning the library: %1 files, %2 changes").arg(scanned).arg(changes));
+                });
+                connect(m_libraryRescanner, &LibraryRescanner::finished, this,
+                        [this](const LibraryRescanner::Statistics &stats) {
+                    if (stats.changes() > 0 && m_musicModel)
+                        m_musicModel->refresh();
+                    if (!m_rescanInteractive)
+                        return;
+                    m_rescanInteractive = false;
+                    ui->statusBar->clearMessage();
+                    QMessageBox::information(this, tr("Rescan the library"),
+                                             tr("%1 files checked in %2 s.\n\n"
+                                                "Added: %3\nUpdated: %4\nMoved: %5\nRemoved: %6\nFailed: %7")
+                                                 .arg(stats.scanned)
+                                                 .arg(QString::number(stats.elapsedMs / 1000.0, 'f', 1))
+                                                 .arg(stats.added).arg(stats.updated).arg(stats.moved)
+                                                 .arg(stats.removed).arg(stats.failed));
+                });
+                connect(m_libraryRescanner, &LibraryRescanner::rescanError, this, [this](const QString &error) {
+                    qWarning() << "Library rescan:" << error;
+                    if (m_rescanInteractive) {
+                        m_rescanInteractive = false;
+                        QMessageBox::warning(this, tr("Rescan the library"), error);
+                    }
+                });
+                // Library conversions run on a worker pool; the queue lives
+                // in the database, so one cut short resumes on the next start
+                m_transcodeQueue = new TranscodeQueue(m_libraryDb,
+                                                      TranscodeQueue::ffmpegTranscoder(FxEngine::ffmpegExecutable()),
+                                                      this);
+                connect(m_transcodeQueue, &TranscodeQueue::progress, this, [this](int done, int total) {
+                    ui->statusBar->showMessage(tr("Converting the library: %1 of %2 files").arg(done).arg(total));
+                });
+                connect(m_transcodeQueue, &TranscodeQueue::finished, this,
+                        [this](const TranscodeQueue::Statistics &stats) {
+                    ui->statusBar->clearMessage();
+                    if (stats.converted > 0 && m_musicModel)
+                        m_musicModel->refresh();
+                    const QString title = stats.cancelled ? tr("Conversion stopped") : tr("Conversion Summary");
+                    QString text = tr("Converted: %1\nFailed: %2\nAlready in that format: %3\nTime: %4 s")
+                                       .arg(stats.converted).arg(stats.failed).arg(stats.skipped)
+                                       .arg(QString::number(stats.elapsedMs / 1000.0, 'f', 1));
+                    if (stats.cancelled)
+                        text += tr("\n\nThe remaining files stay queued; the conversion resumes on the next start.");
+                    QMessageBox::information(this, title, text);
+                });
+                connect(m_transcodeQueue, &TranscodeQueue::transcodeError, this, [this](const QString &error) {
+                    qWarning() << "Library conversion:" << error;
+                    QMessageBox::warning(this, tr("Conversion Error"), error);
+                });
+                if (TranscodeQueue::unfinishedJobs(m_libraryDb) > 0)
+                    QTimer::singleShot(0, this, [this]() { startLibraryTranscode(QString()); });
+                // Silence trims are stored, not cut: the engines skip them
+                // on their own threads, each through its own connection
+                m_trackTrimmer = new TrackTrimmer(m_libraryDb,
+                                                  TrackTrimmer::ffmpegScanner(FxEngine::ffmpegExecutable()),
+                                                  TrackTrimmer::ffmpegCutter(FxEngine::ffmpegExecutable()),
+                                                  this);
+                connect(m_trackTrimmer, &TrackTrimmer::progress, this, [this](int done, int total) {
+                    ui->statusBar->showMessage(m_trimRewriting
+                                                   ? tr("Trimming the library: %1 of %2 files").arg(done).arg(total)
+                                                   : tr("Finding silence in the library: %1 of %2 files").arg(done).arg(total));
+                });
+                connect(m_trackTrimmer, &TrackTrimmer::finished, this,
+                        [this](const TrackTrimmer::Statistics &stats) {
+                    ui->statusBar->clearMessage();
+                    const QString title = stats.cancelled ? tr("Auto-Trim stopped") : tr("Auto-Trim Summary");
+                    QString text = m_trimRewriting
+                                       ? tr("Trimmed: %1\nNothing to trim: %2\nFailed: %3\nTime: %4 s")
+                                             .arg(stats.rewritten).arg(stats.analyzed + stats.unchanged)
+                                             .arg(stats.failed)
+                                             .arg(QString::number(stats.elapsedMs / 1000.0, 'f', 1))
+                                       : tr("Scanned: %1\nAlready scanned: %2\nFailed: %3\n"
+                                            "Silence found: %4 s\nTime: %5 s")
+                                             .arg(stats.analyzed).arg(stats.unchanged).arg(stats.failed)
+                                             .arg(stats.silenceMs / 1000)
+                                             .arg(QString::number(stats.elapsedMs / 1000.0, 'f', 1));
+                    if (stats.cancelled)
+                        text += tr("\n\nChoose Auto-Trim again to carry on where it stopped.");
+                    if (m_trimRewriting || stats.cancelled) {
+                        QMessageBox::information(this, title, text);
+                        return;
+                    }
+                    text += tr("\n\nPlayback already skips the silence found. Also cut it out of the "
+                               "files?\n\nOriginal files will be overwritten! Files are cut without "
+                               "re-encoding where the format allows it.");
+                    if (QMessageBox::question(this, title, text, QMessageBox::Yes | QMessageBox::No,
+                                              QMessageBox::No) != QMessageBox::Yes)
+                        return;
+                    TrackTrimmer::Options options;
+                    options.mode = TrackTrimmer::Mode::Rewrite;
+                    m_trimRewriting = true;
+                    if (m_trackTrimmer->start(options))
+                        ui->statusBar->showMessage(tr("Trimming the library..."));
+                });
+                connect(m_trackTrimmer, &TrackTrimmer::trimError, this, [this](const QString &error) {
+                    qWarning() << "Library trim:" << error;
+                    QMessageBox::warning(this, tr("Auto-Trim"), error);
+                });
+                DatabaseAccess *access = m_databaseAccess;
+                FxPlayer::setTrimLookup([access](const QString &path, qint64 *startMs, qint64 *endMs) {
+                    return TrackTrimmer::storedCut(access->connection(), path, startMs, endMs);
+                });
+                {
+                    QSettings settings(QStandardPaths::writableLocation(QStandardPaths::AppConfigLocation)
+                                           + "/xfb.conf", QSettings::IniFormat);
+                    if (settings.value("WatchMusicFolders", false).toBool())
+                        ui->actionWatch_the_music_folders->setChecked(true); // starts watching
+                }
                 ui->musicView->setSortingEnabled(true);
                 ui->musicView->hideColumn(0);
                 ui->musicView->setSizePolicy(QSizePolicy::Expanding,QSizePolicy::Expanding);
@@ -1580,6 +1836,10 @@ checkDbOpen();
                                          tr("Convert all musics in the database to 432 Hz tuning"), this);
        ui->menuDatabase->addAction(conv432All);
        connect(conv432All, &QAction::triggered, this, &player::convertAllMusicsTo432);
+
+       QAction *exportPlays = new QAction(tr("Export the play history..."), this);
+       ui->menuDatabase->addAction(exportPlays);
+       connect(exportPlays, &QAction::triggered, this, &player::exportPlayLog);
    }
 
    // DJ decks: scratchable platters + performance FX
@@ -1618,6 +1878,8 @@ checkDbOpen();
        connect(lp1_Xplayer, &FxPlayer::playbackStateChanged, this,
                [this](QMediaPlayer::PlaybackState s) {
            if (s == QMediaPlayer::StoppedState) {
+               if (m_playLog)
+                   m_playLog->stopped(PlayLog::deck(1));
                if (m_lpPlatterAnim[0])
                    m_lpPlatterAnim[0]->stop();
                ui->lp_1_bt_play->setDisabled(false);
@@ -1630,6 +1892,8 @@ checkDbOpen();
        connect(lp2_Xplayer, &FxPlayer::playbackStateChanged, this,
                [this](QMediaPlayer::PlaybackState s) {
            if (s == QMediaPlayer::StoppedState) {
+               if (m_playLog)
+                   m_playLog->stopped(PlayLog::deck(2));
                if (m_lpPlatterAnim[1])
                    m_lpPlatterAnim[1]->stop();
                ui->lp_1_bt_play_2->setDisabled(false);
@@ -1806,9 +2070,9 @@ void player::closeEvent(QCloseEvent *event)
         radio1.waitForFinished(2000);
     }
     
-    if (audioRecorder && audioRecorder->recorderState() == QMediaRecorder::RecordingState) {
-        audioRecorder->stop();
-    }
+    // The segments on disk are joined by the next recording
+    if (m_programRecorder)
+        m_programRecorder->shutdown();
     
     if (ServiceContainer::instance()) {
         ServiceContainer::instance()->shutdownServices();
@@ -1872,26 +2136,12 @@ player::~player()
         }
     }
     
-    // Clean up audio recording safely
-    if (audioRecorder) {
-        if (audioRecorder->recorderState() == QMediaRecorder::RecordingState) {
-            audioRecorder->stop();
-        }
-        audioRecorder->deleteLater();
-        audioRecorder = nullptr;
-    }
-    
-    // Clean up capture session safely
-    if (captureSession) {
-        captureSession->deleteLater();
-        captureSession = nullptr;
-    }
-    
-    // Clean up audio input safely
-    if (audioInput) {
-        audioInput->deleteLater();
-        audioInput = nullptr;
-    }
+    // Close the recording's current segment
+    if (m_programRecorder)
+        m_programRecorder->shutdown();
+
+    // Players still setting sources must not reach m_databaseAccess once it is gone
+    FxPlayer::setTrimLookup(FxPlayer::TrimLookup());
     
     // Don't manually delete audio outputs - they are managed by Qt's parent-child system
     // The QMediaPlayer objects and their audio outputs will be cleaned up automatically
@@ -2117,6 +2367,7 @@ void player::updateConfig() {
     // Read enum values if you saved them that way from optionsDialog
     recCodec = settings.value("RecCodec", QVariant::fromValue(QMediaFormat::AudioCodec::Unspecified)).value<QMediaFormat::AudioCodec>();
     recContainer = settings.value("RecContainer", QVariant::fromValue(QMediaFormat::FileFormat())).value<QMediaFormat::FileFormat>();
+    recSegmentMinutes = std::clamp(settings.value("RecSegmentMinutes", 5).toInt(), 1, 60);
 
     // Database path
     txt_selected_db = settings.value("Database").toString();
@@ -2478,6 +2729,11 @@ bool player::checkDbOpen() {
     }
 
     qInfo() << "Database initialization successful. Connection '" << connectionName << "' is open.";
+
+    // WAL, so the scheduler and playback keep reading while an import or
+    // rescan writes; the journal mode sticks to the file for every other
+    // connection, the remaining settings are per connection
+    DatabaseAccess::configure(adb);
     
     // Create torrents table if it doesn't exist
     QSqlQuery createTorrentsTable(adb);
@@ -2497,6 +2753,11 @@ bool player::checkDbOpen() {
     } else {
         qDebug() << "Torrents table created or already exists";
     }
+
+    // Library schema additions since the bundled skeleton (full-text
+    // search index, ...). The index is applied on its own; searching
+    // falls back to LIKE without it.
+    LibraryMigrations::apply(adb);
     
     return true;
 }
@@ -2627,6 +2888,9 @@ void player::musicViewContextMenu(const QPoint& pos) {
     QPoint globalPos = ui->musicView->mapToGlobal(pos);
 
     QModelIndexList selectedIndexes = ui->musicView->selectionModel()->selectedRows(1); // column 1 (artist) — column 0 is hidden
+    // The selection may reach rows whose pages are not loaded (or were
+    // evicted); load them so every path and id below is real
+    if (m_musicModel) m_musicModel->ensureLoaded(selectedIndexes);
     if (selectedIndexes.isEmpty()) return;
 
     bool multiSelect = selectedIndexes.size() > 1;
@@ -3493,6 +3757,8 @@ void player::playNextSong(){
                     if(ui->playlist->count() <= currentPlaylistCount) {
                         qDebug()<<"No new items added to playlist, stopping playback";
                         Xplayer->stop();
+                        if (m_playLog)
+                            m_playLog->stopped(PlayLog::mainDeck());
                         ui->btPlay->setStyleSheet("");
                         ui->btPlay->setText(tr("Play"));
                         PlayMode = "stopped";
@@ -3504,6 +3770,8 @@ void player::playNextSong(){
                     // cleanly and return the Play button to its stopped state.
                     qDebug()<<"Playlist empty and autoMode off — stopping playback";
                     Xplayer->stop();
+                    if (m_playLog)
+                        m_playLog->stopped(PlayLog::mainDeck());
                     ui->btPlay->setStyleSheet("");
                     ui->btPlay->setText(tr("Play"));
                     PlayMode = "stopped";
@@ -3535,6 +3803,15 @@ void player::playNextSong(){
                 m_manualAdvancing = true;
                 onAbout2Finish = 0;  // Reset so playlistAboutToFinish can fire for the new track
 
+                // Capture the track's volume line before its item is deleted.
+                // The FX engine gets it ahead of the source so the line holds
+                // from the very first sample; under plain playback
+                // onPositionChanged applies it through the output volume.
+                m_activeEnvelope = PlaylistWaveView::parseEnvelope(
+                    firstItem->data(PlaylistWaveView::VolumeEnvelopeRole).toString());
+                m_activeEnvelopePath = itemDaPlaylist;
+                Xplayer->setVolumeEnvelope(nextUrl, m_activeEnvelope);
+
                 // Clear the previous source first to release any stuck
                 // AVFoundation session — but not when this track was
                 // preloaded: the clear would tear down the primed pipeline
@@ -3547,22 +3824,24 @@ void player::playNextSong(){
 
                 lastPlayedSong = itemDaPlaylist;
 
-                // Capture the track's volume line before its item is deleted;
-                // onPositionChanged applies it while this track plays
-                m_activeEnvelope = PlaylistWaveView::parseEnvelope(
-                    firstItem->data(PlaylistWaveView::VolumeEnvelopeRole).toString());
-                m_activeEnvelopePath = itemDaPlaylist;
                 if (m_nowPlayingWave)
                     m_nowPlayingWave->setEnvelope(m_activeEnvelope);
 
                 // Apply the level for position 0 right away (a track without
                 // a line restores the plain slider volume) so the first
-                // instants don't play at the previous track's envelope level
+                // instants don't play at the previous track's envelope level.
+                // The engine applies the line itself: the output keeps the
+                // plain slider volume there.
                 if (XplayerOutput) {
                     const double base = ui->sliderVolume->value() / 100.0;
-                    XplayerOutput->setVolume(float(base
-                        * PlaylistWaveView::envelopeGainAt(m_activeEnvelope, 0)));
-                    m_envelopeApplied = !m_activeEnvelope.isEmpty();
+                    if (Xplayer->fxEngineActive()) {
+                        XplayerOutput->setVolume(float(base));
+                        m_envelopeApplied = false;
+                    } else {
+                        XplayerOutput->setVolume(float(base
+                            * PlaylistWaveView::envelopeGainAt(m_activeEnvelope, 0)));
+                        m_envelopeApplied = !m_activeEnvelope.isEmpty();
+                    }
                 }
 
                 int dotsNumInString = itemDaPlaylist.count(".");
@@ -3573,6 +3852,8 @@ void player::playNextSong(){
                 ui->txtNowPlaying->setText(baseName);
 
                 QDateTime now = QDateTime::currentDateTime();
+                if (m_playLog)
+                    m_playLog->started(PlayLog::mainDeck(), itemDaPlaylist, now);
                 QString text = now.toString("yyyy-MM-dd || hh:mm:ss ||");
                 QString historyNewLine = text + " " + baseName;
                 {
@@ -3609,22 +3890,15 @@ void player::playNextSong(){
                     delete itemToDelete;
                 }
 
-                if(ui->checkBox_update_last_played_values->isChecked()){
-                    // Prepared statements: file paths may contain quotes
-                    QSqlQuery qry(db);
-                    qry.prepare("update musics set last_played = :ts where path = :path");
-                    qry.bindValue(":ts", now.toString("yyyy-MM-dd || hh:mm:ss"));
-                    qry.bindValue(":path", lastPlayedSong);
-                    if (!qry.exec()) {
-                        qWarning() << "Failed to update last_played:" << qry.lastError().text();
-                    }
-
-                    qry.prepare("update musics set played_times = played_times+1 where path = :path");
-                    qry.bindValue(":path", lastPlayedSong);
-                    if (!qry.exec()) {
-                        qWarning() << "Failed to update played_times:" << qry.lastError().text();
-                    }
+                if(ui->checkBox_update_last_played_values->isChecked() && m_databaseAccess){
+                    // Queued for the library writer: never holds up the next
+                    // track behind a running import. Bound values: file
+                    // paths may contain quotes.
+                    m_databaseAccess->write("update musics set last_played = ?, played_times = played_times+1 where path = ?",
+                                            {now.toString("yyyy-MM-dd || hh:mm:ss"), lastPlayedSong});
                 }
+                if (m_rotation)
+                    m_rotation->notePlayed(lastPlayedSong, now);
 
                 if(ui->checkBox_random_jingles->isChecked()){
                     int num = ui->spinBox_random_jingles_interval->value();
@@ -3672,6 +3946,8 @@ void player::playNextSong(){
             if(ui->playlist->count() <= currentPlaylistCount) {
                 qDebug()<<"No new items added to playlist, stopping";
                 Xplayer->stop();
+                if (m_playLog)
+                    m_playLog->stopped(PlayLog::mainDeck());
                 ui->btPlay->setStyleSheet("");
                 ui->btPlay->setText(tr("Play"));
                 PlayMode = "stopped";
@@ -3694,6 +3970,8 @@ void player::on_btStop_clicked()
     // (AVFoundation on macOS can hang on certain OGG files)
     Xplayer->stop();
     Xplayer->setSource(QUrl());  // Clear the source to fully release AVFoundation resources
+    if (m_playLog)
+        m_playLog->stopped(PlayLog::mainDeck());
     
     m_manualAdvancing = false;
     m_playbackWatchdog->stop();
@@ -3736,8 +4014,10 @@ void player::onPositionChanged(qint64 position)
         m_nowPlayingWave->setPlayhead(position);
 
     // Volume line: shape the playing track's volume along its envelope
-    // (slider volume stays the reference level the line scales from)
+    // (slider volume stays the reference level the line scales from).
+    // Only for plain playback — the FX engine applies the line per sample.
     if (!m_activeEnvelope.isEmpty() && Xplayer && XplayerOutput
+            && !Xplayer->fxEngineActive()
             && Xplayer->source().isLocalFile()
             && Xplayer->source().toLocalFile() == m_activeEnvelopePath) {
         const double base = ui->sliderVolume->value() / 100.0;
@@ -4227,9 +4507,8 @@ void player::playlistAboutToFinish()
     qDebug()<<"Launched playlistAboutToFinish";
     onAbout2Finish = 1;
 
-    int numItemsInPlaylist = ui->playlist->count();
-    if(numItemsInPlaylist==0)
-        autoModeGetMoreSongs();
+    // Auto mode keeps the coming hour planned, not just the next song
+    autoModeGetMoreSongs();
 
     // If the next track defines a crossfade overlap, preload the current
     // track into the tail player now so the handoff at the segue point is
@@ -4269,10 +4548,20 @@ void player::startOverlapSegue(qint64 fadeMs)
     } else if (m_tailPlayer && endingSource.isLocalFile()) {
         if (m_tailFade->state() == QAbstractAnimation::Running)
             m_tailFade->stop();
-        const float startVolume = XplayerOutput ? XplayerOutput->volume() : 1.0f;
-        m_tailOutput->setVolume(startVolume);
+        // The outgoing volume line goes with the tail
+        const bool endingHasLine = endingSource.isLocalFile()
+                                   && endingSource.toLocalFile() == m_activeEnvelopePath;
+        m_tailPlayer->setVolumeEnvelope(endingSource, endingHasLine ? m_activeEnvelope
+                                                                    : QVector<QPointF>());
         if (m_tailPlayer->source() != endingSource) // normally preloaded earlier
             m_tailPlayer->setSource(endingSource);
+        // An engine tail applies the line itself and fades from the slider
+        // level; plain playback fades from the line's current level
+        const double base = ui->sliderVolume->value() / 100.0;
+        const float startVolume = (m_tailPlayer->fxEngineActive() || !endingHasLine)
+            ? float(base)
+            : float(base * PlaylistWaveView::envelopeGainAt(m_activeEnvelope, endingPos));
+        m_tailOutput->setVolume(startVolume);
         // Seek BEFORE play: a stopped-state seek is only remembered, so the
         // decoder spawns once, already at the tail position. The previous
         // play-then-seek order spawned it twice (from 0, then again at the
@@ -4350,24 +4639,17 @@ void player::update_music_table() {
     qInfo() << "Updating tables using connection:" << db.connectionName() << "DB Name:" << db.databaseName();
 
     // --- Populate music table ---
-    // Always delete previous model if reloading to prevent memory leaks and issues
-    delete ui->musicView->model(); // Delete old model first
-    QSqlTableModel *model = new QSqlTableModel(this, db); // Pass the CORRECT db handle
-    model->setTable("musics");
-    // Optional: Set edit strategy if needed (BEFORE select)
-    // model->setEditStrategy(QSqlTableModel::OnFieldChange);
-    if (!model->select()) {
-        qWarning() << "Failed to select 'musics' table:" << model->lastError().text();
-        delete model; // Clean up failed model
-    } else {
-        ui->musicView->setModel(model);
-        // Configure view AFTER setting model (if needed)
-         qDebug() << "'musics' table model set.";
-         // Re-apply view settings if necessary as they might reset with new model
-         ui->musicView->setSortingEnabled(true);
-         ui->musicView->hideColumn(0);
-         // ... other ui->musicView settings ...
+    // The library model stays; it re-counts and reloads pages in the background
+    if (m_musicModel) {
+        if (ui->musicView->model() != m_musicModel) {
+            ui->musicView->setModel(m_musicModel);
+            ui->musicView->hideColumn(0);
+        }
+        m_musicModel->refresh();
     }
+    // Rotations reload in the background too
+    if (m_rotation)
+        m_rotation->reload();
 
 
     // --- Populate jingles table ---
@@ -4917,6 +5199,7 @@ void player::on_bt_autoMode_clicked()
         autoMode = 1;
         qDebug()<<"autoMode is ON";
         ui->bt_autoMode->setStyleSheet("background-color: rgb(175, 227, 59)");
+        autoModeGetMoreSongs();
     } else {
         autoMode = 0;
         qDebug()<<"autoMode is OFF";
@@ -4926,134 +5209,38 @@ void player::on_bt_autoMode_clicked()
 
 void player::autoModeGetMoreSongs()
 {
+    if(autoMode!=1 || !m_rotation)
+        return;
 
-    //check if there's a programed genre for this hour in the hourgenre table
-
-    QSqlDatabase db = QSqlDatabase::database("xfb_connection");
-    QDateTime now = QDateTime::currentDateTime();
-    QString currentHour = now.toString("h");
-    int dia = QDate::currentDate().dayOfWeek();
-
-    QString dw;
-    if(dia == 1) dw = "1";
-    if(dia == 2) dw = "2";
-    if(dia == 3) dw = "3";
-    if(dia == 4) dw = "4";
-    if(dia == 5) dw = "5";
-    if(dia == 6) dw = "6";
-    if(dia == 7) dw = "7";
-
-checkDbOpen();
-    QSqlQuery runQry(db);
-    runQry.prepare("select genre from hourgenre where hour=:hour and day=:day");
-    runQry.bindValue(":hour", currentHour);
-    runQry.bindValue(":day", dw);
-    QString currentGenre = "";
-
-    if(runQry.exec()){
-
-        qDebug()<<"The query was successfull: "<<runQry.lastQuery();
-
-        while(runQry.next()){
-            currentGenre = runQry.value(0).toString();
-            qDebug()<<"We now have selected the following genre for this hour, based on the data from the hourgenre table in the database: "<<currentGenre;
-        }
-
-    } else {
-
-        qDebug()<<"Oh dear, what now? "<<runQry.lastError();
-
-
+    // The first load runs at startup and takes well under a second even
+    // for a large library. Until it is in, RotationEngine::ready() calls
+    // back here; a load that failed is retried.
+    if(!m_rotation->isReady()){
+        qDebug()<<"autoMode: waiting for the music rotation to load";
+        if(!m_rotation->isLoading())
+            m_rotation->reload();
+        return;
     }
 
+    // Keep an hour of airtime planned. Each track is picked from the
+    // rotation of the hourgenre genre of the hour it will air in.
+    const int planSeconds = 3600;
+    int queuedSeconds = 0;
+    for(int i = 0; i < ui->playlist->count(); ++i)
+        queuedSeconds += m_rotation->secondsOf(ui->playlist->item(i)->text());
+    if(queuedSeconds >= planSeconds)
+        return;
 
-    if(currentGenre.isEmpty()){
-
-           if(autoMode==1){
-               //randomly select music from db
-               int numMusics = 1;
-               QSqlQuery query(db);
-               query.prepare("select path from musics order by random() limit :numMusics");
-               query.bindValue(":numMusics", numMusics);
-               if(query.exec())
-               {
-                   qDebug() << "SQL query executed: " << query.lastQuery();
-
-                   while(query.next()){
-                       QString path = query.value(0).toString();
-
-                       if(path!=lastPlayedSong){
-                           ui->playlist->addItem(path);
-                           qDebug() << "autoMode random music chooser adding: " << path;
-
-                       } else {
-
-                           QSqlQuery numOfItemsInDB(db);
-                           numOfItemsInDB.prepare("select count(path) from music where 1");
-                           numOfItemsInDB.exec();
-                           if(numOfItemsInDB.value(0).toInt()>1){
-                               qDebug()<<"autoMode picked the same song that was played before... Small DB or a Big Coincidence? Quering again for a 'random' new song..";
-                               autoModeGetMoreSongs();
-                           }
-
-                       }
-
-                   }
-
-               } else {
-                   qDebug() << "SQL ERROR: " << query.lastError();
-                   qDebug() << "SQL was: " << query.lastQuery();
-
-
-               }
-           }
-
-    } else {
-
-        if(autoMode==1){
-            //randomly select music from db based on genre for this hour
-
-            QSqlQuery query(db);
-            query.prepare("select path from musics where genre1 like :genre order by random() limit 1");
-            query.bindValue(":genre", currentGenre);
-            if(query.exec())
-            {
-                qDebug() << "SQL query executed: " << query.lastQuery();
-
-                while(query.next()){
-                    QString path = query.value(0).toString();
-
-                    if(path!=lastPlayedSong){
-                        ui->playlist->addItem(path);
-                        qDebug() << "autoMode genre based random music chooser adding: " << path;
-
-                    } else {
-
-                        QSqlQuery numOfItemsInDB(db);
-                        numOfItemsInDB.prepare("select count(path) from music where 1");
-                        numOfItemsInDB.exec();
-                        if(numOfItemsInDB.value(0).toInt()>1){
-                            qDebug()<<"autoMode picked the same song that was played before... Small DB or a Big Coincidence? Quering again for a 'random' new song..";
-                            autoModeGetMoreSongs();
-                        }
-
-                    }
-
-                }
-
-            } else {
-                qDebug() << "SQL ERROR: " << query.lastError();
-                qDebug() << "SQL was: " << query.lastQuery();
-
-
-            }
-            currentGenre = "";
-        }
-
+    const QDateTime from = QDateTime::currentDateTime().addSecs(queuedSeconds);
+    const QStringList paths = m_rotation->plan(from, planSeconds - queuedSeconds);
+    for(const QString &path : paths){
+        // Never queue the song that just played to play again right away
+        if(ui->playlist->count()==0 && path==lastPlayedSong && paths.size()>1)
+            continue;
+        ui->playlist->addItem(path);
     }
-
-
-
+    qDebug()<<"autoMode planned"<<paths.size()<<"songs from"<<from.toString("hh:mm")
+            <<"genre:"<<m_rotation->genreAt(from);
 }
 
 void player::on_actionAdd_a_single_song_triggered()
@@ -5516,7 +5703,7 @@ void player::server_check_and_schedule_new_programs(){
                                                 QString pMin = qhm.value(1).toString();
 
                                                 QSqlQuery addsch(db);
-                                                addsch.prepare("INSERT INTO scheduler VALUES (?, ?, ?, ?, ?, ?, '1', NULL, NULL, NULL, NULL, NULL, NULL, NULL, '1')");
+                                                addsch.prepare("INSERT INTO scheduler (id, ano, mes, dia, hora, min, tipo, is_program) VALUES (?, ?, ?, ?, ?, ?, '1', '1')");
                                                 addsch.addBindValue(pID);
                                                 addsch.addBindValue(pAno);
                                                 addsch.addBindValue(pMes);
@@ -6057,7 +6244,7 @@ void player::server_ftp_check(){
                                         QString pMin = qhm.value(1).toString();
 
                                         QSqlQuery addsch(db);
-                                        addsch.prepare("INSERT INTO scheduler VALUES (?, ?, ?, ?, ?, ?, '1', NULL, NULL, NULL, NULL, NULL, NULL, NULL, '1')");
+                                        addsch.prepare("INSERT INTO scheduler (id, ano, mes, dia, hora, min, tipo, is_program) VALUES (?, ?, ?, ?, ?, ?, '1', '1')");
                                         addsch.addBindValue(pID);
                                         addsch.addBindValue(pAno);
                                         addsch.addBindValue(pMes);
@@ -6227,206 +6414,56 @@ void player::stopMplayer(){
 }
 
 
-void player::run_scheduler(){
+void player::run_scheduler(int targetId, bool isProgram, bool once){
 
     QSqlDatabase db = QSqlDatabase::database("xfb_connection");
     checkDbOpen();
 
-    /*check if there is any thing to go on now*/
-
-    qDebug()<<"\nThe scheduller is now monitoring the database (the scheduler table) to check if there is something to go on at "<<QDateTime::currentDateTime().toString()<<"\n";
-
-
-
-QSqlQuery sched_qry(db);
-sched_qry.prepare("select * from scheduler");
-if(sched_qry.exec()){
-    while(sched_qry.next()){
-        QString tipo = sched_qry.value(6).toString();
-        //qDebug() << "Scheduler got a type "<<tipo<<" event rule.";
-
-        /*
-         *
-         * Var tipo determines the type of shedule
-         * 1 = an event to be played only once at a specific minute in time
-         *
-         * 2 = an event to be played every specific day of the week at a specific hour/min
-         *
-         * */
-
-        if(tipo=="1"){
-            QDateTime now = QDateTime::currentDateTime();
-
-                QString ano1 = now.toString("yyyy");
-                QString mes1 = now.toString("M");
-                QString dia1 = now.toString("d");
-                QString hora1 = now.toString("h");
-                QString min1 = now.toString("m");
-
-                QString ano2 = sched_qry.value(1).toString();
-                QString mes2 = sched_qry.value(2).toString();
-                QString dia2 = sched_qry.value(3).toString();
-                QString hora2 = sched_qry.value(4).toString();
-                QString min2 = sched_qry.value(5).toString();
-
-                QString is_program = sched_qry.value(14).toString();
-
-                /*
-                qDebug()<<"Scheduler is comparing values: ";
-                qDebug()<<ano1<<" should be equal to "<<ano2<<" -> ano";
-                qDebug()<<mes1<<" should be equal to "<<mes2<<" -> mes";
-                qDebug()<<dia1<<" should be equal to "<<dia2<<" -> dia";
-                qDebug()<<hora1<<" should be equal to "<<hora2<<" -> hora";
-                qDebug()<<min1<<" should be equal to "<<min2<<" -> minuto";
-                 */
-
-
-            //if agora values == este qry values
-                if((ano1==ano2) && (mes1==mes2) && (dia1==dia2) && (hora1==hora2) && (min1==min2)){
-                    qDebug() << "Scheduled event now fired (type 1)!";
-
-                    QString schId = sched_qry.value(0).toString();
-
-                    //add to playlist
-                    QSqlQuery getPath(db);
-                    if(is_program=="1"){
-                        getPath.prepare("SELECT path FROM programs WHERE id=?");
-                    } else {
-                        getPath.prepare("SELECT path FROM pub WHERE id=?");
-                    }
-                    getPath.addBindValue(schId);
-
-                    if(getPath.exec()){
-                        while(getPath.next()){
-                            QString pubPath = getPath.value(0).toString();
-                            ui->playlist->insertItem(0,pubPath);
-                            qDebug()<<"Scheduled event added to the top of the playlist: "<<pubPath;
-                        }
-
-                    }
-
-                    //delete scheduler row cause its a type 1
-
-                    QSqlQuery del_qry(db);
-                    del_qry.prepare("DELETE FROM scheduler WHERE id=? AND ano=? AND mes=? AND dia=? AND hora=? AND min=?");
-                    del_qry.addBindValue(schId);
-                    del_qry.addBindValue(ano1);
-                    del_qry.addBindValue(mes1);
-                    del_qry.addBindValue(dia1);
-                    del_qry.addBindValue(hora1);
-                    del_qry.addBindValue(min1);
-                    if(del_qry.exec()){
-                        qDebug () << "Scheduled rule was deleted!";
-                    } else {
-                        qDebug()<<"exeption deleting scheduled rule with qry: "<<del_qry.lastQuery()<<" we got: "<<del_qry.lastError();
-                    }
-
-                    //check if pub still has other scheduler rules and delete from pub if not
-                    QSqlQuery sq(db);
-                    sq.prepare("SELECT count(id) FROM scheduler WHERE id=?");
-                    sq.addBindValue(schId);
-                    if(sq.exec()){
-
-                        while(sq.next()){
-                            qDebug()<<"We have a total of "<<sq.value(0).toString()<<" records in the scheduler table with the schId "<<schId;
-                            if(sq.value(0).toString()=="0"){
-                                //we can delete it from pub cause no more scheduled rules apply
-
-                                QSqlQuery sd(db);
-                                sd.prepare("DELETE FROM pub WHERE id=?");
-                                sd.addBindValue(schId);
-                                if(sd.exec()){
-                                    qDebug () << "Pub rule was deleted!";
-                                    update_music_table();
-                                } else {
-                                    qDebug()<<"exeption deleting pub rule with qry: "<<del_qry.lastQuery()<<" we got: "<<del_qry.lastError();
-                                }
-
-                            }
-                        }
-
-
-                    }
-
-                }
+    /*
+     * Called by SchedulerEngine when a rule is due; targetId is the pub
+     * or program the rule plays (isProgram says which table):
+     *
+     * once = an event to be played only once at a specific minute in time;
+     * the engine has already deleted its scheduler row
+     *
+     * otherwise an event played every specific day of the week at a
+     * specific hour/min
+     *
+     * */
+
+    qDebug() << "Scheduled event now fired (type" << (once ? 1 : 2) << ") at" << QDateTime::currentDateTime().toString();
+
+    //add to playlist
+    QSqlQuery getPath(db);
+    if(isProgram){
+        getPath.prepare("SELECT path FROM programs WHERE id=?");
+    } else {
+        getPath.prepare("SELECT path FROM pub WHERE id=?");
+    }
+    getPath.addBindValue(targetId);
 
+    if(getPath.exec()){
+        while(getPath.next()){
+            QString pubPath = getPath.value(0).toString();
+            ui->playlist->insertItem(0,pubPath);
+            qDebug()<<"Scheduled event added to the top of the playlist: "<<pubPath;
         }
+    }
 
-        if(tipo=="2"){
-            int dia = QDate::currentDate().dayOfWeek();
-
-            QString dw;
-            if(dia == 1) dw = "Monday";
-            if(dia == 2) dw = "Tuesday";
-            if(dia == 3) dw = "Wednesday";
-            if(dia == 4) dw = "Thursday";
-            if(dia == 5) dw = "Friday";
-            if(dia == 6) dw = "Saturday";
-            if(dia == 7) dw = "Sunday";
-
-            //qDebug()<<"Today it's "<< dw << "!";
-
-
-            QString is_program = sched_qry.value(14).toString();
-
-
-
-            QDateTime now = QDateTime::currentDateTime();
-
-            QString hora1 = now.toString("h");
-            QString min1 = now.toString("m");
-
-
-
-            QString dw2 = sched_qry.value(7).toString();
-            QString hora2 = sched_qry.value(4).toString();
-            QString min2 = sched_qry.value(5).toString();
-
-
-
-            //so:
-            //
-            //dw has today's day of the week
-            //hora1 has the current hour
-            //min1 has the current minute
-            //dw2 has the scheduled day of the week
-            //hora2 has the scheduled hour
-            //min2 has the scheduled minute
-            //
-            // /////////////// //
-
-            if((dw==dw2)&&(hora1==hora2)&&(min1==min2)){
-                qDebug() << "Scheduled event now fired (type 2)!";
-                QString schId = sched_qry.value(0).toString();
-
-                //add to playlist
-                QSqlQuery getPath(db);
-                if(is_program=="1"){
-                    getPath.prepare("SELECT path FROM programs WHERE id=?");
-                } else {
-                    getPath.prepare("SELECT path FROM pub WHERE id=?");
-                }
-                getPath.addBindValue(schId);
-
-                if(getPath.exec()){
-                    while(getPath.next()){
-                        QString pubPath = getPath.value(0).toString();
-                        ui->playlist->insertItem(0,pubPath);
-                        qDebug()<<"Scheduled event added to the top of the playlist: "<<pubPath;
-                    }
-
-                }
-
-            }
-
-
+    //delete the pub once no more scheduled rules apply to it
+    if(once && !isProgram && m_scheduler && m_scheduler->rulesFor(targetId, false) == 0){
+        QSqlQuery sd(db);
+        sd.prepare("DELETE FROM pub WHERE id=?");
+        sd.addBindValue(targetId);
+        if(sd.exec()){
+            qDebug () << "Pub rule was deleted!";
+            update_music_table();
+        } else {
+            qDebug()<<"exeption deleting pub rule with qry: "<<sd.lastQuery()<<" we got: "<<sd.lastError();
         }
-
     }
 }
 
-}
-
 
 
 
@@ -6492,23 +6529,25 @@ void player::on_actionAdd_a_song_from_Youtube_or_Other_triggered()
 }
 
 void player::on_bt_search_clicked()
+{
+    applyLibrarySearch();
+}
+
+void player::applyLibrarySearch()
 {
     //search
     qDebug()<<"Staring a new search!";
     QString term = ui->txt_search->text();
+    if (m_searchTypingTimer)
+        m_searchTypingTimer->stop();
 
-    QSqlQueryModel *model = new QSqlQueryModel();
-    QSqlQuery searchQuery(QSqlDatabase::database("xfb_connection"));
-    searchQuery.prepare("select * from musics where artist like :t1 or song like :t2");
-    searchQuery.bindValue(":t1", "%" + term + "%");
-    searchQuery.bindValue(":t2", "%" + term + "%");
-    searchQuery.exec();
-    model->setQuery(std::move(searchQuery));
-    ui->musicView->setModel(model);
-
-    ui->musicView->setSortingEnabled(true);
-    ui->musicView->hideColumn(0);
-    ui->musicView->setSizePolicy(QSizePolicy::Expanding,QSizePolicy::Expanding);
+    // Searches the whole library, as before: a genre filter does not apply.
+    // No columns: every column in the full-text index (artist and song
+    // when the index is unavailable)
+    if (m_musicModel) {
+        m_musicModel->setGenreFilter(QString());
+        m_musicModel->setSearchFilter(term);
+    }
 }
 
 void player::on_bt_reset_clicked()
@@ -6519,15 +6558,10 @@ void player::on_bt_reset_clicked()
     // (which uses the right connection) refreshed it.
     ui->txt_search->clear();
     checkDbOpen();
-    delete ui->musicView->model();
-    QSqlQueryModel *modelo = new QSqlQueryModel();
-    QSqlQuery all(QSqlDatabase::database("xfb_connection"));
-    all.exec("select * from musics");
-    modelo->setQuery(std::move(all));
-    ui->musicView->setModel(modelo);
-    ui->musicView->setSortingEnabled(true);
-    ui->musicView->hideColumn(0);
-    ui->musicView->setSizePolicy(QSizePolicy::Expanding, QSizePolicy::Expanding);
+    if (m_musicModel) {
+        m_musicModel->clearFilters();
+        m_musicModel->refresh();
+    }
 }
 
 void player::on_bt_apply_filter_clicked()
@@ -6606,15 +6640,12 @@ void player::on_bt_apply_filter_clicked()
     }
     qDebug()<<"addG1 is "<<addG1<<" and addG2 is "<<addG2;
     if(addG1 != "" || addG2 != ""){
-        qDebug() << "making a new table to show with the results...";
-        QSqlQueryModel * model = new QSqlQueryModel();
-        QSqlQuery filterQuery(db);
-        filterQuery.prepare("select * from musics where "+addG1+addG2);
-        if(g1_checked) filterQuery.bindValue(":g1", selectedGenre1);
-        if(g2_checked) filterQuery.bindValue(":g2", selectedGenre2);
-        filterQuery.exec();
-        model->setQuery(std::move(filterQuery));
-        ui->musicView->setModel(model);
+        qDebug() << "filtering the music table by genre...";
+        if (m_musicModel) {
+            m_musicModel->setSearchFilter(QString());
+            m_musicModel->setGenreFilter(g1_checked ? selectedGenre1 : QString(),
+                                         g2_checked ? selectedGenre2 : QString());
+        }
     }
 
 
@@ -6823,7 +6854,7 @@ void player::on_bt_rec_clicked()
         ui->bt_rec->setStyleSheet("");
         ui->bt_pause_rec->setStyleSheet("");
         setRecTimeToDefaults();
-        audioRecorder->stop();
+        m_programRecorder->stop();
         ui->led_rec->hide();
         ui->bt_pause_rec->setEnabled(false);
         recPause = false;
@@ -6833,11 +6864,11 @@ void player::on_bt_rec_clicked()
 
 void player::RecCHK(){
 
-    QFile myFile(saveFile);
+    const ProgramRecorder::Stats stats = m_programRecorder->stats();
 
-    qDebug()<<"File.size() is now: "<<myFile.size();
+    qDebug()<<"Recorded bytes so far: "<<stats.bytesWritten;
 
-    if(myFile.size()==0){
+    if(!m_programRecorder->isRecording() || stats.bytesWritten==0){
         //red
         ui->led_rec->setStyleSheet("background-color:#FF0010;border-radius:8px;");
     } else {
@@ -6919,78 +6950,40 @@ void player::RectimerDone(){
         selectedDevice = QMediaDevices::defaultAudioInput();
     }
 
-    // Set the audio input device
-    audioInput->setDevice(selectedDevice);
     qDebug() << "Selecting this audio input device: " << selectedDevice.description();
 
-    // Configure media recorder settings
-    QMediaFormat format;
-
-    // Set container format
-    aExtencaoDesteCoiso = "ogg";
-
-    if(contentamento=="matroska") {
-        format.setFileFormat(QMediaFormat::FileFormat::Matroska);
-        aExtencaoDesteCoiso = "mp3";
-    } else if(contentamento=="ogg") {
-        format.setFileFormat(QMediaFormat::FileFormat::Ogg);
-        aExtencaoDesteCoiso = "ogg";
-    } else if(contentamento=="mp4") {
-        format.setFileFormat(QMediaFormat::FileFormat::MPEG4);
-        aExtencaoDesteCoiso = "mp4";
-    } else if(contentamento=="wav") {
-        format.setFileFormat(QMediaFormat::FileFormat::Wave);
-        aExtencaoDesteCoiso = "wav";
-    } else if(contentamento=="quicktime") {
-        format.setFileFormat(QMediaFormat::FileFormat::QuickTime);
-        aExtencaoDesteCoiso = "mov";
+    // Recording format from the configured codec and container; Ogg/Opus
+    // stays the default. Encoded formats fall back to WAV when no encoder
+    // is available.
+    RecordingSegmenter::Settings recSettings;
+    if (recContainer == QMediaFormat::Wave) {
+        recSettings.format = RecordingSegmenter::Format::Wav;
+    } else if (recCodec == QMediaFormat::AudioCodec::MP3) {
+        recSettings.format = RecordingSegmenter::Format::Mp3;
+    } else if (recCodec == QMediaFormat::AudioCodec::AAC) {
+        recSettings.format = RecordingSegmenter::Format::Aac;
     } else {
-        // Default to Ogg if format not recognized
-        format.setFileFormat(QMediaFormat::FileFormat::Ogg);
-        aExtencaoDesteCoiso = "ogg";
-    }
-
-    // Set audio codec (if needed)
-    if (!codec.isEmpty()) {
-        if (codec == "audio/vorbis") {
-            format.setAudioCodec(QMediaFormat::AudioCodec::Vorbis);
-        } else if (codec == "audio/opus") {
-            format.setAudioCodec(QMediaFormat::AudioCodec::Opus);
-        } else if (codec == "audio/mp3") {
-            format.setAudioCodec(QMediaFormat::AudioCodec::MP3);
-        } else if (codec == "audio/aac") {
-            format.setAudioCodec(QMediaFormat::AudioCodec::AAC);
-        }
-    }
-
-    // Set quality
-    audioRecorder->setQuality(QMediaRecorder::HighQuality);
-    audioRecorder->setMediaFormat(format);
-    audioRecorder->setOutputLocation(QUrl::fromLocalFile(saveFile));
-
-    // Connect signals for recording state changes
-    connect(audioRecorder, &QMediaRecorder::recorderStateChanged, this, [](QMediaRecorder::RecorderState state) {
-        if (state == QMediaRecorder::RecordingState) {
-            qDebug() << "Recording state: Recording";
-        } else if (state == QMediaRecorder::PausedState) {
-            qDebug() << "Recording state: Paused";
-        } else if (state == QMediaRecorder::StoppedState) {
-            qDebug() << "Recording state: Stopped";
-        }
-    });
-
-    connect(audioRecorder, &QMediaRecorder::errorOccurred, this, [this](QMediaRecorder::Error error, const QString &errorString) {
-        // Unused parameter 'error'
-        Q_UNUSED(error);
-
-        qDebug() << "Recording error: " << errorString;
-        QMessageBox::warning(this, tr("Recording Error"), errorString);
-    });
+        recSettings.format = RecordingSegmenter::Format::Opus;
+    }
+    recSettings.bitrateKbps = recSettings.format == RecordingSegmenter::Format::Opus ? 128 : 192;
+    recSettings.segmentSeconds = recSegmentMinutes * 60;
+    aExtencaoDesteCoiso = RecordingSegmenter::extension(recSettings.format);
+    saveFile = SavePath + "/XFB." + aExtencaoDesteCoiso;
 
-    // Start recording
-    audioRecorder->record();
+    QString error;
+    if (!m_programRecorder->start(selectedDevice, recSettings, SavePath + "/XFB", &error)) {
+        qDebug() << "Recording error: " << error;
+        setRecTimeToDefaults();
+        ui->bt_rec->setStyleSheet("");
+        ui->bt_pause_rec->setEnabled(false);
+        ui->led_rec->hide();
+        ui->bt_rec->show();
+        recMode = 0;
+        QMessageBox::warning(this, tr("Recording Error"), error);
+        return;
+    }
 
-    qDebug() << "Recording started with format: " << format.fileFormat();
+    qDebug() << "Recording started with format: " << aExtencaoDesteCoiso;
 
     ui->bt_rec->show();
 }
@@ -6998,58 +6991,20 @@ void player::RectimerDone(){
 
 void player::run_recTimer(){
 
-    QString xsegundos;
-    QString xminutos;
-    QString xhoras;
+    // Time actually on disk, so pauses and capture hiccups are accounted for
+    const qint64 secs = m_programRecorder->stats().recordedMs / 1000;
+    const QString txtElapsedTimeLable = QString("%1:%2:%3")
+            .arg(secs / 3600, 2, 10, QChar('0'))
+            .arg((secs / 60) % 60, 2, 10, QChar('0'))
+            .arg(secs % 60, 2, 10, QChar('0'));
+    ui->txt_recTime->setText(txtElapsedTimeLable);
 
-    if(recSecs<60){
-        recSecs++;
-    }
+}
 
-    if(recSecs==60)
-    {
-        recMins++;
-        recSecs-=60;
-    }
-    if(recMins>59)
-    {
-        ++recHours;
-        recMins-=60;
-    }
-
-    if(recSecs<10)
-    {
-        xsegundos = "0"+QString::number(recSecs);
-    } else {
-        xsegundos = QString::number(recSecs);
-    }
-    if(recMins<10)
-    {
-        xminutos = "0"+QString::number(recMins);
-    } else {
-        xminutos = QString::number(recMins);
-    }
-    if(recHours<10)
-    {
-        xhoras = "0"+QString::number(recHours);
-    } else {
-        xhoras = QString::number(recHours);
-    }
-   QString txtElapsedTimeLable =  xhoras+":"+xminutos+":"+xsegundos;
-   ui->txt_recTime->setText(txtElapsedTimeLable);
-
-
-
-
-}
-
-void player::setRecTimeToDefaults(){
-    recTimer->stop();
-    recSecs = 0;
-    recMins = 0;
-    recHours = 0;
-    ui->txt_recTime->setText("");
-    ui->txt_recTime->hide();
+void player::setRecTimeToDefaults(){
+    recTimer->stop();
+    ui->txt_recTime->setText("");
+    ui->txt_recTime->hide();
 
 }
 
@@ -7218,6 +7173,9 @@ void player::on_bt_ProgramStopandProcess_clicked()
 
             if(saveFile.isEmpty()){
                 QMessageBox::information(this,tr("No program set or recorded"),tr("There is no program set or recorded to send"));
+            } else if(m_programRecorder->isRecording() || !QFile::exists(saveFile)){
+                // The segments are joined into saveFile shortly after the stop
+                QMessageBox::information(this,tr("Recording not saved yet"),tr("Stop the recording and wait a moment for it to be saved before sending it"));
             } else {
                 qDebug()<<"Processing file: "<<saveFile;
 
@@ -7998,6 +7956,99 @@ void player::calculate_playlist_total_time() {
     qInfo() << "Final calculated playlist time string:" << finalTimeString;
     ui->txt_playlistTotalTime->setText(finalTimeString);
 }
+bool player::startLibraryRescan(bool watch)
+{
+    QSqlDatabase db = QSqlDatabase::database("xfb_connection");
+    QStringList roots = LibraryRescanner::libraryRoots(db);
+
+    // Libraries imported before roots were recorded: start from the
+    // configured music folder, else ask once
+    if (roots.isEmpty() && !MusicPath.isEmpty() && QFileInfo(MusicPath).isDir())
+        roots << MusicPath;
+    if (roots.isEmpty()) {
+        const QString dir = QFileDialog::getExistingDirectory(this, tr("Select your music folder"));
+        if (dir.isEmpty())
+            return false;
+        roots << dir;
+    }
+    for (const QString &root : roots)
+        LibraryRescanner::addLibraryRoot(db, root);
+
+    LibraryRescanner::Options options;
+    options.roots = roots;
+    options.rowDefaults.country = "Other country / language";
+    options.rowDefaults.publishedDate = QDate::currentDate().toString("yyyy/MM/dd");
+
+    return watch ? m_libraryRescanner->watch(options) : m_libraryRescanner->start(options);
+}
+
+void player::on_actionRescan_the_library_triggered()
+{
+    if (!m_libraryRescanner)
+        return;
+    if (m_libraryRescanner->isRunning()) {
+        m_rescanInteractive = true;
+        return;
+    }
+
+    m_rescanInteractive = true;
+    if (!startLibraryRescan(false))
+        m_rescanInteractive = false;
+}
+
+void player::on_actionWatch_the_music_folders_toggled(bool checked)
+{
+    if (!m_libraryRescanner)
+        return;
+
+    if (checked) {
+        if (!m_libraryRescanner->isWatching() && !startLibraryRescan(true)) {
+            ui->actionWatch_the_music_folders->setChecked(false);
+            return;
+        }
+    } else {
+        m_libraryRescanner->stopWatching();
+    }
+
+    QSettings settings(QStandardPaths::writableLocation(QStandardPaths::AppConfigLocation)
+                           + "/xfb.conf", QSettings::IniFormat);
+    settings.setValue("WatchMusicFolders", checked);
+}
+
+QStringList player::recommendedLibraryIndexes() const
+{
+    QStringList statements;
+    if (!m_databaseOptimizer)
+        return statements;
+    for (const auto &recommendation : m_databaseOptimizer->getOptimizationRecommendations()) {
+        if (recommendation.type == DatabaseOptimizer::OptimizationRecommendation::CreateIndex)
+            statements << recommendation.sqlCommand;
+    }
+    return statements;
+}
+
+void player::on_actionApply_the_recommended_library_indexes_triggered()
+{
+    const QStringList statements = recommendedLibraryIndexes();
+    if (statements.isEmpty()) {
+        QMessageBox::information(this, tr("Library indexes"),
+                                 tr("No slow library query needs an index at the moment."));
+        ui->actionApply_the_recommended_library_indexes->setEnabled(false);
+        return;
+    }
+
+    const QString text = tr("These indexes would speed up slow library queries:\n\n%1\n\n"
+                            "Creating them locks the library for a moment. Create them now?")
+                             .arg(statements.join('\n'));
+    if (QMessageBox::question(this, tr("Library indexes"), text, QMessageBox::Yes | QMessageBox::No,
+                              QMessageBox::No) != QMessageBox::Yes)
+        return;
+
+    const int created = m_databaseOptimizer->createRecommendedIndexes();
+    ui->statusBar->showMessage(tr("Created %1 of %2 library indexes").arg(created).arg(statements.size()));
+    ui->actionApply_the_recommended_library_indexes->setEnabled(false);
+}
+
 void player::on_actionCheck_Database_Data_and_DELETE_all_invalid_records_witouth_confirmation_triggered()
 {
 
@@ -8439,6 +8490,8 @@ void player::on_lp_1_bt_play_clicked()
     lp1_XplaylistUrls.append(QUrl::fromLocalFile(ui->lp_1_txt_file->text()));
     lp1_Xplayer->setSource(lp1_XplaylistUrls.first());
     lp1_Xplayer->play();
+    if (m_playLog)
+        m_playLog->started(PlayLog::deck(1), ui->lp_1_txt_file->text());
 
 
     if (movie) movie->deleteLater(); // don't leak the previous animation
@@ -8468,6 +8521,8 @@ void player::on_lp_1_bt_play_2_clicked()
     lp2_XplaylistUrls.append(QUrl::fromLocalFile(ui->lp_2_txt_file->text()));
     lp2_Xplayer->setSource(lp2_XplaylistUrls.first());
     lp2_Xplayer->play();
+    if (m_playLog)
+        m_playLog->started(PlayLog::deck(2), ui->lp_2_txt_file->text());
 
     if (movie2) movie2->deleteLater(); // don't leak the previous animation
     movie2 = new QMovie(":/images/lp_anim1.gif");
@@ -8492,11 +8547,15 @@ void player::on_lp_1_bt_pause_clicked()
 {
     if(lp_1_paused){
         lp1_Xplayer->play();
+        if (m_playLog)
+            m_playLog->resumed(PlayLog::deck(1));
         //movie->start();
         lp_1_paused = false;
         ui->lp_1_bt_pause->setStyleSheet("");
     }else{
         lp1_Xplayer->pause();
+        if (m_playLog)
+            m_playLog->paused(PlayLog::deck(1));
         //movie->stop();
         lp_1_paused = true;
         ui->lp_1_bt_pause->setStyleSheet("background-color:#EDE635");
@@ -8508,11 +8567,15 @@ void player::on_lp_2_bt_pause_clicked()
 {
     if(lp_2_paused){
         lp2_Xplayer->play();
+        if (m_playLog)
+            m_playLog->resumed(PlayLog::deck(2));
         //movie->start();
         lp_2_paused = false;
         ui->lp_2_bt_pause->setStyleSheet("");
     }else{
         lp2_Xplayer->pause();
+        if (m_playLog)
+            m_playLog->paused(PlayLog::deck(2));
         //movie->stop();
         lp_2_paused = true;
         ui->lp_2_bt_pause->setStyleSheet("background-color:#EDE635");
@@ -8570,240 +8633,38 @@ void player::on_bt_sndconv_clicked()
 
 void player::on_actionAutoTrim_the_silence_from_the_start_and_the_end_of_all_music_tracks_in_the_database_triggered()
 {
-    QSqlDatabase db = QSqlDatabase::database("xfb_connection");
-    if (!db.isOpen()) {
-        qWarning() << "Database connection 'xfb_connection' is not open!";
-        QMessageBox::critical(this, "Database Error", "Database connection is not open.");
+    if (!m_trackTrimmer)
         return;
-    }
 
-    // --- Check for SOX executable ---
-    QString soxPath = QStandardPaths::findExecutable("sox");
-    if (soxPath.isEmpty()) {
-        qWarning() << "'sox' command not found in system PATH.";
-        QMessageBox::critical(this, "Missing Dependency",
-                              "The 'sox' command (Sound eXchange) is required for this feature "
-                              "but was not found in the system's PATH.\n\nPlease install SoX and ensure it's accessible.");
+    // Asking again while a trim runs offers to stop it
+    if (m_trackTrimmer->isRunning()) {
+        if (QMessageBox::question(this, tr("Auto-Trim"),
+                                  tr("The library is being trimmed. Stop now?\n\n"
+                                     "Files already done keep their trim; the rest is picked up next time."),
+                                  QMessageBox::Yes | QMessageBox::No) == QMessageBox::Yes)
+            m_trackTrimmer->cancel();
         return;
     }
-    qInfo() << "Found sox executable at:" << soxPath;
-    // --- End SOX check ---
 
-    QMessageBox::StandardButton run = QMessageBox::question(this, "Confirm Auto-Trim",
-                                                            "This will attempt to trim silence (below 1% threshold) from the start and end of every track in the database using 'sox'.\n\n"
-                                                            "Original files will be overwritten!\n\n"
-                                                            "This process can take a long time and is irreversible.\n"
-                                                            "Are you sure you want to proceed?",
-                                                            QMessageBox::Yes | QMessageBox::No);
-    if (run == QMessageBox::No) {
+    if (FxEngine::ffmpegExecutable().isEmpty()) {
+        qWarning() << "'ffmpeg' command not found in system PATH.";
+        QMessageBox::critical(this, "Missing Dependency",
+                              "The 'ffmpeg' command is required for this feature "
+                              "but was not found in the system's PATH.\n\nPlease install ffmpeg and ensure it's accessible.");
         return;
     }
 
-    // --- Setup Loading Indicator & Progress Dialog ---
-    QMovie loadingMovie(":/images/loading.gif"); // Use stack variable if movie is temporary
-    if(!loadingMovie.isValid()){
-         qWarning() << "Loading GIF not valid:" << ":/images/loading.gif";
-         // Continue without movie, maybe show text?
-         ui->txt_loading->setText("Processing...");
-         ui->txt_loading->show();
-    } else {
-        ui->txt_loading->setMovie(&loadingMovie);
-        ui->txt_loading->setScaledContents(true);
-        ui->txt_loading->show();
-        loadingMovie.start();
-    }
-    qApp->processEvents(); // Allow UI to update
-
-    QProgressDialog progressDialog("Trimming silence...", "Cancel", 0, 0, this);
-    progressDialog.setWindowModality(Qt::WindowModal);
-    progressDialog.setValue(0);
-    progressDialog.show();
-    qApp->processEvents();
-    // --- End Setup ---
-
-
-    QSqlQuery querySelect(db);
-    QString selectStr = "SELECT path FROM musics"; // Only need the path
-    int totalFiles = 0;
-
-    // First count the files for the progress bar
-    if (querySelect.exec("SELECT COUNT(*) FROM musics")) {
-        if (querySelect.next()) {
-            totalFiles = querySelect.value(0).toInt();
-        }
-    } else {
-         qWarning() << "Failed to count records:" << querySelect.lastError();
-         // Proceed without accurate progress max? Or abort? Let's try proceeding.
-    }
-    progressDialog.setMaximum(totalFiles > 0 ? totalFiles : 100); // Set max for progress bar
-    qApp->processEvents();
-
-
-    // Now get the paths
-    if (!querySelect.exec(selectStr)) {
-        qWarning() << "Failed to SELECT paths from musics:" << querySelect.lastError();
-        QMessageBox::critical(this, "Database Error", "Failed to query the musics table for paths.");
-        loadingMovie.stop();
-        ui->txt_loading->hide();
-        progressDialog.cancel();
+    if (QMessageBox::question(this, tr("Confirm Auto-Trim"),
+                              tr("This finds the silence (below 1% of full scale) at the start and the end "
+                                 "of every track in the database. Playback then skips it.\n\n"
+                                 "The files are not changed; you can choose to cut the silence out of them "
+                                 "when the scan is done. It runs in the background; choose it again to stop it."),
+                              QMessageBox::Yes | QMessageBox::No) != QMessageBox::Yes)
         return;
-    }
 
-    int processedCount = 0;
-    int successCount = 0;
-    int failCount = 0;
-    bool cancelled = false;
-
-    QTemporaryDir tempDir; // Creates a unique temporary directory
-    if (!tempDir.isValid()) {
-        qWarning() << "Failed to create temporary directory:" << tempDir.errorString();
-        QMessageBox::critical(this, "File System Error", "Could not create a temporary directory to process files.");
-        loadingMovie.stop();
-        ui->txt_loading->hide();
-        progressDialog.cancel();
-        return;
-    }
-    qInfo() << "Using temporary directory:" << tempDir.path();
-
-
-    while (querySelect.next() && !cancelled) {
-        processedCount++;
-        progressDialog.setValue(processedCount);
-        QString originalPath = querySelect.value(0).toString();
-        QFileInfo originalFileInfo(originalPath);
-
-        progressDialog.setLabelText(QString("Processing [%1/%2]:\n%3")
-                                        .arg(processedCount)
-                                        .arg(totalFiles)
-                                        .arg(originalFileInfo.fileName()));
-        qApp->processEvents(); // Keep UI responsive and check for Cancel button
-
-        if (progressDialog.wasCanceled()) {
-            qInfo() << "User cancelled the operation.";
-            cancelled = true;
-            break;
-        }
-
-        qInfo().noquote() << "AutoTrim Processing [" << processedCount << "/" << totalFiles << "]:" << originalPath;
-
-        if (!originalFileInfo.exists() || !originalFileInfo.isFile()) {
-            qWarning() << "File does not exist or is not a regular file:" << originalPath;
-            failCount++;
-            continue; // Skip to next file
-        }
-
-        // --- Prepare temporary output path ---
-        // Use original filename but in the temporary directory
-        QString tempOutputPath = tempDir.filePath(originalFileInfo.fileName());
-        qDebug() << "Temporary output path:" << tempOutputPath;
-
-        // --- Run SOX ---
-        QProcess soxProcess;
-        QStringList soxArgs;
-        soxArgs << originalPath                   // Input file
-                << tempOutputPath                 // Output file
-                << "silence"                      // Effect name
-                << "1"                            // Detect silence around the file (mode)
-                << "0.1"                          // Stop point (duration in seconds)
-                << "1%";                          // Threshold (e.g., 0.1% or 1%) - NOTE: You had 0.1% in question, 1% in code. Using 1% as per code.
-
-        qDebug() << "Running command:" << soxPath << soxArgs;
-
-        soxProcess.start(soxPath, soxArgs);
-
-        // Wait for SOX to finish (adjust timeout if needed, -1 means wait indefinitely)
-        // Use a reasonable timeout, e.g., 5 minutes (300000 ms) for potentially large files
-        if (!soxProcess.waitForFinished(300000)) {
-            qWarning() << "Sox process timed out for:" << originalPath << soxProcess.errorString();
-            soxProcess.kill();
-            soxProcess.waitForFinished(1000); // Wait a bit after killing
-            failCount++;
-            continue; // Skip to next file
-        }
-
-        // Check SOX execution result
-        if (soxProcess.exitStatus() != QProcess::NormalExit || soxProcess.exitCode() != 0) {
-            qWarning() << "Sox process failed for:" << originalPath
-                       << "Exit code:" << soxProcess.exitCode()
-                       << "Exit status:" << soxProcess.exitStatus();
-            QString errorOutput = QString::fromLocal8Bit(soxProcess.readAllStandardError());
-            qWarning() << "Sox Standard Error:\n" << errorOutput;
-            // Clean up potentially incomplete temp file before continuing
-            QFile::remove(tempOutputPath);
-            failCount++;
-            continue; // Skip to next file
-        }
-
-        // --- Check if temp file was created and is valid ---
-        QFileInfo tempFileInfo(tempOutputPath);
-        if (!tempFileInfo.exists() || tempFileInfo.size() == 0) {
-             qWarning() << "Sox finished successfully but the output file is missing or empty:" << tempOutputPath;
-             // Clean up potentially empty temp file
-             QFile::remove(tempOutputPath);
-             failCount++;
-             continue; // Skip to next file
-        }
-
-        qDebug() << "Sox completed successfully. Temp file size:" << tempFileInfo.size();
-
-        // --- Replace original file with trimmed version ---
-        // QFile::rename will overwrite the destination if it exists on most platforms.
-        // This is atomic on many filesystems (safer than delete then move).
-        bool renamed = QFile::rename(tempOutputPath, originalPath);
-
-        if (!renamed) {
-            // Rename failed. Maybe permissions issue, file lock, cross-device move?
-            // Try copy & delete as a fallback (less safe, not atomic)
-            qWarning() << "QFile::rename failed for" << tempOutputPath << "to" << originalPath << ". Attempting copy and delete.";
-            if (QFile::copy(tempOutputPath, originalPath)) {
-                 qDebug() << "Copy successful. Now removing temporary file.";
-                 if (!QFile::remove(tempOutputPath)) {
-                      qWarning() << "Failed to remove temporary file after successful copy:" << tempOutputPath;
-                      // Continue, main goal achieved, but temp file left behind.
-                 }
-                 successCount++;
-                 qInfo() << "File trimmed and replaced (using copy/delete):" << originalPath;
-            } else {
-                qWarning() << "Fallback copy failed for:" << tempOutputPath << "to" << originalPath;
-                // Clean up temp file if copy failed
-                QFile::remove(tempOutputPath);
-                failCount++;
-                continue; // Skip to next file
-            }
-        } else {
-            // Rename successful! The temp file is now gone (moved).
-            successCount++;
-            qInfo() << "File trimmed and replaced (using rename):" << originalPath;
-        }
-        // --- End Replace ---
-
-    } // End while loop
-
-    // --- Cleanup and Summary ---
-    loadingMovie.stop();
-    ui->txt_loading->hide();
-    progressDialog.cancel(); // Close the progress dialog cleanly
-
-    // Temporary directory (`tempDir`) is automatically removed here when it goes out of scope.
-
-    QString summaryMessage;
-    if (cancelled) {
-         summaryMessage = QString("Operation Cancelled.\n\nProcessed: %1\nSuccessfully Trimmed: %2\nFailed/Skipped: %3")
-                             .arg(processedCount -1) // Don't count the one being processed when cancelled
-                             .arg(successCount)
-                             .arg(failCount);
-    } else {
-         summaryMessage = QString("Auto-Trim Complete.\n\nTotal Records: %1\nSuccessfully Trimmed: %2\nFailed/Skipped: %3")
-                             .arg(totalFiles)
-                             .arg(successCount)
-                             .arg(failCount);
-    }
-
-    qInfo() << "-------------------------------------";
-    qInfo() << summaryMessage.replace("\n\n", " | "); // Log summary concisely
-    qInfo() << "-------------------------------------";
-
-    QMessageBox::information(this, "Operation Summary", summaryMessage);
+    m_trimRewriting = false;
+    if (m_trackTrimmer->start(TrackTrimmer::Options()))
+        ui->statusBar->showMessage(tr("Finding silence in the library..."));
 }
 
 void player::on_actionUpdate_System_triggered()
@@ -8830,6 +8691,7 @@ void player::on_bt_apply_multi_selection_clicked()
        //name them in debugger
 
        QModelIndexList indexlist = ui->musicView->selectionModel()->selectedIndexes();
+       if (m_musicModel) m_musicModel->ensureLoaded(indexlist);
        int row;
        foreach(QModelIndex index, indexlist){
            if(index.row()!=row){
@@ -8865,6 +8727,7 @@ void player::on_bt_apply_multi_selection_clicked()
 
 
                        QModelIndexList indexlist = ui->musicView->selectionModel()->selectedIndexes();
+                       if (m_musicModel) m_musicModel->ensureLoaded(indexlist);
                        int row;
                        foreach(QModelIndex index, indexlist){
                            if(index.row()!=row){
@@ -8981,6 +8844,7 @@ void player::on_bt_apply_multi_selection_clicked()
 
        // --- Get Selected Files ---
        QModelIndexList selectedIndexes = ui->musicView->selectionModel()->selectedIndexes();
+       if (m_musicModel) m_musicModel->ensureLoaded(selectedIndexes);
        QSet<int> uniqueRows; // Use a QSet to get unique row numbers easily
        for (const QModelIndex &index : selectedIndexes) {
            uniqueRows.insert(index.row());
@@ -9228,6 +9092,7 @@ void player::on_bt_apply_multi_selection_clicked()
 
           // --- Get Selected Files ---
           QModelIndexList selectedIndexes = ui->musicView->selectionModel()->selectedIndexes();
+          if (m_musicModel) m_musicModel->ensureLoaded(selectedIndexes);
           QSet<int> uniqueRows; // Use a QSet to get unique row numbers easily
           for (const QModelIndex &index : selectedIndexes) {
               uniqueRows.insert(index.row());
@@ -9473,6 +9338,7 @@ void player::on_bt_apply_multi_selection_clicked()
               return;
           }
           QModelIndexList selectedIndexes = selectionModel->selectedIndexes();
+          if (m_musicModel) m_musicModel->ensureLoaded(selectedIndexes);
           QSet<int> uniqueRows; // Use a QSet to get unique row numbers easily
           for (const QModelIndex &index : selectedIndexes) {
               uniqueRows.insert(index.row());
@@ -9695,6 +9561,7 @@ void player::on_bt_apply_multi_selection_clicked()
               return;
           }
           QModelIndexList selectedIndexes = selectionModel->selectedIndexes();
+          if (m_musicModel) m_musicModel->ensureLoaded(selectedIndexes);
           QSet<int> uniqueRows; // Use a QSet to get unique row numbers easily
           for (const QModelIndex &index : selectedIndexes) {
               uniqueRows.insert(index.row());
@@ -9890,545 +9757,66 @@ void player::on_bt_apply_multi_selection_clicked()
 
 void player::on_actionConvert_all_musics_in_the_database_to_mp3_triggered()
 {
-    QSqlDatabase db = QSqlDatabase::database("xfb_connection"); // Or pass it in
-    if (!db.isOpen()) {
-        qWarning() << "Database connection 'xfb_connection' is not open!";
-        QMessageBox::critical(this, "Database Error", "Database connection is not open.");
-        return;
-    }
-
-    // --- Check for FFMPEG executable ---
-    QString ffmpegPath = FxEngine::ffmpegExecutable();
-    if (ffmpegPath.isEmpty()) {
-        qWarning() << "'ffmpeg' command not found in system PATH.";
-        QMessageBox::critical(this, "Missing Dependency",
-                              "The 'ffmpeg' command is required for audio conversion "
-                              "but was not found in the system's PATH.\n\nPlease install ffmpeg and ensure it's accessible.");
-        return;
-    }
-    qInfo() << "Found ffmpeg executable at:" << ffmpegPath;
-    // --- End FFMPEG check ---
-
-    // --- Confirmation ---
-    QMessageBox::StandardButton confirm = QMessageBox::question(this, "Confirm Full Conversion",
-                                     "Convert ALL tracks in the database to MP3 (192kbps)?\n\n"
-                                     "Original files will be replaced with the MP3 version.\n"
-                                     "This action cannot be undone and may take a very long time!\n\n"
-                                     "Note: Only the audio stream will be kept.",
-                                     QMessageBox::Yes | QMessageBox::No);
-
-    if (confirm == QMessageBox::No) {
-        return;
-    }
-
-    // --- Setup Loading Indicator & Progress Dialog ---
-    // Use stack variable for QMovie if its lifetime is limited to this function
-    QMovie loadingMovie(":/images/loading.gif");
-    if(!loadingMovie.isValid()){
-         qWarning() << "Loading GIF not valid:" << ":/images/loading.gif";
-         ui->txt_loading->setText("Processing..."); // Fallback text
-         ui->txt_loading->show();
-    } else {
-        ui->txt_loading->setMovie(&loadingMovie);
-        ui->txt_loading->setScaledContents(true);
-        ui->txt_loading->show();
-        loadingMovie.start();
-    }
-    qApp->processEvents(); // Allow UI to update
+    startLibraryTranscode("mp3");
+}
 
-    QProgressDialog progressDialog("Converting all tracks to MP3...", "Cancel", 0, 0, this);
-    progressDialog.setWindowModality(Qt::WindowModal);
-    progressDialog.setValue(0);
-    progressDialog.show();
-    qApp->processEvents();
-    // --- End Setup ---
+void player::on_actionConvert_all_musics_in_the_database_to_ogg_triggered()
+{
+    startLibraryTranscode("ogg");
+}
 
-    // --- Prepare Database Queries (outside loop) ---
-    QSqlQuery querySelect(db);
-    QSqlQuery queryUpdate(db);
-    QSqlQuery queryCount(db); // For counting total records
-
-    // Prepare UPDATE statement
-    if (!queryUpdate.prepare("UPDATE musics SET path = :new_path WHERE path = :old_path")) {
-        qWarning() << "Failed to prepare database UPDATE statement:" << queryUpdate.lastError();
-        QMessageBox::critical(this, "Database Error", "Failed to prepare database query for updating paths.");
-        loadingMovie.stop();
-        ui->txt_loading->hide();
-        progressDialog.cancel();
+void player::startLibraryTranscode(const QString &extension)
+{
+    if (!m_transcodeQueue)
         return;
-    }
 
-    // Count total files for progress bar
-    int totalFiles = 0;
-    if (queryCount.exec("SELECT COUNT(*) FROM musics")) {
-        if (queryCount.next()) {
-            totalFiles = queryCount.value(0).toInt();
-            progressDialog.setMaximum(totalFiles);
-        }
-    } else {
-        qWarning() << "Failed to count records:" << queryCount.lastError();
-        // Proceed without accurate progress max? Or abort? Let's proceed.
-        progressDialog.setMaximum(100); // Set an arbitrary max
-    }
-    qApp->processEvents();
-
-
-    // Select only the path
-    QString selectStr = "SELECT path FROM musics";
-    if (!querySelect.exec(selectStr)) {
-        qWarning() << "Failed to SELECT paths from musics:" << querySelect.lastError();
-        QMessageBox::critical(this, "Database Error", "Failed to query the musics table for paths.");
-        loadingMovie.stop();
-        ui->txt_loading->hide();
-        progressDialog.cancel();
-        return;
-    }
-
-    // --- Get Temporary Directory ---
-    QString tempDirPath = QStandardPaths::writableLocation(QStandardPaths::TempLocation);
-    if (tempDirPath.isEmpty()) {
-         qWarning() << "Could not find a writable temporary location.";
-         QMessageBox::critical(this, "File System Error", "Cannot find a suitable temporary directory for conversion.");
-         loadingMovie.stop();
-         ui->txt_loading->hide();
-         progressDialog.cancel();
-         return;
-    }
-    QDir tempDir(tempDirPath);
-    qInfo() << "Using temporary directory:" << tempDirPath;
-
-
-    // --- Process Files ---
-    int processedCount = 0;
-    int successCount = 0;
-    int failCount = 0;
-    bool cancelled = false;
-
-    while (querySelect.next() && !cancelled) {
-        processedCount++;
-        progressDialog.setValue(processedCount);
-        qApp->processEvents(); // Keep UI responsive and check for Cancel button
-
-        if (progressDialog.wasCanceled()) {
-            qInfo() << "User cancelled the operation.";
-            cancelled = true;
-            break;
-        }
-
-        QString originalPath = querySelect.value(0).toString();
-        QFileInfo originalFileInfo(originalPath);
-
-        progressDialog.setLabelText(QString("Converting [%1/%2]:\n%3")
-                                        .arg(processedCount)
-                                        .arg(totalFiles > 0 ? totalFiles : processedCount) // Show total if known
-                                        .arg(originalFileInfo.fileName()));
-        qApp->processEvents();
-
-        qInfo().noquote() << "Processing [" << processedCount << "/" << (totalFiles > 0 ? QString::number(totalFiles): "?") << "]:" << originalPath;
-
-        if (!originalFileInfo.exists() || !originalFileInfo.isFile()) {
-            qWarning() << "Original file does not exist or is not a file:" << originalPath;
-            failCount++;
-            continue; // Skip to next file
-        }
-
-        // --- Prepare Paths ---
-        QString baseName = originalFileInfo.baseName(); // Name without extension
-        QString originalDir = originalFileInfo.absolutePath(); // Directory of original file
-        QString tempMp3Path = tempDir.filePath(baseName + ".mp3"); // Full path for temporary MP3
-        QString finalMp3Path = QDir(originalDir).filePath(baseName + ".mp3"); // Final path for MP3 in original dir
-
-        // --- Run FFMPEG ---
-        QProcess ffmpegProcess;
-        QStringList ffmpegArgs;
-        ffmpegArgs << "-i" << originalPath // Input file
-                   << "-vn"               // No video output
-                   << "-ar" << "44100"    // Audio sample rate
-                   << "-ac" << "2"        // Audio channels (stereo)
-                   << "-b:a" << "192k"    // Audio bitrate (use -b:a)
-                   << "-f" << "mp3"       // Force output format (optional)
-                   << tempMp3Path;        // Output file path
-
-        qDebug() << "Running command:" << ffmpegPath << ffmpegArgs;
-
-        ffmpegProcess.start(ffmpegPath, ffmpegArgs);
-
-        // Wait for ffmpeg (e.g., 10 min timeout)
-        if (!ffmpegProcess.waitForFinished(600000)) {
-            qWarning() << "ffmpeg process timed out for:" << originalPath << ffmpegProcess.errorString();
-            ffmpegProcess.kill();
-            ffmpegProcess.waitForFinished(1000);
-            QFile::remove(tempMp3Path); // Clean up incomplete temp file
-            failCount++;
-            continue;
-        }
-
-        // Check ffmpeg result
-        if (ffmpegProcess.exitStatus() != QProcess::NormalExit || ffmpegProcess.exitCode() != 0) {
-            qWarning() << "ffmpeg process failed for:" << originalPath
-                       << "Exit code:" << ffmpegProcess.exitCode()
-                       << "Exit status:" << ffmpegProcess.exitStatus();
-            QString errorOutput = QString::fromLocal8Bit(ffmpegProcess.readAllStandardError());
-            qWarning() << "ffmpeg Standard Error:\n" << errorOutput;
-             QFile::remove(tempMp3Path); // Clean up potentially failed temp file
-            failCount++;
-            continue;
-        }
-
-        // Check if temp MP3 exists and has size
-         QFileInfo tempMp3Info(tempMp3Path);
-         if (!tempMp3Info.exists() || tempMp3Info.size() == 0) {
-             qWarning() << "ffmpeg finished successfully but the output MP3 file is missing or empty:" << tempMp3Path;
-             QFile::remove(tempMp3Path);
-             failCount++;
-             continue;
-         }
-
-        qInfo() << "ffmpeg conversion successful for:" << originalPath << " -> " << tempMp3Path;
-
-        // --- Delete Original File ---
-        qInfo() << "Attempting to delete original file:" << originalPath;
-        if (!QFile::remove(originalPath)) {
-            qWarning() << "Failed to delete original file:" << originalPath << ". Skipping move and database update.";
-            failCount++;
-            continue; // Skip rest of steps for this file
-        }
-        qInfo() << "Original file deleted successfully.";
-
-        // --- Move Temporary MP3 to Final Location ---
-        qInfo() << "Attempting to move" << tempMp3Path << "to" << finalMp3Path;
-        if (!QFile::rename(tempMp3Path, finalMp3Path)) {
-            qWarning() << "Failed to move temporary MP3" << tempMp3Path << "to" << finalMp3Path << ". The original file was deleted! MP3 remains in temp folder.";
-            QMessageBox::warning(this, "Move Failed",
-                                 QString("Failed to move the converted MP3 to its final destination:\n%1\n\n"
-                                         "The original file was deleted, but the MP3 remains in the temporary folder:\n%2\n\n"
-                                         "Please move it manually and check the database record.")
-                                     .arg(finalMp3Path).arg(tempMp3Path));
-            failCount++;
-            continue; // Cannot update DB path if move failed
-        }
-        qInfo() << "MP3 moved successfully to:" << finalMp3Path;
-
-        // --- Update Database ---
-        qInfo() << "Updating database: set path =" << finalMp3Path << "where path =" << originalPath;
-        queryUpdate.bindValue(":new_path", finalMp3Path);
-        queryUpdate.bindValue(":old_path", originalPath);
-
-        if (!queryUpdate.exec()) {
-            qWarning() << "Failed to update database path for:" << originalPath << "->" << finalMp3Path;
-            qWarning() << "DB Error:" << queryUpdate.lastError().text();
-            qWarning() << "Last Query (Bound values might not show):" << queryUpdate.lastQuery();
-            QMessageBox::warning(this, "Database Update Failed",
-                                 QString("The file was successfully converted and moved to:\n%1\n\n"
-                                         "However, updating the database record failed:\n%2\n\n"
-                                         "Please check the database manually.")
-                                     .arg(finalMp3Path).arg(queryUpdate.lastError().text()));
-            failCount++; // Count as failure since DB update is critical
-        } else {
-            qInfo() << "Database path updated successfully.";
-            successCount++;
-            // update_music_table(); // Update only once at the end
-        }
-
-    } // End while loop
-
-    // --- Final Cleanup & Summary ---
-    loadingMovie.stop();
-    ui->txt_loading->hide();
-    progressDialog.cancel(); // Close progress dialog
-
-    update_music_table(); // Update the table view once after all operations
-
-    QString summaryMessage;
-    if (cancelled) {
-        summaryMessage = QString("Operation Cancelled.\n\nProcessed: %1\nSuccessfully Converted: %2\nFailed/Skipped: %3")
-                             .arg(processedCount -1) // Don't count the one being processed when cancelled
-                             .arg(successCount)
-                             .arg(failCount);
-    } else {
-        summaryMessage = QString("MP3 Conversion Complete.\n\nTotal Records: %1\nSuccessfully Converted: %2\nFailed/Skipped: %3")
-                             .arg(totalFiles) // Use the count obtained earlier
-                             .arg(successCount)
-                             .arg(failCount);
-    }
-
-    qInfo() << "-------------------------------------";
-    qInfo() << summaryMessage.replace("\n\n", " | "); // Log summary concisely
-    qInfo() << "-------------------------------------";
-
-    QMessageBox::information(this, "Conversion Summary", summaryMessage);
-}
-void player::on_actionConvert_all_musics_in_the_database_to_ogg_triggered()
-{
-    QSqlDatabase db = QSqlDatabase::database("xfb_connection"); // Or pass it in
-    if (!db.isOpen()) {
-        qWarning() << "Database connection 'xfb_connection' is not open!";
-        QMessageBox::critical(this, "Database Error", "Database connection is not open.");
+    // Asking again while a conversion runs offers to stop it
+    if (m_transcodeQueue->isRunning()) {
+        if (QMessageBox::question(this, tr("Library conversion"),
+                                  tr("The library is being converted. Stop now?\n\n"
+                                     "Files not converted yet stay queued for the next start."),
+                                  QMessageBox::Yes | QMessageBox::No) == QMessageBox::Yes)
+            m_transcodeQueue->cancel();
         return;
     }
 
     // --- Check for FFMPEG executable ---
-    QString ffmpegPath = FxEngine::ffmpegExecutable();
-    if (ffmpegPath.isEmpty()) {
+    if (FxEngine::ffmpegExecutable().isEmpty()) {
         qWarning() << "'ffmpeg' command not found in system PATH.";
         QMessageBox::critical(this, "Missing Dependency",
                               "The 'ffmpeg' command is required for audio conversion "
                               "but was not found in the system's PATH.\n\nPlease install ffmpeg and ensure it's accessible.");
         return;
     }
-    qInfo() << "Found ffmpeg executable at:" << ffmpegPath;
-    // --- End FFMPEG check ---
-
-    // --- Confirmation ---
-    // Updated confirmation message for Ogg
-    QMessageBox::StandardButton confirm = QMessageBox::question(this, "Confirm Full Conversion",
-                                     "Convert ALL tracks in the database to Ogg Vorbis (Quality ~7)?\n\n"
-                                     "Original files will be replaced with the Ogg version.\n"
-                                     "This action cannot be undone and may take a very long time!\n\n"
-                                     "Note: Only the audio stream will be kept.",
-                                     QMessageBox::Yes | QMessageBox::No);
-
-    if (confirm == QMessageBox::No) {
-        return;
-    }
-
-    // --- Setup Loading Indicator & Progress Dialog ---
-    QMovie loadingMovie(":/images/loading.gif");
-    if(!loadingMovie.isValid()){
-         qWarning() << "Loading GIF not valid:" << ":/images/loading.gif";
-         ui->txt_loading->setText("Processing..."); // Fallback text
-         ui->txt_loading->show();
-    } else {
-        ui->txt_loading->setMovie(&loadingMovie);
-        ui->txt_loading->setScaledContents(true);
-        ui->txt_loading->show();
-        loadingMovie.start();
-    }
-    qApp->processEvents(); // Allow UI to update
-
-    // Updated progress dialog title
-    QProgressDialog progressDialog("Converting all tracks to Ogg Vorbis...", "Cancel", 0, 0, this);
-    progressDialog.setWindowModality(Qt::WindowModal);
-    progressDialog.setValue(0);
-    progressDialog.show();
-    qApp->processEvents();
-    // --- End Setup ---
-
-    // --- Prepare Database Queries (outside loop) ---
-    QSqlQuery querySelect(db);
-    QSqlQuery queryUpdate(db);
-    QSqlQuery queryCount(db); // For counting total records
-
-    // Prepare UPDATE statement
-    if (!queryUpdate.prepare("UPDATE musics SET path = :new_path WHERE path = :old_path")) {
-        qWarning() << "Failed to prepare database UPDATE statement:" << queryUpdate.lastError();
-        QMessageBox::critical(this, "Database Error", "Failed to prepare database query for updating paths.");
-        loadingMovie.stop();
-        ui->txt_loading->hide();
-        progressDialog.cancel();
-        return;
-    }
-
-    // Count total files for progress bar
-    int totalFiles = 0;
-    if (queryCount.exec("SELECT COUNT(*) FROM musics")) {
-        if (queryCount.next()) {
-            totalFiles = queryCount.value(0).toInt();
-            progressDialog.setMaximum(totalFiles);
-        }
-    } else {
-        qWarning() << "Failed to count records:" << queryCount.lastError();
-        progressDialog.setMaximum(100); // Set an arbitrary max
-    }
-    qApp->processEvents();
-
-
-    // Select only the path
-    QString selectStr = "SELECT path FROM musics";
-    if (!querySelect.exec(selectStr)) {
-        qWarning() << "Failed to SELECT paths from musics:" << querySelect.lastError();
-        QMessageBox::critical(this, "Database Error", "Failed to query the musics table for paths.");
-        loadingMovie.stop();
-        ui->txt_loading->hide();
-        progressDialog.cancel();
-        return;
-    }
-
-    // --- Get Temporary Directory ---
-    QString tempDirPath = QStandardPaths::writableLocation(QStandardPaths::TempLocation);
-    if (tempDirPath.isEmpty()) {
-         qWarning() << "Could not find a writable temporary location.";
-         QMessageBox::critical(this, "File System Error", "Cannot find a suitable temporary directory for conversion.");
-         loadingMovie.stop();
-         ui->txt_loading->hide();
-         progressDialog.cancel();
-         return;
-    }
-    QDir tempDir(tempDirPath);
-    qInfo() << "Using temporary directory:" << tempDirPath;
-
-
-    // --- Process Files ---
-    int processedCount = 0;
-    int successCount = 0;
-    int failCount = 0;
-    bool cancelled = false;
-
-    while (querySelect.next() && !cancelled) {
-        processedCount++;
-        progressDialog.setValue(processedCount);
-        qApp->processEvents(); // Keep UI responsive and check for Cancel button
-
-        if (progressDialog.wasCanceled()) {
-            qInfo() << "User cancelled the operation.";
-            cancelled = true;
-            break;
-        }
-
-        QString originalPath = querySelect.value(0).toString();
-        QFileInfo originalFileInfo(originalPath);
-
-        // Updated progress label
-        progressDialog.setLabelText(QString("Converting [%1/%2]:\n%3")
-                                        .arg(processedCount)
-                                        .arg(totalFiles > 0 ? totalFiles : processedCount) // Show total if known
-                                        .arg(originalFileInfo.fileName()));
-        qApp->processEvents();
-
-        qInfo().noquote() << "Processing [" << processedCount << "/" << (totalFiles > 0 ? QString::number(totalFiles): "?") << "]:" << originalPath;
-
-        if (!originalFileInfo.exists() || !originalFileInfo.isFile()) {
-            qWarning() << "Original file does not exist or is not a file:" << originalPath;
-            failCount++;
-            continue; // Skip to next file
-        }
-
-        // --- Prepare Paths ---
-        QString baseName = originalFileInfo.baseName(); // Name without extension
-        QString originalDir = originalFileInfo.absolutePath(); // Directory of original file
-        // Ogg paths
-        QString tempOggPath = tempDir.filePath(baseName + ".ogg"); // Full path for temporary Ogg
-        QString finalOggPath = QDir(originalDir).filePath(baseName + ".ogg"); // Final path for Ogg in original dir
-
-        // --- Run FFMPEG ---
-        QProcess ffmpegProcess;
-        QStringList ffmpegArgs;
-        // Args for Ogg Vorbis
-        ffmpegArgs << "-i" << originalPath           // Input file
-                   << "-c:a" << "libvorbis"        // Audio codec: libvorbis
-                   << "-qscale:a" << "7"           // Quality scale (adjust as needed)
-                   << tempOggPath;                 // Output file path
-
-        qDebug() << "Running command:" << ffmpegPath << ffmpegArgs;
-
-        ffmpegProcess.start(ffmpegPath, ffmpegArgs);
-
-        // Wait for ffmpeg (e.g., 10 min timeout)
-        if (!ffmpegProcess.waitForFinished(600000)) {
-            qWarning() << "ffmpeg process timed out for:" << originalPath << ffmpegProcess.errorString();
-            ffmpegProcess.kill();
-            ffmpegProcess.waitForFinished(1000);
-            QFile::remove(tempOggPath); // Clean up incomplete temp file
-            failCount++;
-            continue;
-        }
 
-        // Check ffmpeg result
-        if (ffmpegProcess.exitStatus() != QProcess::NormalExit || ffmpegProcess.exitCode() != 0) {
-            qWarning() << "ffmpeg process failed for:" << originalPath
-                       << "Exit code:" << ffmpegProcess.exitCode()
-                       << "Exit status:" << ffmpegProcess.exitStatus();
-            QString errorOutput = QString::fromLocal8Bit(ffmpegProcess.readAllStandardError());
-            qWarning() << "ffmpeg Standard Error:\n" << errorOutput;
-             QFile::remove(tempOggPath); // Clean up potentially failed temp file
-            failCount++;
-            continue;
-        }
-
-        // Check if temp Ogg exists and has size
-         QFileInfo tempOggInfo(tempOggPath);
-         if (!tempOggInfo.exists() || tempOggInfo.size() == 0) {
-             qWarning() << "ffmpeg finished successfully but the output Ogg file is missing or empty:" << tempOggPath;
-             QFile::remove(tempOggPath);
-             failCount++;
-             continue;
-         }
-
-        qInfo() << "ffmpeg conversion successful for:" << originalPath << " -> " << tempOggPath;
-
-        // --- Delete Original File ---
-        qInfo() << "Attempting to delete original file:" << originalPath;
-        if (!QFile::remove(originalPath)) {
-            qWarning() << "Failed to delete original file:" << originalPath << ". Skipping move and database update.";
-            failCount++;
-            continue; // Skip rest of steps for this file
-        }
-        qInfo() << "Original file deleted successfully.";
-
-        // --- Move Temporary Ogg to Final Location ---
-        qInfo() << "Attempting to move" << tempOggPath << "to" << finalOggPath;
-        if (!QFile::rename(tempOggPath, finalOggPath)) {
-            qWarning() << "Failed to move temporary Ogg" << tempOggPath << "to" << finalOggPath << ". The original file was deleted! Ogg remains in temp folder.";
-            QMessageBox::warning(this, "Move Failed",
-                                 QString("Failed to move the converted Ogg file to its final destination:\n%1\n\n"
-                                         "The original file was deleted, but the Ogg file remains in the temporary folder:\n%2\n\n"
-                                         "Please move it manually and check the database record.")
-                                     .arg(finalOggPath).arg(tempOggPath));
-            failCount++;
-            continue; // Cannot update DB path if move failed
-        }
-        qInfo() << "Ogg file moved successfully to:" << finalOggPath;
-
-        // --- Update Database ---
-        qInfo() << "Updating database: set path =" << finalOggPath << "where path =" << originalPath;
-        queryUpdate.bindValue(":new_path", finalOggPath);
-        queryUpdate.bindValue(":old_path", originalPath);
-
-        if (!queryUpdate.exec()) {
-            qWarning() << "Failed to update database path for:" << originalPath << "->" << finalOggPath;
-            qWarning() << "DB Error:" << queryUpdate.lastError().text();
-            qWarning() << "Last Query (Bound values might not show):" << queryUpdate.lastQuery();
-            QMessageBox::warning(this, "Database Update Failed",
-                                 QString("The file was successfully converted and moved to:\n%1\n\n"
-                                         "However, updating the database record failed:\n%2\n\n"
-                                         "Please check the database manually.")
-                                     .arg(finalOggPath).arg(queryUpdate.lastError().text()));
-            failCount++; // Count as failure since DB update is critical
-        } else {
-            qInfo() << "Database path updated successfully.";
-            successCount++;
-            // update_music_table(); // Update only once at the end
-        }
-
-    } // End while loop
-
-    // --- Final Cleanup & Summary ---
-    loadingMovie.stop();
-    ui->txt_loading->hide();
-    progressDialog.cancel(); // Close progress dialog
-
-    update_music_table(); // Update the table view once after all operations
-
-    // Updated summary message
-    QString summaryMessage;
-    if (cancelled) {
-        summaryMessage = QString("Operation Cancelled.\n\nProcessed: %1\nSuccessfully Converted to Ogg: %2\nFailed/Skipped: %3")
-                             .arg(processedCount -1)
-                             .arg(successCount)
-                             .arg(failCount);
+    TranscodeQueue::Options options;
+    if (extension.isEmpty()) {
+        const int left = TranscodeQueue::unfinishedJobs(m_libraryDb);
+        if (QMessageBox::question(this, tr("Resume Conversion"),
+                                  tr("A library conversion was interrupted with %1 files left.\n\n"
+                                     "Resume it now?").arg(left),
+                                  QMessageBox::Yes | QMessageBox::No) != QMessageBox::Yes)
+            return;
     } else {
-        summaryMessage = QString("Ogg Conversion Complete.\n\nTotal Records: %1\nSuccessfully Converted: %2\nFailed/Skipped: %3")
-                             .arg(totalFiles) // Use the count obtained earlier
-                             .arg(successCount)
-                             .arg(failCount);
+        options.enqueueLibrary = true;
+        options.format = extension == "ogg" ? TranscodeQueue::Format::Ogg : TranscodeQueue::Format::Mp3;
+        const QString target = options.format == TranscodeQueue::Format::Ogg ? tr("Ogg Vorbis (Quality ~7)")
+                                                                             : tr("MP3 (192kbps)");
+        if (QMessageBox::question(this, tr("Confirm Full Conversion"),
+                                  tr("Convert ALL tracks in the database to %1?\n\n"
+                                     "Original files will be replaced with the converted version.\n"
+                                     "This action cannot be undone. It runs in the background and "
+                                     "carries on after a restart; choose it again to stop it.\n\n"
+                                     "Note: Only the audio stream will be kept. Tracks already in "
+                                     "that format are left as they are.").arg(target),
+                                  QMessageBox::Yes | QMessageBox::No) != QMessageBox::Yes)
+            return;
     }
 
-    qInfo() << "-------------------------------------";
-    qInfo() << summaryMessage.replace("\n\n", " | "); // Log summary concisely
-    qInfo() << "-------------------------------------";
-
-    QMessageBox::information(this, "Conversion Summary", summaryMessage);
+    if (m_transcodeQueue->start(options))
+        ui->statusBar->showMessage(tr("Converting the library..."));
 }
+
 void player::on_bt_start_streaming_clicked()
 {
     qDebug()<<"Starting the streaming!";
@@ -10493,6 +9881,10 @@ void player::on_bt_stop_streaming_clicked()
 
 
     // --- Stop Butt ---
+    if (m_streamSource) {
+        m_streamSource->stop();
+        buttrunning = false;
+    }
     QProcess killer_butt;
     QString butt_cmd;
     QStringList butt_args;
@@ -10537,6 +9929,29 @@ void player::on_bt_stop_streaming_clicked()
 
     piscaLive = false; // Assuming piscaLive is a member variable bool
 }
+void player::updateStreamSourceStatus()
+{
+    // Stopping resets the label itself; late mount updates are ignored
+    if (!m_streamSource || !m_streamSource->isRunning())
+        return;
+
+    const int total = m_streamMountsUp.size();
+    const int up = static_cast<int>(std::count(m_streamMountsUp.cbegin(), m_streamMountsUp.cend(), true));
+    if (total > 0 && up == total) {
+        ui->lbl_butt->setText("Running");
+        ui->lbl_butt->setStyleSheet("color:green;");
+        ui->lbl_butt->setToolTip(QString());
+    } else if (up > 0) {
+        ui->lbl_butt->setText(QString("Running %1/%2").arg(up).arg(total));
+        ui->lbl_butt->setStyleSheet("color:orange;");
+        ui->lbl_butt->setToolTip(m_streamLastError);
+    } else {
+        ui->lbl_butt->setText(m_streamLastError.isEmpty() ? "Connecting..." : "Reconnecting...");
+        ui->lbl_butt->setStyleSheet(m_streamLastError.isEmpty() ? "color:orange;" : "color:red;");
+        ui->lbl_butt->setToolTip(m_streamLastError);
+    }
+}
+
 void player::streaming_timmer(){
 
     qDebug()<<"Running streaming_timmer (checking external processes...)";
@@ -10615,7 +10030,9 @@ void player::streaming_timmer(){
      }
 
     // Update Butt UI
-    if(butt_running){
+    if (m_streamSource) {
+        // Reported by updateStreamSourceStatus()
+    } else if(butt_running){
         ui->lbl_butt->setText("Running");
         ui->lbl_butt->setStyleSheet("color:green;");
     } else {
@@ -10735,22 +10152,7 @@ void player::on_bt_center_lps_vol_clicked()
 
 void player::on_txt_search_returnPressed()
 {
-    //search
-    qDebug()<<"Staring a new search!";
-    QString term = ui->txt_search->text();
-
-    QSqlQueryModel *model = new QSqlQueryModel();
-    QSqlQuery searchQuery(QSqlDatabase::database("xfb_connection"));
-    searchQuery.prepare("select * from musics where artist like :t1 or song like :t2");
-    searchQuery.bindValue(":t1", "%" + term + "%");
-    searchQuery.bindValue(":t2", "%" + term + "%");
-    searchQuery.exec();
-    model->setQuery(std::move(searchQuery));
-    ui->musicView->setModel(model);
-
-    ui->musicView->setSortingEnabled(true);
-    ui->musicView->hideColumn(0);
-    ui->musicView->setSizePolicy(QSizePolicy::Expanding,QSizePolicy::Expanding);
+    applyLibrarySearch();
 }
 
 void player::on_actionForce_monitorization_triggered()
@@ -11107,7 +10509,16 @@ void player::on_bt_butt_clicked()
     // Determine the intended state
     bool shouldBeRunning = !buttrunning;
 
-    if (shouldBeRunning) {
+    if (shouldBeRunning && m_streamSource) {
+        qInfo() << "Starting the stream source...";
+        m_streamMountsUp.clear();
+        m_streamLastError.clear();
+        m_streamSource->start(StreamSource::loadMounts());
+        buttrunning = true;
+        ui->lbl_butt->setText("Connecting...");
+        ui->lbl_butt->setStyleSheet("color:orange;");
+        ui->bt_butt->setStyleSheet("background-color:#C8EE72;");
+    } else if (shouldBeRunning) {
         // --- Try to START Butt ---
         qInfo() << "Attempting to start Butt...";
 
@@ -11178,7 +10589,11 @@ void player::on_bt_butt_clicked()
         }
 
         // 2. Kill the 'butt' process (FIXED: was killing icecast in original code)
-        bool killed = killProcessByName("butt");
+        bool killed = true;
+        if (m_streamSource)
+            m_streamSource->stop();
+        else
+            killed = killProcessByName("butt");
 
         // 3. Update state and UI regardless of kill success
         buttrunning = false;
@@ -11206,6 +10621,9 @@ void player::on_bt_butt_clicked()
 // --- Refactored butt_timmer ---
 
 void player::butt_timmer() {
+    // The stream source reports its state itself (updateStreamSourceStatus)
+    if (m_streamSource)
+        return;
     qDebug() << "Running butt_timmer (checking butt process status...)";
 
     QProcess check_butt;
@@ -12080,13 +11498,13 @@ void player::on_bt_pause_rec_clicked()
         recPause=true;
         ui->bt_pause_rec->setStyleSheet("background-color:yellow");
 
-        audioRecorder->pause();
+        m_programRecorder->setPaused(true);
         recTimer->stop();
 
     } else {
         recPause=false;
         ui->bt_pause_rec->setStyleSheet("");
-        audioRecorder->record();
+        m_programRecorder->setPaused(false);
         recTimer->start();
     }
 
@@ -12100,12 +11518,16 @@ void player::on_bt_pause_play_clicked()
         ui->bt_pause_play->setStyleSheet("background-color:yellow");
 
         Xplayer->pause();
+        if (m_playLog)
+            m_playLog->paused(PlayLog::mainDeck());
 
 
     } else {
         playPause=false;
         ui->bt_pause_play->setStyleSheet("");
         Xplayer->play();
+        if (m_playLog)
+            m_playLog->resumed(PlayLog::mainDeck());
 
     }
 }
@@ -13015,6 +12437,59 @@ void player::convertAllMusicsTo432()
     convertMusicsTo432(paths);
 }
 
+void player::exportPlayLog()
+{
+    QSqlDatabase db = QSqlDatabase::database("xfb_connection");
+    if (!db.isOpen()) {
+        QMessageBox::critical(this, tr("Database Error"), tr("Database connection is not open."));
+        return;
+    }
+
+    // Period, last month by default; both days included
+    QDialog dialog(this);
+    dialog.setWindowTitle(tr("Export the play history"));
+    auto *layout = new QFormLayout(&dialog);
+    auto *fromEdit = new QDateEdit(QDate::currentDate().addMonths(-1), &dialog);
+    auto *toEdit = new QDateEdit(QDate::currentDate(), &dialog);
+    fromEdit->setCalendarPopup(true);
+    toEdit->setCalendarPopup(true);
+    layout->addRow(tr("From:"), fromEdit);
+    layout->addRow(tr("To:"), toEdit);
+    auto *buttons = new QDialogButtonBox(QDialogButtonBox::Ok | QDialogButtonBox::Cancel, &dialog);
+    layout->addRow(buttons);
+    connect(buttons, &QDialogButtonBox::accepted, &dialog, &QDialog::accept);
+    connect(buttons, &QDialogButtonBox::rejected, &dialog, &QDialog::reject);
+    if (dialog.exec() != QDialog::Accepted)
+        return;
+
+    const QString fileName = QFileDialog::getSaveFileName(this, tr("Export the play history"),
+        QString("plays-%1-%2.csv").arg(fromEdit->date().toString("yyyyMMdd"), toEdit->date().toString("yyyyMMdd")),
+        tr("CSV files (*.csv)"));
+    if (fileName.isEmpty())
+        return;
+
+    QFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        QMessageBox::critical(this, tr("Export Error"), tr("Could not create %1: %2").arg(fileName, file.errorString()));
+        return;
+    }
+
+    // Plays still queued for the writer belong in the report
+    if (m_databaseAccess)
+        m_databaseAccess->flush(5000);
+
+    QApplication::setOverrideCursor(Qt::WaitCursor);
+    QString error;
+    const qint64 rows = PlayLog::exportCsv(db, &file, fromEdit->date().startOfDay(),
+                                           toEdit->date().addDays(1).startOfDay(), &error);
+    QApplication::restoreOverrideCursor();
+
+    if (rows < 0)
+        QMessageBox::critical(this, tr("Export Error"), tr("Could not export the play history: %1").arg(error));
+    else
+        ui->statusBar->showMessage(tr("Exported %1 plays to %2").arg(rows).arg(fileName), 5000);
+}
+
 void player::convertMusicsTo432(const QStringList &paths)
 {
     if (paths.isEmpty()) {
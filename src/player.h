@@ -3,15 +3,13 @@
 
 #include <QMainWindow>
 #include <QMediaPlayer>
-#include <QMediaRecorder>
 #include <QMediaFormat>
-#include <QMediaCaptureSession>
 #include <QAudioOutput>
-#include <QAudioInput>
 #include <QSqlDatabase>
 #include <QUrl>
 #include <QTimer>
 #include <QElapsedTimer>
+#include <QHash>
 #include <QMutex>
 #include <QMutexLocker>
 #include <QPixmap>
@@ -49,13 +47,27 @@ class NgrokTunnelService;
 class UpdateCheckService;
 class AudioFxWidget;
 class WaveformStore;
+class TrackAnalysisStore;
 class PlaylistWaveView;
 class NowPlayingWaveStrip;
 class LevelMeter;
 class ArtworkStore;
 class NowPlayingArtPanel;
+class MusicRepository;
+class MusicListModel;
+class LibraryRescanner;
+class TranscodeQueue;
+class TrackTrimmer;
+class DatabaseAccess;
+class SchedulerEngine;
+class RotationEngine;
+class PlayLog;
+class StreamSource;
+class ProgramRecorder;
+class DatabaseOptimizer;
 
 #include "services/TorrentTypes.h"
+#include "audio/FxMixer.h"
 #include "audio/FxPlayer.h"
 
 namespace Ui {
@@ -82,9 +94,6 @@ public:
     QSqlDatabase adb;
     QString saveFile;
     QTimer *recTimer = nullptr;
-    int recSecs = 0;
-    int recMins = 0;
-    int recHours = 0;
     int server_this_day_of_the_week = 0;
     QString lp1_total_time;
     int lp1_total_time_int = 0;
@@ -156,7 +165,7 @@ private slots:
     void on_actionManage_Genres_triggered();
     void on_actionAdd_Jingle_triggered();
     void on_actionAdd_a_publicity_triggered();
-    void run_scheduler();
+    void run_scheduler(int targetId, bool isProgram, bool once);
     void on_actionOptions_triggered();
     void on_actionAbout_triggered();
     void on_actionAdd_a_song_from_Youtube_or_Other_triggered();
@@ -181,6 +190,8 @@ private slots:
     void on_actionForce_an_FTP_Check_triggered();
     void on_actionMake_a_program_from_this_playlist_triggered();
     void on_actionCheck_the_Database_records_triggered();
+    void on_actionRescan_the_library_triggered();
+    void on_actionWatch_the_music_folders_toggled(bool checked);
     void calculate_playlist_total_time();
     void RectimerDone();
     void RecT5();
@@ -190,6 +201,7 @@ private slots:
     void RecT1();
     void RecCHK();
     void on_actionCheck_Database_Data_and_DELETE_all_invalid_records_witouth_confirmation_triggered();
+    void on_actionApply_the_recommended_library_indexes_triggered();
     void on_bt_rol_streaming_play_clicked();
     void on_bt_rol_streaming_stop_clicked();
     void on_lp_1_bt_play_clicked();
@@ -296,6 +308,9 @@ private slots:
     void convertAllMusicsTo432();
     void convertMusicsTo432(const QStringList &paths);
 
+    // Play history report
+    void exportPlayLog();
+
     // Streaming client (listen to a network stream)
     void startRadioStream(const QUrl &streamUrl);
     void resolveAndPlayStreamPlaylist(const QUrl &playlistUrl);
@@ -333,10 +348,8 @@ private slots:
     QAudioOutput *lp1_XplayerOutput = nullptr;
     QAudioOutput *lp2_XplayerOutput = nullptr;
 
-    // Media recording
-    QMediaCaptureSession *captureSession = nullptr;
-    QMediaRecorder *audioRecorder = nullptr;
-    QAudioInput *audioInput = nullptr;
+    // Program recording: capture, encode and segment off the GUI thread
+    ProgramRecorder *m_programRecorder = nullptr;
 
     // Ad banner
     QQuickWidget *adBanner = nullptr;
@@ -411,6 +424,7 @@ private slots:
     QString recDeviceDesc;
     QMediaFormat::AudioCodec recCodec = QMediaFormat::AudioCodec::Unspecified;
     QMediaFormat::FileFormat recContainer = QMediaFormat::FileFormat();
+    int recSegmentMinutes = 5;
     QNetworkAccessManager *networkManager = nullptr;
     
     // Torrent services
@@ -422,6 +436,42 @@ private slots:
     // ngrok tunnel for the public streaming link
     NgrokTunnelService *m_ngrokService = nullptr;
 
+    // Music library view: a virtualized model paging musics on its own
+    // worker connection, so ui->musicView stays responsive on huge libraries
+    QSqlDatabase m_libraryDb;
+    MusicRepository *m_musicRepository = nullptr;
+    MusicListModel *m_musicModel = nullptr;
+    QTimer *m_searchTypingTimer = nullptr; // search-as-you-type debounce
+    void applyLibrarySearch();
+
+    // Incremental resync of musics with the library folders, by hand or
+    // continuously while the folders are watched
+    LibraryRescanner *m_libraryRescanner = nullptr;
+    bool m_rescanInteractive = false;
+    bool startLibraryRescan(bool watch);
+    TranscodeQueue *m_transcodeQueue = nullptr;
+    void startLibraryTranscode(const QString &extension); // empty: resume the queue
+    TrackTrimmer *m_trackTrimmer = nullptr;
+    bool m_trimRewriting = false;  // the running or last trim rewrites files
+
+    // Serialized background writer for the library database; on-air
+    // updates queue here instead of waiting out an import's write lock
+    DatabaseAccess *m_databaseAccess = nullptr;
+
+    // Fires scheduler table rules at their time (Server role)
+    SchedulerEngine *m_scheduler = nullptr;
+
+    // Auto mode's precomputed per-genre rotations
+    RotationEngine *m_rotation = nullptr;
+
+    // Per-play history (play_log), written through m_databaseAccess
+    PlayLog *m_playLog = nullptr;
+
+    // Times library statements and recommends indexes for the slow ones
+    // that scan a table; the operator applies them
+    DatabaseOptimizer *m_databaseOptimizer = nullptr;
+    QStringList recommendedLibraryIndexes() const;
+
     // Update notifications
     UpdateCheckService *m_updateService = nullptr;
     bool m_updateCheckManual = false;
@@ -439,6 +489,8 @@ private slots:
     QToolButton *m_waveViewToggle = nullptr;
     // Wave + volume line of the track on air (its playlist item is gone)
     NowPlayingWaveStrip *m_nowPlayingWave = nullptr;
+    // Loudness / cue-point analysis of playlist tracks (read by the FX engine)
+    TrackAnalysisStore *m_analysisStore = nullptr;
     // "Max overlap" control: how early the next track can be dragged to
     // start (tracks with long silent tails need more than the default)
     QWidget *m_maxOverlapBox = nullptr;
@@ -456,6 +508,14 @@ private slots:
     // the main playback state machine never notices the difference.
     FxPlayer *m_tailPlayer = nullptr;
     QAudioOutput *m_tailOutput = nullptr;
+    // Shared output the on-air decks mix into (Fx/SharedOutput)
+    FxMixer *m_mixer = nullptr;
+    // In-process Icecast/Shoutcast source, replaces butt when mounts are
+    // configured ([Streaming] Mounts); per mount: connected or not
+    StreamSource *m_streamSource = nullptr;
+    QHash<QString, bool> m_streamMountsUp;
+    QString m_streamLastError;
+    void updateStreamSourceStatus();
     QVariantAnimation *m_tailFade = nullptr;
     bool m_overlapSegueFired = false;
     // Gapless: the next playlist item was handed to Xplayer->prepareNext()
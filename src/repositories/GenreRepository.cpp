@@ -1,4 +1,5 @@
 #include "GenreRepository.h"
+#include "../services/QueryProfiler.h"
 #include <QSqlQuery>
 #include <QSqlError>
 #include <QVariant>
@@ -386,7 +387,7 @@ int GenreRepository::addGenreBatch(const QList<GenreItem>& genreList)
             
             query.addBindValue(sanitizeName(genre.name));
             
-            if (query.exec()) {
+            if (QueryProfiler::exec(query)) {
                 successCount++;
                 
                 // Emit signal for each added item
@@ -429,7 +430,7 @@ bool GenreRepository::genreExists(const QString& name, int genreType)
     query.prepare(queryString);
     query.addBindValue(sanitizeName(name));
     
-    if (query.exec() && query.next()) {
+    if (QueryProfiler::exec(query) && query.next()) {
         return query.value("count").toInt() > 0;
     }
     
@@ -579,7 +580,7 @@ void GenreRepository::logError(const QString& operation, const QString& error, c
 
 bool GenreRepository::executeQuery(QSqlQuery& query, const QString& operation)
 {
-    if (!query.exec()) {
+    if (!QueryProfiler::exec(query)) {
         QString error = QString("SQL Error: %1").arg(query.lastError().text());
         logError(operation, error, query.lastQuery());
         emit operationError(operation, error);
@@ -0,0 +1,483 @@
+#include "LibraryMigrations.h"
+
+#include <QDebug>
+#include <QSqlQuery>
+
+namespace {
+
+Migration makeMigration(const QString& version, const QString& name,
+                        const QString& description,
+                        const QString& upSql, const QString& downSql)
+{
+    Migration migration;
+    migration.version = version;
+    migration.name = name;
+    migration.description = description;
+    migration.upSql = upSql;
+    migration.downSql = downSql;
+    return migration;
+}
+
+// musics_fts and its triggers (001-006): they need FTS5, which not every
+// system SQLite is built with
+bool isFullTextMigration(const Migration& migration)
+{
+    return migration.version.toInt() <= 6;
+}
+
+bool fullTextAvailable(QSqlDatabase& database)
+{
+    QSqlQuery query(database);
+    if (!query.exec("CREATE VIRTUAL TABLE temp.xfb_fts5_probe USING fts5(x)"))
+        return false;
+    query.exec("DROP TABLE temp.xfb_fts5_probe");
+    return true;
+}
+
+// One DatabaseMigrator run: the pending migrations of the batch, in one
+// transaction
+bool applyBatch(QSqlDatabase& database, const QList<Migration>& migrations)
+{
+    DatabaseMigrator migrator(database);
+    if (!migrator.initialize()) {
+        qWarning() << "LibraryMigrations: could not initialize the migration table";
+        return false;
+    }
+
+    for (const Migration& migration : migrations) {
+        if (!migrator.addMigration(migration)) {
+            qWarning() << "LibraryMigrations: rejected migration" << migration.version;
+            return false;
+        }
+    }
+
+    const DatabaseMigrator::MigrationResult result = migrator.migrate();
+    if (!result.success) {
+        qWarning() << "LibraryMigrations: migration failed:" << result.error
+                   << "failed:" << result.failedMigrations;
+        return false;
+    }
+    if (result.appliedCount > 0)
+        qInfo() << "LibraryMigrations: applied" << result.appliedMigrations;
+    return true;
+}
+
+} // namespace
+
+QList<Migration> LibraryMigrations::all()
+{
+    QList<Migration> migrations;
+
+    // Full-text index over the searchable library columns. musics has no
+    // INTEGER PRIMARY KEY, so the index is keyed by rowid (an external
+    // content table: the text itself is only stored once, in musics).
+    // unicode61 folds case and, with remove_diacritics 2, accents; the
+    // 2- and 3-character prefix indexes keep search-as-you-type fast.
+    migrations << makeMigration(
+        "001", "Create musics_fts",
+        "Full-text search index over the music library",
+        "CREATE VIRTUAL TABLE IF NOT EXISTS musics_fts USING fts5("
+        "artist, song, genre1, genre2, country, path, "
+        "content='musics', content_rowid='rowid', "
+        "tokenize='unicode61 remove_diacritics 2', prefix='2 3')",
+        "DROP TABLE IF EXISTS musics_fts");
+
+    // Triggers keep the index in step with every writer of musics, not
+    // just MusicRepository. A migration is a single statement, so an
+    // update is split into a BEFORE trigger that removes the old terms
+    // and an AFTER trigger that adds the new ones. Play count updates
+    // do not touch indexed columns and therefore skip both.
+    migrations << makeMigration(
+        "002", "Index inserted musics",
+        "Add new musics rows to musics_fts",
+        "CREATE TRIGGER IF NOT EXISTS musics_fts_ai AFTER INSERT ON musics BEGIN "
+        "INSERT INTO musics_fts(rowid, artist, song, genre1, genre2, country, path) "
+        "VALUES (new.rowid, new.artist, new.song, new.genre1, new.genre2, new.country, new.path); "
+        "END",
+        "DROP TRIGGER IF EXISTS musics_fts_ai");
+
+    migrations << makeMigration(
+        "003", "Unindex deleted musics",
+        "Remove deleted musics rows from musics_fts",
+        "CREATE TRIGGER IF NOT EXISTS musics_fts_ad AFTER DELETE ON musics BEGIN "
+        "INSERT INTO musics_fts(musics_fts, rowid, artist, song, genre1, genre2, country, path) "
+        "VALUES ('delete', old.rowid, old.artist, old.song, old.genre1, old.genre2, old.country, old.path); "
+        "END",
+        "DROP TRIGGER IF EXISTS musics_fts_ad");
+
+    migrations << makeMigration(
+        "004", "Unindex updated musics",
+        "Remove the previous terms of an updated musics row",
+        "CREATE TRIGGER IF NOT EXISTS musics_fts_bu "
+        "BEFORE UPDATE OF artist, song, genre1, genre2, country, path ON musics BEGIN "
+        "INSERT INTO musics_fts(musics_fts, rowid, artist, song, genre1, genre2, country, path) "
+        "VALUES ('delete', old.rowid, old.artist, old.song, old.genre1, old.genre2, old.country, old.path); "
+        "END",
+        "DROP TRIGGER IF EXISTS musics_fts_bu");
+
+    migrations << makeMigration(
+        "005", "Reindex updated musics",
+        "Add the new terms of an updated musics row",
+        "CREATE TRIGGER IF NOT EXISTS musics_fts_au "
+        "AFTER UPDATE OF artist, song, genre1, genre2, country, path ON musics BEGIN "
+        "INSERT INTO musics_fts(rowid, artist, song, genre1, genre2, country, path) "
+        "VALUES (new.rowid, new.artist, new.song, new.genre1, new.genre2, new.country, new.path); "
+        "END",
+        "DROP TRIGGER IF EXISTS musics_fts_au");
+
+    migrations << makeMigration(
+        "006", "Populate musics_fts",
+        "Index the rows that predate musics_fts",
+        "INSERT INTO musics_fts(musics_fts) VALUES ('rebuild')",
+        "INSERT INTO musics_fts(musics_fts) VALUES ('delete-all')");
+
+    // Every import checks whether a path is already in the library. Not
+    // UNIQUE: older libraries may already hold the same path twice, and
+    // the migration must not fail on them.
+    migrations << makeMigration(
+        "007", "Index musics paths",
+        "Look up musics rows by path without a table scan",
+        "CREATE INDEX IF NOT EXISTS idx_musics_path ON musics(path)",
+        "DROP INDEX IF EXISTS idx_musics_path");
+
+    // Rescan manifest: what each library file looked like when it was last
+    // seen, so a rescan only has to act on files that differ. Keyed by the
+    // clean path; hash stays NULL until a rescan needs it.
+    migrations << makeMigration(
+        "008", "Create library_files",
+        "File state manifest for incremental rescans",
+        "CREATE TABLE IF NOT EXISTS library_files ("
+        "path TEXT PRIMARY KEY, size INTEGER NOT NULL, mtime INTEGER NOT NULL, "
+        "inode INTEGER NOT NULL DEFAULT 0, hash BLOB)",
+        "DROP TABLE IF EXISTS library_files");
+
+    migrations << makeMigration(
+        "009", "Create library_roots",
+        "Music folders a rescan walks",
+        "CREATE TABLE IF NOT EXISTS library_roots (path TEXT PRIMARY KEY, added TEXT)",
+        "DROP TABLE IF EXISTS library_roots");
+
+    // The scheduler table as shipped in adb.db, for databases without it.
+    // Not dropped on rollback: it holds the station's schedule. 028-035
+    // rebuild it with a key.
+    migrations << makeMigration(
+        "010", "Create scheduler",
+        "Scheduled pubs and programs",
+        "CREATE TABLE IF NOT EXISTS scheduler (\"id\" INTEGER, \"ano\" INTEGER, \"mes\" INTEGER, "
+        "\"dia\" INTEGER, \"hora\" INTEGER, \"min\" INTEGER, \"tipo\" INTEGER, \"week_day\" TEXT, "
+        "\"start_ano\" INTEGER, \"start_mes\" INTEGER, \"start_dia\" INTEGER, \"end_ano\" INTEGER, "
+        "\"end_mes\" INTEGER, \"end_dia\" INTEGER, \"is_program\" NULL)",
+        QString());
+
+    migrations << makeMigration(
+        "011", "Index scheduler times",
+        "Look up scheduler rules by date and time",
+        "CREATE INDEX IF NOT EXISTS idx_scheduler_time ON scheduler(ano, mes, dia, hora, min)",
+        "DROP INDEX IF EXISTS idx_scheduler_time");
+
+    // Change log for SchedulerEngine: the rowid of every scheduler row
+    // inserted, updated or deleted, whoever did it. The engine reloads just
+    // those rows and prunes what it has read.
+    migrations << makeMigration(
+        "012", "Create scheduler_changes",
+        "Log of changed scheduler rows",
+        "CREATE TABLE IF NOT EXISTS scheduler_changes ("
+        "seq INTEGER PRIMARY KEY AUTOINCREMENT, rule INTEGER NOT NULL)",
+        "DROP TABLE IF EXISTS scheduler_changes");
+
+    migrations << makeMigration(
+        "013", "Log inserted scheduler rows",
+        "Add new scheduler rows to scheduler_changes",
+        "CREATE TRIGGER IF NOT EXISTS scheduler_changes_ai AFTER INSERT ON scheduler BEGIN "
+        "INSERT INTO scheduler_changes(rule) VALUES (new.rowid); "
+        "END",
+        "DROP TRIGGER IF EXISTS scheduler_changes_ai");
+
+    migrations << makeMigration(
+        "014", "Log deleted scheduler rows",
+        "Add deleted scheduler rows to scheduler_changes",
+        "CREATE TRIGGER IF NOT EXISTS scheduler_changes_ad AFTER DELETE ON scheduler BEGIN "
+        "INSERT INTO scheduler_changes(rule) VALUES (old.rowid); "
+        "END",
+        "DROP TRIGGER IF EXISTS scheduler_changes_ad");
+
+    migrations << makeMigration(
+        "015", "Log updated scheduler rows",
+        "Add updated scheduler rows to scheduler_changes",
+        "CREATE TRIGGER IF NOT EXISTS scheduler_changes_au AFTER UPDATE ON scheduler BEGIN "
+        "INSERT INTO scheduler_changes(rule) SELECT old.rowid UNION SELECT new.rowid; "
+        "END",
+        "DROP TRIGGER IF EXISTS scheduler_changes_au");
+
+    // Genre filters: by equality from the rotations and the genre picker,
+    // and case-insensitively by LIKE from the library search. These used
+    // to be created at startup by DatabaseOptimizer::createOptimalIndexes().
+    migrations << makeMigration(
+        "036", "Index musics genres",
+        "Filter the library by genre without a table scan",
+        "CREATE INDEX IF NOT EXISTS idx_musics_genre1 ON musics(genre1)",
+        "DROP INDEX IF EXISTS idx_musics_genre1");
+
+    migrations << makeMigration(
+        "037", "Index musics genres for LIKE",
+        "Let a case-insensitive genre LIKE use an index",
+        "CREATE INDEX IF NOT EXISTS idx_musics_genre1_nocase ON musics(genre1 COLLATE NOCASE)",
+        "DROP INDEX IF EXISTS idx_musics_genre1_nocase");
+
+    // MusicListModel sorts the library view by any column and pages it by
+    // (column, rowid) keys: one index per sortable column turns each page
+    // and the anchor scan into index walks. path (007) and genre1 (036)
+    // already have theirs. Named as the model used to create them on the
+    // first sort, so libraries that already have one keep it.
+    migrations << makeMigration(
+        "038", "Index musics id",
+        "Sort the library view by ids without a table sort",
+        "CREATE INDEX IF NOT EXISTS idx_musics_id ON musics(id)",
+        "DROP INDEX IF EXISTS idx_musics_id");
+
+    migrations << makeMigration(
+        "039", "Index musics artist",
+        "Sort the library view by artists without a table sort",
+        "CREATE INDEX IF NOT EXISTS idx_musics_artist ON musics(artist)",
+        "DROP INDEX IF EXISTS idx_musics_artist");
+
+    migrations << makeMigration(
+        "040", "Index musics song",
+        "Sort the library view by titles without a table sort",
+        "CREATE INDEX IF NOT EXISTS idx_musics_song ON musics(song)",
+        "DROP INDEX IF EXISTS idx_musics_song");
+
+    migrations << makeMigration(
+        "041", "Index musics genre2",
+        "Sort the library view by second genres without a table sort",
+        "CREATE INDEX IF NOT EXISTS idx_musics_genre2 ON musics(genre2)",
+        "DROP INDEX IF EXISTS idx_musics_genre2");
+
+    migrations << makeMigration(
+        "042", "Index musics country",
+        "Sort the library view by countries without a table sort",
+        "CREATE INDEX IF NOT EXISTS idx_musics_country ON musics(country)",
+        "DROP INDEX IF EXISTS idx_musics_country");
+
+    migrations << makeMigration(
+        "043", "Index musics published_date",
+        "Sort the library view by publication dates without a table sort",
+        "CREATE INDEX IF NOT EXISTS idx_musics_published_date ON musics(published_date)",
+        "DROP INDEX IF EXISTS idx_musics_published_date");
+
+    migrations << makeMigration(
+        "044", "Index musics time",
+        "Sort the library view by durations without a table sort",
+        "CREATE INDEX IF NOT EXISTS idx_musics_time ON musics(time)",
+        "DROP INDEX IF EXISTS idx_musics_time");
+
+    migrations << makeMigration(
+        "045", "Index musics played_times",
+        "Sort the library view by play counts without a table sort",
+        "CREATE INDEX IF NOT EXISTS idx_musics_played_times ON musics(played_times)",
+        "DROP INDEX IF EXISTS idx_musics_played_times");
+
+    migrations << makeMigration(
+        "046", "Index musics last_played",
+        "Sort the library view by last plays without a table sort",
+        "CREATE INDEX IF NOT EXISTS idx_musics_last_played ON musics(last_played)",
+        "DROP INDEX IF EXISTS idx_musics_last_played");
+
+    // One row per play, appended by PlayLog. track is the musics rowid,
+    // NULL for a file outside the library; times are milliseconds since
+    // the epoch so periods are plain integer ranges.
+    migrations << makeMigration(
+        "016", "Create play_log",
+        "Per-play history for reports",
+        "CREATE TABLE IF NOT EXISTS play_log ("
+        "id INTEGER PRIMARY KEY, track INTEGER, path TEXT NOT NULL, "
+        "started INTEGER NOT NULL, ended INTEGER NOT NULL, "
+        "aired_ms INTEGER NOT NULL, source TEXT NOT NULL)",
+        "DROP TABLE IF EXISTS play_log");
+
+    // Covering indexes: plays of one track in a period, and plays of every
+    // track in a period, are answered without reading play_log itself
+    migrations << makeMigration(
+        "017", "Index play_log by track",
+        "Plays per track per period",
+        "CREATE INDEX IF NOT EXISTS idx_play_log_track ON play_log(track, started, aired_ms)",
+        "DROP INDEX IF EXISTS idx_play_log_track");
+
+    migrations << makeMigration(
+        "018", "Index play_log by time",
+        "Plays in a period",
+        "CREATE INDEX IF NOT EXISTS idx_play_log_started ON play_log(started, track, aired_ms)",
+        "DROP INDEX IF EXISTS idx_play_log_started");
+
+    // Queue of TranscodeQueue: one row per file to convert, kept across
+    // restarts. state is TranscodeQueue::JobState; rows of converted files
+    // are deleted once their original is gone, failed ones stay until the
+    // next conversion is queued.
+    migrations << makeMigration(
+        "019", "Create transcode_jobs",
+        "Persistent queue of library conversions",
+        "CREATE TABLE IF NOT EXISTS transcode_jobs ("
+        "id INTEGER PRIMARY KEY, source TEXT NOT NULL UNIQUE, target TEXT NOT NULL, "
+        "format TEXT NOT NULL, state INTEGER NOT NULL DEFAULT 0, "
+        "attempts INTEGER NOT NULL DEFAULT 0, error TEXT, updated INTEGER NOT NULL)",
+        "DROP TABLE IF EXISTS transcode_jobs");
+
+    migrations << makeMigration(
+        "020", "Index transcode_jobs by state",
+        "Pending conversions in queue order",
+        "CREATE INDEX IF NOT EXISTS idx_transcode_jobs_state ON transcode_jobs(state, id)",
+        "DROP INDEX IF EXISTS idx_transcode_jobs_state");
+
+    // Silence found by TrackTrimmer at the head and tail of each file, in
+    // ms. size and mtime are the file's when it was scanned: a trim only
+    // holds while they still match.
+    migrations << makeMigration(
+        "021", "Create track_trims",
+        "Stored head and tail silence of library files",
+        "CREATE TABLE IF NOT EXISTS track_trims ("
+        "path TEXT PRIMARY KEY, start_ms INTEGER NOT NULL, end_ms INTEGER NOT NULL, "
+        "duration_ms INTEGER NOT NULL, size INTEGER NOT NULL, mtime INTEGER NOT NULL, "
+        "updated INTEGER NOT NULL)",
+        "DROP TABLE IF EXISTS track_trims");
+
+    // Size and modification time of a converted file, recorded before it
+    // is renamed into place (TranscodeQueue::JobState::Renaming): after a
+    // crash only a target that still matches them is taken as converted.
+    migrations << makeMigration(
+        "022", "Record transcode output sizes",
+        "Size of each converted file before its rename",
+        "ALTER TABLE transcode_jobs ADD COLUMN output_size INTEGER",
+        "ALTER TABLE transcode_jobs DROP COLUMN output_size");
+
+    migrations << makeMigration(
+        "023", "Record transcode output times",
+        "Modification time of each converted file before its rename",
+        "ALTER TABLE transcode_jobs ADD COLUMN output_mtime INTEGER",
+        "ALTER TABLE transcode_jobs DROP COLUMN output_mtime");
+
+    // PlayLog reports go by path: musics has no INTEGER PRIMARY KEY, so a
+    // VACUUM renumbers its rowids and play_log.track goes stale. The same
+    // covering indexes as 017 and 018, on path; those two are dropped.
+    migrations << makeMigration(
+        "024", "Index play_log by path",
+        "Plays per track per period",
+        "CREATE INDEX IF NOT EXISTS idx_play_log_path ON play_log(path, started, aired_ms)",
+        "DROP INDEX IF EXISTS idx_play_log_path");
+
+    migrations << makeMigration(
+        "025", "Index play_log by time and path",
+        "Plays in a period",
+        "CREATE INDEX IF NOT EXISTS idx_play_log_started_path ON play_log(started, path, aired_ms)",
+        "DROP INDEX IF EXISTS idx_play_log_started_path");
+
+    migrations << makeMigration(
+        "026", "Drop play_log track index",
+        "Superseded by idx_play_log_path",
+        "DROP INDEX IF EXISTS idx_play_log_track",
+        "CREATE INDEX IF NOT EXISTS idx_play_log_track ON play_log(track, started, aired_ms)");
+
+    migrations << makeMigration(
+        "027", "Drop play_log time index",
+        "Superseded by idx_play_log_started_path",
+        "DROP INDEX IF EXISTS idx_play_log_started",
+        "CREATE INDEX IF NOT EXISTS idx_play_log_started ON play_log(started, track, aired_ms)");
+
+    // scheduler had no INTEGER PRIMARY KEY, so a VACUUM renumbered the
+    // rowids SchedulerEngine keys its rules by. It is rebuilt with one,
+    // rule_id, added last so the shipped columns keep their positions;
+    // each rule keeps its rowid as its key. Dropping the old table drops
+    // its index and change triggers, which are created again on rule_id.
+    migrations << makeMigration(
+        "028", "Create keyed scheduler",
+        "scheduler with a stable rule key",
+        "CREATE TABLE IF NOT EXISTS scheduler_keyed (\"id\" INTEGER, \"ano\" INTEGER, \"mes\" INTEGER, "
+        "\"dia\" INTEGER, \"hora\" INTEGER, \"min\" INTEGER, \"tipo\" INTEGER, \"week_day\" TEXT, "
+        "\"start_ano\" INTEGER, \"start_mes\" INTEGER, \"start_dia\" INTEGER, \"end_ano\" INTEGER, "
+        "\"end_mes\" INTEGER, \"end_dia\" INTEGER, \"is_program\" NULL, \"rule_id\" INTEGER PRIMARY KEY)",
+        "DROP TABLE IF EXISTS scheduler_keyed");
+
+    migrations << makeMigration(
+        "029", "Copy scheduler rules",
+        "Move the rules, keyed by their rowid",
+        "INSERT INTO scheduler_keyed (id, ano, mes, dia, hora, min, tipo, week_day, start_ano, start_mes, start_dia, "
+        "end_ano, end_mes, end_dia, is_program, rule_id) "
+        "SELECT id, ano, mes, dia, hora, min, tipo, week_day, start_ano, start_mes, start_dia, "
+        "end_ano, end_mes, end_dia, is_program, rowid FROM scheduler",
+        "DELETE FROM scheduler_keyed");
+
+    migrations << makeMigration(
+        "030", "Drop unkeyed scheduler",
+        "Replaced by scheduler_keyed",
+        "DROP TABLE scheduler",
+        QString());
+
+    migrations << makeMigration(
+        "031", "Rename keyed scheduler",
+        "scheduler_keyed becomes scheduler",
+        "ALTER TABLE scheduler_keyed RENAME TO scheduler",
+        "ALTER TABLE scheduler RENAME TO scheduler_keyed");
+
+    migrations << makeMigration(
+        "032", "Index keyed scheduler times",
+        "Look up scheduler rules by date and time",
+        "CREATE INDEX IF NOT EXISTS idx_scheduler_time ON scheduler(ano, mes, dia, hora, min)",
+        "DROP INDEX IF EXISTS idx_scheduler_time");
+
+    migrations << makeMigration(
+        "033", "Log inserted scheduler rules",
+        "Add new scheduler rules to scheduler_changes",
+        "CREATE TRIGGER IF NOT EXISTS scheduler_changes_ai AFTER INSERT ON scheduler BEGIN "
+        "INSERT INTO scheduler_changes(rule) VALUES (new.rule_id); "
+        "END",
+        "DROP TRIGGER IF EXISTS scheduler_changes_ai");
+
+    migrations << makeMigration(
+        "034", "Log deleted scheduler rules",
+        "Add deleted scheduler rules to scheduler_changes",
+        "CREATE TRIGGER IF NOT EXISTS scheduler_changes_ad AFTER DELETE ON scheduler BEGIN "
+        "INSERT INTO scheduler_changes(rule) VALUES (old.rule_id); "
+        "END",
+        "DROP TRIGGER IF EXISTS scheduler_changes_ad");
+
+    migrations << makeMigration(
+        "035", "Log updated scheduler rules",
+        "Add updated scheduler rules to scheduler_changes",
+        "CREATE TRIGGER IF NOT EXISTS scheduler_changes_au AFTER UPDATE ON scheduler BEGIN "
+        "INSERT INTO scheduler_changes(rule) SELECT old.rule_id UNION SELECT new.rule_id; "
+        "END",
+        "DROP TRIGGER IF EXISTS scheduler_changes_au");
+
+    // PlayLog reports join play_log to musics on path. A trigger moves the
+    // logged path along with the file for every writer of musics.path
+    // (rescans, conversions, the legacy converters), in the writer's own
+    // transaction.
+    migrations << makeMigration(
+        "047", "Follow moved files in play_log",
+        "Keep play_log paths in step with musics",
+        "CREATE TRIGGER IF NOT EXISTS play_log_path_au AFTER UPDATE OF path ON musics "
+        "WHEN old.path IS NOT new.path BEGIN "
+        "UPDATE play_log SET path = new.path WHERE path = old.path; "
+        "END",
+        "DROP TRIGGER IF EXISTS play_log_path_au");
+
+    return migrations;
+}
+
+bool LibraryMigrations::apply(QSqlDatabase& database)
+{
+    QList<Migration> schema;
+    QList<Migration> fullText;
+    for (const Migration& migration : all())
+        (isFullTextMigration(migration) ? fullText : schema) << migration;
+
+    // The full-text index runs in a batch of its own, after the rest: a
+    // library whose SQLite lacks FTS5 still gets every later table and
+    // index, and searching falls back to LIKE
+    const bool schemaApplied = applyBatch(database, schema);
+    if (!fullTextAvailable(database)) {
+        qWarning() << "LibraryMigrations: SQLite has no FTS5, library search will not be indexed";
+        return schemaApplied;
+    }
+    const bool fullTextApplied = applyBatch(database, fullText);
+    return schemaApplied && fullTextApplied;
+}
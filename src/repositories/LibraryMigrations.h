@@ -0,0 +1,42 @@
+#ifndef LIBRARYMIGRATIONS_H
+#define LIBRARYMIGRATIONS_H
+
+#include "DatabaseMigrator.h"
+
+#include <QList>
+#include <QSqlDatabase>
+
+/**
+ * @brief Schema changes applied to the user's library database
+ *
+ * The bundled adb.db is only a first-run skeleton and never replaces an
+ * existing database, so anything the library schema gains after release
+ * is added here as a DatabaseMigrator migration and applied on open.
+ * Migrations are append-only: never edit or renumber a shipped one.
+ *
+ * @since XFB 2.0
+ */
+class LibraryMigrations
+{
+public:
+    /**
+     * @brief All library migrations, in version order
+     * @return List of Migration objects
+     */
+    static QList<Migration> all();
+
+    /**
+     * @brief Apply the pending library migrations to database
+     *
+     * The full-text index (musics_fts, 001-006) is applied in a second
+     * transaction, and only when SQLite has FTS5, so it never holds back
+     * the rest of the schema.
+     *
+     * @param database Open library database
+     * @return true if the schema is up to date, false otherwise; still
+     *         true without FTS5
+     */
+    static bool apply(QSqlDatabase& database);
+};
+
+#endif // LIBRARYMIGRATIONS_H
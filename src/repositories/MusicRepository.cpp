@@ -1,4 +1,5 @@
 #include "MusicRepository.h"
+#include "../services/QueryProfiler.h"
 #include <QSqlQuery>
 #include <QSqlError>
 #include <QVariant>
@@ -9,6 +10,8 @@
 #include <QDateTime>
 #include <QMutexLocker>
 #include <QCoreApplication>
+#include <QRegularExpression>
+#include <QSet>
 
 MusicRepository::MusicRepository(QSqlDatabase& database, QObject* parent)
     : QObject(parent)
@@ -260,6 +263,25 @@ QList<MusicItem> MusicRepository::searchMusic(const SearchCriteria& criteria)
                          "path, time, played_times, last_played FROM musics WHERE 1=1";
     
     QVariantList bindValues;
+    bool ranked = false;
+    
+    // With the full-text index, the general text search is one MATCH
+    // instead of a LIKE scan per column. Field criteria stay substring
+    // filters: getMusicByArtist() and friends rely on that.
+    const QString match = hasSearchIndex(m_database)
+        ? searchMatchExpression(criteria.searchText) : QString();
+    if (!match.isEmpty()) {
+        if (criteria.rankByRelevance) {
+            queryString = "SELECT id, artist, song, genre1, genre2, country, published_date, "
+                          "path, time, played_times, last_played FROM musics "
+                          "JOIN (SELECT rowid AS fts_rowid, rank AS fts_rank FROM musics_fts "
+                          "WHERE musics_fts MATCH ?) ON musics.rowid = fts_rowid WHERE 1=1";
+            ranked = true;
+        } else {
+            queryString += " AND rowid IN (SELECT rowid FROM musics_fts WHERE musics_fts MATCH ?)";
+        }
+        bindValues.append(match);
+    }
     
     // Build WHERE clause based on criteria
     if (!criteria.artist.isEmpty()) {
@@ -287,7 +309,7 @@ QList<MusicItem> MusicRepository::searchMusic(const SearchCriteria& criteria)
         bindValues.append(QString("%%1%").arg(criteria.country));
     }
     
-    if (!criteria.searchText.isEmpty()) {
+    if (match.isEmpty() && !criteria.searchText.isEmpty()) {
         queryString += " AND (artist LIKE ? OR song LIKE ? OR genre1 LIKE ? OR genre2 LIKE ?)";
         QString searchPattern = QString("%%1%").arg(criteria.searchText);
         bindValues.append(searchPattern);
@@ -297,9 +319,13 @@ QList<MusicItem> MusicRepository::searchMusic(const SearchCriteria& criteria)
     }
     
     // Add ORDER BY clause
-    queryString += QString(" ORDER BY %1").arg(criteria.orderBy);
-    if (!criteria.ascending) {
-        queryString += " DESC";
+    if (ranked) {
+        queryString += " ORDER BY fts_rank";
+    } else {
+        queryString += QString(" ORDER BY %1").arg(criteria.orderBy);
+        if (!criteria.ascending) {
+            queryString += " DESC";
+        }
     }
     
     // Add LIMIT and OFFSET
@@ -344,6 +370,35 @@ QList<MusicItem> MusicRepository::searchMusic(const SearchCriteria& criteria)
     return results;
 }
 
+bool MusicRepository::hasSearchIndex(const QSqlDatabase& database)
+{
+    QSqlQuery query(database);
+    return query.exec("SELECT 1 FROM sqlite_master WHERE type = 'table' AND name = 'musics_fts'")
+        && query.next();
+}
+
+QString MusicRepository::searchMatchExpression(const QString& text, const QStringList& columns)
+{
+    // Split where the unicode61 tokenizer does, so that every word is a
+    // single-token prefix query and no user input reaches FTS5 syntax
+    static const QRegularExpression separators("[^\\p{L}\\p{N}\\p{M}]+");
+    const QStringList words = text.split(separators, Qt::SkipEmptyParts);
+    if (words.isEmpty()) {
+        return QString();
+    }
+
+    QStringList tokens;
+    for (const QString& word : words) {
+        tokens << QString("\"%1\"*").arg(word);
+    }
+
+    const QString expression = tokens.join(' ');
+    if (columns.isEmpty()) {
+        return expression;
+    }
+    return QString("{%1} : (%2)").arg(columns.join(' '), expression);
+}
+
 QList<MusicItem> MusicRepository::getMusicByGenre(const QString& genre, bool useGenre2)
 {
     SearchCriteria criteria;
@@ -414,9 +469,12 @@ int MusicRepository::addMusicBatch(const QList<MusicItem>& musicList)
     }
     
     int successCount = 0;
+    // One statement does both the duplicate check and the insert; a row
+    // that already exists just affects nothing
     QSqlQuery query(m_database);
     query.prepare("INSERT INTO musics (artist, song, genre1, genre2, country, published_date, path, time, played_times, last_played) "
-                  "VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, ?)");
+                  "SELECT ?, ?, ?, ?, ?, ?, ?, ?, ?, ? "
+                  "WHERE NOT EXISTS (SELECT 1 FROM musics WHERE path = ?)");
     
     for (const MusicItem& music : musicList) {
         // Validate each item
@@ -426,30 +484,24 @@ int MusicRepository::addMusicBatch(const QList<MusicItem>& musicList)
             continue;
         }
         
-        // Check if path already exists (inline to avoid recursive mutex lock)
-        {
-            QSqlQuery checkQuery(m_database);
-            checkQuery.prepare("SELECT COUNT(*) as count FROM musics WHERE path = ?");
-            checkQuery.addBindValue(sanitizePath(music.path));
-            
-            if (checkQuery.exec() && checkQuery.next() && checkQuery.value("count").toInt() > 0) {
-                qDebug() << "Skipping duplicate path:" << music.path;
-                continue;
-            }
-        }
-        
+        const QString path = sanitizePath(music.path);
         query.addBindValue(music.artist);
         query.addBindValue(music.song);
         query.addBindValue(music.genre1);
         query.addBindValue(music.genre2);
         query.addBindValue(music.country);
         query.addBindValue(music.publishedDate);
-        query.addBindValue(sanitizePath(music.path));
+        query.addBindValue(path);
         query.addBindValue(music.time);
         query.addBindValue(music.playedTimes);
         query.addBindValue(music.lastPlayed);
+        query.addBindValue(path);
         
-        if (query.exec()) {
+        if (QueryProfiler::exec(query)) {
+            if (query.numRowsAffected() == 0) {
+                qDebug() << "Skipping duplicate path:" << music.path;
+                continue;
+            }
             successCount++;
             
             // Emit signal for each added item
@@ -506,6 +558,20 @@ int MusicRepository::importFromDirectory(const QString& directoryPath, bool recu
         return 0;
     }
     
+    // Every path already in the library, read once instead of one
+    // lookup per file
+    QSet<QString> knownPaths;
+    {
+        QMutexLocker locker(&m_mutex);
+        QSqlQuery pathQuery(m_database);
+        pathQuery.setForwardOnly(true);
+        if (QueryProfiler::exec(pathQuery, "SELECT path FROM musics")) {
+            while (pathQuery.next()) {
+                knownPaths.insert(pathQuery.value(0).toString());
+            }
+        }
+    }
+    
     // Process files in batches
     QList<MusicItem> musicBatch;
     int processed = 0;
@@ -515,16 +581,10 @@ int MusicRepository::importFromDirectory(const QString& directoryPath, bool recu
     for (const QString& filePath : audioFiles) {
         emit importProgress(processed, audioFiles.size(), filePath);
         
-        // Skip if already exists (check without additional mutex lock)
-        {
-            QSqlQuery checkQuery(m_database);
-            checkQuery.prepare("SELECT COUNT(*) as count FROM musics WHERE path = ?");
-            checkQuery.addBindValue(sanitizePath(filePath));
-            
-            if (checkQuery.exec() && checkQuery.next() && checkQuery.value("count").toInt() > 0) {
-                processed++;
-                continue;
-            }
+        // Skip if already exists
+        if (knownPaths.contains(sanitizePath(filePath))) {
+            processed++;
+            continue;
         }
         
         // Extract metadata
@@ -707,7 +767,7 @@ bool MusicRepository::pathExists(const QString& filePath)
     query.prepare("SELECT COUNT(*) as count FROM musics WHERE path = ?");
     query.addBindValue(sanitizePath(filePath));
     
-    if (query.exec() && query.next()) {
+    if (QueryProfiler::exec(query) && query.next()) {
         return query.value("count").toInt() > 0;
     }
     
@@ -822,7 +882,7 @@ void MusicRepository::logError(const QString& operation, const QString& error, c
 
 bool MusicRepository::executeQuery(QSqlQuery& query, const QString& operation)
 {
-    if (!query.exec()) {
+    if (!QueryProfiler::exec(query)) {
         QString error = QString("SQL Error: %1").arg(query.lastError().text());
         logError(operation, error, query.lastQuery());
         emit operationError(operation, error);
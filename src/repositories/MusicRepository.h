@@ -135,6 +135,7 @@ public:
         int offset = 0;
         QString orderBy = "artist, song"; // Default ordering
         bool ascending = true;
+        bool rankByRelevance = false; // Best full-text matches first; overrides orderBy
     };
 
     /**
@@ -153,6 +154,12 @@ public:
     explicit MusicRepository(QSqlDatabase& database, QObject* parent = nullptr);
     ~MusicRepository() override;
 
+    /**
+     * @brief Connection this repository works on
+     * @return The database passed to the constructor
+     */
+    QSqlDatabase& database() const { return m_database; }
+
     /**
      * @brief Add a new music item to the database
      * @param music MusicItem to add
@@ -196,6 +203,30 @@ public:
      */
     QList<MusicItem> searchMusic(const SearchCriteria& criteria);
 
+    /**
+     * @brief Check whether the musics_fts full-text index exists
+     * 
+     * When it does, searchMusic() and MusicListModel match words through
+     * the index instead of scanning the table with LIKE.
+     * 
+     * @param database Library database
+     * @return true if the index is available, false otherwise
+     */
+    static bool hasSearchIndex(const QSqlDatabase& database);
+
+    /**
+     * @brief Build a musics_fts MATCH expression from text typed by a user
+     * 
+     * Every word must occur, as a prefix of a word, in one of columns
+     * (all indexed columns when empty). Case and accents are ignored.
+     * 
+     * @param text Search text
+     * @param columns Indexed column names to search in
+     * @return MATCH expression, empty if text holds no searchable word
+     */
+    static QString searchMatchExpression(const QString& text,
+                                         const QStringList& columns = QStringList());
+
     /**
      * @brief Get music items by genre
      * @param genre Genre name to search for
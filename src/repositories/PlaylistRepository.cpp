@@ -1,4 +1,5 @@
 #include "PlaylistRepository.h"
+#include "../services/QueryProfiler.h"
 #include <QSqlQuery>
 #include <QSqlError>
 #include <QVariant>
@@ -353,7 +354,7 @@ int PlaylistRepository::addPlaylistBatch(const QList<PlaylistItem>& playlistList
         query.addBindValue(sanitizeName(playlist.name));
         query.addBindValue(sanitizePath(playlist.path));
         
-        if (query.exec()) {
+        if (QueryProfiler::exec(query)) {
             successCount++;
             
             // Emit signal for each added item
@@ -389,7 +390,7 @@ bool PlaylistRepository::playlistExists(const QString& name)
     query.prepare("SELECT COUNT(*) as count FROM programs WHERE name = ?");
     query.addBindValue(sanitizeName(name));
     
-    if (query.exec() && query.next()) {
+    if (QueryProfiler::exec(query) && query.next()) {
         return query.value("count").toInt() > 0;
     }
     
@@ -408,7 +409,7 @@ bool PlaylistRepository::pathExists(const QString& path)
     query.prepare("SELECT COUNT(*) as count FROM programs WHERE path = ?");
     query.addBindValue(sanitizePath(path));
     
-    if (query.exec() && query.next()) {
+    if (QueryProfiler::exec(query) && query.next()) {
         return query.value("count").toInt() > 0;
     }
     
@@ -573,7 +574,7 @@ void PlaylistRepository::logError(const QString& operation, const QString& error
 
 bool PlaylistRepository::executeQuery(QSqlQuery& query, const QString& operation)
 {
-    if (!query.exec()) {
+    if (!QueryProfiler::exec(query)) {
         QString error = QString("SQL Error: %1").arg(query.lastError().text());
         logError(operation, error, query.lastQuery());
         emit operationError(operation, error);
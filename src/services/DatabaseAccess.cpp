@@ -0,0 +1,316 @@
+#include "DatabaseAccess.h"
+#include <QDeadlineTimer>
+#include <QElapsedTimer>
+#include <QSqlError>
+#include <QSqlQuery>
+#include <QThread>
+#include <QDebug>
+
+DatabaseAccess::DatabaseAccess(const QString& databaseName, QObject* parent)
+    : DatabaseAccess(databaseName, Tuning(), parent)
+{
+}
+
+DatabaseAccess::DatabaseAccess(const QString& databaseName, const Tuning& tuning, QObject* parent)
+    : QObject(parent)
+    , m_databaseName(databaseName)
+    , m_tuning(tuning)
+    , m_connectionPrefix(QString("DatabaseAccess_%1").arg(quintptr(this), 0, 16))
+{
+    // One writer, kept alive so its connection (and page cache) is reused
+    m_writerPool.setMaxThreadCount(1);
+    m_writerPool.setExpiryTimeout(-1);
+}
+
+DatabaseAccess::~DatabaseAccess()
+{
+    flush();
+    m_writerPool.waitForDone();
+    if (m_connections.hasLocalData())
+        m_connections.setLocalData(nullptr);
+}
+
+DatabaseAccess::ThreadConnection::~ThreadConnection()
+{
+    closeConnection(name);
+}
+
+QSqlDatabase DatabaseAccess::openConnection(const QString& connectionName, const QString& driver,
+                                            const QString& databaseName, const Tuning& tuning)
+{
+    QSqlDatabase db = QSqlDatabase::addDatabase(driver, connectionName);
+    db.setDatabaseName(databaseName);
+    if (driver == QLatin1String("QSQLITE"))
+        db.setConnectOptions(QString("QSQLITE_BUSY_TIMEOUT=%1").arg(tuning.busyTimeoutMs));
+    if (db.open())
+        configure(db, tuning);
+    return db;
+}
+
+void DatabaseAccess::closeConnection(const QString& connectionName)
+{
+    {
+        QSqlDatabase db = QSqlDatabase::database(connectionName, false);
+        db.close();
+    }
+    QSqlDatabase::removeDatabase(connectionName);
+}
+
+QSqlDatabase DatabaseAccess::connection()
+{
+    if (!m_connections.hasLocalData()) {
+        ThreadConnection* owned = new ThreadConnection;
+        owned->name = QString("%1_%2").arg(m_connectionPrefix).arg(++m_connectionCounter);
+        m_connections.setLocalData(owned);
+        QSqlDatabase db = openConnection(owned->name, "QSQLITE", m_databaseName, m_tuning);
+        if (!db.isOpen())
+            qWarning() << "DatabaseAccess: could not open" << m_databaseName << ":" << db.lastError().text();
+        return db;
+    }
+
+    // Reopened here if the first open failed or it was closed since
+    QSqlDatabase db = QSqlDatabase::database(m_connections.localData()->name, false);
+    if (!db.isOpen()) {
+        if (!db.open()) {
+            qWarning() << "DatabaseAccess: could not open" << m_databaseName << ":" << db.lastError().text();
+            return db;
+        }
+        configure(db, m_tuning);
+    }
+    return db;
+}
+
+void DatabaseAccess::write(const QString& sql, const QVariantList& values)
+{
+    write([this, sql, values](QSqlDatabase& db) {
+        QSqlQuery query(db);
+        query.prepare(sql);
+        for (const QVariant& value : values)
+            query.addBindValue(value);
+        if (query.exec())
+            return true;
+
+        const QString error = query.lastError().text();
+        qWarning() << "DatabaseAccess: write failed:" << error << "SQL:" << sql;
+        emit writeFailed(error);
+        return false;
+    });
+}
+
+void DatabaseAccess::write(Job job)
+{
+    Pending pending;
+    pending.job = std::move(job);
+    enqueue(std::move(pending));
+}
+
+bool DatabaseAccess::writeAndWait(Job job, int timeoutMs)
+{
+    Pending pending;
+    pending.job = std::move(job);
+    pending.succeeded = std::make_shared<bool>(false);
+    const std::shared_ptr<bool> succeeded = pending.succeeded;
+
+    // Jobs finish in queue order: ours is done once the count reaches it
+    const qint64 sequence = enqueue(std::move(pending));
+    return waitFor(sequence, timeoutMs) && *succeeded;
+}
+
+bool DatabaseAccess::flush(int timeoutMs)
+{
+    qint64 sequence;
+    {
+        QMutexLocker locker(&m_mutex);
+        sequence = m_queuedSequence;
+    }
+    return waitFor(sequence, timeoutMs);
+}
+
+int DatabaseAccess::pendingWrites() const
+{
+    QMutexLocker locker(&m_mutex);
+    return int(m_queuedSequence - m_doneSequence);
+}
+
+DatabaseAccess::Statistics DatabaseAccess::statistics() const
+{
+    Statistics stats;
+    stats.jobs = m_jobs;
+    stats.failed = m_failed;
+    stats.batches = m_batches;
+    stats.maxQueued = m_maxQueued;
+    stats.maxBatchMs = m_maxBatchMs;
+    return stats;
+}
+
+bool DatabaseAccess::configure(QSqlDatabase& database, const Tuning& tuning)
+{
+    if (database.driverName() != "QSQLITE")
+        return true;
+    if (!database.isOpen())
+        return false;
+
+    QSqlQuery query(database);
+    bool ok = true;
+    auto pragma = [&](const QString& setting) {
+        if (!query.exec("PRAGMA " + setting)) {
+            qWarning() << "DatabaseAccess: PRAGMA" << setting << "failed:" << query.lastError().text();
+            ok = false;
+        }
+        query.finish();
+    };
+
+    pragma(QString("busy_timeout = %1").arg(tuning.busyTimeoutMs));
+    if (tuning.wal) {
+        // Needs a moment without other connections in a transaction; once
+        // set it sticks to the file. In-memory databases answer "memory".
+        QString mode;
+        if (query.exec("PRAGMA journal_mode = WAL") && query.next())
+            mode = query.value(0).toString().toLower();
+        query.finish();
+        if (mode != "wal" && mode != "memory") {
+            qWarning() << "DatabaseAccess: could not switch" << database.databaseName()
+                       << "to WAL, journal mode is" << mode << query.lastError().text();
+            ok = false;
+        }
+    }
+    pragma("synchronous = " + tuning.synchronous);
+    pragma(QString("mmap_size = %1").arg(tuning.mmapSize));
+    pragma(QString("cache_size = %1").arg(-tuning.cacheSizeKiB));  // negative: KiB, not pages
+    pragma("temp_store = MEMORY");
+    return ok;
+}
+
+QString DatabaseAccess::journalMode(const QSqlDatabase& database)
+{
+    QSqlQuery query(database);
+    if (!query.exec("PRAGMA journal_mode") || !query.next())
+        return QString();
+    return query.value(0).toString().toLower();
+}
+
+qint64 DatabaseAccess::enqueue(Pending pending)
+{
+    QMutexLocker locker(&m_mutex);
+    m_queue.append(std::move(pending));
+    ++m_queuedSequence;
+
+    const int queued = int(m_queuedSequence - m_doneSequence);
+    if (queued > m_maxQueued)
+        m_maxQueued = queued;
+
+    if (!m_draining) {
+        m_draining = true;
+        m_writerPool.start([this]() { drain(); });
+    }
+    return m_queuedSequence;
+}
+
+void DatabaseAccess::drain()
+{
+    QSqlDatabase db = connection();
+    int beginFailures = 0;
+
+    for (;;) {
+        // Everything that queued up while the last batch was committing
+        // goes into the next one
+        QList<Pending> batch;
+        {
+            QMutexLocker locker(&m_mutex);
+            if (m_queue.isEmpty()) {
+                m_draining = false;
+                return;
+            }
+            const int count = qMin(int(m_queue.size()), kMaxBatch);
+            batch = m_queue.mid(0, count);
+            m_queue.remove(0, count);
+        }
+
+        QString beginError;
+        if (!commit(db, batch, &beginError)) {
+            if (++beginFailures < kBeginAttempts) {
+                // Locked out: back to the head of the queue, where the
+                // writes queued meanwhile join it, and try again later
+                {
+                    QMutexLocker locker(&m_mutex);
+                    m_queue = batch + m_queue;
+                }
+                QThread::msleep(kBeginBackoffMs << (beginFailures - 1));
+                db = connection();
+                continue;
+            }
+            qWarning() << "DatabaseAccess:" << beginError << "- dropped" << batch.size() << "writes after"
+                       << kBeginAttempts << "attempts";
+            m_jobs += batch.size();
+            m_failed += batch.size();
+            emit writeFailed(tr("%1 writes dropped: %2").arg(batch.size()).arg(beginError));
+        }
+        beginFailures = 0;
+
+        {
+            QMutexLocker locker(&m_mutex);
+            m_doneSequence += batch.size();
+        }
+        m_committed.wakeAll();
+    }
+}
+
+bool DatabaseAccess::commit(QSqlDatabase& db, QList<Pending>& batch, QString* beginError)
+{
+    QElapsedTimer clock;
+    clock.start();
+
+    // IMMEDIATE takes the write lock up front, waiting out other writers
+    // through the busy timeout; a deferred transaction could fail to
+    // upgrade halfway through the batch instead
+    QSqlQuery control(db);
+    if (!control.exec("BEGIN IMMEDIATE")) {
+        *beginError = tr("Could not start a write transaction: %1").arg(control.lastError().text());
+        return false; // nothing ran; drain() retries or drops the batch
+    }
+
+    int failed = 0;
+    for (Pending& pending : batch) {
+        control.exec("SAVEPOINT job");
+        const bool ok = pending.job(db);
+        if (!ok) {
+            control.exec("ROLLBACK TO job");
+            ++failed;
+        }
+        control.exec("RELEASE job");
+        if (pending.succeeded)
+            *pending.succeeded = ok;
+    }
+
+    m_jobs += batch.size();
+    if (control.exec("COMMIT")) {
+        m_failed += failed;
+        ++m_batches;
+    } else {
+        const QString error = tr("Could not commit %1 writes: %2").arg(batch.size()).arg(control.lastError().text());
+        qWarning() << "DatabaseAccess:" << error;
+        control.exec("ROLLBACK");
+        m_failed += batch.size();
+        for (Pending& pending : batch) {
+            if (pending.succeeded)
+                *pending.succeeded = false;
+        }
+        emit writeFailed(error);
+    }
+
+    const qint64 elapsed = clock.elapsed();
+    if (elapsed > m_maxBatchMs)
+        m_maxBatchMs = elapsed;
+    return true;
+}
+
+bool DatabaseAccess::waitFor(qint64 sequence, int timeoutMs)
+{
+    QDeadlineTimer deadline(timeoutMs);  // negative: never expires
+    QMutexLocker locker(&m_mutex);
+    while (m_doneSequence < sequence) {
+        if (!m_committed.wait(&m_mutex, deadline))
+            return m_doneSequence >= sequence;
+    }
+    return true;
+}
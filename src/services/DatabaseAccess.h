@@ -0,0 +1,234 @@
+#ifndef DATABASEACCESS_H
+#define DATABASEACCESS_H
+
+#include <QObject>
+#include <QList>
+#include <QMutex>
+#include <QSqlDatabase>
+#include <QThreadPool>
+#include <QThreadStorage>
+#include <QVariantList>
+#include <QWaitCondition>
+#include <atomic>
+#include <functional>
+#include <memory>
+
+/**
+ * @brief Per-thread connections to the library database and one writer
+ *
+ * SQLite lets one connection write at a time, and with the default
+ * rollback journal a writer also locks out every reader: while an import
+ * commits, the scheduler's queries and the on-air play count updates
+ * wait for it. DatabaseAccess switches the database to WAL, so readers
+ * work from a snapshot and never wait for a writer, and tunes every
+ * connection it hands out (see configure()).
+ *
+ * - connection() returns a connection owned by the calling thread,
+ *   opened on first use and removed when the thread exits. A
+ *   QSqlDatabase must not be used from two threads, so background work
+ *   takes one of these instead of sharing "xfb_connection".
+ * - write() queues a statement, or a job of several, for the writer
+ *   thread and returns at once. The writer commits everything that
+ *   queued up while it was busy in one transaction, each job in its own
+ *   savepoint, so a failing job never takes the others down with it and
+ *   a burst of small updates costs one commit.
+ *
+ * When the write lock cannot be had (another process holding it past
+ * the busy timeout), the batch goes back to the head of the queue and
+ * is retried with a growing backoff; after kBeginAttempts it is dropped
+ * with a warning and writeFailed().
+ *
+ * Jobs run in submission order. The object must outlive every thread
+ * that took a connection(); the application keeps one for its lifetime.
+ *
+ * @example
+ * @code
+ * DatabaseAccess* access = new DatabaseAccess(db.databaseName(), this);
+ * access->write("UPDATE musics SET played_times = played_times + 1 WHERE path = ?", {path});
+ * @endcode
+ *
+ * @since XFB 2.0
+ */
+class DatabaseAccess : public QObject
+{
+    Q_OBJECT
+
+public:
+    /**
+     * @brief Per-connection SQLite settings
+     */
+    struct Tuning {
+        bool wal = true;
+        QString synchronous = QStringLiteral("NORMAL"); // durable at checkpoints with WAL, no fsync per commit
+        qint64 mmapSize = qint64(256) * 1024 * 1024;
+        int cacheSizeKiB = 16 * 1024;
+        int busyTimeoutMs = 5000;
+    };
+
+    /**
+     * @brief Writer counters
+     */
+    struct Statistics {
+        qint64 jobs = 0;          // jobs run, failed ones included
+        qint64 failed = 0;
+        qint64 batches = 0;       // transactions committed
+        int maxQueued = 0;        // deepest the queue has been
+        qint64 maxBatchMs = 0;    // longest transaction
+    };
+
+    /**
+     * @brief A unit of writing; runs on the writer thread inside a savepoint
+     *
+     * Return false to roll the job's changes back.
+     */
+    using Job = std::function<bool(QSqlDatabase&)>;
+
+    explicit DatabaseAccess(const QString& databaseName, QObject* parent = nullptr);
+    DatabaseAccess(const QString& databaseName, const Tuning& tuning, QObject* parent = nullptr);
+
+    /**
+     * @brief Commits whatever is still queued
+     */
+    ~DatabaseAccess() override;
+
+    QString databaseName() const { return m_databaseName; }
+
+    /**
+     * @brief The calling thread's connection, opened and tuned
+     * @return Open connection, or an invalid/closed one if opening failed
+     */
+    QSqlDatabase connection();
+
+    /**
+     * @brief Queue one statement for the writer
+     * @param sql Statement with positional placeholders
+     * @param values Values bound to the placeholders, in order
+     */
+    void write(const QString& sql, const QVariantList& values = QVariantList());
+
+    /**
+     * @brief Queue a job for the writer
+     * @param job Job to run
+     */
+    void write(Job job);
+
+    /**
+     * @brief Queue a job and block until it has been committed
+     *
+     * For callers that need the outcome; never call it from a job.
+     *
+     * @param job Job to run
+     * @param timeoutMs Timeout in milliseconds, -1 to wait forever
+     * @return true if the job succeeded and its batch was committed
+     */
+    bool writeAndWait(Job job, int timeoutMs = -1);
+
+    /**
+     * @brief Block until everything queued so far has been committed
+     * @param timeoutMs Timeout in milliseconds, -1 to wait forever
+     * @return true if the queue drained in time
+     */
+    bool flush(int timeoutMs = -1);
+
+    /**
+     * @brief Jobs queued or running
+     */
+    int pendingWrites() const;
+
+    Statistics statistics() const;
+
+    /**
+     * @brief Apply tuning to an open SQLite connection
+     *
+     * journal_mode is a property of the database file; the other settings
+     * belong to the connection and must be applied to each one. Other
+     * drivers are left alone.
+     *
+     * @param database Open connection
+     * @param tuning Settings to apply
+     * @return true if every setting was accepted
+     */
+    static bool configure(QSqlDatabase& database, const Tuning& tuning = Tuning());
+
+    /**
+     * @brief Open a named connection for a worker, tuned like connection()'s
+     *
+     * For workers that keep a connection for the length of one run (an
+     * import, a rescan, ...) instead of their thread's: the busy timeout
+     * and configure() settings are the same as everywhere else. Release it
+     * with closeConnection() once every handle to it is out of scope.
+     *
+     * @param connectionName Name to register the connection under
+     * @param driver Qt SQL driver
+     * @param databaseName Database to open
+     * @param tuning Settings to apply
+     * @return The connection; closed if opening failed, lastError() says why
+     */
+    static QSqlDatabase openConnection(const QString& connectionName, const QString& driver,
+                                       const QString& databaseName, const Tuning& tuning = Tuning());
+
+    /**
+     * @brief Close and remove a connection from openConnection()
+     * @param connectionName Name it was registered under
+     */
+    static void closeConnection(const QString& connectionName);
+
+    /**
+     * @brief Current journal mode of a connection's database, lower case
+     */
+    static QString journalMode(const QSqlDatabase& database);
+
+signals:
+    /**
+     * @brief Emitted from the writer thread when a job or commit fails
+     * @param error Error message
+     */
+    void writeFailed(const QString& error);
+
+private:
+    static constexpr int kMaxBatch = 512;        // jobs per transaction
+    static constexpr int kBeginAttempts = 3;     // each waits up to busyTimeoutMs
+    static constexpr int kBeginBackoffMs = 250;  // before the 2nd attempt, doubling after
+
+    struct Pending {
+        Job job;
+        std::shared_ptr<bool> succeeded;          // set for writeAndWait()
+    };
+
+    // Owned by one thread; closes and removes the connection when the
+    // thread exits
+    struct ThreadConnection {
+        QString name;
+        ~ThreadConnection();
+    };
+
+    qint64 enqueue(Pending pending);   // returns the job's sequence number
+    void drain();
+    bool commit(QSqlDatabase& db, QList<Pending>& batch, QString* beginError);
+    bool waitFor(qint64 sequence, int timeoutMs);
+
+    QString m_databaseName;
+    Tuning m_tuning;
+    QString m_connectionPrefix;
+    std::atomic<int> m_connectionCounter{0};
+
+    mutable QMutex m_mutex;
+    QWaitCondition m_committed;
+    QList<Pending> m_queue;
+    qint64 m_queuedSequence = 0;     // jobs ever queued
+    qint64 m_doneSequence = 0;       // jobs finished, committed or not
+    bool m_draining = false;
+
+    std::atomic<qint64> m_jobs{0};
+    std::atomic<qint64> m_failed{0};
+    std::atomic<qint64> m_batches{0};
+    std::atomic<int> m_maxQueued{0};
+    std::atomic<qint64> m_maxBatchMs{0};
+
+    // Declared before the pool: the writer thread's connection is removed
+    // when the pool's thread exits, which needs the storage alive
+    QThreadStorage<ThreadConnection*> m_connections;
+    QThreadPool m_writerPool;
+};
+
+#endif // DATABASEACCESS_H
@@ -1,5 +1,6 @@
 #include "DatabaseOptimizer.h"
 #include "ErrorHandler.h"
+#include "QueryProfiler.h"
 #include <QSqlRecord>
 #include <QJsonDocument>
 #include <QJsonObject>
@@ -16,12 +17,16 @@ DatabaseOptimizer::DatabaseOptimizer(QSqlDatabase& database, QObject* parent)
     , m_optimizationTimer(new QTimer(this))
     , m_autoOptimizationEnabled(false)
     , m_optimizationInterval(DEFAULT_OPTIMIZATION_INTERVAL)
+    , m_reportTimer(new QTimer(this))
 {
     // Setup auto optimization timer
     m_optimizationTimer->setSingleShot(false);
     m_optimizationTimer->setInterval(m_optimizationInterval);
     connect(m_optimizationTimer, &QTimer::timeout, this, &DatabaseOptimizer::performAutoOptimization);
     
+    m_reportTimer->setSingleShot(false);
+    connect(m_reportTimer, &QTimer::timeout, this, &DatabaseOptimizer::emitPerformanceReport);
+    
     // Initialize metrics
     m_metrics = PerformanceMetrics{};
     m_metricsLastUpdated = QDateTime::currentDateTime();
@@ -59,10 +64,12 @@ void DatabaseOptimizer::shutdown()
     
     stopQueryMonitoring();
     m_optimizationTimer->stop();
+    m_reportTimer->stop();
     
     // Clear caches
     QMutexLocker statsLocker(&m_statsMutex);
     m_queryStats.clear();
+    m_patternCache.clear();
     
     QMutexLocker indexLocker(&m_indexMutex);
     m_indexCache.clear();
@@ -103,6 +110,8 @@ bool DatabaseOptimizer::createOptimalIndexes()
         {"idx_music_search", "music", {"artist", "song", "genre1"}, false, ""},
         {"idx_music_popular", "music", {"played_times", "last_played"}, false, "played_times > 0"},
         
+        // The library table (musics) gets its indexes from LibraryMigrations
+        
         // Playlist table indexes (if exists)
         {"idx_playlist_name", "playlist", {"name"}, false, ""},
         {"idx_playlist_created", "playlist", {"created_date"}, false, ""},
@@ -227,6 +236,15 @@ bool DatabaseOptimizer::vacuumDatabase()
         QSqlQuery query(m_database);
         success = query.exec("VACUUM");
         if (success) {
+            // VACUUM may renumber the rowids of musics (no INTEGER PRIMARY
+            // KEY); the full-text index is keyed by them
+            if (query.exec("SELECT 1 FROM sqlite_master WHERE type = 'table' AND name = 'musics_fts'")
+                && query.next()
+                && !query.exec("INSERT INTO musics_fts(musics_fts) VALUES ('rebuild')")) {
+                ErrorHandler::logMessage(ErrorHandler::ErrorSeverity::Warning, "DatabaseOptimizer",
+                                         "Full-text index rebuild failed: " + query.lastError().text());
+            }
+            
             // Update last vacuum time
             QMutexLocker locker(&m_metricsMutex);
             m_metrics.lastVacuum = QDateTime::currentDateTime();
@@ -267,15 +285,28 @@ bool DatabaseOptimizer::reindexDatabase()
 
 void DatabaseOptimizer::startQueryMonitoring(qint64 slowQueryThreshold)
 {
-    QMutexLocker locker(&m_statsMutex);
-    m_slowQueryThreshold = slowQueryThreshold;
-    m_monitoringEnabled = true;
+    {
+        QMutexLocker locker(&m_statsMutex);
+        m_slowQueryThreshold = slowQueryThreshold;
+        m_monitoringEnabled = true;
+    }
+    
+    // Outside m_statsMutex: detach() waits for recorders, which take it
+    QueryProfiler::attach(this,
+        [this](const QString& query, qint64 microseconds) {
+            return recordQueryTime(query, microseconds);
+        },
+        [this](const QString& query, const QString& plan) {
+            recordQueryPlan(query, plan);
+        });
     
     ErrorHandler::logMessage(ErrorHandler::ErrorSeverity::Info, "DatabaseOptimizer", QString("Started query monitoring (slow query threshold: %1ms)").arg(slowQueryThreshold));
 }
 
 void DatabaseOptimizer::stopQueryMonitoring()
 {
+    QueryProfiler::detach(this);
+    
     QMutexLocker locker(&m_statsMutex);
     m_monitoringEnabled = false;
     
@@ -283,55 +314,75 @@ void DatabaseOptimizer::stopQueryMonitoring()
 }
 
 void DatabaseOptimizer::recordQueryExecution(const QString& query, qint64 executionTime)
+{
+    recordQueryTime(query, executionTime * 1000);
+}
+
+bool DatabaseOptimizer::recordQueryTime(const QString& query, qint64 microseconds)
 {
     if (!m_monitoringEnabled) {
-        return;
+        return false;
     }
     
-    QMutexLocker locker(&m_statsMutex);
-    
-    QString pattern = normalizeQuery(query);
-    
-    if (m_queryStats.contains(pattern)) {
+    const qint64 executionTime = microseconds / 1000;
+    bool isSlow = false;
+    bool wantsPlan = false;
+    {
+        QMutexLocker locker(&m_statsMutex);
+        
+        const QString pattern = patternOf(query);
+        const QDateTime now = QDateTime::currentDateTime();
+        isSlow = microseconds >= m_slowQueryThreshold * 1000;
+        
         QueryStats& stats = m_queryStats[pattern];
+        if (stats.executionCount == 0) {
+            stats.queryPattern = pattern;
+            stats.minExecutionTime = executionTime;
+            stats.firstSeen = now;
+        }
         stats.executionCount++;
-        stats.totalExecutionTime += executionTime;
-        stats.averageExecutionTime = stats.totalExecutionTime / stats.executionCount;
+        stats.totalExecutionTimeUs += microseconds;
+        stats.totalExecutionTime = stats.totalExecutionTimeUs / 1000;
+        stats.averageExecutionTime = stats.totalExecutionTimeUs / stats.executionCount / 1000;
         stats.minExecutionTime = qMin(stats.minExecutionTime, executionTime);
         stats.maxExecutionTime = qMax(stats.maxExecutionTime, executionTime);
-        stats.lastSeen = QDateTime::currentDateTime();
+        stats.lastSeen = now;
         
-        if (executionTime >= m_slowQueryThreshold) {
+        if (isSlow) {
             stats.isSlowQuery = true;
+            // One plan per pattern is enough to tell a missing index
+            if (stats.queryPlan.isEmpty() && !stats.planRequested) {
+                stats.planRequested = true;
+                wantsPlan = true;
+            }
         }
-    } else {
-        QueryStats stats;
-        stats.queryPattern = pattern;
-        stats.executionCount = 1;
-        stats.totalExecutionTime = executionTime;
-        stats.averageExecutionTime = executionTime;
-        stats.minExecutionTime = executionTime;
-        stats.maxExecutionTime = executionTime;
-        stats.firstSeen = QDateTime::currentDateTime();
-        stats.lastSeen = QDateTime::currentDateTime();
-        stats.isSlowQuery = (executionTime >= m_slowQueryThreshold);
-        
-        m_queryStats[pattern] = stats;
     }
     
     // Update global metrics
-    QMutexLocker metricsLocker(&m_metricsMutex);
-    m_metrics.totalQueries++;
-    if (executionTime >= m_slowQueryThreshold) {
-        m_metrics.slowQueries++;
+    {
+        QMutexLocker metricsLocker(&m_metricsMutex);
+        m_metrics.totalQueries++;
+        m_totalQueryTimeUs += microseconds;
+        m_metrics.averageQueryTime = m_totalQueryTimeUs / m_metrics.totalQueries / 1000;
+        if (isSlow) {
+            m_metrics.slowQueries++;
+        }
+    }
+    
+    if (isSlow) {
         emit slowQueryDetected(query, executionTime);
     }
     
-    // Update average query time
-    if (m_metrics.totalQueries > 0) {
-        static qint64 totalTime = 0;
-        totalTime += executionTime;
-        m_metrics.averageQueryTime = totalTime / m_metrics.totalQueries;
+    return wantsPlan;
+}
+
+void DatabaseOptimizer::recordQueryPlan(const QString& query, const QString& plan)
+{
+    QMutexLocker locker(&m_statsMutex);
+    
+    auto it = m_queryStats.find(patternOf(query));
+    if (it != m_queryStats.end()) {
+        it->queryPlan = plan;
     }
 }
 
@@ -343,7 +394,7 @@ QList<DatabaseOptimizer::QueryStats> DatabaseOptimizer::getQueryStatistics(int l
     
     // Sort by total execution time (descending)
     std::sort(stats.begin(), stats.end(), [](const QueryStats& a, const QueryStats& b) {
-        return a.totalExecutionTime > b.totalExecutionTime;
+        return a.totalExecutionTimeUs > b.totalExecutionTimeUs;
     });
     
     if (limit > 0 && stats.size() > limit) {
@@ -485,6 +536,20 @@ QList<DatabaseOptimizer::OptimizationRecommendation> DatabaseOptimizer::getOptim
         }
     }
     
+    // Indexes for slow queries whose plans scan a table they filter
+    for (const auto& index : analyzeQueryPatterns()) {
+        OptimizationRecommendation rec;
+        rec.type = OptimizationRecommendation::CreateIndex;
+        rec.description = QString("Create index %1 on %2 (%3) for %4 slow query executions")
+                         .arg(index.name, index.tableName, index.columns.join(", "))
+                         .arg(index.useCount);
+        rec.sqlCommand = QString("CREATE INDEX IF NOT EXISTS %1 ON %2 (%3)")
+                        .arg(index.name, index.tableName, index.columns.join(", "));
+        rec.priority = 7;
+        rec.estimatedImpact = index.useCount * m_slowQueryThreshold / 2;
+        recommendations.append(rec);
+    }
+    
     // Sort by priority (descending)
     std::sort(recommendations.begin(), recommendations.end(), 
               [](const OptimizationRecommendation& a, const OptimizationRecommendation& b) {
@@ -544,6 +609,18 @@ bool DatabaseOptimizer::applyRecommendation(const OptimizationRecommendation& re
                                  .arg(query.lastError().text()));
                 }
             }
+            if (success && recommendation.type == OptimizationRecommendation::CreateIndex) {
+                {
+                    QMutexLocker indexLocker(&m_indexMutex);
+                    m_indexCacheUpdated = QDateTime();
+                }
+                // Plans predate the index: capture them again if still slow
+                QMutexLocker statsLocker(&m_statsMutex);
+                for (auto& stats : m_queryStats) {
+                    stats.queryPlan.clear();
+                    stats.planRequested = false;
+                }
+            }
             break;
     }
     
@@ -553,6 +630,17 @@ bool DatabaseOptimizer::applyRecommendation(const OptimizationRecommendation& re
     return success;
 }
 
+int DatabaseOptimizer::createRecommendedIndexes()
+{
+    int createdCount = 0;
+    for (const auto& rec : getOptimizationRecommendations()) {
+        if (rec.type == OptimizationRecommendation::CreateIndex && applyRecommendation(rec)) {
+            createdCount++;
+        }
+    }
+    return createdCount;
+}
+
 void DatabaseOptimizer::setAutoOptimizationEnabled(bool enabled)
 {
     m_autoOptimizationEnabled = enabled;
@@ -588,11 +676,12 @@ void DatabaseOptimizer::clearQueryStatistics()
 {
     QMutexLocker locker(&m_statsMutex);
     m_queryStats.clear();
+    m_patternCache.clear();
     
     ErrorHandler::logMessage(ErrorHandler::ErrorSeverity::Info, "DatabaseOptimizer", "Query statistics cleared");
 }
 
-QString DatabaseOptimizer::exportPerformanceData()
+QString DatabaseOptimizer::exportPerformanceData(int topQueries)
 {
     QJsonObject root;
     
@@ -623,18 +712,22 @@ QString DatabaseOptimizer::exportPerformanceData()
     
     // Export query statistics
     QJsonArray queryStatsArray;
-    QList<QueryStats> stats = getQueryStatistics(100);
+    QList<QueryStats> stats = getQueryStatistics(topQueries);
     for (const auto& stat : stats) {
         QJsonObject statObj;
         statObj["queryPattern"] = stat.queryPattern;
         statObj["executionCount"] = stat.executionCount;
         statObj["totalExecutionTime"] = static_cast<qint64>(stat.totalExecutionTime);
+        statObj["totalExecutionTimeUs"] = static_cast<qint64>(stat.totalExecutionTimeUs);
         statObj["averageExecutionTime"] = static_cast<qint64>(stat.averageExecutionTime);
         statObj["minExecutionTime"] = static_cast<qint64>(stat.minExecutionTime);
         statObj["maxExecutionTime"] = static_cast<qint64>(stat.maxExecutionTime);
         statObj["isSlowQuery"] = stat.isSlowQuery;
         statObj["firstSeen"] = stat.firstSeen.toString(Qt::ISODate);
         statObj["lastSeen"] = stat.lastSeen.toString(Qt::ISODate);
+        if (!stat.queryPlan.isEmpty()) {
+            statObj["queryPlan"] = stat.queryPlan;
+        }
         queryStatsArray.append(statObj);
     }
     root["queryStatistics"] = queryStatsArray;
@@ -664,6 +757,27 @@ QString DatabaseOptimizer::exportPerformanceData()
     return doc.toJson();
 }
 
+void DatabaseOptimizer::setReportInterval(int intervalMs, int topQueries)
+{
+    m_reportTopQueries = topQueries;
+    
+    if (intervalMs > 0) {
+        m_reportTimer->start(intervalMs);
+    } else {
+        m_reportTimer->stop();
+    }
+}
+
+int DatabaseOptimizer::reportInterval() const
+{
+    return m_reportTimer->isActive() ? m_reportTimer->interval() : 0;
+}
+
+void DatabaseOptimizer::emitPerformanceReport()
+{
+    emit performanceReport(exportPerformanceData(m_reportTopQueries));
+}
+
 void DatabaseOptimizer::performAutoOptimization()
 {
     if (!m_autoOptimizationEnabled) {
@@ -737,6 +851,23 @@ QString DatabaseOptimizer::normalizeQuery(const QString& query)
     return normalized;
 }
 
+QString DatabaseOptimizer::patternOf(const QString& query)
+{
+    // Statements are prepared from a handful of strings; the regular
+    // expressions run once per string, not once per execution
+    auto it = m_patternCache.constFind(query);
+    if (it != m_patternCache.constEnd()) {
+        return it.value();
+    }
+    
+    if (m_patternCache.size() >= PATTERN_CACHE_SIZE) {
+        m_patternCache.clear();
+    }
+    const QString pattern = normalizeQuery(query);
+    m_patternCache.insert(query, pattern);
+    return pattern;
+}
+
 bool DatabaseOptimizer::indexExists(const QString& indexName)
 {
     QSqlQuery query(m_database);
@@ -822,21 +953,150 @@ QList<DatabaseOptimizer::IndexInfo> DatabaseOptimizer::analyzeQueryPatterns()
 {
     QList<IndexInfo> recommendations;
     
-    // This is a simplified implementation
-    // In a real-world scenario, you would analyze actual query patterns
-    // from the query statistics to recommend indexes
-    
-    QMutexLocker locker(&m_statsMutex);
+    QList<QueryStats> planned;
+    {
+        QMutexLocker locker(&m_statsMutex);
+        for (const auto& stats : std::as_const(m_queryStats)) {
+            if (stats.isSlowQuery && !stats.queryPlan.isEmpty()) {
+                planned.append(stats);
+            }
+        }
+    }
+    if (planned.isEmpty()) {
+        return recommendations;
+    }
     
-    for (const auto& stats : m_queryStats.values()) {
-        if (stats.isSlowQuery && stats.executionCount > 10) {
-            // Analyze query pattern and suggest indexes
-            // This would require more sophisticated query parsing
+    // A full scan is "SCAN musics", "SCAN m" for an alias, or "SCAN TABLE
+    // musics [AS m]" before SQLite 3.36. A scan USING an index is not.
+    static const QRegularExpression scanRe(R"(^SCAN (?:TABLE )?(\w+)(?: AS (\w+))?$)");
+    static const QRegularExpression tableRe(R"(\b(?:FROM|JOIN|UPDATE)\s+(\w+)(?:\s+(?:AS\s+)?(\w+))?)");
+    static const QRegularExpression clauseEndRe(R"( (?:GROUP BY|ORDER BY|HAVING|LIMIT) )");
+    static const QRegularExpression predicateRe(
+        R"((?:(\w+)\.)?(\w+)\s*(==|=|<=|>=|<(?!>)|>|\bLIKE\b|\bIN\b|\bBETWEEN\b))");
+    static const QStringList keywords = {"WHERE", "SET", "ON", "JOIN", "LEFT", "INNER", "CROSS",
+                                         "NATURAL", "ORDER", "GROUP", "LIMIT", "INDEXED", "UNION"};
+    
+    QHash<QString, QStringList> columnsOf;
+    QHash<QString, int> byName;
+    const QList<IndexInfo> existing = getIndexInformation();
+    
+    for (const auto& stats : planned) {
+        // Patterns are upper case; map aliases and names to tables
+        QHash<QString, QString> tables;
+        auto tableMatches = tableRe.globalMatch(stats.queryPattern);
+        while (tableMatches.hasNext()) {
+            const QRegularExpressionMatch match = tableMatches.next();
+            tables.insert(match.captured(1), match.captured(1));
+            if (!match.captured(2).isEmpty() && !keywords.contains(match.captured(2))) {
+                tables.insert(match.captured(2), match.captured(1));
+            }
+        }
+        
+        // The filter of the statement; an OR of columns needs an index per
+        // column and is left alone
+        const int wherePos = stats.queryPattern.indexOf(" WHERE ");
+        if (wherePos < 0) {
+            continue;
+        }
+        QString where = stats.queryPattern.mid(wherePos + 7);
+        const QRegularExpressionMatch clauseEnd = clauseEndRe.match(where);
+        if (clauseEnd.hasMatch()) {
+            where.truncate(clauseEnd.capturedStart());
+        }
+        if (where.contains(" OR ")) {
+            continue;
+        }
+        
+        for (const QString& step : stats.queryPlan.split('\n', Qt::SkipEmptyParts)) {
+            const QRegularExpressionMatch scan = scanRe.match(step.trimmed());
+            if (!scan.hasMatch()) {
+                continue;
+            }
+            const QString scanned = (scan.captured(2).isEmpty() ? scan.captured(1) : scan.captured(2)).toUpper();
+            const QString table = tables.value(scanned, scanned);
+            
+            if (!columnsOf.contains(table)) {
+                columnsOf.insert(table, getColumnNames(table));
+            }
+            const QStringList& tableColumns = columnsOf[table];
+            
+            // Equality columns lead; one range or LIKE column may follow
+            QStringList equalities;
+            QString trailing;
+            auto predicates = predicateRe.globalMatch(where);
+            while (predicates.hasNext()) {
+                const QRegularExpressionMatch predicate = predicates.next();
+                const QString qualifier = predicate.captured(1);
+                if (!qualifier.isEmpty() && tables.value(qualifier, qualifier) != table) {
+                    continue;
+                }
+                QString column;
+                for (const QString& candidate : tableColumns) {
+                    if (candidate.compare(predicate.captured(2), Qt::CaseInsensitive) == 0) {
+                        column = candidate;
+                        break;
+                    }
+                }
+                if (column.isEmpty()) {
+                    continue;
+                }
+                
+                const QString op = predicate.captured(3).toUpper();
+                if (op == "=" || op == "==" || op == "IN") {
+                    if (!equalities.contains(column) && equalities.size() < 3) {
+                        equalities.append(column);
+                    }
+                } else if (trailing.isEmpty()) {
+                    // LIKE only uses an index built with its NOCASE collation
+                    trailing = op == "LIKE" ? column + " COLLATE NOCASE" : column;
+                }
+            }
+            
+            QStringList columns = equalities;
+            if (!trailing.isEmpty() && !equalities.contains(trailing)) {
+                columns.append(trailing);
+            }
+            if (columns.isEmpty()) {
+                continue;
+            }
+            
+            // An index leading with the same column is there and unused:
+            // another one would not be either
+            bool covered = false;
+            for (const auto& index : existing) {
+                if (index.tableName.compare(table, Qt::CaseInsensitive) == 0 && !index.columns.isEmpty()
+                    && QString(index.columns.first()).remove('"').simplified()
+                           .compare(columns.first(), Qt::CaseInsensitive) == 0) {
+                    covered = true;
+                    break;
+                }
+            }
+            if (covered) {
+                continue;
+            }
+            
+            QStringList nameParts;
+            for (const QString& column : columns) {
+                nameParts << QString(column).replace(" COLLATE ", "_").toLower();
+            }
+            const QString name = QString("idx_auto_%1_%2").arg(table.toLower(), nameParts.join('_'));
+            
+            auto known = byName.constFind(name);
+            if (known != byName.constEnd()) {
+                recommendations[known.value()].useCount += stats.executionCount;
+                continue;
+            }
+            if (indexExists(name)) {
+                continue;
+            }
             
             IndexInfo recommendation;
+            recommendation.name = name;
+            recommendation.tableName = table.toLower();
+            recommendation.columns = columns;
             recommendation.isRecommended = true;
-            // ... populate recommendation based on query analysis
-            
+            recommendation.useCount = stats.executionCount;
+            byName.insert(name, recommendations.size());
             recommendations.append(recommendation);
         }
     }
@@ -29,6 +29,12 @@
  * - Scheduled maintenance operations
  * - Performance regression detection
  * 
+ * While monitoring, statements run through QueryProfiler are recorded
+ * here. The query plan of a slow statement is captured once per pattern;
+ * a plan that scans a table the statement filters by turns into a
+ * CreateIndex recommendation, which createRecommendedIndexes() applies.
+ * setReportInterval() emits the busiest patterns periodically.
+ * 
  * @example
  * @code
  * DatabaseOptimizer* optimizer = new DatabaseOptimizer(database, this);
@@ -64,6 +70,9 @@ public:
         QDateTime firstSeen;            // When first seen
         QDateTime lastSeen;             // When last seen
         bool isSlowQuery = false;       // Flagged as slow query
+        qint64 totalExecutionTimeUs = 0; // Total execution time in microseconds
+        QString queryPlan;              // EXPLAIN QUERY PLAN of a slow execution
+        bool planRequested = false;     // Plan asked of QueryProfiler
     };
 
     /**
@@ -182,6 +191,13 @@ public:
      */
     void recordQueryExecution(const QString& query, qint64 executionTime);
 
+    /**
+     * @brief Record the query plan of a slow query
+     * @param query SQL query string
+     * @param plan EXPLAIN QUERY PLAN details, one step per line
+     */
+    void recordQueryPlan(const QString& query, const QString& plan);
+
     /**
      * @brief Get query performance statistics
      * @param limit Maximum number of results to return
@@ -220,6 +236,16 @@ public:
      */
     bool applyRecommendation(const OptimizationRecommendation& recommendation);
 
+    /**
+     * @brief Create the indexes recommended from slow query plans
+     *
+     * Unlike performAutoOptimization(), nothing but indexes: no VACUUM,
+     * which may renumber the rowids other tables refer to.
+     *
+     * @return Number of indexes created
+     */
+    int createRecommendedIndexes();
+
     /**
      * @brief Set automatic optimization enabled/disabled
      * @param enabled true to enable automatic optimization
@@ -251,9 +277,23 @@ public:
 
     /**
      * @brief Export performance data to JSON
+     * @param topQueries Query patterns to include, by total execution time
      * @return JSON string containing performance data
      */
-    QString exportPerformanceData();
+    QString exportPerformanceData(int topQueries = 100);
+
+    /**
+     * @brief Emit performanceReport() periodically
+     * @param intervalMs Interval in milliseconds, 0 to stop
+     * @param topQueries Query patterns per report
+     */
+    void setReportInterval(int intervalMs, int topQueries = 10);
+
+    /**
+     * @brief Get the current report interval
+     * @return Interval in milliseconds, 0 if stopped
+     */
+    int reportInterval() const;
 
 signals:
     /**
@@ -283,6 +323,12 @@ signals:
      */
     void metricsUpdated(const PerformanceMetrics& metrics);
 
+    /**
+     * @brief Emitted every report interval
+     * @param json exportPerformanceData() with the top query patterns
+     */
+    void performanceReport(const QString& json);
+
 private slots:
     /**
      * @brief Perform automatic optimization checks
@@ -294,7 +340,20 @@ private slots:
      */
     void updateMetrics();
 
+    /**
+     * @brief Emit performanceReport()
+     */
+    void emitPerformanceReport();
+
 private:
+    /**
+     * @brief Record a query timed by QueryProfiler
+     * @param query SQL query string
+     * @param microseconds Execution time in microseconds
+     * @return true if the query plan should be captured
+     */
+    bool recordQueryTime(const QString& query, qint64 microseconds);
+
     /**
      * @brief Normalize query for pattern matching
      * @param query Raw SQL query
@@ -302,6 +361,12 @@ private:
      */
     QString normalizeQuery(const QString& query);
 
+    /**
+     * @brief Normalized pattern of a query, cached by query string
+     * @note Call with m_statsMutex held
+     */
+    QString patternOf(const QString& query);
+
     /**
      * @brief Check if an index exists
      * @param indexName Name of the index
@@ -346,7 +411,13 @@ private:
 
     /**
      * @brief Analyze query patterns to recommend indexes
-     * @return List of recommended indexes
+     *
+     * Looks at the captured plans of slow queries for full table scans
+     * and proposes an index on the columns the query filters that table
+     * by: equality columns first, then one range or LIKE column.
+     *
+     * @return List of recommended indexes; useCount is the number of
+     *         slow executions each would have served
      */
     QList<IndexInfo> analyzeQueryPatterns();
 
@@ -389,8 +460,10 @@ private:
     // Query monitoring
     mutable QMutex m_statsMutex;
     QHash<QString, QueryStats> m_queryStats;
+    QHash<QString, QString> m_patternCache;
     qint64 m_slowQueryThreshold;
     bool m_monitoringEnabled;
+    qint64 m_totalQueryTimeUs = 0;
     
     // Index management
     mutable QMutex m_indexMutex;
@@ -402,6 +475,10 @@ private:
     bool m_autoOptimizationEnabled;
     int m_optimizationInterval;
     
+    // Periodic reports
+    QTimer* m_reportTimer;
+    int m_reportTopQueries = 10;
+    
     // Performance metrics
     mutable QMutex m_metricsMutex;
     PerformanceMetrics m_metrics;
@@ -412,6 +489,7 @@ private:
     static constexpr int DEFAULT_OPTIMIZATION_INTERVAL = 3600000; // 1 hour
     static constexpr int INDEX_CACHE_DURATION = 300000; // 5 minutes
     static constexpr int METRICS_CACHE_DURATION = 60000; // 1 minute
+    static constexpr int PATTERN_CACHE_SIZE = 1000;
 };
 
 #endif // DATABASEOPTIMIZER_H
\ No newline at end of file
@@ -1,4 +1,5 @@
 #include "DatabaseService.h"
+#include "QueryProfiler.h"
 #include <QSqlDatabase>
 #include <QSqlQuery>
 #include <QSqlError>
@@ -276,7 +277,7 @@ bool DatabaseService::executeQuery(const QString& queryString, const QVariantLis
         query.addBindValue(value);
     }
     
-    if (!query.exec()) {
+    if (!QueryProfiler::exec(query)) {
         QMutexLocker statsLocker(&m_statsMutex);
         m_failedQueries++;
         statsLocker.unlock();
@@ -317,7 +318,7 @@ QList<QVariantMap> DatabaseService::executeSelect(const QString& queryString, co
         query.addBindValue(value);
     }
     
-    if (!query.exec()) {
+    if (!QueryProfiler::exec(query)) {
         QMutexLocker statsLocker(&m_statsMutex);
         m_failedQueries++;
         statsLocker.unlock();
@@ -492,6 +493,14 @@ bool DatabaseService::optimizeDatabase()
         return false;
     }
     
+    // VACUUM may renumber the rowids of musics (it has no INTEGER PRIMARY
+    // KEY), and the full-text index is keyed by them
+    if (query.exec("SELECT 1 FROM sqlite_master WHERE type = 'table' AND name = 'musics_fts'")
+        && query.next()
+        && !query.exec("INSERT INTO musics_fts(musics_fts) VALUES ('rebuild')")) {
+        logSqlError(query.lastError(), "musics_fts rebuild", "Database optimization");
+    }
+    
     // ANALYZE to update query planner statistics
     if (!query.exec("ANALYZE")) {
         logSqlError(query.lastError(), "ANALYZE", "Database optimization");
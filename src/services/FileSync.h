@@ -0,0 +1,28 @@
+#ifndef FILESYNC_H
+#define FILESYNC_H
+
+#include <QFileDevice>
+#include <QString>
+
+/**
+ * @brief Durable writes: data on the disk, not only in the OS cache
+ *
+ * Shared by everything that writes a file next to another one and swaps
+ * it in (TranscodeQueue, TrackTrimmer) or must survive a crash as written
+ * (RecordingSegmenter).
+ */
+namespace FileSync
+{
+
+/** flush() plus fsync of an open file. */
+bool syncToDisk(QFileDevice& file);
+
+/** fsync of a closed file, before it replaces anything. */
+bool syncFile(const QString& path);
+
+/** Make a new file's directory entry durable too; a no-op on Windows. */
+void syncDirectory(const QString& directory);
+
+} // namespace FileSync
+
+#endif // FILESYNC_H
@@ -0,0 +1,368 @@
+#include "LibraryImporter.h"
+#include "DatabaseAccess.h"
+#include <QCoreApplication>
+#include <QDir>
+#include <QDirIterator>
+#include <QFileInfo>
+#include <QSqlError>
+#include <QSqlQuery>
+#include <QThread>
+#include <QTime>
+#include <QDebug>
+
+LibraryImporter::LibraryImporter(const QSqlDatabase& database, QObject* parent)
+    : QObject(parent)
+    , m_databaseName(database.databaseName())
+    , m_driver(database.driverName())
+    , m_connectionName(QString("LibraryImporter_%1").arg(quintptr(this), 0, 16))
+{
+    qRegisterMetaType<LibraryImporter::Statistics>();
+
+    // Walking is I/O bound and a handful of threads saturate a disk;
+    // the extractor pool is sized per import in start()
+    m_walkPool.setMaxThreadCount(4);
+    m_writerPool.setMaxThreadCount(1);
+
+    m_progressTimer.setInterval(kProgressIntervalMs);
+    connect(&m_progressTimer, &QTimer::timeout, this, [this]() {
+        const Statistics stats = statistics();
+        emit progress(stats.processed(), stats.filesFound, stats.filesPerSecond());
+    });
+}
+
+LibraryImporter::~LibraryImporter()
+{
+    cancel();
+    // The writer waits for the walkers and extractors before it returns
+    m_writerPool.waitForDone();
+}
+
+void LibraryImporter::setDurationProbe(DurationProbe probe)
+{
+    m_probe = std::move(probe);
+}
+
+QStringList LibraryImporter::defaultExtensions()
+{
+    return {"mp3", "wav", "ogg", "flac", "aac", "m4a", "wma", "opus"};
+}
+
+bool LibraryImporter::start(const Options& options)
+{
+    if (m_running) {
+        qWarning() << "LibraryImporter: an import is already running";
+        return false;
+    }
+
+    if (options.directory.isEmpty() || !QDir(options.directory).exists()) {
+        emit importError(tr("Directory does not exist: %1").arg(options.directory));
+        return false;
+    }
+
+    m_options = options;
+    m_options.batchSize = qMax(1, options.batchSize);
+    m_root = QDir::cleanPath(options.directory);
+    m_extensions.clear();
+    for (const QString& extension : options.extensions.isEmpty() ? defaultExtensions() : options.extensions)
+        m_extensions << extension.toLower();
+    m_extractPool.setMaxThreadCount(options.extractors > 0 ? options.extractors
+                                                           : QThread::idealThreadCount());
+
+    m_knownPaths.clear();
+    m_queue.clear();
+    m_inputDone = false;
+    m_cancelled = false;
+    m_found = 0;
+    m_imported = 0;
+    m_duplicates = 0;
+    m_failed = 0;
+    m_elapsedMs = 0;
+
+    // The root walk is counted here, before the writer submits it, so the
+    // pipeline cannot look drained while the known paths are still loading
+    m_pendingTasks = 1;
+    m_running = true;
+    const int run = ++m_run;
+    m_clock.start();
+    m_progressTimer.start();
+
+    m_writerPool.start([this, run]() { runWriter(run); });
+    return true;
+}
+
+void LibraryImporter::cancel()
+{
+    if (!m_running)
+        return;
+
+    m_cancelled = true;
+    QMutexLocker locker(&m_queueMutex);
+    m_queueReady.wakeAll();
+}
+
+bool LibraryImporter::waitForFinished(int timeoutMs)
+{
+    if (!m_running)
+        return true;
+    if (!m_writerPool.waitForDone(timeoutMs))
+        return false;
+
+    // Deliver the batches' rowsAdded() (and the writer's own finish call)
+    // before finished(), in the order the writer queued them
+    QCoreApplication::sendPostedEvents(this, QEvent::MetaCall);
+    finish(m_run);
+    return true;
+}
+
+LibraryImporter::Statistics LibraryImporter::statistics() const
+{
+    Statistics stats;
+    stats.filesFound = m_found;
+    stats.imported = m_imported;
+    stats.duplicates = m_duplicates;
+    stats.failed = m_failed;
+    stats.elapsedMs = m_running ? m_clock.elapsed() : m_elapsedMs.load();
+    stats.cancelled = m_cancelled;
+    return stats;
+}
+
+MusicItem LibraryImporter::itemForFile(const QString& root, const QString& filePath, const Options& options)
+{
+    // Same rule as the original "Add directory" dialog, so rows imported
+    // now look like the ones already in the library: "Artist - Song.ext",
+    // where the artist part may include subdirectories
+    QString name = QDir(root).relativeFilePath(filePath);
+    const QString suffix = QFileInfo(filePath).suffix();
+    if (!suffix.isEmpty())
+        name.chop(suffix.size() + 1);
+
+    auto clean = [](QString part) {
+        return part.replace("_", " ").replace(".mp3", "").replace(".mp4", "")
+                   .replace(".ogg", "").replace(".wav", "").replace(".flac", "").trimmed();
+    };
+
+    const QStringList parts = name.split("-");
+
+    MusicItem music;
+    music.artist = options.artist.isEmpty() ? clean(parts.value(0)) : options.artist;
+    music.song = clean(parts.value(1));
+    if (music.song.isEmpty())
+        music.song = "-";
+    music.genre1 = options.genre1;
+    music.genre2 = options.genre2;
+    music.country = options.country;
+    music.publishedDate = options.publishedDate;
+    music.path = filePath;
+    return music;
+}
+
+void LibraryImporter::taskDone()
+{
+    if (--m_pendingTasks == 0) {
+        QMutexLocker locker(&m_queueMutex);
+        m_inputDone = true;
+        m_queueReady.wakeAll();
+    }
+}
+
+bool LibraryImporter::loadKnownPaths(QSqlDatabase& db)
+{
+    QSqlQuery query(db);
+    query.setForwardOnly(true);
+    if (!query.exec("SELECT path FROM musics")) {
+        qWarning() << "LibraryImporter: could not read library paths:" << query.lastError().text();
+        return false;
+    }
+    while (query.next())
+        m_knownPaths.insert(query.value(0).toString());
+    return true;
+}
+
+void LibraryImporter::walkDirectory(const QString& path)
+{
+    QStringList files;
+
+    QDirIterator it(path, QDir::Files | QDir::Dirs | QDir::NoDotAndDotDot);
+    while (it.hasNext() && !m_cancelled) {
+        const QString entry = it.next();
+        const QFileInfo info = it.fileInfo();
+
+        if (info.isDir()) {
+            // Symlinked directories are skipped, as QDirIterator::Subdirectories
+            // without FollowSymlinks did, so a link loop cannot hang the walk
+            if (m_options.recursive && !info.isSymLink()) {
+                ++m_pendingTasks;
+                m_walkPool.start([this, entry]() { walkDirectory(entry); });
+            }
+            continue;
+        }
+
+        if (!m_extensions.contains(info.suffix().toLower()))
+            continue;
+
+        ++m_found;
+        if (m_knownPaths.contains(entry)) {
+            ++m_duplicates;
+            continue;
+        }
+
+        files << entry;
+        if (files.size() >= kFilesPerExtractTask) {
+            ++m_pendingTasks;
+            m_extractPool.start([this, files]() { extractFiles(files); });
+            files.clear();
+        }
+    }
+
+    if (!files.isEmpty() && !m_cancelled) {
+        ++m_pendingTasks;
+        m_extractPool.start([this, files]() { extractFiles(files); });
+    }
+
+    taskDone();
+}
+
+void LibraryImporter::extractFiles(const QStringList& files)
+{
+    QList<MusicItem> items;
+    items.reserve(files.size());
+
+    for (const QString& file : files) {
+        if (m_cancelled)
+            break;
+
+        MusicItem music = itemForFile(m_root, file, m_options);
+        if (m_probe) {
+            const qint64 durationMs = m_probe(file);
+            if (durationMs > 0)
+                music.time = QTime(0, 0).addMSecs(durationMs).toString("h:mm:ss");
+        }
+        items << music;
+    }
+
+    if (!items.isEmpty()) {
+        QMutexLocker locker(&m_queueMutex);
+        m_queue << items;
+        if (m_queue.size() >= m_options.batchSize)
+            m_queueReady.wakeOne();
+    }
+
+    taskDone();
+}
+
+void LibraryImporter::writeBatch(QSqlDatabase& db, const QList<MusicItem>& batch)
+{
+    if (!db.transaction()) {
+        qWarning() << "LibraryImporter: could not start a transaction:" << db.lastError().text();
+        m_failed += batch.size();
+        return;
+    }
+
+    // The known-path set already filtered the walk; NOT EXISTS (served by
+    // idx_musics_path) only catches rows another writer added meanwhile
+    QSqlQuery query(db);
+    query.prepare("INSERT INTO musics (artist, song, genre1, genre2, country, published_date, path, time, played_times, last_played) "
+                  "SELECT ?, ?, ?, ?, ?, ?, ?, ?, 0, '' "
+                  "WHERE NOT EXISTS (SELECT 1 FROM musics WHERE path = ?)");
+
+    int added = 0;
+    int duplicates = 0;
+    int failed = 0;
+    for (const MusicItem& music : batch) {
+        query.addBindValue(music.artist);
+        query.addBindValue(music.song);
+        query.addBindValue(music.genre1);
+        query.addBindValue(music.genre2);
+        query.addBindValue(music.country);
+        query.addBindValue(music.publishedDate);
+        query.addBindValue(music.path);
+        query.addBindValue(music.time);
+        query.addBindValue(music.path);
+
+        if (!query.exec()) {
+            qWarning() << "LibraryImporter: failed to add" << music.path << query.lastError().text();
+            ++failed;
+        } else if (query.numRowsAffected() > 0) {
+            ++added;
+        } else {
+            ++duplicates;
+        }
+    }
+
+    if (!db.commit()) {
+        qWarning() << "LibraryImporter: could not commit a batch:" << db.lastError().text();
+        db.rollback();
+        m_failed += batch.size();
+        return;
+    }
+
+    m_imported += added;
+    m_duplicates += duplicates;
+    m_failed += failed;
+    if (added > 0)
+        QMetaObject::invokeMethod(this, [this, added]() { emit rowsAdded(added); }, Qt::QueuedConnection);
+}
+
+void LibraryImporter::runWriter(int run)
+{
+    {
+        QSqlDatabase db = DatabaseAccess::openConnection(m_connectionName, m_driver, m_databaseName);
+        if (!db.isOpen() || !loadKnownPaths(db)) {
+            const QString error = tr("Could not open the library: %1").arg(db.lastError().text());
+            QMetaObject::invokeMethod(this, [this, error]() { emit importError(error); }, Qt::QueuedConnection);
+        } else {
+            m_walkPool.start([this]() { walkDirectory(m_root); });
+
+            for (;;) {
+                QList<MusicItem> batch;
+                {
+                    QMutexLocker locker(&m_queueMutex);
+                    while (m_queue.size() < m_options.batchSize && !m_inputDone && !m_cancelled) {
+                        // Commit what there is if the extractors are slow
+                        // (duration probes), so rows show up steadily
+                        if (!m_queueReady.wait(&m_queueMutex, kMaxBatchWaitMs) && !m_queue.isEmpty())
+                            break;
+                    }
+                    if (m_cancelled)
+                        break;
+
+                    batch = m_queue.mid(0, m_options.batchSize);
+                    m_queue.remove(0, batch.size());
+                    if (batch.isEmpty() && m_inputDone)
+                        break;
+                }
+
+                if (!batch.isEmpty())
+                    writeBatch(db, batch);
+            }
+
+            // Let the walkers and extractors see the flag and drain; walkers
+            // go first since they are the only ones feeding the extractors
+            m_walkPool.waitForDone();
+            m_extractPool.waitForDone();
+        }
+    }
+    DatabaseAccess::closeConnection(m_connectionName);
+
+    m_elapsedMs = m_clock.elapsed();
+    QMetaObject::invokeMethod(this, [this, run]() { finish(run); }, Qt::QueuedConnection);
+}
+
+void LibraryImporter::finish(int run)
+{
+    // Both the writer and waitForFinished() end up here; only the first
+    // call for the current run counts
+    if (run != m_run || !m_running)
+        return;
+
+    m_progressTimer.stop();
+    m_running = false;
+
+    const Statistics stats = statistics();
+    qInfo() << "LibraryImporter: imported" << stats.imported << "of" << stats.filesFound
+            << "files," << stats.duplicates << "duplicates," << stats.failed << "failed,"
+            << QString::number(stats.filesPerSecond(), 'f', 1) << "files/s";
+
+    emit progress(stats.processed(), stats.filesFound, stats.filesPerSecond());
+    emit finished(stats);
+}
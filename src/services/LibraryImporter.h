@@ -0,0 +1,245 @@
+#ifndef LIBRARYIMPORTER_H
+#define LIBRARYIMPORTER_H
+
+#include <QObject>
+#include <QList>
+#include <QMutex>
+#include <QSet>
+#include <QSqlDatabase>
+#include <QStringList>
+#include <QThreadPool>
+#include <QTimer>
+#include <QWaitCondition>
+#include <QElapsedTimer>
+#include <atomic>
+#include <functional>
+
+#include "../repositories/MusicRepository.h"
+
+/**
+ * @brief Staged, parallel import of a directory tree into the musics table
+ *
+ * An import runs as a pipeline, entirely off the GUI thread:
+ * - walkers list directories in parallel, one task per directory;
+ * - files whose path is already in the library are dropped right there,
+ *   against an in-memory set of every known path loaded once up front;
+ * - a pool of extractors turns the remaining files into MusicItems (file
+ *   name rule plus the optional duration probe);
+ * - a single writer, on its own connection, inserts them in transactions
+ *   of Options::batchSize rows.
+ *
+ * Progress is sampled from counters on a timer rather than emitted per
+ * file, and rowsAdded() fires once per committed batch, so a 40k-file
+ * archive costs the GUI a few hundred signals, not a few hundred thousand.
+ *
+ * @example
+ * @code
+ * LibraryImporter* importer = new LibraryImporter(database, this);
+ * importer->setDurationProbe(probe);
+ * connect(importer, &LibraryImporter::finished, this, &Dialog::onImported);
+ *
+ * LibraryImporter::Options options;
+ * options.directory = "/media/archive";
+ * options.genre1 = "Pop";
+ * importer->start(options);
+ * @endcode
+ *
+ * @since XFB 2.0
+ */
+class LibraryImporter : public QObject
+{
+    Q_OBJECT
+
+public:
+    /**
+     * @brief What to import and the values every imported row gets
+     */
+    struct Options {
+        QString directory;
+        bool recursive = true;
+        QStringList extensions;   // empty for the usual audio formats
+        int batchSize = 500;      // rows per writer transaction
+        int extractors = 0;       // 0 for QThread::idealThreadCount()
+
+        QString artist;           // empty: read from the file name
+        QString genre1;
+        QString genre2;
+        QString country;
+        QString publishedDate;
+    };
+
+    /**
+     * @brief Counters of a running or finished import
+     */
+    struct Statistics {
+        int filesFound = 0;       // audio files seen by the walkers
+        int imported = 0;         // rows committed
+        int duplicates = 0;       // already in the library
+        int failed = 0;           // rejected by the database
+        qint64 elapsedMs = 0;
+        bool cancelled = false;
+
+        int processed() const { return imported + duplicates + failed; }
+        double filesPerSecond() const {
+            return elapsedMs > 0 ? processed() * 1000.0 / elapsedMs : 0.0;
+        }
+    };
+
+    /**
+     * @brief Duration of a file in milliseconds, 0 when unknown
+     *
+     * Called on extractor threads, so it must be thread-safe. A file the
+     * probe cannot read is still imported, without a duration, as the
+     * old exiftool-based import did.
+     */
+    using DurationProbe = std::function<qint64(const QString& filePath)>;
+
+    /**
+     * @brief Constructor
+     * @param database Library database; the writer opens its own
+     *        connection to the same file, so it cannot be ":memory:"
+     * @param parent Parent object
+     */
+    explicit LibraryImporter(const QSqlDatabase& database, QObject* parent = nullptr);
+    ~LibraryImporter() override;
+
+    /**
+     * @brief Probe used by the extractors to fill in MusicItem::time
+     * @param probe Thread-safe probe, or nullptr to leave time empty
+     */
+    void setDurationProbe(DurationProbe probe);
+
+    /**
+     * @brief Start importing in the background
+     * @param options Import options
+     * @return false if an import is already running or the directory is missing
+     */
+    bool start(const Options& options);
+
+    /**
+     * @brief Stop the running import; rows already committed stay
+     */
+    void cancel();
+
+    /**
+     * @brief Check if an import is running
+     * @return true while the pipeline has work in flight
+     */
+    bool isRunning() const { return m_running; }
+
+    /**
+     * @brief Block until the running import has finished
+     *
+     * Must be called from the importer's own thread; finished() has been
+     * emitted when this returns true.
+     *
+     * @param timeoutMs Timeout in milliseconds, -1 to wait forever
+     * @return true if no import is running any more
+     */
+    bool waitForFinished(int timeoutMs = -1);
+
+    /**
+     * @brief Current counters
+     * @return Statistics of the running or last import
+     */
+    Statistics statistics() const;
+
+    /**
+     * @brief Build the row for a file the way "Add directory" always has
+     *
+     * The path relative to the import root is split on '-': artist before,
+     * song after, with '_' read as a space and the extension dropped.
+     *
+     * @param root Import root directory
+     * @param filePath File inside root
+     * @param options Values shared by every row
+     * @return MusicItem without a duration
+     */
+    static MusicItem itemForFile(const QString& root, const QString& filePath, const Options& options);
+
+    /**
+     * @brief Default audio file extensions
+     * @return Lower-case extensions without the dot
+     */
+    static QStringList defaultExtensions();
+
+signals:
+    /**
+     * @brief Emitted at most every kProgressIntervalMs while importing
+     * @param processed Files imported, skipped or failed so far
+     * @param found Audio files found so far
+     * @param filesPerSecond Current throughput
+     */
+    void progress(int processed, int found, double filesPerSecond);
+
+    /**
+     * @brief Emitted once per committed batch
+     * @param count Rows added by the batch
+     */
+    void rowsAdded(int count);
+
+    /**
+     * @brief Emitted when the import has finished or been cancelled
+     * @param statistics Final counters
+     */
+    void finished(const LibraryImporter::Statistics& statistics);
+
+    /**
+     * @brief Emitted when the import cannot proceed
+     * @param error Error message
+     */
+    void importError(const QString& error);
+
+private:
+    static constexpr int kProgressIntervalMs = 100;
+    static constexpr int kFilesPerExtractTask = 32;
+    static constexpr int kMaxBatchWaitMs = 250; // commit a partial batch after this
+
+    void walkDirectory(const QString& path);
+    void extractFiles(const QStringList& files);
+    void runWriter(int run);
+    void writeBatch(QSqlDatabase& db, const QList<MusicItem>& batch);
+    void taskDone();
+    bool loadKnownPaths(QSqlDatabase& db);
+    void finish(int run);
+
+    QString m_databaseName;
+    QString m_driver;
+    QString m_connectionName;
+    int m_run = 0;              // bumped by start(), guards stale finish() calls
+    DurationProbe m_probe;
+    Options m_options;
+    QString m_root;
+    QStringList m_extensions;
+
+    QThreadPool m_walkPool;
+    QThreadPool m_extractPool;
+    QThreadPool m_writerPool;
+
+    // Paths in the library when the import started; read-only once the
+    // walkers run
+    QSet<QString> m_knownPaths;
+
+    // Extractor -> writer queue
+    QMutex m_queueMutex;
+    QWaitCondition m_queueReady;
+    QList<MusicItem> m_queue;
+    bool m_inputDone = false;
+
+    std::atomic<int> m_pendingTasks{0}; // walk and extract tasks in flight
+    std::atomic<bool> m_cancelled{false};
+    std::atomic<bool> m_running{false};
+
+    std::atomic<int> m_found{0};
+    std::atomic<int> m_imported{0};
+    std::atomic<int> m_duplicates{0};
+    std::atomic<int> m_failed{0};
+    QElapsedTimer m_clock;
+    std::atomic<qint64> m_elapsedMs{0};
+
+    QTimer m_progressTimer;
+};
+
+Q_DECLARE_METATYPE(LibraryImporter::Statistics)
+
+#endif // LIBRARYIMPORTER_H
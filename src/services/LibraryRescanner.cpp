@@ -0,0 +1,758 @@
+#include "LibraryRescanner.h"
+#include "DatabaseAccess.h"
+#include <QCoreApplication>
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDir>
+#include <QDirIterator>
+#include <QFile>
+#include <QFileInfo>
+#include <QSqlError>
+#include <QSqlQuery>
+#include <QThread>
+#include <QTime>
+#include <QDebug>
+#include <functional>
+#include <vector>
+
+#ifdef Q_OS_UNIX
+#include <sys/stat.h>
+#endif
+
+namespace {
+
+constexpr qint64 kHashChunkBytes = 64 * 1024;
+
+// Prefix of the paths under directory, with the trailing separator
+QString directoryPrefix(const QString& directory)
+{
+    return directory.endsWith('/') ? directory : directory + '/';
+}
+
+// Run work(0..count-1) on pool and wait for it
+void forEachParallel(QThreadPool& pool, int count, const std::atomic<bool>& cancelled,
+                     const std::function<void(int)>& work)
+{
+    if (count <= 0)
+        return;
+
+    const int chunk = qMax(1, count / (pool.maxThreadCount() * 4));
+    for (int begin = 0; begin < count; begin += chunk) {
+        const int end = qMin(count, begin + chunk);
+        pool.start([&work, &cancelled, begin, end]() {
+            for (int i = begin; i < end && !cancelled; ++i)
+                work(i);
+        });
+    }
+    pool.waitForDone();
+}
+
+} // namespace
+
+LibraryRescanner::LibraryRescanner(const QSqlDatabase& database, QObject* parent)
+    : QObject(parent)
+    , m_databaseName(database.databaseName())
+    , m_driver(database.driverName())
+    , m_connectionName(QString("LibraryRescanner_%1").arg(quintptr(this), 0, 16))
+{
+    qRegisterMetaType<LibraryRescanner::Statistics>();
+
+    m_walkPool.setMaxThreadCount(4);
+    m_scanPool.setMaxThreadCount(1);
+
+    m_progressTimer.setInterval(kProgressIntervalMs);
+    connect(&m_progressTimer, &QTimer::timeout, this, [this]() {
+        const Statistics stats = statistics();
+        emit progress(stats.scanned, stats.changes());
+    });
+
+    m_watchTimer.setSingleShot(true);
+    m_watchTimer.setInterval(kWatchDelayMs);
+    connect(&m_watchTimer, &QTimer::timeout, this, &LibraryRescanner::rescanChangedDirectories);
+    connect(&m_watcher, &QFileSystemWatcher::directoryChanged, this, &LibraryRescanner::directoryChanged);
+}
+
+LibraryRescanner::~LibraryRescanner()
+{
+    cancel();
+    m_scanPool.waitForDone();
+}
+
+void LibraryRescanner::setDurationProbe(LibraryImporter::DurationProbe probe)
+{
+    m_probe = std::move(probe);
+}
+
+bool LibraryRescanner::start(const Options& options)
+{
+    return startScan(options, options.roots);
+}
+
+bool LibraryRescanner::startScan(const Options& options, const QStringList& scope)
+{
+    if (m_running) {
+        qWarning() << "LibraryRescanner: a rescan is already running";
+        return false;
+    }
+
+    // Skip missing directories instead of treating everything under them
+    // as deleted: a root on an unmounted drive must not empty the library
+    QStringList directories;
+    for (const QString& directory : scope) {
+        const QString clean = QDir::cleanPath(directory);
+        if (clean.isEmpty() || directories.contains(clean))
+            continue;
+        if (!QFileInfo(clean).isDir()) {
+            qWarning() << "LibraryRescanner: skipping missing directory" << clean;
+            continue;
+        }
+        directories << clean;
+    }
+
+    // A directory inside another one is walked by the outer one already
+    if (options.recursive) {
+        QStringList outer;
+        for (const QString& directory : directories) {
+            bool nested = false;
+            for (const QString& other : directories) {
+                if (other != directory && directory.startsWith(directoryPrefix(other))) {
+                    nested = true;
+                    break;
+                }
+            }
+            if (!nested)
+                outer << directory;
+        }
+        directories = outer;
+    }
+
+    if (directories.isEmpty()) {
+        emit rescanError(tr("None of the library folders could be found"));
+        return false;
+    }
+
+    m_options = options;
+    m_options.batchSize = qMax(1, options.batchSize);
+    m_options.roots.clear();
+    for (const QString& root : options.roots)
+        m_options.roots << QDir::cleanPath(root);
+    m_scope = directories;
+
+    m_extensions.clear();
+    for (const QString& extension : options.extensions.isEmpty() ? LibraryImporter::defaultExtensions()
+                                                                 : options.extensions)
+        m_extensions << extension.toLower();
+    m_workPool.setMaxThreadCount(options.workers > 0 ? options.workers : QThread::idealThreadCount());
+
+    m_manifest.clear();
+    m_libraryPaths.clear();
+    m_seen.clear();
+    m_changed.clear();
+    m_new.clear();
+    m_baseline.clear();
+    m_directories.clear();
+
+    m_cancelled = false;
+    m_scanned = 0;
+    m_unchanged = 0;
+    m_added = 0;
+    m_updated = 0;
+    m_moved = 0;
+    m_removed = 0;
+    m_failed = 0;
+    m_elapsedMs = 0;
+
+    m_running = true;
+    const int run = ++m_run;
+    m_clock.start();
+    m_progressTimer.start();
+
+    m_scanPool.start([this, run]() { runScan(run); });
+    return true;
+}
+
+void LibraryRescanner::cancel()
+{
+    m_cancelled = true;
+}
+
+bool LibraryRescanner::waitForFinished(int timeoutMs)
+{
+    if (!m_running)
+        return true;
+    if (!m_scanPool.waitForDone(timeoutMs))
+        return false;
+
+    QCoreApplication::sendPostedEvents(this, QEvent::MetaCall);
+    finish(m_run);
+    return true;
+}
+
+LibraryRescanner::Statistics LibraryRescanner::statistics() const
+{
+    Statistics stats;
+    stats.scanned = m_scanned;
+    stats.unchanged = m_unchanged;
+    stats.added = m_added;
+    stats.updated = m_updated;
+    stats.moved = m_moved;
+    stats.removed = m_removed;
+    stats.failed = m_failed;
+    stats.elapsedMs = m_running ? m_clock.elapsed() : m_elapsedMs.load();
+    stats.cancelled = m_cancelled;
+    return stats;
+}
+
+LibraryRescanner::FileState LibraryRescanner::fileState(const QFileInfo& info)
+{
+    FileState state;
+    if (!info.exists())
+        return state;
+
+    state.size = info.size();
+    state.modifiedMs = info.lastModified().toMSecsSinceEpoch();
+#ifdef Q_OS_UNIX
+    struct stat st;
+    if (::stat(QFile::encodeName(info.filePath()).constData(), &st) == 0)
+        state.inode = static_cast<quint64>(st.st_ino);
+#endif
+    return state;
+}
+
+QByteArray LibraryRescanner::contentHash(const QString& filePath)
+{
+    QFile file(filePath);
+    if (!file.open(QIODevice::ReadOnly))
+        return QByteArray();
+
+    // Enough to tell two files apart (tags live at either end, audio in
+    // between) without reading whole albums on every rescan
+    const qint64 size = file.size();
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    hash.addData(QByteArray::number(size));
+    hash.addData(file.read(kHashChunkBytes));
+    if (size > kHashChunkBytes) {
+        file.seek(qMax(kHashChunkBytes, size - kHashChunkBytes));
+        hash.addData(file.read(kHashChunkBytes));
+    }
+    return hash.result();
+}
+
+QStringList LibraryRescanner::libraryRoots(const QSqlDatabase& database)
+{
+    QStringList roots;
+    QSqlQuery query(database);
+    if (query.exec("SELECT path FROM library_roots ORDER BY path")) {
+        while (query.next())
+            roots << query.value(0).toString();
+    }
+    return roots;
+}
+
+bool LibraryRescanner::addLibraryRoot(const QSqlDatabase& database, const QString& directory)
+{
+    QSqlQuery query(database);
+    query.prepare("INSERT OR IGNORE INTO library_roots (path, added) VALUES (?, ?)");
+    query.addBindValue(QDir::cleanPath(directory));
+    query.addBindValue(QDateTime::currentDateTime().toString(Qt::ISODate));
+    if (!query.exec()) {
+        qWarning() << "LibraryRescanner: could not record library root" << directory
+                   << query.lastError().text();
+        return false;
+    }
+    return true;
+}
+
+bool LibraryRescanner::inScope(const QString& path) const
+{
+    for (const QString& directory : m_scope) {
+        if (m_options.recursive ? path.startsWith(directoryPrefix(directory))
+                                : QFileInfo(path).path() == directory)
+            return true;
+    }
+    return false;
+}
+
+QString LibraryRescanner::rootOf(const QString& path) const
+{
+    // New rows are named relative to their library root, so a change seen
+    // by the watcher deep in the tree names files like a full rescan does
+    for (const QStringList& candidates : {m_options.roots, m_scope}) {
+        QString best;
+        for (const QString& directory : candidates) {
+            if (path.startsWith(directoryPrefix(directory)) && directory.size() > best.size())
+                best = directory;
+        }
+        if (!best.isEmpty())
+            return best;
+    }
+    return QFileInfo(path).path();
+}
+
+void LibraryRescanner::walkDirectory(const QString& path)
+{
+    QList<Found> changed;
+    QList<Found> added;
+    QList<Found> baseline;
+    QStringList seen;
+    int unchanged = 0;
+
+    QDirIterator it(path, QDir::Files | QDir::Dirs | QDir::NoDotAndDotDot);
+    while (it.hasNext() && !m_cancelled) {
+        const QString entry = it.next();
+        const QFileInfo info = it.fileInfo();
+
+        if (info.isDir()) {
+            if (m_options.recursive && !info.isSymLink())
+                m_walkPool.start([this, entry]() { walkDirectory(entry); });
+            continue;
+        }
+
+        if (!m_extensions.contains(info.suffix().toLower()))
+            continue;
+
+        ++m_scanned;
+        const FileState state = fileState(info);
+        if (!state.isValid()) {
+            ++m_failed;
+            continue;
+        }
+        seen << entry;
+
+        if (!m_libraryPaths.contains(entry)) {
+            added << Found{entry, state};
+            continue;
+        }
+
+        const auto known = m_manifest.constFind(entry);
+        if (known == m_manifest.constEnd())
+            baseline << Found{entry, state};
+        else if (known->sameAs(state))
+            ++unchanged;
+        else
+            changed << Found{entry, state};
+    }
+
+    m_unchanged += unchanged;
+
+    QMutexLocker locker(&m_resultMutex);
+    m_directories << path;
+    for (const QString& entry : std::as_const(seen))
+        m_seen.insert(entry);
+    m_changed << changed;
+    m_new << added;
+    m_baseline << baseline;
+}
+
+void LibraryRescanner::runScan(int run)
+{
+    {
+        QSqlDatabase db = DatabaseAccess::openConnection(m_connectionName, m_driver, m_databaseName);
+        bool ok = db.isOpen();
+        QSqlQuery query(db);
+        query.setForwardOnly(true);
+        ok = ok && query.exec("SELECT path, size, mtime, inode, hash FROM library_files");
+        while (ok && query.next()) {
+            const QString path = query.value(0).toString();
+            if (!inScope(path))
+                continue;
+            FileState state;
+            state.size = query.value(1).toLongLong();
+            state.modifiedMs = query.value(2).toLongLong();
+            state.inode = static_cast<quint64>(query.value(3).toLongLong());
+            state.hash = query.value(4).toByteArray();
+            m_manifest.insert(path, state);
+        }
+
+        // Stored paths are compared in clean form, so a row added as
+        // "/music//a.mp3" is not mistaken for a new file "/music/a.mp3"
+        ok = ok && query.exec("SELECT path FROM musics");
+        while (ok && query.next()) {
+            const QString path = query.value(0).toString();
+            const QString clean = QDir::cleanPath(path);
+            if (inScope(clean))
+                m_libraryPaths.insert(clean, path);
+        }
+        const QString readError = query.lastError().isValid() ? query.lastError().text()
+                                                              : db.lastError().text();
+        query.finish();
+
+        if (!ok) {
+            const QString error = tr("Could not read the library: %1").arg(readError);
+            QMetaObject::invokeMethod(this, [this, error]() { emit rescanError(error); }, Qt::QueuedConnection);
+        } else {
+            for (const QString& directory : std::as_const(m_scope))
+                m_walkPool.start([this, directory]() { walkDirectory(directory); });
+            m_walkPool.waitForDone();
+
+            if (!m_cancelled)
+                reconcile(db);
+        }
+    }
+    DatabaseAccess::closeConnection(m_connectionName);
+
+    m_elapsedMs = m_clock.elapsed();
+    QMetaObject::invokeMethod(this, [this, run]() { finish(run); }, Qt::QueuedConnection);
+}
+
+void LibraryRescanner::reconcile(QSqlDatabase& db)
+{
+    // Gone: known to the library or the manifest, not seen by the walk and
+    // really not on disk (a row whose file the walk skips, say a symlinked
+    // folder or another extension, stays)
+    QStringList missing;
+    {
+        QSet<QString> candidates;
+        for (auto it = m_libraryPaths.constBegin(); it != m_libraryPaths.constEnd(); ++it)
+            candidates.insert(it.key());
+        for (auto it = m_manifest.constBegin(); it != m_manifest.constEnd(); ++it)
+            candidates.insert(it.key());
+        for (const QString& path : std::as_const(candidates)) {
+            if (!m_seen.contains(path) && !QFileInfo::exists(path))
+                missing << path;
+        }
+    }
+
+    // Moves: a missing file whose inode (same file system) or size and
+    // hash (copied elsewhere) turn up again as a new file
+    const int newCount = m_new.size();
+    std::vector<QByteArray> newHashes(newCount);
+    QHash<QString, int> moves;               // missing path -> index in m_new
+    QSet<int> movedNew;
+    {
+        QHash<quint64, int> newByInode;
+        for (int i = 0; i < newCount; ++i) {
+            if (m_new.at(i).state.inode != 0)
+                newByInode.insert(m_new.at(i).state.inode, i);
+        }
+
+        QList<QString> unmatched;
+        for (const QString& path : std::as_const(missing)) {
+            // Only rows can move; a manifest entry alone has nothing to keep
+            const auto known = m_manifest.constFind(path);
+            if (known == m_manifest.constEnd() || !m_libraryPaths.contains(path))
+                continue;
+            const int index = known->inode != 0 ? newByInode.value(known->inode, -1) : -1;
+            if (index >= 0 && !movedNew.contains(index) && m_new.at(index).state.size == known->size) {
+                moves.insert(path, index);
+                movedNew.insert(index);
+            } else if (!known->hash.isEmpty()) {
+                unmatched << path;
+            }
+        }
+
+        if (!unmatched.isEmpty()) {
+            QSet<qint64> sizes;
+            for (const QString& path : std::as_const(unmatched))
+                sizes.insert(m_manifest.value(path).size);
+
+            QList<int> toHash;
+            for (int i = 0; i < newCount; ++i) {
+                if (!movedNew.contains(i) && sizes.contains(m_new.at(i).state.size))
+                    toHash << i;
+            }
+            forEachParallel(m_workPool, toHash.size(), m_cancelled, [&](int n) {
+                newHashes[toHash.at(n)] = contentHash(m_new.at(toHash.at(n)).path);
+            });
+
+            for (const QString& path : std::as_const(unmatched)) {
+                const FileState known = m_manifest.value(path);
+                for (int i : std::as_const(toHash)) {
+                    if (!movedNew.contains(i) && m_new.at(i).state.size == known.size
+                        && newHashes[i] == known.hash) {
+                        moves.insert(path, i);
+                        movedNew.insert(i);
+                        break;
+                    }
+                }
+            }
+        }
+    }
+
+    // New files: the row as "Add directory" would build it, plus the hash
+    // for the manifest
+    std::vector<MusicItem> newItems(newCount);
+    forEachParallel(m_workPool, newCount, m_cancelled, [&](int i) {
+        if (movedNew.contains(i))
+            return;
+        const Found& found = m_new.at(i);
+        MusicItem music = LibraryImporter::itemForFile(rootOf(found.path), found.path, m_options.rowDefaults);
+        if (m_probe) {
+            const qint64 durationMs = m_probe(found.path);
+            if (durationMs > 0)
+                music.time = QTime(0, 0).addMSecs(durationMs).toString("h:mm:ss");
+        }
+        if (newHashes[i].isEmpty())
+            newHashes[i] = contentHash(found.path);
+        newItems[i] = music;
+    });
+
+    // Changed files: a new time stamp over the same bytes is only a touch
+    const int changedCount = m_changed.size();
+    std::vector<QByteArray> changedHashes(changedCount);
+    std::vector<QString> changedTimes(changedCount);
+    std::vector<char> contentChanged(changedCount, 0);
+    forEachParallel(m_workPool, changedCount, m_cancelled, [&](int i) {
+        const Found& found = m_changed.at(i);
+        changedHashes[i] = contentHash(found.path);
+        const QByteArray previous = m_manifest.value(found.path).hash;
+        if (!previous.isEmpty() && previous == changedHashes[i])
+            return;
+        contentChanged[i] = 1;
+        if (m_probe) {
+            const qint64 durationMs = m_probe(found.path);
+            if (durationMs > 0)
+                changedTimes[i] = QTime(0, 0).addMSecs(durationMs).toString("h:mm:ss");
+        }
+    });
+
+    if (m_cancelled)
+        return;
+
+    // Writes, batched. Counters only move once their batch is committed.
+    struct Pending {
+        int items = 0;
+        int added = 0;
+        int updated = 0;
+        int moved = 0;
+        int removed = 0;
+    } pending;
+    bool inTransaction = false;
+
+    auto begin = [&]() {
+        if (!inTransaction)
+            inTransaction = db.transaction();
+    };
+    auto commit = [&]() {
+        if (inTransaction) {
+            inTransaction = false;
+            if (!db.commit()) {
+                qWarning() << "LibraryRescanner: could not commit a batch:" << db.lastError().text();
+                db.rollback();
+                m_failed += pending.items;
+                pending = Pending();
+                return;
+            }
+        }
+        m_added += pending.added;
+        m_updated += pending.updated;
+        m_moved += pending.moved;
+        m_removed += pending.removed;
+        pending = Pending();
+    };
+    auto done = [&]() {
+        if (++pending.items >= m_options.batchSize)
+            commit();
+    };
+
+    QSqlQuery insertMusic(db);
+    insertMusic.prepare("INSERT INTO musics (artist, song, genre1, genre2, country, published_date, path, time, played_times, last_played) "
+                        "SELECT ?, ?, ?, ?, ?, ?, ?, ?, 0, '' "
+                        "WHERE NOT EXISTS (SELECT 1 FROM musics WHERE path = ?)");
+    QSqlQuery movePath(db);
+    movePath.prepare("UPDATE musics SET path = ? WHERE path = ?");
+    QSqlQuery updateTime(db);
+    updateTime.prepare("UPDATE musics SET time = ? WHERE path = ?");
+    QSqlQuery deleteMusic(db);
+    deleteMusic.prepare("DELETE FROM musics WHERE path = ?");
+    QSqlQuery saveState(db);
+    saveState.prepare("INSERT OR REPLACE INTO library_files (path, size, mtime, inode, hash) VALUES (?, ?, ?, ?, ?)");
+    QSqlQuery forgetState(db);
+    forgetState.prepare("DELETE FROM library_files WHERE path = ?");
+
+    auto save = [&](const QString& path, const FileState& state, const QByteArray& hash) {
+        saveState.addBindValue(path);
+        saveState.addBindValue(state.size);
+        saveState.addBindValue(state.modifiedMs);
+        saveState.addBindValue(static_cast<qint64>(state.inode));
+        saveState.addBindValue(hash.isEmpty() ? QVariant() : QVariant(hash));
+        if (!saveState.exec())
+            qWarning() << "LibraryRescanner: could not record" << path << saveState.lastError().text();
+    };
+    auto forget = [&](const QString& path) {
+        forgetState.addBindValue(path);
+        forgetState.exec();
+    };
+
+    for (int i = 0; i < newCount && !m_cancelled; ++i) {
+        if (movedNew.contains(i))
+            continue;
+        const MusicItem& music = newItems[i];
+        begin();
+        insertMusic.addBindValue(music.artist);
+        insertMusic.addBindValue(music.song);
+        insertMusic.addBindValue(music.genre1);
+        insertMusic.addBindValue(music.genre2);
+        insertMusic.addBindValue(music.country);
+        insertMusic.addBindValue(music.publishedDate);
+        insertMusic.addBindValue(music.path);
+        insertMusic.addBindValue(music.time);
+        insertMusic.addBindValue(music.path);
+        if (!insertMusic.exec()) {
+            qWarning() << "LibraryRescanner: failed to add" << music.path << insertMusic.lastError().text();
+            ++m_failed;
+            continue;
+        }
+        if (insertMusic.numRowsAffected() > 0)
+            ++pending.added;
+        save(m_new.at(i).path, m_new.at(i).state, newHashes[i]);
+        done();
+    }
+
+    for (auto it = moves.constBegin(); it != moves.constEnd() && !m_cancelled; ++it) {
+        const Found& found = m_new.at(it.value());
+        begin();
+        movePath.addBindValue(found.path);
+        movePath.addBindValue(m_libraryPaths.value(it.key()));
+        if (!movePath.exec()) {
+            qWarning() << "LibraryRescanner: failed to move" << it.key() << movePath.lastError().text();
+            ++m_failed;
+            continue;
+        }
+        ++pending.moved;
+        forget(it.key());
+        save(found.path, found.state, newHashes[it.value()].isEmpty() ? m_manifest.value(it.key()).hash
+                                                                      : newHashes[it.value()]);
+        done();
+    }
+
+    for (int i = 0; i < changedCount && !m_cancelled; ++i) {
+        const Found& found = m_changed.at(i);
+        begin();
+        if (contentChanged[i]) {
+            if (!changedTimes[i].isEmpty()) {
+                updateTime.addBindValue(changedTimes[i]);
+                updateTime.addBindValue(m_libraryPaths.value(found.path));
+                if (!updateTime.exec()) {
+                    qWarning() << "LibraryRescanner: failed to update" << found.path << updateTime.lastError().text();
+                    ++m_failed;
+                    continue;
+                }
+            }
+            ++pending.updated;
+        }
+        save(found.path, found.state, changedHashes[i]);
+        done();
+    }
+
+    // Files the library had before the manifest existed: recorded as they
+    // are now, hashed later only if they ever change
+    for (const Found& found : std::as_const(m_baseline)) {
+        if (m_cancelled)
+            break;
+        begin();
+        save(found.path, found.state, QByteArray());
+        done();
+    }
+
+    if (m_options.removeMissing) {
+        for (const QString& path : std::as_const(missing)) {
+            if (m_cancelled)
+                break;
+            if (moves.contains(path))
+                continue;
+            begin();
+            if (m_libraryPaths.contains(path)) {
+                deleteMusic.addBindValue(m_libraryPaths.value(path));
+                if (!deleteMusic.exec()) {
+                    qWarning() << "LibraryRescanner: failed to remove" << path << deleteMusic.lastError().text();
+                    ++m_failed;
+                    continue;
+                }
+                pending.removed += deleteMusic.numRowsAffected();
+            }
+            forget(path);
+            done();
+        }
+    }
+
+    commit();
+}
+
+void LibraryRescanner::finish(int run)
+{
+    if (run != m_run || !m_running)
+        return;
+
+    m_progressTimer.stop();
+    m_running = false;
+
+    const Statistics stats = statistics();
+    qInfo() << "LibraryRescanner: scanned" << stats.scanned << "files in" << stats.elapsedMs << "ms:"
+            << stats.added << "added," << stats.updated << "updated," << stats.moved << "moved,"
+            << stats.removed << "removed," << stats.failed << "failed";
+
+    emit progress(stats.scanned, stats.changes());
+    emit finished(stats);
+
+    if (m_watching) {
+        if (!stats.cancelled) {
+            const QStringList watched = m_watcher.directories();
+            QStringList unwatched;
+            for (const QString& directory : std::as_const(m_directories)) {
+                if (!watched.contains(directory))
+                    unwatched << directory;
+            }
+            if (!unwatched.isEmpty())
+                m_watcher.addPaths(unwatched);
+        }
+        if (!m_changedDirectories.isEmpty())
+            m_watchTimer.start();
+    }
+}
+
+bool LibraryRescanner::watch(const Options& options)
+{
+    m_watchOptions = options;
+    m_watching = true;
+    if (startScan(options, options.roots))
+        return true;
+
+    m_watching = false;
+    return false;
+}
+
+void LibraryRescanner::stopWatching()
+{
+    m_watching = false;
+    m_watchTimer.stop();
+    m_changedDirectories.clear();
+    const QStringList watched = m_watcher.directories();
+    if (!watched.isEmpty())
+        m_watcher.removePaths(watched);
+}
+
+QStringList LibraryRescanner::watchedDirectories() const
+{
+    return m_watcher.directories();
+}
+
+void LibraryRescanner::directoryChanged(const QString& path)
+{
+    if (!m_watching)
+        return;
+    m_changedDirectories.insert(QDir::cleanPath(path));
+    m_watchTimer.start();
+}
+
+void LibraryRescanner::rescanChangedDirectories()
+{
+    // A rescan in progress picks the set up again when it finishes
+    if (!m_watching || m_running || m_changedDirectories.isEmpty())
+        return;
+
+    // A removed directory needs no walk: its parent changed too, and the
+    // parent's rescan finds everything that was under it
+    QStringList scope;
+    for (const QString& directory : std::as_const(m_changedDirectories)) {
+        if (QFileInfo(directory).isDir())
+            scope << directory;
+    }
+    m_changedDirectories.clear();
+    if (scope.isEmpty())
+        return;
+
+    Options options = m_watchOptions;
+    options.recursive = true;   // new subdirectories are walked right away
+    startScan(options, scope);
+}
@@ -0,0 +1,294 @@
+#ifndef LIBRARYRESCANNER_H
+#define LIBRARYRESCANNER_H
+
+#include <QObject>
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <QFileSystemWatcher>
+#include <QHash>
+#include <QMutex>
+#include <QSet>
+#include <QSqlDatabase>
+#include <QStringList>
+#include <QThreadPool>
+#include <QTimer>
+#include <atomic>
+
+#include "LibraryImporter.h"
+
+class QFileInfo;
+
+/**
+ * @brief Incremental resync of the musics table with the music folders
+ *
+ * The rescanner keeps a manifest (library_files) of every library file's
+ * size, modification time, inode and a quick content hash. A rescan walks
+ * the library roots in parallel and compares each file with the manifest,
+ * so unchanged files cost a stat and nothing else. Only these touch the
+ * database:
+ * - new files are added to musics, named like "Add directory" names them;
+ * - changed files get a fresh duration;
+ * - moved or renamed files (same inode, or same size and hash) keep their
+ *   row, play count included, under the new path;
+ * - files that are gone are removed from musics.
+ *
+ * All writes go through one connection in batched transactions. A root
+ * that does not exist (an unmounted drive) is skipped, never emptied.
+ *
+ * With watch(), directories under the roots are watched (inotify on
+ * Linux) and a change rescans just the directories that changed.
+ *
+ * @example
+ * @code
+ * LibraryRescanner* rescanner = new LibraryRescanner(database, this);
+ * LibraryRescanner::Options options;
+ * options.roots = LibraryRescanner::libraryRoots(database);
+ * rescanner->start(options);
+ * @endcode
+ *
+ * @since XFB 2.0
+ */
+class LibraryRescanner : public QObject
+{
+    Q_OBJECT
+
+public:
+    /**
+     * @brief What the manifest knows about one file
+     */
+    struct FileState {
+        qint64 size = -1;
+        qint64 modifiedMs = 0;
+        quint64 inode = 0;        // 0 where the platform has none
+        QByteArray hash;          // empty until a rescan needed it
+
+        bool isValid() const { return size >= 0; }
+
+        /**
+         * @brief Size, time and (when both know it) inode are equal
+         */
+        bool sameAs(const FileState& other) const {
+            return size == other.size && modifiedMs == other.modifiedMs
+                   && (inode == 0 || other.inode == 0 || inode == other.inode);
+        }
+    };
+
+    /**
+     * @brief What to rescan
+     */
+    struct Options {
+        QStringList roots;        // library roots; also the base of new rows' names
+        bool recursive = true;
+        bool removeMissing = true;
+        int batchSize = 500;      // statements per transaction
+        int workers = 0;          // 0 for QThread::idealThreadCount()
+        QStringList extensions;   // empty for LibraryImporter::defaultExtensions()
+
+        // Values given to new rows; directory and batch fields are unused
+        LibraryImporter::Options rowDefaults;
+    };
+
+    /**
+     * @brief Outcome of a rescan
+     */
+    struct Statistics {
+        int scanned = 0;          // audio files seen
+        int unchanged = 0;
+        int added = 0;
+        int updated = 0;          // changed content, duration refreshed
+        int moved = 0;
+        int removed = 0;
+        int failed = 0;
+        qint64 elapsedMs = 0;
+        bool cancelled = false;
+
+        int changes() const { return added + updated + moved + removed; }
+    };
+
+    explicit LibraryRescanner(const QSqlDatabase& database, QObject* parent = nullptr);
+    ~LibraryRescanner() override;
+
+    /**
+     * @brief Probe used to fill in durations of new and changed files
+     * @param probe Thread-safe probe, or nullptr to leave durations alone
+     */
+    void setDurationProbe(LibraryImporter::DurationProbe probe);
+
+    /**
+     * @brief Rescan options.roots in the background
+     * @param options Rescan options
+     * @return false if a rescan is already running or there are no roots
+     */
+    bool start(const Options& options);
+
+    /**
+     * @brief Stop the running rescan; batches already committed stay
+     */
+    void cancel();
+
+    /**
+     * @brief Check if a rescan is running
+     * @return true while a rescan is in progress
+     */
+    bool isRunning() const { return m_running; }
+
+    /**
+     * @brief Block until the running rescan has finished
+     *
+     * Must be called from the rescanner's own thread; finished() has been
+     * emitted when this returns true.
+     *
+     * @param timeoutMs Timeout in milliseconds, -1 to wait forever
+     * @return true if no rescan is running any more
+     */
+    bool waitForFinished(int timeoutMs = -1);
+
+    /**
+     * @brief Current counters
+     * @return Statistics of the running or last rescan
+     */
+    Statistics statistics() const;
+
+    /**
+     * @brief Rescan now, then keep watching the roots for changes
+     * @param options Rescan options, reused for every change
+     * @return false if the first rescan could not start
+     */
+    bool watch(const Options& options);
+
+    /**
+     * @brief Stop watching the roots
+     */
+    void stopWatching();
+
+    /**
+     * @brief Check if the roots are being watched
+     * @return true between watch() and stopWatching()
+     */
+    bool isWatching() const { return m_watching; }
+
+    /**
+     * @brief Directories currently watched
+     * @return Watched directory paths
+     */
+    QStringList watchedDirectories() const;
+
+    /**
+     * @brief Size, time and inode of a file, without the hash
+     * @param info File info, as returned by a directory listing
+     * @return Invalid state if the file cannot be read
+     */
+    static FileState fileState(const QFileInfo& info);
+
+    /**
+     * @brief Quick content hash: SHA-1 of the size and the first and last 64 KiB
+     * @param filePath File to hash
+     * @return Hash, or an empty array if the file cannot be read
+     */
+    static QByteArray contentHash(const QString& filePath);
+
+    /**
+     * @brief Library roots recorded in the database
+     * @param database Library database
+     * @return Root directories
+     */
+    static QStringList libraryRoots(const QSqlDatabase& database);
+
+    /**
+     * @brief Record a library root; imports do this for their directory
+     * @param database Library database
+     * @param directory Root directory
+     * @return true if the root is recorded
+     */
+    static bool addLibraryRoot(const QSqlDatabase& database, const QString& directory);
+
+signals:
+    /**
+     * @brief Emitted at most every kProgressIntervalMs while rescanning
+     * @param scanned Audio files seen so far
+     * @param changes Rows added, updated, moved or removed so far
+     */
+    void progress(int scanned, int changes);
+
+    /**
+     * @brief Emitted when a rescan has finished or been cancelled
+     * @param statistics Final counters
+     */
+    void finished(const LibraryRescanner::Statistics& statistics);
+
+    /**
+     * @brief Emitted when a rescan cannot proceed
+     * @param error Error message
+     */
+    void rescanError(const QString& error);
+
+private:
+    static constexpr int kProgressIntervalMs = 100;
+    static constexpr int kWatchDelayMs = 1500;   // coalesce a burst of changes
+
+    struct Found {
+        QString path;
+        FileState state;
+    };
+
+    bool startScan(const Options& options, const QStringList& scope);
+    void runScan(int run);
+    void reconcile(QSqlDatabase& db);
+    void walkDirectory(const QString& path);
+    void finish(int run);
+    void directoryChanged(const QString& path);
+    void rescanChangedDirectories();
+    QString rootOf(const QString& path) const;
+    bool inScope(const QString& path) const;
+
+    QString m_databaseName;
+    QString m_driver;
+    QString m_connectionName;
+    LibraryImporter::DurationProbe m_probe;
+
+    Options m_options;
+    QStringList m_scope;        // directories this scan covers
+    QStringList m_extensions;
+    int m_run = 0;
+
+    QThreadPool m_walkPool;
+    QThreadPool m_workPool;     // hashing and duration probes
+    QThreadPool m_scanPool;     // the scan itself, one at a time
+
+    // Loaded before the walk, read-only while it runs
+    QHash<QString, FileState> m_manifest;
+    QHash<QString, QString> m_libraryPaths;  // clean path -> path as stored
+
+    // Walk results
+    QMutex m_resultMutex;
+    QSet<QString> m_seen;
+    QList<Found> m_changed;
+    QList<Found> m_new;
+    QList<Found> m_baseline;    // in musics but not yet in the manifest
+    QStringList m_directories;
+
+    std::atomic<bool> m_cancelled{false};
+    std::atomic<bool> m_running{false};
+    std::atomic<int> m_scanned{0};
+    std::atomic<int> m_unchanged{0};
+    std::atomic<int> m_added{0};
+    std::atomic<int> m_updated{0};
+    std::atomic<int> m_moved{0};
+    std::atomic<int> m_removed{0};
+    std::atomic<int> m_failed{0};
+    QElapsedTimer m_clock;
+    std::atomic<qint64> m_elapsedMs{0};
+
+    QTimer m_progressTimer;
+
+    // Watching
+    bool m_watching = false;
+    Options m_watchOptions;
+    QFileSystemWatcher m_watcher;
+    QSet<QString> m_changedDirectories;
+    QTimer m_watchTimer;
+};
+
+Q_DECLARE_METATYPE(LibraryRescanner::Statistics)
+
+#endif // LIBRARYRESCANNER_H
@@ -5,15 +5,163 @@
 #include <QJsonObject>
 #include <QJsonArray>
 #include <QFile>
+#include <QSaveFile>
 #include <QDir>
 #include <QStandardPaths>
 #include <QCryptographicHash>
 #include <QDataStream>
-#include <QBuffer>
-#include <algorithm>
+#include <QElapsedTimer>
+#include <QMetaMethod>
+#include <mutex>
+
+namespace {
+
+constexpr quint32 kSnapshotMagic = 0x58464d43; // "XFMC"
+constexpr quint16 kSnapshotVersion = 1;
+
+// Heap block of a string; literals and empty strings own none
+qint64 stringBytes(const QString& text)
+{
+    const qsizetype capacity = text.capacity();
+    return capacity > 0 ? qint64(sizeof(QArrayData)) + (capacity + 1) * qint64(sizeof(QChar)) : 0;
+}
+
+qint64 byteArrayBytes(const QByteArray& data)
+{
+    const qsizetype capacity = data.capacity();
+    return capacity > 0 ? qint64(sizeof(QArrayData)) + capacity + 1 : 0;
+}
+
+template<typename List>
+qint64 listBlockBytes(const List& list)
+{
+    const qsizetype capacity = list.capacity();
+    return capacity > 0 ? qint64(sizeof(QArrayData)) + capacity * qint64(sizeof(typename List::value_type)) : 0;
+}
+
+qint64 variantBytes(const QVariant& value)
+{
+    qint64 bytes = 0;
+    switch (value.typeId()) {
+    case QMetaType::QString:
+        return stringBytes(value.toString());
+    case QMetaType::QByteArray:
+        return byteArrayBytes(value.toByteArray());
+    case QMetaType::QStringList: {
+        const QStringList list = value.toStringList();
+        bytes = listBlockBytes(list);
+        for (const QString& text : list)
+            bytes += stringBytes(text);
+        return bytes;
+    }
+    case QMetaType::QVariantList: {
+        const QVariantList list = value.toList();
+        bytes = listBlockBytes(list);
+        for (const QVariant& item : list)
+            bytes += variantBytes(item);
+        return bytes;
+    }
+    case QMetaType::QVariantMap:
+    case QMetaType::QVariantHash: {
+        // Map and hash nodes alike: key, value and two links
+        const QVariantMap map = value.toMap();
+        for (auto it = map.cbegin(); it != map.cend(); ++it) {
+            bytes += qint64(sizeof(QString) + sizeof(QVariant) + 2 * sizeof(void*));
+            bytes += stringBytes(it.key()) + variantBytes(it.value());
+        }
+        return bytes;
+    }
+    default:
+        break;
+    }
+
+    // Anything else lives inside the QVariant when it fits, otherwise in
+    // a shared block of its own
+    const QMetaType type = value.metaType();
+    if (type.isValid() && type.sizeOf() > qsizetype(3 * sizeof(void*)))
+        bytes = qint64(sizeof(QArrayData)) + type.sizeOf();
+    return bytes;
+}
+
+QJsonObject trackToJson(const MusicItem& music)
+{
+    QJsonObject object;
+    object["id"] = music.id;
+    object["artist"] = music.artist;
+    object["song"] = music.song;
+    object["genre1"] = music.genre1;
+    object["genre2"] = music.genre2;
+    object["country"] = music.country;
+    object["publishedDate"] = music.publishedDate;
+    object["path"] = music.path;
+    object["time"] = music.time;
+    object["playedTimes"] = music.playedTimes;
+    object["lastPlayed"] = music.lastPlayed;
+    return object;
+}
+
+MusicItem trackFromJson(const QJsonObject& object)
+{
+    MusicItem music;
+    music.id = object["id"].toInt(-1);
+    music.artist = object["artist"].toString();
+    music.song = object["song"].toString();
+    music.genre1 = object["genre1"].toString();
+    music.genre2 = object["genre2"].toString();
+    music.country = object["country"].toString();
+    music.publishedDate = object["publishedDate"].toString();
+    music.path = object["path"].toString();
+    music.time = object["time"].toString();
+    music.playedTimes = object["playedTimes"].toInt();
+    music.lastPlayed = object["lastPlayed"].toString();
+    return music;
+}
+
+void writeTrack(QDataStream& out, const MusicItem& music)
+{
+    out << qint32(music.id) << music.artist << music.song << music.genre1 << music.genre2
+        << music.country << music.publishedDate << music.path << music.time
+        << qint32(music.playedTimes) << music.lastPlayed;
+}
+
+MusicItem readTrack(QDataStream& in)
+{
+    MusicItem music;
+    qint32 id = -1;
+    qint32 playedTimes = 0;
+    in >> id >> music.artist >> music.song >> music.genre1 >> music.genre2
+       >> music.country >> music.publishedDate >> music.path >> music.time
+       >> playedTimes >> music.lastPlayed;
+    music.id = id;
+    music.playedTimes = playedTimes;
+    return music;
+}
+
+} // namespace
+
+struct MusicCache::Record {
+    EntryKind kind = TrackEntry;
+    qint32 musicId = 0;
+    QString category;
+    QString name;
+    QList<MusicItem> tracks;    // One for a TrackEntry
+    QVariant value;
+    qint64 createdAt = 0;       // Ticks, see now()
+    qint64 accessedAt = 0;
+    qint64 expiresAt = -1;
+    qint32 accessCount = 0;
+    qint64 bytes = 0;
+    bool referenced = false;
+    bool pinned = false;
+};
 
 MusicCache::MusicCache(QObject* parent)
     : QObject(parent)
+    , m_shards(std::make_unique<Shard[]>(MAX_SHARDS))
+    , m_shardMask(shardCountFor(DEFAULT_MAX_MEMORY) - 1)
+    , m_shardBudget(DEFAULT_MAX_MEMORY / shardCountFor(DEFAULT_MAX_MEMORY))
+    , m_memoryUsage(0)
+    , m_entryCount(0)
     , m_maxMemoryUsage(DEFAULT_MAX_MEMORY)
     , m_defaultExpirationTime(DEFAULT_EXPIRATION_TIME)
     , m_invalidationStrategy(SmartInvalidation)
@@ -22,15 +170,11 @@ MusicCache::MusicCache(QObject* parent)
     , m_persistenceTimer(new QTimer(this))
     , m_autoPersistenceEnabled(false)
 {
-    // Initialize statistics
-    m_statistics = CacheStatistics{};
-    m_statistics.maxMemoryUsage = m_maxMemoryUsage;
-    
     // Setup maintenance timer
     m_maintenanceTimer->setSingleShot(false);
     m_maintenanceTimer->setInterval(MAINTENANCE_INTERVAL_MS);
     connect(m_maintenanceTimer, &QTimer::timeout, this, &MusicCache::performMaintenance);
-    
+
     // Setup persistence timer
     m_persistenceTimer->setSingleShot(false);
     m_persistenceTimer->setInterval(PERSISTENCE_INTERVAL_MS);
@@ -45,89 +189,96 @@ MusicCache::~MusicCache()
 bool MusicCache::initialize()
 {
     ErrorHandler::logMessage(ErrorHandler::ErrorSeverity::Info, "MusicCache", "Initializing music cache");
-    
+
     // Start maintenance timer
     m_maintenanceTimer->start();
-    
-    // Load cache from persistent storage if enabled
+
+    // Warm start from the last snapshot if enabled
     if (m_autoPersistenceEnabled && !m_persistenceFilePath.isEmpty()) {
         if (QFile::exists(m_persistenceFilePath)) {
-            loadFromFile(m_persistenceFilePath);
+            loadSnapshot(m_persistenceFilePath);
         }
         m_persistenceTimer->start();
     }
-    
-    ErrorHandler::logMessage(ErrorHandler::ErrorSeverity::Info, "MusicCache", QString("Music cache initialized (max memory: %1 MB)")
-                 .arg(m_maxMemoryUsage / (1024 * 1024)));
-    
+
+    ErrorHandler::logMessage(ErrorHandler::ErrorSeverity::Info, "MusicCache", QString("Music cache initialized (max memory: %1 MB, %2 shards)")
+                 .arg(maxMemoryUsage() / (1024 * 1024)).arg(shardCount()));
+
     return true;
 }
 
 void MusicCache::shutdown()
 {
     ErrorHandler::logMessage(ErrorHandler::ErrorSeverity::Info, "MusicCache", "Shutting down music cache");
-    
+
     // Stop timers
     m_maintenanceTimer->stop();
     m_persistenceTimer->stop();
-    
+
     // Save cache if auto-persistence is enabled
     if (m_autoPersistenceEnabled && !m_persistenceFilePath.isEmpty()) {
-        saveToFile(m_persistenceFilePath);
-    }
-    
-    // Clear cache
-    QMutexLocker locker(&m_cacheMutex);
-    m_cache.clear();
-    
-    // Reset statistics
+        saveSnapshot(m_persistenceFilePath);
+    }
+
+    // Clear cache and reset statistics
+    forEachShard([this](Shard& shard) {
+        resetShard(shard);
+        shard.hits = 0;
+        shard.misses = 0;
+        shard.evictions = 0;
+        shard.categoryHits.clear();
+        shard.categoryMisses.clear();
+    });
+
     QMutexLocker statsLocker(&m_statsMutex);
-    m_statistics = CacheStatistics{};
-    m_statistics.maxMemoryUsage = m_maxMemoryUsage;
+    m_lastCleanup = QDateTime();
+    m_lastWarmup = QDateTime();
 }
 
 void MusicCache::setMaxMemoryUsage(qint64 maxBytes)
 {
-    QMutexLocker locker(&m_statsMutex);
-    m_maxMemoryUsage = maxBytes;
-    m_statistics.maxMemoryUsage = maxBytes;
-    
-    ErrorHandler::logMessage(ErrorHandler::ErrorSeverity::Info, "MusicCache", QString("Max memory usage set to %1 MB").arg(maxBytes / (1024 * 1024)));
-    
+    m_maxMemoryUsage.storeRelaxed(maxBytes);
+    reshard(shardCountFor(maxBytes), maxBytes);
+
+    ErrorHandler::logMessage(ErrorHandler::ErrorSeverity::Info, "MusicCache", QString("Max memory usage set to %1 MB (%2 shards)")
+                 .arg(maxBytes / (1024 * 1024)).arg(shardCount()));
+
     // Trigger cleanup if current usage exceeds new limit
-    if (m_statistics.currentMemoryUsage > maxBytes) {
-        locker.unlock();
+    if (currentMemoryUsage() > maxBytes) {
         cleanup(static_cast<qint64>(maxBytes * MEMORY_CLEANUP_TARGET));
     }
 }
 
 qint64 MusicCache::maxMemoryUsage() const
 {
-    QMutexLocker locker(&m_statsMutex);
-    return m_maxMemoryUsage;
+    return m_maxMemoryUsage.loadRelaxed();
 }
 
 qint64 MusicCache::currentMemoryUsage() const
 {
-    QMutexLocker locker(&m_statsMutex);
-    return m_statistics.currentMemoryUsage;
+    return m_memoryUsage.loadRelaxed();
+}
+
+int MusicCache::shardCount() const
+{
+    return m_shardMask.loadRelaxed() + 1;
 }
 
 void MusicCache::setDefaultExpirationTime(int seconds)
 {
-    m_defaultExpirationTime = seconds;
+    m_defaultExpirationTime.storeRelaxed(seconds);
     ErrorHandler::logMessage(ErrorHandler::ErrorSeverity::Info, "MusicCache", QString("Default expiration time set to %1 seconds").arg(seconds));
 }
 
 int MusicCache::defaultExpirationTime() const
 {
-    return m_defaultExpirationTime;
+    return m_defaultExpirationTime.loadRelaxed();
 }
 
 void MusicCache::setInvalidationStrategy(InvalidationStrategy strategy)
 {
-    m_invalidationStrategy = strategy;
-    
+    m_invalidationStrategy.storeRelaxed(strategy);
+
     QString strategyName;
     switch (strategy) {
         case TimeBasedExpiration: strategyName = "TimeBasedExpiration"; break;
@@ -136,19 +287,19 @@ void MusicCache::setInvalidationStrategy(InvalidationStrategy strategy)
         case ManualInvalidation: strategyName = "ManualInvalidation"; break;
         case SmartInvalidation: strategyName = "SmartInvalidation"; break;
     }
-    
+
     ErrorHandler::logMessage(ErrorHandler::ErrorSeverity::Info, "MusicCache", QString("Invalidation strategy set to %1").arg(strategyName));
 }
 
 MusicCache::InvalidationStrategy MusicCache::invalidationStrategy() const
 {
-    return m_invalidationStrategy;
+    return static_cast<InvalidationStrategy>(m_invalidationStrategy.loadRelaxed());
 }
 
 void MusicCache::setWarmupStrategy(WarmupStrategy strategy)
 {
     m_warmupStrategy = strategy;
-    
+
     QString strategyName;
     switch (strategy) {
         case NoWarmup: strategyName = "NoWarmup"; break;
@@ -157,7 +308,7 @@ void MusicCache::setWarmupStrategy(WarmupStrategy strategy)
         case PredictiveWarmup: strategyName = "PredictiveWarmup"; break;
         case FullWarmup: strategyName = "FullWarmup"; break;
     }
-    
+
     ErrorHandler::logMessage(ErrorHandler::ErrorSeverity::Info, "MusicCache", QString("Warmup strategy set to %1").arg(strategyName));
 }
 
@@ -168,536 +319,197 @@ MusicCache::WarmupStrategy MusicCache::warmupStrategy() const
 
 void MusicCache::put(int musicId, const MusicItem& music, const QString& category, int expirationSeconds)
 {
-    QString key = generateMusicKey(musicId, category);
-    
-    QMutexLocker locker(&m_cacheMutex);
-    
-    // Create cache entry
-    CacheEntry entry;
-    entry.data = QVariant::fromValue(music);
-    entry.createdAt = QDateTime::currentDateTime();
-    entry.lastAccessed = entry.createdAt;
-    entry.accessCount = 0;
-    entry.source = "manual";
-    entry.size = calculateDataSize(entry.data);
-    
-    // Set expiration
-    if (expirationSeconds > 0) {
-        entry.expiresAt = entry.createdAt.addSecs(expirationSeconds);
-    } else if (m_defaultExpirationTime > 0) {
-        entry.expiresAt = entry.createdAt.addSecs(m_defaultExpirationTime);
-    }
-    
-    // Add metadata
-    entry.metadata["musicId"] = musicId;
-    entry.metadata["category"] = category;
-    
-    // Check if we need to evict entries to make room
-    qint64 newMemoryUsage = m_statistics.currentMemoryUsage + entry.size;
-    if (newMemoryUsage > m_maxMemoryUsage) {
-        locker.unlock();
-        cleanup(static_cast<qint64>(m_maxMemoryUsage * MEMORY_CLEANUP_TARGET));
-        locker.relock();
-    }
-    
-    // Store entry
-    bool isUpdate = m_cache.contains(key);
-    if (isUpdate) {
-        // Update existing entry size in statistics
-        qint64 oldSize = m_cache[key].size;
-        m_statistics.currentMemoryUsage -= oldSize;
-    }
-    
-    m_cache[key] = entry;
-    m_statistics.currentMemoryUsage += entry.size;
-    m_statistics.currentEntries = m_cache.size();
-    
-    // Update category statistics
-    m_statistics.categorySize[category] += entry.size;
-    
-    logCacheOperation("put", key, true, QString("Music ID: %1, Size: %2 bytes").arg(musicId).arg(entry.size));
+    Record record;
+    record.kind = TrackEntry;
+    record.musicId = musicId;
+    record.category = category;
+    record.tracks.append(music);
+
+    const qint64 lifetimeMs = 1000LL * (expirationSeconds > 0 ? expirationSeconds : defaultExpirationTime());
+    record.createdAt = record.accessedAt = now();
+    record.expiresAt = lifetimeMs > 0 ? record.createdAt + lifetimeMs : -1;
+
+    insert(record);
 }
 
 std::unique_ptr<MusicItem> MusicCache::get(int musicId, const QString& category)
 {
-    QString key = generateMusicKey(musicId, category);
-    
-    QMutexLocker locker(&m_cacheMutex);
-    
-    if (!m_cache.contains(key)) {
-        // Cache miss
-        m_statistics.totalMisses++;
-        m_statistics.categoryMisses[category]++;
-        
-        locker.unlock();
-        emit cacheMiss(key, category);
-        logCacheOperation("get", key, false, "Cache miss");
-        return nullptr;
-    }
-    
-    CacheEntry& entry = m_cache[key];
-    
-    // Check if entry has expired
-    if (isExpired(entry)) {
-        m_cache.remove(key);
-        m_statistics.currentMemoryUsage -= entry.size;
-        m_statistics.currentEntries = m_cache.size();
-        m_statistics.totalMisses++;
-        m_statistics.categoryMisses[category]++;
-        
-        locker.unlock();
-        emit cacheMiss(key, category);
-        logCacheOperation("get", key, false, "Entry expired");
-        return nullptr;
+    const Key key = trackKey(musicId, category);
+    std::unique_ptr<MusicItem> result;
+    {
+        Shard& shard = lockShard(key);
+        std::unique_lock<QMutex> locker(shard.mutex, std::adopt_lock);
+        if (const Slot* slot = lookup(shard, key)) {
+            result = std::make_unique<MusicItem>(decode(shard, slot->track));
+        }
     }
-    
-    // Update access information
-    entry.lastAccessed = QDateTime::currentDateTime();
-    entry.accessCount++;
-    
-    // Cache hit
-    m_statistics.totalHits++;
-    m_statistics.categoryHits[category]++;
-    
-    // Calculate hit ratio
-    qint64 totalAccesses = m_statistics.totalHits + m_statistics.totalMisses;
-    if (totalAccesses > 0) {
-        m_statistics.hitRatio = static_cast<double>(m_statistics.totalHits) / totalAccesses;
-    }
-    
-    auto result = std::make_unique<MusicItem>(entry.data.value<MusicItem>());
-    
-    locker.unlock();
-    emit cacheHit(key, category);
-    logCacheOperation("get", key, true, QString("Access count: %1").arg(entry.accessCount));
-    
+
+    notifyAccess(key, result != nullptr);
     return result;
 }
 
 bool MusicCache::contains(int musicId, const QString& category)
 {
-    QString key = generateMusicKey(musicId, category);
-    
-    QMutexLocker locker(&m_cacheMutex);
-    
-    if (!m_cache.contains(key)) {
-        return false;
-    }
-    
-    // Check if entry has expired
-    const CacheEntry& entry = m_cache[key];
-    if (isExpired(entry)) {
-        // Remove expired entry
-        m_cache.remove(key);
-        m_statistics.currentMemoryUsage -= entry.size;
-        m_statistics.currentEntries = m_cache.size();
-        return false;
-    }
-    
-    return true;
+    return containsKey(trackKey(musicId, category));
 }
 
 bool MusicCache::remove(int musicId, const QString& category)
 {
-    QString key = generateMusicKey(musicId, category);
-    
-    QMutexLocker locker(&m_cacheMutex);
-    
-    if (!m_cache.contains(key)) {
-        return false;
-    }
-    
-    const CacheEntry& entry = m_cache[key];
-    m_statistics.currentMemoryUsage -= entry.size;
-    m_statistics.categorySize[category] -= entry.size;
-    
-    m_cache.remove(key);
-    m_statistics.currentEntries = m_cache.size();
-    
-    logCacheOperation("remove", key, true, QString("Music ID: %1").arg(musicId));
-    return true;
+    return removeKey(trackKey(musicId, category));
 }
 
 void MusicCache::putSearchResults(const QString& searchKey, const QList<MusicItem>& results, int expirationSeconds)
 {
-    QString key = generateSearchKey(searchKey);
-    
-    QMutexLocker locker(&m_cacheMutex);
-    
-    // Create cache entry
-    CacheEntry entry;
-    entry.data = QVariant::fromValue(results);
-    entry.createdAt = QDateTime::currentDateTime();
-    entry.lastAccessed = entry.createdAt;
-    entry.accessCount = 0;
-    entry.source = "search";
-    entry.size = calculateDataSize(entry.data);
-    
-    // Set expiration (search results typically expire faster)
-    int searchExpirationTime = expirationSeconds > 0 ? expirationSeconds : (m_defaultExpirationTime / 2);
-    if (searchExpirationTime > 0) {
-        entry.expiresAt = entry.createdAt.addSecs(searchExpirationTime);
-    }
-    
-    // Add metadata
-    entry.metadata["searchKey"] = searchKey;
-    entry.metadata["resultCount"] = results.size();
-    entry.metadata["category"] = "search";
-    
-    // Check memory usage
-    qint64 newMemoryUsage = m_statistics.currentMemoryUsage + entry.size;
-    if (newMemoryUsage > m_maxMemoryUsage) {
-        locker.unlock();
-        cleanup(static_cast<qint64>(m_maxMemoryUsage * MEMORY_CLEANUP_TARGET));
-        locker.relock();
-    }
-    
-    // Store entry
-    bool isUpdate = m_cache.contains(key);
-    if (isUpdate) {
-        qint64 oldSize = m_cache[key].size;
-        m_statistics.currentMemoryUsage -= oldSize;
-    }
-    
-    m_cache[key] = entry;
-    m_statistics.currentMemoryUsage += entry.size;
-    m_statistics.currentEntries = m_cache.size();
-    m_statistics.categorySize["search"] += entry.size;
-    
-    logCacheOperation("putSearchResults", key, true, 
-                     QString("Search: %1, Results: %2, Size: %3 bytes")
-                     .arg(searchKey).arg(results.size()).arg(entry.size));
+    Record record;
+    record.kind = SearchEntry;
+    record.category = QStringLiteral("search");
+    record.name = searchKey;
+    record.tracks = results;
+
+    // Search results expire after half the default time
+    const qint64 lifetimeMs = expirationSeconds > 0 ? 1000LL * expirationSeconds : 500LL * defaultExpirationTime();
+    record.createdAt = record.accessedAt = now();
+    record.expiresAt = lifetimeMs > 0 ? record.createdAt + lifetimeMs : -1;
+
+    insert(record);
 }
 
 QList<MusicItem> MusicCache::getSearchResults(const QString& searchKey)
 {
-    QString key = generateSearchKey(searchKey);
-    
-    QMutexLocker locker(&m_cacheMutex);
-    
-    if (!m_cache.contains(key)) {
-        m_statistics.totalMisses++;
-        m_statistics.categoryMisses["search"]++;
-        
-        locker.unlock();
-        emit cacheMiss(key, "search");
-        logCacheOperation("getSearchResults", key, false, "Cache miss");
-        return QList<MusicItem>();
-    }
-    
-    CacheEntry& entry = m_cache[key];
-    
-    // Check if entry has expired
-    if (isExpired(entry)) {
-        m_cache.remove(key);
-        m_statistics.currentMemoryUsage -= entry.size;
-        m_statistics.currentEntries = m_cache.size();
-        m_statistics.totalMisses++;
-        m_statistics.categoryMisses["search"]++;
-        
-        locker.unlock();
-        emit cacheMiss(key, "search");
-        logCacheOperation("getSearchResults", key, false, "Entry expired");
-        return QList<MusicItem>();
-    }
-    
-    // Update access information
-    entry.lastAccessed = QDateTime::currentDateTime();
-    entry.accessCount++;
-    
-    // Cache hit
-    m_statistics.totalHits++;
-    m_statistics.categoryHits["search"]++;
-    
-    // Calculate hit ratio
-    qint64 totalAccesses = m_statistics.totalHits + m_statistics.totalMisses;
-    if (totalAccesses > 0) {
-        m_statistics.hitRatio = static_cast<double>(m_statistics.totalHits) / totalAccesses;
-    }
-    
-    QList<MusicItem> results = entry.data.value<QList<MusicItem>>();
-    
-    locker.unlock();
-    emit cacheHit(key, "search");
-    logCacheOperation("getSearchResults", key, true, 
-                     QString("Search: %1, Results: %2").arg(searchKey).arg(results.size()));
-    
+    const Key key = searchResultsKey(searchKey);
+    QList<MusicItem> results;
+    bool hit = false;
+    {
+        Shard& shard = lockShard(key);
+        std::unique_lock<QMutex> locker(shard.mutex, std::adopt_lock);
+        if (const Slot* slot = lookup(shard, key)) {
+            hit = true;
+            results.reserve(slot->results.size());
+            for (const Track& track : slot->results) {
+                results.append(decode(shard, track));
+            }
+        }
+    }
+
+    notifyAccess(key, hit);
     return results;
 }
 
 bool MusicCache::containsSearchResults(const QString& searchKey)
 {
-    QString key = generateSearchKey(searchKey);
-    
-    QMutexLocker locker(&m_cacheMutex);
-    
-    if (!m_cache.contains(key)) {
-        return false;
-    }
-    
-    const CacheEntry& entry = m_cache[key];
-    if (isExpired(entry)) {
-        m_cache.remove(key);
-        m_statistics.currentMemoryUsage -= entry.size;
-        m_statistics.currentEntries = m_cache.size();
-        return false;
-    }
-    
-    return true;
+    return containsKey(searchResultsKey(searchKey));
 }
 
 bool MusicCache::removeSearchResults(const QString& searchKey)
 {
-    QString key = generateSearchKey(searchKey);
-    
-    QMutexLocker locker(&m_cacheMutex);
-    
-    if (!m_cache.contains(key)) {
-        return false;
-    }
-    
-    const CacheEntry& entry = m_cache[key];
-    m_statistics.currentMemoryUsage -= entry.size;
-    m_statistics.categorySize["search"] -= entry.size;
-    
-    m_cache.remove(key);
-    m_statistics.currentEntries = m_cache.size();
-    
-    logCacheOperation("removeSearchResults", key, true, QString("Search: %1").arg(searchKey));
-    return true;
+    return removeKey(searchResultsKey(searchKey));
 }
 
 void MusicCache::putMetadata(const QString& key, const QVariant& data, const QString& category, int expirationSeconds)
 {
-    QString cacheKey = generateMetadataKey(key, category);
-    
-    QMutexLocker locker(&m_cacheMutex);
-    
-    // Create cache entry
-    CacheEntry entry;
-    entry.data = data;
-    entry.createdAt = QDateTime::currentDateTime();
-    entry.lastAccessed = entry.createdAt;
-    entry.accessCount = 0;
-    entry.source = "metadata";
-    entry.size = calculateDataSize(data);
-    
-    // Set expiration
-    if (expirationSeconds > 0) {
-        entry.expiresAt = entry.createdAt.addSecs(expirationSeconds);
-    } else if (m_defaultExpirationTime > 0) {
-        entry.expiresAt = entry.createdAt.addSecs(m_defaultExpirationTime);
-    }
-    
-    // Add metadata
-    entry.metadata["originalKey"] = key;
-    entry.metadata["category"] = category;
-    
-    // Check memory usage
-    qint64 newMemoryUsage = m_statistics.currentMemoryUsage + entry.size;
-    if (newMemoryUsage > m_maxMemoryUsage) {
-        locker.unlock();
-        cleanup(static_cast<qint64>(m_maxMemoryUsage * MEMORY_CLEANUP_TARGET));
-        locker.relock();
-    }
-    
-    // Store entry
-    bool isUpdate = m_cache.contains(cacheKey);
-    if (isUpdate) {
-        qint64 oldSize = m_cache[cacheKey].size;
-        m_statistics.currentMemoryUsage -= oldSize;
-    }
-    
-    m_cache[cacheKey] = entry;
-    m_statistics.currentMemoryUsage += entry.size;
-    m_statistics.currentEntries = m_cache.size();
-    m_statistics.categorySize[category] += entry.size;
-    
-    logCacheOperation("putMetadata", cacheKey, true, 
-                     QString("Key: %1, Category: %2, Size: %3 bytes")
-                     .arg(key).arg(category).arg(entry.size));
+    Record record;
+    record.kind = MetadataEntry;
+    record.category = category;
+    record.name = key;
+    record.value = data;
+
+    const qint64 lifetimeMs = 1000LL * (expirationSeconds > 0 ? expirationSeconds : defaultExpirationTime());
+    record.createdAt = record.accessedAt = now();
+    record.expiresAt = lifetimeMs > 0 ? record.createdAt + lifetimeMs : -1;
+
+    insert(record);
 }
 
 QVariant MusicCache::getMetadata(const QString& key, const QString& category)
 {
-    QString cacheKey = generateMetadataKey(key, category);
-    
-    QMutexLocker locker(&m_cacheMutex);
-    
-    if (!m_cache.contains(cacheKey)) {
-        m_statistics.totalMisses++;
-        m_statistics.categoryMisses[category]++;
-        
-        locker.unlock();
-        emit cacheMiss(cacheKey, category);
-        logCacheOperation("getMetadata", cacheKey, false, "Cache miss");
-        return QVariant();
-    }
-    
-    CacheEntry& entry = m_cache[cacheKey];
-    
-    // Check if entry has expired
-    if (isExpired(entry)) {
-        m_cache.remove(cacheKey);
-        m_statistics.currentMemoryUsage -= entry.size;
-        m_statistics.currentEntries = m_cache.size();
-        m_statistics.totalMisses++;
-        m_statistics.categoryMisses[category]++;
-        
-        locker.unlock();
-        emit cacheMiss(cacheKey, category);
-        logCacheOperation("getMetadata", cacheKey, false, "Entry expired");
-        return QVariant();
-    }
-    
-    // Update access information
-    entry.lastAccessed = QDateTime::currentDateTime();
-    entry.accessCount++;
-    
-    // Cache hit
-    m_statistics.totalHits++;
-    m_statistics.categoryHits[category]++;
-    
-    // Calculate hit ratio
-    qint64 totalAccesses = m_statistics.totalHits + m_statistics.totalMisses;
-    if (totalAccesses > 0) {
-        m_statistics.hitRatio = static_cast<double>(m_statistics.totalHits) / totalAccesses;
-    }
-    
-    QVariant result = entry.data;
-    
-    locker.unlock();
-    emit cacheHit(cacheKey, category);
-    logCacheOperation("getMetadata", cacheKey, true, QString("Key: %1, Category: %2").arg(key).arg(category));
-    
+    const Key cacheKey = metadataKey(key, category);
+    QVariant result;
+    bool hit = false;
+    {
+        Shard& shard = lockShard(cacheKey);
+        std::unique_lock<QMutex> locker(shard.mutex, std::adopt_lock);
+        if (const Slot* slot = lookup(shard, cacheKey)) {
+            hit = true;
+            result = slot->value;
+        }
+    }
+
+    notifyAccess(cacheKey, hit);
     return result;
 }
 
 bool MusicCache::containsMetadata(const QString& key, const QString& category)
 {
-    QString cacheKey = generateMetadataKey(key, category);
-    
-    QMutexLocker locker(&m_cacheMutex);
-    
-    if (!m_cache.contains(cacheKey)) {
-        return false;
-    }
-    
-    const CacheEntry& entry = m_cache[cacheKey];
-    if (isExpired(entry)) {
-        m_cache.remove(cacheKey);
-        m_statistics.currentMemoryUsage -= entry.size;
-        m_statistics.currentEntries = m_cache.size();
-        return false;
-    }
-    
-    return true;
+    return containsKey(metadataKey(key, category));
 }
 
 bool MusicCache::removeMetadata(const QString& key, const QString& category)
 {
-    QString cacheKey = generateMetadataKey(key, category);
-    
-    QMutexLocker locker(&m_cacheMutex);
-    
-    if (!m_cache.contains(cacheKey)) {
-        return false;
-    }
-    
-    const CacheEntry& entry = m_cache[cacheKey];
-    m_statistics.currentMemoryUsage -= entry.size;
-    m_statistics.categorySize[category] -= entry.size;
-    
-    m_cache.remove(cacheKey);
-    m_statistics.currentEntries = m_cache.size();
-    
-    logCacheOperation("removeMetadata", cacheKey, true, QString("Key: %1, Category: %2").arg(key).arg(category));
-    return true;
+    return removeKey(metadataKey(key, category));
 }
 
 void MusicCache::clear()
 {
-    QMutexLocker locker(&m_cacheMutex);
-    
-    int entriesRemoved = m_cache.size();
-    qint64 memoryFreed = m_statistics.currentMemoryUsage;
-    
-    m_cache.clear();
-    
-    // Reset statistics
-    QMutexLocker statsLocker(&m_statsMutex);
-    m_statistics.currentEntries = 0;
-    m_statistics.currentMemoryUsage = 0;
-    m_statistics.categorySize.clear();
-    
+    int entriesRemoved = 0;
+    qint64 memoryFreed = 0;
+
+    forEachShard([this, &entriesRemoved, &memoryFreed](Shard& shard) {
+        entriesRemoved += int(shard.index.size());
+        memoryFreed += shard.bytes;
+        resetShard(shard);
+    });
+
     ErrorHandler::logMessage(ErrorHandler::ErrorSeverity::Info, "MusicCache", QString("Cache cleared: %1 entries, %2 MB freed")
                  .arg(entriesRemoved).arg(memoryFreed / (1024 * 1024)));
-    
+
     emit cleanupCompleted(entriesRemoved, memoryFreed);
 }
 
 void MusicCache::clearCategory(const QString& category)
 {
-    QMutexLocker locker(&m_cacheMutex);
-    
     int entriesRemoved = 0;
     qint64 memoryFreed = 0;
-    
-    auto it = m_cache.begin();
-    while (it != m_cache.end()) {
-        const CacheEntry& entry = it.value();
-        QString entryCategory = entry.metadata.value("category", "unknown").toString();
-        
-        if (entryCategory == category) {
-            memoryFreed += entry.size;
-            entriesRemoved++;
-            it = m_cache.erase(it);
-        } else {
-            ++it;
+
+    forEachShard([this, &category, &entriesRemoved, &memoryFreed](Shard& shard) {
+        const qint64 bytesBefore = shard.bytes;
+        for (int i = 0; i < shard.slots.size(); ++i) {
+            const Slot& slot = shard.slots[i];
+            if (slot.used && slot.key.category == category) {
+                drop(shard, i);
+                entriesRemoved++;
+            }
         }
-    }
-    
-    // Update statistics
-    QMutexLocker statsLocker(&m_statsMutex);
-    m_statistics.currentEntries = m_cache.size();
-    m_statistics.currentMemoryUsage -= memoryFreed;
-    m_statistics.categorySize[category] = 0;
-    
+        shard.categorySize.remove(category);
+        memoryFreed += bytesBefore - shard.bytes;
+    });
+
     ErrorHandler::logMessage(ErrorHandler::ErrorSeverity::Info, "MusicCache", QString("Category '%1' cleared: %2 entries, %3 MB freed")
                  .arg(category).arg(entriesRemoved).arg(memoryFreed / (1024 * 1024)));
-    
+
     emit cleanupCompleted(entriesRemoved, memoryFreed);
 }
 
 void MusicCache::invalidateExpired()
 {
-    QMutexLocker locker(&m_cacheMutex);
-    
+    QList<Eviction> evictions;
     int entriesRemoved = 0;
     qint64 memoryFreed = 0;
-    
-    auto it = m_cache.begin();
-    while (it != m_cache.end()) {
-        const CacheEntry& entry = it.value();
-        
-        if (isExpired(entry)) {
-            QString category = entry.metadata.value("category", "unknown").toString();
-            memoryFreed += entry.size;
-            entriesRemoved++;
-            
-            emit entryEvicted(it.key(), category, "expired");
-            it = m_cache.erase(it);
-        } else {
-            ++it;
+    const qint64 tick = now();
+
+    forEachShard([this, tick, &evictions, &entriesRemoved, &memoryFreed](Shard& shard) {
+        const qint64 bytesBefore = shard.bytes;
+        for (int i = 0; i < shard.slots.size(); ++i) {
+            const Slot& slot = shard.slots[i];
+            if (slot.used && isExpired(slot.expiresAt, slot.accessedAt, tick)) {
+                evict(shard, i, "expired", &evictions);
+                entriesRemoved++;
+            }
         }
-    }
-    
-    // Update statistics
-    QMutexLocker statsLocker(&m_statsMutex);
-    m_statistics.currentEntries = m_cache.size();
-    m_statistics.currentMemoryUsage -= memoryFreed;
-    m_statistics.totalEvictions += entriesRemoved;
-    
+        memoryFreed += bytesBefore - shard.bytes;
+    });
+
+    notifyEvictions(evictions);
+
     if (entriesRemoved > 0) {
         ErrorHandler::logMessage(ErrorHandler::ErrorSeverity::Info, "MusicCache", QString("Expired entries invalidated: %1 entries, %2 MB freed")
                      .arg(entriesRemoved).arg(memoryFreed / (1024 * 1024)));
@@ -706,63 +518,65 @@ void MusicCache::invalidateExpired()
 
 void MusicCache::cleanup(qint64 targetMemoryUsage)
 {
-    QMutexLocker locker(&m_cacheMutex);
-    
+    const qint64 maxMemory = maxMemoryUsage();
     if (targetMemoryUsage < 0) {
-        targetMemoryUsage = static_cast<qint64>(m_maxMemoryUsage * MEMORY_CLEANUP_TARGET);
+        targetMemoryUsage = static_cast<qint64>(maxMemory * MEMORY_CLEANUP_TARGET);
     }
-    
-    if (m_statistics.currentMemoryUsage <= targetMemoryUsage) {
+
+    const qint64 initialUsage = currentMemoryUsage();
+    if (initialUsage <= targetMemoryUsage) {
         return; // No cleanup needed
     }
-    
+
     ErrorHandler::logMessage(ErrorHandler::ErrorSeverity::Info, "MusicCache", QString("Starting cleanup: current %1 MB, target %2 MB")
-                 .arg(m_statistics.currentMemoryUsage / (1024 * 1024))
+                 .arg(initialUsage / (1024 * 1024))
                  .arg(targetMemoryUsage / (1024 * 1024)));
-    
+
+    QList<Eviction> evictions;
     int entriesRemoved = 0;
-    qint64 memoryFreed = 0;
-    
-    // First, remove expired entries
-    auto it = m_cache.begin();
-    while (it != m_cache.end() && m_statistics.currentMemoryUsage > targetMemoryUsage) {
-        const CacheEntry& entry = it.value();
-        
-        if (isExpired(entry)) {
-            QString category = entry.metadata.value("category", "unknown").toString();
-            memoryFreed += entry.size;
-            m_statistics.currentMemoryUsage -= entry.size;
+    const qint64 tick = now();
+
+    // Each shard down to its share of the target: expired entries first,
+    // then CLOCK victims
+    forEachShard([this, tick, targetMemoryUsage, &evictions, &entriesRemoved](Shard& shard) {
+        const qint64 shardTarget = targetMemoryUsage / shardCount();
+        for (int i = 0; i < shard.slots.size() && shard.bytes > shardTarget; ++i) {
+            const Slot& slot = shard.slots[i];
+            if (slot.used && isExpired(slot.expiresAt, slot.accessedAt, tick)) {
+                evict(shard, i, "expired", &evictions);
+                entriesRemoved++;
+            }
+        }
+        while (shard.bytes > shardTarget) {
+            const int victim = clockVictim(shard, -1);
+            if (victim < 0) {
+                break; // Only pinned entries left
+            }
+            evict(shard, victim, "memory limit", &evictions);
             entriesRemoved++;
-            
-            emit entryEvicted(it.key(), category, "expired");
-            it = m_cache.erase(it);
-        } else {
-            ++it;
         }
+    });
+
+    {
+        QMutexLocker statsLocker(&m_statsMutex);
+        m_lastCleanup = QDateTime::currentDateTime();
     }
-    
-    // If still over target, use LRU eviction
-    if (m_statistics.currentMemoryUsage > targetMemoryUsage) {
-        int lruEvicted = evictLRU(targetMemoryUsage);
-        entriesRemoved += lruEvicted;
-    }
-    
-    // Update statistics
-    QMutexLocker statsLocker(&m_statsMutex);
-    m_statistics.currentEntries = m_cache.size();
-    m_statistics.totalEvictions += entriesRemoved;
-    m_statistics.lastCleanup = QDateTime::currentDateTime();
-    
+
+    notifyEvictions(evictions);
+
+    const qint64 finalUsage = currentMemoryUsage();
+    const qint64 memoryFreed = initialUsage - finalUsage;
+
     ErrorHandler::logMessage(ErrorHandler::ErrorSeverity::Info, "MusicCache", QString("Cleanup completed: %1 entries removed, %2 MB freed, current usage: %3 MB")
                  .arg(entriesRemoved)
                  .arg(memoryFreed / (1024 * 1024))
-                 .arg(m_statistics.currentMemoryUsage / (1024 * 1024)));
-    
+                 .arg(finalUsage / (1024 * 1024)));
+
     emit cleanupCompleted(entriesRemoved, memoryFreed);
-    
+
     // Check if we're still over the memory threshold
-    if (m_statistics.currentMemoryUsage > m_maxMemoryUsage * MEMORY_CLEANUP_THRESHOLD) {
-        emit memoryThresholdExceeded(m_statistics.currentMemoryUsage, m_maxMemoryUsage);
+    if (finalUsage > maxMemory * MEMORY_CLEANUP_THRESHOLD) {
+        emit memoryThresholdExceeded(finalUsage, maxMemory);
     }
 }
 
@@ -771,215 +585,285 @@ void MusicCache::warmupCache()
     if (m_warmupStrategy == NoWarmup) {
         return;
     }
-    
+
     ErrorHandler::logMessage(ErrorHandler::ErrorSeverity::Info, "MusicCache", "Starting cache warmup");
-    
+
     int entriesWarmed = 0;
-    
+
     // This is a simplified warmup implementation
     // In a real application, you would query the database for popular/recent items
     // and pre-load them into the cache
-    
+
     switch (m_warmupStrategy) {
         case PopularItemsWarmup:
             // Would query database for most played items
             ErrorHandler::logMessage(ErrorHandler::ErrorSeverity::Info, "MusicCache", "Popular items warmup not implemented - requires database access");
             break;
-            
+
         case RecentItemsWarmup:
             // Would query database for recently accessed items
             ErrorHandler::logMessage(ErrorHandler::ErrorSeverity::Info, "MusicCache", "Recent items warmup not implemented - requires database access");
             break;
-            
+
         case PredictiveWarmup:
             // Would use machine learning or heuristics to predict likely accessed items
             ErrorHandler::logMessage(ErrorHandler::ErrorSeverity::Info, "MusicCache", "Predictive warmup not implemented - requires ML model");
             break;
-            
+
         case FullWarmup:
             // Would load entire dataset (use with caution)
             ErrorHandler::logMessage(ErrorHandler::ErrorSeverity::Info, "MusicCache", "Full warmup not implemented - requires database access");
             break;
-            
+
         case NoWarmup:
         default:
             break;
     }
-    
-    QMutexLocker statsLocker(&m_statsMutex);
-    m_statistics.lastWarmup = QDateTime::currentDateTime();
-    
+
+    {
+        QMutexLocker statsLocker(&m_statsMutex);
+        m_lastWarmup = QDateTime::currentDateTime();
+    }
+
     ErrorHandler::logMessage(ErrorHandler::ErrorSeverity::Info, "MusicCache", QString("Cache warmup completed: %1 entries warmed").arg(entriesWarmed));
     emit warmupCompleted(entriesWarmed);
 }
 
 void MusicCache::pinEntry(const QString& key, const QString& category)
 {
-    QString cacheKey = (category == "music") ? generateMusicKey(key.toInt(), category) : 
-                       (category == "search") ? generateSearchKey(key) :
-                       generateMetadataKey(key, category);
-    
-    QMutexLocker locker(&m_cacheMutex);
-    
-    if (m_cache.contains(cacheKey)) {
-        m_cache[cacheKey].isPinned = true;
-        logCacheOperation("pinEntry", cacheKey, true, QString("Category: %1").arg(category));
-    }
+    setPinned(entryKey(key, category), true);
 }
 
 void MusicCache::unpinEntry(const QString& key, const QString& category)
 {
-    QString cacheKey = (category == "music") ? generateMusicKey(key.toInt(), category) : 
-                       (category == "search") ? generateSearchKey(key) :
-                       generateMetadataKey(key, category);
-    
-    QMutexLocker locker(&m_cacheMutex);
-    
-    if (m_cache.contains(cacheKey)) {
-        m_cache[cacheKey].isPinned = false;
-        logCacheOperation("unpinEntry", cacheKey, true, QString("Category: %1").arg(category));
-    }
+    setPinned(entryKey(key, category), false);
 }
 
 MusicCache::CacheStatistics MusicCache::getStatistics() const
 {
-    QMutexLocker locker(&m_statsMutex);
-    return m_statistics;
+    CacheStatistics statistics;
+
+    forEachShard([&statistics](Shard& shard) {
+        statistics.totalHits += shard.hits;
+        statistics.totalMisses += shard.misses;
+        statistics.totalEvictions += shard.evictions;
+        for (auto it = shard.categoryHits.cbegin(); it != shard.categoryHits.cend(); ++it) {
+            statistics.categoryHits[it.key()] += it.value();
+        }
+        for (auto it = shard.categoryMisses.cbegin(); it != shard.categoryMisses.cend(); ++it) {
+            statistics.categoryMisses[it.key()] += it.value();
+        }
+        for (auto it = shard.categorySize.cbegin(); it != shard.categorySize.cend(); ++it) {
+            statistics.categorySize[it.key()] += it.value();
+        }
+    });
+
+    statistics.currentEntries = m_entryCount.loadRelaxed();
+    statistics.currentMemoryUsage = currentMemoryUsage();
+    statistics.maxMemoryUsage = maxMemoryUsage();
+
+    const qint64 totalAccesses = statistics.totalHits + statistics.totalMisses;
+    if (totalAccesses > 0) {
+        statistics.hitRatio = static_cast<double>(statistics.totalHits) / totalAccesses;
+    }
+
+    QMutexLocker statsLocker(&m_statsMutex);
+    statistics.lastCleanup = m_lastCleanup;
+    statistics.lastWarmup = m_lastWarmup;
+    return statistics;
 }
 
 std::unique_ptr<MusicCache::CacheEntry> MusicCache::getEntryInfo(const QString& key, const QString& category)
 {
-    QString cacheKey = (category == "music") ? generateMusicKey(key.toInt(), category) : 
-                       (category == "search") ? generateSearchKey(key) :
-                       generateMetadataKey(key, category);
-    
-    QMutexLocker locker(&m_cacheMutex);
-    
-    if (!m_cache.contains(cacheKey)) {
+    const Key cacheKey = entryKey(key, category);
+
+    Shard& shard = lockShard(cacheKey);
+    std::unique_lock<QMutex> locker(shard.mutex, std::adopt_lock);
+
+    const auto found = shard.index.constFind(cacheKey);
+    if (found == shard.index.constEnd()) {
         return nullptr;
     }
-    
-    return std::make_unique<CacheEntry>(m_cache[cacheKey]);
+
+    const Slot& slot = shard.slots[found.value()];
+    const qint64 tick = now();
+    const QDateTime current = QDateTime::currentDateTime();
+
+    auto info = std::make_unique<CacheEntry>();
+    info->createdAt = current.addMSecs(slot.createdAt - tick);
+    info->lastAccessed = current.addMSecs(slot.accessedAt - tick);
+    if (slot.expiresAt >= 0) {
+        info->expiresAt = current.addMSecs(slot.expiresAt - tick);
+    }
+    info->accessCount = slot.accessCount;
+    info->size = slot.bytes;
+    info->isPinned = slot.pinned;
+    info->metadata["category"] = slot.key.category;
+
+    switch (slot.key.kind) {
+        case TrackEntry:
+            info->data = QVariant::fromValue(decode(shard, slot.track));
+            info->source = "manual";
+            info->metadata["musicId"] = slot.key.musicId;
+            break;
+
+        case SearchEntry: {
+            QList<MusicItem> results;
+            for (const Track& track : slot.results) {
+                results.append(decode(shard, track));
+            }
+            info->data = QVariant::fromValue(results);
+            info->source = "search";
+            info->metadata["searchKey"] = slot.key.name;
+            info->metadata["resultCount"] = results.size();
+            break;
+        }
+
+        case MetadataEntry:
+            info->data = slot.value;
+            info->source = "metadata";
+            info->metadata["originalKey"] = slot.key.name;
+            break;
+    }
+
+    return info;
 }
 
 QStringList MusicCache::getKeys(const QString& category)
 {
-    QMutexLocker locker(&m_cacheMutex);
-    
     QStringList keys;
-    
-    for (auto it = m_cache.begin(); it != m_cache.end(); ++it) {
-        const CacheEntry& entry = it.value();
-        QString entryCategory = entry.metadata.value("category", "unknown").toString();
-        
-        if (category.isEmpty() || entryCategory == category) {
-            keys.append(it.key());
+
+    forEachShard([&category, &keys](Shard& shard) {
+        for (const Slot& slot : std::as_const(shard.slots)) {
+            if (slot.used && (category.isEmpty() || slot.key.category == category)) {
+                keys.append(externalKey(slot.key));
+            }
         }
-    }
-    
+    });
+
     return keys;
 }
 
 QString MusicCache::exportStatistics()
 {
-    QMutexLocker locker(&m_statsMutex);
-    
+    const CacheStatistics statistics = getStatistics();
+
     QJsonObject root;
-    
+
     // Basic statistics
-    root["totalHits"] = static_cast<qint64>(m_statistics.totalHits);
-    root["totalMisses"] = static_cast<qint64>(m_statistics.totalMisses);
-    root["totalEvictions"] = static_cast<qint64>(m_statistics.totalEvictions);
-    root["currentEntries"] = static_cast<qint64>(m_statistics.currentEntries);
-    root["currentMemoryUsage"] = static_cast<qint64>(m_statistics.currentMemoryUsage);
-    root["maxMemoryUsage"] = static_cast<qint64>(m_statistics.maxMemoryUsage);
-    root["hitRatio"] = m_statistics.hitRatio;
-    
-    if (m_statistics.lastCleanup.isValid()) {
-        root["lastCleanup"] = m_statistics.lastCleanup.toString(Qt::ISODate);
-    }
-    if (m_statistics.lastWarmup.isValid()) {
-        root["lastWarmup"] = m_statistics.lastWarmup.toString(Qt::ISODate);
-    }
-    
+    root["totalHits"] = static_cast<qint64>(statistics.totalHits);
+    root["totalMisses"] = static_cast<qint64>(statistics.totalMisses);
+    root["totalEvictions"] = static_cast<qint64>(statistics.totalEvictions);
+    root["currentEntries"] = static_cast<qint64>(statistics.currentEntries);
+    root["currentMemoryUsage"] = static_cast<qint64>(statistics.currentMemoryUsage);
+    root["maxMemoryUsage"] = static_cast<qint64>(statistics.maxMemoryUsage);
+    root["hitRatio"] = statistics.hitRatio;
+    root["shards"] = shardCount();
+
+    if (statistics.lastCleanup.isValid()) {
+        root["lastCleanup"] = statistics.lastCleanup.toString(Qt::ISODate);
+    }
+    if (statistics.lastWarmup.isValid()) {
+        root["lastWarmup"] = statistics.lastWarmup.toString(Qt::ISODate);
+    }
+
     // Category statistics
     QJsonObject categoryHits;
-    for (auto it = m_statistics.categoryHits.begin(); it != m_statistics.categoryHits.end(); ++it) {
+    for (auto it = statistics.categoryHits.begin(); it != statistics.categoryHits.end(); ++it) {
         categoryHits[it.key()] = static_cast<qint64>(it.value());
     }
     root["categoryHits"] = categoryHits;
-    
+
     QJsonObject categoryMisses;
-    for (auto it = m_statistics.categoryMisses.begin(); it != m_statistics.categoryMisses.end(); ++it) {
+    for (auto it = statistics.categoryMisses.begin(); it != statistics.categoryMisses.end(); ++it) {
         categoryMisses[it.key()] = static_cast<qint64>(it.value());
     }
     root["categoryMisses"] = categoryMisses;
-    
+
     QJsonObject categorySize;
-    for (auto it = m_statistics.categorySize.begin(); it != m_statistics.categorySize.end(); ++it) {
+    for (auto it = statistics.categorySize.begin(); it != statistics.categorySize.end(); ++it) {
         categorySize[it.key()] = static_cast<qint64>(it.value());
     }
     root["categorySize"] = categorySize;
-    
+
     QJsonDocument doc(root);
     return doc.toJson();
 }
 
 bool MusicCache::saveToFile(const QString& filePath)
 {
-    QMutexLocker locker(&m_cacheMutex);
-    
-    QFile file(filePath);
+    QSaveFile file(filePath);
     if (!file.open(QIODevice::WriteOnly)) {
         ErrorHandler::logMessage(ErrorHandler::ErrorSeverity::Error, "MusicCache", QString("Failed to open cache file for writing: %1").arg(filePath));
         return false;
     }
-    
-    QJsonObject root;
+
+    const qint64 tick = now();
+    const QDateTime current = QDateTime::currentDateTime();
+    const auto wallClock = [tick, &current](qint64 at) {
+        return current.addMSecs(at - tick).toString(Qt::ISODateWithMs);
+    };
+
     QJsonArray entries;
-    
-    for (auto it = m_cache.begin(); it != m_cache.end(); ++it) {
-        const CacheEntry& entry = it.value();
-        
-        QJsonObject entryObj;
-        entryObj["key"] = it.key();
-        entryObj["createdAt"] = entry.createdAt.toString(Qt::ISODate);
-        entryObj["lastAccessed"] = entry.lastAccessed.toString(Qt::ISODate);
-        if (entry.expiresAt.isValid()) {
-            entryObj["expiresAt"] = entry.expiresAt.toString(Qt::ISODate);
-        }
-        entryObj["accessCount"] = entry.accessCount;
-        entryObj["size"] = static_cast<qint64>(entry.size);
-        entryObj["source"] = entry.source;
-        entryObj["isPinned"] = entry.isPinned;
-        
-        // Serialize data (simplified - in practice you'd need proper serialization)
-        QJsonObject dataObj;
-        dataObj["type"] = entry.data.typeName();
-        // Note: Full data serialization would require custom serialization for MusicItem
-        
-        entryObj["data"] = dataObj;
-        
-        // Metadata
-        QJsonObject metadataObj;
-        for (auto metaIt = entry.metadata.begin(); metaIt != entry.metadata.end(); ++metaIt) {
-            metadataObj[metaIt.key()] = QJsonValue::fromVariant(metaIt.value());
+
+    // One shard at a time, so the others stay available meanwhile
+    for (int i = 0; i < MAX_SHARDS; ++i) {
+        for (const Record& record : shardRecords(i)) {
+            QJsonObject entryObj;
+            entryObj["key"] = externalKey(keyOf(record));
+            entryObj["category"] = record.category;
+            entryObj["createdAt"] = wallClock(record.createdAt);
+            entryObj["lastAccessed"] = wallClock(record.accessedAt);
+            if (record.expiresAt >= 0) {
+                entryObj["expiresAt"] = wallClock(record.expiresAt);
+            }
+            entryObj["accessCount"] = record.accessCount;
+            entryObj["size"] = record.bytes;
+            entryObj["isPinned"] = record.pinned;
+
+            switch (record.kind) {
+                case TrackEntry:
+                    entryObj["kind"] = "music";
+                    entryObj["musicId"] = record.musicId;
+                    entryObj["data"] = trackToJson(record.tracks.value(0));
+                    break;
+
+                case SearchEntry: {
+                    QJsonArray results;
+                    for (const MusicItem& music : record.tracks) {
+                        results.append(trackToJson(music));
+                    }
+                    entryObj["kind"] = "search";
+                    entryObj["searchKey"] = record.name;
+                    entryObj["data"] = results;
+                    break;
+                }
+
+                case MetadataEntry:
+                    entryObj["kind"] = "metadata";
+                    entryObj["originalKey"] = record.name;
+                    entryObj["data"] = QJsonValue::fromVariant(record.value);
+                    break;
+            }
+
+            entries.append(entryObj);
         }
-        entryObj["metadata"] = metadataObj;
-        
-        entries.append(entryObj);
     }
-    
+
+    QJsonObject root;
     root["entries"] = entries;
-    root["version"] = "1.0";
-    root["timestamp"] = QDateTime::currentDateTime().toString(Qt::ISODate);
-    
-    QJsonDocument doc(root);
-    file.write(doc.toJson());
-    
+    root["version"] = "2.0";
+    root["timestamp"] = current.toString(Qt::ISODate);
+
+    file.write(QJsonDocument(root).toJson());
+    if (!file.commit()) {
+        ErrorHandler::logMessage(ErrorHandler::ErrorSeverity::Error, "MusicCache", QString("Failed to write cache file: %1").arg(filePath));
+        return false;
+    }
+
     ErrorHandler::logMessage(ErrorHandler::ErrorSeverity::Info, "MusicCache", QString("Cache saved to file: %1 (%2 entries)")
-                 .arg(filePath).arg(m_cache.size()));
-    
+                 .arg(filePath).arg(entries.size()));
+
     return true;
 }
 
@@ -990,81 +874,208 @@ bool MusicCache::loadFromFile(const QString& filePath)
         ErrorHandler::logMessage(ErrorHandler::ErrorSeverity::Warning, "MusicCache", QString("Failed to open cache file for reading: %1").arg(filePath));
         return false;
     }
-    
+
     QJsonParseError error;
     QJsonDocument doc = QJsonDocument::fromJson(file.readAll(), &error);
-    
+
     if (error.error != QJsonParseError::NoError) {
         ErrorHandler::logMessage(ErrorHandler::ErrorSeverity::Error, "MusicCache", QString("Failed to parse cache file: %1").arg(error.errorString()));
         return false;
     }
-    
-    QJsonObject root = doc.object();
-    QJsonArray entries = root["entries"].toArray();
-    
-    QMutexLocker locker(&m_cacheMutex);
-    
+
+    const qint64 tick = now();
+    const QDateTime current = QDateTime::currentDateTime();
+    const auto ticks = [tick, &current](const QJsonValue& value) {
+        return tick + current.msecsTo(QDateTime::fromString(value.toString(), Qt::ISODateWithMs));
+    };
+
+    const QJsonArray entries = doc.object()["entries"].toArray();
     int loadedEntries = 0;
-    
+
     for (const QJsonValue& value : entries) {
-        QJsonObject entryObj = value.toObject();
-        
-        QString key = entryObj["key"].toString();
-        
-        CacheEntry entry;
-        entry.createdAt = QDateTime::fromString(entryObj["createdAt"].toString(), Qt::ISODate);
-        entry.lastAccessed = QDateTime::fromString(entryObj["lastAccessed"].toString(), Qt::ISODate);
-        
-        if (entryObj.contains("expiresAt")) {
-            entry.expiresAt = QDateTime::fromString(entryObj["expiresAt"].toString(), Qt::ISODate);
-        }
-        
-        entry.accessCount = entryObj["accessCount"].toInt();
-        entry.size = entryObj["size"].toVariant().toLongLong();
-        entry.source = entryObj["source"].toString();
-        entry.isPinned = entryObj["isPinned"].toBool();
-        
-        // Load metadata
-        QJsonObject metadataObj = entryObj["metadata"].toObject();
-        for (auto it = metadataObj.begin(); it != metadataObj.end(); ++it) {
-            entry.metadata[it.key()] = it.value().toVariant();
+        const QJsonObject entryObj = value.toObject();
+        const QString kind = entryObj["kind"].toString();
+
+        Record record;
+        if (kind == "music") {
+            record.kind = TrackEntry;
+            record.musicId = entryObj["musicId"].toInt();
+            record.tracks.append(trackFromJson(entryObj["data"].toObject()));
+        } else if (kind == "search") {
+            record.kind = SearchEntry;
+            record.name = entryObj["searchKey"].toString();
+            const QJsonArray results = entryObj["data"].toArray();
+            for (const QJsonValue& result : results) {
+                record.tracks.append(trackFromJson(result.toObject()));
+            }
+        } else if (kind == "metadata") {
+            record.kind = MetadataEntry;
+            record.name = entryObj["originalKey"].toString();
+            record.value = entryObj["data"].toVariant();
+        } else {
+            continue; // Version 1.0 files did not hold the data
         }
-        
-        // Skip expired entries
-        if (isExpired(entry)) {
-            continue;
+
+        record.category = entryObj["category"].toString();
+        record.createdAt = ticks(entryObj["createdAt"]);
+        record.accessedAt = ticks(entryObj["lastAccessed"]);
+        record.expiresAt = entryObj.contains("expiresAt") ? ticks(entryObj["expiresAt"]) : -1;
+        record.accessCount = entryObj["accessCount"].toInt();
+        record.pinned = entryObj["isPinned"].toBool();
+
+        // Expired entries are skipped
+        if (insert(record)) {
+            loadedEntries++;
         }
-        
-        // Note: Data loading is simplified here
-        // In practice, you'd need proper deserialization for MusicItem and other types
-        
-        m_cache[key] = entry;
-        m_statistics.currentMemoryUsage += entry.size;
-        loadedEntries++;
-    }
-    
-    m_statistics.currentEntries = m_cache.size();
-    
+    }
+
     ErrorHandler::logMessage(ErrorHandler::ErrorSeverity::Info, "MusicCache", QString("Cache loaded from file: %1 (%2 entries loaded)")
                  .arg(filePath).arg(loadedEntries));
-    
+
+    return true;
+}
+
+bool MusicCache::saveSnapshot(const QString& filePath)
+{
+    // Atomic replace: a crash while saving leaves the previous snapshot
+    QSaveFile file(filePath);
+    if (!file.open(QIODevice::WriteOnly)) {
+        ErrorHandler::logMessage(ErrorHandler::ErrorSeverity::Error, "MusicCache", QString("Failed to open snapshot for writing: %1").arg(filePath));
+        return false;
+    }
+
+    QDataStream out(&file);
+    out.setVersion(QDataStream::Qt_6_0);
+    out << kSnapshotMagic << kSnapshotVersion;
+
+    // Times are stored as wall clock milliseconds
+    const qint64 tick = now();
+    const qint64 current = QDateTime::currentMSecsSinceEpoch();
+    int savedEntries = 0;
+
+    for (int i = 0; i < MAX_SHARDS; ++i) {
+        for (const Record& record : shardRecords(i)) {
+            if (record.kind == MetadataEntry && !record.value.metaType().hasRegisteredDataStreamOperators()) {
+                continue; // No way to write the value
+            }
+
+            out << quint8(1) << quint8(record.kind) << record.musicId << record.category << record.name
+                << current + (record.createdAt - tick) << current + (record.accessedAt - tick)
+                << (record.expiresAt >= 0 ? current + (record.expiresAt - tick) : qint64(-1))
+                << record.accessCount << record.pinned << qint32(record.tracks.size());
+            for (const MusicItem& music : record.tracks) {
+                writeTrack(out, music);
+            }
+            if (record.kind == MetadataEntry) {
+                out << record.value;
+            }
+            savedEntries++;
+        }
+    }
+    out << quint8(0);
+
+    if (out.status() != QDataStream::Ok || !file.commit()) {
+        ErrorHandler::logMessage(ErrorHandler::ErrorSeverity::Error, "MusicCache", QString("Failed to write snapshot: %1").arg(filePath));
+        return false;
+    }
+
+    ErrorHandler::logMessage(ErrorHandler::ErrorSeverity::Info, "MusicCache", QString("Cache snapshot saved: %1 (%2 entries)")
+                 .arg(filePath).arg(savedEntries));
+    return true;
+}
+
+bool MusicCache::loadSnapshot(const QString& filePath)
+{
+    QFile file(filePath);
+    if (!file.open(QIODevice::ReadOnly)) {
+        ErrorHandler::logMessage(ErrorHandler::ErrorSeverity::Warning, "MusicCache", QString("Failed to open snapshot for reading: %1").arg(filePath));
+        return false;
+    }
+
+    QDataStream in(&file);
+    in.setVersion(QDataStream::Qt_6_0);
+    quint32 magic = 0;
+    quint16 version = 0;
+    in >> magic >> version;
+    if (magic != kSnapshotMagic || version != kSnapshotVersion) {
+        ErrorHandler::logMessage(ErrorHandler::ErrorSeverity::Warning, "MusicCache", QString("Not a cache snapshot: %1").arg(filePath));
+        return false;
+    }
+
+    const qint64 tick = now();
+    const qint64 current = QDateTime::currentMSecsSinceEpoch();
+    int loadedEntries = 0;
+    bool complete = false;
+
+    while (in.status() == QDataStream::Ok) {
+        quint8 more = 0;
+        in >> more;
+        if (in.status() != QDataStream::Ok) {
+            break;
+        }
+        if (more == 0) {
+            complete = true;
+            break;
+        }
+
+        Record record;
+        quint8 kind = 0;
+        qint64 createdAt = 0;
+        qint64 accessedAt = 0;
+        qint64 expiresAt = -1;
+        qint32 trackCount = 0;
+        in >> kind >> record.musicId >> record.category >> record.name
+           >> createdAt >> accessedAt >> expiresAt >> record.accessCount >> record.pinned >> trackCount;
+        if (in.status() != QDataStream::Ok || kind > MetadataEntry || trackCount < 0) {
+            break;
+        }
+
+        record.kind = static_cast<EntryKind>(kind);
+        for (qint32 i = 0; i < trackCount && in.status() == QDataStream::Ok; ++i) {
+            record.tracks.append(readTrack(in));
+        }
+        if (record.kind == MetadataEntry) {
+            in >> record.value;
+        }
+        if (in.status() != QDataStream::Ok) {
+            break;
+        }
+
+        record.createdAt = tick + (createdAt - current);
+        record.accessedAt = tick + (accessedAt - current);
+        record.expiresAt = expiresAt >= 0 ? tick + (expiresAt - current) : -1;
+
+        // Expired entries are skipped
+        if (insert(record)) {
+            loadedEntries++;
+        }
+    }
+
+    if (!complete) {
+        ErrorHandler::logMessage(ErrorHandler::ErrorSeverity::Error, "MusicCache", QString("Cache snapshot is damaged: %1 (%2 entries loaded)")
+                     .arg(filePath).arg(loadedEntries));
+        return false;
+    }
+
+    ErrorHandler::logMessage(ErrorHandler::ErrorSeverity::Info, "MusicCache", QString("Cache snapshot loaded: %1 (%2 entries loaded)")
+                 .arg(filePath).arg(loadedEntries));
     return true;
 }
 
 void MusicCache::setAutoPersistence(bool enabled, const QString& filePath)
 {
     m_autoPersistenceEnabled = enabled;
-    
+
     if (enabled) {
         if (filePath.isEmpty()) {
             // Use default cache directory
             QString cacheDir = QStandardPaths::writableLocation(QStandardPaths::CacheLocation);
             QDir().mkpath(cacheDir);
-            m_persistenceFilePath = QDir(cacheDir).filePath("music_cache.json");
+            m_persistenceFilePath = QDir(cacheDir).filePath("music_cache.snapshot");
         } else {
             m_persistenceFilePath = filePath;
         }
-        
+
         m_persistenceTimer->start();
         ErrorHandler::logMessage(ErrorHandler::ErrorSeverity::Info, "MusicCache", QString("Auto-persistence enabled: %1").arg(m_persistenceFilePath));
     } else {
@@ -1077,25 +1088,198 @@ void MusicCache::performMaintenance()
 {
     // Invalidate expired entries
     invalidateExpired();
-    
+
     // Check memory usage and cleanup if necessary
-    if (m_statistics.currentMemoryUsage > m_maxMemoryUsage * MEMORY_CLEANUP_THRESHOLD) {
+    if (currentMemoryUsage() > maxMemoryUsage() * MEMORY_CLEANUP_THRESHOLD) {
         cleanup();
     }
-    
+
     // Update statistics
     updateStatistics();
-    
+
     ErrorHandler::logMessage(ErrorHandler::ErrorSeverity::Info, "MusicCache", QString("Maintenance completed: %1 entries, %2 MB used")
-                  .arg(m_statistics.currentEntries)
-                  .arg(m_statistics.currentMemoryUsage / (1024 * 1024)));
+                  .arg(m_entryCount.loadRelaxed())
+                  .arg(currentMemoryUsage() / (1024 * 1024)));
 }
 
 void MusicCache::autoPersist()
 {
     if (m_autoPersistenceEnabled && !m_persistenceFilePath.isEmpty()) {
-        saveToFile(m_persistenceFilePath);
+        saveSnapshot(m_persistenceFilePath);
+    }
+}
+
+qint64 MusicCache::now()
+{
+    static const QElapsedTimer clock = [] {
+        QElapsedTimer timer;
+        timer.start();
+        return timer;
+    }();
+    return clock.elapsed();
+}
+
+int MusicCache::shardCountFor(qint64 maxBytes)
+{
+    int count = 1;
+    while (count < MAX_SHARDS && maxBytes / (count * 2) >= MIN_SHARD_BYTES) {
+        count *= 2;
+    }
+    return count;
+}
+
+MusicCache::Shard& MusicCache::lockShard(const Key& key)
+{
+    const size_t hash = qHash(key);
+    for (;;) {
+        const int mask = m_shardMask.loadAcquire();
+        Shard& shard = m_shards[hash & size_t(mask)];
+        shard.mutex.lock();
+        // reshard() changes the mask with every shard locked
+        if (m_shardMask.loadRelaxed() == mask) {
+            return shard;
+        }
+        shard.mutex.unlock();
+    }
+}
+
+void MusicCache::forEachShard(const std::function<void(Shard&)>& visit) const
+{
+    for (int i = 0; i < MAX_SHARDS; ++i) {
+        Shard& shard = m_shards[i];
+        QMutexLocker locker(&shard.mutex);
+        if (i <= m_shardMask.loadRelaxed()) {
+            visit(shard);
+        }
+    }
+}
+
+void MusicCache::reshard(int shardCount, qint64 maxBytes)
+{
+    for (int i = 0; i < MAX_SHARDS; ++i) {
+        m_shards[i].mutex.lock();
+    }
+
+    QList<Eviction> evictions;
+    const int previousCount = m_shardMask.loadRelaxed() + 1;
+    m_shardBudget = maxBytes / shardCount;
+
+    if (shardCount != previousCount) {
+        QList<Record> records;
+        qint64 hits = 0;
+        qint64 misses = 0;
+        qint64 evicted = 0;
+        QHash<QString, qint64> categoryHits;
+        QHash<QString, qint64> categoryMisses;
+
+        for (int i = 0; i < previousCount; ++i) {
+            Shard& shard = m_shards[i];
+            // From the hand on, so the entries keep their CLOCK order
+            const int slotCount = int(shard.slots.size());
+            for (int step = 0; step < slotCount; ++step) {
+                const Slot& slot = shard.slots[(shard.hand + step) % slotCount];
+                if (slot.used) {
+                    records.append(toRecord(shard, slot));
+                }
+            }
+
+            hits += shard.hits;
+            misses += shard.misses;
+            evicted += shard.evictions;
+            for (auto it = shard.categoryHits.cbegin(); it != shard.categoryHits.cend(); ++it) {
+                categoryHits[it.key()] += it.value();
+            }
+            for (auto it = shard.categoryMisses.cbegin(); it != shard.categoryMisses.cend(); ++it) {
+                categoryMisses[it.key()] += it.value();
+            }
+            shard.hits = 0;
+            shard.misses = 0;
+            shard.evictions = 0;
+            shard.categoryHits.clear();
+            shard.categoryMisses.clear();
+            resetShard(shard);
+        }
+
+        m_shardMask.storeRelease(shardCount - 1);
+
+        Shard& first = m_shards[0];
+        first.hits = hits;
+        first.misses = misses;
+        first.evictions = evicted;
+        first.categoryHits = categoryHits;
+        first.categoryMisses = categoryMisses;
+
+        for (const Record& record : std::as_const(records)) {
+            restore(m_shards[qHash(keyOf(record)) & size_t(shardCount - 1)], record, &evictions);
+        }
+    }
+
+    for (int i = MAX_SHARDS - 1; i >= 0; --i) {
+        m_shards[i].mutex.unlock();
+    }
+
+    notifyEvictions(evictions);
+}
+
+MusicCache::Key MusicCache::trackKey(int musicId, const QString& category)
+{
+    Key key;
+    key.kind = TrackEntry;
+    key.musicId = musicId;
+    key.category = category;
+    return key;
+}
+
+MusicCache::Key MusicCache::searchResultsKey(const QString& searchKey)
+{
+    Key key;
+    key.kind = SearchEntry;
+    key.category = QStringLiteral("search");
+    key.name = searchKey;
+    return key;
+}
+
+MusicCache::Key MusicCache::metadataKey(const QString& key, const QString& category)
+{
+    Key cacheKey;
+    cacheKey.kind = MetadataEntry;
+    cacheKey.category = category;
+    cacheKey.name = key;
+    return cacheKey;
+}
+
+MusicCache::Key MusicCache::entryKey(const QString& key, const QString& category)
+{
+    if (category == "music") {
+        return trackKey(key.toInt(), category);
+    }
+    if (category == "search") {
+        return searchResultsKey(key);
     }
+    return metadataKey(key, category);
+}
+
+MusicCache::Key MusicCache::keyOf(const Record& record)
+{
+    Key key;
+    key.kind = record.kind;
+    key.musicId = record.musicId;
+    key.category = record.category;
+    key.name = record.name;
+    return key;
+}
+
+QString MusicCache::externalKey(const Key& key)
+{
+    switch (key.kind) {
+        case TrackEntry:
+            return generateMusicKey(key.musicId, key.category);
+        case SearchEntry:
+            return generateSearchKey(key.name);
+        case MetadataEntry:
+            return generateMetadataKey(key.name, key.category);
+    }
+    return QString();
 }
 
 QString MusicCache::generateMusicKey(int musicId, const QString& category)
@@ -1116,106 +1300,463 @@ QString MusicCache::generateMetadataKey(const QString& key, const QString& categ
     return QString("meta:%1:%2").arg(category).arg(key);
 }
 
-qint64 MusicCache::calculateDataSize(const QVariant& data)
+quint32 MusicCache::intern(Shard& shard, const QString& text)
+{
+    if (text.isEmpty()) {
+        return 0;
+    }
+
+    const auto found = shard.stringIds.constFind(text);
+    if (found != shard.stringIds.constEnd()) {
+        ++shard.strings[found.value() - 1].refs;
+        return found.value();
+    }
+
+    quint32 id;
+    if (!shard.freeStrings.isEmpty()) {
+        id = shard.freeStrings.takeLast();
+    } else {
+        shard.strings.append(PooledString());
+        id = quint32(shard.strings.size());
+    }
+
+    PooledString& pooled = shard.strings[id - 1];
+    pooled.text = text;
+    pooled.refs = 1;
+    shard.stringIds.insert(pooled.text, id);
+    account(shard, qint64(sizeof(PooledString) + sizeof(QString) + sizeof(quint32)) + stringBytes(pooled.text));
+    return id;
+}
+
+void MusicCache::release(Shard& shard, quint32 id)
+{
+    if (id == 0) {
+        return;
+    }
+
+    PooledString& pooled = shard.strings[id - 1];
+    if (--pooled.refs > 0) {
+        return;
+    }
+
+    account(shard, -(qint64(sizeof(PooledString) + sizeof(QString) + sizeof(quint32)) + stringBytes(pooled.text)));
+    shard.stringIds.remove(pooled.text);
+    pooled.text = QString();
+    shard.freeStrings.append(id);
+}
+
+MusicCache::Track MusicCache::encode(Shard& shard, const MusicItem& music)
+{
+    Track track;
+    track.id = music.id;
+    track.playedTimes = music.playedTimes;
+    track.artist = intern(shard, music.artist);
+    track.genre1 = intern(shard, music.genre1);
+    track.genre2 = intern(shard, music.genre2);
+    track.country = intern(shard, music.country);
+    track.publishedDate = intern(shard, music.publishedDate);
+    track.time = intern(shard, music.time);
+
+    QByteArray text = music.song.toUtf8();
+    text += '\0';
+    text += music.path.toUtf8();
+    text += '\0';
+    text += music.lastPlayed.toUtf8();
+    text.squeeze();
+    track.text = text;
+    return track;
+}
+
+void MusicCache::releaseTrack(Shard& shard, const Track& track)
+{
+    release(shard, track.artist);
+    release(shard, track.genre1);
+    release(shard, track.genre2);
+    release(shard, track.country);
+    release(shard, track.publishedDate);
+    release(shard, track.time);
+}
+
+MusicItem MusicCache::decode(const Shard& shard, const Track& track)
+{
+    const auto pooled = [&shard](quint32 id) {
+        return id ? shard.strings[id - 1].text : QString();
+    };
+
+    MusicItem music;
+    music.id = track.id;
+    music.playedTimes = track.playedTimes;
+    music.artist = pooled(track.artist);
+    music.genre1 = pooled(track.genre1);
+    music.genre2 = pooled(track.genre2);
+    music.country = pooled(track.country);
+    music.publishedDate = pooled(track.publishedDate);
+    music.time = pooled(track.time);
+
+    const QByteArray& text = track.text;
+    const qsizetype pathStart = text.indexOf('\0') + 1;
+    const qsizetype playedStart = pathStart > 0 ? text.indexOf('\0', pathStart) + 1 : 0;
+    if (playedStart > 0) {
+        music.song = QString::fromUtf8(text.constData(), pathStart - 1);
+        music.path = QString::fromUtf8(text.constData() + pathStart, playedStart - pathStart - 1);
+        music.lastPlayed = QString::fromUtf8(text.constData() + playedStart, text.size() - playedStart);
+    }
+    return music;
+}
+
+qint64 MusicCache::slotBytes(const Slot& slot)
 {
-    // Simplified size calculation
-    // In practice, you'd need more accurate size calculation for complex types
-    
-    QBuffer buffer;
-    buffer.open(QIODevice::WriteOnly);
-    QDataStream stream(&buffer);
-    stream << data;
-    
-    return buffer.size();
+    // The slot, its index entry and the blocks only it points to
+    qint64 bytes = qint64(sizeof(Slot) + sizeof(Key) + sizeof(int));
+    bytes += stringBytes(slot.key.name);
+    bytes += byteArrayBytes(slot.track.text);
+    bytes += listBlockBytes(slot.results);
+    for (const Track& track : slot.results) {
+        bytes += byteArrayBytes(track.text);
+    }
+    bytes += variantBytes(slot.value);
+    return bytes;
 }
 
-bool MusicCache::isExpired(const CacheEntry& entry)
+bool MusicCache::isExpired(qint64 expiresAt, qint64 accessedAt, qint64 tick) const
 {
-    if (!entry.expiresAt.isValid()) {
+    if (expiresAt < 0) {
         return false; // No expiration set
     }
-    
-    QDateTime now = QDateTime::currentDateTime();
-    
-    switch (m_invalidationStrategy) {
+
+    const qint64 idleLimit = 1000LL * defaultExpirationTime();
+
+    switch (invalidationStrategy()) {
         case TimeBasedExpiration:
-            return now > entry.expiresAt;
-            
+            return tick > expiresAt;
+
         case AccessBasedExpiration:
             // Expire if not accessed for expiration time
-            return entry.lastAccessed.secsTo(now) > m_defaultExpirationTime;
-            
+            return tick - accessedAt > idleLimit;
+
         case VersionBasedExpiration:
             // Would need version tracking - simplified here
-            return now > entry.expiresAt;
-            
+            return tick > expiresAt;
+
         case ManualInvalidation:
             return false; // Never expire automatically
-            
+
         case SmartInvalidation:
             // Combination of time-based and access-based
-            return (now > entry.expiresAt) || 
-                   (entry.lastAccessed.secsTo(now) > m_defaultExpirationTime * 2);
+            return tick > expiresAt || tick - accessedAt > idleLimit * 2;
     }
-    
+
     return false;
 }
 
-int MusicCache::evictLRU(qint64 targetSize)
+MusicCache::Slot* MusicCache::find(Shard& shard, const Key& key, qint64 tick)
+{
+    const auto found = shard.index.constFind(key);
+    if (found == shard.index.constEnd()) {
+        return nullptr;
+    }
+
+    Slot& slot = shard.slots[found.value()];
+    if (isExpired(slot.expiresAt, slot.accessedAt, tick)) {
+        drop(shard, found.value());
+        return nullptr;
+    }
+    return &slot;
+}
+
+MusicCache::Slot* MusicCache::lookup(Shard& shard, const Key& key)
+{
+    const qint64 tick = now();
+    Slot* slot = find(shard, key, tick);
+    if (!slot) {
+        shard.misses++;
+        shard.categoryMisses[key.category]++;
+        return nullptr;
+    }
+
+    slot->accessedAt = tick;
+    slot->accessCount++;
+    slot->referenced = true;
+    shard.hits++;
+    shard.categoryHits[key.category]++;
+    return slot;
+}
+
+bool MusicCache::insert(const Record& record)
+{
+    if (isExpired(record.expiresAt, record.accessedAt, now())) {
+        return false;
+    }
+
+    QList<Eviction> evictions;
+    int position;
+    {
+        Shard& shard = lockShard(keyOf(record));
+        std::unique_lock<QMutex> locker(shard.mutex, std::adopt_lock);
+        position = restore(shard, record, &evictions);
+    }
+
+    notifyEvictions(evictions);
+    return position >= 0;
+}
+
+int MusicCache::restore(Shard& shard, const Record& record, QList<Eviction>* evictions)
 {
-    // Create list of entries sorted by last access time (oldest first)
-    QList<QPair<QString, QDateTime>> entries;
-    
-    for (auto it = m_cache.begin(); it != m_cache.end(); ++it) {
-        const CacheEntry& entry = it.value();
-        
-        // Don't evict pinned entries
-        if (entry.isPinned) {
+    Slot slot;
+    slot.key = keyOf(record);
+    slot.category = intern(shard, record.category);
+    if (slot.category) {
+        slot.key.category = shard.strings[slot.category - 1].text;
+    }
+
+    switch (record.kind) {
+        case TrackEntry:
+            slot.track = encode(shard, record.tracks.value(0));
+            break;
+
+        case SearchEntry:
+            slot.results.reserve(record.tracks.size());
+            for (const MusicItem& music : record.tracks) {
+                slot.results.append(encode(shard, music));
+            }
+            break;
+
+        case MetadataEntry:
+            slot.value = record.value;
+            break;
+    }
+
+    slot.createdAt = record.createdAt;
+    slot.accessedAt = record.accessedAt;
+    slot.expiresAt = record.expiresAt;
+    slot.accessCount = record.accessCount;
+    slot.referenced = record.referenced;
+    slot.pinned = record.pinned;
+
+    return store(shard, std::move(slot), evictions);
+}
+
+int MusicCache::store(Shard& shard, Slot slot, QList<Eviction>* evictions)
+{
+    // The replaced entry goes first; the strings it shares with the new
+    // one are already referenced again
+    const auto existing = shard.index.constFind(slot.key);
+    if (existing != shard.index.constEnd()) {
+        drop(shard, existing.value());
+    }
+
+    slot.used = true;
+    slot.bytes = slotBytes(slot);
+
+    int position;
+    if (!shard.freeSlots.isEmpty()) {
+        position = shard.freeSlots.takeLast();
+    } else {
+        position = int(shard.slots.size());
+        shard.slots.append(Slot());
+    }
+
+    Slot& stored = shard.slots[position];
+    stored = std::move(slot);
+    shard.index.insert(stored.key, position);
+    shard.categorySize[stored.key.category] += stored.bytes;
+    account(shard, stored.bytes);
+    m_entryCount.fetchAndAddRelaxed(1);
+
+    while (shard.bytes > m_shardBudget) {
+        const int victim = clockVictim(shard, position);
+        if (victim >= 0) {
+            evict(shard, victim, "memory limit", evictions);
             continue;
         }
-        
-        entries.append(qMakePair(it.key(), entry.lastAccessed));
-    }
-    
-    // Sort by last accessed time (oldest first)
-    std::sort(entries.begin(), entries.end(), 
-              [](const QPair<QString, QDateTime>& a, const QPair<QString, QDateTime>& b) {
-                  return a.second < b.second;
-              });
-    
-    int evicted = 0;
-    
-    // Evict oldest entries until we reach target size
-    for (const auto& pair : entries) {
-        if (m_statistics.currentMemoryUsage <= targetSize) {
-            break;
+
+        // Only pinned entries left: the new one does not fit
+        if (!shard.slots[position].pinned) {
+            evict(shard, position, "memory limit", evictions);
+            return -1;
+        }
+        break;
+    }
+
+    return position;
+}
+
+int MusicCache::clockVictim(Shard& shard, int keep)
+{
+    // Two turns: the first may only clear reference bits
+    const int slotCount = int(shard.slots.size());
+    for (int step = 0; step < 2 * slotCount; ++step) {
+        const int position = shard.hand;
+        shard.hand = (shard.hand + 1) % slotCount;
+
+        Slot& slot = shard.slots[position];
+        if (!slot.used || slot.pinned || position == keep) {
+            continue;
         }
-        
-        const QString& key = pair.first;
-        if (m_cache.contains(key)) {
-            const CacheEntry& entry = m_cache[key];
-            QString category = entry.metadata.value("category", "unknown").toString();
-            
-            m_statistics.currentMemoryUsage -= entry.size;
-            m_cache.remove(key);
-            evicted++;
-            
-            emit entryEvicted(key, category, "LRU");
+        if (slot.referenced) {
+            slot.referenced = false;
+            continue;
         }
+        return position;
+    }
+    return -1;
+}
+
+void MusicCache::evict(Shard& shard, int position, const QString& reason, QList<Eviction>* evictions)
+{
+    static const QMetaMethod evictedSignal = QMetaMethod::fromSignal(&MusicCache::entryEvicted);
+
+    const Slot& slot = shard.slots[position];
+    if (evictions && isSignalConnected(evictedSignal)) {
+        evictions->append(Eviction{externalKey(slot.key), slot.key.category, reason});
+    }
+    shard.evictions++;
+    drop(shard, position);
+}
+
+void MusicCache::drop(Shard& shard, int position)
+{
+    Slot& slot = shard.slots[position];
+    shard.index.remove(slot.key);
+    shard.categorySize[slot.key.category] -= slot.bytes;
+    account(shard, -slot.bytes);
+    m_entryCount.fetchAndSubRelaxed(1);
+
+    releaseTrack(shard, slot.track);
+    for (const Track& track : std::as_const(slot.results)) {
+        releaseTrack(shard, track);
+    }
+    release(shard, slot.category);
+
+    slot = Slot();
+    shard.freeSlots.append(position);
+}
+
+void MusicCache::resetShard(Shard& shard)
+{
+    m_memoryUsage.fetchAndSubRelaxed(shard.bytes);
+    m_entryCount.fetchAndSubRelaxed(shard.index.size());
+
+    shard.index.clear();
+    shard.slots.clear();
+    shard.freeSlots.clear();
+    shard.hand = 0;
+    shard.strings.clear();
+    shard.stringIds.clear();
+    shard.freeStrings.clear();
+    shard.bytes = 0;
+    shard.categorySize.clear();
+}
+
+void MusicCache::account(Shard& shard, qint64 bytes)
+{
+    shard.bytes += bytes;
+    m_memoryUsage.fetchAndAddRelaxed(bytes);
+}
+
+MusicCache::Record MusicCache::toRecord(const Shard& shard, const Slot& slot) const
+{
+    Record record;
+    record.kind = slot.key.kind;
+    record.musicId = slot.key.musicId;
+    record.category = slot.key.category;
+    record.name = slot.key.name;
+    if (slot.key.kind == TrackEntry) {
+        record.tracks.append(decode(shard, slot.track));
+    }
+    for (const Track& track : slot.results) {
+        record.tracks.append(decode(shard, track));
+    }
+    record.value = slot.value;
+    record.createdAt = slot.createdAt;
+    record.accessedAt = slot.accessedAt;
+    record.expiresAt = slot.expiresAt;
+    record.accessCount = slot.accessCount;
+    record.bytes = slot.bytes;
+    record.referenced = slot.referenced;
+    record.pinned = slot.pinned;
+    return record;
+}
+
+QList<MusicCache::Record> MusicCache::shardRecords(int shardIndex)
+{
+    QList<Record> records;
+
+    Shard& shard = m_shards[shardIndex];
+    QMutexLocker locker(&shard.mutex);
+    if (shardIndex > m_shardMask.loadRelaxed()) {
+        return records;
+    }
+
+    for (const Slot& slot : std::as_const(shard.slots)) {
+        if (slot.used) {
+            records.append(toRecord(shard, slot));
+        }
+    }
+    return records;
+}
+
+bool MusicCache::containsKey(const Key& key)
+{
+    Shard& shard = lockShard(key);
+    std::unique_lock<QMutex> locker(shard.mutex, std::adopt_lock);
+    return find(shard, key, now()) != nullptr;
+}
+
+bool MusicCache::removeKey(const Key& key)
+{
+    {
+        Shard& shard = lockShard(key);
+        std::unique_lock<QMutex> locker(shard.mutex, std::adopt_lock);
+        const auto found = shard.index.constFind(key);
+        if (found == shard.index.constEnd()) {
+            return false;
+        }
+        drop(shard, found.value());
+    }
+
+    logCacheOperation("remove", externalKey(key), true);
+    return true;
+}
+
+void MusicCache::setPinned(const Key& key, bool pinned)
+{
+    {
+        Shard& shard = lockShard(key);
+        std::unique_lock<QMutex> locker(shard.mutex, std::adopt_lock);
+        const auto found = shard.index.constFind(key);
+        if (found == shard.index.constEnd()) {
+            return;
+        }
+        shard.slots[found.value()].pinned = pinned;
+    }
+
+    logCacheOperation(pinned ? "pinEntry" : "unpinEntry", externalKey(key), true, QString("Category: %1").arg(key.category));
+}
+
+void MusicCache::notifyAccess(const Key& key, bool hit)
+{
+    // The key string costs more than the lookup: only built for listeners
+    static const QMetaMethod hitSignal = QMetaMethod::fromSignal(&MusicCache::cacheHit);
+    static const QMetaMethod missSignal = QMetaMethod::fromSignal(&MusicCache::cacheMiss);
+
+    if (hit && isSignalConnected(hitSignal)) {
+        emit cacheHit(externalKey(key), key.category);
+    } else if (!hit && isSignalConnected(missSignal)) {
+        emit cacheMiss(externalKey(key), key.category);
+    }
+}
+
+void MusicCache::notifyEvictions(const QList<Eviction>& evictions)
+{
+    for (const Eviction& eviction : evictions) {
+        emit entryEvicted(eviction.key, eviction.category, eviction.reason);
     }
-    
-    return evicted;
 }
 
 void MusicCache::updateStatistics()
 {
-    QMutexLocker locker(&m_statsMutex);
-    
-    // Update current entries count
-    m_statistics.currentEntries = m_cache.size();
-    
-    // Emit statistics update
-    emit statisticsUpdated(m_statistics);
+    emit statisticsUpdated(getStatistics());
 }
 
 void MusicCache::logCacheOperation(const QString& operation, const QString& key, bool success, const QString& details)
@@ -1224,14 +1765,10 @@ void MusicCache::logCacheOperation(const QString& operation, const QString& key,
                      .arg(operation)
                      .arg(key.left(50)) // Truncate long keys
                      .arg(success ? "true" : "false");
-    
+
     if (!details.isEmpty()) {
         message += QString(", Details: %1").arg(details);
     }
-    
+
     ErrorHandler::logMessage(ErrorHandler::ErrorSeverity::Info, "MusicCache", message);
 }
-
-// Register MusicItem with Qt's meta-type system for QVariant storage
-Q_DECLARE_METATYPE(MusicItem)
-Q_DECLARE_METATYPE(QList<MusicItem>)
\ No newline at end of file
@@ -2,14 +2,16 @@
 #define MUSICCACHE_H
 
 #include <QObject>
-#include <QCache>
+#include <QAtomicInt>
 #include <QHash>
+#include <QList>
 #include <QMutex>
 #include <QTimer>
 #include <QDateTime>
 #include <QVariant>
 #include <QJsonObject>
 #include <QJsonDocument>
+#include <functional>
 #include <memory>
 
 // Forward declarations
@@ -25,14 +27,20 @@ struct MusicItem;
  * accessed music data.
  * 
  * Features:
- * - LRU (Least Recently Used) cache eviction
+ * - Sharded storage: each shard has its own lock, so loader threads
+ *   working on different entries do not wait for each other
+ * - CLOCK (second chance) eviction within a memory budget per shard
+ * - Compact entries: a MusicItem is kept as pool ids for the strings that
+ *   repeat across the library (artist, genres, ...) and one UTF-8 block
+ *   for the rest, with monotonic millisecond timestamps
+ * - Byte accounting of what the entries and string pools actually hold
  * - Intelligent cache invalidation strategies
- * - Memory usage monitoring and limits
  * - Cache hit/miss statistics
- * - Automatic cache warming for popular items
- * - Thread-safe operations
- * - Cache persistence across application restarts
- * - Smart prefetching based on access patterns
+ * - Binary snapshots for fast warm starts, JSON export
+ * 
+ * The number of shards follows the memory limit: a shard gets at least
+ * MIN_SHARD_BYTES, so a small cache is a single CLOCK ring and a large
+ * one is split up to MAX_SHARDS ways.
  * 
  * @example
  * @code
@@ -151,6 +159,12 @@ public:
      */
     qint64 currentMemoryUsage() const;
 
+    /**
+     * @brief Get the number of shards
+     * @return Shard count, a power of two set by the memory limit
+     */
+    int shardCount() const;
+
     /**
      * @brief Set default expiration time for cache entries
      * @param seconds Expiration time in seconds
@@ -368,8 +382,30 @@ public:
      */
     bool loadFromFile(const QString& filePath);
 
+    /**
+     * @brief Save the cache as a binary snapshot
+     *
+     * Unlike saveToFile() the snapshot is meant to be read back by
+     * loadSnapshot() only: it is compact and quick to restore.
+     * @param filePath Path to save the snapshot to
+     * @return true if successful
+     */
+    bool saveSnapshot(const QString& filePath);
+
+    /**
+     * @brief Restore a snapshot written by saveSnapshot()
+     *
+     * Entries that have expired since are skipped.
+     * @param filePath Path to load the snapshot from
+     * @return true if successful
+     */
+    bool loadSnapshot(const QString& filePath);
+
     /**
      * @brief Enable/disable automatic cache persistence
+     *
+     * The cache is saved as a snapshot periodically and on shutdown, and
+     * restored by initialize().
      * @param enabled true to enable automatic persistence
      * @param filePath Path for automatic saves
      */
@@ -435,21 +471,185 @@ private slots:
      */
     void autoPersist();
 
+
 private:
+    /**
+     * @brief What an entry holds
+     */
+    enum EntryKind : quint8 {
+        TrackEntry,     // A MusicItem
+        SearchEntry,    // Search results
+        MetadataEntry   // Arbitrary metadata
+    };
+
+    /**
+     * @brief A MusicItem as the cache holds it
+     *
+     * Strings that repeat across the library are ids in the shard's
+     * string pool, the ones that do not share one UTF-8 block.
+     */
+    struct Track {
+        qint32 id = 0;
+        qint32 playedTimes = 0;
+        quint32 artist = 0;
+        quint32 genre1 = 0;
+        quint32 genre2 = 0;
+        quint32 country = 0;
+        quint32 publishedDate = 0;
+        quint32 time = 0;
+        QByteArray text;            // song, path and lastPlayed, NUL-separated
+    };
+
+    /**
+     * @brief Identity of an entry
+     */
+    struct Key {
+        EntryKind kind = TrackEntry;
+        qint32 musicId = 0;         // TrackEntry
+        QString category;
+        QString name;               // Search or metadata key
+
+        friend bool operator==(const Key& a, const Key& b)
+        {
+            return a.kind == b.kind && a.musicId == b.musicId
+                && a.category == b.category && a.name == b.name;
+        }
+
+        friend size_t qHash(const Key& key, size_t seed = 0)
+        {
+            return qHashMulti(seed, int(key.kind), key.musicId, key.category, key.name);
+        }
+    };
+
+    /**
+     * @brief One position of a shard's CLOCK ring
+     */
+    struct Slot {
+        Key key;                    // category is the pooled string
+        Track track;                // TrackEntry
+        QList<Track> results;       // SearchEntry
+        QVariant value;             // MetadataEntry
+        quint32 category = 0;       // Pool id of key.category
+        qint32 accessCount = 0;
+        qint64 bytes = 0;           // Held by the entry, pooled strings aside
+        qint64 createdAt = 0;       // Ticks, see now()
+        qint64 accessedAt = 0;
+        qint64 expiresAt = -1;      // -1: no expiration
+        bool used = false;
+        bool referenced = false;    // CLOCK reference bit
+        bool pinned = false;
+    };
+
+    /**
+     * @brief A string pool entry
+     */
+    struct PooledString {
+        QString text;
+        qint32 refs = 0;
+    };
+
+    /**
+     * @brief An independently locked part of the cache
+     *
+     * bytes covers the slots and the string pool and is held within
+     * m_shardBudget. Statistics are kept per shard as well, so recording
+     * a hit takes no lock but the shard's.
+     */
+    struct alignas(64) Shard {
+        QMutex mutex;
+        QHash<Key, int> index;      // Key -> slot
+        QList<Slot> slots;
+        QList<int> freeSlots;
+        int hand = 0;               // CLOCK hand
+        QList<PooledString> strings; // Pool id - 1 -> string
+        QHash<QString, quint32> stringIds;
+        QList<quint32> freeStrings;
+        qint64 bytes = 0;
+        qint64 hits = 0;
+        qint64 misses = 0;
+        qint64 evictions = 0;
+        QHash<QString, qint64> categoryHits;
+        QHash<QString, qint64> categoryMisses;
+        QHash<QString, qint64> categorySize;
+    };
+
+    /**
+     * @brief An evicted entry, reported once the shard is unlocked
+     */
+    struct Eviction {
+        QString key;
+        QString category;
+        QString reason;
+    };
+
+    /**
+     * @brief An entry decoded from its shard, for persistence and resharding
+     */
+    struct Record;
+
+    /**
+     * @brief Monotonic clock for entry timestamps
+     * @return Milliseconds since the first call
+     */
+    static qint64 now();
+
+    /**
+     * @brief Number of shards for a memory limit
+     * @param maxBytes Memory limit
+     * @return Power of two, at most MAX_SHARDS
+     */
+    static int shardCountFor(qint64 maxBytes);
+
+    /**
+     * @brief Lock the shard holding a key
+     * @param key Entry key
+     * @return The shard, locked by the caller's thread
+     */
+    Shard& lockShard(const Key& key);
+
+    /**
+     * @brief Run a function on each shard in turn, under its lock
+     */
+    void forEachShard(const std::function<void(Shard&)>& visit) const;
+
+    /**
+     * @brief Change the shard count and budget
+     *
+     * Locks every shard; entries move to their new shard in CLOCK order.
+     * @param shardCount New shard count
+     * @param maxBytes Memory limit to divide among the shards
+     */
+    void reshard(int shardCount, qint64 maxBytes);
+
+    static Key trackKey(int musicId, const QString& category);
+    static Key searchResultsKey(const QString& searchKey);
+    static Key metadataKey(const QString& key, const QString& category);
+
+    /**
+     * @brief Key of an entry named the way pinEntry() and getEntryInfo() take it
+     */
+    static Key entryKey(const QString& key, const QString& category);
+    static Key keyOf(const Record& record);
+
+    /**
+     * @brief Cache key as reported in signals and by getKeys()
+     */
+    static QString externalKey(const Key& key);
+
     /**
      * @brief Generate cache key for music item
      * @param musicId Music item ID
      * @param category Category
      * @return Cache key
      */
-    QString generateMusicKey(int musicId, const QString& category);
+    static QString generateMusicKey(int musicId, const QString& category);
 
     /**
      * @brief Generate cache key for search results
      * @param searchKey Search key
      * @return Cache key
      */
-    QString generateSearchKey(const QString& searchKey);
+    static QString generateSearchKey(const QString& searchKey);
 
     /**
      * @brief Generate cache key for metadata
@@ -457,28 +657,82 @@ private:
      * @param category Category
      * @return Cache key
      */
-    QString generateMetadataKey(const QString& key, const QString& category);
+    static QString generateMetadataKey(const QString& key, const QString& category);
+
+    quint32 intern(Shard& shard, const QString& text);
+    void release(Shard& shard, quint32 id);
+    Track encode(Shard& shard, const MusicItem& music);
+    void releaseTrack(Shard& shard, const Track& track);
+    static MusicItem decode(const Shard& shard, const Track& track);
 
     /**
-     * @brief Calculate size of data in bytes
-     * @param data Data to calculate size for
-     * @return Size in bytes
+     * @brief Bytes held by a slot, pooled strings aside
      */
-    qint64 calculateDataSize(const QVariant& data);
+    static qint64 slotBytes(const Slot& slot);
 
     /**
      * @brief Check if entry has expired
-     * @param entry Cache entry to check
+     * @param expiresAt Expiration of the entry, -1 for none
+     * @param accessedAt Last access to the entry
+     * @param tick Current time, see now()
      * @return true if expired
      */
-    bool isExpired(const CacheEntry& entry);
+    bool isExpired(qint64 expiresAt, qint64 accessedAt, qint64 tick) const;
+
+    /**
+     * @brief Find an entry, dropping it if it has expired
+     * @return The entry or nullptr
+     */
+    Slot* find(Shard& shard, const Key& key, qint64 tick);
+
+    /**
+     * @brief find() for a read: counts the hit or miss and marks the entry
+     */
+    Slot* lookup(Shard& shard, const Key& key);
+
+    /**
+     * @brief Store a new entry in its shard
+     * @return false if it has expired or did not fit
+     */
+    bool insert(const Record& record);
+
+    /**
+     * @brief Store an entry, replacing any with the same key
+     *
+     * Evicts with CLOCK until the shard is within its budget; the new entry
+     * itself goes last, when it does not fit beside the pinned ones.
+     * @return Slot of the entry, -1 if it did not fit
+     */
+    int store(Shard& shard, Slot slot, QList<Eviction>* evictions);
 
     /**
-     * @brief Evict least recently used entries
-     * @param targetSize Target cache size after eviction
-     * @return Number of entries evicted
+     * @brief Next CLOCK victim: the first unreferenced, unpinned slot
+     *        after the hand, clearing reference bits on the way
+     * @param keep Slot not to evict, -1 for none
+     * @return Slot or -1 if every entry is pinned
      */
-    int evictLRU(qint64 targetSize);
+    int clockVictim(Shard& shard, int keep);
+
+    void evict(Shard& shard, int position, const QString& reason, QList<Eviction>* evictions);
+    void drop(Shard& shard, int position);
+    void resetShard(Shard& shard);
+    void account(Shard& shard, qint64 bytes);
+
+    Record toRecord(const Shard& shard, const Slot& slot) const;
+    int restore(Shard& shard, const Record& record, QList<Eviction>* evictions);
+
+    /**
+     * @brief Copy the entries of one shard
+     * @param shardIndex Shard, empty if not in use
+     */
+    QList<Record> shardRecords(int shardIndex);
+
+    bool containsKey(const Key& key);
+    bool removeKey(const Key& key);
+    void setPinned(const Key& key, bool pinned);
+
+    void notifyAccess(const Key& key, bool hit);
+    void notifyEvictions(const QList<Eviction>& evictions);
 
     /**
      * @brief Update cache statistics
@@ -494,19 +748,23 @@ private:
      */
     void logCacheOperation(const QString& operation, const QString& key, bool success, const QString& details = QString());
 
-    // Cache storage
-    mutable QMutex m_cacheMutex;
-    QHash<QString, CacheEntry> m_cache;
+    // Cache storage: MAX_SHARDS allocated, m_shardMask + 1 in use
+    std::unique_ptr<Shard[]> m_shards;
+    QAtomicInt m_shardMask;
+    qint64 m_shardBudget;           // Changed with every shard locked
+    QAtomicInteger<qint64> m_memoryUsage;
+    QAtomicInteger<qint64> m_entryCount;
     
     // Configuration
-    qint64 m_maxMemoryUsage;
-    int m_defaultExpirationTime;
-    InvalidationStrategy m_invalidationStrategy;
+    QAtomicInteger<qint64> m_maxMemoryUsage;
+    QAtomicInt m_defaultExpirationTime;
+    QAtomicInt m_invalidationStrategy;
     WarmupStrategy m_warmupStrategy;
     
-    // Statistics
+    // Statistics not kept per shard
     mutable QMutex m_statsMutex;
-    CacheStatistics m_statistics;
+    QDateTime m_lastCleanup;
+    QDateTime m_lastWarmup;
     
     // Maintenance
     QTimer* m_maintenanceTimer;
@@ -521,6 +779,8 @@ private:
     static constexpr int PERSISTENCE_INTERVAL_MS = 600000; // 10 minutes
     static constexpr double MEMORY_CLEANUP_THRESHOLD = 0.9; // 90% of max memory
     static constexpr double MEMORY_CLEANUP_TARGET = 0.7; // 70% of max memory
+    static constexpr int MAX_SHARDS = 64;
+    static constexpr qint64 MIN_SHARD_BYTES = 512 * 1024;
 };
 
-#endif // MUSICCACHE_H
\ No newline at end of file
+#endif // MUSICCACHE_H
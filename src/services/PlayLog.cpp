@@ -0,0 +1,205 @@
+#include "PlayLog.h"
+#include "DatabaseAccess.h"
+#include <QIODevice>
+#include <QSqlError>
+#include <QSqlQuery>
+#include <QTextStream>
+#include <QDebug>
+
+namespace {
+
+// RFC 4180: quote fields holding a separator, a quote or a line break
+QString csvField(const QString& value)
+{
+    if (!value.contains(QLatin1Char(',')) && !value.contains(QLatin1Char('"'))
+            && !value.contains(QLatin1Char('\n')) && !value.contains(QLatin1Char('\r')))
+        return value;
+    QString quoted = value;
+    quoted.replace(QLatin1String("\""), QLatin1String("\"\""));
+    return QLatin1Char('"') + quoted + QLatin1Char('"');
+}
+
+QString csvTime(qint64 ms)
+{
+    return QDateTime::fromMSecsSinceEpoch(ms).toString("yyyy-MM-dd HH:mm:ss");
+}
+
+} // namespace
+
+PlayLog::PlayLog(DatabaseAccess* writer, QObject* parent)
+    : QObject(parent)
+    , m_writer(writer)
+{
+}
+
+void PlayLog::started(const QString& source, const QString& path, const QDateTime& at)
+{
+    stopped(source, at);
+
+    OnAir play;
+    play.path = path;
+    play.started = at;
+    play.since = at;
+    m_onAir.insert(source, play);
+}
+
+void PlayLog::stopped(const QString& source, const QDateTime& at)
+{
+    const auto it = m_onAir.constFind(source);
+    if (it == m_onAir.constEnd())
+        return;
+
+    Play play;
+    play.path = it->path;
+    play.source = source;
+    play.started = it->started;
+    play.ended = at;
+    play.airedMs = it->airedMs + (it->since.isValid() ? qMax<qint64>(0, it->since.msecsTo(at)) : 0);
+    m_onAir.erase(it);
+    record(play);
+}
+
+void PlayLog::paused(const QString& source, const QDateTime& at)
+{
+    const auto it = m_onAir.find(source);
+    if (it == m_onAir.end() || !it->since.isValid())
+        return;
+    it->airedMs += qMax<qint64>(0, it->since.msecsTo(at));
+    it->since = QDateTime();
+}
+
+void PlayLog::resumed(const QString& source, const QDateTime& at)
+{
+    const auto it = m_onAir.find(source);
+    if (it != m_onAir.end() && !it->since.isValid())
+        it->since = at;
+}
+
+void PlayLog::record(const Play& play)
+{
+    if (!m_writer || play.path.isEmpty() || !play.started.isValid())
+        return;
+
+    const QDateTime ended = play.ended.isValid() ? play.ended : play.started;
+    const qint64 airedMs = play.airedMs >= 0 ? play.airedMs : qMax<qint64>(0, play.started.msecsTo(ended));
+
+    // The track is looked up on the writer thread, through idx_musics_path
+    m_writer->write("INSERT INTO play_log (track, path, started, ended, aired_ms, source) VALUES "
+                    "(COALESCE(?, (SELECT rowid FROM musics WHERE path = ? LIMIT 1)), ?, ?, ?, ?, ?)",
+                    {play.trackId > 0 ? QVariant(play.trackId) : QVariant(QMetaType(QMetaType::LongLong)),
+                     play.path, play.path, play.started.toMSecsSinceEpoch(), ended.toMSecsSinceEpoch(),
+                     airedMs, play.source});
+}
+
+QList<PlayLog::TrackPlays> PlayLog::playsPerTrack(const QSqlDatabase& database, const QDateTime& from,
+                                                  const QDateTime& to, QString* error)
+{
+    // The aggregate reads idx_play_log_started_path alone; musics is only
+    // visited once per path, by idx_musics_path. Plays are matched to the
+    // library by path: a VACUUM renumbers musics, so the logged rowid may
+    // belong to another track by now. Files outside the library are summed
+    // into one row (NULL track).
+    QSqlQuery query(database);
+    query.setForwardOnly(true);
+    query.prepare("SELECT t.track, t.path, t.artist, t.song, SUM(t.plays) AS plays, SUM(t.aired) AS aired FROM "
+                  "(SELECT m.rowid AS track, m.path, m.artist, m.song, p.plays, p.aired FROM "
+                  "(SELECT path, COUNT(*) AS plays, SUM(aired_ms) AS aired FROM play_log "
+                  "WHERE started >= ? AND started < ? GROUP BY path) AS p "
+                  "LEFT JOIN musics m ON m.rowid = (SELECT rowid FROM musics WHERE path = p.path LIMIT 1)) AS t "
+                  "GROUP BY t.track ORDER BY plays DESC, aired DESC");
+    query.addBindValue(from.toMSecsSinceEpoch());
+    query.addBindValue(to.toMSecsSinceEpoch());
+
+    QList<TrackPlays> result;
+    if (!query.exec()) {
+        qWarning() << "PlayLog: could not report plays:" << query.lastError().text();
+        if (error)
+            *error = query.lastError().text();
+        return result;
+    }
+    while (query.next()) {
+        TrackPlays plays;
+        plays.trackId = query.value(0).toLongLong();
+        plays.path = query.value(1).toString();
+        plays.artist = query.value(2).toString();
+        plays.title = query.value(3).toString();
+        plays.plays = query.value(4).toInt();
+        plays.airedMs = query.value(5).toLongLong();
+        result << plays;
+    }
+    return result;
+}
+
+PlayLog::TrackPlays PlayLog::playsOf(const QSqlDatabase& database, qint64 trackId,
+                                     const QDateTime& from, const QDateTime& to)
+{
+    TrackPlays plays;
+    plays.trackId = trackId;
+
+    QSqlQuery query(database);
+    // By path, through idx_play_log_path: the rowid is only current in musics
+    query.prepare("SELECT COUNT(*), COALESCE(SUM(aired_ms), 0) FROM play_log "
+                  "WHERE path = (SELECT path FROM musics WHERE rowid = ?) AND started >= ? AND started < ?");
+    query.addBindValue(trackId);
+    query.addBindValue(from.toMSecsSinceEpoch());
+    query.addBindValue(to.toMSecsSinceEpoch());
+    if (query.exec() && query.next()) {
+        plays.plays = query.value(0).toInt();
+        plays.airedMs = query.value(1).toLongLong();
+    } else {
+        qWarning() << "PlayLog: could not count plays:" << query.lastError().text();
+    }
+    return plays;
+}
+
+qint64 PlayLog::exportCsv(const QSqlDatabase& database, QIODevice* device,
+                          const QDateTime& from, const QDateTime& to, QString* error)
+{
+    if (!device || !device->isWritable()) {
+        if (error)
+            *error = tr("The export file is not open for writing");
+        return -1;
+    }
+
+    // Forward-only: the driver steps through the result instead of
+    // caching it, so memory stays flat however long the period
+    QSqlQuery query(database);
+    query.setForwardOnly(true);
+    query.prepare("SELECT p.started, p.ended, p.aired_ms, p.source, m.artist, m.song, p.path "
+                  "FROM play_log p "
+                  "LEFT JOIN musics m ON m.rowid = (SELECT rowid FROM musics WHERE path = p.path LIMIT 1) "
+                  "WHERE p.started >= ? AND p.started < ? ORDER BY p.started");
+    query.addBindValue(from.toMSecsSinceEpoch());
+    query.addBindValue(to.toMSecsSinceEpoch());
+    if (!query.exec()) {
+        qWarning() << "PlayLog: could not export:" << query.lastError().text();
+        if (error)
+            *error = query.lastError().text();
+        return -1;
+    }
+
+    QTextStream out(device);
+    out.setEncoding(QStringConverter::Utf8);
+    out << "started,ended,aired_seconds,deck,artist,title,path\n";
+
+    qint64 rows = 0;
+    while (query.next()) {
+        out << csvTime(query.value(0).toLongLong()) << ','
+            << csvTime(query.value(1).toLongLong()) << ','
+            << QString::number(query.value(2).toLongLong() / 1000.0, 'f', 1) << ','
+            << csvField(query.value(3).toString()) << ','
+            << csvField(query.value(4).toString()) << ','
+            << csvField(query.value(5).toString()) << ','
+            << csvField(query.value(6).toString()) << '\n';
+        if (++rows % 1000 == 0)
+            out.flush();
+    }
+    out.flush();
+
+    if (out.status() != QTextStream::Ok) {
+        if (error)
+            *error = tr("Could not write the export: %1").arg(device->errorString());
+        return -1;
+    }
+    return rows;
+}
@@ -0,0 +1,154 @@
+#ifndef PLAYLOG_H
+#define PLAYLOG_H
+
+#include <QObject>
+#include <QDateTime>
+#include <QHash>
+#include <QList>
+#include <QSqlDatabase>
+
+class QIODevice;
+class DatabaseAccess;
+
+/**
+ * @brief Per-play history for royalty reports
+ *
+ * Every play on a deck becomes one row of the append-only play_log table:
+ * its path, the musics row it played at the time (NULL for a file outside
+ * the library), when it started and ended, how long it was actually on
+ * air (pauses left out) and the deck. Rows are queued for the
+ * DatabaseAccess writer, which batches them into its transactions, so
+ * logging never waits on the database.
+ *
+ * Reports match plays to the library by path, never by the logged rowid:
+ * musics has no INTEGER PRIMARY KEY, so a VACUUM renumbers it. A trigger
+ * on musics moves the logged path when a file is moved or converted. play_log
+ * has two covering indexes, (path, started, aired_ms) and (started, path,
+ * aired_ms), so plays per track per period are read from an index alone.
+ * exportCsv() streams a period row by row.
+ *
+ * @example
+ * @code
+ * PlayLog* log = new PlayLog(databaseAccess, this);
+ * log->started(PlayLog::mainDeck(), path);
+ * ...
+ * log->stopped(PlayLog::mainDeck());
+ * @endcode
+ *
+ * @since XFB 2.0
+ */
+class PlayLog : public QObject
+{
+    Q_OBJECT
+
+public:
+    /**
+     * @brief One finished play
+     */
+    struct Play {
+        qint64 trackId = 0;       // musics rowid at the time; 0 to look it up by path
+        QString path;
+        QString source;           // deck it aired on
+        QDateTime started;
+        QDateTime ended;
+        qint64 airedMs = -1;      // -1: ended - started
+    };
+
+    /**
+     * @brief Plays of one track in a period
+     */
+    struct TrackPlays {
+        qint64 trackId = 0;       // current musics rowid; 0: files outside the library, summed
+        QString path;
+        QString artist;
+        QString title;
+        int plays = 0;
+        qint64 airedMs = 0;
+    };
+
+    explicit PlayLog(DatabaseAccess* writer, QObject* parent = nullptr);
+
+    /**
+     * @brief A track went on air; ends what the deck had on air before
+     * @param source Deck
+     * @param path Track path
+     * @param at When it started
+     */
+    void started(const QString& source, const QString& path,
+                 const QDateTime& at = QDateTime::currentDateTime());
+
+    /**
+     * @brief The deck stopped; logs what it had on air
+     */
+    void stopped(const QString& source, const QDateTime& at = QDateTime::currentDateTime());
+
+    /**
+     * @brief The deck paused; the time until resumed() does not count as aired
+     */
+    void paused(const QString& source, const QDateTime& at = QDateTime::currentDateTime());
+    void resumed(const QString& source, const QDateTime& at = QDateTime::currentDateTime());
+
+    /**
+     * @brief Check if a deck has a play in progress
+     */
+    bool isOnAir(const QString& source) const { return m_onAir.contains(source); }
+
+    /**
+     * @brief Queue a finished play for the writer
+     * @param play Play to log
+     */
+    void record(const Play& play);
+
+    /**
+     * @brief Plays per track in a period, most played first
+     * @param database Library database
+     * @param from Start of the period
+     * @param to End of the period, exclusive
+     * @param error Set to the error message on failure
+     * @return Plays per track, empty on failure
+     */
+    static QList<TrackPlays> playsPerTrack(const QSqlDatabase& database, const QDateTime& from,
+                                           const QDateTime& to, QString* error = nullptr);
+
+    /**
+     * @brief Plays of one track in a period
+     * @param database Library database
+     * @param trackId Current musics rowid; plays are counted by its path
+     * @param from Start of the period
+     * @param to End of the period, exclusive
+     * @return Plays and airtime; zero if none or on failure
+     */
+    static TrackPlays playsOf(const QSqlDatabase& database, qint64 trackId,
+                              const QDateTime& from, const QDateTime& to);
+
+    /**
+     * @brief Write a period of the log as CSV, one row at a time
+     *
+     * Columns: started, ended, aired seconds, deck, artist, title, path.
+     *
+     * @param database Library database
+     * @param device Open, writable device
+     * @param from Start of the period
+     * @param to End of the period, exclusive
+     * @param error Set to the error message on failure
+     * @return Plays written, -1 on failure
+     */
+    static qint64 exportCsv(const QSqlDatabase& database, QIODevice* device,
+                            const QDateTime& from, const QDateTime& to, QString* error = nullptr);
+
+    static QString mainDeck() { return QStringLiteral("main"); }
+    static QString deck(int number) { return QStringLiteral("deck%1").arg(number); }
+
+private:
+    struct OnAir {
+        QString path;
+        QDateTime started;
+        qint64 airedMs = 0;       // up to the last pause
+        QDateTime since;          // null while paused
+    };
+
+    DatabaseAccess* m_writer;
+    QHash<QString, OnAir> m_onAir;
+};
+
+#endif // PLAYLOG_H
@@ -0,0 +1,439 @@
+#include "ProgramRecorder.h"
+#include "../audio/FrameRing.h"
+#include <QAudioFormat>
+#include <QAudioSource>
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QIODevice>
+#include <QMutexLocker>
+#include <QTimer>
+#include <QDebug>
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+
+namespace {
+
+constexpr int kDrainIntervalMs = 50;
+// Capture slack before input is lost: the worker may stall this long
+constexpr int kRingSeconds = 10;
+
+} // namespace
+
+// ------------------------------------------------------------ CaptureDevice
+
+/**
+ * The QAudioSource writes here, on the capture thread: samples are turned
+ * into float and copied into the ring, nothing more.
+ */
+class ProgramRecorder::CaptureDevice : public QIODevice
+{
+public:
+    CaptureDevice(FrameRing* ring, const QAudioFormat& format)
+        : m_ring(ring)
+        , m_format(format)
+        , m_bytesPerSample(std::max(1, format.bytesPerSample()))
+        , m_bytesPerFrame(std::max(1, format.bytesPerFrame()))
+    {
+    }
+
+    std::atomic<bool> paused{false};
+    std::atomic<quint64> dropped{0};
+
+protected:
+    qint64 readData(char*, qint64) override { return -1; }
+
+    qint64 writeData(const char* data, qint64 len) override
+    {
+        if (paused.load(std::memory_order_relaxed)) {
+            m_carry.clear();
+            return len;
+        }
+        const char* p = data;
+        qint64 left = len;
+        // A frame split across two writes
+        if (!m_carry.isEmpty()) {
+            const qint64 take = std::min<qint64>(left, m_bytesPerFrame - m_carry.size());
+            m_carry.append(p, take);
+            p += take;
+            left -= take;
+            if (m_carry.size() < m_bytesPerFrame)
+                return len;
+            convert(m_carry.constData(), 1);
+            m_carry.clear();
+        }
+        const qint64 frames = left / m_bytesPerFrame;
+        convert(p, static_cast<size_t>(frames));
+        m_carry.append(p + frames * m_bytesPerFrame, left - frames * m_bytesPerFrame);
+        return len;
+    }
+
+private:
+    void convert(const char* in, size_t frames)
+    {
+        const int channels = m_ring->channels();
+        while (frames > 0) {
+            FrameRing::Region first, second;
+            const size_t room = m_ring->prepareWrite(frames, first, second);
+            if (room == 0) {
+                dropped.fetch_add(frames, std::memory_order_relaxed);
+                return;
+            }
+            for (const FrameRing::Region& region : {first, second}) {
+                const size_t samples = region.frames * static_cast<size_t>(channels);
+                for (size_t i = 0; i < samples; ++i, in += m_bytesPerSample)
+                    region.data[i] = sample(in);
+            }
+            m_ring->commitWrite(room);
+            frames -= room;
+        }
+    }
+
+    float sample(const char* in) const
+    {
+        switch (m_format.sampleFormat()) {
+        case QAudioFormat::UInt8:
+            return (static_cast<int>(static_cast<quint8>(*in)) - 128) / 128.0f;
+        case QAudioFormat::Int16: {
+            qint16 v;
+            memcpy(&v, in, sizeof(v));
+            return v / 32768.0f;
+        }
+        case QAudioFormat::Int32: {
+            qint32 v;
+            memcpy(&v, in, sizeof(v));
+            return static_cast<float>(v / 2147483648.0);
+        }
+        case QAudioFormat::Float: {
+            float v;
+            memcpy(&v, in, sizeof(v));
+            return v;
+        }
+        default:
+            break;
+        }
+        return 0.0f;
+    }
+
+    FrameRing* m_ring;
+    QAudioFormat m_format;
+    int m_bytesPerSample;
+    int m_bytesPerFrame;
+    QByteArray m_carry;
+};
+
+// ---------------------------------------------------------- ProgramRecorder
+
+ProgramRecorder::ProgramRecorder(EncoderFactory encoderFactory, QObject* parent)
+    : QObject(parent)
+{
+    m_worker = new ProgramRecorderWorker(std::move(encoderFactory));
+    m_worker->moveToThread(&m_thread);
+    connect(&m_thread, &QThread::finished, m_worker, &QObject::deleteLater);
+    connect(m_worker, &ProgramRecorderWorker::segmentFinished, this, &ProgramRecorder::segmentFinished);
+    connect(m_worker, &ProgramRecorderWorker::finished, this, &ProgramRecorder::finished);
+    connect(m_worker, &ProgramRecorderWorker::recovered, this, &ProgramRecorder::recovered);
+    connect(m_worker, &ProgramRecorderWorker::errorOccurred, this, [this](const QString& error) {
+        // The recording cannot go on: stop feeding it
+        if (m_recording) {
+            stopCapture();
+            m_recording = false;
+        }
+        emit errorOccurred(error);
+    });
+    m_thread.setObjectName(QStringLiteral("ProgramRecorderThread"));
+    m_thread.start();
+
+    m_captureContext = new QObject;
+    m_captureContext->moveToThread(&m_captureThread);
+    connect(&m_captureThread, &QThread::finished, m_captureContext, &QObject::deleteLater);
+    m_captureThread.setObjectName(QStringLiteral("ProgramCaptureThread"));
+    m_captureThread.start(QThread::TimeCriticalPriority);
+}
+
+ProgramRecorder::~ProgramRecorder()
+{
+    shutdown();
+    m_captureThread.quit();
+    m_captureThread.wait();
+    m_thread.quit();
+    m_thread.wait();
+}
+
+bool ProgramRecorder::start(const QAudioDevice& device, const RecordingSegmenter::Settings& settings,
+                            const QString& outputBase, QString* error)
+{
+    if (m_recording)
+        shutdown();
+
+    // Float at the requested rate if the device does it, else its own format
+    QAudioFormat format;
+    format.setSampleRate(settings.sampleRate);
+    format.setChannelCount(settings.channels);
+    format.setSampleFormat(QAudioFormat::Float);
+    if (!device.isFormatSupported(format)) {
+        format.setSampleFormat(QAudioFormat::Int16);
+        if (!device.isFormatSupported(format))
+            format = device.preferredFormat();
+    }
+    RecordingSegmenter::Settings actual = settings;
+    actual.sampleRate = format.sampleRate();
+    actual.channels = format.channelCount();
+
+    auto newRing = std::make_unique<FrameRing>(actual.channels);
+    newRing->reset(static_cast<size_t>(actual.sampleRate) * kRingSeconds);
+
+    // Queued behind a previous stop(), which may still be draining m_ring
+    bool ok = false;
+    QString startError;
+    ProgramRecorderWorker* worker = m_worker;
+    FrameRing* ring = newRing.get();
+    QMetaObject::invokeMethod(worker, [&]() {
+        ok = worker->start(ring, actual, outputBase, &startError);
+    }, Qt::BlockingQueuedConnection);
+    if (!ok) {
+        if (error)
+            *error = startError;
+        return false;
+    }
+    m_ring = std::move(newRing);
+
+    QMetaObject::invokeMethod(m_captureContext, [&]() {
+        m_capture = new CaptureDevice(ring, format);
+        m_capture->open(QIODevice::WriteOnly);
+        m_source = new QAudioSource(device, format, m_captureContext);
+        m_source->setBufferSize(format.bytesForDuration(100000));
+        m_source->start(m_capture);
+        if (m_source->error() != QAudio::NoError) {
+            startError = tr("Cannot open %1 (error %2)").arg(device.description()).arg(int(m_source->error()));
+            ok = false;
+        }
+    }, Qt::BlockingQueuedConnection);
+    if (!ok) {
+        stopCapture();
+        QMetaObject::invokeMethod(worker, [worker]() { worker->discard(); }, Qt::BlockingQueuedConnection);
+        if (error)
+            *error = startError;
+        return false;
+    }
+
+    qDebug() << "ProgramRecorder: recording" << device.description() << "at" << actual.sampleRate << "Hz,"
+             << actual.channels << "channel(s)," << format.sampleFormat();
+    m_recording = true;
+    return true;
+}
+
+void ProgramRecorder::stop()
+{
+    if (!m_recording)
+        return;
+    stopCapture();
+    m_recording = false;
+    ProgramRecorderWorker* worker = m_worker;
+    QMetaObject::invokeMethod(worker, [worker]() { worker->stop(true); });
+}
+
+void ProgramRecorder::shutdown()
+{
+    if (!m_recording)
+        return;
+    stopCapture();
+    m_recording = false;
+    ProgramRecorderWorker* worker = m_worker;
+    QMetaObject::invokeMethod(worker, [worker]() { worker->stop(false); }, Qt::BlockingQueuedConnection);
+}
+
+void ProgramRecorder::setPaused(bool paused)
+{
+    if (m_capture)
+        m_capture->paused.store(paused, std::memory_order_relaxed);
+}
+
+bool ProgramRecorder::isPaused() const
+{
+    return m_capture && m_capture->paused.load(std::memory_order_relaxed);
+}
+
+ProgramRecorder::Stats ProgramRecorder::stats() const
+{
+    Stats stats = m_worker->stats();
+    if (m_capture)
+        stats.droppedFrames = m_capture->dropped.load(std::memory_order_relaxed);
+    return stats;
+}
+
+void ProgramRecorder::stopCapture()
+{
+    if (!m_source && !m_capture)
+        return;
+    QMetaObject::invokeMethod(m_captureContext, [this]() {
+        if (m_source) {
+            m_source->stop();
+            delete m_source;
+            m_source = nullptr;
+        }
+        delete m_capture;
+        m_capture = nullptr;
+    }, Qt::BlockingQueuedConnection);
+}
+
+// ------------------------------------------------------ ProgramRecorderWorker
+
+ProgramRecorderWorker::ProgramRecorderWorker(ProgramRecorder::EncoderFactory encoderFactory)
+    : m_segmenter(std::move(encoderFactory))
+{
+}
+
+ProgramRecorderWorker::~ProgramRecorderWorker()
+{
+    stop(false);
+}
+
+bool ProgramRecorderWorker::start(FrameRing* ring, RecordingSegmenter::Settings settings,
+                                  const QString& outputBase, QString* error)
+{
+    stop(false);
+    if (!m_drainTimer) {
+        m_drainTimer = new QTimer(this);
+        m_drainTimer->setTimerType(Qt::PreciseTimer);
+        connect(m_drainTimer, &QTimer::timeout, this, &ProgramRecorderWorker::drain);
+    }
+
+    settings.directory = outputBase + QStringLiteral(".parts");
+    settings.baseName = QFileInfo(outputBase).fileName();
+    recover(settings.directory, settings.baseName, outputBase);
+
+    QString openError;
+    if (!m_segmenter.open(settings, &openError)) {
+        if (settings.format == RecordingSegmenter::Format::Wav) {
+            if (error)
+                *error = openError;
+            return false;
+        }
+        qWarning() << "ProgramRecorder:" << openError << "- recording WAV instead";
+        settings.format = RecordingSegmenter::Format::Wav;
+        if (!m_segmenter.open(settings, error))
+            return false;
+    }
+
+    m_ring = ring;
+    m_outputBase = outputBase;
+    m_announced = 0;
+    m_drainTimer->start(kDrainIntervalMs);
+    updateStats();
+    return true;
+}
+
+void ProgramRecorderWorker::stop(bool join)
+{
+    if (m_drainTimer)
+        m_drainTimer->stop();
+    if (!m_segmenter.isOpen())
+        return;
+
+    drain();
+    QString error;
+    const bool closed = m_segmenter.close(&error);
+    announceSegments();
+    updateStats();
+    m_ring = nullptr;
+    if (!join)
+        return;
+    if (!closed) {
+        emit errorOccurred(error);
+        return;
+    }
+
+    const QStringList segments = m_segmenter.segments();
+    const QString output = m_outputBase + '.' + RecordingSegmenter::extension(m_segmenter.settings().format);
+    if (!RecordingSegmenter::concatenate(segments, output, &error)) {
+        // The segments stay where they are; the next start() tries again
+        emit errorOccurred(tr("Cannot join the recording: %1").arg(error));
+        return;
+    }
+    for (const QString& segment : segments)
+        QFile::remove(segment);
+    QDir().rmdir(m_segmenter.settings().directory);
+    emit finished(output);
+}
+
+void ProgramRecorderWorker::discard()
+{
+    stop(false);
+    for (const QString& segment : m_segmenter.segments())
+        QFile::remove(segment);
+    QDir().rmdir(m_segmenter.settings().directory);
+}
+
+ProgramRecorder::Stats ProgramRecorderWorker::stats() const
+{
+    QMutexLocker locker(&m_statsMutex);
+    return m_stats;
+}
+
+void ProgramRecorderWorker::drain()
+{
+    if (!m_ring || !m_segmenter.isOpen())
+        return;
+    for (;;) {
+        FrameRing::Region first, second;
+        if (m_ring->peek(m_ring->availableFrames(), first, second) == 0)
+            break;
+        size_t taken = m_segmenter.write(first.data, first.frames);
+        if (taken == first.frames && second.frames > 0)
+            taken += m_segmenter.write(second.data, second.frames);
+        m_ring->commitRead(taken);
+        // The encoder is behind: the rest waits in the ring
+        if (taken < first.frames + second.frames || m_segmenter.failed())
+            break;
+    }
+    // Collect output even when nothing new came in (paused)
+    m_segmenter.write(nullptr, 0);
+    announceSegments();
+    updateStats();
+
+    if (m_segmenter.failed()) {
+        m_drainTimer->stop();
+        QString error;
+        m_segmenter.close(&error);
+        emit errorOccurred(m_segmenter.errorString());
+    }
+}
+
+void ProgramRecorderWorker::recover(const QString& partsDir, const QString& baseName, const QString& outputBase)
+{
+    const QStringList leftovers = RecordingSegmenter::findSegments(partsDir, baseName);
+    if (leftovers.isEmpty())
+        return;
+    const QString output = QString("%1-recovered-%2.%3")
+                               .arg(outputBase, QDateTime::currentDateTime().toString("yyyyMMdd-HHmmss"),
+                                    QFileInfo(leftovers.first()).suffix());
+    QString error;
+    if (!RecordingSegmenter::concatenate(leftovers, output, &error)) {
+        qWarning() << "ProgramRecorder: cannot recover the interrupted recording:" << error;
+        return;
+    }
+    for (const QString& segment : leftovers)
+        QFile::remove(segment);
+    qWarning() << "ProgramRecorder: recovered an interrupted recording to" << output;
+    emit recovered(output);
+}
+
+void ProgramRecorderWorker::announceSegments()
+{
+    for (const QString& segment : m_segmenter.takeClosedSegments())
+        emit segmentFinished(segment, ++m_announced);
+}
+
+void ProgramRecorderWorker::updateStats()
+{
+    const RecordingSegmenter::Settings& settings = m_segmenter.settings();
+    ProgramRecorder::Stats stats;
+    stats.recordedMs = settings.sampleRate > 0 ? m_segmenter.framesWritten() * 1000 / settings.sampleRate : 0;
+    stats.bytesWritten = m_segmenter.bytesWritten();
+    stats.segments = m_announced;
+    QMutexLocker locker(&m_statsMutex);
+    m_stats = stats;
+}
@@ -0,0 +1,157 @@
+#ifndef PROGRAMRECORDER_H
+#define PROGRAMRECORDER_H
+
+#include <QObject>
+#include <QAudioDevice>
+#include <QMutex>
+#include <QString>
+#include <QStringList>
+#include <QThread>
+#include <memory>
+
+#include "RecordingSegmenter.h"
+#include "../audio/FrameRing.h"
+
+class QAudioSource;
+class QTimer;
+class ProgramRecorderWorker;
+
+/**
+ * @brief Records a program from an audio input straight to disk
+ *
+ * A QAudioSource on a capture thread of its own converts what it gets to
+ * float and drops it into a lock-free ring (10 s); nothing else happens on
+ * that thread, so a slow disk or encoder never makes it miss input. A
+ * worker thread drains the ring every 50 ms into a RecordingSegmenter:
+ * the encoded audio goes to fixed-length segments in <outputBase>.parts,
+ * each fsync'd when it closes and announced by segmentFinished(), ready
+ * to be copied or uploaded while the recording goes on.
+ *
+ * stop() joins the segments into <outputBase>.<ext> on the worker, without
+ * re-encoding, and emits finished(). If XFB dies mid-program the closed
+ * segments survive; the next start() joins them into
+ * <outputBase>-recovered-<date>.<ext> first and emits recovered().
+ *
+ * When the chosen encoder is unavailable the recorder falls back to WAV.
+ * stats() is thread-safe.
+ *
+ * @example
+ * @code
+ * ProgramRecorder* recorder = new ProgramRecorder(factory, this);
+ * connect(recorder, &ProgramRecorder::finished, this, &Player::programRecorded);
+ * recorder->start(QMediaDevices::defaultAudioInput(), settings, savePath + "/XFB");
+ * @endcode
+ *
+ * @since XFB 2.0
+ */
+class ProgramRecorder : public QObject
+{
+    Q_OBJECT
+
+public:
+    struct Stats {
+        qint64 recordedMs = 0;        // audio on disk or in the encoder, pauses excluded
+        qint64 bytesWritten = 0;
+        quint64 droppedFrames = 0;    // capture ring overruns
+        int segments = 0;             // closed so far
+    };
+
+    using EncoderFactory = RecordingSegmenter::EncoderFactory;
+
+    explicit ProgramRecorder(EncoderFactory encoderFactory, QObject* parent = nullptr);
+    ~ProgramRecorder() override;
+
+    /**
+     * @brief Start capturing from device
+     *
+     * settings.sampleRate and channels are what is asked of the device; the
+     * recording uses what it accepts. directory and baseName are set from
+     * outputBase.
+     */
+    bool start(const QAudioDevice& device, const RecordingSegmenter::Settings& settings,
+               const QString& outputBase, QString* error = nullptr);
+
+    /**
+     * @brief Stop capturing and join the segments; finished() or errorOccurred() follows
+     */
+    void stop();
+
+    /**
+     * @brief Stop capturing and close the current segment, waiting for it
+     *
+     * For the application exit: the segments are left for the next start().
+     */
+    void shutdown();
+
+    /** Input is discarded while paused; the recording carries on seamlessly. */
+    void setPaused(bool paused);
+
+    bool isRecording() const { return m_recording; }
+    bool isPaused() const;
+
+    Stats stats() const;
+
+signals:
+    void segmentFinished(const QString& path, int index);
+    void finished(const QString& path);
+    void recovered(const QString& path);
+    void errorOccurred(const QString& error);
+
+private:
+    class CaptureDevice;
+
+    void stopCapture();
+
+    QThread m_captureThread;
+    QThread m_thread;
+    QObject* m_captureContext = nullptr;
+    QAudioSource* m_source = nullptr;      // capture thread
+    CaptureDevice* m_capture = nullptr;    // capture thread
+    std::unique_ptr<FrameRing> m_ring;
+    ProgramRecorderWorker* m_worker = nullptr;
+    bool m_recording = false;
+};
+
+/**
+ * @brief ProgramRecorder's side on its own thread
+ */
+class ProgramRecorderWorker : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit ProgramRecorderWorker(ProgramRecorder::EncoderFactory encoderFactory);
+    ~ProgramRecorderWorker() override;
+
+    bool start(FrameRing* ring, RecordingSegmenter::Settings settings, const QString& outputBase,
+               QString* error);
+    /** Close the recording; join the segments into the output file when join is set. */
+    void stop(bool join);
+    /** Close and delete the recording (the capture could not start). */
+    void discard();
+
+    ProgramRecorder::Stats stats() const;
+
+signals:
+    void segmentFinished(const QString& path, int index);
+    void finished(const QString& path);
+    void recovered(const QString& path);
+    void errorOccurred(const QString& error);
+
+private:
+    void drain();
+    void recover(const QString& partsDir, const QString& baseName, const QString& outputBase);
+    void announceSegments();
+    void updateStats();
+
+    RecordingSegmenter m_segmenter;
+    FrameRing* m_ring = nullptr;
+    QTimer* m_drainTimer = nullptr;
+    QString m_outputBase;
+    int m_announced = 0;
+
+    mutable QMutex m_statsMutex;
+    ProgramRecorder::Stats m_stats;
+};
+
+#endif // PROGRAMRECORDER_H
@@ -0,0 +1,118 @@
+#include "QueryProfiler.h"
+#include <QAtomicInt>
+#include <QElapsedTimer>
+#include <QReadWriteLock>
+#include <QRegularExpression>
+#include <QSqlDriver>
+#include <QSqlResult>
+#include <QStringList>
+
+namespace {
+
+struct Recorders {
+    QReadWriteLock lock;
+    QAtomicInt attached;
+    QObject* owner = nullptr;
+    QueryProfiler::Recorder recorder;
+    QueryProfiler::PlanRecorder planRecorder;
+};
+
+Recorders& recorders()
+{
+    static Recorders instance;
+    return instance;
+}
+
+} // namespace
+
+bool QueryProfiler::exec(QSqlQuery& query)
+{
+    if (!isAttached())
+        return query.exec();
+
+    QElapsedTimer timer;
+    timer.start();
+    const bool success = query.exec();
+    const qint64 microseconds = timer.nsecsElapsed() / 1000;
+    if (success)
+        record(query, query.lastQuery(), microseconds);
+    return success;
+}
+
+bool QueryProfiler::exec(QSqlQuery& query, const QString& sql)
+{
+    if (!isAttached())
+        return query.exec(sql);
+
+    QElapsedTimer timer;
+    timer.start();
+    const bool success = query.exec(sql);
+    const qint64 microseconds = timer.nsecsElapsed() / 1000;
+    if (success)
+        record(query, sql, microseconds);
+    return success;
+}
+
+void QueryProfiler::attach(QObject* owner, Recorder recorder, PlanRecorder planRecorder)
+{
+    Recorders& state = recorders();
+    QWriteLocker locker(&state.lock);
+    state.owner = owner;
+    state.recorder = std::move(recorder);
+    state.planRecorder = std::move(planRecorder);
+    state.attached.storeRelease(state.recorder ? 1 : 0);
+}
+
+void QueryProfiler::detach(QObject* owner)
+{
+    Recorders& state = recorders();
+    QWriteLocker locker(&state.lock);
+    if (state.owner != owner)
+        return;
+    state.attached.storeRelease(0);
+    state.owner = nullptr;
+    state.recorder = nullptr;
+    state.planRecorder = nullptr;
+}
+
+bool QueryProfiler::isAttached()
+{
+    return recorders().attached.loadAcquire() != 0;
+}
+
+void QueryProfiler::record(const QSqlQuery& query, const QString& sql, qint64 microseconds)
+{
+    Recorders& state = recorders();
+    QReadLocker locker(&state.lock);
+    if (!state.recorder || !state.recorder(sql, microseconds) || !state.planRecorder)
+        return;
+
+    const QString plan = explain(query, sql);
+    if (!plan.isEmpty())
+        state.planRecorder(sql, plan);
+}
+
+QString QueryProfiler::explain(const QSqlQuery& query, const QString& sql)
+{
+    // Only statements that read a table have a plan worth an index
+    static const QRegularExpression explainable(QStringLiteral("^\\s*(SELECT|WITH|UPDATE|DELETE)\\b"),
+                                                QRegularExpression::CaseInsensitiveOption);
+    if (!query.driver() || !explainable.match(sql).hasMatch())
+        return QString();
+
+    // A second statement on the query's own connection: the connection
+    // belongs to the calling thread, and the query keeps its position
+    QSqlQuery plan(query.driver()->createResult());
+    if (!plan.prepare(QStringLiteral("EXPLAIN QUERY PLAN ") + sql))
+        return QString();
+    const QVariantList values = query.boundValues();
+    for (int i = 0; i < values.size(); ++i)
+        plan.bindValue(i, values.at(i));
+    if (!plan.exec())
+        return QString();
+
+    QStringList steps;
+    while (plan.next())
+        steps << plan.value(3).toString();
+    return steps.join(QLatin1Char('\n'));
+}
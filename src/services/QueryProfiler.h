@@ -0,0 +1,89 @@
+#ifndef QUERYPROFILER_H
+#define QUERYPROFILER_H
+
+#include <QString>
+#include <QSqlQuery>
+#include <functional>
+
+class QObject;
+
+/**
+ * @brief Times SQL statements for whoever is listening
+ *
+ * DatabaseService, the repositories and MusicListModel run their
+ * statements through exec() instead of QSqlQuery::exec(). With nothing
+ * attached that is a plain exec(). While a recorder is attached (see
+ * DatabaseOptimizer::startQueryMonitoring()) each statement is timed and
+ * reported with its SQL; when the recorder asks for it, the statement's
+ * EXPLAIN QUERY PLAN is captured on the same connection, with the same
+ * bound values, and reported too.
+ *
+ * exec() is thread-safe: statements on worker connections are recorded
+ * like those on the GUI thread. For SQLite the timing covers preparing
+ * the statement and stepping to the first row, which is where a missing
+ * index costs a lookup its table scan.
+ *
+ * @example
+ * @code
+ * QSqlQuery query(database);
+ * query.prepare("SELECT * FROM musics WHERE path = ?");
+ * query.addBindValue(path);
+ * if (!QueryProfiler::exec(query)) { ... }
+ * @endcode
+ *
+ * @since XFB 2.0
+ */
+class QueryProfiler
+{
+public:
+    /**
+     * @brief Called after each statement
+     * @return true to have the statement's query plan captured
+     */
+    using Recorder = std::function<bool(const QString& sql, qint64 microseconds)>;
+
+    /**
+     * @brief Called with the query plan of a statement, one step per line
+     */
+    using PlanRecorder = std::function<void(const QString& sql, const QString& plan)>;
+
+    /**
+     * @brief Execute a prepared statement
+     * @param query Prepared query with its values bound
+     * @return Result of QSqlQuery::exec()
+     */
+    static bool exec(QSqlQuery& query);
+
+    /**
+     * @brief Execute a statement directly
+     * @param query Query to run it on
+     * @param sql Statement
+     * @return Result of QSqlQuery::exec(sql)
+     */
+    static bool exec(QSqlQuery& query, const QString& sql);
+
+    /**
+     * @brief Attach the recorder; replaces any other
+     * @param owner Owner of the recorders, for detach()
+     */
+    static void attach(QObject* owner, Recorder recorder, PlanRecorder planRecorder);
+
+    /**
+     * @brief Detach the owner's recorders
+     *
+     * Waits for calls in progress, so the owner may be destroyed
+     * afterwards. Does nothing if another owner has attached since.
+     */
+    static void detach(QObject* owner);
+
+    /**
+     * @brief Check if a recorder is attached
+     */
+    static bool isAttached();
+
+private:
+    static void record(const QSqlQuery& query, const QString& sql, qint64 microseconds);
+    static QString explain(const QSqlQuery& query, const QString& sql);
+};
+
+#endif // QUERYPROFILER_H
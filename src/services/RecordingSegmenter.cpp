@@ -0,0 +1,573 @@
+#include "RecordingSegmenter.h"
+#include "FileSync.h"
+#include <QCoreApplication>
+#include <QDebug>
+#include <QDir>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QtEndian>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace {
+
+constexpr int kWavHeaderSize = 44;
+constexpr qint64 kCopyChunk = 1 << 20;
+
+QString translate(const char* text)
+{
+    return QCoreApplication::translate("RecordingSegmenter", text);
+}
+
+QByteArray wavHeader(int sampleRate, int channels, quint32 dataBytes)
+{
+    QByteArray h(kWavHeaderSize, '\0');
+    char* p = h.data();
+    const quint16 blockAlign = static_cast<quint16>(channels * 2);
+    memcpy(p, "RIFF", 4);
+    qToLittleEndian<quint32>(dataBytes > 0xFFFFFFFFu - 36 ? 0xFFFFFFFFu : dataBytes + 36, p + 4);
+    memcpy(p + 8, "WAVEfmt ", 8);
+    qToLittleEndian<quint32>(16, p + 16);
+    qToLittleEndian<quint16>(1, p + 20);                 // PCM
+    qToLittleEndian<quint16>(static_cast<quint16>(channels), p + 22);
+    qToLittleEndian<quint32>(static_cast<quint32>(sampleRate), p + 24);
+    qToLittleEndian<quint32>(static_cast<quint32>(sampleRate) * blockAlign, p + 28);
+    qToLittleEndian<quint16>(blockAlign, p + 32);
+    qToLittleEndian<quint16>(16, p + 34);
+    memcpy(p + 36, "data", 4);
+    qToLittleEndian<quint32>(dataBytes, p + 40);
+    return h;
+}
+
+// --- frame and page headers of the encoded formats ------------------------
+
+/** MPEG audio Layer III frame at p: its length, 0 if more bytes are needed, -1 if none. */
+qsizetype mp3FrameLength(const uchar* p, qsizetype avail)
+{
+    if (avail < 4)
+        return avail > 0 && p[0] != 0xFF ? -1 : 0;
+    if (p[0] != 0xFF || (p[1] & 0xE0) != 0xE0)
+        return -1;
+    const int version = (p[1] >> 3) & 3;    // 0: 2.5, 2: 2, 3: 1
+    const int layer = (p[1] >> 1) & 3;      // 1: Layer III
+    const int bitrateIndex = p[2] >> 4;
+    const int rateIndex = (p[2] >> 2) & 3;
+    if (version == 1 || layer != 1 || bitrateIndex == 0 || bitrateIndex == 15 || rateIndex == 3)
+        return -1;
+    static const int kBitratesV1[] = {0, 32, 40, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320};
+    static const int kBitratesV2[] = {0, 8, 16, 24, 32, 40, 48, 56, 64, 80, 96, 112, 128, 144, 160};
+    static const int kRates[] = {44100, 48000, 32000};
+    const int padding = (p[2] >> 1) & 1;
+    int rate = kRates[rateIndex];
+    if (version == 3)
+        return 144000 * kBitratesV1[bitrateIndex] / rate + padding;
+    rate /= version == 2 ? 2 : 4;
+    return 72000 * kBitratesV2[bitrateIndex] / rate + padding;
+}
+
+/** ADTS frame at p, same contract as mp3FrameLength(). */
+qsizetype adtsFrameLength(const uchar* p, qsizetype avail)
+{
+    if (avail < 7)
+        return avail > 0 && p[0] != 0xFF ? -1 : 0;
+    if (p[0] != 0xFF || (p[1] & 0xF6) != 0xF0)
+        return -1;
+    const qsizetype length = ((p[3] & 0x03) << 11) | (p[4] << 3) | (p[5] >> 5);
+    return length >= 7 ? length : -1;
+}
+
+/** Ogg page at p, same contract as mp3FrameLength(). */
+qsizetype oggPageLength(const uchar* p, qsizetype avail)
+{
+    static const char kCapture[] = "OggS";
+    for (qsizetype i = 0; i < std::min<qsizetype>(avail, 4); ++i) {
+        if (p[i] != uchar(kCapture[i]))
+            return -1;
+    }
+    if (avail < 27)
+        return 0;
+    const int segments = p[26];
+    if (avail < 27 + segments)
+        return 0;
+    qsizetype length = 27 + segments;
+    for (int i = 0; i < segments; ++i)
+        length += p[27 + i];
+    return length;
+}
+
+qint64 oggGranule(const uchar* page)
+{
+    return qFromLittleEndian<qint64>(page + 6);
+}
+
+/** Where the samples of a WAV file start, and its bytes per frame. */
+bool wavLayout(QFile& file, qint64* dataOffset, int* blockAlign)
+{
+    if (!file.seek(0))
+        return false;
+    const QByteArray riff = file.read(12);
+    if (riff.size() < 12 || !riff.startsWith("RIFF") || riff.mid(8, 4) != "WAVE")
+        return false;
+    *blockAlign = 1;
+    qint64 pos = 12;
+    while (file.seek(pos)) {
+        const QByteArray chunk = file.read(8);
+        if (chunk.size() < 8)
+            return false;
+        const quint32 size = qFromLittleEndian<quint32>(chunk.constData() + 4);
+        if (chunk.startsWith("fmt ")) {
+            const QByteArray fmt = file.read(16);
+            if (fmt.size() >= 14)
+                *blockAlign = std::max<int>(1, qFromLittleEndian<quint16>(fmt.constData() + 12));
+        } else if (chunk.startsWith("data")) {
+            *dataOffset = pos + 8;
+            return true;
+        }
+        pos += 8 + size + (size & 1);
+    }
+    return false;
+}
+
+bool copyRange(QFile& in, qint64 from, qint64 to, QFileDevice& out)
+{
+    if (!in.seek(from))
+        return false;
+    QByteArray buffer;
+    for (qint64 pos = from; pos < to;) {
+        buffer = in.read(std::min(kCopyChunk, to - pos));
+        if (buffer.isEmpty() || out.write(buffer) != buffer.size())
+            return false;
+        pos += buffer.size();
+    }
+    return true;
+}
+
+} // namespace
+
+// ---------------------------------------------------------------- Framer
+
+/**
+ * Splits the encoded byte stream into whole frames (MP3, ADTS) or pages
+ * (Ogg), the places a segment may start. Bytes that parse as neither are
+ * passed on as they are, never dropped.
+ */
+class RecordingSegmenter::Framer
+{
+public:
+    explicit Framer(Format format) : m_format(format) {}
+
+    void feed(const QByteArray& bytes) { m_buffer += bytes; }
+
+    /**
+     * Length of the next complete unit at data(), 0 when none is complete
+     * yet. cuttable: a segment may start with it. header: an Ogg header page.
+     */
+    qsizetype next(bool* cuttable, bool* header)
+    {
+        const uchar* p = reinterpret_cast<const uchar*>(m_buffer.constData()) + m_pos;
+        const qsizetype avail = m_buffer.size() - m_pos;
+        *cuttable = false;
+        *header = false;
+        if (avail == 0)
+            return 0;
+        const qsizetype length = unitLength(p, avail);
+        if (length > 0) {
+            if (length > avail)
+                return 0;
+            if (m_format == Format::Opus) {
+                const qint64 granule = oggGranule(p);
+                *header = granule == 0;
+                *cuttable = granule != 0 && !(p[5] & 0x01);
+            } else {
+                *cuttable = true;
+            }
+            return length;
+        }
+        if (length == 0)
+            return 0;
+        // Out of sync: pass everything up to the next possible start
+        const uchar sync = m_format == Format::Opus ? 'O' : 0xFF;
+        const void* hit = memchr(p + 1, sync, static_cast<size_t>(avail - 1));
+        return hit ? static_cast<const uchar*>(hit) - p : avail;
+    }
+
+    const char* data() const { return m_buffer.constData() + m_pos; }
+
+    void consume(qsizetype bytes)
+    {
+        m_pos += bytes;
+        if (m_pos == m_buffer.size()) {
+            m_buffer.clear();
+            m_pos = 0;
+        } else if (m_pos > 64 * 1024) {
+            m_buffer.remove(0, m_pos);
+            m_pos = 0;
+        }
+    }
+
+    /** Whatever is left at the end of the stream. */
+    QByteArray takeRest()
+    {
+        QByteArray rest = m_buffer.mid(m_pos);
+        m_buffer.clear();
+        m_pos = 0;
+        return rest;
+    }
+
+private:
+    qsizetype unitLength(const uchar* p, qsizetype avail) const
+    {
+        switch (m_format) {
+        case Format::Mp3: return mp3FrameLength(p, avail);
+        case Format::Aac: return adtsFrameLength(p, avail);
+        case Format::Opus: return oggPageLength(p, avail);
+        case Format::Wav: break;
+        }
+        return -1;
+    }
+
+    Format m_format;
+    QByteArray m_buffer;
+    qsizetype m_pos = 0;
+};
+
+// ---------------------------------------------------------- RecordingSegmenter
+
+RecordingSegmenter::RecordingSegmenter(EncoderFactory encoderFactory)
+    : m_encoderFactory(std::move(encoderFactory))
+{
+}
+
+RecordingSegmenter::~RecordingSegmenter()
+{
+    if (m_open)
+        close();
+}
+
+QString RecordingSegmenter::extension(Format format)
+{
+    switch (format) {
+    case Format::Opus: return QStringLiteral("ogg");
+    case Format::Mp3: return QStringLiteral("mp3");
+    case Format::Aac: return QStringLiteral("aac");
+    case Format::Wav: break;
+    }
+    return QStringLiteral("wav");
+}
+
+bool RecordingSegmenter::open(const Settings& settings, QString* error)
+{
+    if (m_open)
+        close();
+    m_settings = settings;
+    m_settings.channels = std::max(1, settings.channels);
+    m_settings.segmentSeconds = std::max(1, settings.segmentSeconds);
+    m_encoder.reset();
+    m_framer.reset();
+    m_segmentIndex = 0;
+    m_segmentFrames = 0;
+    m_cutPending = false;
+    m_headerUnits.clear();
+    m_segments.clear();
+    m_closedSinceTake.clear();
+    m_framesWritten = 0;
+    m_bytesWritten = 0;
+    m_failed = false;
+    m_error.clear();
+
+    if (!QDir().mkpath(m_settings.directory)) {
+        if (error)
+            *error = translate("Cannot create %1").arg(m_settings.directory);
+        return false;
+    }
+
+    if (m_settings.format != Format::Wav) {
+        FxEncoder::Settings enc;
+        enc.codec = m_settings.format == Format::Opus ? FxEncoder::Codec::Opus
+                    : m_settings.format == Format::Aac ? FxEncoder::Codec::Aac
+                                                        : FxEncoder::Codec::Mp3;
+        enc.bitrateKbps = m_settings.bitrateKbps;
+        enc.sampleRate = m_settings.sampleRate;
+        enc.channels = m_settings.channels;
+        QString encoderError;
+        m_encoder = m_encoderFactory ? m_encoderFactory(enc, &encoderError) : nullptr;
+        if (!m_encoder) {
+            if (error)
+                *error = translate("Cannot start the %1 encoder: %2")
+                             .arg(FxEncoder::codecName(enc.codec), encoderError);
+            return false;
+        }
+        m_framer = std::make_unique<Framer>(m_settings.format);
+    }
+
+    if (!openSegment()) {
+        if (error)
+            *error = m_error;
+        m_encoder.reset();
+        return false;
+    }
+    m_open = true;
+    return true;
+}
+
+size_t RecordingSegmenter::write(const float* interleaved, size_t frames)
+{
+    if (!m_open || m_failed)
+        return 0;
+
+    size_t accepted = frames;
+    if (m_settings.format == Format::Wav) {
+        writePcm(interleaved, frames);
+    } else {
+        if (frames > 0)
+            accepted = m_encoder->write(interleaved, frames);
+        // The cut lands on the next frame the encoder puts out after this
+        m_segmentFrames += static_cast<qint64>(accepted);
+        const qint64 segmentFrames = qint64(m_settings.sampleRate) * m_settings.segmentSeconds;
+        if (m_segmentFrames >= segmentFrames) {
+            m_segmentFrames -= segmentFrames;
+            m_cutPending = true;
+        }
+        m_encoded.clear();
+        m_encoder->takeEncoded(m_encoded);
+        writeEncoded(m_encoded);
+        if (!m_failed && m_encoder->failed())
+            fail(translate("Encoder stopped: %1").arg(m_encoder->errorString()));
+    }
+    m_framesWritten += static_cast<qint64>(accepted);
+
+    // In the OS cache at least: a crash of XFB itself loses nothing
+    if (!m_failed && !m_file.flush())
+        fail(translate("Cannot write %1: %2").arg(m_file.fileName(), m_file.errorString()));
+    return accepted;
+}
+
+bool RecordingSegmenter::close(QString* error)
+{
+    if (!m_open)
+        return !m_failed;
+    m_open = false;
+
+    if (m_encoder && !m_failed) {
+        m_encoder->finish();
+        m_encoded.clear();
+        m_encoder->takeEncoded(m_encoded);
+        writeEncoded(m_encoded);
+        const QByteArray rest = m_framer->takeRest();
+        if (!rest.isEmpty())
+            writeUnit(rest.constData(), rest.size());
+        if (!m_failed && m_encoder->failed())
+            fail(translate("Encoder stopped: %1").arg(m_encoder->errorString()));
+    }
+    m_encoder.reset();
+    m_framer.reset();
+    if (m_file.isOpen() && !closeSegment() && !m_failed)
+        fail(translate("Cannot write %1: %2").arg(m_file.fileName(), m_file.errorString()));
+
+    if (m_failed && error)
+        *error = m_error;
+    return !m_failed;
+}
+
+QStringList RecordingSegmenter::takeClosedSegments()
+{
+    QStringList closed;
+    closed.swap(m_closedSinceTake);
+    return closed;
+}
+
+bool RecordingSegmenter::openSegment()
+{
+    ++m_segmentIndex;
+    const QString name = QString("%1-%2.%3").arg(m_settings.baseName)
+                             .arg(m_segmentIndex, 4, 10, QLatin1Char('0'))
+                             .arg(extension(m_settings.format));
+    m_file.setFileName(QDir(m_settings.directory).filePath(name));
+    if (!m_file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        fail(translate("Cannot create %1: %2").arg(m_file.fileName(), m_file.errorString()));
+        return false;
+    }
+    FileSync::syncDirectory(m_settings.directory);
+
+    m_segmentDataBytes = 0;
+    if (m_settings.format == Format::Wav) {
+        // Sizes are filled in when the segment closes
+        m_file.write(wavHeader(m_settings.sampleRate, m_settings.channels, 0));
+    } else if (!m_headerUnits.isEmpty()) {
+        // Ogg: each segment plays on its own, from the stream's header pages
+        m_file.write(m_headerUnits);
+    }
+    return true;
+}
+
+bool RecordingSegmenter::closeSegment()
+{
+    bool ok = true;
+    if (m_settings.format == Format::Wav) {
+        const quint32 dataBytes = static_cast<quint32>(std::min<qint64>(m_segmentDataBytes, 0xFFFFFFFFLL - 36));
+        ok = m_file.seek(0) && m_file.write(wavHeader(m_settings.sampleRate, m_settings.channels, dataBytes))
+                                   == kWavHeaderSize;
+    }
+    ok = FileSync::syncToDisk(m_file) && ok;
+    m_file.close();
+    m_segments << m_file.fileName();
+    m_closedSinceTake << m_file.fileName();
+    return ok;
+}
+
+void RecordingSegmenter::writeEncoded(const QByteArray& bytes)
+{
+    if (bytes.isEmpty())
+        return;
+    m_framer->feed(bytes);
+    bool cuttable = false;
+    bool header = false;
+    qsizetype length;
+    while (!m_failed && (length = m_framer->next(&cuttable, &header)) > 0) {
+        if (header && m_segmentIndex == 1) {
+            m_headerUnits.append(m_framer->data(), length);
+        } else if (m_cutPending && cuttable) {
+            m_cutPending = false;
+            if (!closeSegment()) {
+                fail(translate("Cannot write %1: %2").arg(m_file.fileName(), m_file.errorString()));
+                break;
+            }
+            if (!openSegment())
+                break;
+        }
+        writeUnit(m_framer->data(), length);
+        m_framer->consume(length);
+    }
+}
+
+void RecordingSegmenter::writeUnit(const char* data, qsizetype size)
+{
+    if (m_file.write(data, size) != size) {
+        fail(translate("Cannot write %1: %2").arg(m_file.fileName(), m_file.errorString()));
+        return;
+    }
+    m_bytesWritten += size;
+}
+
+void RecordingSegmenter::writePcm(const float* interleaved, size_t frames)
+{
+    const size_t channels = static_cast<size_t>(m_settings.channels);
+    const qint64 segmentFrames = qint64(m_settings.sampleRate) * m_settings.segmentSeconds;
+    while (frames > 0 && !m_failed) {
+        const size_t n = static_cast<size_t>(std::min<qint64>(qint64(frames), segmentFrames - m_segmentFrames));
+        m_pcm.resize(n * channels);
+        for (size_t i = 0; i < n * channels; ++i) {
+            const float v = std::clamp(interleaved[i], -1.0f, 1.0f);
+            m_pcm[i] = static_cast<qint16>(std::lround(v * 32767.0f));
+        }
+        writeUnit(reinterpret_cast<const char*>(m_pcm.data()), static_cast<qsizetype>(m_pcm.size() * sizeof(qint16)));
+        m_segmentDataBytes += static_cast<qint64>(m_pcm.size() * sizeof(qint16));
+        m_segmentFrames += static_cast<qint64>(n);
+        interleaved += n * channels;
+        frames -= n;
+
+        if (m_segmentFrames >= segmentFrames) {
+            m_segmentFrames = 0;
+            if (!closeSegment()) {
+                fail(translate("Cannot write %1: %2").arg(m_file.fileName(), m_file.errorString()));
+                return;
+            }
+            openSegment();
+        }
+    }
+}
+
+void RecordingSegmenter::fail(const QString& error)
+{
+    if (m_failed)
+        return;
+    m_failed = true;
+    m_error = error;
+    qWarning() << "RecordingSegmenter:" << error;
+}
+
+QStringList RecordingSegmenter::findSegments(const QString& directory, const QString& baseName)
+{
+    QDir dir(directory);
+    QStringList names = dir.entryList({baseName + "-????.*"}, QDir::Files, QDir::Name);
+    QStringList paths;
+    for (const QString& name : std::as_const(names))
+        paths << dir.filePath(name);
+    return paths;
+}
+
+bool RecordingSegmenter::concatenate(const QStringList& segments, const QString& outputPath, QString* error)
+{
+    const auto bail = [error](const QString& message) {
+        if (error)
+            *error = message;
+        return false;
+    };
+    if (segments.isEmpty())
+        return bail(translate("Nothing was recorded"));
+
+    const QString suffix = QFileInfo(outputPath).suffix().toLower();
+    const bool wav = suffix == QLatin1String("wav");
+    const bool ogg = suffix == QLatin1String("ogg") || suffix == QLatin1String("opus");
+
+    QSaveFile out(outputPath);
+    if (!out.open(QIODevice::WriteOnly))
+        return bail(translate("Cannot create %1: %2").arg(outputPath, out.errorString()));
+
+    qint64 wavDataBytes = 0;
+    for (int i = 0; i < segments.size(); ++i) {
+        QFile in(segments.at(i));
+        if (!in.open(QIODevice::ReadOnly))
+            return bail(translate("Cannot read %1: %2").arg(in.fileName(), in.errorString()));
+        qint64 from = 0;
+        qint64 to = in.size();
+
+        if (wav) {
+            int blockAlign = 1;
+            if (!wavLayout(in, &from, &blockAlign))
+                return bail(translate("%1 is not a WAV file").arg(in.fileName()));
+            // A segment cut short keeps its whole frames; its header may still say 0
+            to = from + (to - from) / blockAlign * blockAlign;
+            if (i == 0 && !copyRange(in, 0, from, out))
+                return bail(translate("Cannot write %1: %2").arg(outputPath, out.errorString()));
+            wavDataBytes += to - from;
+        } else if (ogg && i > 0) {
+            // Leave out the copy of the header pages this segment starts with
+            while (from + 27 <= to) {
+                in.seek(from);
+                const QByteArray head = in.read(27 + 255);
+                const uchar* p = reinterpret_cast<const uchar*>(head.constData());
+                const qsizetype length = oggPageLength(p, head.size());
+                if (length <= 0 || oggGranule(p) != 0)
+                    break;
+                from += length;
+            }
+        }
+        if (!copyRange(in, from, to, out))
+            return bail(translate("Cannot write %1: %2").arg(outputPath, out.errorString()));
+    }
+
+    if (wav) {
+        // The first segment's header, with the sizes of the whole recording
+        out.seek(0);
+        QFile first(segments.first());
+        qint64 dataOffset = kWavHeaderSize;
+        int blockAlign = 1;
+        if (first.open(QIODevice::ReadOnly))
+            wavLayout(first, &dataOffset, &blockAlign);
+        const quint32 dataBytes = static_cast<quint32>(std::min<qint64>(wavDataBytes, 0xFFFFFFFFLL));
+        const quint32 riffBytes = static_cast<quint32>(std::min<qint64>(wavDataBytes + dataOffset - 8, 0xFFFFFFFFLL));
+        char le[4];
+        qToLittleEndian<quint32>(riffBytes, le);
+        out.seek(4);
+        out.write(le, 4);
+        qToLittleEndian<quint32>(dataBytes, le);
+        out.seek(dataOffset - 4);
+        out.write(le, 4);
+    }
+
+    if (!FileSync::syncToDisk(out) || !out.commit())
+        return bail(translate("Cannot write %1: %2").arg(outputPath, out.errorString()));
+    return true;
+}
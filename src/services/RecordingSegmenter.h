@@ -0,0 +1,136 @@
+#ifndef RECORDINGSEGMENTER_H
+#define RECORDINGSEGMENTER_H
+
+#include <QByteArray>
+#include <QFile>
+#include <QString>
+#include <QStringList>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "../audio/FxEncoder.h"
+
+/**
+ * @brief Writes a recording as a series of fixed-length files
+ *
+ * Takes interleaved float PCM, encodes it (FxEncoder, or 16-bit PCM for
+ * WAV) and writes the result into segments of about segmentSeconds each:
+ * <baseName>-0001.<ext>, <baseName>-0002.<ext>, ... in the directory. A
+ * segment is flushed to the OS on every write() and fsync'd when it is
+ * closed, so a crash loses at most the segment being written, and a
+ * closed segment can be copied or uploaded while the recording goes on.
+ *
+ * One encoder runs for the whole recording; the segments are cut between
+ * its frames (MP3, ADTS) or pages (Ogg), so concatenate() rebuilds the
+ * encoded stream byte for byte, with no gap or re-encode at the seams.
+ * Ogg segments after the first start with a copy of the header pages so
+ * each plays on its own; concatenate() leaves those out again. WAV
+ * segments are cut at exact frame counts and get one header between them.
+ *
+ * Not thread-safe: owned by one thread.
+ *
+ * @since XFB 2.0
+ */
+class RecordingSegmenter
+{
+public:
+    enum class Format { Wav, Opus, Mp3, Aac };
+
+    using EncoderFactory = std::function<std::unique_ptr<FxEncoder>(const FxEncoder::Settings&, QString*)>;
+
+    struct Settings {
+        QString directory;
+        QString baseName = QStringLiteral("recording");
+        Format format = Format::Wav;
+        int bitrateKbps = 192;
+        int sampleRate = 48000;
+        int channels = 2;
+        int segmentSeconds = 300;
+    };
+
+    explicit RecordingSegmenter(EncoderFactory encoderFactory);
+    ~RecordingSegmenter();
+
+    RecordingSegmenter(const RecordingSegmenter&) = delete;
+    RecordingSegmenter& operator=(const RecordingSegmenter&) = delete;
+
+    /**
+     * @brief Start a recording; false with error set when the encoder or the
+     * first segment cannot be opened
+     */
+    bool open(const Settings& settings, QString* error = nullptr);
+
+    /**
+     * @brief Record frames; returns the frames taken, fewer when the encoder
+     * is behind (offer the rest again later). write(nullptr, 0) only
+     * collects encoded output.
+     */
+    size_t write(const float* interleaved, size_t frames);
+
+    /**
+     * @brief Flush the encoder and close the last segment; the recording is
+     * complete on disk when this returns true
+     */
+    bool close(QString* error = nullptr);
+
+    bool isOpen() const { return m_open; }
+    bool failed() const { return m_failed; }
+    QString errorString() const { return m_error; }
+
+    const Settings& settings() const { return m_settings; }
+    qint64 framesWritten() const { return m_framesWritten; }
+    qint64 bytesWritten() const { return m_bytesWritten; }
+
+    /** Every closed segment so far, oldest first. */
+    QStringList segments() const { return m_segments; }
+    /** Segments closed since the previous call. */
+    QStringList takeClosedSegments();
+
+    static QString extension(Format format);
+
+    /** Segment files of baseName in directory, in recording order. */
+    static QStringList findSegments(const QString& directory, const QString& baseName);
+
+    /**
+     * @brief Join segments into one playable file without re-encoding
+     *
+     * The format follows the extension. Tolerates a last segment cut short
+     * by a crash (a WAV header that was never updated, a torn last frame).
+     */
+    static bool concatenate(const QStringList& segments, const QString& outputPath, QString* error = nullptr);
+
+private:
+    class Framer;
+
+    bool openSegment();
+    bool closeSegment();
+    void writeEncoded(const QByteArray& bytes);
+    void writeUnit(const char* data, qsizetype size);
+    void writePcm(const float* interleaved, size_t frames);
+    void fail(const QString& error);
+
+    EncoderFactory m_encoderFactory;
+    Settings m_settings;
+    std::unique_ptr<FxEncoder> m_encoder;
+    std::unique_ptr<Framer> m_framer;
+
+    QFile m_file;
+    int m_segmentIndex = 0;
+    qint64 m_segmentFrames = 0;       // input frames since the segment began
+    qint64 m_segmentDataBytes = 0;    // WAV: PCM bytes in the open segment
+    bool m_cutPending = false;
+    QByteArray m_headerUnits;         // Ogg: the stream's header pages
+    QByteArray m_encoded;
+    std::vector<qint16> m_pcm;
+
+    QStringList m_segments;
+    QStringList m_closedSinceTake;
+    qint64 m_framesWritten = 0;
+    qint64 m_bytesWritten = 0;
+    bool m_open = false;
+    bool m_failed = false;
+    QString m_error;
+};
+
+#endif // RECORDINGSEGMENTER_H
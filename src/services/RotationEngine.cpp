@@ -0,0 +1,384 @@
+#include "RotationEngine.h"
+#include "DatabaseAccess.h"
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QRandomGenerator>
+#include <QSqlError>
+#include <QSqlQuery>
+#include <QDebug>
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+namespace {
+
+// "h:mm:ss" as imports store it, or "mm:ss"; 0 if unknown
+int parseSeconds(const QString& text)
+{
+    int seconds = 0;
+    const QStringList parts = text.trimmed().split(':');
+    for (const QString& part : parts) {
+        bool ok = false;
+        const int value = part.toInt(&ok);
+        if (!ok)
+            return 0;
+        seconds = seconds * 60 + value;
+    }
+    return qMax(0, seconds);
+}
+
+// Separation key of a title: the same song filed twice counts once
+QString titleKey(const RotationEngine::Track& track)
+{
+    return track.artist.trimmed().toLower() + QLatin1Char('\n') + track.title.trimmed().toLower();
+}
+
+} // namespace
+
+RotationEngine::RotationEngine(const QSqlDatabase& database, QObject* parent)
+    : QObject(parent)
+    , m_databaseName(database.databaseName())
+    , m_driver(database.driverName())
+    , m_connectionName(QString("RotationEngine_%1").arg(quintptr(this), 0, 16))
+{
+    m_loadPool.setMaxThreadCount(1);
+    m_refillPool.setMaxThreadCount(1);
+}
+
+RotationEngine::~RotationEngine()
+{
+    m_loadPool.waitForDone();
+    m_refillPool.waitForDone();
+}
+
+void RotationEngine::setOptions(const Options& options)
+{
+    m_options = options;
+    m_options.artistSeparation = qMax(0, options.artistSeparation);
+    m_options.titleSeparation = qMax(0, options.titleSeparation);
+    m_options.lookAhead = qMax(1, options.lookAhead);
+    m_options.refillBelow = qMax(1, options.refillBelow);
+    m_options.averageSeconds = qMax(1, options.averageSeconds);
+}
+
+void RotationEngine::reload()
+{
+    if (m_loading) {
+        m_reloadPending = true;
+        return;
+    }
+
+    m_loading = true;
+    const int run = ++m_run;
+    const QHash<QString, qint64> played = m_played;
+    const quint32 seed = nextSeed();
+    m_loadPool.start([this, run, played, seed]() { load(run, played, seed); });
+}
+
+bool RotationEngine::waitForReady(int timeoutMs)
+{
+    QElapsedTimer clock;
+    clock.start();
+    while (m_loading) {
+        const int remaining = timeoutMs < 0 ? -1 : int(qMax<qint64>(0, timeoutMs - clock.elapsed()));
+        if (!m_loadPool.waitForDone(remaining))
+            return false;
+        QCoreApplication::sendPostedEvents(this, QEvent::MetaCall);
+    }
+    return isReady();
+}
+
+QString RotationEngine::genreAt(const QDateTime& at) const
+{
+    return m_library ? m_library->genreNames.value(keyAt(at)) : QString();
+}
+
+QStringList RotationEngine::next(int count, const QDateTime& at)
+{
+    QStringList paths;
+    const QString key = keyAt(at);
+    for (int i = 0; i < count; ++i) {
+        const int index = pick(key);
+        if (index < 0)
+            break;
+        paths << m_library->tracks.at(index).path;
+    }
+    return paths;
+}
+
+QStringList RotationEngine::plan(const QDateTime& from, int seconds)
+{
+    QStringList paths;
+    qint64 planned = 0;
+    while (planned < seconds) {
+        const int index = pick(keyAt(from.addSecs(planned)));
+        if (index < 0)
+            break;
+        const Track& track = m_library->tracks.at(index);
+        paths << track.path;
+        planned += track.seconds > 0 ? track.seconds : m_options.averageSeconds;
+    }
+    return paths;
+}
+
+int RotationEngine::secondsOf(const QString& path) const
+{
+    if (m_library) {
+        const int index = m_library->paths.value(path, -1);
+        if (index >= 0 && m_library->tracks.at(index).seconds > 0)
+            return m_library->tracks.at(index).seconds;
+    }
+    return m_options.averageSeconds;
+}
+
+void RotationEngine::notePlayed(const QString& path, const QDateTime& at)
+{
+    // By path: a VACUUM renumbers the musics rowids between two loads
+    if (m_library && m_library->paths.contains(path))
+        m_played.insert(path, at.toMSecsSinceEpoch());
+}
+
+int RotationEngine::queued(const QString& genre) const
+{
+    const auto it = m_rotations.constFind(genreKey(genre));
+    return it != m_rotations.constEnd() ? int(it->order.size()) : 0;
+}
+
+RotationEngine::Statistics RotationEngine::statistics() const
+{
+    Statistics stats = m_stats;
+    if (m_library) {
+        stats.tracks = m_library->tracks.size();
+        stats.genres = m_library->genres.size() - (m_library->genres.contains(QString()) ? 1 : 0);
+    }
+    return stats;
+}
+
+double RotationEngine::weight(int playedTimes, qint64 lastPlayedMs, qint64 nowMs)
+{
+    // Days since the last play, between a twentieth and four: a track that
+    // just aired is eighty times less likely to lead than one rested for
+    // four days. A long play count only damps it a little.
+    double rested = 4.0;
+    if (lastPlayedMs > 0)
+        rested = qBound(0.05, double(nowMs - lastPlayedMs) / kDayMs, 4.0);
+    return rested / (1.0 + std::log1p(double(qMax(0, playedTimes))) / 4.0);
+}
+
+void RotationEngine::load(int run, const QHash<QString, qint64>& played, quint32 seed)
+{
+    QElapsedTimer clock;
+    clock.start();
+
+    auto library = QSharedPointer<Library>::create();
+    QString error;
+    {
+        QSqlDatabase db = DatabaseAccess::openConnection(m_connectionName, m_driver, m_databaseName);
+        if (!db.isOpen()) {
+            error = tr("Could not open the library: %1").arg(db.lastError().text());
+        } else {
+            QSqlQuery query(db);
+            query.setForwardOnly(true);
+            if (query.exec("SELECT path, artist, song, genre1, time, played_times, last_played FROM musics")) {
+                while (query.next()) {
+                    Track track;
+                    track.path = query.value(0).toString();
+                    if (track.path.isEmpty())
+                        continue;
+                    track.artist = query.value(1).toString();
+                    track.title = query.value(2).toString();
+                    track.genre = query.value(3).toString();
+                    track.seconds = parseSeconds(query.value(4).toString());
+                    track.playedTimes = query.value(5).toInt();
+                    const QDateTime lastPlayed = QDateTime::fromString(query.value(6).toString(),
+                                                                       "yyyy-MM-dd || hh:mm:ss");
+                    track.lastPlayedMs = lastPlayed.isValid() ? lastPlayed.toMSecsSinceEpoch() : 0;
+
+                    const int index = library->tracks.size();
+                    const QString key = genreKey(track.genre);
+                    library->genres[QString()].append(index);
+                    if (!key.isEmpty()) {
+                        library->genres[key].append(index);
+                        if (!library->genreNames.contains(key))
+                            library->genreNames.insert(key, track.genre.trimmed());
+                    }
+                    library->paths.insert(track.path, index);
+                    library->tracks.append(track);
+                }
+            } else {
+                error = tr("Could not read the library: %1").arg(query.lastError().text());
+            }
+
+            // The clock is optional: without it every hour plays the library
+            if (error.isEmpty() && query.exec("SELECT day, hour, genre FROM hourgenre")) {
+                while (query.next()) {
+                    const int day = query.value(0).toInt();
+                    const int hour = query.value(1).toInt();
+                    const QString key = genreKey(query.value(2).toString());
+                    if (day >= 1 && day <= 7 && hour >= 0 && hour <= 23 && !key.isEmpty())
+                        library->clock.insert(day * 24 + hour, key);
+                }
+            }
+            query.finish();
+        }
+    }
+    DatabaseAccess::closeConnection(m_connectionName);
+
+    Shuffles shuffles;
+    if (error.isEmpty()) {
+        quint32 genreSeed = seed;
+        for (auto it = library->genres.constBegin(); it != library->genres.constEnd(); ++it)
+            shuffles.insert(it.key(), shuffle(*library, it.value(), played, genreSeed++));
+    }
+
+    const qint64 elapsedMs = clock.elapsed();
+    QSharedPointer<const Library> result = library;
+    QMetaObject::invokeMethod(this, [this, run, result, shuffles, error, elapsedMs]() {
+        loaded(run, result, shuffles, error, elapsedMs);
+    }, Qt::QueuedConnection);
+}
+
+void RotationEngine::loaded(int run, QSharedPointer<const Library> library, const Shuffles& shuffles,
+                            const QString& error, qint64 elapsedMs)
+{
+    if (run != m_run)
+        return;
+    m_loading = false;
+
+    if (!error.isEmpty()) {
+        qWarning() << "RotationEngine:" << error;
+        emit rotationError(error);
+    } else {
+        m_library = library;
+        ++m_generation;
+        m_rotations.clear();
+        for (auto it = shuffles.constBegin(); it != shuffles.constEnd(); ++it)
+            m_rotations[it.key()].order = it.value();
+
+        ++m_stats.loads;
+        m_stats.lastLoadMs = elapsedMs;
+        qDebug() << "RotationEngine: loaded" << m_library->tracks.size() << "tracks in"
+                 << m_library->genres.size() << "rotations in" << elapsedMs << "ms";
+        emit ready(m_library->tracks.size());
+    }
+
+    if (m_reloadPending) {
+        m_reloadPending = false;
+        reload();
+    }
+}
+
+QString RotationEngine::keyAt(const QDateTime& at) const
+{
+    if (!m_library)
+        return QString();
+    const QString key = m_library->clock.value(at.date().dayOfWeek() * 24 + at.time().hour());
+    return m_library->genres.contains(key) ? key : QString();
+}
+
+int RotationEngine::pick(const QString& key)
+{
+    if (!m_library)
+        return -1;
+
+    Rotation& rotation = m_rotations[key];
+    if (rotation.order.empty()) {
+        // Ran dry before its refill arrived (a tiny genre): shuffle here,
+        // it is all in memory
+        const QVector<int> indexes = m_library->genres.value(key);
+        if (indexes.isEmpty())
+            return -1;
+        rotation.order = shuffle(*m_library, indexes, m_played, nextSeed());
+    }
+
+    // First track near the head that keeps both separations; if none
+    // does, the head, so that a small genre keeps playing
+    const int picks = m_stats.picks;
+    const size_t limit = qMin(rotation.order.size(), size_t(m_options.lookAhead));
+    size_t chosen = limit;
+    for (size_t i = 0; i < limit; ++i) {
+        const Track& track = m_library->tracks.at(rotation.order[i]);
+        const auto artist = m_artistPicks.constFind(track.artist.trimmed().toLower());
+        if (!track.artist.trimmed().isEmpty() && artist != m_artistPicks.constEnd()
+                && picks - *artist <= m_options.artistSeparation)
+            continue;
+        const auto title = m_titlePicks.constFind(titleKey(track));
+        if (title != m_titlePicks.constEnd() && picks - *title <= m_options.titleSeparation)
+            continue;
+        chosen = i;
+        break;
+    }
+    if (chosen == limit) {
+        chosen = 0;
+        ++m_stats.relaxed;
+    }
+
+    const int index = rotation.order[chosen];
+    rotation.order.erase(rotation.order.begin() + std::ptrdiff_t(chosen));
+
+    const Track& track = m_library->tracks.at(index);
+    m_artistPicks.insert(track.artist.trimmed().toLower(), picks);
+    m_titlePicks.insert(titleKey(track), picks);
+    ++m_stats.picks;
+
+    if (rotation.order.size() < size_t(m_options.refillBelow))
+        refill(key);
+    return index;
+}
+
+void RotationEngine::refill(const QString& key)
+{
+    Rotation& rotation = m_rotations[key];
+    if (rotation.refilling)
+        return;
+    rotation.refilling = true;
+
+    const QSharedPointer<const Library> library = m_library;
+    const QHash<QString, qint64> played = m_played;
+    const quint32 seed = nextSeed();
+    const int generation = m_generation;
+    m_refillPool.start([this, library, played, seed, generation, key]() {
+        std::deque<int> order = shuffle(*library, library->genres.value(key), played, seed);
+        QMetaObject::invokeMethod(this, [this, generation, key, order]() {
+            if (generation != m_generation)
+                return;    // the library was loaded again meanwhile
+            Rotation& rotation = m_rotations[key];
+            rotation.order.insert(rotation.order.end(), order.begin(), order.end());
+            rotation.refilling = false;
+            ++m_stats.refills;
+        }, Qt::QueuedConnection);
+    });
+}
+
+std::deque<int> RotationEngine::shuffle(const Library& library, const QVector<int>& indexes,
+                                        const QHash<QString, qint64>& played, quint32 seed)
+{
+    // Weighted shuffle: each track draws an exponential arrival time with
+    // its weight as the rate and the rotation is the arrival order
+    const qint64 now = QDateTime::currentMSecsSinceEpoch();
+    QRandomGenerator random(seed);
+    std::vector<std::pair<double, int>> arrivals;
+    arrivals.reserve(indexes.size());
+    for (int index : indexes) {
+        const Track& track = library.tracks.at(index);
+        const qint64 lastPlayed = qMax(track.lastPlayedMs, played.value(track.path, 0));
+        const double rate = weight(track.playedTimes, lastPlayed, now);
+        arrivals.emplace_back(-std::log(1.0 - random.generateDouble()) / rate, index);
+    }
+    std::sort(arrivals.begin(), arrivals.end());
+
+    std::deque<int> order;
+    for (const auto& arrival : arrivals)
+        order.push_back(arrival.second);
+    return order;
+}
+
+quint32 RotationEngine::nextSeed()
+{
+    return m_options.seed != 0 ? m_options.seed + m_seeds++ : QRandomGenerator::global()->generate();
+}
+
+QString RotationEngine::genreKey(const QString& genre)
+{
+    return genre.trimmed().toLower();
+}
@@ -0,0 +1,245 @@
+#ifndef ROTATIONENGINE_H
+#define ROTATIONENGINE_H
+
+#include <QObject>
+#include <QDateTime>
+#include <QHash>
+#include <QSharedPointer>
+#include <QSqlDatabase>
+#include <QStringList>
+#include <QThreadPool>
+#include <QVector>
+#include <deque>
+
+/**
+ * @brief Precomputed music rotations for auto mode
+ *
+ * The engine loads the library and the hourgenre clock once, in the
+ * background, and keeps per genre a shuffled rotation of tracks: every
+ * track of the genre once, in an order weighted by play history. Tracks
+ * played in the last day sink towards the end of a rotation, tracks not
+ * played for days (or never) rise, and heavily played tracks sink a
+ * little. Picking walks the head of a rotation and takes the first track
+ * that keeps the artist and title separation, so asking for the next
+ * songs costs a few hash lookups and never touches the database.
+ *
+ * A rotation running low is refilled with a fresh shuffle on a worker
+ * thread. Genres come from the hourgenre table (day 1 to 7, hour 0 to
+ * 23); an hour without a genre, or whose genre has no tracks, draws from
+ * the whole library.
+ *
+ * @example
+ * @code
+ * RotationEngine* rotation = new RotationEngine(database, this);
+ * rotation->reload();
+ * ...
+ * for (const QString& path : rotation->plan(QDateTime::currentDateTime(), 3600))
+ *     playlist->addItem(path);
+ * @endcode
+ *
+ * @since XFB 2.0
+ */
+class RotationEngine : public QObject
+{
+    Q_OBJECT
+
+public:
+    /**
+     * @brief One musics row, as far as rotations need it
+     */
+    struct Track {
+        QString path;
+        QString artist;
+        QString title;
+        QString genre;
+        int seconds = 0;          // 0 where the duration is unknown
+        int playedTimes = 0;
+        qint64 lastPlayedMs = 0;  // 0: never played
+    };
+
+    struct Options {
+        int artistSeparation = 6;  // tracks between two by the same artist
+        int titleSeparation = 30;  // tracks between two of the same title
+        int lookAhead = 64;        // rotation entries tried before separation gives way
+        int refillBelow = 64;      // queued tracks that trigger a refill
+        int averageSeconds = 210;  // planning length of a track without a duration
+        quint32 seed = 0;          // shuffle seed, 0 for a random one
+    };
+
+    struct Statistics {
+        int tracks = 0;
+        int genres = 0;           // genres with tracks
+        int loads = 0;
+        int refills = 0;          // background reshuffles
+        int picks = 0;
+        int relaxed = 0;          // picks that had to break separation
+        qint64 lastLoadMs = 0;
+    };
+
+    explicit RotationEngine(const QSqlDatabase& database, QObject* parent = nullptr);
+    ~RotationEngine() override;
+
+    /**
+     * @brief Separation, refill and planning options
+     *
+     * Separation applies from the next pick, the shuffle seed from the
+     * next refill or load.
+     */
+    void setOptions(const Options& options);
+    Options options() const { return m_options; }
+
+    /**
+     * @brief Load the library and the hourgenre clock again in the background
+     *
+     * Calls while a load runs are coalesced into one more load. Separation
+     * history and plays noted since are kept.
+     */
+    void reload();
+
+    /**
+     * @brief Check if a load has completed
+     * @return true once rotations can be picked from
+     */
+    bool isReady() const { return !m_library.isNull(); }
+
+    /**
+     * @brief Check if a load is running; ready() or rotationError() follows
+     */
+    bool isLoading() const { return m_loading; }
+
+    /**
+     * @brief Block until the running load has finished
+     *
+     * Must be called from the engine's own thread; ready() has been
+     * emitted when this returns true.
+     *
+     * @param timeoutMs Timeout in milliseconds, -1 to wait forever
+     * @return true if the engine is ready and no load is running
+     */
+    bool waitForReady(int timeoutMs = -1);
+
+    /**
+     * @brief Genre the hourgenre clock gives a moment
+     * @return Genre as stored, empty for the whole library
+     */
+    QString genreAt(const QDateTime& at) const;
+
+    /**
+     * @brief Next tracks for the hour a moment falls in
+     * @param count Tracks wanted
+     * @param at Moment whose genre applies
+     * @return Paths, fewer than count only for an empty library
+     */
+    QStringList next(int count, const QDateTime& at = QDateTime::currentDateTime());
+
+    /**
+     * @brief Plan airtime ahead, following the clock across hours
+     * @param from When the first track will start
+     * @param seconds Airtime to fill
+     * @return Paths in airing order
+     */
+    QStringList plan(const QDateTime& from, int seconds);
+
+    /**
+     * @brief Planning length of a track
+     * @param path Track path
+     * @return Duration in seconds; averageSeconds for unknown tracks
+     */
+    int secondsOf(const QString& path) const;
+
+    /**
+     * @brief Record that a track went on air
+     *
+     * Shuffles weight it as just played until the next load reads the
+     * play from the database.
+     *
+     * @param path Track path
+     * @param at When it started
+     */
+    void notePlayed(const QString& path, const QDateTime& at = QDateTime::currentDateTime());
+
+    /**
+     * @brief Tracks queued in a genre's rotation
+     * @param genre Genre, empty for the whole library
+     */
+    int queued(const QString& genre) const;
+
+    Statistics statistics() const;
+
+    /**
+     * @brief Weight of a track in a shuffle
+     * @param playedTimes Times the track was played
+     * @param lastPlayedMs Last play in milliseconds since the epoch, 0 for never
+     * @param nowMs Current time in milliseconds since the epoch
+     * @return Relative chance of a place near the head of a rotation
+     */
+    static double weight(int playedTimes, qint64 lastPlayedMs, qint64 nowMs);
+
+signals:
+    /**
+     * @brief Emitted when a load has completed
+     * @param tracks Tracks in the library
+     */
+    void ready(int tracks);
+
+    /**
+     * @brief Emitted when the library cannot be read
+     * @param error Error message
+     */
+    void rotationError(const QString& error);
+
+private:
+    static constexpr qint64 kDayMs = 24 * 3600 * 1000;
+
+    // Read-only once loaded; shared with refill workers
+    struct Library {
+        QVector<Track> tracks;
+        QHash<QString, QVector<int>> genres;     // genre key -> track indexes
+        QHash<QString, int> paths;               // path -> track index
+        QHash<int, QString> clock;               // day * 24 + hour -> genre key
+        QHash<QString, QString> genreNames;      // genre key -> genre as stored
+    };
+
+    struct Rotation {
+        std::deque<int> order;    // track indexes, head airs first
+        bool refilling = false;
+    };
+
+    using Shuffles = QHash<QString, std::deque<int>>;
+
+    void load(int run, const QHash<QString, qint64>& played, quint32 seed);
+    void loaded(int run, QSharedPointer<const Library> library, const Shuffles& shuffles,
+                const QString& error, qint64 elapsedMs);
+    QString keyAt(const QDateTime& at) const;
+    int pick(const QString& key);
+    void refill(const QString& key);
+    static std::deque<int> shuffle(const Library& library, const QVector<int>& indexes,
+                                   const QHash<QString, qint64>& played, quint32 seed);
+    quint32 nextSeed();
+
+    static QString genreKey(const QString& genre);
+
+    QString m_databaseName;
+    QString m_driver;
+    QString m_connectionName;
+    Options m_options;
+
+    QSharedPointer<const Library> m_library;
+    QHash<QString, Rotation> m_rotations;
+    QHash<QString, qint64> m_played;         // path -> last play noted here
+
+    // Separation: pick number of each artist's and title's last pick
+    QHash<QString, int> m_artistPicks;
+    QHash<QString, int> m_titlePicks;
+
+    int m_run = 0;
+    int m_generation = 0;     // bumped by every load, stale refills are dropped
+    bool m_loading = false;
+    bool m_reloadPending = false;
+    quint32 m_seeds = 0;
+    QThreadPool m_loadPool;
+    QThreadPool m_refillPool;
+    Statistics m_stats;
+};
+
+#endif // ROTATIONENGINE_H
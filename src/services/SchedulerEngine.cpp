@@ -0,0 +1,432 @@
+#include "SchedulerEngine.h"
+#include "DatabaseAccess.h"
+#include <QElapsedTimer>
+#include <QLocale>
+#include <QSet>
+#include <QSqlDriver>
+#include <QSqlError>
+#include <QSqlQuery>
+#include <QDebug>
+
+namespace {
+
+const char* const kRuleColumns =
+    "SELECT rule_id, id, ano, mes, dia, hora, min, tipo, week_day, is_program FROM scheduler";
+
+} // namespace
+
+SchedulerEngine::SchedulerEngine(const QSqlDatabase& database, QObject* parent)
+    : QObject(parent)
+    , m_database(database)
+    , m_clock([]() { return QDateTime::currentMSecsSinceEpoch(); })
+{
+    qRegisterMetaType<SchedulerEngine::Event>();
+
+    m_timer.setSingleShot(true);
+    m_timer.setTimerType(Qt::PreciseTimer);
+    connect(&m_timer, &QTimer::timeout, this, &SchedulerEngine::fireDue);
+
+    connect(&m_changeTimer, &QTimer::timeout, this, &SchedulerEngine::refresh);
+}
+
+SchedulerEngine::~SchedulerEngine()
+{
+    stop();
+}
+
+void SchedulerEngine::setPreRoll(int milliseconds)
+{
+    m_preRollMs = qMax(0, milliseconds);
+    arm();
+}
+
+void SchedulerEngine::setClock(Clock clock)
+{
+    m_clock = clock ? std::move(clock) : Clock([]() { return QDateTime::currentMSecsSinceEpoch(); });
+}
+
+void SchedulerEngine::setWriter(DatabaseAccess* writer)
+{
+    m_writer = writer;
+}
+
+bool SchedulerEngine::start()
+{
+    if (m_running)
+        return true;
+    if (!reload())
+        return false;
+
+    m_running = true;
+
+    QSqlDriver* driver = m_database.driver();
+    m_notified = driver && driver->subscribeToNotification(QStringLiteral("scheduler"));
+    if (m_notified) {
+        connect(driver, &QSqlDriver::notification, this, &SchedulerEngine::changeNotified);
+        m_changeTimer.setSingleShot(true);
+        m_changeTimer.setInterval(kChangeDelayMs);
+    } else {
+        qWarning() << "SchedulerEngine: no change notifications from the database, polling";
+        m_changeTimer.setSingleShot(false);
+        m_changeTimer.setInterval(kChangePollMs);
+        m_changeTimer.start();
+    }
+    arm();
+    return true;
+}
+
+void SchedulerEngine::stop()
+{
+    m_running = false;
+    m_timer.stop();
+    m_changeTimer.stop();
+
+    QSqlDriver* driver = m_database.driver();
+    if (m_notified && driver) {
+        disconnect(driver, &QSqlDriver::notification, this, &SchedulerEngine::changeNotified);
+        driver->unsubscribeFromNotification(QStringLiteral("scheduler"));
+    }
+    m_notified = false;
+}
+
+bool SchedulerEngine::reload()
+{
+    QElapsedTimer clock;
+    clock.start();
+
+    // Log position first: a change made while loading is applied once
+    // more by the next refresh(), never missed
+    const qint64 logPosition = lastChange();
+
+    QSqlQuery query(m_database);
+    query.setForwardOnly(true);
+    if (!query.exec(kRuleColumns)) {
+        const QString error = tr("Could not read the scheduler: %1").arg(query.lastError().text());
+        qWarning() << "SchedulerEngine:" << error;
+        emit schedulerError(error);
+        return false;
+    }
+
+    m_rules.clear();
+    m_perTarget.clear();
+    m_queue = decltype(m_queue)();
+
+    const qint64 now = m_clock();
+    Rule rule;
+    while (query.next()) {
+        if (readRule(query, &rule))
+            putRule(rule, now);
+    }
+
+    m_lastChange = logPosition;
+    ++m_stats.reloads;
+    m_stats.lastLoadMs = clock.elapsed();
+    qDebug() << "SchedulerEngine: loaded" << m_rules.size() << "rules in" << m_stats.lastLoadMs << "ms";
+
+    arm();
+    return true;
+}
+
+int SchedulerEngine::refresh()
+{
+    if (!m_database.isOpen())
+        return 0;
+
+    QSqlQuery query(m_database);
+    query.setForwardOnly(true);
+    query.prepare("SELECT seq, rule FROM scheduler_changes WHERE seq > ? ORDER BY seq");
+    query.addBindValue(m_lastChange);
+    if (!query.exec())
+        return 0;
+
+    QSet<qint64> changed;
+    qint64 last = m_lastChange;
+    while (query.next()) {
+        last = query.value(0).toLongLong();
+        changed.insert(query.value(1).toLongLong());
+    }
+    query.finish();
+    if (changed.isEmpty())
+        return 0;
+
+    if (changed.size() > kReloadThreshold) {
+        // Bulk edits (clearing the schedule): one pass over the table
+        // beats a lookup per row
+        if (!reload())
+            return 0;
+    } else {
+        QSqlQuery row(m_database);
+        row.setForwardOnly(true);
+        row.prepare(QString(kRuleColumns) + " WHERE rule_id = ?");
+        const qint64 now = m_clock();
+        Rule rule;
+        for (qint64 ruleId : std::as_const(changed)) {
+            row.addBindValue(ruleId);
+            if (!row.exec()) {
+                qWarning() << "SchedulerEngine: could not reload rule" << ruleId << row.lastError().text();
+                continue;
+            }
+            if (row.next() && readRule(row, &rule)) {
+                putRule(rule, now);
+            } else {
+                dropRule(ruleId);
+                m_firedAt.remove(ruleId);
+            }
+            row.finish();
+        }
+        m_lastChange = last;
+        compact();
+        arm();
+    }
+
+    m_stats.changesApplied += changed.size();
+    write("DELETE FROM scheduler_changes WHERE seq <= ?", {last});
+    return changed.size();
+}
+
+QDateTime SchedulerEngine::nextFireTime()
+{
+    while (!m_queue.empty()) {
+        const Pending& top = m_queue.top();
+        const auto it = m_rules.constFind(top.ruleId);
+        if (it != m_rules.constEnd() && it->generation == top.generation)
+            return QDateTime::fromMSecsSinceEpoch(top.fireMs);
+        m_queue.pop();
+    }
+    return QDateTime();
+}
+
+int SchedulerEngine::rulesFor(int id, bool isProgram) const
+{
+    return m_perTarget.value(qMakePair(id, isProgram), 0);
+}
+
+SchedulerEngine::Statistics SchedulerEngine::statistics() const
+{
+    Statistics stats = m_stats;
+    stats.rules = m_rules.size();
+    stats.armed = 0;
+    for (const Entry& entry : m_rules) {
+        if (entry.fireMs >= 0)
+            ++stats.armed;
+    }
+    return stats;
+}
+
+QDateTime SchedulerEngine::nextFire(const Rule& rule, const QDateTime& from)
+{
+    if (rule.type == Once)
+        return rule.at.isValid() && rule.at >= from ? rule.at : QDateTime();
+
+    if (rule.weekDay < 1 || rule.weekDay > 7 || !rule.time.isValid())
+        return QDateTime();
+
+    // Today counts if the time is still ahead; the same weekday a week on
+    // always is
+    QDate day = from.date();
+    for (int i = 0; i <= 7; ++i, day = day.addDays(1)) {
+        if (day.dayOfWeek() != rule.weekDay)
+            continue;
+        const QDateTime candidate(day, rule.time);
+        if (candidate >= from)
+            return candidate;
+    }
+    return QDateTime();
+}
+
+int SchedulerEngine::weekDayFromName(const QString& name)
+{
+    const QString trimmed = name.trimmed();
+    if (trimmed.isEmpty())
+        return 0;
+
+    // Stored as shown in the pub and program dialogs: English, unless the
+    // dialogs were translated
+    const QLocale locales[] = {QLocale::c(), QLocale::system(), QLocale()};
+    for (const QLocale& locale : locales) {
+        for (int day = 1; day <= 7; ++day) {
+            if (trimmed.compare(locale.dayName(day, QLocale::LongFormat), Qt::CaseInsensitive) == 0)
+                return day;
+        }
+    }
+    return 0;
+}
+
+bool SchedulerEngine::readRule(const QSqlQuery& query, Rule* rule) const
+{
+    // Columns as in kRuleColumns; dates and times are stored as text, with
+    // or without leading zeros
+    const int type = query.value(7).toInt();
+    if (type != Once && type != Weekly)
+        return false;
+
+    *rule = Rule();
+    rule->ruleId = query.value(0).toLongLong();
+    rule->id = query.value(1).toInt();
+    rule->isProgram = query.value(9).toInt() == 1;
+    rule->type = RuleType(type);
+
+    const QTime time(query.value(5).toInt(), query.value(6).toInt());
+    if (type == Once) {
+        const QDate date(query.value(2).toInt(), query.value(3).toInt(), query.value(4).toInt());
+        if (date.isValid() && time.isValid())
+            rule->at = QDateTime(date, time);
+    } else {
+        rule->weekDay = weekDayFromName(query.value(8).toString());
+        rule->time = time;
+    }
+    return true;
+}
+
+void SchedulerEngine::putRule(const Rule& rule, qint64 now)
+{
+    if (m_rules.contains(rule.ruleId))
+        dropRule(rule.ruleId);
+
+    // Still fire what fell due within the grace period, but never fire
+    // the same occurrence twice
+    qint64 from = now - kGraceMs;
+    const auto fired = m_firedAt.constFind(rule.ruleId);
+    if (fired != m_firedAt.constEnd())
+        from = qMax(from, *fired + 1);
+
+    Entry entry;
+    entry.rule = rule;
+    entry.generation = ++m_generation;
+    const QDateTime next = nextFire(rule, QDateTime::fromMSecsSinceEpoch(from));
+    entry.fireMs = next.isValid() ? next.toMSecsSinceEpoch() : -1;
+
+    m_rules.insert(rule.ruleId, entry);
+    ++m_perTarget[qMakePair(rule.id, rule.isProgram)];
+    if (entry.fireMs >= 0)
+        m_queue.push({entry.fireMs, rule.ruleId, entry.generation});
+}
+
+void SchedulerEngine::dropRule(qint64 ruleId)
+{
+    // Its queue entry goes stale and is skipped when it reaches the top
+    const auto it = m_rules.constFind(ruleId);
+    if (it == m_rules.constEnd())
+        return;
+
+    const QPair<int, bool> target(it->rule.id, it->rule.isProgram);
+    if (--m_perTarget[target] <= 0)
+        m_perTarget.remove(target);
+    m_rules.erase(it);
+}
+
+void SchedulerEngine::fireDue()
+{
+    const qint64 now = m_clock();
+
+    while (!m_queue.empty()) {
+        const Pending top = m_queue.top();
+        const auto it = m_rules.constFind(top.ruleId);
+        if (it == m_rules.constEnd() || it->generation != top.generation) {
+            m_queue.pop();
+            continue;
+        }
+        const qint64 dueMs = top.fireMs - m_preRollMs;
+        if (dueMs > now)
+            break;
+        m_queue.pop();
+
+        const Rule rule = it->rule;
+        if (now - top.fireMs > kGraceMs) {
+            // Missed by more than its minute (the machine slept): skip this
+            // occurrence, as polling did
+            putRule(rule, now);
+            continue;
+        }
+
+        Event event;
+        event.rule = rule;
+        event.scheduledAt = QDateTime::fromMSecsSinceEpoch(top.fireMs);
+        event.latenessMs = now - dueMs;
+        m_firedAt.insert(rule.ruleId, top.fireMs);
+
+        if (rule.type == Once) {
+            dropRule(rule.ruleId);
+            write("DELETE FROM scheduler WHERE rule_id = ?", {rule.ruleId});
+        } else {
+            putRule(rule, now);
+        }
+
+        ++m_stats.fired;
+        m_stats.maxLatenessMs = qMax(m_stats.maxLatenessMs, event.latenessMs);
+        emit ruleDue(event);
+    }
+
+    arm();
+}
+
+void SchedulerEngine::arm()
+{
+    if (!m_running) {
+        m_timer.stop();
+        return;
+    }
+
+    const QDateTime next = nextFireTime();
+    if (!next.isValid()) {
+        m_timer.stop();
+        return;
+    }
+
+    // Sleep at most kMaxSleepMs: a wall clock change (NTP, daylight saving)
+    // is then noticed within a minute
+    const qint64 wait = next.toMSecsSinceEpoch() - m_preRollMs - m_clock();
+    m_timer.start(int(qBound<qint64>(0, wait, kMaxSleepMs)));
+}
+
+void SchedulerEngine::compact()
+{
+    // Every change leaves a stale entry behind; rebuild once they dominate
+    if (m_queue.size() <= size_t(2 * m_rules.size() + 1024))
+        return;
+
+    std::vector<Pending> live;
+    live.reserve(m_rules.size());
+    for (auto it = m_rules.constBegin(); it != m_rules.constEnd(); ++it) {
+        if (it->fireMs >= 0)
+            live.push_back({it->fireMs, it.key(), it->generation});
+    }
+    m_queue = decltype(m_queue)(std::greater<Pending>(), std::move(live));
+}
+
+void SchedulerEngine::changeNotified(const QString& name)
+{
+    // One notification per row written: the first arms the timer, the
+    // rest of a bulk edit lands within it
+    if (name == QLatin1String("scheduler") && m_running && !m_changeTimer.isActive())
+        m_changeTimer.start();
+}
+
+qint64 SchedulerEngine::lastChange()
+{
+    QSqlQuery query(m_database);
+    if (!query.exec("SELECT COALESCE(MAX(seq), 0) FROM scheduler_changes") || !query.next()) {
+        qWarning() << "SchedulerEngine: no scheduler_changes log, changes need a reload:"
+                   << query.lastError().text();
+        return 0;
+    }
+    return query.value(0).toLongLong();
+}
+
+void SchedulerEngine::write(const QString& sql, const QVariantList& values)
+{
+    if (m_writer) {
+        m_writer->write(sql, values);
+        return;
+    }
+
+    QSqlQuery query(m_database);
+    query.prepare(sql);
+    for (const QVariant& value : values)
+        query.addBindValue(value);
+    if (!query.exec()) {
+        const QString error = tr("Could not update the scheduler: %1").arg(query.lastError().text());
+        qWarning() << "SchedulerEngine:" << error;
+        emit schedulerError(error);
+    }
+}
@@ -0,0 +1,237 @@
+#ifndef SCHEDULERENGINE_H
+#define SCHEDULERENGINE_H
+
+#include <QObject>
+#include <QDateTime>
+#include <QHash>
+#include <QSqlDatabase>
+#include <QTimer>
+#include <functional>
+#include <queue>
+#include <vector>
+
+class QSqlQuery;
+class DatabaseAccess;
+
+/**
+ * @brief Fires scheduler table rules at their time from an in-memory queue
+ *
+ * The scheduler table holds two kinds of rule: type 1 plays a pub or
+ * program once at a given minute, type 2 plays it every week on a given
+ * day at a given time. The engine loads the table once into a min-heap
+ * of next fire times and arms a single precise timer for the earliest,
+ * so a rule fires at its second rather than somewhere in a polled minute,
+ * and the cost of firing does not grow with the table.
+ *
+ * Rules are keyed by scheduler.rule_id, an INTEGER PRIMARY KEY, so a
+ * VACUUM does not renumber them. Changes reach the engine through the
+ * scheduler_changes log, which triggers on the scheduler table fill
+ * whoever writes it; the engine reloads only the rules named there. The
+ * log is read when the connection's driver reports a write to scheduler
+ * (SQLite's update hook, so the dialogs writing on the same connection
+ * are seen as they write), kChangeDelayMs later so a bulk edit is read
+ * once. A driver without notifications is polled every kChangePollMs
+ * instead. refresh() applies the log immediately.
+ *
+ * A once rule is deleted from the table when it fires. A rule whose time
+ * passed less than kGraceMs ago when it is loaded still fires, as it would
+ * have within its minute before. With a pre-roll, ruleDue() is emitted
+ * that long before the rule's time.
+ *
+ * @example
+ * @code
+ * SchedulerEngine* scheduler = new SchedulerEngine(database, this);
+ * connect(scheduler, &SchedulerEngine::ruleDue, this, &Player::playScheduled);
+ * scheduler->start();
+ * @endcode
+ *
+ * @since XFB 2.0
+ */
+class SchedulerEngine : public QObject
+{
+    Q_OBJECT
+
+public:
+    enum RuleType {
+        Once = 1,
+        Weekly = 2
+    };
+
+    /**
+     * @brief One row of the scheduler table
+     */
+    struct Rule {
+        qint64 ruleId = 0;        // scheduler.rule_id
+        int id = 0;               // pub or program id
+        bool isProgram = false;
+        RuleType type = Once;
+        QDateTime at;             // Once: when
+        int weekDay = 0;          // Weekly: 1 (Monday) to 7
+        QTime time;               // Weekly: time of day
+    };
+
+    /**
+     * @brief A rule that is due
+     */
+    struct Event {
+        Rule rule;
+        QDateTime scheduledAt;    // the rule's time, pre-roll not applied
+        qint64 latenessMs = 0;    // how late ruleDue() was emitted
+    };
+
+    struct Statistics {
+        int rules = 0;            // rows in memory, expired once rules included
+        int armed = 0;            // rules with a time still to come
+        int reloads = 0;          // full loads of the table
+        int changesApplied = 0;   // rows reloaded from the change log
+        int fired = 0;
+        qint64 lastLoadMs = 0;
+        qint64 maxLatenessMs = 0;
+    };
+
+    /**
+     * @brief Wall clock in milliseconds since the epoch
+     */
+    using Clock = std::function<qint64()>;
+
+    explicit SchedulerEngine(const QSqlDatabase& database, QObject* parent = nullptr);
+    ~SchedulerEngine() override;
+
+    /**
+     * @brief Emit ruleDue() this long before a rule's time
+     * @param milliseconds Pre-roll, 0 for none
+     */
+    void setPreRoll(int milliseconds);
+    int preRoll() const { return m_preRollMs; }
+
+    /**
+     * @brief Replace the wall clock, for tests; call before start()
+     */
+    void setClock(Clock clock);
+
+    /**
+     * @brief Queue the engine's own writes (deleting fired once rules,
+     * pruning the change log) instead of running them on this thread
+     * @param writer Library writer, or nullptr to write directly
+     */
+    void setWriter(DatabaseAccess* writer);
+
+    /**
+     * @brief Load the table, arm the timer and follow the change log
+     * @return false if the table could not be read
+     */
+    bool start();
+
+    /**
+     * @brief Stop firing and following changes
+     */
+    void stop();
+
+    bool isRunning() const { return m_running; }
+
+    /**
+     * @brief Load the whole table again
+     * @return false if the table could not be read
+     */
+    bool reload();
+
+    /**
+     * @brief Apply the change log now
+     * @return Number of rows reloaded
+     */
+    int refresh();
+
+    /**
+     * @brief Time the next rule is due, pre-roll not applied
+     * @return Invalid if nothing is scheduled
+     */
+    QDateTime nextFireTime();
+
+    /**
+     * @brief Rules for one pub or program still in the table
+     */
+    int rulesFor(int id, bool isProgram) const;
+
+    Statistics statistics() const;
+
+    /**
+     * @brief When a rule is next due at or after a moment
+     * @param rule Rule
+     * @param from Earliest time to consider
+     * @return Invalid if the rule will not fire again
+     */
+    static QDateTime nextFire(const Rule& rule, const QDateTime& from);
+
+    /**
+     * @brief Day number (1 = Monday) of a stored week_day name
+     * @return 0 if the name is not a day
+     */
+    static int weekDayFromName(const QString& name);
+
+signals:
+    /**
+     * @brief Emitted when a rule is due
+     * @param event The rule and when it was due
+     */
+    void ruleDue(const SchedulerEngine::Event& event);
+
+    /**
+     * @brief Emitted when the table cannot be read or updated
+     * @param error Error message
+     */
+    void schedulerError(const QString& error);
+
+private:
+    static constexpr qint64 kGraceMs = 60 * 1000;
+    static constexpr int kChangeDelayMs = 100;         // after a notification
+    static constexpr int kChangePollMs = 2000;         // without notifications
+    static constexpr int kMaxSleepMs = 60 * 1000;      // re-check the wall clock at least this often
+    static constexpr int kReloadThreshold = 1000;       // more logged changes than this: reload
+
+    struct Entry {
+        Rule rule;
+        qint64 fireMs = -1;       // -1: will not fire again
+        quint32 generation = 0;
+    };
+
+    struct Pending {
+        qint64 fireMs;
+        qint64 ruleId;
+        quint32 generation;
+        bool operator>(const Pending& other) const {
+            return fireMs != other.fireMs ? fireMs > other.fireMs : ruleId > other.ruleId;
+        }
+    };
+
+    bool readRule(const QSqlQuery& query, Rule* rule) const;
+    void putRule(const Rule& rule, qint64 now);
+    void dropRule(qint64 ruleId);
+    void fireDue();
+    void arm();
+    void compact();
+    qint64 lastChange();
+    void write(const QString& sql, const QVariantList& values);
+    void changeNotified(const QString& name);
+
+    QSqlDatabase m_database;
+    DatabaseAccess* m_writer = nullptr;
+    Clock m_clock;
+    int m_preRollMs = 0;
+    bool m_running = false;
+    bool m_notified = false;                // the driver reports writes
+
+    QHash<qint64, Entry> m_rules;
+    QHash<qint64, qint64> m_firedAt;        // ruleId -> time it last fired
+    QHash<QPair<int, bool>, int> m_perTarget;
+    std::priority_queue<Pending, std::vector<Pending>, std::greater<Pending>> m_queue;
+    quint32 m_generation = 0;
+    qint64 m_lastChange = 0;
+
+    QTimer m_timer;
+    QTimer m_changeTimer;
+    Statistics m_stats;
+};
+
+Q_DECLARE_METATYPE(SchedulerEngine::Event)
+
+#endif // SCHEDULERENGINE_H
@@ -0,0 +1,457 @@
+#include "StreamSource.h"
+#include "../audio/FxParams.h"
+#include <QHash>
+#include <QMutexLocker>
+#include <QSettings>
+#include <QTcpSocket>
+#include <QTimer>
+#include <QDebug>
+#include <algorithm>
+
+namespace {
+
+constexpr int kPumpIntervalMs = 20;
+constexpr int kBufferFrames = FxStreamTap::kSampleRate / 4;
+// Dry tap for longer than this: nothing is playing, send silence
+constexpr qint64 kSilenceAfterMs = 250;
+constexpr qint64 kHandshakeTimeoutMs = 10000;
+constexpr qint64 kMinBackoffMs = 1000;
+constexpr qint64 kMaxBackoffMs = 60000;
+// Encoded audio the socket may hold before the mount is dropped
+constexpr qint64 kMaxBacklogSeconds = 10;
+
+QByteArray headerLine(const char* name, const QString& value)
+{
+    return QByteArray(name) + ": " + value.toUtf8() + "\r\n";
+}
+
+} // namespace
+
+// ------------------------------------------------------------ StreamSource
+
+StreamSource::StreamSource(EncoderFactory encoderFactory, QObject* parent)
+    : QObject(parent)
+{
+    m_worker = new StreamSourceWorker(&m_tap, std::move(encoderFactory));
+    m_worker->moveToThread(&m_thread);
+    connect(&m_thread, &QThread::finished, m_worker, &QObject::deleteLater);
+    connect(m_worker, &StreamSourceWorker::mountStateChanged, this, &StreamSource::mountStateChanged);
+    m_thread.setObjectName(QStringLiteral("StreamSourceThread"));
+    m_thread.start();
+}
+
+StreamSource::~StreamSource()
+{
+    m_tap.setEnabled(false);
+    // The worker closes its sockets and encoders on its own thread
+    QMetaObject::invokeMethod(m_worker, &StreamSourceWorker::stop, Qt::BlockingQueuedConnection);
+    m_thread.quit();
+    m_thread.wait();
+}
+
+void StreamSource::start(const QList<StreamMount>& mounts)
+{
+    StreamSourceWorker* worker = m_worker;
+    QMetaObject::invokeMethod(worker, [worker, mounts]() { worker->start(mounts); });
+    m_tap.setEnabled(true);
+    m_running = true;
+}
+
+void StreamSource::stop()
+{
+    m_tap.setEnabled(false);
+    QMetaObject::invokeMethod(m_worker, &StreamSourceWorker::stop);
+    m_running = false;
+}
+
+StreamSource::Stats StreamSource::stats() const
+{
+    return m_worker->stats();
+}
+
+QList<StreamMount> StreamSource::loadMounts()
+{
+    QSettings s(FxSettings::configFilePath(), QSettings::IniFormat);
+    QList<StreamMount> mounts;
+    s.beginGroup("Streaming");
+    const int count = s.beginReadArray("Mounts");
+    for (int i = 0; i < count; ++i) {
+        s.setArrayIndex(i);
+        StreamMount m;
+        m.host = s.value("host", m.host).toString();
+        if (m.host.isEmpty())
+            continue;
+        m.protocol = s.value("protocol").toString().compare("shoutcast", Qt::CaseInsensitive) == 0
+                         ? StreamMount::Shoutcast : StreamMount::Icecast;
+        m.port = static_cast<quint16>(s.value("port", m.port).toUInt());
+        m.mount = s.value("mount", m.mount).toString();
+        if (!m.mount.startsWith('/'))
+            m.mount.prepend('/');
+        m.user = s.value("user", m.user).toString();
+        m.password = s.value("password").toString();
+        m.encoder.codec = FxEncoder::codecFromName(s.value("codec").toString());
+        m.encoder.bitrateKbps = std::clamp(s.value("bitrate", m.encoder.bitrateKbps).toInt(), 16, 320);
+        m.streamName = s.value("streamName").toString();
+        m.description = s.value("description").toString();
+        m.genre = s.value("genre").toString();
+        m.url = s.value("url").toString();
+        m.isPublic = s.value("public", false).toBool();
+        m.name = s.value("name").toString();
+        if (m.name.isEmpty()) {
+            m.name = m.protocol == StreamMount::Icecast
+                         ? QString("%1:%2%3").arg(m.host).arg(m.port).arg(m.mount)
+                         : QString("%1:%2").arg(m.host).arg(m.port);
+        }
+        mounts << m;
+    }
+    s.endArray();
+    s.endGroup();
+    return mounts;
+}
+
+// ------------------------------------------------------ StreamSourceWorker
+
+struct StreamSourceWorker::Connection {
+    StreamMount mount;
+    QTcpSocket* socket = nullptr;
+    int lane = 0;                  // encoder shared with the mounts of the same settings
+    bool joined = false;           // receiving the lane's output (else waiting for a header)
+    StreamSource::MountState state = StreamSource::Stopped;
+    QByteArray reply;              // handshake answer so far
+    qint64 attemptStartedMs = 0;
+    qint64 retryAtMs = 0;
+    int failures = 0;              // in a row, sets the backoff
+    bool attempted = false;
+    qint64 bytesSent = 0;
+    int reconnects = 0;
+    QString lastError;
+};
+
+StreamSourceWorker::StreamSourceWorker(FxStreamTap* tap, StreamSource::EncoderFactory encoderFactory)
+    : m_tap(tap)
+    , m_fanout(FxStreamTap::kChannels, FxStreamTap::kSampleRate, std::move(encoderFactory))
+    , m_buffer(static_cast<size_t>(kBufferFrames) * FxStreamTap::kChannels)
+{
+}
+
+StreamSourceWorker::~StreamSourceWorker()
+{
+    stop();
+}
+
+void StreamSourceWorker::start(const QList<StreamMount>& mounts)
+{
+    stop();
+    if (!m_pumpTimer) {
+        m_pumpTimer = new QTimer(this);
+        m_pumpTimer->setTimerType(Qt::PreciseTimer);
+        connect(m_pumpTimer, &QTimer::timeout, this, &StreamSourceWorker::pump);
+    }
+
+    // Whatever the tap held from before the start is stale
+    m_tap->discardAll();
+    m_clock.start();
+    m_lastAudioMs = 0;
+    m_paddedUntilMs = 0;
+
+    // One encoder per distinct format, whatever the number of mounts
+    QHash<QString, int> lanes;
+    for (const StreamMount& mount : mounts) {
+        const FxEncoder::Settings& enc = mount.encoder;
+        const QString key = QString("%1/%2/%3/%4").arg(FxEncoder::codecName(enc.codec))
+                                .arg(enc.bitrateKbps).arg(enc.sampleRate).arg(enc.channels);
+        if (!lanes.contains(key)) {
+            lanes.insert(key, m_fanout.addLane(enc));
+            m_lanes << lanes.value(key);
+        }
+        auto c = std::make_unique<Connection>();
+        c->mount = mount;
+        c->lane = lanes.value(key);
+        m_connections.push_back(std::move(c));
+    }
+    for (auto& c : m_connections)
+        connectMount(*c);
+    m_pumpTimer->start(kPumpIntervalMs);
+    updateStats(0);
+}
+
+void StreamSourceWorker::stop()
+{
+    if (m_pumpTimer)
+        m_pumpTimer->stop();
+    for (auto& c : m_connections) {
+        closeSocket(*c);
+        setState(*c, StreamSource::Stopped);
+    }
+    m_connections.clear();
+    m_fanout.clear();
+    m_lanes.clear();
+    m_failedLanes.clear();
+    updateStats(0);
+}
+
+StreamSource::Stats StreamSourceWorker::stats() const
+{
+    QMutexLocker locker(&m_statsMutex);
+    return m_stats;
+}
+
+void StreamSourceWorker::pump()
+{
+    const qint64 now = m_clock.elapsed();
+    const qint64 lagFrames = static_cast<qint64>(m_tap->availableFrames());
+
+    bool gotAudio = false;
+    size_t frames;
+    while ((frames = m_tap->read(m_buffer.data(), kBufferFrames)) > 0) {
+        gotAudio = true;
+        m_fanout.push(m_buffer.data(), frames);
+    }
+    if (gotAudio) {
+        m_lastAudioMs = now;
+        m_paddedUntilMs = now;
+    } else if (now - m_lastAudioMs > kSilenceAfterMs) {
+        // Paused or stopped: keep the mounts fed at the real-time rate, or
+        // the servers time the source out and the listeners drop
+        const qint64 padFrames = std::min<qint64>((now - m_paddedUntilMs) * FxStreamTap::kSampleRate / 1000,
+                                                  kBufferFrames);
+        if (padFrames > 0) {
+            std::fill(m_buffer.begin(), m_buffer.begin() + padFrames * FxStreamTap::kChannels, 0.0f);
+            m_fanout.push(m_buffer.data(), static_cast<size_t>(padFrames));
+            m_paddedUntilMs += padFrames * 1000 / FxStreamTap::kSampleRate;
+        }
+    }
+
+    for (int lane : std::as_const(m_lanes))
+        send(lane);
+
+    for (auto& c : m_connections) {
+        switch (c->state) {
+        case StreamSource::Connecting:
+            if (now - c->attemptStartedMs > kHandshakeTimeoutMs)
+                fail(*c, tr("No answer from the server"));
+            break;
+        case StreamSource::Retrying:
+            if (now >= c->retryAtMs)
+                connectMount(*c);
+            break;
+        case StreamSource::Streaming:
+        case StreamSource::Stopped:
+            break;
+        }
+    }
+    updateStats(lagFrames);
+}
+
+void StreamSourceWorker::send(int lane)
+{
+    FxEncodeFanout::Output& out = m_output;
+    m_fanout.takeOutput(lane, out);
+    if (out.failed)
+        m_failedLanes.insert(lane);
+
+    for (auto& c : m_connections) {
+        if (c->lane != lane || c->state != StreamSource::Streaming)
+            continue;
+        if (out.failed) {
+            fail(*c, tr("Encoder stopped: %1").arg(out.error));
+            continue;
+        }
+        // A mount that needs a container header joins where the restarted
+        // encoder's output begins
+        qsizetype from = 0;
+        if (!c->joined) {
+            if (out.restartOffset < 0)
+                continue;
+            from = out.restartOffset;
+            c->joined = true;
+        }
+        const qint64 maxBacklog = qint64(c->mount.encoder.bitrateKbps) * 125 * kMaxBacklogSeconds;
+        if (c->socket->bytesToWrite() > maxBacklog) {
+            fail(*c, tr("The server is not taking the stream fast enough"));
+            continue;
+        }
+        if (out.bytes.size() > from) {
+            c->socket->write(out.bytes.constData() + from, out.bytes.size() - from);
+            c->bytesSent += out.bytes.size() - from;
+        }
+    }
+}
+
+void StreamSourceWorker::connectMount(Connection& c)
+{
+    closeSocket(c);
+    if (c.attempted)
+        ++c.reconnects;
+    c.attempted = true;
+    c.reply.clear();
+    c.joined = false;
+    c.attemptStartedMs = m_clock.elapsed();
+
+    Connection* conn = &c;
+    c.socket = new QTcpSocket(this);
+    connect(c.socket, &QTcpSocket::connected, this, [this, conn]() { onConnected(*conn); });
+    connect(c.socket, &QTcpSocket::readyRead, this, [this, conn]() { onReadyRead(*conn); });
+    connect(c.socket, &QTcpSocket::errorOccurred, this, [this, conn]() {
+        fail(*conn, conn->socket->errorString());
+    });
+    setState(c, StreamSource::Connecting);
+    c.socket->connectToHost(c.mount.host, c.mount.port);
+}
+
+void StreamSourceWorker::onConnected(Connection& c)
+{
+    const StreamMount& m = c.mount;
+    const FxEncoder::Settings& enc = m.encoder;
+    if (m.protocol == StreamMount::Shoutcast) {
+        // v1: the password alone, then OK2 before the icy- headers
+        c.socket->write(m.password.toUtf8() + "\r\n");
+        return;
+    }
+
+    QByteArray request = "PUT " + m.mount.toUtf8() + " HTTP/1.1\r\n";
+    request += headerLine("Host", QString("%1:%2").arg(m.host).arg(m.port));
+    request += headerLine("Authorization",
+                          "Basic " + QString::fromLatin1((m.user + ':' + m.password).toUtf8().toBase64()));
+    request += headerLine("User-Agent", QStringLiteral("XFB"));
+    request += headerLine("Content-Type", FxEncoder::contentType(enc.codec));
+    request += headerLine("Ice-Public", m.isPublic ? QStringLiteral("1") : QStringLiteral("0"));
+    if (!m.streamName.isEmpty())
+        request += headerLine("Ice-Name", m.streamName);
+    if (!m.description.isEmpty())
+        request += headerLine("Ice-Description", m.description);
+    if (!m.genre.isEmpty())
+        request += headerLine("Ice-Genre", m.genre);
+    if (!m.url.isEmpty())
+        request += headerLine("Ice-Url", m.url);
+    request += headerLine("Ice-Audio-Info", QString("ice-bitrate=%1;ice-channels=%2;ice-samplerate=%3")
+                                                .arg(enc.bitrateKbps).arg(enc.channels).arg(enc.sampleRate));
+    // Icecast answers 100 before any audio, so a refusal costs no data
+    request += "Expect: 100-continue\r\n\r\n";
+    c.socket->write(request);
+}
+
+void StreamSourceWorker::onReadyRead(Connection& c)
+{
+    if (c.state != StreamSource::Connecting) {
+        c.socket->readAll(); // nothing more is expected from a source's server
+        return;
+    }
+    c.reply += c.socket->readAll();
+    const int eol = c.reply.indexOf("\r\n");
+    if (eol < 0)
+        return;
+    const QByteArray status = c.reply.left(eol).trimmed();
+
+    if (c.mount.protocol == StreamMount::Shoutcast) {
+        if (!status.startsWith("OK")) {
+            fail(c, tr("Server refused the source: %1").arg(QString::fromUtf8(status)));
+            return;
+        }
+        const StreamMount& m = c.mount;
+        QByteArray headers;
+        headers += headerLine("content-type", FxEncoder::contentType(m.encoder.codec));
+        headers += headerLine("icy-name", m.streamName);
+        headers += headerLine("icy-genre", m.genre);
+        headers += headerLine("icy-url", m.url);
+        headers += headerLine("icy-pub", m.isPublic ? QStringLiteral("1") : QStringLiteral("0"));
+        headers += headerLine("icy-br", QString::number(m.encoder.bitrateKbps));
+        headers += "\r\n";
+        c.socket->write(headers);
+        beginStreaming(c);
+        return;
+    }
+
+    // "HTTP/1.1 100 Continue" or "HTTP/1.0 200 OK"
+    const QList<QByteArray> parts = status.split(' ');
+    const int code = parts.size() > 1 ? parts.at(1).toInt() : 0;
+    if (code == 100 || code == 200) {
+        beginStreaming(c);
+    } else if (code == 401 || code == 403) {
+        fail(c, tr("Wrong user or password for %1").arg(c.mount.mount));
+    } else {
+        fail(c, tr("Server refused the source: %1").arg(QString::fromUtf8(status)));
+    }
+}
+
+void StreamSourceWorker::beginStreaming(Connection& c)
+{
+    // MP3 and AAC mounts join the running encoder at its next frame; an
+    // Ogg mount restarts it, so every mount on it gets a new chain with
+    // headers. A failed encoder is reopened by whoever needs it next.
+    c.joined = FxEncoder::joinableMidStream(c.mount.encoder.codec) && !m_failedLanes.contains(c.lane);
+    if (!c.joined) {
+        m_failedLanes.remove(c.lane);
+        m_fanout.restartLane(c.lane);
+    }
+    c.failures = 0;
+    c.lastError.clear();
+    setState(c, StreamSource::Streaming);
+    qDebug() << "StreamSource: streaming to" << c.mount.name;
+}
+
+void StreamSourceWorker::fail(Connection& c, const QString& error)
+{
+    if (c.state == StreamSource::Retrying || c.state == StreamSource::Stopped)
+        return;
+    closeSocket(c);
+    c.joined = false;
+    c.lastError = error;
+
+    const qint64 delay = std::min(kMaxBackoffMs, kMinBackoffMs << std::min(c.failures, 6));
+    ++c.failures;
+    c.retryAtMs = m_clock.elapsed() + delay;
+    qWarning() << "StreamSource:" << c.mount.name << error << "- retrying in" << delay / 1000 << "s";
+    setState(c, StreamSource::Retrying, error);
+}
+
+void StreamSourceWorker::closeSocket(Connection& c)
+{
+    if (!c.socket)
+        return;
+    // Signals first: abort() would report the disconnect as a failure
+    c.socket->disconnect(this);
+    c.socket->abort();
+    c.socket->deleteLater();
+    c.socket = nullptr;
+}
+
+void StreamSourceWorker::setState(Connection& c, StreamSource::MountState state, const QString& detail)
+{
+    if (c.state == state)
+        return;
+    c.state = state;
+    emit mountStateChanged(c.mount.name, state, detail);
+}
+
+void StreamSourceWorker::updateStats(qint64 lagFrames)
+{
+    qint64 encoderQueued = 0;
+    StreamSource::Stats stats;
+    stats.droppedFrames = m_tap->droppedFrames();
+    for (int lane : std::as_const(m_lanes)) {
+        const FxEncodeFanout::LaneStats laneStats = m_fanout.laneStats(lane);
+        StreamSource::EncoderStats encoder;
+        encoder.settings = laneStats.settings;
+        encoder.lagMs = laneStats.queuedFrames * 1000 / FxStreamTap::kSampleRate;
+        encoder.droppedFrames = laneStats.droppedFrames;
+        encoder.cpuTimeUs = laneStats.cpuTimeUs;
+        stats.encoders << encoder;
+        encoderQueued = std::max(encoderQueued, laneStats.queuedFrames);
+        stats.droppedFrames += laneStats.droppedFrames;
+    }
+    for (const auto& c : m_connections) {
+        StreamSource::MountStats mount;
+        mount.name = c->mount.name;
+        mount.state = c->state;
+        mount.bytesSent = c->bytesSent;
+        mount.reconnects = c->reconnects;
+        mount.lastError = c->lastError;
+        stats.mounts << mount;
+        stats.bytesSent += c->bytesSent;
+    }
+    stats.encoderLagMs = (lagFrames + encoderQueued) * 1000 / FxStreamTap::kSampleRate;
+
+    QMutexLocker locker(&m_statsMutex);
+    m_stats = stats;
+}
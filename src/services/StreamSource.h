@@ -0,0 +1,198 @@
+#ifndef STREAMSOURCE_H
+#define STREAMSOURCE_H
+
+#include <QObject>
+#include <QElapsedTimer>
+#include <QList>
+#include <QMutex>
+#include <QSet>
+#include <QString>
+#include <QThread>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "../audio/FxEncodeFanout.h"
+#include "../audio/FxEncoder.h"
+#include "../audio/FxStreamTap.h"
+
+class QTimer;
+class StreamSourceWorker;
+
+/**
+ * @brief One server mount the station streams to
+ */
+struct StreamMount {
+    enum Protocol { Icecast, Shoutcast };
+
+    QString name;                 // shown in the status and the log
+    Protocol protocol = Icecast;
+    QString host = QStringLiteral("localhost");
+    quint16 port = 8000;          // Shoutcast v1: the source port (base port + 1)
+    QString mount = QStringLiteral("/stream");   // Icecast only
+    QString user = QStringLiteral("source");     // Icecast only
+    QString password;
+    FxEncoder::Settings encoder;
+    QString streamName;
+    QString description;
+    QString genre;
+    QString url;
+    bool isPublic = false;
+};
+
+/**
+ * @brief In-process Icecast/Shoutcast source client
+ *
+ * Streams what is on air without an external encoder (butt) capturing the
+ * sound card: the FxEngine, or the shared mix bus when the decks play
+ * through one, pushes every finished output block into tap(). A worker
+ * thread drains the tap every 20 ms and sends it to the servers over plain
+ * sockets: Icecast 2.4+ with an HTTP PUT source request, Shoutcast v1 with
+ * its password/OK2 handshake.
+ *
+ * The audio is encoded once per distinct codec and bitrate, each encoder on
+ * a thread of its own (FxEncodeFanout), and the mounts that share a format
+ * share its output; an encoder that falls behind drops its own audio only.
+ *
+ * Each mount reconnects on its own, with a backoff from 1 s doubling up to
+ * a minute. An MP3 or AAC mount joins its running encoder; an Ogg mount
+ * restarts it so that it begins with the stream headers. A mount whose socket
+ * cannot take the data (more than 10 s queued) is dropped and reconnected
+ * rather than buffering without bound. While nothing plays the mounts are
+ * fed silence, so the servers keep the source.
+ *
+ * stats() is thread-safe.
+ *
+ * @example
+ * @code
+ * StreamSource* source = new StreamSource(
+ *     [ffmpeg](const FxEncoder::Settings& s, QString* error) { return FxEncoder::open(s, ffmpeg, error); },
+ *     this);
+ * player->setStreamTap(source->tap());
+ * source->start(StreamSource::loadMounts());
+ * @endcode
+ *
+ * @since XFB 2.0
+ */
+class StreamSource : public QObject
+{
+    Q_OBJECT
+
+public:
+    enum MountState { Stopped, Connecting, Streaming, Retrying };
+    Q_ENUM(MountState)
+
+    struct MountStats {
+        QString name;
+        MountState state = Stopped;
+        qint64 bytesSent = 0;
+        int reconnects = 0;
+        QString lastError;
+    };
+
+    struct EncoderStats {
+        FxEncoder::Settings settings;
+        qint64 lagMs = 0;
+        quint64 droppedFrames = 0;
+        qint64 cpuTimeUs = -1;
+    };
+
+    struct Stats {
+        qint64 bytesSent = 0;
+        qint64 encoderLagMs = 0;      // audio tapped but not yet encoded, slowest encoder
+        quint64 droppedFrames = 0;    // tap overruns plus frames the encoders dropped
+        QList<EncoderStats> encoders;
+        QList<MountStats> mounts;
+    };
+
+    using EncoderFactory = std::function<std::unique_ptr<FxEncoder>(const FxEncoder::Settings&, QString*)>;
+
+    explicit StreamSource(EncoderFactory encoderFactory, QObject* parent = nullptr);
+    ~StreamSource() override;
+
+    /**
+     * @brief The feed: hand it to FxPlayer::setStreamTap() or FxMixer::setStreamTap()
+     */
+    FxStreamTap* tap() { return &m_tap; }
+
+    /**
+     * @brief Connect to the mounts and start streaming; replaces a running set
+     */
+    void start(const QList<StreamMount>& mounts);
+
+    /**
+     * @brief Disconnect from every mount
+     */
+    void stop();
+
+    bool isRunning() const { return m_running; }
+
+    Stats stats() const;
+
+    /**
+     * @brief Mounts configured in xfb.conf ([Streaming] Mounts array)
+     */
+    static QList<StreamMount> loadMounts();
+
+signals:
+    void mountStateChanged(const QString& name, StreamSource::MountState state, const QString& detail);
+
+private:
+    FxStreamTap m_tap;
+    QThread m_thread;
+    StreamSourceWorker* m_worker = nullptr;
+    bool m_running = false;
+};
+
+/**
+ * @brief StreamSource's side on its own thread
+ */
+class StreamSourceWorker : public QObject
+{
+    Q_OBJECT
+
+public:
+    StreamSourceWorker(FxStreamTap* tap, StreamSource::EncoderFactory encoderFactory);
+    ~StreamSourceWorker() override;
+
+    void start(const QList<StreamMount>& mounts);
+    void stop();
+
+    StreamSource::Stats stats() const;
+
+signals:
+    void mountStateChanged(const QString& name, StreamSource::MountState state, const QString& detail);
+
+private:
+    struct Connection;
+
+    void pump();
+    void send(int lane);
+    void connectMount(Connection& c);
+    void onConnected(Connection& c);
+    void onReadyRead(Connection& c);
+    void beginStreaming(Connection& c);
+    void fail(Connection& c, const QString& error);
+    void closeSocket(Connection& c);
+    void setState(Connection& c, StreamSource::MountState state, const QString& detail = QString());
+    void updateStats(qint64 lagFrames);
+
+    FxStreamTap* m_tap;
+    FxEncodeFanout m_fanout;
+    QList<int> m_lanes;
+    QSet<int> m_failedLanes;        // encoder died; reopened when a mount next needs it
+    FxEncodeFanout::Output m_output;
+    std::vector<std::unique_ptr<Connection>> m_connections;
+    QTimer* m_pumpTimer = nullptr;
+    std::vector<float> m_buffer;
+
+    // Silence while the tap is dry, paced by the clock
+    QElapsedTimer m_clock;
+    qint64 m_lastAudioMs = 0;
+    qint64 m_paddedUntilMs = 0;
+
+    mutable QMutex m_statsMutex;
+    StreamSource::Stats m_stats;
+};
+
+#endif // STREAMSOURCE_H
@@ -0,0 +1,498 @@
+#include "TrackTrimmer.h"
+#include "DatabaseAccess.h"
+#include "FileSync.h"
+#include "../audio/WaveformScanner.h"
+#include <QCoreApplication>
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QHash>
+#include <QProcess>
+#include <QSqlError>
+#include <QSqlQuery>
+#include <QThread>
+#include <QDebug>
+
+#ifdef Q_OS_WIN
+#include <windows.h>
+#else
+#include <cstdio>
+#endif
+
+namespace {
+
+constexpr int kCutTimeoutMs = 10 * 60 * 1000;
+constexpr int kCancelPollMs = 200;
+
+// Peaks at or above this are sound: about 1% of full scale (-40 dBFS),
+// the threshold of the old sox trim
+constexpr int kSilencePeak = 3;
+// The peaks only see what lies below 2 kHz (WaveformScanner's decode
+// rate); a little slack keeps a bright attack or a cymbal decay
+constexpr qint64 kMarginMs = 2 * WaveformData::MsPerPeak;
+
+// Hidden, next to the original and with its extension, which tells
+// ffmpeg the format to write
+QString temporaryPath(const QString& path)
+{
+    const QFileInfo info(path);
+    return info.dir().filePath("." + info.completeBaseName() + ".trim." + info.suffix());
+}
+
+// One atomic step: the original is either still there or replaced whole
+bool replaceFile(const QString& from, const QString& to)
+{
+#ifdef Q_OS_WIN
+    return MoveFileExW(reinterpret_cast<const wchar_t*>(QDir::toNativeSeparators(from).utf16()),
+                       reinterpret_cast<const wchar_t*>(QDir::toNativeSeparators(to).utf16()),
+                       MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+#else
+    return std::rename(QFile::encodeName(from).constData(), QFile::encodeName(to).constData()) == 0;
+#endif
+}
+
+qint64 modificationTime(const QFileInfo& info)
+{
+    return info.lastModified().toMSecsSinceEpoch();
+}
+
+bool worthCutting(const TrackTrimmer::Trim& trim)
+{
+    return trim.headMs() >= TrackTrimmer::kMinRewriteMs || trim.tailMs() >= TrackTrimmer::kMinRewriteMs;
+}
+
+} // namespace
+
+TrackTrimmer::TrackTrimmer(const QSqlDatabase& database, Scanner scanner, Cutter cutter, QObject* parent)
+    : QObject(parent)
+    , m_databaseName(database.databaseName())
+    , m_driver(database.driverName())
+    , m_connectionName(QString("TrackTrimmer_%1").arg(quintptr(this), 0, 16))
+    , m_scanner(std::move(scanner))
+    , m_cutter(std::move(cutter))
+{
+    qRegisterMetaType<TrackTrimmer::Statistics>();
+
+    m_runPool.setMaxThreadCount(1);
+
+    m_progressTimer.setInterval(kProgressIntervalMs);
+    connect(&m_progressTimer, &QTimer::timeout, this, [this]() {
+        const Statistics stats = statistics();
+        emit progress(stats.done(), stats.total);
+    });
+}
+
+TrackTrimmer::~TrackTrimmer()
+{
+    cancel();
+    m_runPool.waitForDone();
+}
+
+bool TrackTrimmer::start(const Options& options)
+{
+    if (m_running) {
+        qWarning() << "TrackTrimmer: a run is already in progress";
+        return false;
+    }
+
+    m_options = options;
+    m_options.batchSize = qMax(1, options.batchSize);
+    m_workPool.setMaxThreadCount(options.workers > 0 ? options.workers : QThread::idealThreadCount());
+
+    m_cancelled = false;
+    m_total = 0;
+    m_analyzed = 0;
+    m_rewritten = 0;
+    m_failed = 0;
+    m_unchanged = 0;
+    m_silenceMs = 0;
+    m_elapsedMs = 0;
+
+    m_running = true;
+    const int run = ++m_run;
+    m_clock.start();
+    m_progressTimer.start();
+
+    m_runPool.start([this, run]() { this->run(run); });
+    return true;
+}
+
+void TrackTrimmer::cancel()
+{
+    m_cancelled = true;
+    m_resultReady.wakeAll();
+}
+
+bool TrackTrimmer::waitForFinished(int timeoutMs)
+{
+    if (!m_running)
+        return true;
+    if (!m_runPool.waitForDone(timeoutMs))
+        return false;
+
+    QCoreApplication::sendPostedEvents(this, QEvent::MetaCall);
+    finish(m_run);
+    return true;
+}
+
+TrackTrimmer::Statistics TrackTrimmer::statistics() const
+{
+    Statistics stats;
+    stats.total = m_total;
+    stats.analyzed = m_analyzed;
+    stats.rewritten = m_rewritten;
+    stats.failed = m_failed;
+    stats.unchanged = m_unchanged;
+    stats.silenceMs = m_silenceMs;
+    stats.elapsedMs = m_running ? m_clock.elapsed() : m_elapsedMs.load();
+    stats.cancelled = m_cancelled;
+    return stats;
+}
+
+bool TrackTrimmer::storedTrim(const QSqlDatabase& database, const QString& path, Trim* trim)
+{
+    QSqlQuery query(database);
+    query.prepare("SELECT start_ms, end_ms, duration_ms, size, mtime FROM track_trims WHERE path = ?");
+    query.addBindValue(path);
+    if (!query.exec() || !query.next())
+        return false;
+
+    const QFileInfo info(path);
+    if (query.value(3).toLongLong() != info.size() || query.value(4).toLongLong() != modificationTime(info))
+        return false;
+    trim->startMs = query.value(0).toLongLong();
+    trim->endMs = query.value(1).toLongLong();
+    trim->durationMs = query.value(2).toLongLong();
+    return true;
+}
+
+bool TrackTrimmer::storedCut(const QSqlDatabase& database, const QString& path, qint64* startMs,
+                             qint64* endMs)
+{
+    Trim trim;
+    if (!storedTrim(database, path, &trim))
+        return false;
+    *startMs = trim.headMs();
+    *endMs = trim.tailMs() > 0 ? trim.endMs : 0;
+    return true;
+}
+
+TrackTrimmer::Trim TrackTrimmer::findTrim(const WaveformData& data)
+{
+    Trim trim;
+    trim.durationMs = data.durationMs;
+    trim.endMs = data.durationMs;
+    const qint64 head = data.quietHeadMs(kSilencePeak);
+    if (head >= data.durationMs)
+        return trim;    // never gets loud: a quiet piece, not silence
+
+    trim.startMs = qMax(qint64(0), head - kMarginMs);
+    const qint64 tail = data.quietTailMs(kSilencePeak);
+    if (tail > 0)
+        trim.endMs = qMin(data.durationMs, data.durationMs - tail + kMarginMs);
+    return trim;
+}
+
+TrackTrimmer::Scanner TrackTrimmer::ffmpegScanner(const QString& ffmpeg)
+{
+    return [ffmpeg](const QString& path, const std::atomic<bool>& cancelled, WaveformData* data,
+                    QString* error) {
+        *data = WaveformScanner::scanFile(ffmpeg, path, &cancelled, error);
+        return !data->failed;
+    };
+}
+
+TrackTrimmer::Cutter TrackTrimmer::ffmpegCutter(const QString& ffmpeg)
+{
+    return [ffmpeg](const QString& source, const QString& output, const Trim& trim,
+                    const std::atomic<bool>& cancelled, QString* error) {
+        QStringList args;
+        args << "-nostdin" << "-y" << "-loglevel" << "error";
+        if (trim.headMs() > 0)
+            args << "-ss" << QString::number(trim.startMs / 1000.0, 'f', 3);
+        if (trim.tailMs() > 0)
+            args << "-to" << QString::number(trim.endMs / 1000.0, 'f', 3);
+        args << "-i" << source
+             << "-map" << "0" << "-map_metadata" << "0" << "-c" << "copy";
+        // Lossy audio is cut between its packets, never decoded; FLAC is
+        // cut to the sample and encoded again, still losslessly
+        if (QFileInfo(source).suffix().compare("flac", Qt::CaseInsensitive) == 0)
+            args << "-c:a" << "flac";
+        args << "-threads" << "1" << output;
+
+        QProcess process;
+        process.start(ffmpeg, args);
+        if (!process.waitForStarted()) {
+            *error = process.errorString();
+            return false;
+        }
+
+        QElapsedTimer clock;
+        clock.start();
+        while (!process.waitForFinished(kCancelPollMs)) {
+            if (process.state() == QProcess::NotRunning)
+                break;
+            if (cancelled || clock.elapsed() > kCutTimeoutMs) {
+                process.kill();
+                process.waitForFinished(1000);
+                *error = cancelled ? QCoreApplication::translate("TrackTrimmer", "Cancelled")
+                                   : QCoreApplication::translate("TrackTrimmer", "ffmpeg timed out");
+                return false;
+            }
+        }
+
+        if (process.exitStatus() != QProcess::NormalExit || process.exitCode() != 0) {
+            *error = QString::fromLocal8Bit(process.readAllStandardError()).trimmed();
+            if (error->isEmpty())
+                *error = QCoreApplication::translate("TrackTrimmer", "ffmpeg exited with code %1")
+                             .arg(process.exitCode());
+            return false;
+        }
+        return true;
+    };
+}
+
+void TrackTrimmer::run(int run)
+{
+    {
+        QSqlDatabase db = DatabaseAccess::openConnection(m_connectionName, m_driver, m_databaseName);
+        bool ok = db.isOpen();
+        QList<Job> jobs;
+        ok = ok && loadJobs(db, &jobs);
+
+        if (!ok) {
+            const QString error = tr("Could not read the library: %1").arg(db.lastError().text());
+            QMetaObject::invokeMethod(this, [this, error]() { emit trimError(error); }, Qt::QueuedConnection);
+        } else {
+            for (const Job& job : std::as_const(jobs))
+                m_workPool.start([this, job]() { process(job); });
+
+            // Finished files are written in batches, at least every
+            // kCommitIntervalMs so a slow run still saves its progress
+            QList<Result> batch;
+            QElapsedTimer sinceCommit;
+            sinceCommit.start();
+            int received = 0;
+            for (;;) {
+                bool idle = false;
+                {
+                    QMutexLocker locker(&m_resultMutex);
+                    if (m_results.isEmpty())
+                        m_resultReady.wait(&m_resultMutex, m_cancelled ? kCancelPollMs : kCommitIntervalMs);
+                    received += m_results.size();
+                    batch << m_results;
+                    m_results.clear();
+                    // A cancelled worker posts nothing
+                    idle = received == jobs.size() || (m_cancelled && m_workPool.activeThreadCount() == 0);
+                }
+                if (idle) {
+                    m_workPool.waitForDone();
+                    QMutexLocker locker(&m_resultMutex);
+                    batch << m_results;
+                    m_results.clear();
+                }
+                if (!batch.isEmpty()
+                    && (idle || batch.size() >= m_options.batchSize || sinceCommit.elapsed() >= kCommitIntervalMs)) {
+                    commit(db, batch);
+                    batch.clear();
+                    sinceCommit.restart();
+                }
+                if (idle)
+                    break;
+            }
+        }
+    }
+    DatabaseAccess::closeConnection(m_connectionName);
+
+    m_elapsedMs = m_clock.elapsed();
+    QMetaObject::invokeMethod(this, [this, run]() { finish(run); }, Qt::QueuedConnection);
+}
+
+bool TrackTrimmer::loadJobs(QSqlDatabase& db, QList<Job>* jobs)
+{
+    QSqlQuery query(db);
+    query.setForwardOnly(true);
+
+    // Trims of files that left the library are of no use any more
+    if (!query.exec("DELETE FROM track_trims WHERE path NOT IN (SELECT path FROM musics)"))
+        return false;
+
+    struct Stored {
+        Trim trim;
+        qint64 size = 0;
+        qint64 mtime = 0;
+    };
+    QHash<QString, Stored> stored;
+    if (!query.exec("SELECT path, start_ms, end_ms, duration_ms, size, mtime FROM track_trims"))
+        return false;
+    while (query.next()) {
+        Stored row;
+        row.trim.startMs = query.value(1).toLongLong();
+        row.trim.endMs = query.value(2).toLongLong();
+        row.trim.durationMs = query.value(3).toLongLong();
+        row.size = query.value(4).toLongLong();
+        row.mtime = query.value(5).toLongLong();
+        stored.insert(query.value(0).toString(), row);
+    }
+
+    QStringList paths;
+    if (!query.exec("SELECT DISTINCT path FROM musics"))
+        return false;
+    while (query.next())
+        paths << query.value(0).toString();
+    query.finish();
+
+    int missing = 0;
+    for (const QString& path : std::as_const(paths)) {
+        if (m_cancelled)
+            break;
+        const QFileInfo info(path);
+        if (!info.isFile()) {
+            ++missing;
+            continue;
+        }
+
+        Job job;
+        job.path = path;
+        const auto it = stored.constFind(path);
+        job.known = it != stored.constEnd() && it->size == info.size() && it->mtime == modificationTime(info);
+        if (job.known) {
+            job.trim = it->trim;
+            if (m_options.mode == Mode::Analyze || !worthCutting(job.trim)) {
+                ++m_unchanged;
+                continue;
+            }
+        }
+        *jobs << job;
+    }
+
+    if (missing > 0)
+        qWarning() << "TrackTrimmer:" << missing << "library files do not exist";
+    m_total += jobs->size() + missing;
+    m_failed += missing;
+    return true;
+}
+
+void TrackTrimmer::process(const Job& job)
+{
+    if (m_cancelled)
+        return;
+
+    Result result;
+    result.path = job.path;
+    result.trim = job.trim;
+    result.ok = job.known;
+
+    QString error;
+    if (!job.known) {
+        WaveformData data;
+        result.ok = m_scanner(job.path, m_cancelled, &data, &error);
+        if (!result.ok && m_cancelled)
+            return;     // scanned again next run
+        if (result.ok)
+            result.trim = findTrim(data);
+        else
+            result.error = error.isEmpty() ? tr("The file could not be decoded") : error;
+    }
+
+    if (result.ok)
+        result.silenceMs = result.trim.headMs() + result.trim.tailMs();
+
+    if (result.ok && m_options.mode == Mode::Rewrite && worthCutting(result.trim)) {
+        const QString temporary = temporaryPath(job.path);
+        QFile::remove(temporary);
+
+        // A cut that fails leaves the original as it was, its trim still stored
+        error.clear();
+        if (!m_cutter(job.path, temporary, result.trim, m_cancelled, &error)) {
+            QFile::remove(temporary);
+            if (m_cancelled && job.known)
+                return;     // nothing new to store
+            if (!m_cancelled)
+                result.error = error.isEmpty() ? tr("The file could not be cut") : error;
+        } else if (QFileInfo(temporary).size() <= 0 || !FileSync::syncFile(temporary)) {
+            QFile::remove(temporary);
+            result.error = tr("The cut file is missing or empty");
+        } else if (!replaceFile(temporary, job.path)) {
+            QFile::remove(temporary);
+            result.error = tr("Could not replace %1").arg(job.path);
+        } else {
+            const qint64 length = result.trim.endMs - result.trim.startMs;
+            result.trim = Trim{0, length, length};
+            result.rewritten = true;
+        }
+    }
+
+    if (!result.error.isEmpty())
+        qWarning() << "TrackTrimmer: could not trim" << job.path << "-" << result.error;
+
+    // Stamped after any rewrite, so the stored trim matches the file on disk
+    const QFileInfo info(job.path);
+    result.size = info.size();
+    result.mtime = modificationTime(info);
+
+    QMutexLocker locker(&m_resultMutex);
+    m_results << result;
+    m_resultReady.wakeOne();
+}
+
+bool TrackTrimmer::commit(QSqlDatabase& db, const QList<Result>& results)
+{
+    const qint64 now = QDateTime::currentMSecsSinceEpoch();
+    bool ok = db.transaction();
+    QSqlQuery store(db);
+    ok = ok && store.prepare("INSERT OR REPLACE INTO track_trims (path, start_ms, end_ms, duration_ms, size, mtime, updated) "
+                             "VALUES (?, ?, ?, ?, ?, ?, ?)");
+    for (const Result& result : results) {
+        if (!ok)
+            break;
+        if (!result.ok)
+            continue;
+        store.addBindValue(result.path);
+        store.addBindValue(result.trim.startMs);
+        store.addBindValue(result.trim.endMs);
+        store.addBindValue(result.trim.durationMs);
+        store.addBindValue(result.size);
+        store.addBindValue(result.mtime);
+        store.addBindValue(now);
+        ok = store.exec();
+    }
+    if (!ok || !db.commit()) {
+        qWarning() << "TrackTrimmer: could not commit a batch:" << store.lastError().text()
+                   << db.lastError().text();
+        db.rollback();
+        m_failed += results.size();
+        return false;
+    }
+
+    for (const Result& result : results) {
+        if (!result.error.isEmpty())
+            ++m_failed;
+        else if (result.rewritten)
+            ++m_rewritten;
+        else
+            ++m_analyzed;
+        if (result.ok)
+            m_silenceMs += result.silenceMs;
+    }
+    return true;
+}
+
+void TrackTrimmer::finish(int run)
+{
+    if (run != m_run || !m_running)
+        return;
+
+    m_progressTimer.stop();
+    m_running = false;
+
+    const Statistics stats = statistics();
+    qInfo() << "TrackTrimmer:" << stats.analyzed << "analyzed," << stats.rewritten << "rewritten,"
+            << stats.failed << "failed," << stats.unchanged << "unchanged of" << stats.total << "in"
+            << stats.elapsedMs << "ms," << stats.silenceMs / 1000 << "s of silence found"
+            << (stats.cancelled ? "(cancelled)" : "");
+
+    emit progress(stats.done(), stats.total);
+    emit finished(stats);
+}
@@ -0,0 +1,280 @@
+#ifndef TRACKTRIMMER_H
+#define TRACKTRIMMER_H
+
+#include <QObject>
+#include <QElapsedTimer>
+#include <QList>
+#include <QMutex>
+#include <QSqlDatabase>
+#include <QString>
+#include <QThreadPool>
+#include <QTimer>
+#include <QWaitCondition>
+#include <atomic>
+#include <functional>
+
+struct WaveformData;
+
+/**
+ * @brief Finds the silence at the head and tail of every library track
+ *
+ * Each file is decoded to the same low-rate peaks the waveform views draw
+ * (WaveformScanner) and scanned for the first and last stretch of sound
+ * above about 1% of full scale, as the old sox trim did. The result is a
+ * row of track_trims keyed by path and stamped with the file's size and
+ * modification time; the FX engine reads it to start and end the track
+ * where its audio does (FxPlayer::setTrimLookup), so nothing is rewritten.
+ * A run skips files whose stored trim is still current, which makes a
+ * cancelled or repeated run cheap.
+ *
+ * Files are only changed in Rewrite mode. Each cut is written next to the
+ * original under a hidden temporary name, synced and swapped in with one
+ * atomic rename; a cut that fails leaves the original untouched. Files
+ * are cut by copying their packets, so lossy audio is never re-encoded;
+ * FLAC is encoded again, losslessly, to cut it to the sample.
+ *
+ * Files run on a pool of workers, one per core by default; results are
+ * written in batched transactions.
+ *
+ * @example
+ * @code
+ * TrackTrimmer* trimmer = new TrackTrimmer(database, TrackTrimmer::ffmpegScanner(ffmpeg),
+ *                                          TrackTrimmer::ffmpegCutter(ffmpeg), this);
+ * trimmer->start(TrackTrimmer::Options());
+ * @endcode
+ *
+ * @since XFB 2.0
+ */
+class TrackTrimmer : public QObject
+{
+    Q_OBJECT
+
+public:
+    /**
+     * @brief Where the audio of a file starts and ends
+     */
+    struct Trim {
+        qint64 startMs = 0;
+        qint64 endMs = 0;         // just past the last sound
+        qint64 durationMs = 0;    // of the file as scanned
+
+        qint64 headMs() const { return startMs; }
+        qint64 tailMs() const { return durationMs - endMs; }
+    };
+
+    /**
+     * @brief Decodes path to waveform peaks; must be thread-safe
+     *
+     * Returns false with error set on failure. Should give up soon after
+     * cancelled becomes true.
+     */
+    using Scanner = std::function<bool(const QString& path, const std::atomic<bool>& cancelled,
+                                       WaveformData* data, QString* error)>;
+
+    /**
+     * @brief Writes source cut to trim into output; must be thread-safe
+     *
+     * output carries the source's extension. Returns false with error set
+     * on failure.
+     */
+    using Cutter = std::function<bool(const QString& source, const QString& output, const Trim& trim,
+                                      const std::atomic<bool>& cancelled, QString* error)>;
+
+    enum class Mode {
+        Analyze,    // store the trims only
+        Rewrite     // also cut the silence out of the files
+    };
+
+    /**
+     * @brief What to run
+     */
+    struct Options {
+        Mode mode = Mode::Analyze;
+        int workers = 0;          // 0 for QThread::idealThreadCount()
+        int batchSize = 200;      // files per transaction
+    };
+
+    /**
+     * @brief Outcome of a run
+     */
+    struct Statistics {
+        int total = 0;            // files this run set out to do
+        int analyzed = 0;         // trim stored, file left as it is
+        int rewritten = 0;        // cut (Rewrite mode)
+        int failed = 0;
+        int unchanged = 0;        // stored trim still current, nothing to do
+        qint64 silenceMs = 0;     // head and tail silence found
+        qint64 elapsedMs = 0;
+        bool cancelled = false;
+
+        int done() const { return analyzed + rewritten + failed; }
+    };
+
+    // Below this much silence at either end a file is not worth rewriting
+    static constexpr qint64 kMinRewriteMs = 250;
+
+    TrackTrimmer(const QSqlDatabase& database, Scanner scanner, Cutter cutter, QObject* parent = nullptr);
+    ~TrackTrimmer() override;
+
+    /**
+     * @brief Run over the library in the background
+     * @param options Run options
+     * @return false if a run is already in progress
+     */
+    bool start(const Options& options);
+
+    /**
+     * @brief Stop the run; files in progress are left as they were
+     */
+    void cancel();
+
+    /**
+     * @brief Check if a run is in progress
+     * @return true while files are being scanned
+     */
+    bool isRunning() const { return m_running; }
+
+    /**
+     * @brief Block until the run has finished
+     *
+     * Must be called from the trimmer's own thread; finished() has been
+     * emitted when this returns true.
+     *
+     * @param timeoutMs Timeout in milliseconds, -1 to wait forever
+     * @return true if no run is in progress any more
+     */
+    bool waitForFinished(int timeoutMs = -1);
+
+    /**
+     * @brief Current counters
+     * @return Statistics of the running or last run
+     */
+    Statistics statistics() const;
+
+    /**
+     * @brief Stored trim of a file, if it is still current
+     *
+     * Thread-safe for a connection owned by the calling thread.
+     *
+     * @param database Library database
+     * @param path File path
+     * @param trim Filled in when found
+     * @return false when there is none or the file changed since
+     */
+    static bool storedTrim(const QSqlDatabase& database, const QString& path, Trim* trim);
+
+    /**
+     * @brief Stored trim of a file as playback cues it (FxPlayer::TrimLookup)
+     *
+     * endMs is 0 when the file has no tail to cut: the peaks stop a few ms
+     * short of its end.
+     *
+     * @return false when there is no current trim
+     */
+    static bool storedCut(const QSqlDatabase& database, const QString& path, qint64* startMs,
+                          qint64* endMs);
+
+    /**
+     * @brief Head and tail silence of a waveform
+     * @param data Peaks of the whole file
+     * @return The trim; the whole file when it never gets loud
+     */
+    static Trim findTrim(const WaveformData& data);
+
+    /**
+     * @brief Scanner decoding with ffmpeg, as WaveformStore does
+     * @param ffmpeg Path of the ffmpeg executable
+     */
+    static Scanner ffmpegScanner(const QString& ffmpeg);
+
+    /**
+     * @brief Cutter running ffmpeg
+     *
+     * Packets are copied (no re-encoding) except for FLAC, which is
+     * re-encoded to FLAC; tags and cover art are kept.
+     *
+     * @param ffmpeg Path of the ffmpeg executable
+     */
+    static Cutter ffmpegCutter(const QString& ffmpeg);
+
+signals:
+    /**
+     * @brief Emitted at most every kProgressIntervalMs while running
+     * @param done Files scanned, cut or failed so far
+     * @param total Files in this run
+     */
+    void progress(int done, int total);
+
+    /**
+     * @brief Emitted when a run has finished or been cancelled
+     * @param statistics Final counters
+     */
+    void finished(const TrackTrimmer::Statistics& statistics);
+
+    /**
+     * @brief Emitted when a run cannot proceed
+     * @param error Error message
+     */
+    void trimError(const QString& error);
+
+private:
+    static constexpr int kProgressIntervalMs = 250;
+    static constexpr int kCommitIntervalMs = 1000;
+
+    struct Job {
+        QString path;
+        Trim trim;                // stored and current, else scanned first
+        bool known = false;
+    };
+
+    struct Result {
+        QString path;
+        Trim trim;
+        qint64 size = 0;
+        qint64 mtime = 0;
+        qint64 silenceMs = 0;     // found, before any rewrite
+        bool ok = false;          // trim known: store it
+        bool rewritten = false;
+        QString error;
+    };
+
+    void run(int run);
+    bool loadJobs(QSqlDatabase& db, QList<Job>* jobs);
+    void process(const Job& job);
+    bool commit(QSqlDatabase& db, const QList<Result>& results);
+    void finish(int run);
+
+    QString m_databaseName;
+    QString m_driver;
+    QString m_connectionName;
+    Scanner m_scanner;
+    Cutter m_cutter;
+
+    Options m_options;
+    int m_run = 0;
+
+    QThreadPool m_workPool;     // the files
+    QThreadPool m_runPool;      // the run itself, one at a time
+
+    // Finished files waiting for their batch
+    QMutex m_resultMutex;
+    QWaitCondition m_resultReady;
+    QList<Result> m_results;
+
+    std::atomic<bool> m_cancelled{false};
+    std::atomic<bool> m_running{false};
+    std::atomic<int> m_total{0};
+    std::atomic<int> m_analyzed{0};
+    std::atomic<int> m_rewritten{0};
+    std::atomic<int> m_failed{0};
+    std::atomic<int> m_unchanged{0};
+    std::atomic<qint64> m_silenceMs{0};
+    QElapsedTimer m_clock;
+    std::atomic<qint64> m_elapsedMs{0};
+
+    QTimer m_progressTimer;
+};
+
+Q_DECLARE_METATYPE(TrackTrimmer::Statistics)
+
+#endif // TRACKTRIMMER_H
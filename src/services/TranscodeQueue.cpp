@@ -0,0 +1,551 @@
+#include "TranscodeQueue.h"
+#include "DatabaseAccess.h"
+#include "FileSync.h"
+#include <QCoreApplication>
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QProcess>
+#include <QSet>
+#include <QSqlError>
+#include <QSqlQuery>
+#include <QThread>
+#include <QDebug>
+
+namespace {
+
+constexpr int kTranscodeTimeoutMs = 10 * 60 * 1000;
+constexpr int kCancelPollMs = 200;
+
+// Hidden, next to the target: the rename into place stays on one file system
+QString temporaryPath(const QString& target)
+{
+    const QFileInfo info(target);
+    return info.dir().filePath("." + info.fileName() + ".part");
+}
+
+TranscodeQueue::Format formatFromName(const QString& name)
+{
+    return name == QLatin1String("ogg") ? TranscodeQueue::Format::Ogg : TranscodeQueue::Format::Mp3;
+}
+
+} // namespace
+
+TranscodeQueue::TranscodeQueue(const QSqlDatabase& database, Transcoder transcoder, QObject* parent)
+    : QObject(parent)
+    , m_databaseName(database.databaseName())
+    , m_driver(database.driverName())
+    , m_connectionName(QString("TranscodeQueue_%1").arg(quintptr(this), 0, 16))
+    , m_transcoder(std::move(transcoder))
+{
+    qRegisterMetaType<TranscodeQueue::Statistics>();
+
+    m_runPool.setMaxThreadCount(1);
+
+    m_progressTimer.setInterval(kProgressIntervalMs);
+    connect(&m_progressTimer, &QTimer::timeout, this, [this]() {
+        const Statistics stats = statistics();
+        emit progress(stats.done(), stats.total);
+    });
+}
+
+TranscodeQueue::~TranscodeQueue()
+{
+    cancel();
+    m_runPool.waitForDone();
+}
+
+bool TranscodeQueue::start(const Options& options)
+{
+    if (m_running) {
+        qWarning() << "TranscodeQueue: a run is already in progress";
+        return false;
+    }
+
+    m_options = options;
+    m_options.batchSize = qMax(1, options.batchSize);
+    m_workPool.setMaxThreadCount(options.workers > 0 ? options.workers : QThread::idealThreadCount());
+
+    m_cancelled = false;
+    m_total = 0;
+    m_converted = 0;
+    m_failed = 0;
+    m_skipped = 0;
+    m_elapsedMs = 0;
+
+    m_running = true;
+    const int run = ++m_run;
+    m_clock.start();
+    m_progressTimer.start();
+
+    m_runPool.start([this, run]() { this->run(run); });
+    return true;
+}
+
+void TranscodeQueue::cancel()
+{
+    m_cancelled = true;
+    m_resultReady.wakeAll();
+}
+
+bool TranscodeQueue::waitForFinished(int timeoutMs)
+{
+    if (!m_running)
+        return true;
+    if (!m_runPool.waitForDone(timeoutMs))
+        return false;
+
+    QCoreApplication::sendPostedEvents(this, QEvent::MetaCall);
+    finish(m_run);
+    return true;
+}
+
+TranscodeQueue::Statistics TranscodeQueue::statistics() const
+{
+    Statistics stats;
+    stats.total = m_total;
+    stats.converted = m_converted;
+    stats.failed = m_failed;
+    stats.skipped = m_skipped;
+    stats.elapsedMs = m_running ? m_clock.elapsed() : m_elapsedMs.load();
+    stats.cancelled = m_cancelled;
+    return stats;
+}
+
+int TranscodeQueue::unfinishedJobs(const QSqlDatabase& database)
+{
+    QSqlQuery query(database);
+    query.prepare("SELECT COUNT(*) FROM transcode_jobs WHERE state IN (?, ?)");
+    query.addBindValue(int(JobState::Pending));
+    query.addBindValue(int(JobState::Renaming));
+    if (!query.exec() || !query.next())
+        return 0;
+    return query.value(0).toInt();
+}
+
+QString TranscodeQueue::extension(Format format)
+{
+    return format == Format::Ogg ? QStringLiteral("ogg") : QStringLiteral("mp3");
+}
+
+TranscodeQueue::Transcoder TranscodeQueue::ffmpegTranscoder(const QString& ffmpeg)
+{
+    return [ffmpeg](const QString& source, const QString& output, Format format,
+                    const std::atomic<bool>& cancelled, QString* error) {
+        QStringList args;
+        args << "-nostdin" << "-y" << "-loglevel" << "error"
+             << "-i" << source
+             << "-vn";
+        if (format == Format::Ogg)
+            args << "-c:a" << "libvorbis" << "-qscale:a" << "7" << "-f" << "ogg";
+        else
+            args << "-ar" << "44100" << "-ac" << "2" << "-b:a" << "192k" << "-f" << "mp3";
+        args << "-threads" << "1" << output;
+
+        QProcess process;
+        process.start(ffmpeg, args);
+        if (!process.waitForStarted()) {
+            *error = process.errorString();
+            return false;
+        }
+
+        QElapsedTimer clock;
+        clock.start();
+        while (!process.waitForFinished(kCancelPollMs)) {
+            if (process.state() == QProcess::NotRunning)
+                break;
+            if (cancelled || clock.elapsed() > kTranscodeTimeoutMs) {
+                process.kill();
+                process.waitForFinished(1000);
+                *error = cancelled ? QCoreApplication::translate("TranscodeQueue", "Cancelled")
+                                   : QCoreApplication::translate("TranscodeQueue", "ffmpeg timed out");
+                return false;
+            }
+        }
+
+        if (process.exitStatus() != QProcess::NormalExit || process.exitCode() != 0) {
+            *error = QString::fromLocal8Bit(process.readAllStandardError()).trimmed();
+            if (error->isEmpty())
+                *error = QCoreApplication::translate("TranscodeQueue", "ffmpeg exited with code %1")
+                             .arg(process.exitCode());
+            return false;
+        }
+        return true;
+    };
+}
+
+void TranscodeQueue::run(int run)
+{
+    {
+        QSqlDatabase db = DatabaseAccess::openConnection(m_connectionName, m_driver, m_databaseName);
+        bool ok = db.isOpen();
+        ok = ok && recover(db);
+        if (ok && m_options.enqueueLibrary)
+            ok = enqueueLibrary(db);
+
+        QList<Job> jobs;
+        QSqlQuery query(db);
+        query.setForwardOnly(true);
+        query.prepare("SELECT id, source, target, format FROM transcode_jobs WHERE state = ? ORDER BY id");
+        query.addBindValue(int(JobState::Pending));
+        ok = ok && query.exec();
+        while (ok && query.next()) {
+            Job job;
+            job.id = query.value(0).toLongLong();
+            job.source = query.value(1).toString();
+            job.target = query.value(2).toString();
+            job.format = formatFromName(query.value(3).toString());
+            jobs << job;
+        }
+        const QString readError = query.lastError().isValid() ? query.lastError().text()
+                                                              : db.lastError().text();
+        query.finish();
+
+        if (!ok) {
+            const QString error = tr("Could not read the conversion queue: %1").arg(readError);
+            QMetaObject::invokeMethod(this, [this, error]() { emit transcodeError(error); }, Qt::QueuedConnection);
+        } else {
+            m_total += jobs.size();
+            for (const Job& job : std::as_const(jobs))
+                m_workPool.start([this, job]() { convert(job); });
+
+            // Finished jobs are written in batches, at least every
+            // kCommitIntervalMs so a slow run still saves its progress
+            QList<Result> batch;
+            QElapsedTimer sinceCommit;
+            sinceCommit.start();
+            int received = 0;
+            for (;;) {
+                bool idle = false;
+                {
+                    QMutexLocker locker(&m_resultMutex);
+                    if (m_results.isEmpty())
+                        m_resultReady.wait(&m_resultMutex, m_cancelled ? kCancelPollMs : kCommitIntervalMs);
+                    received += m_results.size();
+                    batch << m_results;
+                    m_results.clear();
+                    // A cancelled worker leaves its job pending and posts nothing
+                    idle = received == jobs.size() || (m_cancelled && m_workPool.activeThreadCount() == 0);
+                }
+                if (idle) {
+                    m_workPool.waitForDone();
+                    QMutexLocker locker(&m_resultMutex);
+                    batch << m_results;
+                    m_results.clear();
+                }
+                if (!batch.isEmpty()
+                    && (idle || batch.size() >= m_options.batchSize || sinceCommit.elapsed() >= kCommitIntervalMs)) {
+                    if (moveIntoPlace(db, &batch))
+                        commit(db, batch);
+                    batch.clear();
+                    sinceCommit.restart();
+                }
+                if (idle)
+                    break;
+            }
+        }
+    }
+    DatabaseAccess::closeConnection(m_connectionName);
+
+    m_elapsedMs = m_clock.elapsed();
+    QMetaObject::invokeMethod(this, [this, run]() { finish(run); }, Qt::QueuedConnection);
+}
+
+bool TranscodeQueue::recover(QSqlDatabase& db)
+{
+    QSqlQuery query(db);
+
+    // Committed, but XFB stopped before the originals were deleted
+    query.prepare("SELECT source, target FROM transcode_jobs WHERE state = ?");
+    query.addBindValue(int(JobState::Done));
+    if (!query.exec())
+        return false;
+    QStringList leftovers;
+    while (query.next()) {
+        const QString source = query.value(0).toString();
+        if (source != query.value(1).toString() && QFileInfo::exists(source))
+            leftovers << source;
+    }
+    QSqlQuery referenced(db);
+    referenced.prepare("SELECT 1 FROM musics WHERE path = ? LIMIT 1");
+    for (const QString& source : std::as_const(leftovers)) {
+        referenced.addBindValue(source);
+        if (referenced.exec() && !referenced.next())
+            QFile::remove(source);
+        referenced.finish();
+    }
+    query.prepare("DELETE FROM transcode_jobs WHERE state = ?");
+    query.addBindValue(int(JobState::Done));
+    if (!query.exec())
+        return false;
+
+    // XFB stopped around a rename. The target is only ours if it is the
+    // very file recorded before the rename; anything else at that path was
+    // put there by someone else, and the job is converted again (and then
+    // fails on the taken name) rather than deleting its original.
+    query.prepare("SELECT id, source, target, format, output_size, output_mtime FROM transcode_jobs "
+                  "WHERE state = ?");
+    query.addBindValue(int(JobState::Renaming));
+    if (!query.exec())
+        return false;
+    QList<Result> finished;
+    while (query.next()) {
+        Result result;
+        result.job.id = query.value(0).toLongLong();
+        result.job.source = query.value(1).toString();
+        result.job.target = query.value(2).toString();
+        result.job.format = formatFromName(query.value(3).toString());
+        result.size = query.value(4).toLongLong();
+        result.mtime = query.value(5).toLongLong();
+        result.ok = true;
+        const QFileInfo target(result.job.target);
+        if (target.isFile() && target.size() == result.size
+            && target.lastModified().toMSecsSinceEpoch() == result.mtime)
+            finished << result;
+    }
+    query.finish();
+
+    if (!finished.isEmpty()) {
+        qInfo() << "TranscodeQueue: finishing" << finished.size() << "conversions of an interrupted run";
+        m_total += finished.size();
+        commit(db, finished);
+    }
+
+    // Renames that never happened, or whose file is not ours
+    query.prepare("UPDATE transcode_jobs SET state = ?, output_size = NULL, output_mtime = NULL WHERE state = ?");
+    query.addBindValue(int(JobState::Pending));
+    query.addBindValue(int(JobState::Renaming));
+    return query.exec();
+}
+
+bool TranscodeQueue::enqueueLibrary(QSqlDatabase& db)
+{
+    const QString ext = extension(m_options.format);
+
+    QStringList paths;
+    {
+        QSqlQuery query(db);
+        query.setForwardOnly(true);
+        if (!query.exec("SELECT DISTINCT path FROM musics"))
+            return false;
+        while (query.next())
+            paths << query.value(0).toString();
+    }
+
+    if (!db.transaction())
+        return false;
+
+    // A new conversion replaces whatever was queued before; recover() has
+    // already finished the jobs that were half done
+    QSqlQuery clear(db);
+    QSqlQuery insert(db);
+    insert.prepare("INSERT OR IGNORE INTO transcode_jobs (source, target, format, state, attempts, error, updated) "
+                   "VALUES (?, ?, ?, ?, 0, ?, ?)");
+    bool ok = clear.exec("DELETE FROM transcode_jobs");
+
+    const qint64 now = QDateTime::currentMSecsSinceEpoch();
+    QSet<QString> targets;
+    int failed = 0;
+    for (const QString& path : std::as_const(paths)) {
+        if (!ok)
+            break;
+        const QFileInfo info(path);
+        if (info.suffix().compare(ext, Qt::CaseInsensitive) == 0) {
+            ++m_skipped;
+            continue;
+        }
+
+        const QString target = info.dir().filePath(info.completeBaseName() + '.' + ext);
+        QString error;
+        if (!info.isFile())
+            error = tr("The file does not exist");
+        else if (targets.contains(target) || QFileInfo::exists(target))
+            error = tr("%1 already exists").arg(target);
+        targets.insert(target);
+
+        insert.addBindValue(path);
+        insert.addBindValue(target);
+        insert.addBindValue(ext);
+        insert.addBindValue(int(error.isEmpty() ? JobState::Pending : JobState::Failed));
+        insert.addBindValue(error.isEmpty() ? QVariant() : QVariant(error));
+        insert.addBindValue(now);
+        ok = insert.exec();
+        if (!error.isEmpty())
+            ++failed;
+    }
+
+    if (!ok || !db.commit()) {
+        qWarning() << "TranscodeQueue: could not queue the library:" << insert.lastError().text()
+                   << db.lastError().text();
+        db.rollback();
+        return false;
+    }
+    m_total += failed;
+    m_failed += failed;
+    return true;
+}
+
+void TranscodeQueue::convert(const Job& job)
+{
+    if (m_cancelled)
+        return;
+
+    Result result;
+    result.job = job;
+    const QString temporary = temporaryPath(job.target);
+    QFile::remove(temporary);
+
+    QString error;
+    if (!m_transcoder(job.source, temporary, job.format, m_cancelled, &error)) {
+        QFile::remove(temporary);
+        if (m_cancelled)
+            return;     // still pending, for the next run
+        result.error = error.isEmpty() ? tr("Conversion failed") : error;
+    } else if (QFileInfo(temporary).size() <= 0 || !FileSync::syncFile(temporary)) {
+        QFile::remove(temporary);
+        result.error = tr("The converted file is missing or empty");
+    } else {
+        // Renamed into place by moveIntoPlace() once this is on record
+        const QFileInfo info(temporary);
+        result.size = info.size();
+        result.mtime = info.lastModified().toMSecsSinceEpoch();
+        result.ok = true;
+    }
+
+    if (!result.ok)
+        qWarning() << "TranscodeQueue: could not convert" << job.source << "-" << result.error;
+
+    QMutexLocker locker(&m_resultMutex);
+    m_results << result;
+    m_resultReady.wakeOne();
+}
+
+bool TranscodeQueue::moveIntoPlace(QSqlDatabase& db, QList<Result>* results)
+{
+    // Each new file's size and mtime are committed before it is renamed: a
+    // rename keeps both, so recover() can tell the file from anything else
+    // found at the target later
+    bool ok = db.transaction();
+    QSqlQuery mark(db);
+    ok = ok && mark.prepare("UPDATE transcode_jobs SET state = ?, output_size = ?, output_mtime = ?, "
+                            "updated = ? WHERE id = ?");
+    const qint64 now = QDateTime::currentMSecsSinceEpoch();
+    for (const Result& result : std::as_const(*results)) {
+        if (!ok)
+            break;
+        if (!result.ok)
+            continue;
+        mark.addBindValue(int(JobState::Renaming));
+        mark.addBindValue(result.size);
+        mark.addBindValue(result.mtime);
+        mark.addBindValue(now);
+        mark.addBindValue(result.job.id);
+        ok = mark.exec();
+    }
+    if (!ok || !db.commit()) {
+        qWarning() << "TranscodeQueue: could not record a batch:" << mark.lastError().text()
+                   << db.lastError().text();
+        db.rollback();
+        // Nothing renamed: the jobs are still pending for the next run
+        for (const Result& result : std::as_const(*results))
+            QFile::remove(temporaryPath(result.job.target));
+        m_failed += results->size();
+        return false;
+    }
+
+    for (Result& result : *results) {
+        if (!result.ok)
+            continue;
+        const QString temporary = temporaryPath(result.job.target);
+        // QFile::rename never replaces: a target that turned up meanwhile stays
+        if (!QFile::rename(temporary, result.job.target)) {
+            QFile::remove(temporary);
+            result.ok = false;
+            result.error = tr("Could not move the converted file to %1").arg(result.job.target);
+            qWarning() << "TranscodeQueue: could not convert" << result.job.source << "-" << result.error;
+        }
+    }
+    return true;
+}
+
+bool TranscodeQueue::commit(QSqlDatabase& db, const QList<Result>& results)
+{
+    int converted = 0;
+    int failed = 0;
+    for (const Result& result : results)
+        result.ok ? ++converted : ++failed;
+
+    // The new paths and the job states in one transaction: on failure the
+    // jobs stay in Renaming and the next run's recover() finishes them
+    const qint64 now = QDateTime::currentMSecsSinceEpoch();
+    bool ok = db.transaction();
+    QSqlQuery movePath(db);
+    QSqlQuery updateJob(db);
+    ok = ok && movePath.prepare("UPDATE musics SET path = ? WHERE path = ?");
+    ok = ok && updateJob.prepare("UPDATE transcode_jobs SET state = ?, error = ?, attempts = attempts + 1, "
+                                 "updated = ? WHERE id = ?");
+    for (const Result& result : results) {
+        if (!ok)
+            break;
+        if (result.ok) {
+            movePath.addBindValue(result.job.target);
+            movePath.addBindValue(result.job.source);
+            ok = movePath.exec();
+        }
+        updateJob.addBindValue(int(result.ok ? JobState::Done : JobState::Failed));
+        updateJob.addBindValue(result.ok ? QVariant() : QVariant(result.error));
+        updateJob.addBindValue(now);
+        updateJob.addBindValue(result.job.id);
+        ok = ok && updateJob.exec();
+    }
+    if (!ok || !db.commit()) {
+        qWarning() << "TranscodeQueue: could not commit a batch:" << movePath.lastError().text()
+                   << updateJob.lastError().text() << db.lastError().text();
+        db.rollback();
+        m_failed += results.size();
+        return false;
+    }
+
+    // Only now can the originals go; then their jobs are done with
+    QList<qint64> done;
+    for (const Result& result : results) {
+        if (!result.ok)
+            continue;
+        if (result.job.source != result.job.target && QFileInfo::exists(result.job.source)
+            && !QFile::remove(result.job.source))
+            qWarning() << "TranscodeQueue: could not delete the original" << result.job.source;
+        done << result.job.id;
+    }
+    if (!done.isEmpty()) {
+        QSqlQuery forget(db);
+        forget.prepare("DELETE FROM transcode_jobs WHERE id = ?");
+        db.transaction();
+        for (qint64 id : std::as_const(done)) {
+            forget.addBindValue(id);
+            forget.exec();
+        }
+        db.commit();
+    }
+
+    m_converted += converted;
+    m_failed += failed;
+    return true;
+}
+
+void TranscodeQueue::finish(int run)
+{
+    if (run != m_run || !m_running)
+        return;
+
+    m_progressTimer.stop();
+    m_running = false;
+
+    const Statistics stats = statistics();
+    qInfo() << "TranscodeQueue:" << stats.converted << "converted," << stats.failed << "failed,"
+            << stats.skipped << "skipped of" << stats.total << "in" << stats.elapsedMs << "ms"
+            << (stats.cancelled ? "(cancelled)" : "");
+
+    emit progress(stats.done(), stats.total);
+    emit finished(stats);
+}
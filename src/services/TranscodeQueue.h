@@ -0,0 +1,230 @@
+#ifndef TRANSCODEQUEUE_H
+#define TRANSCODEQUEUE_H
+
+#include <QObject>
+#include <QElapsedTimer>
+#include <QList>
+#include <QMutex>
+#include <QSqlDatabase>
+#include <QString>
+#include <QThreadPool>
+#include <QTimer>
+#include <QWaitCondition>
+#include <atomic>
+#include <functional>
+
+/**
+ * @brief Converts library files to another format in the background
+ *
+ * Every file to convert is a row of transcode_jobs, so a conversion
+ * survives a restart: start() picks up whatever is still pending.
+ *
+ * Jobs run on a pool of workers, one per core by default, each converting
+ * one file at a time. A worker writes the new file next to the original
+ * under a hidden temporary name and syncs it. The run then records each
+ * new file's size and modification time (JobState::Renaming) before it
+ * renames the file into place, so the target is either complete or
+ * absent, and a job whose new file was already in place when XFB stopped
+ * is finished without converting it again. A file found at the target
+ * that does not match the record is never taken for a converted one. The
+ * new paths are written to musics together with the job states in
+ * batched transactions; an original is only deleted once its batch is
+ * committed.
+ *
+ * Files already in the target format are left alone. A file whose target
+ * name is taken fails instead of overwriting anything.
+ *
+ * @example
+ * @code
+ * TranscodeQueue* queue = new TranscodeQueue(database, TranscodeQueue::ffmpegTranscoder(ffmpeg), this);
+ * TranscodeQueue::Options options;
+ * options.enqueueLibrary = true;
+ * options.format = TranscodeQueue::Format::Mp3;
+ * queue->start(options);
+ * @endcode
+ *
+ * @since XFB 2.0
+ */
+class TranscodeQueue : public QObject
+{
+    Q_OBJECT
+
+public:
+    enum class Format { Mp3, Ogg };
+
+    /**
+     * @brief State of a row in transcode_jobs
+     */
+    enum class JobState { Pending = 0, Done = 1, Failed = 2, Renaming = 3 };
+
+    /**
+     * @brief Converts source into output; must be thread-safe
+     *
+     * Returns false with error set on failure. Should give up soon after
+     * cancelled becomes true.
+     */
+    using Transcoder = std::function<bool(const QString& source, const QString& output, Format format,
+                                          const std::atomic<bool>& cancelled, QString* error)>;
+
+    /**
+     * @brief What to run
+     */
+    struct Options {
+        bool enqueueLibrary = false;  // queue every musics row first
+        Format format = Format::Mp3;  // for enqueueLibrary; queued jobs keep theirs
+        int workers = 0;              // 0 for QThread::idealThreadCount()
+        int batchSize = 200;          // finished jobs per transaction
+    };
+
+    /**
+     * @brief Outcome of a run
+     */
+    struct Statistics {
+        int total = 0;            // jobs this run set out to do
+        int converted = 0;
+        int failed = 0;
+        int skipped = 0;          // already in the target format when queued
+        qint64 elapsedMs = 0;
+        bool cancelled = false;
+
+        int done() const { return converted + failed; }
+    };
+
+    TranscodeQueue(const QSqlDatabase& database, Transcoder transcoder, QObject* parent = nullptr);
+    ~TranscodeQueue() override;
+
+    /**
+     * @brief Run the queue in the background
+     * @param options Run options
+     * @return false if a run is already in progress
+     */
+    bool start(const Options& options);
+
+    /**
+     * @brief Stop the run; conversions in progress are abandoned and stay queued
+     */
+    void cancel();
+
+    /**
+     * @brief Check if a run is in progress
+     * @return true while jobs are being run
+     */
+    bool isRunning() const { return m_running; }
+
+    /**
+     * @brief Block until the run has finished
+     *
+     * Must be called from the queue's own thread; finished() has been
+     * emitted when this returns true.
+     *
+     * @param timeoutMs Timeout in milliseconds, -1 to wait forever
+     * @return true if no run is in progress any more
+     */
+    bool waitForFinished(int timeoutMs = -1);
+
+    /**
+     * @brief Current counters
+     * @return Statistics of the running or last run
+     */
+    Statistics statistics() const;
+
+    /**
+     * @brief Jobs left over from an earlier run
+     * @param database Library database
+     * @return Jobs still pending or being renamed into place
+     */
+    static int unfinishedJobs(const QSqlDatabase& database);
+
+    /**
+     * @brief File extension of format, without the dot
+     */
+    static QString extension(Format format);
+
+    /**
+     * @brief Transcoder running ffmpeg with XFB's usual settings
+     *
+     * MP3 at 192 kbps, 44.1 kHz stereo, or Ogg Vorbis at quality 7; audio
+     * only. Each ffmpeg is held to one thread, the pool provides the rest.
+     *
+     * @param ffmpeg Path of the ffmpeg executable
+     */
+    static Transcoder ffmpegTranscoder(const QString& ffmpeg);
+
+signals:
+    /**
+     * @brief Emitted at most every kProgressIntervalMs while running
+     * @param done Jobs converted or failed so far
+     * @param total Jobs in this run
+     */
+    void progress(int done, int total);
+
+    /**
+     * @brief Emitted when a run has finished or been cancelled
+     * @param statistics Final counters
+     */
+    void finished(const TranscodeQueue::Statistics& statistics);
+
+    /**
+     * @brief Emitted when a run cannot proceed
+     * @param error Error message
+     */
+    void transcodeError(const QString& error);
+
+private:
+    static constexpr int kProgressIntervalMs = 250;
+    static constexpr int kCommitIntervalMs = 1000;
+
+    struct Job {
+        qint64 id = 0;
+        QString source;
+        QString target;
+        Format format = Format::Mp3;
+    };
+
+    struct Result {
+        Job job;
+        bool ok = false;
+        qint64 size = 0;          // of the converted file
+        qint64 mtime = 0;
+        QString error;
+    };
+
+    void run(int run);
+    bool recover(QSqlDatabase& db);
+    bool enqueueLibrary(QSqlDatabase& db);
+    void convert(const Job& job);
+    bool moveIntoPlace(QSqlDatabase& db, QList<Result>* results);
+    bool commit(QSqlDatabase& db, const QList<Result>& results);
+    void finish(int run);
+
+    QString m_databaseName;
+    QString m_driver;
+    QString m_connectionName;
+    Transcoder m_transcoder;
+
+    Options m_options;
+    int m_run = 0;
+
+    QThreadPool m_workPool;     // the conversions
+    QThreadPool m_runPool;      // the run itself, one at a time
+
+    // Finished conversions waiting for their batch
+    QMutex m_resultMutex;
+    QWaitCondition m_resultReady;
+    QList<Result> m_results;
+
+    std::atomic<bool> m_cancelled{false};
+    std::atomic<bool> m_running{false};
+    std::atomic<int> m_total{0};
+    std::atomic<int> m_converted{0};
+    std::atomic<int> m_failed{0};
+    std::atomic<int> m_skipped{0};
+    QElapsedTimer m_clock;
+    std::atomic<qint64> m_elapsedMs{0};
+
+    QTimer m_progressTimer;
+};
+
+Q_DECLARE_METATYPE(TranscodeQueue::Statistics)
+
+#endif // TRANSCODEQUEUE_H
@@ -17,8 +17,21 @@ SOURCES += \
     main.cpp \
     player.cpp \
     audio/FxDsp.cpp \
+    audio/FrameRing.cpp \
+    audio/FxDecoder.cpp \
+    audio/FxOutput.cpp \
+    audio/FxMixer.cpp \
+    audio/FxStreamTap.cpp \
+    audio/FxEncoder.cpp \
+    audio/FxEncodeFanout.cpp \
+    audio/FxBlockPool.cpp \
     audio/FxEngine.cpp \
     audio/FxPlayer.cpp \
+    audio/FxRenderer.cpp \
+    audio/TrackAnalysisStore.cpp \
+    audio/TrackCue.cpp \
+    audio/WaveformData.cpp \
+    audio/WaveformScanner.cpp \
     audio/WaveformStore.cpp \
     PlaylistWaveView.cpp \
     LevelMeter.cpp \
@@ -47,7 +60,20 @@ SOURCES += \
     services/Logger.cpp \
     services/InputValidator.cpp \
     services/DatabaseOptimizer.cpp \
+    services/QueryProfiler.cpp \
     services/MusicCache.cpp \
+    services/LibraryImporter.cpp \
+    services/LibraryRescanner.cpp \
+    services/TranscodeQueue.cpp \
+    services/TrackTrimmer.cpp \
+    services/FileSync.cpp \
+    services/DatabaseAccess.cpp \
+    services/SchedulerEngine.cpp \
+    services/RotationEngine.cpp \
+    services/PlayLog.cpp \
+    services/RecordingSegmenter.cpp \
+    services/ProgramRecorder.cpp \
+    services/StreamSource.cpp \
     services/AccessibilityManager.cpp \
     services/AccessibilitySettingsService.cpp \
     services/BrailleDisplayService.cpp \
@@ -69,6 +95,7 @@ SOURCES += \
     repositories/GenreRepository.cpp \
     repositories/PlaylistRepository.cpp \
     repositories/DatabaseMigrator.cpp \
+    repositories/LibraryMigrations.cpp \
     services/TorNetworkService.cpp \
     services/TorrentSearchService.cpp \
     services/TorrentDownloadService.cpp \
@@ -79,8 +106,21 @@ HEADERS += \
     player.h \
     audio/FxParams.h \
     audio/FxDsp.h \
+    audio/FrameRing.h \
+    audio/FxDecoder.h \
+    audio/FxOutput.h \
+    audio/FxMixer.h \
+    audio/FxStreamTap.h \
+    audio/FxEncoder.h \
+    audio/FxEncodeFanout.h \
+    audio/FxBlockPool.h \
     audio/FxEngine.h \
     audio/FxPlayer.h \
+    audio/FxRenderer.h \
+    audio/TrackAnalysisStore.h \
+    audio/TrackCue.h \
+    audio/WaveformData.h \
+    audio/WaveformScanner.h \
     audio/WaveformStore.h \
     PlaylistWaveView.h \
     LevelMeter.h \
@@ -109,7 +149,20 @@ HEADERS += \
     services/Logger.h \
     services/InputValidator.h \
     services/DatabaseOptimizer.h \
+    services/QueryProfiler.h \
     services/MusicCache.h \
+    services/LibraryImporter.h \
+    services/LibraryRescanner.h \
+    services/TranscodeQueue.h \
+    services/TrackTrimmer.h \
+    services/FileSync.h \
+    services/DatabaseAccess.h \
+    services/SchedulerEngine.h \
+    services/RotationEngine.h \
+    services/PlayLog.h \
+    services/RecordingSegmenter.h \
+    services/ProgramRecorder.h \
+    services/StreamSource.h \
     services/AccessibilityManager.h \
     services/AccessibilitySettingsService.h \
     services/BrailleDisplayService.h \
@@ -132,6 +185,7 @@ HEADERS += \
     repositories/GenreRepository.h \
     repositories/PlaylistRepository.h \
     repositories/DatabaseMigrator.h \
+    repositories/LibraryMigrations.h \
     services/TorNetworkService.h \
     services/TorrentSearchService.h \
     services/TorrentDownloadService.h \
@@ -173,6 +227,15 @@ macx {
     QMAKE_MACOSX_DEPLOYMENT_TARGET = 10.15
 }
 
+# Optional in-process decoding for the FX engine: qmake CONFIG+=libav
+libav {
+    CONFIG += link_pkgconfig
+    PKGCONFIG += libavformat libavcodec libswresample libavutil
+    DEFINES += XFB_HAVE_LIBAV
+    SOURCES += audio/LibavDecoder.cpp audio/LibavEncoder.cpp
+    HEADERS += audio/LibavDecoder.h audio/LibavEncoder.h
+}
+
 contains(CONFIG, cross_compile) {
     include(cross_compile.pri)
 }
@@ -0,0 +1,304 @@
+#include "TestDatabaseContentionPerformance.h"
+#include "../../src/services/DatabaseAccess.h"
+#include "../../src/repositories/LibraryMigrations.h"
+
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QSqlDatabase>
+#include <QSqlError>
+#include <QSqlQuery>
+#include <QThread>
+
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <memory>
+
+namespace
+{
+struct Lane {
+    QVector<double> latenciesMs;
+    int failed = 0;
+
+    void add(const QElapsedTimer &clock) { latenciesMs.append(clock.nsecsElapsed() / 1e6); }
+};
+
+double percentile(QVector<double> values, double fraction)
+{
+    if (values.isEmpty())
+        return 0.0;
+    std::sort(values.begin(), values.end());
+    return values[std::min(int(values.size()) - 1, int(fraction * values.size()))];
+}
+
+void report(const char *name, const Lane &lane)
+{
+    qDebug().nospace() << "  " << name << ": " << lane.latenciesMs.size() << " ops, p50 "
+                       << percentile(lane.latenciesMs, 0.50) << " ms, p99 "
+                       << percentile(lane.latenciesMs, 0.99) << " ms, max "
+                       << percentile(lane.latenciesMs, 1.0) << " ms, failed " << lane.failed;
+}
+
+// What every connection looked like before DatabaseAccess
+QSqlDatabase openPlain(const QString &databaseName, const QString &connectionName)
+{
+    QSqlDatabase db = QSqlDatabase::addDatabase("QSQLITE", connectionName);
+    db.setDatabaseName(databaseName);
+    db.setConnectOptions("QSQLITE_BUSY_TIMEOUT=5000");
+    db.open();
+    return db;
+}
+
+QString seedPath(int i)
+{
+    return QString("/music/seed/%1.mp3").arg(i);
+}
+}
+
+void TestDatabaseContentionPerformance::initTestCase()
+{
+    QVERIFY(m_tempDir.isValid());
+}
+
+bool TestDatabaseContentionPerformance::createLibrary(const QString &databaseName)
+{
+    bool ok = true;
+    {
+        QSqlDatabase db = openPlain(databaseName, "contention_setup");
+        QSqlQuery query(db);
+        ok = db.isOpen()
+             && query.exec("CREATE TABLE musics (\"id\" INTEGER, \"artist\" VARCHAR NOT NULL, "
+                           "\"song\" VARCHAR NOT NULL, \"genre1\" VARCHAR NOT NULL, \"genre2\" VARCHAR, "
+                           "\"country\" VARCHAR, \"published_date\" VARCHAR, \"path\" TEXT, \"time\" TEXT, "
+                           "\"played_times\" INTEGER, \"last_played\" TEXT)")
+             && query.exec("CREATE TABLE scheduler (\"id\" INTEGER, \"ano\" INTEGER, \"mes\" INTEGER, "
+                           "\"dia\" INTEGER, \"hora\" INTEGER, \"min\" INTEGER, \"tipo\" INTEGER, "
+                           "\"week_day\" TEXT, \"start_ano\" INTEGER, \"start_mes\" INTEGER, "
+                           "\"start_dia\" INTEGER, \"end_ano\" INTEGER, \"end_mes\" INTEGER, "
+                           "\"end_dia\" INTEGER, \"is_program\" NULL)")
+             && query.exec("CREATE TABLE programs (\"id\" INTEGER PRIMARY KEY AUTOINCREMENT, "
+                           "\"name\" TEXT, \"path\" TEXT)")
+             && LibraryMigrations::apply(db);
+
+        ok = ok && db.transaction();
+        query.prepare("INSERT INTO musics (artist, song, genre1, genre2, country, published_date, "
+                      "path, time, played_times, last_played) VALUES (?, ?, ?, '', '', '', ?, '00:03:30', 0, '')");
+        for (int i = 0; ok && i < kLibraryRows; ++i) {
+            query.addBindValue(QString("Artist %1").arg(i % 500));
+            query.addBindValue(QString("Song %1").arg(i));
+            query.addBindValue(QString("Genre %1").arg(i % 20));
+            query.addBindValue(seedPath(i));
+            ok = query.exec();
+        }
+        for (int i = 0; ok && i < 200; ++i) {
+            ok = query.exec(QString("INSERT INTO scheduler VALUES (%1, 2026, 1, %2, %3, 0, 1, '', "
+                                    "2026, 1, 1, 2026, 12, 31, 1)")
+                                .arg(i % 50 + 1).arg(i % 28 + 1).arg(i % 24));
+        }
+        for (int i = 0; ok && i < 50; ++i)
+            ok = query.exec(QString("INSERT INTO programs (name, path) VALUES ('Program %1', "
+                                    "'/programs/%1.mp3')").arg(i));
+        ok = ok && db.commit();
+        if (!ok)
+            qWarning() << "Library setup failed:" << query.lastError().text();
+        query.finish();
+        db.close();
+    }
+    QSqlDatabase::removeDatabase("contention_setup");
+    return ok;
+}
+
+void TestDatabaseContentionPerformance::testImportSchedulerSearch_data()
+{
+    QTest::addColumn<bool>("tuned");
+    QTest::newRow("rollback journal, writes on the GUI thread") << false;
+    QTest::newRow("WAL, DatabaseAccess writer") << true;
+}
+
+void TestDatabaseContentionPerformance::testImportSchedulerSearch()
+{
+    QFETCH(bool, tuned);
+
+    const QString databaseName = m_tempDir.path() + QString("/adb_%1.db").arg(tuned ? "wal" : "rollback");
+    QVERIFY(createLibrary(databaseName));
+
+    std::unique_ptr<DatabaseAccess> access;
+    if (tuned) {
+        access = std::make_unique<DatabaseAccess>(databaseName);
+        QCOMPARE(DatabaseAccess::journalMode(access->connection()), QString("wal"));
+    }
+
+    // Each thread its own connection, as Qt requires either way
+    auto run = [&](const QString &name, const std::function<void(QSqlDatabase &)> &work) {
+        if (tuned) {
+            QSqlDatabase db = access->connection();
+            work(db);
+            return;
+        }
+        {
+            QSqlDatabase db = openPlain(databaseName, name);
+            work(db);
+            db.close();
+        }
+        QSqlDatabase::removeDatabase(name);
+    };
+
+    std::atomic<bool> importing{true};
+    Lane import, scheduler, search, playback;
+
+    QThread *importer = QThread::create([&]() {
+        run("contention_import", [&](QSqlDatabase &db) {
+            QSqlQuery insert(db);
+            insert.prepare("INSERT INTO musics (artist, song, genre1, genre2, country, published_date, "
+                           "path, time, played_times, last_played) VALUES (?, ?, ?, '', '', '', ?, '00:03:30', 0, '')");
+            for (int b = 0; b < kImportBatches; ++b) {
+                QElapsedTimer clock;
+                clock.start();
+                bool ok = db.transaction();
+                for (int i = 0; ok && i < kImportBatchSize; ++i) {
+                    insert.addBindValue(QString("Imported %1").arg(b));
+                    insert.addBindValue(QString("Track %1").arg(i));
+                    insert.addBindValue("Imported");
+                    insert.addBindValue(QString("/music/import/%1/%2.mp3").arg(b).arg(i));
+                    ok = insert.exec();
+                }
+                insert.finish();
+                if (!(ok && db.commit())) {
+                    db.rollback();
+                    ++import.failed;
+                }
+                import.add(clock);
+            }
+        });
+        importing = false;
+    });
+
+    QThread *schedulerThread = QThread::create([&]() {
+        run("contention_scheduler", [&](QSqlDatabase &db) {
+            // run_scheduler: the whole table, then the path of what is due
+            QSqlQuery rules(db);
+            QSqlQuery path(db);
+            path.prepare("SELECT path FROM programs WHERE id=?");
+            int n = 0;
+            while (importing) {
+                QElapsedTimer clock;
+                clock.start();
+                bool ok = rules.exec("select * from scheduler");
+                while (ok && rules.next()) {
+                }
+                rules.finish();
+                path.addBindValue(++n % 50 + 1);
+                ok = ok && path.exec() && path.next();
+                path.finish();
+                if (!ok)
+                    ++scheduler.failed;
+                scheduler.add(clock);
+                QThread::msleep(kSchedulerIntervalMs);
+            }
+        });
+    });
+
+    QThread *searchThread = QThread::create([&]() {
+        run("contention_search", [&](QSqlDatabase &db) {
+            QSqlQuery query(db);
+            query.prepare("SELECT musics.rowid, artist, song FROM musics JOIN "
+                          "(SELECT rowid AS hit FROM musics_fts WHERE musics_fts MATCH ? LIMIT 200) "
+                          "ON musics.rowid = hit");
+            int n = 0;
+            while (importing) {
+                QElapsedTimer clock;
+                clock.start();
+                query.addBindValue(QString("song %1*").arg(++n % 100));
+                bool ok = query.exec();
+                while (ok && query.next()) {
+                }
+                query.finish();
+                if (!ok)
+                    ++search.failed;
+                search.add(clock);
+                QThread::msleep(5);
+            }
+        });
+    });
+
+    QElapsedTimer total;
+    total.start();
+    importer->start();
+    schedulerThread->start();
+    searchThread->start();
+
+    // Playback, on this (the GUI) thread: one finished track per interval
+    int updates = 0;
+    {
+        QSqlDatabase gui;
+        if (!tuned)
+            gui = openPlain(databaseName, "contention_gui");
+        while (importing) {
+            const QString path = seedPath(updates % kLibraryRows);
+            QElapsedTimer clock;
+            clock.start();
+            if (tuned) {
+                access->write("update musics set last_played = ?, played_times = played_times+1 where path = ?",
+                              {QString("2026-01-01 || 12:00:00"), path});
+            } else {
+                QSqlQuery qry(gui);
+                qry.prepare("update musics set last_played = ?, played_times = played_times+1 where path = ?");
+                qry.addBindValue(QString("2026-01-01 || 12:00:00"));
+                qry.addBindValue(path);
+                if (!qry.exec())
+                    ++playback.failed;
+            }
+            playback.add(clock);
+            ++updates;
+            QThread::msleep(kPlaybackIntervalMs);
+        }
+        gui.close();
+    }
+    if (!tuned)
+        QSqlDatabase::removeDatabase("contention_gui");
+
+    for (QThread *thread : {importer, schedulerThread, searchThread}) {
+        QVERIFY(thread->wait(60000));
+        delete thread;
+    }
+
+    if (tuned) {
+        QVERIFY(access->flush(10000));
+        playback.failed += int(access->statistics().failed);
+    }
+    const qint64 elapsedMs = total.elapsed();
+
+    qDebug() << (tuned ? "WAL, DatabaseAccess writer:" : "Rollback journal, GUI-thread writes:")
+             << kImportBatches * kImportBatchSize << "rows imported in" << elapsedMs << "ms";
+    report("import batch", import);
+    report("scheduler poll", scheduler);
+    report("search", search);
+    report("playback update (GUI thread)", playback);
+
+    QCOMPARE(import.failed, 0);
+
+    // Every play was counted, whichever way it was written
+    int played = -1;
+    {
+        QSqlDatabase db = openPlain(databaseName, "contention_check");
+        QSqlQuery query(db);
+        if (query.exec("SELECT SUM(played_times) FROM musics") && query.next())
+            played = query.value(0).toInt();
+        query.finish();
+        db.close();
+    }
+    QSqlDatabase::removeDatabase("contention_check");
+    QCOMPARE(played + playback.failed, updates);
+
+    if (tuned) {
+        // Readers work from a snapshot and the GUI only queues its update
+        QCOMPARE(scheduler.failed, 0);
+        QCOMPARE(search.failed, 0);
+        QCOMPARE(playback.failed, 0);
+        QVERIFY2(percentile(playback.latenciesMs, 1.0) < 50.0,
+                 qPrintable(QString("playback update blocked the GUI thread for %1 ms")
+                                .arg(percentile(playback.latenciesMs, 1.0))));
+    }
+}
+
+QTEST_MAIN(TestDatabaseContentionPerformance)
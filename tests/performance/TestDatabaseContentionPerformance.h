@@ -0,0 +1,41 @@
+#ifndef TESTDATABASECONTENTIONPERFORMANCE_H
+#define TESTDATABASECONTENTIONPERFORMANCE_H
+
+#include <QObject>
+#include <QTest>
+#include <QTemporaryDir>
+
+/**
+ * @brief Library database contention: an import against the on-air path
+ *
+ * A bulk import commits 500-row batches while the scheduler polls its
+ * table, the library search runs full-text queries and playback bumps
+ * played_times after every track, all at once. The benchmark runs this
+ * with the old setup (rollback journal, synchronous statements on the
+ * GUI thread) and with DatabaseAccess (WAL, per-thread connections,
+ * queued writes), and reports p50/p99/max latency of each lane. With
+ * DatabaseAccess the playback update must never block and no query may
+ * fail on a lock.
+ */
+class TestDatabaseContentionPerformance : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void testImportSchedulerSearch_data();
+    void testImportSchedulerSearch();
+
+private:
+    bool createLibrary(const QString& databaseName);
+
+    QTemporaryDir m_tempDir;
+
+    static constexpr int kLibraryRows = 20000;
+    static constexpr int kImportBatches = 40;
+    static constexpr int kImportBatchSize = 500;
+    static constexpr int kSchedulerIntervalMs = 20;
+    static constexpr int kPlaybackIntervalMs = 25;
+};
+
+#endif // TESTDATABASECONTENTIONPERFORMANCE_H
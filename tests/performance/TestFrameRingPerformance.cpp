@@ -0,0 +1,77 @@
+#include "TestFrameRingPerformance.h"
+#include "../../src/audio/FrameRing.h"
+
+#include <QDebug>
+#include <QElapsedTimer>
+
+#include <vector>
+
+namespace
+{
+// One pump of the pre-ring engine: front-erase a chunk off a vector FIFO,
+// then refill the same amount at the back
+qint64 vectorPumpNs(size_t bufferedFrames, int chunkFrames, int pumps)
+{
+    std::vector<float> fifo(bufferedFrames * 2, 0.25f);
+    std::vector<float> chunk(static_cast<size_t>(chunkFrames) * 2);
+    std::vector<float> refill(static_cast<size_t>(chunkFrames) * 2, 0.5f);
+
+    QElapsedTimer timer;
+    timer.start();
+    for (int p = 0; p < pumps; ++p) {
+        std::copy(fifo.begin(), fifo.begin() + chunkFrames * 2, chunk.begin());
+        fifo.erase(fifo.begin(), fifo.begin() + chunkFrames * 2);
+        fifo.insert(fifo.end(), refill.begin(), refill.end());
+    }
+    return timer.nsecsElapsed() / pumps;
+}
+
+qint64 ringPumpNs(size_t bufferedFrames, int chunkFrames, int pumps)
+{
+    FrameRing ring(2);
+    ring.reset(bufferedFrames + static_cast<size_t>(chunkFrames));
+    std::vector<float> prime(bufferedFrames * 2, 0.25f);
+    ring.write(prime.data(), bufferedFrames);
+    std::vector<float> chunk(static_cast<size_t>(chunkFrames) * 2);
+    std::vector<float> refill(static_cast<size_t>(chunkFrames) * 2, 0.5f);
+
+    QElapsedTimer timer;
+    timer.start();
+    for (int p = 0; p < pumps; ++p) {
+        ring.read(chunk.data(), static_cast<size_t>(chunkFrames));
+        ring.write(refill.data(), static_cast<size_t>(chunkFrames));
+    }
+    return timer.nsecsElapsed() / pumps;
+}
+} // namespace
+
+void TestFrameRingPerformance::testPumpCostIsFlat_data()
+{
+    QTest::addColumn<int>("bufferedSeconds");
+    QTest::newRow("1 s") << 1;
+    QTest::newRow("5 s") << 5;
+    QTest::newRow("12 s") << 12;
+    QTest::newRow("30 s") << 30;
+}
+
+void TestFrameRingPerformance::testPumpCostIsFlat()
+{
+    QFETCH(int, bufferedSeconds);
+
+    const size_t buffered = static_cast<size_t>(bufferedSeconds) * kSampleRate;
+    const qint64 baselineRing = ringPumpNs(kSampleRate, kChunkFrames, kPumps);
+    const qint64 ringNs = ringPumpNs(buffered, kChunkFrames, kPumps);
+    const qint64 vectorNs = vectorPumpNs(buffered, kChunkFrames, kPumps / 10);
+
+    qDebug() << "buffered" << bufferedSeconds << "s:"
+             << "ring" << ringNs << "ns/pump,"
+             << "vector erase" << vectorNs << "ns/pump";
+
+    // The ring does the same fixed amount of work per pump regardless of
+    // the backlog; generous slack absorbs cache effects and noisy CI hosts.
+    QVERIFY2(ringNs <= baselineRing * 4 + 20000,
+             QString("ring pump cost grew from %1 ns to %2 ns")
+                 .arg(baselineRing).arg(ringNs).toLocal8Bit());
+}
+
+QTEST_MAIN(TestFrameRingPerformance)
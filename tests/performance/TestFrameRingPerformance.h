@@ -0,0 +1,29 @@
+#ifndef TESTFRAMERINGPERFORMANCE_H
+#define TESTFRAMERINGPERFORMANCE_H
+
+#include <QObject>
+#include <QTest>
+
+/**
+ * @brief Per-pump cost of the FxEngine FrameRing
+ *
+ * The benchmark replays the engine's pump pattern (decoder burst in,
+ * one 2048-frame chunk out) at growing buffered durations and checks that
+ * the ring's cost stays flat while the old vector front-erase grows with
+ * the backlog.
+ */
+class TestFrameRingPerformance : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void testPumpCostIsFlat_data();
+    void testPumpCostIsFlat();
+
+private:
+    static constexpr int kSampleRate = 48000;
+    static constexpr int kChunkFrames = 2048;
+    static constexpr int kPumps = 2000;
+};
+
+#endif // TESTFRAMERINGPERFORMANCE_H
@@ -0,0 +1,207 @@
+#include "TestFxDecoderPerformance.h"
+#include "../../src/audio/FrameRing.h"
+#include "../../src/audio/FxDecoder.h"
+#ifdef XFB_HAVE_LIBAV
+#include "../../src/audio/LibavDecoder.h"
+#endif
+
+#include <QDataStream>
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QProcess>
+#include <QStandardPaths>
+
+#include <cmath>
+
+namespace
+{
+// Stereo 16-bit PCM WAV whose left channel is a ramp: sample n carries
+// (n % 30000), so any decoded frame tells exactly where it came from.
+bool writeRampWav(const QString &path, int sampleRate, int seconds)
+{
+    QFile f(path);
+    if (!f.open(QIODevice::WriteOnly))
+        return false;
+    const quint32 frames = quint32(sampleRate) * quint32(seconds);
+    const quint32 dataBytes = frames * 4;
+
+    QDataStream out(&f);
+    out.setByteOrder(QDataStream::LittleEndian);
+    out.writeRawData("RIFF", 4);
+    out << quint32(36 + dataBytes);
+    out.writeRawData("WAVEfmt ", 8);
+    out << quint32(16) << quint16(1) << quint16(2) << quint32(sampleRate)
+        << quint32(sampleRate * 4) << quint16(4) << quint16(16);
+    out.writeRawData("data", 4);
+    out << dataBytes;
+    for (quint32 n = 0; n < frames; ++n)
+        out << qint16(n % 30000) << qint16(0);
+    return out.status() == QDataStream::Ok;
+}
+} // namespace
+
+void TestFxDecoderPerformance::initTestCase()
+{
+    QVERIFY(m_tempDir.isValid());
+    m_wavPath = m_tempDir.filePath(QStringLiteral("ramp.wav"));
+    QVERIFY(writeRampWav(m_wavPath, kSampleRate, kFileSeconds));
+    m_ffmpeg = QStandardPaths::findExecutable(QStringLiteral("ffmpeg"));
+}
+
+std::unique_ptr<FxDecoder> TestFxDecoderPerformance::startProcess(qint64 positionMs)
+{
+    // Same output format as FxEngine::spawnDecoder, without the -re pacing
+    QStringList args{"-nostdin", "-loglevel", "error"};
+    if (positionMs > 0)
+        args << "-ss" << QString::number(positionMs / 1000.0, 'f', 3);
+    args << "-i" << m_wavPath << "-vn" << "-f" << "f32le" << "-acodec" << "pcm_f32le"
+         << "-ac" << QString::number(kChannels) << "-ar" << QString::number(kSampleRate) << "-";
+    auto *proc = new QProcess(&m_processParent);
+    proc->setReadChannel(QProcess::StandardOutput);
+    proc->start(m_ffmpeg, args);
+    return std::make_unique<ProcessDecoder>(proc);
+}
+
+qint64 TestFxDecoderPerformance::timeToFirstFrames(FxDecoder &decoder)
+{
+    FrameRing ring(kChannels);
+    ring.reset(kSampleRate);
+    QElapsedTimer timer;
+    timer.start();
+    while (ring.isEmpty() && !decoder.exhausted() && timer.elapsed() < 10000) {
+        if (auto *p = dynamic_cast<ProcessDecoder *>(&decoder))
+            p->process()->waitForReadyRead(5);
+        decoder.drainInto(ring);
+    }
+    return timer.nsecsElapsed();
+}
+
+qint64 TestFxDecoderPerformance::decodeAll(FxDecoder &decoder)
+{
+    FrameRing ring(kChannels);
+    ring.reset(kSampleRate);
+    qint64 frames = 0;
+    QElapsedTimer guard;
+    guard.start();
+    while (!decoder.exhausted() && guard.elapsed() < 60000) {
+        if (auto *p = dynamic_cast<ProcessDecoder *>(&decoder))
+            p->process()->waitForReadyRead(5);
+        decoder.drainInto(ring);
+        frames += qint64(ring.discard(ring.availableFrames()));
+    }
+    return frames;
+}
+
+qint64 TestFxDecoderPerformance::perHourMs(qint64 elapsedNs)
+{
+    return elapsedNs * 3600 / kFileSeconds / 1000000;
+}
+
+void TestFxDecoderPerformance::testProcessColdStart()
+{
+    if (m_ffmpeg.isEmpty())
+        QSKIP("ffmpeg not installed");
+    auto decoder = startProcess(0);
+    const qint64 ns = timeToFirstFrames(*decoder);
+    qDebug() << "ffmpeg pipe cold start:" << ns / 1000 << "us";
+    QVERIFY(!decoder->failed());
+}
+
+void TestFxDecoderPerformance::testProcessSeekLatency()
+{
+    if (m_ffmpeg.isEmpty())
+        QSKIP("ffmpeg not installed");
+    // The pipe path seeks by respawning at -ss
+    auto decoder = startProcess(61234);
+    const qint64 ns = timeToFirstFrames(*decoder);
+    qDebug() << "ffmpeg pipe seek (respawn):" << ns / 1000 << "us";
+}
+
+void TestFxDecoderPerformance::testProcessDecodeCostPerHour()
+{
+    if (m_ffmpeg.isEmpty())
+        QSKIP("ffmpeg not installed");
+    auto decoder = startProcess(0);
+    QElapsedTimer timer;
+    timer.start();
+    const qint64 frames = decodeAll(*decoder);
+    const qint64 ns = timer.nsecsElapsed();
+    qDebug() << "ffmpeg pipe: decode + pipe cost" << perHourMs(ns) << "ms per hour of audio";
+    QCOMPARE(frames, qint64(kSampleRate) * kFileSeconds);
+}
+
+void TestFxDecoderPerformance::testLibavColdStart()
+{
+#ifdef XFB_HAVE_LIBAV
+    QElapsedTimer timer;
+    timer.start();
+    QString error;
+    auto decoder = LibavDecoder::open(m_wavPath, 0, kSampleRate, kChannels, &error);
+    QVERIFY2(decoder, qPrintable(error));
+    const qint64 ns = timer.nsecsElapsed() + timeToFirstFrames(*decoder);
+    qDebug() << "libav in-process cold start:" << ns / 1000 << "us";
+#else
+    QSKIP("built without XFB_HAVE_LIBAV");
+#endif
+}
+
+void TestFxDecoderPerformance::testLibavSeekLatency()
+{
+#ifdef XFB_HAVE_LIBAV
+    QString error;
+    auto decoder = LibavDecoder::open(m_wavPath, 0, kSampleRate, kChannels, &error);
+    QVERIFY2(decoder, qPrintable(error));
+    QElapsedTimer timer;
+    timer.start();
+    QVERIFY(decoder->seek(61234));
+    const qint64 ns = timer.nsecsElapsed() + timeToFirstFrames(*decoder);
+    qDebug() << "libav in-process seek:" << ns / 1000 << "us";
+#else
+    QSKIP("built without XFB_HAVE_LIBAV");
+#endif
+}
+
+void TestFxDecoderPerformance::testLibavSeekIsSampleAccurate()
+{
+#ifdef XFB_HAVE_LIBAV
+    QString error;
+    auto decoder = LibavDecoder::open(m_wavPath, 0, kSampleRate, kChannels, &error);
+    QVERIFY2(decoder, qPrintable(error));
+
+    const qint64 positions[] = {1, 1000, 33333, 61234, 119000};
+    for (qint64 ms : positions) {
+        QVERIFY(decoder->seek(ms));
+        FrameRing ring(kChannels);
+        ring.reset(4096);
+        while (ring.isEmpty() && !decoder->exhausted())
+            decoder->drainInto(ring);
+        QVERIFY(!ring.isEmpty());
+        const qint64 expectedFrame = ms * kSampleRate / 1000;
+        const float expected = float(expectedFrame % 30000) / 32768.0f;
+        QVERIFY2(std::fabs(ring.frame(0)[0] - expected) < 1e-4f,
+                 qPrintable(QString("seek to %1 ms landed on the wrong frame").arg(ms)));
+    }
+#else
+    QSKIP("built without XFB_HAVE_LIBAV");
+#endif
+}
+
+void TestFxDecoderPerformance::testLibavDecodeCostPerHour()
+{
+#ifdef XFB_HAVE_LIBAV
+    QString error;
+    auto decoder = LibavDecoder::open(m_wavPath, 0, kSampleRate, kChannels, &error);
+    QVERIFY2(decoder, qPrintable(error));
+    QElapsedTimer timer;
+    timer.start();
+    const qint64 frames = decodeAll(*decoder);
+    const qint64 ns = timer.nsecsElapsed();
+    qDebug() << "libav in-process: decode cost" << perHourMs(ns) << "ms per hour of audio";
+    QCOMPARE(frames, qint64(kSampleRate) * kFileSeconds);
+#else
+    QSKIP("built without XFB_HAVE_LIBAV");
+#endif
+}
+
+QTEST_MAIN(TestFxDecoderPerformance)
@@ -0,0 +1,54 @@
+#ifndef TESTFXDECODERPERFORMANCE_H
+#define TESTFXDECODERPERFORMANCE_H
+
+#include <QObject>
+#include <QTemporaryDir>
+#include <QTest>
+
+#include <memory>
+
+class FxDecoder;
+
+/**
+ * @brief Decoder backend comparison for the FX engine
+ *
+ * Benchmarks the ffmpeg CLI pipe (ProcessDecoder) against the in-process
+ * libav decoder (LibavDecoder, only when built with XFB_HAVE_LIBAV) on a
+ * generated test file: cold start to first PCM, seek latency and decode
+ * time per hour of audio. Also checks the libav seek is sample-accurate.
+ */
+class TestFxDecoderPerformance : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+
+    void testProcessColdStart();
+    void testProcessSeekLatency();
+    void testProcessDecodeCostPerHour();
+
+    void testLibavColdStart();
+    void testLibavSeekLatency();
+    void testLibavSeekIsSampleAccurate();
+    void testLibavDecodeCostPerHour();
+
+private:
+    std::unique_ptr<FxDecoder> startProcess(qint64 positionMs);
+    /** Pump a decoder until it produced its first frames; returns ns taken. */
+    static qint64 timeToFirstFrames(FxDecoder &decoder);
+    /** Decode everything as fast as possible; returns frames decoded. */
+    static qint64 decodeAll(FxDecoder &decoder);
+    static qint64 perHourMs(qint64 elapsedNs);
+
+    QTemporaryDir m_tempDir;
+    QString m_wavPath;
+    QString m_ffmpeg;
+    QObject m_processParent;
+
+    static constexpr int kSampleRate = 48000;
+    static constexpr int kChannels = 2;
+    static constexpr int kFileSeconds = 120;
+};
+
+#endif // TESTFXDECODERPERFORMANCE_H
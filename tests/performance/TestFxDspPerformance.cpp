@@ -0,0 +1,142 @@
+#include "TestFxDspPerformance.h"
+#include "../../src/audio/FxDsp.h"
+
+#include <QDebug>
+#include <QElapsedTimer>
+
+#include <cmath>
+#include <functional>
+#include <random>
+#include <vector>
+
+namespace
+{
+std::vector<float> noise(int frames, float amplitude)
+{
+    std::mt19937 gen(42);
+    std::uniform_real_distribution<float> dist(-amplitude, amplitude);
+    std::vector<float> out(static_cast<size_t>(frames) * 2);
+    for (float &v : out)
+        v = dist(gen);
+    return out;
+}
+
+FxParams allBandsActive()
+{
+    FxParams p;
+    p.eqEnabled = true;
+    p.preampDb = -2.0;
+    for (int i = 0; i < 10; ++i)
+        p.eqGainDb[i] = (i % 2 == 0) ? 4.5 : -3.0;
+    p.compEnabled = true;
+    p.compThresholdDb = -24.0;
+    p.compRatio = 4.0;
+    return p;
+}
+
+// Frames per second of process() over ~2 s of audio, chunked like the engine
+double framesPerSecond(const std::function<void(float *, int)> &process)
+{
+    const int totalFrames = 48000 * 2;
+    std::vector<float> source = noise(totalFrames, 0.5f);
+    std::vector<float> work(source.size());
+
+    qint64 bestNs = -1;
+    for (int round = 0; round < 5; ++round) {
+        work = source;
+        QElapsedTimer timer;
+        timer.start();
+        for (int off = 0; off < totalFrames; off += 2048)
+            process(work.data() + static_cast<size_t>(off) * 2, std::min(2048, totalFrames - off));
+        const qint64 ns = timer.nsecsElapsed();
+        if (bestNs < 0 || ns < bestNs)
+            bestNs = ns;
+    }
+    return totalFrames * 1e9 / double(std::max<qint64>(1, bestNs));
+}
+} // namespace
+
+void TestFxDspPerformance::testEffectThroughput()
+{
+    const FxParams p = allBandsActive();
+
+    fxdsp::Equalizer eqRef, eqVec;
+    eqRef.configure(kSampleRate, p);
+    eqVec.configure(kSampleRate, p);
+    const double eqRefFps = framesPerSecond([&](float *b, int n) { eqRef.process(b, n); });
+    const double eqVecFps = framesPerSecond([&](float *b, int n) { eqVec.processVectorized(b, n); });
+
+    fxdsp::Compressor compRef, compBlock;
+    compRef.configure(kSampleRate, p);
+    compBlock.configure(kSampleRate, p);
+    const double compRefFps = framesPerSecond([&](float *b, int n) { compRef.process(b, n); });
+    const double compBlockFps = framesPerSecond([&](float *b, int n) { compBlock.processBlockRate(b, n); });
+
+    // Output stage as the engine ran it before: clamp, meter loop, s16 loop
+    std::vector<qint16> s16(static_cast<size_t>(kChunkFrames) * 2);
+    float peakL = 0.0f, peakR = 0.0f;
+    const double outRefFps = framesPerSecond([&](float *b, int n) {
+        fxdsp::clampBuffer(b, n);
+        for (int i = 0; i < n * 2; i += 2) {
+            peakL = std::max(peakL, std::fabs(b[i]));
+            peakR = std::max(peakR, std::fabs(b[i + 1]));
+        }
+        for (int i = 0; i < n * 2; ++i)
+            s16[i] = static_cast<qint16>(b[i] * 32767.0f);
+    });
+    const double outFusedFps = framesPerSecond([&](float *b, int n) {
+        fxdsp::finishOutput(b, n, peakL, peakR, s16.data());
+    });
+
+    const auto report = [](const char *what, double ref, double vec) {
+        qDebug().noquote() << QStringLiteral("%1: reference %2 Mframes/s, vectorized %3 Mframes/s (x%4)")
+                                  .arg(QLatin1String(what))
+                                  .arg(ref / 1e6, 0, 'f', 1)
+                                  .arg(vec / 1e6, 0, 'f', 1)
+                                  .arg(vec / ref, 0, 'f', 2);
+    };
+    report("10-band EQ", eqRefFps, eqVecFps);
+    report("Compressor", compRefFps, compBlockFps);
+    report("Clamp+meter+s16", outRefFps, outFusedFps);
+
+    // Every path must comfortably beat real time, and the block-rate
+    // compressor must actually save its per-sample log/exp
+    QVERIFY(eqVecFps > kSampleRate * 20.0);
+    QVERIFY(compBlockFps > compRefFps);
+    QVERIFY(outFusedFps > kSampleRate * 20.0);
+}
+
+void TestFxDspPerformance::testPeakReducerThroughput()
+{
+    const auto reference = [](const int16_t *s, int n) {
+        int peak = 0;
+        for (int i = 0; i < n; ++i)
+            peak = std::max(peak, std::min(std::abs(int(s[i])), 32767));
+        return peak;
+    };
+    std::mt19937 gen(7);
+    std::uniform_int_distribution<int> dist(-32768, 32767);
+
+    // Waveform extractor's block size (80 samples = 20 ms)
+    constexpr int kPeakSamples = 80;
+    constexpr int kBlocks = 50000;
+    std::vector<int16_t> pcm(static_cast<size_t>(kPeakSamples) * kBlocks);
+    for (int16_t &v : pcm)
+        v = static_cast<int16_t>(dist(gen));
+    qint64 sink = 0; // keeps the reductions from being optimized out
+    const auto samplesPerSecond = [&](const std::function<int(const int16_t *, int)> &reduce) {
+        QElapsedTimer timer;
+        timer.start();
+        for (int b = 0; b < kBlocks; ++b)
+            sink += reduce(pcm.data() + static_cast<size_t>(b) * kPeakSamples, kPeakSamples);
+        return double(pcm.size()) * 1e9 / std::max<qint64>(1, timer.nsecsElapsed());
+    };
+    const double refSps = samplesPerSecond(reference);
+    const double vecSps = samplesPerSecond(fxdsp::peakAbsS16);
+    QVERIFY(sink > 0);
+    qDebug().noquote() << QStringLiteral("Waveform peaks: reference %1 Msamples/s, vectorized %2 Msamples/s")
+                              .arg(refSps / 1e6, 0, 'f', 1)
+                              .arg(vecSps / 1e6, 0, 'f', 1);
+}
+
+QTEST_MAIN(TestFxDspPerformance)
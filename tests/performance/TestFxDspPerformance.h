@@ -0,0 +1,27 @@
+#ifndef TESTFXDSPPERFORMANCE_H
+#define TESTFXDSPPERFORMANCE_H
+
+#include <QObject>
+#include <QTest>
+
+/**
+ * @brief Throughput of the FxEngine DSP chain
+ *
+ * Reports frames per second for each effect and samples per second for
+ * the waveform peak reducer, reference vs vectorized. Their correctness
+ * is covered by the TestFxDsp unit test.
+ */
+class TestFxDspPerformance : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void testEffectThroughput();
+    void testPeakReducerThroughput();
+
+private:
+    static constexpr int kSampleRate = 48000;
+    static constexpr int kChunkFrames = 2048;
+};
+
+#endif // TESTFXDSPPERFORMANCE_H
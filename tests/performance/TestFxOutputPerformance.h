@@ -0,0 +1,28 @@
+#ifndef TESTFXOUTPUTPERFORMANCE_H
+#define TESTFXOUTPUTPERFORMANCE_H
+
+#include <QObject>
+#include <QTest>
+
+/**
+ * @brief Real-time behaviour of the FxEngine pull-mode output device
+ *
+ * Runs a real-time producer/consumer pair at small latencies: a sink-like
+ * thread pulls on a fixed period while a pump-like thread with scheduling
+ * jitter keeps the ring topped up. Delivered audio must stay continuous and
+ * the underrun rate is reported per latency. The mix-bus benchmark reports
+ * what summing sources costs.
+ */
+class TestFxOutputPerformance : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void testMixCost_data();
+    void testMixCost();
+
+    void testRealtimePull_data();
+    void testRealtimePull();
+};
+
+#endif // TESTFXOUTPUTPERFORMANCE_H
@@ -13,12 +13,18 @@ class MusicFilterProxyModel;
 class MusicRepository;
 class QSqlDatabase;
 class QTableView;
+struct MusicItem;
 
 /**
  * @brief Performance tests for MusicListModel lazy loading
  * 
  * These tests verify that the lazy loading implementation performs
  * well with large datasets and provides responsive UI interaction.
+ * testHugeLibraryScrolling() scrolls and jumps through a 500k-row
+ * library the way a view does, timing the GUI-thread cost of data()
+ * and how long each jump takes to fill in.
+ * testFullTextSearchLatency() times search-as-you-type queries on the
+ * same library through the musics_fts index.
  * 
  * @since XFB 2.0
  */
@@ -45,6 +51,8 @@ private slots:
     void testLargeDatasetScrolling();
     void testLargeDatasetSearch_data();
     void testLargeDatasetSearch();
+    void testHugeLibraryScrolling();
+    void testFullTextSearchLatency();
 
     // Memory usage tests
     void testMemoryUsageWithLargeDataset();
@@ -88,6 +96,18 @@ private:
      */
     QList<MusicItem> generateTestMusicData(int count);
 
+    /**
+     * @brief Generate the test music record with the given index
+     * @param index Zero-based record index (the id is index + 1)
+     * @return Generated music item
+     */
+    static MusicItem generateTestMusicItem(int index);
+
+    /**
+     * @brief Close and remove the test database connection
+     */
+    void closeTestDatabase();
+
     /**
      * @brief Measure time for a specific operation
      * @param operation Lambda function to measure
@@ -157,6 +177,19 @@ private:
      */
     bool waitForOperationsComplete(MusicListModel* model, int timeoutMs = 5000);
 
+    /**
+     * @brief Wait until every row of a visible window is loaded
+     * @param model Model to read from, like a view painting the window
+     * @param topRow First visible row
+     * @param rowCount Number of visible rows
+     * @param guiNs Accumulates the time spent inside data()
+     * @param dataCalls Accumulates the number of data() calls
+     * @param timeoutMs Timeout in milliseconds
+     * @return true if the window filled in within timeout
+     */
+    bool waitForWindowLoaded(MusicListModel* model, int topRow, int rowCount,
+                             qint64* guiNs, qint64* dataCalls, int timeoutMs = 5000);
+
 private:
     QTemporaryDir m_tempDir;
     std::unique_ptr<QSqlDatabase> m_database;
@@ -170,6 +203,9 @@ private:
     static constexpr qint64 MAX_SEARCH_TIME = 1000;
     static constexpr qint64 MAX_SORT_TIME = 2000;
     static constexpr qint64 MAX_SCROLL_TIME_PER_ITEM = 1;
+    static constexpr qint64 MAX_JUMP_LATENCY = 100;
+    static constexpr qint64 MAX_DATA_CALL_NS = 20000;
+    static constexpr qint64 MAX_FULLTEXT_SEARCH_TIME = 10;
     
     // Memory thresholds (in bytes)
     static constexpr qint64 MAX_MEMORY_PER_ITEM = 1024; // 1KB per item
@@ -180,6 +216,8 @@ private:
     static constexpr int MEDIUM_DATASET_SIZE = 10000;
     static constexpr int LARGE_DATASET_SIZE = 100000;
     static constexpr int STRESS_DATASET_SIZE = 1000000;
+    static constexpr int HUGE_DATASET_SIZE = 500000;
+    static constexpr int VISIBLE_ROWS = 40;
 };
 
 /**
@@ -0,0 +1,199 @@
+#include "TestStreamEncodePerformance.h"
+#include "../../src/audio/FxEncodeFanout.h"
+
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QHash>
+#include <QMutex>
+#include <QProcess>
+#include <QStandardPaths>
+#include <QThread>
+
+#include <cmath>
+#include <unistd.h>
+
+namespace
+{
+/** Encoder that takes everything and produces nothing. */
+class NullEncoder : public FxEncoder
+{
+public:
+    size_t write(const float *, size_t frames) override { return frames; }
+    qint64 takeEncoded(QByteArray &) override { return 0; }
+    void finish() override {}
+    qint64 queuedFrames() const override { return 0; }
+    bool failed() const override { return false; }
+    QString errorString() const override { return QString(); }
+};
+
+FxEncoder::Settings settings(FxEncoder::Codec codec, int kbps)
+{
+    FxEncoder::Settings s;
+    s.codec = codec;
+    s.bitrateKbps = kbps;
+    return s;
+}
+
+QString label(const FxEncoder::Settings &s)
+{
+    return QStringLiteral("%1 %2k").arg(FxEncoder::codecName(s.codec)).arg(s.bitrateKbps);
+}
+
+/** CPU time a child process used so far (Linux /proc), -1 if unknown. */
+qint64 childCpuUs(qint64 pid)
+{
+    QFile stat(QStringLiteral("/proc/%1/stat").arg(pid));
+    if (!stat.open(QIODevice::ReadOnly))
+        return -1;
+    const QByteArray line = stat.readAll();
+    // utime and stime are fields 14 and 15, counting from the one after "(comm)"
+    const QList<QByteArray> fields = line.mid(line.lastIndexOf(')') + 2).split(' ');
+    if (fields.size() < 13)
+        return -1;
+    const qint64 ticks = fields.at(11).toLongLong() + fields.at(12).toLongLong();
+    return ticks * 1000000 / sysconf(_SC_CLK_TCK);
+}
+} // namespace
+
+void TestStreamEncodePerformance::initTestCase()
+{
+    m_ffmpeg = QStandardPaths::findExecutable(QStringLiteral("ffmpeg"));
+    // A 440 Hz tone with a slow wobble, so the encoders have some work to do
+    m_audio.resize(size_t(kSampleRate) * kSeconds * kChannels);
+    for (size_t n = 0; n < m_audio.size() / kChannels; ++n) {
+        const double t = double(n) / kSampleRate;
+        const float v = float(0.4 * std::sin(2 * M_PI * 440 * t) * (0.75 + 0.25 * std::sin(2 * M_PI * 3 * t)));
+        m_audio[n * kChannels] = v;
+        m_audio[n * kChannels + 1] = -v;
+    }
+}
+
+quint64 TestStreamEncodePerformance::feed(FxEncodeFanout &fanout, const QList<int> &lanes) const
+{
+    const size_t total = m_audio.size() / kChannels;
+    const size_t step = FxEncodeFanout::kBlockFrames * 4;
+    const qint64 maxQueued = kSampleRate / 2;
+    FxEncodeFanout::Output out;
+
+    auto slowest = [&]() {
+        qint64 queued = 0;
+        for (int id : lanes) {
+            fanout.takeOutput(id, out);
+            queued = std::max(queued, fanout.laneStats(id).queuedFrames);
+        }
+        return queued;
+    };
+
+    for (size_t done = 0; done < total; done += step) {
+        // Faster than real time, but never so far ahead that a lane drops
+        while (slowest() > maxQueued)
+            QThread::msleep(1);
+        fanout.push(m_audio.data() + done * kChannels, std::min(step, total - done));
+    }
+    QElapsedTimer guard;
+    guard.start();
+    while (slowest() > 0 && guard.elapsed() < 30000)
+        QThread::msleep(5);
+
+    quint64 dropped = 0;
+    for (int id : lanes)
+        dropped += fanout.laneStats(id).droppedFrames;
+    return dropped;
+}
+
+qint64 TestStreamEncodePerformance::perHourMs(qint64 cpuUs)
+{
+    return cpuUs * 3600 / kSeconds / 1000;
+}
+
+void TestStreamEncodePerformance::testFanoutOverheadPerLane()
+{
+    qint64 previous = 0;
+    for (int lanes = 1; lanes <= 4; ++lanes) {
+        FxEncodeFanout fanout(kChannels, kSampleRate, [](const FxEncoder::Settings &, QString *) {
+            return std::unique_ptr<FxEncoder>(new NullEncoder);
+        });
+        QList<int> ids;
+        for (int i = 0; i < lanes; ++i)
+            ids << fanout.addLane(settings(FxEncoder::Codec::Mp3, 128));
+
+        QElapsedTimer timer;
+        timer.start();
+        QCOMPARE(feed(fanout, ids), quint64(0));
+        const qint64 wallUs = timer.nsecsElapsed() / 1000;
+
+        qint64 laneUs = 0;
+        for (int id : ids)
+            laneUs += std::max<qint64>(0, fanout.laneStats(id).cpuTimeUs);
+        qDebug().noquote() << QStringLiteral("fan-out, %1 lane(s): %2 ms wall, lanes %3 ms CPU per hour of audio, "
+                                             "%4 block(s) allocated")
+                                  .arg(lanes)
+                                  .arg(wallUs / 1000)
+                                  .arg(perHourMs(laneUs))
+                                  .arg(fanout.pool().allocatedBlocks());
+        if (lanes > 1)
+            qDebug().noquote() << "  added lane:" << perHourMs(laneUs - previous) << "ms CPU per hour";
+        previous = laneUs;
+        // Blocks are shared by reference: the pool stays at one queue's worth
+        QVERIFY(fanout.pool().allocatedBlocks()
+                <= size_t(kSampleRate) * FxEncodeFanout::kQueueMs / 1000 / FxEncodeFanout::kBlockFrames + 2);
+    }
+}
+
+void TestStreamEncodePerformance::testCpuPerAddedBitrate()
+{
+#ifndef XFB_HAVE_LIBAV
+    if (m_ffmpeg.isEmpty())
+        QSKIP("neither ffmpeg nor libav available");
+#endif
+    const QList<FxEncoder::Settings> ladder{settings(FxEncoder::Codec::Opus, 64),
+                                            settings(FxEncoder::Codec::Mp3, 128),
+                                            settings(FxEncoder::Codec::Mp3, 192),
+                                            settings(FxEncoder::Codec::Aac, 64)};
+
+    qint64 previous = 0;
+    for (int count = 1; count <= ladder.size(); ++count) {
+        // ffmpeg children, by bitrate label, for their CPU time
+        QMutex pidsMutex;
+        QHash<QString, qint64> pids;
+        const QString ffmpeg = m_ffmpeg;
+        FxEncodeFanout fanout(kChannels, kSampleRate,
+                              [&, ffmpeg](const FxEncoder::Settings &s, QString *error) {
+                                  auto encoder = FxEncoder::open(s, ffmpeg, error);
+                                  if (auto *p = dynamic_cast<ProcessEncoder *>(encoder.get())) {
+                                      QMutexLocker locker(&pidsMutex);
+                                      pids.insert(label(s), p->process()->processId());
+                                  }
+                                  return encoder;
+                              });
+        QList<int> ids;
+        for (int i = 0; i < count; ++i)
+            ids << fanout.addLane(ladder.at(i));
+
+        const quint64 dropped = feed(fanout, ids);
+        qint64 totalUs = 0;
+        QStringList perLane;
+        for (int id : ids) {
+            const FxEncodeFanout::LaneStats stats = fanout.laneStats(id);
+            QVERIFY2(stats.encodedBytes > 0, qPrintable(label(stats.settings) + " produced nothing"));
+            qint64 us = std::max<qint64>(0, stats.cpuTimeUs);
+            QMutexLocker locker(&pidsMutex);
+            if (pids.contains(label(stats.settings)))
+                us += std::max<qint64>(0, childCpuUs(pids.value(label(stats.settings))));
+            totalUs += us;
+            perLane << QStringLiteral("%1 %2 ms").arg(label(stats.settings)).arg(perHourMs(us));
+        }
+        qDebug().noquote() << QStringLiteral("%1 bitrate(s): %2 ms CPU per hour of audio (%3)")
+                                  .arg(count)
+                                  .arg(perHourMs(totalUs))
+                                  .arg(perLane.join(", "));
+        if (count > 1)
+            qDebug().noquote() << "  added" << label(ladder.at(count - 1)) << ":"
+                               << perHourMs(totalUs - previous) << "ms CPU per hour";
+        previous = totalUs;
+        QCOMPARE(dropped, quint64(0));
+    }
+}
+
+QTEST_MAIN(TestStreamEncodePerformance)
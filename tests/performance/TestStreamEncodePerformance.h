@@ -0,0 +1,45 @@
+#ifndef TESTSTREAMENCODEPERFORMANCE_H
+#define TESTSTREAMENCODEPERFORMANCE_H
+
+#include <QList>
+#include <QObject>
+#include <QTest>
+
+#include <vector>
+
+class FxEncodeFanout;
+
+/**
+ * @brief CPU cost of streaming at several bitrates at once
+ *
+ * Feeds generated audio through FxEncodeFanout, the way StreamSource does,
+ * with one to four encoders (Opus 64, MP3 128, MP3 192, AAC 64 kbps) and
+ * reports the CPU time per hour of audio of each encoder (its lane thread,
+ * plus its ffmpeg child when encoding through the CLI) and what each added
+ * bitrate costs. Also measures the fan-out itself against encoders that
+ * discard the audio.
+ */
+class TestStreamEncodePerformance : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+
+    void testFanoutOverheadPerLane();
+    void testCpuPerAddedBitrate();
+
+private:
+    /** Push the test audio as fast as the slowest lane takes it; returns frames the lanes dropped. */
+    quint64 feed(FxEncodeFanout &fanout, const QList<int> &lanes) const;
+    static qint64 perHourMs(qint64 cpuUs);
+
+    QString m_ffmpeg;
+    std::vector<float> m_audio;
+
+    static constexpr int kSampleRate = 48000;
+    static constexpr int kChannels = 2;
+    static constexpr int kSeconds = 60;
+};
+
+#endif // TESTSTREAMENCODEPERFORMANCE_H
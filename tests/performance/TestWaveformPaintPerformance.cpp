@@ -0,0 +1,83 @@
+#include "TestWaveformPaintPerformance.h"
+#include "../../src/audio/WaveformData.h"
+#include "../unit/audio/WaveformTestData.h"
+
+#include <QDebug>
+#include <QElapsedTimer>
+
+#include <algorithm>
+#include <functional>
+
+namespace
+{
+// What painting cost before the pyramid: every 20 ms peak under a column
+int scanPeaks(const WaveformData &data, qint64 fromMs, qint64 toMs, int columns)
+{
+    const double msPerPx = double(toMs - fromMs) / columns;
+    int sink = 0;
+    for (int x = 0; x < columns; ++x) {
+        const qint64 msStart = fromMs + qint64(x * msPerPx);
+        const qint64 msEnd = fromMs + qint64((x + 1) * msPerPx);
+        const int i0 = int(msStart / WaveformData::MsPerPeak);
+        const int i1 = std::min(std::max(int(msEnd / WaveformData::MsPerPeak), i0 + 1),
+                                int(data.peaks.size()));
+        int peak = 0;
+        for (int i = i0; i < i1; ++i)
+            peak = std::max(peak, int(data.peaks[i]));
+        sink += peak;
+    }
+    return sink;
+}
+
+// Best of a few rounds, in ns
+qint64 bestNs(const std::function<void()> &run)
+{
+    qint64 best = -1;
+    for (int round = 0; round < 7; ++round) {
+        QElapsedTimer timer;
+        timer.start();
+        run();
+        const qint64 ns = timer.nsecsElapsed();
+        if (best < 0 || ns < best)
+            best = ns;
+    }
+    return std::max<qint64>(1, best);
+}
+} // namespace
+
+void TestWaveformPaintPerformance::testLongProgrammePaintCost()
+{
+    const WaveformData programme = syntheticWaveform(kProgrammeMs);
+    const WaveformData song = syntheticWaveform(4 * 60 * 1000);
+    QVector<qint8> columns(kColumns * 2);
+    volatile int sink = 0;
+
+    const qint64 scanNs = bestNs([&]() {
+        sink += scanPeaks(programme, 0, programme.durationMs, kColumns);
+    });
+    const qint64 programmeNs = bestNs([&]() {
+        programme.reduceColumns(0, programme.durationMs, kColumns, columns.data());
+        sink += columns[0];
+    });
+    const qint64 songNs = bestNs([&]() {
+        song.reduceColumns(0, song.durationMs, kColumns, columns.data());
+        sink += columns[0];
+    });
+    // The transition strip zoomed in on the programme's end
+    const qint64 zoomNs = bestNs([&]() {
+        programme.reduceColumns(programme.durationMs - 2000, programme.durationMs, kColumns,
+                                columns.data());
+        sink += columns[0];
+    });
+
+    qDebug() << "2 h programme," << kColumns << "columns: 20 ms peak scan"
+             << scanNs / 1000.0 << "us, pyramid" << programmeNs / 1000.0 << "us";
+    qDebug() << "pyramid: 4 min song" << songNs / 1000.0 << "us, 2 s zoom"
+             << zoomNs / 1000.0 << "us," << programme.residentBytes() / 1024 << "KiB resident";
+
+    QVERIFY2(programmeNs < scanNs, "the pyramid must beat scanning every peak");
+    // Same column count, 30x the audio: the cost stays in the same range
+    QVERIFY2(programmeNs < songNs * 8 + 200000, "pyramid cost grows with the track length");
+}
+
+QTEST_MAIN(TestWaveformPaintPerformance)
@@ -0,0 +1,26 @@
+#ifndef TESTWAVEFORMPAINTPERFORMANCE_H
+#define TESTWAVEFORMPAINTPERFORMANCE_H
+
+#include <QObject>
+#include <QTest>
+
+/**
+ * @brief Paint cost of playlist waveforms
+ *
+ * Paints a two-hour programme, zoomed out and zoomed in, and compares the
+ * pyramid reduction with a scan of the 20 ms peaks; the pyramid must not
+ * grow with the programme's length.
+ */
+class TestWaveformPaintPerformance : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void testLongProgrammePaintCost();
+
+private:
+    static constexpr qint64 kProgrammeMs = qint64(2) * 60 * 60 * 1000;
+    static constexpr int kColumns = 1200; // a maximised playlist row
+};
+
+#endif // TESTWAVEFORMPAINTPERFORMANCE_H
@@ -0,0 +1,55 @@
+#ifndef LIBRARYTESTSCHEMA_H
+#define LIBRARYTESTSCHEMA_H
+
+#include <QSqlDatabase>
+#include <QSqlError>
+#include <QSqlQuery>
+#include <QString>
+
+/**
+ * @brief Library database fixture shared by the unit tests
+ *
+ * Each test opens its own adb.db in a temporary directory under a named
+ * connection, creates musics the way the shipped database has it, and
+ * lets LibraryMigrations add the rest.
+ */
+namespace LibraryTestSchema {
+
+/** Opens (creating it) the SQLite database file under connectionName. */
+inline QSqlDatabase openDatabase(const QString& connectionName, const QString& fileName)
+{
+    QSqlDatabase database = QSqlDatabase::addDatabase("QSQLITE", connectionName);
+    database.setDatabaseName(fileName);
+    database.open();
+    return database;
+}
+
+/** Closes database and drops its connection; database is left invalid. */
+inline void closeDatabase(QSqlDatabase& database, const QString& connectionName)
+{
+    database.close();
+    database = QSqlDatabase();
+    QSqlDatabase::removeDatabase(connectionName);
+}
+
+/**
+ * Creates musics as in the shipped adb.db: no INTEGER PRIMARY KEY, so its
+ * rowids are implicit and a VACUUM may renumber them. False with *error
+ * set when the statement fails.
+ */
+inline bool createMusicsTable(QSqlDatabase& database, QString* error = nullptr)
+{
+    QSqlQuery query(database);
+    if (query.exec("CREATE TABLE musics (\"id\" INTEGER, \"artist\" VARCHAR NOT NULL, "
+                   "\"song\" VARCHAR NOT NULL, \"genre1\" VARCHAR NOT NULL, \"genre2\" VARCHAR, "
+                   "\"country\" VARCHAR, \"published_date\" VARCHAR, \"path\" TEXT, \"time\" TEXT, "
+                   "\"played_times\" INTEGER, \"last_played\" TEXT)"))
+        return true;
+    if (error)
+        *error = query.lastError().text();
+    return false;
+}
+
+} // namespace LibraryTestSchema
+
+#endif // LIBRARYTESTSCHEMA_H
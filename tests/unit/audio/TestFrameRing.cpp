@@ -0,0 +1,97 @@
+#include "TestFrameRing.h"
+#include "../../../src/audio/FrameRing.h"
+
+#include <vector>
+
+namespace
+{
+// Interleaved stereo frame i carries (i, -i) so ordering is checkable
+void fillFrames(float *out, size_t first, size_t frames)
+{
+    for (size_t i = 0; i < frames; ++i) {
+        out[2 * i] = static_cast<float>(first + i);
+        out[2 * i + 1] = -static_cast<float>(first + i);
+    }
+}
+} // namespace
+
+void TestFrameRing::testWrapAroundPeekCommit()
+{
+    FrameRing ring(kChannels);
+    ring.reset(1000);
+    QCOMPARE(ring.capacityFrames(), size_t(1024));
+
+    std::vector<float> buf(2048 * kChannels);
+    size_t written = 0;
+    size_t readPos = 0;
+
+    // Push the indices several times around the ring
+    for (int round = 0; round < 10; ++round) {
+        fillFrames(buf.data(), written, 700);
+        QCOMPARE(ring.write(buf.data(), 700), size_t(700));
+        written += 700;
+
+        FrameRing::Region a, b;
+        const size_t n = ring.peek(700, a, b);
+        QCOMPARE(n, size_t(700));
+        QCOMPARE(a.frames + b.frames, n);
+        for (size_t i = 0; i < a.frames; ++i)
+            QCOMPARE(a.data[2 * i], static_cast<float>(readPos + i));
+        for (size_t i = 0; i < b.frames; ++i)
+            QCOMPARE(b.data[2 * i + 1], -static_cast<float>(readPos + a.frames + i));
+        ring.commitRead(n);
+        readPos += n;
+        QVERIFY(ring.isEmpty());
+    }
+
+    // Writes beyond capacity are truncated, never overwrite unread frames
+    fillFrames(buf.data(), 0, 2048);
+    QCOMPARE(ring.write(buf.data(), 2048), size_t(1024));
+    QCOMPARE(ring.freeFrames(), size_t(0));
+}
+
+void TestFrameRing::testOverwriteKeepsNewest()
+{
+    FrameRing history(kChannels);
+    history.reset(256);
+
+    std::vector<float> buf(1000 * kChannels);
+    fillFrames(buf.data(), 0, 1000);
+    for (size_t off = 0; off < 1000; off += 100)
+        history.writeOverwrite(buf.data() + off * kChannels, 100);
+
+    QCOMPARE(history.availableFrames(), size_t(256));
+    QCOMPARE(history.frame(0)[0], 744.0f);
+    QCOMPARE(history.frame(255)[0], 999.0f);
+
+    std::vector<float> out(256 * kChannels);
+    QCOMPARE(history.copyOut(0, out.data(), 256), size_t(256));
+    QCOMPARE(out[0], 744.0f);
+    QCOMPARE(out[255 * kChannels + 1], -999.0f);
+    QCOMPARE(history.availableFrames(), size_t(256)); // copyOut does not consume
+}
+
+void TestFrameRing::testDropNewestAndSwap()
+{
+    FrameRing a(kChannels);
+    FrameRing b(kChannels);
+    a.reset(128);
+    b.reset(64);
+
+    std::vector<float> buf(100 * kChannels);
+    fillFrames(buf.data(), 0, 100);
+    a.write(buf.data(), 100);
+    a.dropNewest(30);
+    QCOMPARE(a.availableFrames(), size_t(70));
+    QCOMPARE(a.frame(69)[0], 69.0f);
+
+    a.swap(b);
+    QVERIFY(a.isEmpty());
+    QCOMPARE(a.capacityFrames(), size_t(64));
+    QCOMPARE(b.capacityFrames(), size_t(128));
+    QCOMPARE(b.availableFrames(), size_t(70));
+    QCOMPARE(b.discard(1000), size_t(70));
+    QVERIFY(b.isEmpty());
+}
+
+QTEST_MAIN(TestFrameRing)
@@ -0,0 +1,26 @@
+#ifndef TESTFRAMERING_H
+#define TESTFRAMERING_H
+
+#include <QtTest/QtTest>
+
+/**
+ * @brief Unit tests for the FxEngine FrameRing
+ *
+ * Frames keep their order across the wrap in peek/commit reads, writes
+ * never overwrite unread frames, the overwriting history mode keeps the
+ * newest frames, and dropNewest/swap move whole rings.
+ */
+class TestFrameRing : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void testWrapAroundPeekCommit();
+    void testOverwriteKeepsNewest();
+    void testDropNewestAndSwap();
+
+private:
+    static constexpr int kChannels = 2;
+};
+
+#endif // TESTFRAMERING_H
@@ -0,0 +1,270 @@
+#include "TestFxDsp.h"
+#include "../../../src/audio/FxDsp.h"
+
+#include <QDebug>
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <vector>
+
+namespace
+{
+std::vector<float> noise(int frames, float amplitude)
+{
+    std::mt19937 gen(42);
+    std::uniform_real_distribution<float> dist(-amplitude, amplitude);
+    std::vector<float> out(static_cast<size_t>(frames) * 2);
+    for (float &v : out)
+        v = dist(gen);
+    return out;
+}
+
+std::vector<float> sine(int frames, double freqHz, float amplitude, int sampleRate)
+{
+    std::vector<float> out(static_cast<size_t>(frames) * 2);
+    for (int i = 0; i < frames; ++i) {
+        const float v = amplitude * static_cast<float>(std::sin(2.0 * M_PI * freqHz * i / sampleRate));
+        out[2 * i] = v;
+        out[2 * i + 1] = v;
+    }
+    return out;
+}
+
+FxParams allBandsActive()
+{
+    FxParams p;
+    p.eqEnabled = true;
+    p.preampDb = -2.0;
+    for (int i = 0; i < 10; ++i)
+        p.eqGainDb[i] = (i % 2 == 0) ? 4.5 : -3.0;
+    p.compEnabled = true;
+    p.compThresholdDb = -24.0;
+    p.compRatio = 4.0;
+    return p;
+}
+
+double rmsDb(const std::vector<float> &buf, size_t from)
+{
+    double sum = 0.0;
+    for (size_t i = from; i < buf.size(); ++i)
+        sum += double(buf[i]) * buf[i];
+    return 10.0 * std::log10(sum / double(buf.size() - from));
+}
+} // namespace
+
+void TestFxDsp::testEqualizerMatchesReference()
+{
+    const FxParams p = allBandsActive();
+    fxdsp::Equalizer reference, vectorized;
+    reference.configure(kSampleRate, p);
+    vectorized.configure(kSampleRate, p);
+
+    std::vector<float> a = noise(kSampleRate, 0.5f);
+    std::vector<float> b = a;
+    // Odd chunk sizes so filter state is carried across calls
+    for (int off = 0; off < kSampleRate; off += 1001) {
+        const int n = std::min(1001, kSampleRate - off);
+        reference.process(a.data() + off * 2, n);
+        vectorized.processVectorized(b.data() + off * 2, n);
+    }
+
+    // Same double math in the same order; only a fused multiply-add on
+    // NEON may move the last bits
+    double maxDiff = 0.0;
+    for (size_t i = 0; i < a.size(); ++i)
+        maxDiff = std::max(maxDiff, double(std::fabs(a[i] - b[i])));
+    QVERIFY2(maxDiff <= 1e-6, qPrintable(QStringLiteral("max diff %1").arg(maxDiff)));
+}
+
+void TestFxDsp::testFinishOutputMatchesReference()
+{
+    // Over-range input so the clamp is exercised
+    std::vector<float> fused = noise(kChunkFrames + 3, 1.6f);
+    std::vector<float> reference = fused;
+    std::vector<qint16> s16(fused.size());
+
+    float peakL = 0.0f, peakR = 0.0f;
+    fxdsp::finishOutput(fused.data(), kChunkFrames + 3, peakL, peakR, s16.data());
+    fxdsp::clampBuffer(reference.data(), kChunkFrames + 3);
+
+    float refPeakL = 0.0f, refPeakR = 0.0f;
+    for (size_t i = 0; i < reference.size(); i += 2) {
+        refPeakL = std::max(refPeakL, std::fabs(reference[i]));
+        refPeakR = std::max(refPeakR, std::fabs(reference[i + 1]));
+    }
+    for (size_t i = 0; i < reference.size(); ++i) {
+        QCOMPARE(fused[i], reference[i]);
+        QCOMPARE(s16[i], static_cast<qint16>(reference[i] * 32767.0f));
+    }
+    QCOMPARE(peakL, refPeakL);
+    QCOMPARE(peakR, refPeakR);
+}
+
+void TestFxDsp::testBlockRateCompressorTolerance()
+{
+    const FxParams p = allBandsActive();
+    fxdsp::Compressor reference, blockRate;
+    reference.configure(kSampleRate, p);
+    blockRate.configure(kSampleRate, p);
+    reference.reset();
+    blockRate.reset();
+
+    // Loud tone, then a quieter one: covers attack, steady state and release
+    std::vector<float> a = sine(kSampleRate, 440.0, 0.7f, kSampleRate);
+    std::vector<float> quiet = sine(kSampleRate, 440.0, 0.1f, kSampleRate);
+    a.insert(a.end(), quiet.begin(), quiet.end());
+    std::vector<float> b = a;
+    const int frames = static_cast<int>(a.size() / 2);
+    for (int off = 0; off < frames; off += kChunkFrames) {
+        const int n = std::min(kChunkFrames, frames - off);
+        reference.process(a.data() + off * 2, n);
+        blockRate.processBlockRate(b.data() + off * 2, n);
+    }
+
+    // Whole-signal level within 0.1 dB, and no sample more than ~0.2 dB off
+    QVERIFY(std::fabs(rmsDb(a, 0) - rmsDb(b, 0)) < 0.1);
+    for (size_t i = 0; i < a.size(); ++i) {
+        if (std::fabs(a[i]) > 0.01f) {
+            const double ratio = double(b[i]) / double(a[i]);
+            QVERIFY2(ratio > 0.977 && ratio < 1.024,
+                     qPrintable(QStringLiteral("sample %1 ratio %2").arg(i).arg(ratio)));
+        }
+    }
+}
+
+void TestFxDsp::testVolumeEnvelopeBreakpoints()
+{
+    // Fade in from a held level, dip, hold, swell and fade out to silence
+    const std::vector<fxdsp::GainEnvelope::Point> points = {
+        {kSampleRate / 2, 0.9},          // 0.5 s
+        {kSampleRate * 2, 0.2},          // 2.0 s
+        {kSampleRate * 13 / 4, 0.2},     // 3.25 s
+        {kSampleRate * 4, 0.8},          // 4.0 s
+        {kSampleRate * 6 + 17, 0.0},     // just past 6 s, off any chunk edge
+    };
+    fxdsp::GainEnvelope envelope;
+    envelope.setPoints(points);
+
+    // Render 7 s of constant signal (different per channel) the way the
+    // engine does: in chunks whose edges fall anywhere relative to the points
+    const int frames = kSampleRate * 7;
+    std::vector<float> out(static_cast<size_t>(frames) * 2);
+    for (int i = 0; i < frames; ++i) {
+        out[2 * i] = 1.0f;
+        out[2 * i + 1] = 0.5f;
+    }
+    const int chunkSizes[] = {1001, 37, kChunkFrames, 480};
+    for (int off = 0, c = 0; off < frames; ++c) {
+        const int n = std::min(chunkSizes[c % 4], frames - off);
+        envelope.apply(out.data() + static_cast<size_t>(off) * 2, n, off);
+        off += n;
+    }
+
+    // Exact at the breakpoints
+    for (const fxdsp::GainEnvelope::Point &p : points) {
+        const size_t i = static_cast<size_t>(p.frame) * 2;
+        QVERIFY2(std::fabs(out[i] - p.gain) <= 1e-6,
+                 qPrintable(QStringLiteral("frame %1: %2, want %3").arg(p.frame).arg(out[i]).arg(p.gain)));
+        QVERIFY(std::fabs(out[i + 1] - 0.5 * p.gain) <= 1e-6);
+    }
+    // Held flat outside the line
+    QCOMPARE(out[0], 0.9f);
+    QCOMPARE(out[out.size() - 2], 0.0f);
+
+    // Every sample on the interpolated line, and no zipper steps: adjacent
+    // samples differ by at most the steepest slope (0.8 per second here)
+    const double maxStep = 0.8 / kSampleRate + 1e-6;
+    for (int i = 0; i < frames; ++i) {
+        const double want = envelope.gainAt(i);
+        QVERIFY2(std::fabs(out[2 * i] - want) <= 1e-6,
+                 qPrintable(QStringLiteral("frame %1: %2, want %3").arg(i).arg(out[2 * i]).arg(want)));
+        if (i > 0)
+            QVERIFY(std::fabs(out[2 * i] - out[2 * i - 2]) <= maxStep);
+    }
+
+    // Mid-segment value, checked against the line by hand
+    QVERIFY(std::fabs(envelope.gainAt(kSampleRate * 3) - 0.2) <= 1e-9);
+    QVERIFY(std::fabs(envelope.gainAt(kSampleRate * 5 / 4) - 0.55) <= 1e-9);
+
+    // An empty line is unity
+    fxdsp::GainEnvelope empty;
+    std::vector<float> untouched = noise(64, 0.5f);
+    std::vector<float> copy = untouched;
+    empty.apply(copy.data(), 64, 1000);
+    QVERIFY(copy == untouched);
+}
+
+void TestFxDsp::testLoudnessMeterReference()
+{
+    const auto dbfs = [](double db) { return static_cast<float>(std::pow(10.0, db / 20.0)); };
+    const auto measure = [](fxdsp::LoudnessMeter &meter, const std::vector<float> &signal) {
+        // Odd chunking: blocks must not depend on how the audio arrives
+        const int frames = static_cast<int>(signal.size() / 2);
+        for (int off = 0; off < frames; off += 1001)
+            meter.process(signal.data() + static_cast<size_t>(off) * 2, std::min(1001, frames - off));
+    };
+
+    // Tech 3341 case 1: stereo 1 kHz sine at -23 dBFS reads -23.0 LUFS
+    fxdsp::LoudnessMeter meter;
+    meter.setup(kSampleRate);
+    measure(meter, sine(kSampleRate * 20, 997.0, dbfs(-23.0), kSampleRate));
+    qDebug() << "1 kHz @ -23 dBFS:" << meter.integratedLufs() << "LUFS";
+    QVERIFY(std::fabs(meter.integratedLufs() - -23.0) <= 0.1);
+    QVERIFY(std::fabs(meter.truePeakDb() - -23.0) <= 0.1);
+    QCOMPARE(meter.blocks(), size_t(20 * 10 - 3));
+
+    // Tech 3341 case 3 plus silence: -36 / -23 / -36 dBFS tones for 10 /
+    // 60 / 10 s and 10 s of digital silence. The quiet parts fall under the
+    // relative gate, the silence under the absolute one: still -23.0.
+    meter.reset();
+    measure(meter, sine(kSampleRate * 10, 997.0, dbfs(-36.0), kSampleRate));
+    measure(meter, sine(kSampleRate * 60, 997.0, dbfs(-23.0), kSampleRate));
+    measure(meter, sine(kSampleRate * 10, 997.0, dbfs(-36.0), kSampleRate));
+    measure(meter, std::vector<float>(static_cast<size_t>(kSampleRate) * 10 * 2, 0.0f));
+    qDebug() << "gated -36/-23/-36 + silence:" << meter.integratedLufs() << "LUFS";
+    QVERIFY(std::fabs(meter.integratedLufs() - -23.0) <= 0.1);
+    QVERIFY(meter.momentaryLufs(meter.blocks() - 1) == fxdsp::LoudnessMeter::kSilenceLufs);
+
+    // True peak: a quarter-rate tone sampled 45 degrees off its crests
+    // never has a sample above -3 dBFS, yet the waveform reaches 0 dBFS
+    std::vector<float> offCrest(static_cast<size_t>(kSampleRate) * 2);
+    for (int i = 0; i < kSampleRate; ++i)
+        offCrest[2 * i] = offCrest[2 * i + 1] = static_cast<float>(std::sin(M_PI / 2 * i + M_PI / 4));
+    meter.reset();
+    measure(meter, offCrest);
+    qDebug() << "fs/4 tone, samples at -3 dBFS:" << meter.truePeakDb() << "dBTP";
+    QVERIFY(std::fabs(meter.truePeakDb()) <= 0.2);
+
+    // Nothing measured: silence, not a number
+    fxdsp::LoudnessMeter idle;
+    idle.setup(kSampleRate);
+    QCOMPARE(idle.integratedLufs(), fxdsp::LoudnessMeter::kSilenceLufs);
+}
+
+void TestFxDsp::testPeakReducerMatchesReference()
+{
+    const auto reference = [](const int16_t *s, int n) {
+        int peak = 0;
+        for (int i = 0; i < n; ++i)
+            peak = std::max(peak, std::min(std::abs(int(s[i])), 32767));
+        return peak;
+    };
+
+    // Every length around the vector width, with the extremes planted in
+    // the vector body and in the scalar tail
+    std::mt19937 gen(7);
+    std::uniform_int_distribution<int> dist(-32768, 32767);
+    std::vector<int16_t> block(96);
+    for (int n = 0; n <= static_cast<int>(block.size()); ++n) {
+        for (int16_t &v : block)
+            v = static_cast<int16_t>(dist(gen) / (1 + n % 5));
+        if (n > 3)
+            block[static_cast<size_t>(n / 2)] = (n % 2) ? -32768 : 32767;
+        if (n % 8 == 3)
+            block[static_cast<size_t>(n - 1)] = -32768;
+        QCOMPARE(fxdsp::peakAbsS16(block.data(), n), reference(block.data(), n));
+    }
+}
+
+QTEST_MAIN(TestFxDsp)
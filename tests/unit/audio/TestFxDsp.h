@@ -0,0 +1,32 @@
+#ifndef TESTFXDSP_H
+#define TESTFXDSP_H
+
+#include <QtTest/QtTest>
+
+/**
+ * @brief Unit tests for the FxEngine DSP chain
+ *
+ * The vectorized paths must match their scalar references: the equalizer,
+ * the fused output pass and the waveform peak reducer exactly, the
+ * block-rate compressor within a small gain tolerance. A volume line must
+ * hit its breakpoints exactly whatever the chunk boundaries, and the
+ * loudness meter must read the EBU Tech 3341 references within 0.1 LU.
+ */
+class TestFxDsp : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void testEqualizerMatchesReference();
+    void testFinishOutputMatchesReference();
+    void testBlockRateCompressorTolerance();
+    void testVolumeEnvelopeBreakpoints();
+    void testLoudnessMeterReference();
+    void testPeakReducerMatchesReference();
+
+private:
+    static constexpr int kSampleRate = 48000;
+    static constexpr int kChunkFrames = 2048;
+};
+
+#endif // TESTFXDSP_H
@@ -0,0 +1,131 @@
+#include "TestFxOutput.h"
+#include "../../../src/audio/FxOutput.h"
+
+#include <algorithm>
+#include <vector>
+
+namespace
+{
+std::vector<float> frames(size_t count, float value)
+{
+    return std::vector<float>(count * 2, value);
+}
+
+qint64 pullFrames(FxOutput &out, size_t count, std::vector<float> &buf)
+{
+    buf.resize(count * 2);
+    return out.read(reinterpret_cast<char *>(buf.data()),
+                    static_cast<qint64>(count * 2 * sizeof(float)));
+}
+} // namespace
+
+void TestFxOutput::testUnderrunAccounting()
+{
+    FxOutput out(2);
+    out.configure(1024, true);
+    std::vector<float> buf;
+
+    // Stream starting: silence, but not an underrun
+    QCOMPARE(pullFrames(out, 256, buf), qint64(256 * 2 * sizeof(float)));
+    QCOMPARE(out.stats().underruns, quint64(0));
+
+    const std::vector<float> audio = frames(100, 0.5f);
+    QCOMPARE(out.push(audio.data(), 100), size_t(100));
+    QCOMPARE(pullFrames(out, 256, buf), qint64(256 * 2 * sizeof(float)));
+    QCOMPARE(buf[0], 0.5f);
+    QCOMPARE(buf[199], 0.5f);
+    QCOMPARE(buf[200], 0.0f);
+
+    const FxOutputStats s = out.stats();
+    QCOMPARE(s.callbacks, quint64(2));
+    QCOMPARE(s.underruns, quint64(1));
+    QCOMPARE(s.underrunFrames, quint64(156));
+
+    out.resetStats();
+    QCOMPARE(out.stats().underruns, quint64(0));
+}
+
+void TestFxOutput::testEndOfStreamDrain()
+{
+    FxOutput out(2);
+    out.configure(1024, true);
+    std::vector<float> buf;
+
+    const std::vector<float> audio = frames(64, 0.25f);
+    out.push(audio.data(), 64);
+    out.markEndOfStream();
+    pullFrames(out, 128, buf);
+    pullFrames(out, 128, buf);
+    QCOMPARE(out.stats().underruns, quint64(0));
+    QCOMPARE(out.framesPaddedAtEnd(), quint64(64 + 128));
+
+    // Marking again keeps counting; new audio (gapless handoff) resumes
+    out.markEndOfStream();
+    QCOMPARE(out.framesPaddedAtEnd(), quint64(64 + 128));
+    out.push(audio.data(), 64);
+    pullFrames(out, 128, buf);
+    QCOMPARE(out.stats().underruns, quint64(1));
+}
+
+void TestFxOutput::testInt16Output()
+{
+    FxOutput out(2);
+    out.configure(256, false);
+    // The engine converts in its output pass; float frames are refused
+    const float wrong[2] = {0.5f, 0.5f};
+    QCOMPARE(out.push(wrong, 1), size_t(0));
+
+    const int16_t in[6] = {32767, -32767, 16383, -16383, 0, 8191};
+    QCOMPARE(out.push(in, 3), size_t(3));
+    QCOMPARE(out.bytesAvailable(), qint64(3 * 2 * sizeof(qint16)));
+
+    qint16 s16[6];
+    QCOMPARE(out.read(reinterpret_cast<char *>(s16), sizeof(s16)), qint64(sizeof(s16)));
+    for (int i = 0; i < 6; ++i)
+        QCOMPARE(s16[i], in[i]);
+}
+
+void TestFxOutput::testRenderHistogram()
+{
+    FxOutput out(2);
+    out.recordRenderTime(10 * 1000);        // 10 us
+    out.recordRenderTime(100 * 1000);       // 100 us
+    out.recordRenderTime(100 * 1000);
+    out.recordRenderTime(qint64(1) << 40);  // absurdly slow: last bucket
+
+    const FxOutputStats s = out.stats();
+    QCOMPARE(s.renderHistogram[0], quint64(1));
+    QCOMPARE(s.renderHistogram[1], quint64(2));
+    QCOMPARE(s.renderHistogram[FxOutputStats::kRenderBuckets - 1], quint64(1));
+}
+
+void TestFxOutput::testMixIntoSumsWithGainRamp()
+{
+    FxOutput deck(2), jingle(2);
+    deck.configure(1024, true);
+    jingle.configure(1024, true);
+    const std::vector<float> a = frames(256, 0.25f);
+    const std::vector<float> b = frames(100, 0.5f);
+    deck.push(a.data(), 256);
+    jingle.push(b.data(), 100);
+
+    // Unity gain: a plain, sample-aligned sum; the short source is padded
+    std::vector<float> acc(256 * 2, 0.0f);
+    deck.mixInto(acc.data(), 128);
+    jingle.mixInto(acc.data(), 128);
+    QCOMPARE(acc[0], 0.75f);
+    QCOMPARE(acc[2 * 99 + 1], 0.75f);
+    QCOMPARE(acc[2 * 100], 0.25f);
+    QCOMPARE(jingle.stats().underruns, quint64(1));
+
+    // A gain change ramps across the next block and lands on the target
+    deck.setGain(0.0f);
+    std::fill(acc.begin(), acc.end(), 0.0f);
+    deck.mixInto(acc.data(), 128);
+    for (int i = 1; i < 128; ++i)
+        QVERIFY(acc[2 * i] < acc[2 * (i - 1)]);
+    QVERIFY(acc[0] > 0.24f);
+    QCOMPARE(acc[2 * 127], 0.0f);
+}
+
+QTEST_MAIN(TestFxOutput)
@@ -0,0 +1,25 @@
+#ifndef TESTFXOUTPUT_H
+#define TESTFXOUTPUT_H
+
+#include <QtTest/QtTest>
+
+/**
+ * @brief Unit tests for the FxEngine pull-mode output device
+ *
+ * Covers the underrun accounting (start-up and end-of-stream silence are
+ * not underruns), the Int16 conversion, the render-time histogram, and
+ * mix-bus sources that sum sample-aligned with ramped gains.
+ */
+class TestFxOutput : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void testUnderrunAccounting();
+    void testEndOfStreamDrain();
+    void testInt16Output();
+    void testRenderHistogram();
+    void testMixIntoSumsWithGainRamp();
+};
+
+#endif // TESTFXOUTPUT_H
@@ -0,0 +1,78 @@
+#include "TestTrackCue.h"
+#include "../../../src/audio/FxEngine.h"
+#include "../../../src/audio/TrackAnalysisStore.h"
+#include "../../../src/audio/TrackCue.h"
+
+namespace {
+
+TrackAnalysis analysed(qint64 audioStartMs, qint64 audioEndMs)
+{
+    TrackAnalysis analysis;
+    analysis.durationMs = 200000;
+    analysis.integratedLufs = -14.0;
+    analysis.truePeakDb = -1.0;
+    analysis.audioStartMs = audioStartMs;
+    analysis.audioEndMs = audioEndMs;
+    return analysis;
+}
+
+} // namespace
+
+void TestTrackCue::testNoCue()
+{
+    const TrackCue cue = TrackCue::resolve(TrackAnalysis(), 0, 0);
+    QCOMPARE(cue.startMs, qint64(0));
+    QCOMPARE(cue.endMs, qint64(0));
+    QVERIFY(!cue.startKnown);
+    QVERIFY(!cue.endKnown());
+}
+
+void TestTrackCue::testTrimmedTrack()
+{
+    // Not analysed yet (the usual state of a freshly preloaded track):
+    // the stored trim places both ends
+    const TrackCue cue = TrackCue::resolve(TrackAnalysis(), 2500, 180000);
+    QCOMPARE(cue.startMs, qint64(2500));
+    QCOMPARE(cue.endMs, qint64(180000));
+    QVERIFY(cue.startKnown);
+}
+
+void TestTrackCue::testAnalysisStartWins()
+{
+    const TrackCue cue = TrackCue::resolve(analysed(1200, 199000), 800, 180000);
+    QCOMPARE(cue.startMs, qint64(1200));
+    QCOMPARE(cue.endMs, qint64(180000));
+    QVERIFY(cue.startKnown);
+
+    // Analysed as starting right at the top: nothing to cue
+    const TrackCue top = TrackCue::resolve(analysed(0, 199000), 0, 0);
+    QCOMPARE(top.startMs, qint64(0));
+}
+
+void TestTrackCue::testAnalysedEnd()
+{
+    const TrackCue cue = TrackCue::resolve(analysed(1200, 199000), 0, 0);
+    QCOMPARE(cue.startMs, qint64(1200));
+    QCOMPARE(cue.endMs, qint64(199000));
+    QVERIFY(cue.endKnown());
+}
+
+void TestTrackCue::testStartPastCapNotCued()
+{
+    const TrackCue cue = TrackCue::resolve(TrackAnalysis(), FxEngine::kLeadSkipCapMs + 1, 0);
+    QCOMPARE(cue.startMs, qint64(0));
+    QVERIFY(!cue.startKnown);
+
+    const TrackCue atCap = TrackCue::resolve(TrackAnalysis(), FxEngine::kLeadSkipCapMs, 0);
+    QCOMPARE(atCap.startMs, FxEngine::kLeadSkipCapMs);
+    QVERIFY(atCap.startKnown);
+}
+
+void TestTrackCue::testEndBeforeStartIgnored()
+{
+    const TrackCue cue = TrackCue::resolve(TrackAnalysis(), 5000, 4000);
+    QCOMPARE(cue.startMs, qint64(5000));
+    QCOMPARE(cue.endMs, qint64(0));
+}
+
+QTEST_MAIN(TestTrackCue)
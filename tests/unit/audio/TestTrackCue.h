@@ -0,0 +1,27 @@
+#ifndef TESTTRACKCUE_H
+#define TESTTRACKCUE_H
+
+#include <QtTest/QtTest>
+
+/**
+ * @brief Unit tests for TrackCue
+ *
+ * The cue is where both a cold start and a gapless preload open a track's
+ * decoder, and where its decode stops: the analysed start wins over the
+ * stored trim, the stored end over the analysed one, a start past the
+ * lead-skip cap is not cued, and an end at or before the start is ignored.
+ */
+class TestTrackCue : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void testNoCue();
+    void testTrimmedTrack();
+    void testAnalysisStartWins();
+    void testAnalysedEnd();
+    void testStartPastCapNotCued();
+    void testEndBeforeStartIgnored();
+};
+
+#endif // TESTTRACKCUE_H
@@ -0,0 +1,86 @@
+#include "TestWaveformData.h"
+#include "WaveformTestData.h"
+
+#include <algorithm>
+#include <cmath>
+
+void TestWaveformData::testLevelsAreExactReductions()
+{
+    const WaveformData data = syntheticWaveform(10 * 60 * 1000 + 37);
+    QCOMPARE(int(data.levels.size()), WaveformData::LevelCount);
+
+    for (int k = 1; k < WaveformData::LevelCount; ++k) {
+        const WaveformData::Level &fine = data.levels[k - 1];
+        const WaveformData::Level &coarse = data.levels[k];
+        const int factor = WaveformData::LevelMs[k] / WaveformData::LevelMs[k - 1];
+        QCOMPARE(coarse.buckets(), (fine.buckets() + factor - 1) / factor);
+        QCOMPARE(coarse.buckets(), WaveformData::bucketsAt(k, data.levels[0].buckets()));
+        for (int b = 0; b < coarse.buckets(); ++b) {
+            int lo = 127, hi = -128;
+            for (int i = b * factor; i < std::min((b + 1) * factor, fine.buckets()); ++i) {
+                lo = std::min(lo, int(fine.minMax[i * 2]));
+                hi = std::max(hi, int(fine.minMax[i * 2 + 1]));
+            }
+            if (coarse.minMax[b * 2] != lo || coarse.minMax[b * 2 + 1] != hi)
+                QFAIL(qPrintable(QStringLiteral("level %1 bucket %2 is not its children's range")
+                                     .arg(k).arg(b)));
+        }
+    }
+}
+
+void TestWaveformData::testColumnsCoverFinestLevel()
+{
+    const WaveformData data = syntheticWaveform(30 * 60 * 1000);
+    const WaveformData::Level &finest = data.levels[0];
+    const int msPerBucket = WaveformData::LevelMs[0];
+
+    // Whole track down to a zoomed-in transition strip
+    const qint64 spans[] = {data.durationMs, 10 * 60 * 1000, 25000, 2000, 300};
+    for (qint64 span : spans) {
+        const qint64 fromMs = (data.durationMs - span) / 3;
+        const qint64 toMs = fromMs + span;
+        const double msPerPx = double(span) / kColumns;
+        const int level = data.levelFor(msPerPx);
+        QVERIFY(WaveformData::LevelMs[level] <= std::max(msPerPx, double(msPerBucket)));
+        if (level + 1 < WaveformData::LevelCount)
+            QVERIFY(WaveformData::LevelMs[level + 1] > msPerPx);
+
+        QVector<qint8> columns(kColumns * 2);
+        data.reduceColumns(fromMs, toMs, kColumns, columns.data());
+
+        const auto rangeOver = [&](double ms0, double ms1, int *lo, int *hi) {
+            *lo = 127;
+            *hi = -128;
+            const int i0 = std::max(0, int(std::floor(ms0 / msPerBucket)));
+            const int i1 = std::min(finest.buckets(),
+                                    std::max(int(std::ceil(ms1 / msPerBucket)), i0 + 1));
+            for (int i = i0; i < i1; ++i) {
+                *lo = std::min(*lo, int(finest.minMax[i * 2]));
+                *hi = std::max(*hi, int(finest.minMax[i * 2 + 1]));
+            }
+        };
+        // Coarse buckets may overhang a column by less than one column
+        // (or one finest bucket when zoomed past it), never more
+        const double slack = std::max(msPerPx, double(msPerBucket));
+        for (int x = 0; x < kColumns; ++x) {
+            const double ms0 = fromMs + x * msPerPx;
+            const double ms1 = ms0 + msPerPx;
+            int exactLo, exactHi, wideLo, wideHi;
+            rangeOver(ms0, ms1, &exactLo, &exactHi);
+            rangeOver(ms0 - slack, ms1 + slack, &wideLo, &wideHi);
+            const int lo = columns[x * 2];
+            const int hi = columns[x * 2 + 1];
+            if (lo > exactLo || hi < exactHi || lo < wideLo || hi > wideHi)
+                QFAIL(qPrintable(QStringLiteral("span %1 ms column %2: %3..%4, exact %5..%6")
+                                     .arg(span).arg(x).arg(lo).arg(hi).arg(exactLo).arg(exactHi)));
+        }
+    }
+
+    // Past the end of the audio: empty columns
+    QVector<qint8> tail(4);
+    data.reduceColumns(data.durationMs + 1000, data.durationMs + 3000, 2, tail.data());
+    QVERIFY(tail[0] > tail[1]);
+    QVERIFY(tail[2] > tail[3]);
+}
+
+QTEST_MAIN(TestWaveformData)
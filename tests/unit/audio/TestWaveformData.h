@@ -0,0 +1,26 @@
+#ifndef TESTWAVEFORMDATA_H
+#define TESTWAVEFORMDATA_H
+
+#include <QtTest/QtTest>
+
+/**
+ * @brief Unit tests for the WaveformData min/max pyramid
+ *
+ * Every pyramid level must be the exact min/max of the level below it.
+ * Reducing a view to pixel columns must pick the level matching the
+ * column width and never lose a sample's extent against a reduction over
+ * the finest level.
+ */
+class TestWaveformData : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void testLevelsAreExactReductions();
+    void testColumnsCoverFinestLevel();
+
+private:
+    static constexpr int kColumns = 1200; // a maximised playlist row
+};
+
+#endif // TESTWAVEFORMDATA_H
@@ -0,0 +1,42 @@
+#ifndef WAVEFORMTESTDATA_H
+#define WAVEFORMTESTDATA_H
+
+#include "../../../src/audio/WaveformData.h"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+
+/**
+ * A programme-like waveform for the WaveformData tests and benchmarks: a
+ * slow swell with random detail, every finest bucket a valid min <= max
+ * pair, the 20 ms peaks derived from them and the pyramid built.
+ */
+inline WaveformData syntheticWaveform(qint64 durationMs)
+{
+    std::mt19937 gen(7);
+    std::uniform_int_distribution<int> jitter(0, 40);
+    const int buckets = int(durationMs / WaveformData::LevelMs[0]);
+
+    WaveformData data;
+    data.durationMs = durationMs;
+    data.levels.resize(1);
+    QVector<qint8> &minMax = data.levels[0].minMax;
+    minMax.resize(buckets * 2);
+    for (int b = 0; b < buckets; ++b) {
+        const int swell = int(60 + 50 * std::sin(b / 3000.0));
+        minMax[b * 2] = qint8(-std::min(128, swell + jitter(gen)));
+        minMax[b * 2 + 1] = qint8(std::min(127, swell + jitter(gen)));
+    }
+    const int perPeak = WaveformData::MsPerPeak / WaveformData::LevelMs[0];
+    for (int b = 0; b + perPeak <= buckets; b += perPeak) {
+        int peak = 0;
+        for (int i = b; i < b + perPeak; ++i)
+            peak = std::max({peak, -int(minMax[i * 2]), int(minMax[i * 2 + 1])});
+        data.peaks.append(quint8(std::min(255, peak * 2)));
+    }
+    data.buildLevels();
+    return data;
+}
+
+#endif // WAVEFORMTESTDATA_H
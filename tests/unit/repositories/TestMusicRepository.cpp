@@ -1,5 +1,6 @@
 #include "TestMusicRepository.h"
 #include "../../../src/repositories/MusicRepository.h"
+#include "../../../src/repositories/LibraryMigrations.h"
 #include <QSqlQuery>
 #include <QSqlError>
 #include <QSignalSpy>
@@ -55,6 +56,9 @@ void TestMusicRepository::setupTestDatabase()
         QSqlDatabase::removeDatabase("test_music_connection");
     }
     
+    // Start from an empty file, not the previous test's tables
+    QFile::remove(m_databasePath);
+    
     // Create new database connection
     m_database = QSqlDatabase::addDatabase("QSQLITE", "test_music_connection");
     m_database.setDatabaseName(m_databasePath);
@@ -355,6 +359,72 @@ void TestMusicRepository::testSearchMusicWithCriteria()
     QCOMPARE(results[0].country, QString("USA"));
 }
 
+void TestMusicRepository::testSearchMusicFullText()
+{
+    QVERIFY(!MusicRepository::hasSearchIndex(m_database));
+    
+    // Rows that predate the index are picked up by the migration
+    insertTestData();
+    QVERIFY(LibraryMigrations::apply(m_database));
+    QVERIFY(MusicRepository::hasSearchIndex(m_database));
+    
+    // Rows added afterwards are indexed by the triggers
+    QVERIFY(m_repository->addMusic(createValidMusicItem("Björk", "Jóga", m_testMusicFiles[0])));
+    QVERIFY(m_repository->addMusic(createValidMusicItem("Bjorn Again", "Waterloo", m_testMusicFiles[1])));
+    
+    MusicRepository::SearchCriteria criteria;
+    
+    // Word prefixes, case and accent insensitive
+    criteria.searchText = "bJo";
+    QCOMPARE(m_repository->searchMusic(criteria).size(), 2);
+    criteria.searchText = "joga";
+    QCOMPARE(m_repository->searchMusic(criteria).size(), 1);
+    
+    // Every word must match, in any indexed column
+    criteria.searchText = "artist song 3";
+    QList<MusicItem> results = m_repository->searchMusic(criteria);
+    QCOMPARE(results.size(), 1);
+    QCOMPARE(results[0].song, QString("Song 3"));
+    
+    // Punctuation is a separator, never FTS5 syntax
+    criteria.searchText = "\"water-loo\" OR";
+    QCOMPARE(m_repository->searchMusic(criteria).size(), 0);
+    criteria.searchText = "(*)";
+    QCOMPARE(m_repository->searchMusic(criteria).size(), 0);
+    
+    // Field criteria still filter the matches
+    criteria.searchText = "song";
+    criteria.artist = "Artist A";
+    QCOMPARE(m_repository->searchMusic(criteria).size(), 2);
+    criteria.artist.clear();
+    
+    // Best matches first
+    criteria.searchText = "rock";
+    criteria.rankByRelevance = true;
+    QVERIFY(m_repository->addMusic(createValidMusicItem("Rock Rock", "Rock", m_testMusicFiles[2])));
+    results = m_repository->searchMusic(criteria);
+    QVERIFY(results.size() > 1);
+    QCOMPARE(results[0].artist, QString("Rock Rock"));
+    
+    // Updates and deletes keep the index in step
+    criteria.rankByRelevance = false;
+    criteria.searchText = "jóga";
+    results = m_repository->searchMusic(criteria);
+    QCOMPARE(results.size(), 1);
+    MusicItem bjork = results[0];
+    bjork.song = "Hyperballad";
+    QVERIFY(m_repository->updateMusic(bjork));
+    QCOMPARE(m_repository->searchMusic(criteria).size(), 0);
+    criteria.searchText = "hyperbal";
+    QCOMPARE(m_repository->searchMusic(criteria).size(), 1);
+    QVERIFY(m_repository->deleteMusic(bjork.id));
+    QCOMPARE(m_repository->searchMusic(criteria).size(), 0);
+    
+    QSqlQuery query(m_database);
+    QVERIFY2(query.exec("INSERT INTO musics_fts(musics_fts) VALUES ('integrity-check')"),
+             qPrintable(query.lastError().text()));
+}
+
 void TestMusicRepository::testGetMusicByGenre()
 {
     insertTestData();
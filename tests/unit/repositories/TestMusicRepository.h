@@ -45,6 +45,7 @@ private slots:
     void testGetAllMusicWithLimitAndOffset();
     void testSearchMusic();
     void testSearchMusicWithCriteria();
+    void testSearchMusicFullText();
     void testGetMusicByGenre();
     void testGetMusicByGenreWithGenre2();
     void testGetMusicByArtist();
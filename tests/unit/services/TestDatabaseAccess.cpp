@@ -0,0 +1,273 @@
+#include "TestDatabaseAccess.h"
+#include "../../../src/services/DatabaseAccess.h"
+#include "../LibraryTestSchema.h"
+#include <QElapsedTimer>
+#include <QSemaphore>
+#include <QSqlQuery>
+#include <QSqlError>
+#include <QThread>
+#include <QDebug>
+
+void TestDatabaseAccess::init()
+{
+    m_tempDir = std::make_unique<QTemporaryDir>();
+    QVERIFY(m_tempDir->isValid());
+    m_databaseName = m_tempDir->path() + "/adb.db";
+
+    QSqlDatabase db = LibraryTestSchema::openDatabase("test_database_access_setup", m_databaseName);
+    QVERIFY(db.isOpen());
+    QString error;
+    QVERIFY2(LibraryTestSchema::createMusicsTable(db, &error), qPrintable(error));
+    LibraryTestSchema::closeDatabase(db, "test_database_access_setup");
+}
+
+void TestDatabaseAccess::cleanup()
+{
+    m_tempDir.reset();
+}
+
+int TestDatabaseAccess::rowCount(const QString& where)
+{
+    int count = -1;
+    {
+        QSqlDatabase db = QSqlDatabase::addDatabase("QSQLITE", "test_database_access_count");
+        db.setDatabaseName(m_databaseName);
+        if (db.open()) {
+            QSqlQuery query(db);
+            if (query.exec("SELECT COUNT(*) FROM musics" + (where.isEmpty() ? QString() : " WHERE " + where))
+                && query.next())
+                count = query.value(0).toInt();
+        }
+        db.close();
+    }
+    QSqlDatabase::removeDatabase("test_database_access_count");
+    return count;
+}
+
+void TestDatabaseAccess::testConfigureEnablesWal()
+{
+    DatabaseAccess access(m_databaseName);
+    QSqlDatabase db = access.connection();
+    QVERIFY(db.isOpen());
+    QCOMPARE(DatabaseAccess::journalMode(db), QString("wal"));
+
+    QSqlQuery query(db);
+    QVERIFY(query.exec("PRAGMA synchronous") && query.next());
+    QCOMPARE(query.value(0).toInt(), 1);   // NORMAL
+    QVERIFY(query.exec("PRAGMA cache_size") && query.next());
+    QCOMPARE(query.value(0).toInt(), -16 * 1024);
+    query.finish();
+
+    // The journal mode belongs to the file: a plain connection sees it too
+    {
+        QSqlDatabase plain = QSqlDatabase::addDatabase("QSQLITE", "test_database_access_plain");
+        plain.setDatabaseName(m_databaseName);
+        QVERIFY(plain.open());
+        QCOMPARE(DatabaseAccess::journalMode(plain), QString("wal"));
+        plain.close();
+    }
+    QSqlDatabase::removeDatabase("test_database_access_plain");
+
+    // Nothing to do for other drivers, and a closed connection is an error
+    QSqlDatabase closed = QSqlDatabase::addDatabase("QSQLITE", "test_database_access_closed");
+    QVERIFY(!DatabaseAccess::configure(closed));
+    closed = QSqlDatabase();
+    QSqlDatabase::removeDatabase("test_database_access_closed");
+}
+
+void TestDatabaseAccess::testConnectionPerThread()
+{
+    DatabaseAccess access(m_databaseName);
+    const QString mine = access.connection().connectionName();
+    QCOMPARE(access.connection().connectionName(), mine);
+
+    QString theirs;
+    bool theirsOpen = false;
+    QThread* thread = QThread::create([&]() {
+        QSqlDatabase db = access.connection();
+        theirs = db.connectionName();
+        theirsOpen = db.isOpen();
+    });
+    thread->start();
+    QVERIFY(thread->wait(5000));
+    delete thread;
+
+    QVERIFY(theirsOpen);
+    QVERIFY(theirs != mine);
+    // Removed with the thread that owned it
+    QVERIFY(!QSqlDatabase::contains(theirs));
+    QVERIFY(QSqlDatabase::contains(mine));
+}
+
+void TestDatabaseAccess::testWorkerConnectionIsTuned()
+{
+    DatabaseAccess::Tuning tuning;
+    tuning.busyTimeoutMs = 1234;
+    {
+        QSqlDatabase db = DatabaseAccess::openConnection("test_database_access_worker", "QSQLITE",
+                                                         m_databaseName, tuning);
+        QVERIFY2(db.isOpen(), qPrintable(db.lastError().text()));
+        QCOMPARE(DatabaseAccess::journalMode(db), QString("wal"));
+
+        QSqlQuery query(db);
+        QVERIFY(query.exec("PRAGMA busy_timeout") && query.next());
+        QCOMPARE(query.value(0).toInt(), 1234);
+        QVERIFY(query.exec("PRAGMA cache_size") && query.next());
+        QCOMPARE(query.value(0).toInt(), -16 * 1024);
+    }
+    DatabaseAccess::closeConnection("test_database_access_worker");
+    QVERIFY(!QSqlDatabase::contains("test_database_access_worker"));
+
+    // A failed open leaves a closed connection that still has to be released
+    {
+        QSqlDatabase db = DatabaseAccess::openConnection("test_database_access_missing", "QSQLITE",
+                                                         m_tempDir->path() + "/missing/adb.db");
+        QVERIFY(!db.isOpen());
+    }
+    DatabaseAccess::closeConnection("test_database_access_missing");
+    QVERIFY(!QSqlDatabase::contains("test_database_access_missing"));
+}
+
+void TestDatabaseAccess::testConcurrentWritesAreBatched()
+{
+    const int threads = 4;
+    const int writesPerThread = 500;
+    {
+        DatabaseAccess access(m_databaseName);
+        QList<QThread*> writers;
+        for (int t = 0; t < threads; ++t) {
+            writers << QThread::create([&access, t, writesPerThread]() {
+                for (int i = 0; i < writesPerThread; ++i) {
+                    access.write("INSERT INTO musics (artist, song, genre1, path, played_times) VALUES (?, 'Song', 'Rock', ?, 0)",
+                                 {QString("Artist %1").arg(t), QString("/music/%1/%2.mp3").arg(t).arg(i)});
+                }
+            });
+            writers.last()->start();
+        }
+        for (QThread* writer : writers) {
+            QVERIFY(writer->wait(10000));
+            delete writer;
+        }
+
+        QVERIFY(access.flush(30000));
+        QCOMPARE(access.pendingWrites(), 0);
+
+        const DatabaseAccess::Statistics stats = access.statistics();
+        QCOMPARE(stats.jobs, qint64(threads * writesPerThread));
+        QCOMPARE(stats.failed, qint64(0));
+        // Writes queued behind a commit share the next one
+        QVERIFY2(stats.batches < stats.jobs,
+                 qPrintable(QString("%1 batches for %2 writes").arg(stats.batches).arg(stats.jobs)));
+        qDebug() << stats.jobs << "writes in" << stats.batches << "transactions, queue peaked at" << stats.maxQueued;
+    }
+    QCOMPARE(rowCount(), threads * writesPerThread);
+}
+
+void TestDatabaseAccess::testFailingJobRollsBackAlone()
+{
+    DatabaseAccess access(m_databaseName);
+    QSignalSpy failures(&access, &DatabaseAccess::writeFailed);
+
+    access.write("INSERT INTO musics (artist, song, genre1, path) VALUES (?, 'Song', 'Rock', ?)", {"Before", "/music/before.mp3"});
+    const bool failed = access.writeAndWait([](QSqlDatabase& db) {
+        QSqlQuery query(db);
+        query.exec("INSERT INTO musics (artist, song, genre1, path) VALUES ('Half', 'Song', 'Rock', '/music/half.mp3')");
+        return false;
+    });
+    // NOT NULL artist: the statement itself fails
+    access.write("INSERT INTO musics (artist, song, genre1, path) VALUES (?, 'Song', 'Rock', ?)", {QVariant(), "/music/null.mp3"});
+    const bool after = access.writeAndWait([](QSqlDatabase& db) {
+        QSqlQuery query(db);
+        return query.exec("INSERT INTO musics (artist, song, genre1, path) VALUES ('After', 'Song', 'Rock', '/music/after.mp3')");
+    });
+
+    QVERIFY(!failed);
+    QVERIFY(after);
+    QCOMPARE(rowCount(), 2);
+    QCOMPARE(rowCount("artist = 'Half'"), 0);
+    QCOMPARE(access.statistics().failed, qint64(2));
+    QCOMPARE(failures.count(), 1);
+}
+
+void TestDatabaseAccess::testReadersDoNotWaitForWriter()
+{
+    DatabaseAccess access(m_databaseName);
+    access.write("INSERT INTO musics (artist, song, genre1, path) VALUES (?, 'Song', 'Rock', ?)", {"Committed", "/music/committed.mp3"});
+    QVERIFY(access.flush(5000));
+
+    // Hold the write transaction open, as a long import batch would
+    QSemaphore inside;
+    QSemaphore release;
+    access.write([&](QSqlDatabase& db) {
+        QSqlQuery query(db);
+        query.exec("INSERT INTO musics (artist, song, genre1, path) VALUES ('Pending', 'Song', 'Rock', '/music/pending.mp3')");
+        inside.release();
+        release.tryAcquire(1, 10000);
+        return true;
+    });
+    QVERIFY(inside.tryAcquire(1, 5000));
+
+    QElapsedTimer clock;
+    clock.start();
+    QSqlQuery query(access.connection());
+    QVERIFY2(query.exec("SELECT COUNT(*) FROM musics") && query.next(), qPrintable(query.lastError().text()));
+    const qint64 readMs = clock.elapsed();
+    QCOMPARE(query.value(0).toInt(), 1);   // the snapshot before the open transaction
+    query.finish();
+
+    release.release();
+    QVERIFY(access.flush(5000));
+    QVERIFY2(readMs < 1000, qPrintable(QString("read waited %1 ms for the writer").arg(readMs)));
+    QCOMPARE(rowCount(), 2);
+}
+
+void TestDatabaseAccess::testLockedOutBatchIsRetried()
+{
+    DatabaseAccess::Tuning tuning;
+    tuning.busyTimeoutMs = 100;
+    DatabaseAccess access(m_databaseName, tuning);
+    QVERIFY(access.connection().isOpen());   // WAL before the lock is taken
+    QSignalSpy failures(&access, &DatabaseAccess::writeFailed);
+
+    // Another process holds the write lock past the busy timeout
+    {
+        QSqlDatabase locker = QSqlDatabase::addDatabase("QSQLITE", "test_database_access_locker");
+        locker.setDatabaseName(m_databaseName);
+        QVERIFY(locker.open());
+        QSqlQuery lock(locker);
+
+        // Released before the retries run out: the batch still lands
+        QVERIFY(lock.exec("BEGIN IMMEDIATE"));
+        access.write("INSERT INTO musics (artist, song, genre1, path) VALUES (?, 'Song', 'Rock', ?)", {"Artist", "/music/late.mp3"});
+        QThread::msleep(200);
+        QVERIFY(lock.exec("COMMIT"));
+        QVERIFY(access.flush(10000));
+        QCOMPARE(rowCount(), 1);
+        QCOMPARE(failures.count(), 0);
+
+        // Held through every attempt: dropped, and reported
+        QVERIFY(lock.exec("BEGIN IMMEDIATE"));
+        access.write("INSERT INTO musics (artist, song, genre1, path) VALUES (?, 'Song', 'Rock', ?)", {"Artist", "/music/lost.mp3"});
+        QVERIFY(access.flush(10000));
+        QVERIFY(lock.exec("COMMIT"));
+        lock.finish();
+        locker.close();
+    }
+    QSqlDatabase::removeDatabase("test_database_access_locker");
+
+    QCOMPARE(rowCount(), 1);
+    QCOMPARE(failures.count(), 1);
+    QCOMPARE(access.statistics().failed, qint64(1));
+}
+
+void TestDatabaseAccess::testDestructorFlushes()
+{
+    {
+        DatabaseAccess access(m_databaseName);
+        for (int i = 0; i < 200; ++i)
+            access.write("INSERT INTO musics (artist, song, genre1, path) VALUES (?, 'Song', 'Rock', ?)", {"Artist", QString("/music/%1.mp3").arg(i)});
+    }
+    QCOMPARE(rowCount(), 200);
+}
+
+QTEST_MAIN(TestDatabaseAccess)
@@ -0,0 +1,39 @@
+#ifndef TESTDATABASEACCESS_H
+#define TESTDATABASEACCESS_H
+
+#include <QtTest/QtTest>
+#include <QTemporaryDir>
+#include <memory>
+
+/**
+ * @brief Unit tests for DatabaseAccess class
+ *
+ * Tests connection tuning (WAL and friends), per-thread connections, the
+ * serialized writer's batching and savepoints, and that readers keep
+ * going while the writer holds its transaction.
+ */
+class TestDatabaseAccess : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void init();
+    void cleanup();
+
+    void testConfigureEnablesWal();
+    void testConnectionPerThread();
+    void testWorkerConnectionIsTuned();
+    void testConcurrentWritesAreBatched();
+    void testFailingJobRollsBackAlone();
+    void testReadersDoNotWaitForWriter();
+    void testLockedOutBatchIsRetried();
+    void testDestructorFlushes();
+
+private:
+    int rowCount(const QString& where = QString());
+
+    std::unique_ptr<QTemporaryDir> m_tempDir;
+    QString m_databaseName;
+};
+
+#endif // TESTDATABASEACCESS_H
@@ -1,11 +1,13 @@
 #include "TestDatabaseOptimizer.h"
 #include "../../../src/services/DatabaseOptimizer.h"
+#include "../../../src/services/QueryProfiler.h"
 #include <QSqlQuery>
 #include <QSqlError>
 #include <QSignalSpy>
 #include <QThread>
 #include <QJsonDocument>
 #include <QJsonObject>
+#include <QJsonArray>
 
 void TestDatabaseOptimizer::initTestCase()
 {
@@ -623,6 +625,106 @@ void TestDatabaseOptimizer::testExportPerformanceData()
     QVERIFY(metrics.contains("pageSize"));
 }
 
+void TestDatabaseOptimizer::testProfiledQueriesRecommendIndexes()
+{
+    QVERIFY(m_optimizer->initialize());
+    
+    QSqlQuery query(m_database);
+    QVERIFY(query.exec("CREATE TABLE musics (artist TEXT, song TEXT, genre1 TEXT, path TEXT)"));
+    for (int i = 0; i < 200; ++i) {
+        query.prepare("INSERT INTO musics VALUES (?, ?, ?, ?)");
+        query.addBindValue(QString("Artist %1").arg(i));
+        query.addBindValue(QString("Song %1").arg(i));
+        query.addBindValue(i % 2 ? "Rock" : "Jazz");
+        query.addBindValue(QString("/music/%1.mp3").arg(i));
+        QVERIFY(query.exec());
+    }
+    
+    // Every statement counts as slow, so each pattern gets its plan
+    m_optimizer->startQueryMonitoring(0);
+    QVERIFY(QueryProfiler::isAttached());
+    
+    QSqlQuery byPath(m_database);
+    byPath.prepare("SELECT artist FROM musics WHERE path = ?");
+    byPath.addBindValue("/music/7.mp3");
+    QVERIFY(QueryProfiler::exec(byPath));
+    QVERIFY(byPath.next());
+    QCOMPARE(byPath.value(0).toString(), QString("Artist 7"));
+    
+    QSqlQuery byGenre(m_database);
+    byGenre.prepare("SELECT m.path FROM musics m WHERE m.genre1 LIKE ? ORDER BY m.artist");
+    byGenre.addBindValue("rock");
+    QVERIFY(QueryProfiler::exec(byGenre));
+    QVERIFY(byGenre.next());
+    
+    QList<DatabaseOptimizer::QueryStats> slowQueries = m_optimizer->getSlowQueries();
+    QCOMPARE(slowQueries.size(), 2);
+    for (const auto& stats : slowQueries) {
+        QVERIFY2(stats.queryPlan.contains("SCAN"), qPrintable(stats.queryPlan));
+    }
+    
+    QCOMPARE(m_optimizer->createRecommendedIndexes(), 2);
+    QSqlQuery check(m_database);
+    QVERIFY(check.exec("SELECT name FROM sqlite_master WHERE type = 'index' AND name LIKE 'idx_auto_%' ORDER BY name"));
+    QStringList created;
+    while (check.next()) {
+        created << check.value(0).toString();
+    }
+    QCOMPARE(created, QStringList({"idx_auto_musics_genre1_nocase", "idx_auto_musics_path"}));
+    
+    // The plans are captured again, now through the new indexes
+    QVERIFY(QueryProfiler::exec(byPath));
+    QVERIFY(QueryProfiler::exec(byGenre));
+    for (const auto& stats : m_optimizer->getSlowQueries()) {
+        QVERIFY2(stats.queryPlan.contains("USING INDEX idx_auto_musics"), qPrintable(stats.queryPlan));
+    }
+    QCOMPARE(m_optimizer->createRecommendedIndexes(), 0);
+}
+
+void TestDatabaseOptimizer::testProfilerDetaches()
+{
+    m_optimizer->startQueryMonitoring();
+    QVERIFY(QueryProfiler::isAttached());
+    m_optimizer->stopQueryMonitoring();
+    QVERIFY(!QueryProfiler::isAttached());
+    
+    // Unrecorded, but still executed
+    QSqlQuery query(m_database);
+    QVERIFY(QueryProfiler::exec(query, "SELECT COUNT(*) FROM music"));
+    QVERIFY(query.next());
+    QVERIFY(m_optimizer->getQueryStatistics().isEmpty());
+    
+    // Destroying the optimizer detaches it too
+    m_optimizer->startQueryMonitoring();
+    m_optimizer.reset();
+    QVERIFY(!QueryProfiler::isAttached());
+    m_optimizer = std::make_unique<DatabaseOptimizer>(m_database, this);
+}
+
+void TestDatabaseOptimizer::testPerformanceReport()
+{
+    QVERIFY(m_optimizer->initialize());
+    m_optimizer->startQueryMonitoring();
+    m_optimizer->recordQueryExecution("SELECT * FROM music WHERE artist = 'A'", 5);
+    m_optimizer->recordQueryExecution("SELECT * FROM music WHERE song = 'B'", 20);
+    m_optimizer->recordQueryExecution("SELECT * FROM music WHERE artist = 'C'", 10);
+    
+    QSignalSpy spy(m_optimizer.get(), &DatabaseOptimizer::performanceReport);
+    m_optimizer->setReportInterval(50, 1);
+    QCOMPARE(m_optimizer->reportInterval(), 50);
+    QVERIFY(spy.wait(2000));
+    m_optimizer->setReportInterval(0);
+    QCOMPARE(m_optimizer->reportInterval(), 0);
+    
+    // Top pattern by total time only
+    const QJsonObject report = QJsonDocument::fromJson(spy.first().first().toString().toUtf8()).object();
+    const QJsonArray top = report["queryStatistics"].toArray();
+    QCOMPARE(top.size(), 1);
+    QCOMPARE(top.first().toObject()["queryPattern"].toString(),
+             QString("SELECT * FROM MUSIC WHERE SONG = '?'"));
+    QCOMPARE(top.first().toObject()["totalExecutionTime"].toInt(), 20);
+}
+
 void TestDatabaseOptimizer::testErrorHandling()
 {
     QVERIFY(m_optimizer->initialize());
@@ -69,6 +69,11 @@ private slots:
     void testGetColumnNames();
     void testExportPerformanceData();
 
+    // Profiling tests
+    void testProfiledQueriesRecommendIndexes();
+    void testProfilerDetaches();
+    void testPerformanceReport();
+
     // Error handling tests
     void testErrorHandling();
     void testInvalidDatabase();
@@ -0,0 +1,260 @@
+#include "TestLibraryImporter.h"
+#include "../../../src/services/LibraryImporter.h"
+#include "../../../src/repositories/LibraryMigrations.h"
+#include "../LibraryTestSchema.h"
+#include <QSignalSpy>
+#include <QSqlQuery>
+#include <QSqlError>
+#include <QFile>
+#include <QDir>
+#include <QThread>
+#include <QDebug>
+
+void TestLibraryImporter::initTestCase()
+{
+    qRegisterMetaType<LibraryImporter::Statistics>("LibraryImporter::Statistics");
+}
+
+void TestLibraryImporter::init()
+{
+    m_tempDir = std::make_unique<QTemporaryDir>();
+    QVERIFY(m_tempDir->isValid());
+
+    m_libraryDir = m_tempDir->path() + "/library";
+    QVERIFY(QDir().mkpath(m_libraryDir + "/rock/live"));
+
+    m_connectionName = "test_library_importer";
+    m_database = LibraryTestSchema::openDatabase(m_connectionName, m_tempDir->path() + "/adb.db");
+    QVERIFY(m_database.isOpen());
+
+    QString error;
+    QVERIFY2(LibraryTestSchema::createMusicsTable(m_database, &error), qPrintable(error));
+    QVERIFY(LibraryMigrations::apply(m_database));
+}
+
+void TestLibraryImporter::cleanup()
+{
+    LibraryTestSchema::closeDatabase(m_database, m_connectionName);
+    m_tempDir.reset();
+}
+
+void TestLibraryImporter::createFiles(const QString& directory, const QString& pattern, int count)
+{
+    // The importer never decodes anything itself, so empty files will do
+    for (int i = 1; i <= count; ++i) {
+        QFile file(directory + "/" + pattern.arg(i));
+        QVERIFY(file.open(QIODevice::WriteOnly));
+    }
+}
+
+int TestLibraryImporter::rowCount(const QString& where)
+{
+    QSqlQuery query(m_database);
+    if (!query.exec("SELECT COUNT(*) FROM musics" + (where.isEmpty() ? QString() : " WHERE " + where))
+        || !query.next()) {
+        return -1;
+    }
+    return query.value(0).toInt();
+}
+
+void TestLibraryImporter::testItemForFile()
+{
+    LibraryImporter::Options options;
+    options.genre1 = "Pop";
+    options.genre2 = "Rock";
+    options.country = "Other country / language";
+    options.publishedDate = "2024/01/31";
+
+    MusicItem music = LibraryImporter::itemForFile("/music", "/music/Some_Band - A_Song.mp3", options);
+    QCOMPARE(music.artist, QString("Some Band"));
+    QCOMPARE(music.song, QString("A Song"));
+    QCOMPARE(music.genre1, QString("Pop"));
+    QCOMPARE(music.genre2, QString("Rock"));
+    QCOMPARE(music.country, QString("Other country / language"));
+    QCOMPARE(music.publishedDate, QString("2024/01/31"));
+    QCOMPARE(music.path, QString("/music/Some_Band - A_Song.mp3"));
+    QVERIFY(music.time.isEmpty());
+
+    // Extensions the old replace list never knew about are dropped too
+    music = LibraryImporter::itemForFile("/music", "/music/Band - Tune.opus", options);
+    QCOMPARE(music.song, QString("Tune"));
+
+    // No separator: the whole name is the artist and the song is "-"
+    music = LibraryImporter::itemForFile("/music", "/music/Untitled.flac", options);
+    QCOMPARE(music.artist, QString("Untitled"));
+    QCOMPARE(music.song, QString("-"));
+
+    // Subdirectories are part of the artist, as they always were
+    music = LibraryImporter::itemForFile("/music", "/music/live/Band - Tune.ogg", options);
+    QCOMPARE(music.artist, QString("live/Band"));
+
+    // An artist given in the dialog wins over the file name
+    options.artist = "Given Artist";
+    music = LibraryImporter::itemForFile("/music", "/music/Band - Tune.mp3", options);
+    QCOMPARE(music.artist, QString("Given Artist"));
+    QCOMPARE(music.song, QString("Tune"));
+}
+
+void TestLibraryImporter::testImportDirectoryTree()
+{
+    createFiles(m_libraryDir, "Artist_A - Song %1.mp3", 40);
+    createFiles(m_libraryDir + "/rock", "Band - Track %1.FLAC", 40);
+    createFiles(m_libraryDir + "/rock/live", "Band - Live %1.ogg", 40);
+    createFiles(m_libraryDir, "cover%1.jpg", 1);
+    createFiles(m_libraryDir + "/rock", "notes%1.txt", 1);
+
+    LibraryImporter importer(m_database);
+    std::atomic<int> probed{0};
+    importer.setDurationProbe([&probed](const QString&) {
+        ++probed;
+        return qint64(225000);
+    });
+
+    QSignalSpy rowsSpy(&importer, &LibraryImporter::rowsAdded);
+    QSignalSpy finishedSpy(&importer, &LibraryImporter::finished);
+
+    LibraryImporter::Options options;
+    options.directory = m_libraryDir;
+    options.batchSize = 16;
+    options.extractors = 3;
+    options.genre1 = "Pop";
+    options.country = "Other country / language";
+    options.publishedDate = "2024/01/31";
+    QVERIFY(importer.start(options));
+    QVERIFY(importer.isRunning());
+    QVERIFY(!importer.start(options));
+
+    QVERIFY(finishedSpy.wait(10000));
+    QCOMPARE(finishedSpy.count(), 1);
+    QVERIFY(!importer.isRunning());
+
+    const auto stats = finishedSpy.first().first().value<LibraryImporter::Statistics>();
+    QCOMPARE(stats.filesFound, 120);
+    QCOMPARE(stats.imported, 120);
+    QCOMPARE(stats.duplicates, 0);
+    QCOMPARE(stats.failed, 0);
+    QVERIFY(!stats.cancelled);
+    QCOMPARE(probed.load(), 120);
+
+    // One rowsAdded per committed batch, never per row
+    int added = 0;
+    for (const QList<QVariant>& arguments : rowsSpy) {
+        QVERIFY(arguments.first().toInt() <= options.batchSize);
+        added += arguments.first().toInt();
+    }
+    QCOMPARE(added, 120);
+    QVERIFY(rowsSpy.count() >= 120 / options.batchSize);
+
+    QCOMPARE(rowCount(), 120);
+    QCOMPARE(rowCount("time = '0:03:45' AND genre1 = 'Pop' AND played_times = 0"), 120);
+    QCOMPARE(rowCount("artist = 'rock/live/Band' AND song LIKE 'Live %'"), 40);
+
+    // Imported rows are searchable right away through the triggers
+    QSqlQuery query(m_database);
+    QVERIFY(query.exec("SELECT COUNT(*) FROM musics_fts WHERE musics_fts MATCH 'track'"));
+    QVERIFY(query.next());
+    QCOMPARE(query.value(0).toInt(), 40);
+
+    QVERIFY(query.exec("SELECT name FROM sqlite_master WHERE type = 'index' AND name = 'idx_musics_path'"));
+    QVERIFY(query.next());
+}
+
+void TestLibraryImporter::testNonRecursiveImport()
+{
+    createFiles(m_libraryDir, "Artist - Song %1.mp3", 5);
+    createFiles(m_libraryDir + "/rock", "Band - Track %1.mp3", 5);
+
+    LibraryImporter importer(m_database);
+    LibraryImporter::Options options;
+    options.directory = m_libraryDir;
+    options.recursive = false;
+    QVERIFY(importer.start(options));
+    QVERIFY(importer.waitForFinished(10000));
+
+    QCOMPARE(importer.statistics().imported, 5);
+    QCOMPARE(rowCount(), 5);
+    QCOMPARE(rowCount("path LIKE '%/rock/%'"), 0);
+}
+
+void TestLibraryImporter::testSkipsKnownPaths()
+{
+    createFiles(m_libraryDir, "Artist - Song %1.mp3", 30);
+
+    // Ten of them are already in the library
+    QSqlQuery insert(m_database);
+    insert.prepare("INSERT INTO musics VALUES (NULL, 'Artist', ?, 'Pop', '', '', '', ?, '', 0, '')");
+    for (int i = 1; i <= 10; ++i) {
+        insert.addBindValue(QString("Song %1").arg(i));
+        insert.addBindValue(m_libraryDir + QString("/Artist - Song %1.mp3").arg(i));
+        QVERIFY(insert.exec());
+    }
+
+    LibraryImporter importer(m_database);
+    QSignalSpy finishedSpy(&importer, &LibraryImporter::finished);
+    LibraryImporter::Options options;
+    options.directory = m_libraryDir;
+    options.batchSize = 7;
+    QVERIFY(importer.start(options));
+    QVERIFY(importer.waitForFinished(10000));
+    QCOMPARE(finishedSpy.count(), 1);
+
+    LibraryImporter::Statistics stats = importer.statistics();
+    QCOMPARE(stats.filesFound, 30);
+    QCOMPARE(stats.imported, 20);
+    QCOMPARE(stats.duplicates, 10);
+    QCOMPARE(rowCount(), 30);
+
+    // A second pass finds nothing new
+    QVERIFY(importer.start(options));
+    QVERIFY(importer.waitForFinished(10000));
+    stats = importer.statistics();
+    QCOMPARE(stats.imported, 0);
+    QCOMPARE(stats.duplicates, 30);
+    QCOMPARE(rowCount(), 30);
+    QCOMPARE(finishedSpy.count(), 2);
+}
+
+void TestLibraryImporter::testCancel()
+{
+    createFiles(m_libraryDir, "Artist - Song %1.mp3", 200);
+
+    LibraryImporter importer(m_database);
+    // A slow probe keeps the pipeline busy long enough to cancel it
+    importer.setDurationProbe([](const QString&) {
+        QThread::msleep(20);
+        return qint64(0);
+    });
+
+    QSignalSpy finishedSpy(&importer, &LibraryImporter::finished);
+    LibraryImporter::Options options;
+    options.directory = m_libraryDir;
+    options.batchSize = 10;
+    options.extractors = 2;
+    QVERIFY(importer.start(options));
+
+    QTest::qWait(150);
+    importer.cancel();
+    QVERIFY(importer.waitForFinished(10000));
+    QVERIFY(!importer.isRunning());
+    QCOMPARE(finishedSpy.count(), 1);
+
+    const LibraryImporter::Statistics stats = importer.statistics();
+    QVERIFY(stats.cancelled);
+    QVERIFY(stats.imported < 200);
+    // Whatever was committed stays committed
+    QCOMPARE(rowCount(), stats.imported);
+}
+
+void TestLibraryImporter::testMissingDirectory()
+{
+    LibraryImporter importer(m_database);
+    QSignalSpy errorSpy(&importer, &LibraryImporter::importError);
+
+    LibraryImporter::Options options;
+    options.directory = m_tempDir->path() + "/does-not-exist";
+    QVERIFY(!importer.start(options));
+    QVERIFY(!importer.isRunning());
+    QCOMPARE(errorSpy.count(), 1);
+}
+
+QTEST_MAIN(TestLibraryImporter)
@@ -0,0 +1,42 @@
+#ifndef TESTLIBRARYIMPORTER_H
+#define TESTLIBRARYIMPORTER_H
+
+#include <QtTest/QtTest>
+#include <QTemporaryDir>
+#include <QSqlDatabase>
+#include <memory>
+
+/**
+ * @brief Unit tests for LibraryImporter class
+ *
+ * Tests the parallel import pipeline against a real directory tree and
+ * library database: file name parsing, batching, duplicate detection
+ * and cancellation.
+ */
+class TestLibraryImporter : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void init();
+    void cleanup();
+
+    void testItemForFile();
+    void testImportDirectoryTree();
+    void testNonRecursiveImport();
+    void testSkipsKnownPaths();
+    void testCancel();
+    void testMissingDirectory();
+
+private:
+    void createFiles(const QString& directory, const QString& pattern, int count);
+    int rowCount(const QString& where = QString());
+
+    std::unique_ptr<QTemporaryDir> m_tempDir;
+    QString m_libraryDir;
+    QSqlDatabase m_database;
+    QString m_connectionName;
+};
+
+#endif // TESTLIBRARYIMPORTER_H
@@ -0,0 +1,295 @@
+#include "TestLibraryRescanner.h"
+#include "../../../src/services/LibraryRescanner.h"
+#include "../../../src/repositories/LibraryMigrations.h"
+#include "../LibraryTestSchema.h"
+#include <QSignalSpy>
+#include <QSqlQuery>
+#include <QSqlError>
+#include <QFile>
+#include <QFileInfo>
+#include <QDir>
+#include <QDebug>
+
+void TestLibraryRescanner::initTestCase()
+{
+    qRegisterMetaType<LibraryRescanner::Statistics>("LibraryRescanner::Statistics");
+}
+
+void TestLibraryRescanner::init()
+{
+    m_tempDir = std::make_unique<QTemporaryDir>();
+    QVERIFY(m_tempDir->isValid());
+
+    m_root = m_tempDir->path() + "/library";
+    QVERIFY(QDir().mkpath(m_root + "/rock"));
+
+    m_connectionName = "test_library_rescanner";
+    m_database = LibraryTestSchema::openDatabase(m_connectionName, m_tempDir->path() + "/adb.db");
+    QVERIFY(m_database.isOpen());
+
+    QString error;
+    QVERIFY2(LibraryTestSchema::createMusicsTable(m_database, &error), qPrintable(error));
+    QVERIFY(LibraryMigrations::apply(m_database));
+}
+
+void TestLibraryRescanner::cleanup()
+{
+    LibraryTestSchema::closeDatabase(m_database, m_connectionName);
+    m_tempDir.reset();
+}
+
+void TestLibraryRescanner::writeFile(const QString& path, const QByteArray& content)
+{
+    QFile file(path);
+    QVERIFY(file.open(QIODevice::WriteOnly | QIODevice::Truncate));
+    QCOMPARE(file.write(content), qint64(content.size()));
+}
+
+void TestLibraryRescanner::setModified(const QString& path, const QDateTime& time)
+{
+    QFile file(path);
+    QVERIFY(file.open(QIODevice::ReadWrite));
+    QVERIFY(file.setFileTime(time, QFileDevice::FileModificationTime));
+}
+
+bool TestLibraryRescanner::rescan(LibraryRescanner& rescanner)
+{
+    LibraryRescanner::Options options;
+    options.roots << m_root;
+    options.batchSize = 3;
+    options.rowDefaults.genre1 = "Pop";
+    return rescanner.start(options) && rescanner.waitForFinished(10000);
+}
+
+int TestLibraryRescanner::rowCount(const QString& where)
+{
+    return value("SELECT COUNT(*) FROM musics" + (where.isEmpty() ? QString() : " WHERE " + where)).toInt();
+}
+
+QVariant TestLibraryRescanner::value(const QString& sql)
+{
+    QSqlQuery query(m_database);
+    if (!query.exec(sql) || !query.next())
+        return QVariant();
+    return query.value(0);
+}
+
+void TestLibraryRescanner::testContentHash()
+{
+    const QString a = m_root + "/a.mp3";
+    const QString b = m_root + "/b.mp3";
+    writeFile(a, QByteArray(200 * 1024, 'x'));
+    writeFile(b, QByteArray(200 * 1024, 'x'));
+
+    const QByteArray hash = LibraryRescanner::contentHash(a);
+    QVERIFY(!hash.isEmpty());
+    QCOMPARE(LibraryRescanner::contentHash(b), hash);
+
+    // A change near the end is seen; so is a change of size alone
+    QByteArray tail(200 * 1024, 'x');
+    tail[tail.size() - 10] = 'y';
+    writeFile(b, tail);
+    QVERIFY(LibraryRescanner::contentHash(b) != hash);
+    writeFile(b, QByteArray(200 * 1024 + 1, 'x'));
+    QVERIFY(LibraryRescanner::contentHash(b) != hash);
+
+    QVERIFY(LibraryRescanner::contentHash(m_root + "/missing.mp3").isEmpty());
+}
+
+void TestLibraryRescanner::testFirstRescanRecordsManifest()
+{
+    // A library imported before the manifest existed
+    QSqlQuery insert(m_database);
+    insert.prepare("INSERT INTO musics VALUES (NULL, 'Artist', ?, 'Pop', '', '', '', ?, '0:03:00', 7, '')");
+    for (int i = 1; i <= 5; ++i) {
+        const QString path = m_root + QString("/Artist - Song %1.mp3").arg(i);
+        writeFile(path, "audio");
+        insert.addBindValue(QString("Song %1").arg(i));
+        insert.addBindValue(path);
+        QVERIFY(insert.exec());
+    }
+
+    LibraryRescanner rescanner(m_database);
+    QVERIFY(rescan(rescanner));
+    LibraryRescanner::Statistics stats = rescanner.statistics();
+    QCOMPARE(stats.scanned, 5);
+    QCOMPARE(stats.changes(), 0);
+    QCOMPARE(stats.failed, 0);
+    QCOMPARE(value("SELECT COUNT(*) FROM library_files").toInt(), 5);
+    QCOMPARE(rowCount("played_times = 7 AND time = '0:03:00'"), 5);
+
+    // Nothing changed on disk: every file is answered by the manifest
+    QVERIFY(rescan(rescanner));
+    stats = rescanner.statistics();
+    QCOMPARE(stats.scanned, 5);
+    QCOMPARE(stats.unchanged, 5);
+    QCOMPARE(stats.changes(), 0);
+}
+
+void TestLibraryRescanner::testAddsNewFiles()
+{
+    writeFile(m_root + "/Some_Band - A_Song.mp3", "one");
+    writeFile(m_root + "/rock/Band - Track.ogg", "two");
+    writeFile(m_root + "/rock/cover.jpg", "not audio");
+
+    LibraryRescanner rescanner(m_database);
+    rescanner.setDurationProbe([](const QString&) { return qint64(225000); });
+    QSignalSpy finishedSpy(&rescanner, &LibraryRescanner::finished);
+    QVERIFY(rescan(rescanner));
+    QCOMPARE(finishedSpy.count(), 1);
+
+    const LibraryRescanner::Statistics stats = rescanner.statistics();
+    QCOMPARE(stats.scanned, 2);
+    QCOMPARE(stats.added, 2);
+    QCOMPARE(rowCount(), 2);
+
+    // Named relative to the root, like "Add directory" does
+    QCOMPARE(rowCount("artist = 'Some Band' AND song = 'A Song' AND genre1 = 'Pop' AND time = '0:03:45'"), 1);
+    QCOMPARE(rowCount("artist = 'rock/Band' AND song = 'Track'"), 1);
+
+    // New files are hashed into the manifest right away
+    QCOMPARE(value("SELECT COUNT(*) FROM library_files WHERE hash IS NOT NULL").toInt(), 2);
+}
+
+void TestLibraryRescanner::testUpdatesChangedFiles()
+{
+    const QString path = m_root + "/Artist - Song.mp3";
+    writeFile(path, QByteArray(100, 'a'));
+    setModified(path, QDateTime::currentDateTime().addSecs(-3600));
+
+    LibraryRescanner rescanner(m_database);
+    // Duration follows the content, one second per byte
+    rescanner.setDurationProbe([](const QString& filePath) {
+        return QFileInfo(filePath).size() * 1000;
+    });
+    QVERIFY(rescan(rescanner));
+    QCOMPARE(value("SELECT time FROM musics").toString(), QString("0:01:40"));
+
+    // Same bytes, new time stamp: only the manifest moves
+    setModified(path, QDateTime::currentDateTime().addSecs(-1800));
+    QVERIFY(rescan(rescanner));
+    QCOMPARE(rescanner.statistics().updated, 0);
+    QCOMPARE(rescanner.statistics().changes(), 0);
+
+    // New content
+    writeFile(path, QByteArray(200, 'b'));
+    setModified(path, QDateTime::currentDateTime());
+    QVERIFY(rescan(rescanner));
+    QCOMPARE(rescanner.statistics().updated, 1);
+    QCOMPARE(rescanner.statistics().added, 0);
+    QCOMPARE(rowCount(), 1);
+    QCOMPARE(value("SELECT time FROM musics").toString(), QString("0:03:20"));
+}
+
+void TestLibraryRescanner::testDetectsMoves()
+{
+    const QString from = m_root + "/Artist - Song.mp3";
+    const QString to = m_root + "/rock/Artist - Song (renamed).mp3";
+    writeFile(from, "moving audio");
+
+    LibraryRescanner rescanner(m_database);
+    QVERIFY(rescan(rescanner));
+    QVERIFY(QSqlQuery(m_database).exec("UPDATE musics SET played_times = 12"));
+
+    QVERIFY(QFile::rename(from, to));
+    QVERIFY(rescan(rescanner));
+
+    const LibraryRescanner::Statistics stats = rescanner.statistics();
+    QCOMPARE(stats.moved, 1);
+    QCOMPARE(stats.added, 0);
+    QCOMPARE(stats.removed, 0);
+
+    // Same row, play count and all, under the new path
+    QCOMPARE(rowCount(), 1);
+    QCOMPARE(value("SELECT path FROM musics").toString(), to);
+    QCOMPARE(value("SELECT played_times FROM musics").toInt(), 12);
+    QCOMPARE(value("SELECT path FROM library_files").toString(), to);
+}
+
+void TestLibraryRescanner::testRemovesMissingFiles()
+{
+    for (int i = 1; i <= 4; ++i)
+        writeFile(m_root + QString("/rock/Band - Song %1.mp3").arg(i), QByteArray::number(i));
+
+    LibraryRescanner rescanner(m_database);
+    QVERIFY(rescan(rescanner));
+    QCOMPARE(rowCount(), 4);
+
+    QVERIFY(QFile::remove(m_root + "/rock/Band - Song 2.mp3"));
+    QVERIFY(QFile::remove(m_root + "/rock/Band - Song 3.mp3"));
+    QVERIFY(rescan(rescanner));
+
+    QCOMPARE(rescanner.statistics().removed, 2);
+    QCOMPARE(rescanner.statistics().unchanged, 2);
+    QCOMPARE(rowCount(), 2);
+    QCOMPARE(value("SELECT COUNT(*) FROM library_files").toInt(), 2);
+
+    // With removeMissing off the rows stay
+    QVERIFY(QFile::remove(m_root + "/rock/Band - Song 4.mp3"));
+    LibraryRescanner::Options options;
+    options.roots << m_root;
+    options.removeMissing = false;
+    QVERIFY(rescanner.start(options));
+    QVERIFY(rescanner.waitForFinished(10000));
+    QCOMPARE(rescanner.statistics().removed, 0);
+    QCOMPARE(rowCount(), 2);
+}
+
+void TestLibraryRescanner::testMissingRootIsSkipped()
+{
+    const QString unmounted = m_tempDir->path() + "/external";
+    QVERIFY(QDir().mkpath(unmounted));
+    writeFile(unmounted + "/Artist - Song.mp3", "audio");
+    writeFile(m_root + "/Artist - Other.mp3", "audio");
+
+    LibraryRescanner rescanner(m_database);
+    LibraryRescanner::Options options;
+    options.roots << m_root << unmounted;
+    QVERIFY(rescanner.start(options));
+    QVERIFY(rescanner.waitForFinished(10000));
+    QCOMPARE(rowCount(), 2);
+
+    // The drive goes away: its rows stay, the rest is still rescanned
+    QVERIFY(QDir(unmounted).removeRecursively());
+    QVERIFY(rescanner.start(options));
+    QVERIFY(rescanner.waitForFinished(10000));
+    QCOMPARE(rescanner.statistics().removed, 0);
+    QCOMPARE(rescanner.statistics().scanned, 1);
+    QCOMPARE(rowCount(), 2);
+
+    // No root at all is an error, not an empty library
+    QSignalSpy errorSpy(&rescanner, &LibraryRescanner::rescanError);
+    options.roots = QStringList() << unmounted;
+    QVERIFY(!rescanner.start(options));
+    QCOMPARE(errorSpy.count(), 1);
+    QCOMPARE(rowCount(), 2);
+}
+
+void TestLibraryRescanner::testWatchRescansChangedDirectory()
+{
+    writeFile(m_root + "/rock/Band - One.mp3", "one");
+
+    LibraryRescanner rescanner(m_database);
+    LibraryRescanner::Options options;
+    options.roots << m_root;
+    QVERIFY(rescanner.watch(options));
+    QVERIFY(rescanner.waitForFinished(10000));
+    QVERIFY(rescanner.isWatching());
+    QCOMPARE(rowCount(), 1);
+    QVERIFY(rescanner.watchedDirectories().contains(m_root));
+    QVERIFY(rescanner.watchedDirectories().contains(m_root + "/rock"));
+
+    writeFile(m_root + "/rock/Band - Two.mp3", "two");
+    QTRY_COMPARE_WITH_TIMEOUT(rowCount(), 2, 10000);
+    QTRY_VERIFY_WITH_TIMEOUT(!rescanner.isRunning(), 10000);
+
+    QVERIFY(QFile::remove(m_root + "/rock/Band - One.mp3"));
+    QTRY_COMPARE_WITH_TIMEOUT(rowCount(), 1, 10000);
+    QCOMPARE(value("SELECT song FROM musics").toString(), QString("Two"));
+
+    rescanner.stopWatching();
+    QVERIFY(!rescanner.isWatching());
+    QVERIFY(rescanner.watchedDirectories().isEmpty());
+}
+
+QTEST_MAIN(TestLibraryRescanner)
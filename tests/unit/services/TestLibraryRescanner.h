@@ -0,0 +1,49 @@
+#ifndef TESTLIBRARYRESCANNER_H
+#define TESTLIBRARYRESCANNER_H
+
+#include <QtTest/QtTest>
+#include <QTemporaryDir>
+#include <QSqlDatabase>
+#include <memory>
+
+class LibraryRescanner;
+
+/**
+ * @brief Unit tests for LibraryRescanner class
+ *
+ * Tests incremental rescans against a real directory tree and library
+ * database: the manifest baseline, new, changed, moved and missing files,
+ * unmounted roots and directory watching.
+ */
+class TestLibraryRescanner : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void init();
+    void cleanup();
+
+    void testContentHash();
+    void testFirstRescanRecordsManifest();
+    void testAddsNewFiles();
+    void testUpdatesChangedFiles();
+    void testDetectsMoves();
+    void testRemovesMissingFiles();
+    void testMissingRootIsSkipped();
+    void testWatchRescansChangedDirectory();
+
+private:
+    void writeFile(const QString& path, const QByteArray& content);
+    void setModified(const QString& path, const QDateTime& time);
+    bool rescan(LibraryRescanner& rescanner);
+    int rowCount(const QString& where = QString());
+    QVariant value(const QString& sql);
+
+    std::unique_ptr<QTemporaryDir> m_tempDir;
+    QString m_root;
+    QSqlDatabase m_database;
+    QString m_connectionName;
+};
+
+#endif // TESTLIBRARYRESCANNER_H
@@ -537,10 +537,7 @@ void TestMusicCache::testCleanup()
     
     QSignalSpy cleanupSpy(m_cache.get(), &MusicCache::cleanupCompleted);
     
-    // Set small memory limit
-    m_cache->setMaxMemoryUsage(1024); // 1KB
-    
-    // Add data that exceeds limit
+    // Add data that exceeds the cleanup target
     populateCacheWithTestData(20);
     
     qint64 initialMemory = m_cache->currentMemoryUsage();
@@ -580,8 +577,8 @@ void TestMusicCache::testLRUEviction()
 {
     QVERIFY(m_cache->initialize());
     
-    // Set small memory limit to force eviction
-    m_cache->setMaxMemoryUsage(1024);
+    // Small enough for a single shard
+    m_cache->setMaxMemoryUsage(64 * 1024);
     
     // Add items
     for (int i = 0; i < 10; i++) {
@@ -589,6 +586,11 @@ void TestMusicCache::testLRUEviction()
         m_cache->put(i, music);
     }
     
+    // Room for these ten and no more
+    const qint64 tenTracks = m_cache->currentMemoryUsage();
+    m_cache->setMaxMemoryUsage(tenTracks + tenTracks / 20);
+    QCOMPARE(m_cache->getStatistics().currentEntries, qint64(10));
+    
     // Access some items to update their last accessed time
     m_cache->get(5);
     m_cache->get(7);
@@ -617,8 +619,8 @@ void TestMusicCache::testPinnedEntriesNotEvicted()
 {
     QVERIFY(m_cache->initialize());
     
-    // Set small memory limit
-    m_cache->setMaxMemoryUsage(1024);
+    // Set small memory limit: room for a few tracks
+    m_cache->setMaxMemoryUsage(8 * 1024);
     
     // Add and pin an item
     MusicItem music = createTestMusicItem(100);
@@ -903,8 +905,8 @@ void TestMusicCache::testPinnedEntryNotEvicted()
 {
     QVERIFY(m_cache->initialize());
     
-    // Set small memory limit
-    m_cache->setMaxMemoryUsage(1024);
+    // Set small memory limit: room for a few tracks
+    m_cache->setMaxMemoryUsage(8 * 1024);
     
     // Add and pin an entry
     MusicItem music = createTestMusicItem(100);
@@ -1080,6 +1082,60 @@ void TestMusicCache::testPersistenceWithExpiredEntries()
     QVERIFY(!m_cache->contains(1));
 }
 
+void TestMusicCache::testSnapshotRoundTrip()
+{
+    QVERIFY(m_cache->initialize());
+    
+    // One entry of each kind, one of them pinned
+    MusicItem music = createTestMusicItem(1, "SnapshotArtist", "SnapshotSong");
+    music.genre2.clear();
+    m_cache->put(1, music);
+    m_cache->putSearchResults("snapshot search", createTestMusicList(3));
+    m_cache->putMetadata("snapshot key", QStringList{"a", "b"}, "stats");
+    m_cache->pinEntry("1", "music");
+    m_cache->get(1);
+    
+    QString filePath = m_tempDir->filePath("cache.snapshot");
+    QVERIFY(m_cache->saveSnapshot(filePath));
+    
+    m_cache->clear();
+    QCOMPARE(m_cache->currentMemoryUsage(), qint64(0));
+    QVERIFY(m_cache->loadSnapshot(filePath));
+    QCOMPARE(m_cache->getStatistics().currentEntries, qint64(3));
+    
+    auto cached = m_cache->get(1);
+    QVERIFY(cached != nullptr);
+    QCOMPARE(cached->artist, music.artist);
+    QCOMPARE(cached->song, music.song);
+    QCOMPARE(cached->path, music.path);
+    QCOMPARE(cached->lastPlayed, music.lastPlayed);
+    QCOMPARE(cached->playedTimes, music.playedTimes);
+    QVERIFY(cached->genre2.isEmpty());
+    
+    auto entryInfo = m_cache->getEntryInfo("1", "music");
+    QVERIFY(entryInfo != nullptr);
+    QVERIFY(entryInfo->isPinned);
+    QCOMPARE(entryInfo->accessCount, 2);
+    
+    QList<MusicItem> results = m_cache->getSearchResults("snapshot search");
+    QCOMPARE(results.size(), 3);
+    QCOMPARE(results[2].song, QString("TestSong2"));
+    QCOMPARE(m_cache->getMetadata("snapshot key", "stats").toStringList(), QStringList({"a", "b"}));
+    
+    // Anything but a snapshot is refused
+    QString jsonPath = m_tempDir->filePath("cache.json");
+    QVERIFY(m_cache->saveToFile(jsonPath));
+    QVERIFY(!m_cache->loadSnapshot(jsonPath));
+    QVERIFY(!m_cache->loadSnapshot(m_tempDir->filePath("missing.snapshot")));
+    
+    // A truncated snapshot keeps what it could read but fails
+    QFile file(filePath);
+    QVERIFY(file.open(QIODevice::ReadWrite));
+    QVERIFY(file.resize(file.size() - 1));
+    file.close();
+    QVERIFY(!m_cache->loadSnapshot(filePath));
+}
+
 void TestMusicCache::testExportStatistics()
 {
     QVERIFY(m_cache->initialize());
@@ -1379,6 +1435,67 @@ void TestMusicCache::testCachePerformanceWithManyEntries()
                  .arg(entryCount).arg(populationTime).arg(accessTime).arg(stats.hitRatio);
 }
 
+void TestMusicCache::testShardedThroughput_data()
+{
+    QTest::addColumn<int>("threads");
+    
+    QTest::newRow("1 thread") << 1;
+    QTest::newRow("2 threads") << 2;
+    QTest::newRow("4 threads") << 4;
+    QTest::newRow("8 threads") << 8;
+}
+
+void TestMusicCache::testShardedThroughput()
+{
+    QFETCH(int, threads);
+    QVERIFY(m_cache->initialize());
+    
+    const int trackCount = 2000;
+    const int operationsPerThread = 20000;
+    for (int i = 0; i < trackCount; i++) {
+        m_cache->put(i, createTestMusicItem(i));
+    }
+    
+    // Nine reads for every write, spread over the library
+    QList<QThread*> workers;
+    QAtomicInt hits;
+    for (int t = 0; t < threads; t++) {
+        workers.append(QThread::create([this, &hits, t, trackCount, operationsPerThread]() {
+            QRandomGenerator random(quint32(t + 1));
+            const MusicItem music = createTestMusicItem(t);
+            int localHits = 0;
+            for (int i = 0; i < operationsPerThread; i++) {
+                const int id = random.bounded(trackCount);
+                if (i % 10 == 0) {
+                    m_cache->put(id, music);
+                } else if (m_cache->get(id) != nullptr) {
+                    localHits++;
+                }
+            }
+            hits.fetchAndAddRelaxed(localHits);
+        }));
+    }
+    
+    QElapsedTimer timer;
+    timer.start();
+    for (auto* worker : workers) {
+        worker->start();
+    }
+    for (auto* worker : workers) {
+        QVERIFY(worker->wait(30000));
+        delete worker;
+    }
+    const qint64 elapsed = qMax<qint64>(timer.elapsed(), 1);
+    
+    QVERIFY(hits.loadRelaxed() > 0);
+    QCOMPARE(m_cache->getStatistics().currentEntries, qint64(trackCount));
+    
+    qDebug() << QString("Sharded throughput: %1 threads, %2 shards, %3 ops in %4ms (%5 ops/s)")
+                 .arg(threads).arg(m_cache->shardCount())
+                 .arg(threads * operationsPerThread).arg(elapsed)
+                 .arg(qint64(threads) * operationsPerThread * 1000 / elapsed);
+}
+
 void TestMusicCache::testInvalidFilePath()
 {
     QVERIFY(m_cache->initialize());
@@ -101,6 +101,7 @@ private slots:
     void testLoadFromFile();
     void testAutoPersistence();
     void testPersistenceWithExpiredEntries();
+    void testSnapshotRoundTrip();
 
     // Export/import tests
     void testExportStatistics();
@@ -118,6 +119,8 @@ private slots:
     // Performance tests
     void testLargeDatasetPerformance();
     void testCachePerformanceWithManyEntries();
+    void testShardedThroughput_data();
+    void testShardedThroughput();
 
     // Error handling tests
     void testInvalidFilePath();
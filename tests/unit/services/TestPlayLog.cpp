@@ -0,0 +1,271 @@
+#include "TestPlayLog.h"
+#include "../../../src/services/PlayLog.h"
+#include "../../../src/services/DatabaseAccess.h"
+#include "../../../src/repositories/LibraryMigrations.h"
+#include "../LibraryTestSchema.h"
+#include <QBuffer>
+#include <QSqlQuery>
+#include <QSqlError>
+#include <QDebug>
+
+namespace {
+
+const QDateTime kNoon(QDate(2026, 10, 14), QTime(12, 0));
+
+} // namespace
+
+void TestPlayLog::init()
+{
+    m_tempDir = std::make_unique<QTemporaryDir>();
+    QVERIFY(m_tempDir->isValid());
+
+    m_connectionName = "test_play_log";
+    m_database = LibraryTestSchema::openDatabase(m_connectionName, m_tempDir->path() + "/adb.db");
+    QVERIFY(m_database.isOpen());
+
+    QString error;
+    QVERIFY2(LibraryTestSchema::createMusicsTable(m_database, &error), qPrintable(error));
+    QVERIFY(LibraryMigrations::apply(m_database));
+
+    m_writer = std::make_unique<DatabaseAccess>(m_database.databaseName());
+}
+
+void TestPlayLog::cleanup()
+{
+    m_writer.reset();
+    LibraryTestSchema::closeDatabase(m_database, m_connectionName);
+    m_tempDir.reset();
+}
+
+void TestPlayLog::addTrack(const QString& artist, const QString& title, const QString& path)
+{
+    QSqlQuery query(m_database);
+    query.prepare("INSERT INTO musics (artist, song, genre1, path, time, played_times, last_played) "
+                  "VALUES (?, ?, 'Rock', ?, '0:03:00', 0, '-')");
+    query.addBindValue(artist);
+    query.addBindValue(title);
+    query.addBindValue(path);
+    QVERIFY2(query.exec(), qPrintable(query.lastError().text()));
+}
+
+QVariant TestPlayLog::value(const QString& sql)
+{
+    QSqlQuery query(m_database);
+    if (!query.exec(sql) || !query.next())
+        return QVariant();
+    return query.value(0);
+}
+
+QString TestPlayLog::queryPlan(const QString& sql)
+{
+    QSqlQuery query(m_database);
+    if (!query.exec("EXPLAIN QUERY PLAN " + sql))
+        return query.lastError().text();
+    QStringList steps;
+    while (query.next())
+        steps << query.value(3).toString();
+    return steps.join('\n');
+}
+
+void TestPlayLog::testRecordsThroughTheWriter()
+{
+    addTrack("Artist", "Song", "/music/song.mp3");
+    PlayLog log(m_writer.get());
+
+    log.started(PlayLog::mainDeck(), "/music/song.mp3", kNoon);
+    QVERIFY(log.isOnAir(PlayLog::mainDeck()));
+
+    // The next track on the same deck ends the previous one
+    log.started(PlayLog::mainDeck(), "/elsewhere/jingle.mp3", kNoon.addSecs(180));
+    log.stopped(PlayLog::mainDeck(), kNoon.addSecs(190));
+    QVERIFY(!log.isOnAir(PlayLog::mainDeck()));
+
+    QVERIFY(m_writer->flush(5000));
+    QCOMPARE(value("SELECT COUNT(*) FROM play_log").toInt(), 2);
+
+    // Library tracks are resolved by path, other files have no track
+    QCOMPARE(value("SELECT track FROM play_log WHERE path = '/music/song.mp3'").toLongLong(),
+             value("SELECT rowid FROM musics WHERE path = '/music/song.mp3'").toLongLong());
+    QVERIFY(value("SELECT track FROM play_log WHERE path = '/elsewhere/jingle.mp3'").isNull());
+
+    QCOMPARE(value("SELECT aired_ms FROM play_log WHERE path = '/music/song.mp3'").toLongLong(), 180000LL);
+    QCOMPARE(value("SELECT ended - started FROM play_log WHERE path = '/elsewhere/jingle.mp3'").toLongLong(),
+             10000LL);
+    QCOMPARE(value("SELECT source FROM play_log LIMIT 1").toString(), QString("main"));
+
+    // Stopping an idle deck logs nothing
+    log.stopped(PlayLog::deck(1));
+    QVERIFY(m_writer->flush(5000));
+    QCOMPARE(value("SELECT COUNT(*) FROM play_log").toInt(), 2);
+}
+
+void TestPlayLog::testPausesAreNotAired()
+{
+    PlayLog log(m_writer.get());
+    log.started(PlayLog::deck(1), "/music/a.mp3", kNoon);
+    log.paused(PlayLog::deck(1), kNoon.addSecs(10));
+    log.paused(PlayLog::deck(1), kNoon.addSecs(20));       // already paused
+    log.resumed(PlayLog::deck(1), kNoon.addSecs(70));
+    log.stopped(PlayLog::deck(1), kNoon.addSecs(100));
+
+    // Stopped while paused: the pause does not count either
+    log.started(PlayLog::deck(2), "/music/b.mp3", kNoon);
+    log.paused(PlayLog::deck(2), kNoon.addSecs(30));
+    log.stopped(PlayLog::deck(2), kNoon.addSecs(300));
+
+    QVERIFY(m_writer->flush(5000));
+    QCOMPARE(value("SELECT aired_ms FROM play_log WHERE source = 'deck1'").toLongLong(), 40000LL);
+    QCOMPARE(value("SELECT ended - started FROM play_log WHERE source = 'deck1'").toLongLong(), 100000LL);
+    QCOMPARE(value("SELECT aired_ms FROM play_log WHERE source = 'deck2'").toLongLong(), 30000LL);
+}
+
+void TestPlayLog::testPlaysPerTrack()
+{
+    addTrack("Artist A", "Song A", "/music/a.mp3");
+    addTrack("Artist B", "Song B", "/music/b.mp3");
+    PlayLog log(m_writer.get());
+
+    auto play = [&log](const QString& path, const QDateTime& at) {
+        PlayLog::Play entry;
+        entry.path = path;
+        entry.source = PlayLog::mainDeck();
+        entry.started = at;
+        entry.ended = at.addSecs(180);
+        log.record(entry);
+    };
+    // A three times and B once on the day, B again the day after, and two
+    // files outside the library
+    for (int i = 0; i < 3; ++i)
+        play("/music/a.mp3", kNoon.addSecs(600 * i));
+    play("/music/b.mp3", kNoon.addSecs(3600));
+    play("/music/b.mp3", kNoon.addDays(1));
+    play("/other/x.mp3", kNoon.addSecs(60));
+    play("/other/y.mp3", kNoon.addSecs(120));
+    QVERIFY(m_writer->flush(5000));
+
+    const QDateTime day = kNoon.date().startOfDay();
+    QString error;
+    const QList<PlayLog::TrackPlays> plays = PlayLog::playsPerTrack(m_database, day, day.addDays(1), &error);
+    QVERIFY2(error.isEmpty(), qPrintable(error));
+    QCOMPARE(plays.size(), 3);
+    QCOMPARE(plays[0].path, QString("/music/a.mp3"));
+    QCOMPARE(plays[0].artist, QString("Artist A"));
+    QCOMPARE(plays[0].plays, 3);
+    QCOMPARE(plays[0].airedMs, 3 * 180000LL);
+    QCOMPARE(plays[1].trackId, 0LL);
+    QCOMPARE(plays[1].plays, 2);
+    QCOMPARE(plays[2].title, QString("Song B"));
+    QCOMPARE(plays[2].plays, 1);
+
+    const qint64 trackB = value("SELECT rowid FROM musics WHERE path = '/music/b.mp3'").toLongLong();
+    QCOMPARE(PlayLog::playsOf(m_database, trackB, day, day.addDays(2)).plays, 2);
+    QCOMPARE(PlayLog::playsOf(m_database, trackB, day.addDays(1), day.addDays(2)).airedMs, 180000LL);
+
+    // A VACUUM may renumber musics: A and B swap rowids, and the plays
+    // still go to the track that aired
+    QSqlQuery renumber(m_database);
+    QVERIFY(renumber.exec("UPDATE musics SET rowid = rowid + 100"));
+    QVERIFY(renumber.exec("UPDATE musics SET rowid = CASE path WHEN '/music/a.mp3' THEN 2 ELSE 1 END"));
+    const QList<PlayLog::TrackPlays> renumbered = PlayLog::playsPerTrack(m_database, day, day.addDays(1));
+    QCOMPARE(renumbered.size(), 3);
+    QCOMPARE(renumbered[0].artist, QString("Artist A"));
+    QCOMPARE(renumbered[0].trackId, 2LL);
+    QCOMPARE(renumbered[0].plays, 3);
+    QCOMPARE(renumbered[2].title, QString("Song B"));
+    QCOMPARE(PlayLog::playsOf(m_database, 1, day, day.addDays(2)).plays, 2);
+}
+
+void TestPlayLog::testPlaysFollowMovedFiles()
+{
+    addTrack("Artist A", "Song A", "/music/a.flac");
+    PlayLog log(m_writer.get());
+    PlayLog::Play entry;
+    entry.path = "/music/a.flac";
+    entry.source = PlayLog::mainDeck();
+    entry.started = kNoon;
+    entry.ended = kNoon.addSecs(180);
+    log.record(entry);
+    QVERIFY(m_writer->flush(5000));
+
+    // Converted or moved on disk: the library row and its plays move together
+    QSqlQuery move(m_database);
+    QVERIFY(move.exec("UPDATE musics SET path = '/music/a.mp3' WHERE path = '/music/a.flac'"));
+    QCOMPARE(value("SELECT path FROM play_log").toString(), QString("/music/a.mp3"));
+
+    const QDateTime day = kNoon.date().startOfDay();
+    const QList<PlayLog::TrackPlays> plays = PlayLog::playsPerTrack(m_database, day, day.addDays(1));
+    QCOMPARE(plays.size(), 1);
+    QCOMPARE(plays[0].artist, QString("Artist A"));
+    const qint64 track = value("SELECT rowid FROM musics").toLongLong();
+    QCOMPARE(PlayLog::playsOf(m_database, track, day, day.addDays(1)).plays, 1);
+
+    // Other columns leave the log alone
+    QVERIFY(move.exec("UPDATE musics SET played_times = 1"));
+    QCOMPARE(value("SELECT COUNT(*) FROM play_log WHERE path = '/music/a.mp3'").toInt(), 1);
+}
+
+void TestPlayLog::testReportsUseCoveringIndexes()
+{
+    const QString perTrack = queryPlan("SELECT COUNT(*), SUM(aired_ms) FROM play_log "
+                                       "WHERE path = 'a' AND started >= 0 AND started < 1");
+    QVERIFY2(perTrack.contains("COVERING INDEX idx_play_log_path"), qPrintable(perTrack));
+
+    const QString perPeriod = queryPlan("SELECT path, COUNT(*), SUM(aired_ms) FROM play_log "
+                                        "WHERE started >= 0 AND started < 1 GROUP BY path");
+    QVERIFY2(perPeriod.contains("COVERING INDEX idx_play_log_started_path"), qPrintable(perPeriod));
+}
+
+void TestPlayLog::testExportCsv()
+{
+    addTrack("Artist, \"The\"", "Song", "/music/a.mp3");
+    PlayLog log(m_writer.get());
+
+    PlayLog::Play play;
+    play.path = "/music/a.mp3";
+    play.source = PlayLog::mainDeck();
+    play.started = kNoon;
+    play.ended = kNoon.addSecs(200);
+    play.airedMs = 185500;
+    log.record(play);
+
+    // Enough rows for the export to flush along the way
+    m_writer->write([](QSqlDatabase& db) {
+        QSqlQuery insert(db);
+        insert.prepare("INSERT INTO play_log (track, path, started, ended, aired_ms, source) "
+                       "VALUES (NULL, ?, ?, ?, 1000, 'deck1')");
+        for (int i = 0; i < 5000; ++i) {
+            insert.addBindValue(QString("/other/%1.mp3").arg(i));
+            insert.addBindValue(kNoon.addSecs(300 + i).toMSecsSinceEpoch());
+            insert.addBindValue(kNoon.addSecs(301 + i).toMSecsSinceEpoch());
+            if (!insert.exec())
+                return false;
+        }
+        return true;
+    });
+    // Outside the period
+    play.started = kNoon.addDays(-1);
+    play.ended = play.started.addSecs(60);
+    log.record(play);
+    QVERIFY(m_writer->flush(5000));
+
+    QBuffer buffer;
+    QVERIFY(buffer.open(QIODevice::WriteOnly));
+    QString error;
+    const QDateTime day = kNoon.date().startOfDay();
+    QCOMPARE(PlayLog::exportCsv(m_database, &buffer, day, day.addDays(1), &error), 5001LL);
+    buffer.close();
+
+    const QStringList lines = QString::fromUtf8(buffer.data()).split('\n', Qt::SkipEmptyParts);
+    QCOMPARE(lines.size(), 5002);
+    QCOMPARE(lines[0], QString("started,ended,aired_seconds,deck,artist,title,path"));
+    QCOMPARE(lines[1], QString("2026-10-14 12:00:00,2026-10-14 12:03:20,185.5,main,"
+                               "\"Artist, \"\"The\"\"\",Song,/music/a.mp3"));
+    QCOMPARE(lines[2], QString("2026-10-14 12:05:00,2026-10-14 12:05:01,1.0,deck1,,,/other/0.mp3"));
+
+    // A device that is not open fails cleanly
+    QBuffer closed;
+    QCOMPARE(PlayLog::exportCsv(m_database, &closed, day, day.addDays(1), &error), -1LL);
+    QVERIFY(!error.isEmpty());
+}
+
+QTEST_MAIN(TestPlayLog)
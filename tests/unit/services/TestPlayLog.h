@@ -0,0 +1,44 @@
+#ifndef TESTPLAYLOG_H
+#define TESTPLAYLOG_H
+
+#include <QtTest/QtTest>
+#include <QTemporaryDir>
+#include <QSqlDatabase>
+#include <memory>
+
+class DatabaseAccess;
+
+/**
+ * @brief Unit tests for PlayLog class
+ *
+ * Tests logging plays through the DatabaseAccess writer, aired time with
+ * pauses, the per-track reports and their covering indexes, plays that
+ * follow a moved file, and the CSV export.
+ */
+class TestPlayLog : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void init();
+    void cleanup();
+
+    void testRecordsThroughTheWriter();
+    void testPausesAreNotAired();
+    void testPlaysPerTrack();
+    void testPlaysFollowMovedFiles();
+    void testReportsUseCoveringIndexes();
+    void testExportCsv();
+
+private:
+    void addTrack(const QString& artist, const QString& title, const QString& path);
+    QVariant value(const QString& sql);
+    QString queryPlan(const QString& sql);
+
+    std::unique_ptr<QTemporaryDir> m_tempDir;
+    std::unique_ptr<DatabaseAccess> m_writer;
+    QSqlDatabase m_database;
+    QString m_connectionName;
+};
+
+#endif // TESTPLAYLOG_H
@@ -0,0 +1,317 @@
+#include "TestRecordingSegmenter.h"
+#include "../../../src/services/RecordingSegmenter.h"
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QtEndian>
+#include <vector>
+
+namespace {
+
+constexpr int kMp3FrameBytes = 384;    // MPEG-1 Layer III, 128 kbps, 48 kHz
+constexpr int kMp3FrameSamples = 1152;
+constexpr int kOggPageSamples = 960;
+constexpr int kOggPayload = 100;
+
+/**
+ * Stands in for a real codec: emits well-formed MP3 frames or Ogg pages
+ * (two granule-0 header pages first) and keeps a copy of everything it
+ * emitted in *stream.
+ */
+class FakeEncoder : public FxEncoder
+{
+public:
+    FakeEncoder(RecordingSegmenter::Format format, QByteArray* stream)
+        : m_format(format), m_stream(stream)
+    {
+        if (m_format == RecordingSegmenter::Format::Opus) {
+            emitOggPage(0);
+            emitOggPage(0);
+        }
+    }
+
+    size_t write(const float* interleaved, size_t frames) override
+    {
+        Q_UNUSED(interleaved);
+        m_pending += static_cast<qint64>(frames);
+        const qint64 unit = m_format == RecordingSegmenter::Format::Opus ? kOggPageSamples : kMp3FrameSamples;
+        while (m_pending >= unit) {
+            m_pending -= unit;
+            emitUnit(unit);
+        }
+        return frames;
+    }
+    qint64 takeEncoded(QByteArray& out) override
+    {
+        const qint64 n = m_out.size();
+        out += m_out;
+        m_out.clear();
+        return n;
+    }
+    void finish() override
+    {
+        if (m_pending > 0)
+            emitUnit(m_pending);
+        m_pending = 0;
+    }
+    qint64 queuedFrames() const override { return 0; }
+    bool failed() const override { return false; }
+    QString errorString() const override { return QString(); }
+
+private:
+    void emitUnit(qint64 samples)
+    {
+        if (m_format == RecordingSegmenter::Format::Opus) {
+            m_granule += samples;
+            emitOggPage(m_granule);
+            return;
+        }
+        QByteArray frame(kMp3FrameBytes, char(m_counter++));
+        frame[0] = char(0xFF);
+        frame[1] = char(0xFB);
+        frame[2] = char(0x94);
+        frame[3] = char(0x00);
+        append(frame);
+    }
+
+    void emitOggPage(qint64 granule)
+    {
+        QByteArray page(27 + 1 + kOggPayload, char(m_counter++));
+        char* p = page.data();
+        memcpy(p, "OggS", 4);
+        p[4] = 0;
+        p[5] = granule == 0 && m_sequence == 0 ? 0x02 : 0x00;
+        qToLittleEndian<qint64>(granule, p + 6);
+        qToLittleEndian<quint32>(0x1234, p + 14);
+        qToLittleEndian<quint32>(m_sequence++, p + 18);
+        qToLittleEndian<quint32>(0, p + 22);
+        p[26] = 1;
+        p[27] = char(kOggPayload);
+        append(page);
+    }
+
+    void append(const QByteArray& bytes)
+    {
+        m_out += bytes;
+        *m_stream += bytes;
+    }
+
+    RecordingSegmenter::Format m_format;
+    QByteArray* m_stream;
+    QByteArray m_out;
+    qint64 m_pending = 0;
+    qint64 m_granule = 0;
+    quint32 m_sequence = 0;
+    uchar m_counter = 1;
+};
+
+RecordingSegmenter::EncoderFactory fakeFactory(RecordingSegmenter::Format format, QByteArray* stream)
+{
+    return [format, stream](const FxEncoder::Settings&, QString*) -> std::unique_ptr<FxEncoder> {
+        return std::make_unique<FakeEncoder>(format, stream);
+    };
+}
+
+/** Writes seconds of a ramp in 10 ms blocks. */
+void record(RecordingSegmenter& segmenter, double seconds)
+{
+    const RecordingSegmenter::Settings& s = segmenter.settings();
+    const size_t block = static_cast<size_t>(s.sampleRate / 100);
+    std::vector<float> pcm(block * static_cast<size_t>(s.channels));
+    const qint64 total = static_cast<qint64>(seconds * s.sampleRate);
+    for (qint64 done = 0; done < total;) {
+        const size_t n = static_cast<size_t>(std::min<qint64>(qint64(block), total - done));
+        for (size_t i = 0; i < pcm.size(); ++i)
+            pcm[i] = float((done * s.channels + qint64(i)) % 2000) / 2000.0f - 0.5f;
+        QCOMPARE(segmenter.write(pcm.data(), n), n);
+        done += static_cast<qint64>(n);
+    }
+}
+
+QByteArray readAll(const QString& path)
+{
+    QFile file(path);
+    return file.open(QIODevice::ReadOnly) ? file.readAll() : QByteArray();
+}
+
+quint32 le32(const QByteArray& bytes, int offset)
+{
+    return qFromLittleEndian<quint32>(bytes.constData() + offset);
+}
+
+} // namespace
+
+void TestRecordingSegmenter::init()
+{
+    m_dir = std::make_unique<QTemporaryDir>();
+    QVERIFY(m_dir->isValid());
+}
+
+void TestRecordingSegmenter::cleanup()
+{
+    m_dir.reset();
+}
+
+void TestRecordingSegmenter::testWavSegmentsAndJoin()
+{
+    RecordingSegmenter segmenter(nullptr);
+    RecordingSegmenter::Settings settings;
+    settings.directory = m_dir->path();
+    settings.baseName = "show";
+    settings.format = RecordingSegmenter::Format::Wav;
+    settings.sampleRate = 8000;
+    settings.segmentSeconds = 1;
+    QVERIFY(segmenter.open(settings));
+
+    record(segmenter, 2.5);
+    QCOMPARE(segmenter.takeClosedSegments().size(), 2);
+    QVERIFY(segmenter.close());
+    QCOMPARE(segmenter.takeClosedSegments().size(), 1);
+
+    const QStringList segments = segmenter.segments();
+    QCOMPARE(segments, RecordingSegmenter::findSegments(m_dir->path(), "show"));
+    QVERIFY(segments.first().endsWith("show-0001.wav"));
+
+    QByteArray data;
+    const quint32 sizes[] = {32000, 32000, 16000};
+    for (int i = 0; i < segments.size(); ++i) {
+        const QByteArray bytes = readAll(segments.at(i));
+        QCOMPARE(bytes.size(), int(44 + sizes[i]));
+        QCOMPARE(le32(bytes, 40), sizes[i]);
+        QCOMPARE(le32(bytes, 4), sizes[i] + 36);
+        data += bytes.mid(44);
+    }
+
+    const QString joined = m_dir->filePath("show.wav");
+    QVERIFY(RecordingSegmenter::concatenate(segments, joined));
+    const QByteArray bytes = readAll(joined);
+    QCOMPARE(le32(bytes, 40), quint32(80000));
+    QCOMPARE(le32(bytes, 4), quint32(80036));
+    QCOMPARE(bytes.mid(44), data);
+}
+
+void TestRecordingSegmenter::testMp3CutsBetweenFrames()
+{
+    QByteArray stream;
+    RecordingSegmenter segmenter(fakeFactory(RecordingSegmenter::Format::Mp3, &stream));
+    RecordingSegmenter::Settings settings;
+    settings.directory = m_dir->path();
+    settings.format = RecordingSegmenter::Format::Mp3;
+    settings.segmentSeconds = 1;
+    QVERIFY(segmenter.open(settings));
+    record(segmenter, 3.5);
+    QVERIFY(segmenter.close());
+
+    const QStringList segments = segmenter.segments();
+    QCOMPARE(segments.size(), 4);
+    QByteArray joinedSegments;
+    for (const QString& path : segments) {
+        const QByteArray bytes = readAll(path);
+        QVERIFY(bytes.startsWith("\xFF\xFB"));
+        QCOMPARE(bytes.size() % kMp3FrameBytes, 0);
+        joinedSegments += bytes;
+    }
+    QCOMPARE(joinedSegments, stream);
+    QCOMPARE(segmenter.bytesWritten(), qint64(stream.size()));
+
+    const QString joined = m_dir->filePath("recording.mp3");
+    QVERIFY(RecordingSegmenter::concatenate(segments, joined));
+    QCOMPARE(readAll(joined), stream);
+}
+
+void TestRecordingSegmenter::testOggSegmentsCarryHeaders()
+{
+    QByteArray stream;
+    RecordingSegmenter segmenter(fakeFactory(RecordingSegmenter::Format::Opus, &stream));
+    RecordingSegmenter::Settings settings;
+    settings.directory = m_dir->path();
+    settings.format = RecordingSegmenter::Format::Opus;
+    settings.segmentSeconds = 1;
+    QVERIFY(segmenter.open(settings));
+    record(segmenter, 2.5);
+    QVERIFY(segmenter.close());
+
+    const QStringList segments = segmenter.segments();
+    QCOMPARE(segments.size(), 3);
+    const int pageBytes = 27 + 1 + kOggPayload;
+    const QByteArray headers = stream.left(2 * pageBytes);
+    for (const QString& path : segments) {
+        const QByteArray bytes = readAll(path);
+        QVERIFY(bytes.startsWith(headers));
+        // Audio pages after the headers, none cut through
+        QCOMPARE(bytes.size() % pageBytes, 0);
+        QVERIFY(bytes.size() > headers.size());
+    }
+
+    const QString joined = m_dir->filePath("recording.ogg");
+    QVERIFY(RecordingSegmenter::concatenate(segments, joined));
+    QCOMPARE(readAll(joined), stream);
+}
+
+void TestRecordingSegmenter::testJoinsTornRecording()
+{
+    const QString crashed = m_dir->filePath("crashed");
+    QVERIFY(QDir().mkpath(crashed));
+    {
+        RecordingSegmenter segmenter(nullptr);
+        RecordingSegmenter::Settings settings;
+        settings.directory = m_dir->filePath("live");
+        settings.baseName = "show";
+        settings.sampleRate = 8000;
+        settings.segmentSeconds = 1;
+        QVERIFY(segmenter.open(settings));
+        record(segmenter, 1.5);
+
+        // What a crash leaves: the open segment as last flushed, header unpatched
+        const QStringList live = RecordingSegmenter::findSegments(settings.directory, "show");
+        QCOMPARE(live.size(), 2);
+        for (const QString& path : live)
+            QVERIFY(QFile::copy(path, QDir(crashed).filePath(QFileInfo(path).fileName())));
+    }
+
+    const QStringList segments = RecordingSegmenter::findSegments(crashed, "show");
+    QCOMPARE(segments.size(), 2);
+    QCOMPARE(le32(readAll(segments.last()), 40), quint32(0));
+    QFile torn(segments.last());
+    QVERIFY(torn.open(QIODevice::Append));
+    torn.write("\x01\x02\x03", 3);
+    torn.close();
+
+    const QString joined = m_dir->filePath("show-recovered.wav");
+    QString error;
+    QVERIFY2(RecordingSegmenter::concatenate(segments, joined, &error), qPrintable(error));
+    const QByteArray bytes = readAll(joined);
+    QCOMPARE(le32(bytes, 40), quint32(12000 * 4));
+    QCOMPARE(bytes.size(), 44 + 12000 * 4);
+}
+
+void TestRecordingSegmenter::testFindSegmentsOrder()
+{
+    QDir dir(m_dir->path());
+    for (const char* name : {"show-0010.ogg", "show-0002.ogg", "show-0001.ogg", "show.ogg", "other-0001.ogg"}) {
+        QFile file(dir.filePath(name));
+        QVERIFY(file.open(QIODevice::WriteOnly));
+    }
+    const QStringList found = RecordingSegmenter::findSegments(dir.path(), "show");
+    QCOMPARE(found, QStringList({dir.filePath("show-0001.ogg"), dir.filePath("show-0002.ogg"),
+                                 dir.filePath("show-0010.ogg")}));
+    QVERIFY(RecordingSegmenter::findSegments(dir.path(), "missing").isEmpty());
+}
+
+void TestRecordingSegmenter::testEncoderUnavailable()
+{
+    RecordingSegmenter segmenter([](const FxEncoder::Settings&, QString* error) -> std::unique_ptr<FxEncoder> {
+        *error = "no encoder";
+        return nullptr;
+    });
+    RecordingSegmenter::Settings settings;
+    settings.directory = m_dir->path();
+    settings.format = RecordingSegmenter::Format::Aac;
+    QString error;
+    QVERIFY(!segmenter.open(settings, &error));
+    QVERIFY(error.contains("no encoder"));
+    QVERIFY(!segmenter.isOpen());
+    QVERIFY(RecordingSegmenter::findSegments(m_dir->path(), settings.baseName).isEmpty());
+}
+
+QTEST_MAIN(TestRecordingSegmenter)
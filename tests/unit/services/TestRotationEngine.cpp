@@ -0,0 +1,313 @@
+#include "TestRotationEngine.h"
+#include "../../../src/services/RotationEngine.h"
+#include "../LibraryTestSchema.h"
+#include <QElapsedTimer>
+#include <QSet>
+#include <QSqlQuery>
+#include <QSqlError>
+#include <QDebug>
+
+namespace {
+
+// Wednesday 14 October 2026; hourgenre stores it as day 3
+const QDate kWednesday(2026, 10, 14);
+
+// Paths are "/music/<genre>/<artist>/<title>-<n>.mp3"
+QString artistOf(const QString& path)
+{
+    return path.section('/', 3, 3);
+}
+
+QString genreOf(const QString& path)
+{
+    return path.section('/', 2, 2);
+}
+
+QString titleOf(const QString& path)
+{
+    return path.section('/', 4, 4).section('-', 0, 0);
+}
+
+} // namespace
+
+void TestRotationEngine::init()
+{
+    m_tempDir = std::make_unique<QTemporaryDir>();
+    QVERIFY(m_tempDir->isValid());
+
+    m_connectionName = "test_rotation_engine";
+    m_database = LibraryTestSchema::openDatabase(m_connectionName, m_tempDir->path() + "/adb.db");
+    QVERIFY(m_database.isOpen());
+    m_tracks = 0;
+
+    QString error;
+    QVERIFY2(LibraryTestSchema::createMusicsTable(m_database, &error), qPrintable(error));
+    QSqlQuery query(m_database);
+    QVERIFY2(query.exec("CREATE TABLE hourgenre (\"day\" TEXT, \"hour\" TEXT, \"genre\" TEXT)"),
+             qPrintable(query.lastError().text()));
+}
+
+void TestRotationEngine::cleanup()
+{
+    LibraryTestSchema::closeDatabase(m_database, m_connectionName);
+    m_tempDir.reset();
+}
+
+void TestRotationEngine::addTrack(const QString& artist, const QString& title, const QString& genre,
+                                  const QString& time, const QString& lastPlayed)
+{
+    QSqlQuery query(m_database);
+    query.prepare("INSERT INTO musics (artist, song, genre1, genre2, country, published_date, path, time, "
+                  "played_times, last_played) VALUES (?, ?, ?, '', '', '', ?, ?, 0, ?)");
+    query.addBindValue(artist);
+    query.addBindValue(title);
+    query.addBindValue(genre);
+    query.addBindValue(QString("/music/%1/%2/%3-%4.mp3").arg(genre, artist, title).arg(++m_tracks));
+    query.addBindValue(time);
+    query.addBindValue(lastPlayed);
+    QVERIFY2(query.exec(), qPrintable(query.lastError().text()));
+}
+
+void TestRotationEngine::addTracks(int count, int artists, const QString& genre)
+{
+    QVERIFY(m_database.transaction());
+    for (int i = 0; i < count; ++i)
+        addTrack(QString("Artist %1").arg(i % artists), QString("Song %1").arg(i / artists), genre);
+    QVERIFY(m_database.commit());
+}
+
+void TestRotationEngine::testWeight()
+{
+    const qint64 now = QDateTime::currentMSecsSinceEpoch();
+    const qint64 hour = 3600 * 1000;
+
+    // Never played and rested for days weigh the same, the most
+    QCOMPARE(RotationEngine::weight(0, 0, now), RotationEngine::weight(0, now - 10 * 24 * hour, now));
+    QVERIFY(RotationEngine::weight(0, 0, now) > RotationEngine::weight(0, now - 24 * hour, now));
+    QVERIFY(RotationEngine::weight(0, now - 24 * hour, now) > RotationEngine::weight(0, now - hour, now));
+
+    // Just played: the floor, never zero
+    QCOMPARE(RotationEngine::weight(0, now - 60 * 1000, now), RotationEngine::weight(0, now - hour, now));
+    QVERIFY(RotationEngine::weight(0, now, now) > 0.0);
+
+    // A long play count damps a track, but less than a recent play
+    QVERIFY(RotationEngine::weight(100, 0, now) < RotationEngine::weight(0, 0, now));
+    QVERIFY(RotationEngine::weight(100, 0, now) > RotationEngine::weight(0, now - 24 * hour, now));
+}
+
+void TestRotationEngine::testRotationPlaysEveryTrackOnce()
+{
+    addTracks(100, 10, "Rock");
+
+    RotationEngine engine(m_database);
+    RotationEngine::Options options;
+    options.seed = 7;
+    engine.setOptions(options);
+    engine.reload();
+    QVERIFY(engine.waitForReady(10000));
+    QCOMPARE(engine.statistics().tracks, 100);
+    QCOMPARE(engine.queued(QString()), 100);
+
+    const QStringList paths = engine.next(100);
+    QCOMPARE(paths.size(), 100);
+    QCOMPARE(QSet<QString>(paths.begin(), paths.end()).size(), 100);
+}
+
+void TestRotationEngine::testArtistAndTitleSeparation()
+{
+    // 30 artists with 10 titles each, and a second file of 60 of them
+    addTracks(300, 30, "Rock");
+    QVERIFY(m_database.transaction());
+    for (int i = 0; i < 60; ++i)
+        addTrack(QString("Artist %1").arg(i % 30), QString("Song %1").arg(i / 30), "Rock");
+    QVERIFY(m_database.commit());
+
+    RotationEngine engine(m_database);
+    RotationEngine::Options options;
+    options.seed = 11;
+    engine.setOptions(options);
+    engine.reload();
+    QVERIFY(engine.waitForReady(10000));
+
+    const QStringList paths = engine.next(250);
+    QCOMPARE(paths.size(), 250);
+    for (int i = 0; i < paths.size(); ++i) {
+        for (int j = qMax(0, i - options.artistSeparation); j < i; ++j)
+            QVERIFY2(artistOf(paths[i]) != artistOf(paths[j]), qPrintable(paths[i]));
+        for (int j = qMax(0, i - options.titleSeparation); j < i; ++j)
+            QVERIFY2(artistOf(paths[i]) != artistOf(paths[j]) || titleOf(paths[i]) != titleOf(paths[j]),
+                     qPrintable(paths[i]));
+    }
+    QCOMPARE(engine.statistics().relaxed, 0);
+}
+
+void TestRotationEngine::testWeightingFavoursRestedTracks()
+{
+    // 100 tracks played an hour ago, 100 never played
+    const QString hourAgo = QDateTime::currentDateTime().addSecs(-3600).toString("yyyy-MM-dd || hh:mm:ss");
+    QVERIFY(m_database.transaction());
+    for (int i = 0; i < 100; ++i) {
+        addTrack(QString("Recent %1").arg(i), "Song", "Pop", "0:03:00", hourAgo);
+        addTrack(QString("Rested %1").arg(i), "Song", "Pop");
+    }
+    QVERIFY(m_database.commit());
+
+    RotationEngine engine(m_database);
+    RotationEngine::Options options;
+    options.seed = 3;
+    engine.setOptions(options);
+    engine.reload();
+    QVERIFY(engine.waitForReady(10000));
+
+    int rested = 0;
+    for (const QString& path : engine.next(50)) {
+        if (artistOf(path).startsWith("Rested"))
+            ++rested;
+    }
+    QVERIFY2(rested >= 45, qPrintable(QString::number(rested)));
+
+    // A play noted since the load counts in the next shuffle
+    engine.notePlayed(engine.next(1).first());
+}
+
+void TestRotationEngine::testNotedPlaysSurviveVacuum()
+{
+    addTracks(60, 60, "Pop");
+
+    RotationEngine engine(m_database);
+    RotationEngine::Options options;
+    options.seed = 5;
+    engine.setOptions(options);
+    engine.reload();
+    QVERIFY(engine.waitForReady(10000));
+
+    // Every other track airs, too recently for the database to know
+    QSet<QString> noted;
+    QSqlQuery query(m_database);
+    QVERIFY(query.exec("SELECT path FROM musics WHERE rowid % 2 = 0"));
+    while (query.next()) {
+        noted.insert(query.value(0).toString());
+        engine.notePlayed(query.value(0).toString());
+    }
+    QCOMPARE(noted.size(), 30);
+
+    // musics has no INTEGER PRIMARY KEY: the VACUUM renumbers its rows,
+    // shifting each by one after the first is deleted
+    QVERIFY(query.exec("SELECT path FROM musics WHERE rowid = 2"));
+    QVERIFY(query.next());
+    const QString second = query.value(0).toString();
+    QVERIFY(query.exec("DELETE FROM musics WHERE rowid = 1"));
+    QVERIFY(query.exec("VACUUM"));
+    QVERIFY(query.exec("SELECT path FROM musics WHERE rowid = 1"));
+    QVERIFY(query.next());
+    QCOMPARE(query.value(0).toString(), second);
+
+    engine.reload();
+    QVERIFY(engine.waitForReady(10000));
+    int rested = 0;
+    for (const QString& path : engine.next(25)) {
+        if (!noted.contains(path))
+            ++rested;
+    }
+    QVERIFY2(rested >= 22, qPrintable(QString::number(rested)));
+}
+
+void TestRotationEngine::testHourGenre()
+{
+    addTracks(40, 8, "Rock");
+    addTracks(20, 4, "Jazz");
+    QSqlQuery query(m_database);
+    QVERIFY(query.exec("INSERT INTO hourgenre VALUES ('3', '12', 'jazz')"));
+    QVERIFY(query.exec("INSERT INTO hourgenre VALUES ('3', '13', 'Polka')"));   // no tracks
+
+    RotationEngine engine(m_database);
+    engine.reload();
+    QVERIFY(engine.waitForReady(10000));
+    QCOMPARE(engine.statistics().genres, 2);
+
+    const QDateTime noon(kWednesday, QTime(12, 10));
+    QCOMPARE(engine.genreAt(noon), QString("Jazz"));
+    const QStringList paths = engine.next(10, noon);
+    QCOMPARE(paths.size(), 10);
+    for (const QString& path : paths)
+        QCOMPARE(genreOf(path), QString("Jazz"));
+
+    // An hour without a genre, or with an empty one, plays the library
+    QCOMPARE(engine.genreAt(noon.addSecs(3600)), QString());
+    QCOMPARE(engine.genreAt(noon.addDays(1)), QString());
+    QCOMPARE(engine.next(10, noon.addSecs(3600)).size(), 10);
+}
+
+void TestRotationEngine::testPlanFollowsTheClock()
+{
+    addTracks(100, 20, "Rock");
+    addTracks(50, 10, "Jazz");
+    QSqlQuery query(m_database);
+    QVERIFY(query.exec("INSERT INTO hourgenre VALUES ('3', '12', 'Jazz')"));
+
+    RotationEngine engine(m_database);
+    engine.reload();
+    QVERIFY(engine.waitForReady(10000));
+
+    // Three minute tracks from 11:30: ten before noon, ten in the jazz hour
+    const QDateTime from(kWednesday, QTime(11, 30));
+    const QStringList paths = engine.plan(from, 3600);
+    QCOMPARE(paths.size(), 20);
+    for (int i = 10; i < 20; ++i)
+        QCOMPARE(genreOf(paths[i]), QString("Jazz"));
+
+    QCOMPARE(engine.secondsOf(paths.first()), 180);
+    QCOMPARE(engine.secondsOf("/not/in/the/library.mp3"), engine.options().averageSeconds);
+}
+
+void TestRotationEngine::testRefillsInBackground()
+{
+    addTracks(100, 50, "Rock");
+
+    RotationEngine engine(m_database);
+    engine.reload();
+    QVERIFY(engine.waitForReady(10000));
+
+    // Below refillBelow: a fresh shuffle is appended off this thread
+    QCOMPARE(engine.next(50).size(), 50);
+    QCOMPARE(engine.queued(QString()), 50);
+    QTRY_COMPARE(engine.statistics().refills, 1);
+    QCOMPARE(engine.queued(QString()), 150);
+
+    // A reload starts over from fresh rotations
+    engine.reload();
+    QVERIFY(engine.waitForReady(10000));
+    QCOMPARE(engine.queued(QString()), 100);
+    QCOMPARE(engine.statistics().loads, 2);
+}
+
+void TestRotationEngine::testNextIsConstantTime()
+{
+    // 100k tracks in five genres
+    const QStringList genres = {"Rock", "Pop", "Jazz", "Blues", "Folk"};
+    QVERIFY(m_database.transaction());
+    for (int i = 0; i < 100000; ++i)
+        addTrack(QString("Artist %1").arg(i % 5000), QString("Song %1").arg(i / 5000), genres[i % 5]);
+    QVERIFY(m_database.commit());
+    QSqlQuery query(m_database);
+    QVERIFY(query.exec("INSERT INTO hourgenre VALUES ('3', '12', 'Folk')"));
+
+    RotationEngine engine(m_database);
+    engine.reload();
+    QVERIFY(engine.waitForReady(60000));
+    QCOMPARE(engine.statistics().tracks, 100000);
+    qDebug() << "Loaded and shuffled 100k tracks in" << engine.statistics().lastLoadMs << "ms";
+
+    const QDateTime noon(kWednesday, QTime(12, 0));
+    QElapsedTimer clock;
+    clock.start();
+    for (int i = 0; i < 10000; ++i) {
+        QCOMPARE(engine.next(1, i % 2 ? noon : noon.addSecs(3600)).size(), 1);
+    }
+    const qint64 elapsedMs = clock.elapsed();
+    qDebug() << "10000 picks in" << elapsedMs << "ms";
+    QVERIFY2(elapsedMs < 500, qPrintable(QString::number(elapsedMs)));
+    QCOMPARE(engine.statistics().relaxed, 0);
+}
+
+QTEST_MAIN(TestRotationEngine)
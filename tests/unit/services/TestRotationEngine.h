@@ -0,0 +1,45 @@
+#ifndef TESTROTATIONENGINE_H
+#define TESTROTATIONENGINE_H
+
+#include <QtTest/QtTest>
+#include <QTemporaryDir>
+#include <QSqlDatabase>
+#include <memory>
+
+/**
+ * @brief Unit tests for RotationEngine class
+ *
+ * Tests play history weighting, rotation coverage, artist and title
+ * separation, plays noted across a reload, the hourgenre clock, hour planning, background refills and
+ * the cost of picking from a 100k-track library.
+ */
+class TestRotationEngine : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void init();
+    void cleanup();
+
+    void testWeight();
+    void testRotationPlaysEveryTrackOnce();
+    void testArtistAndTitleSeparation();
+    void testWeightingFavoursRestedTracks();
+    void testNotedPlaysSurviveVacuum();
+    void testHourGenre();
+    void testPlanFollowsTheClock();
+    void testRefillsInBackground();
+    void testNextIsConstantTime();
+
+private:
+    void addTrack(const QString& artist, const QString& title, const QString& genre,
+                  const QString& time = "0:03:00", const QString& lastPlayed = "-");
+    void addTracks(int count, int artists, const QString& genre);
+
+    std::unique_ptr<QTemporaryDir> m_tempDir;
+    QSqlDatabase m_database;
+    QString m_connectionName;
+    int m_tracks = 0;
+};
+
+#endif // TESTROTATIONENGINE_H
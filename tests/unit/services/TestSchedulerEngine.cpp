@@ -0,0 +1,335 @@
+#include "TestSchedulerEngine.h"
+#include "../../../src/services/SchedulerEngine.h"
+#include "../../../src/repositories/LibraryMigrations.h"
+#include "../LibraryTestSchema.h"
+#include <QElapsedTimer>
+#include <QLocale>
+#include <QRandomGenerator>
+#include <QSqlQuery>
+#include <QSqlError>
+#include <QDebug>
+
+namespace {
+
+struct Fired {
+    SchedulerEngine::Event event;
+    qint64 clockMs = 0;       // the engine's clock when ruleDue() arrived
+};
+
+// A clock running offsetMs ahead of the real one
+SchedulerEngine::Clock shiftedClock(qint64 offsetMs)
+{
+    return [offsetMs]() { return QDateTime::currentMSecsSinceEpoch() + offsetMs; };
+}
+
+// A whole minute a few days ahead, so nothing else in the table is near it
+QDateTime targetMinute()
+{
+    QDateTime minute = QDateTime::currentDateTime().addDays(3);
+    minute.setTime(QTime(minute.time().hour(), minute.time().minute()));
+    return minute;
+}
+
+} // namespace
+
+void TestSchedulerEngine::init()
+{
+    m_tempDir = std::make_unique<QTemporaryDir>();
+    QVERIFY(m_tempDir->isValid());
+
+    m_connectionName = "test_scheduler_engine";
+    m_database = LibraryTestSchema::openDatabase(m_connectionName, m_tempDir->path() + "/adb.db");
+    QVERIFY(m_database.isOpen());
+
+    // musics for the library migrations; they add scheduler as shipped
+    QString error;
+    QVERIFY2(LibraryTestSchema::createMusicsTable(m_database, &error), qPrintable(error));
+    QVERIFY(LibraryMigrations::apply(m_database));
+}
+
+void TestSchedulerEngine::cleanup()
+{
+    LibraryTestSchema::closeDatabase(m_database, m_connectionName);
+    m_tempDir.reset();
+}
+
+void TestSchedulerEngine::addRule(int id, const QDateTime& at, bool once)
+{
+    // As add_pub and add_program write them
+    QSqlQuery query(m_database);
+    if (once) {
+        query.prepare("INSERT INTO scheduler (id, ano, mes, dia, hora, min, tipo, is_program) VALUES (?, ?, ?, ?, ?, ?, '1', '0')");
+        query.addBindValue(id);
+        query.addBindValue(QString::number(at.date().year()));
+        query.addBindValue(QString::number(at.date().month()));
+        query.addBindValue(QString::number(at.date().day()));
+        query.addBindValue(QString::number(at.time().hour()));
+        query.addBindValue(QString::number(at.time().minute()));
+    } else {
+        query.prepare("INSERT INTO scheduler (id, hora, min, tipo, week_day, is_program) VALUES (?, ?, ?, '2', ?, '0')");
+        query.addBindValue(id);
+        query.addBindValue(at.toString("HH"));
+        query.addBindValue(at.toString("mm"));
+        query.addBindValue(QLocale::c().dayName(at.date().dayOfWeek()));
+    }
+    QVERIFY2(query.exec(), qPrintable(query.lastError().text()));
+}
+
+void TestSchedulerEngine::addBulkRules(int count, const QDateTime& from)
+{
+    // 70% once rules from a day after `from` to most of a year on, 10%
+    // once rules two days or more before it, 20% weekly rules on the
+    // three weekdays after it: nothing is due within a day of `from`
+    QRandomGenerator random(42);
+    QVERIFY(m_database.transaction());
+    for (int i = 0; i < count; ++i) {
+        const int kind = i % 10;
+        const int id = 1000 + i % 5000;
+        if (kind < 7) {
+            addRule(id, from.addDays(1).addSecs(60 * random.bounded(300 * 24 * 60)), true);
+        } else if (kind == 7) {
+            addRule(id, from.addDays(-2).addSecs(-60 * random.bounded(300 * 24 * 60)), true);
+        } else {
+            const int dayOffset = 1 + random.bounded(3);
+            addRule(id, from.addDays(dayOffset).addSecs(60 * random.bounded(24 * 60)), false);
+        }
+    }
+    QVERIFY(m_database.commit());
+}
+
+QVariant TestSchedulerEngine::value(const QString& sql)
+{
+    QSqlQuery query(m_database);
+    if (!query.exec(sql) || !query.next())
+        return QVariant();
+    return query.value(0);
+}
+
+void TestSchedulerEngine::testNextFire()
+{
+    const QDateTime from(QDate(2026, 10, 14), QTime(12, 0));   // a Wednesday
+
+    SchedulerEngine::Rule once;
+    once.type = SchedulerEngine::Once;
+    once.at = from.addSecs(90);
+    QCOMPARE(SchedulerEngine::nextFire(once, from), once.at);
+    QVERIFY(!SchedulerEngine::nextFire(once, once.at.addMSecs(1)).isValid());
+
+    SchedulerEngine::Rule weekly;
+    weekly.type = SchedulerEngine::Weekly;
+    weekly.weekDay = 3;
+    weekly.time = QTime(12, 30);
+    QCOMPARE(SchedulerEngine::nextFire(weekly, from), QDateTime(QDate(2026, 10, 14), QTime(12, 30)));
+    weekly.time = QTime(11, 30);
+    QCOMPARE(SchedulerEngine::nextFire(weekly, from), QDateTime(QDate(2026, 10, 21), QTime(11, 30)));
+    weekly.weekDay = 1;
+    QCOMPARE(SchedulerEngine::nextFire(weekly, from), QDateTime(QDate(2026, 10, 19), QTime(11, 30)));
+    weekly.weekDay = 0;
+    QVERIFY(!SchedulerEngine::nextFire(weekly, from).isValid());
+}
+
+void TestSchedulerEngine::testWeekDayFromName()
+{
+    QCOMPARE(SchedulerEngine::weekDayFromName("Monday"), 1);
+    QCOMPARE(SchedulerEngine::weekDayFromName(" sunday "), 7);
+    QCOMPARE(SchedulerEngine::weekDayFromName("Someday"), 0);
+    QCOMPARE(SchedulerEngine::weekDayFromName(QString()), 0);
+}
+
+void TestSchedulerEngine::testLoadsHundredThousandRules()
+{
+    const QDateTime base = targetMinute();
+    addBulkRules(100000, base);
+    addRule(7, base.addSecs(-3600 * 12), true);   // the earliest still to come
+
+    SchedulerEngine engine(m_database);
+    engine.setClock(shiftedClock(base.addSecs(-3600 * 13).toMSecsSinceEpoch() - QDateTime::currentMSecsSinceEpoch()));
+    QVERIFY(engine.start());
+
+    const SchedulerEngine::Statistics stats = engine.statistics();
+    qDebug() << stats.rules << "rules loaded in" << stats.lastLoadMs << "ms," << stats.armed << "armed";
+    QCOMPARE(stats.rules, 100001);
+    QCOMPARE(stats.armed, 90001);   // the past once rules never fire
+    QVERIFY2(stats.lastLoadMs < 5000, qPrintable(QString("load took %1 ms").arg(stats.lastLoadMs)));
+    QCOMPARE(engine.nextFireTime(), base.addSecs(-3600 * 12));
+    QCOMPARE(engine.rulesFor(7, false), 1);
+    QCOMPARE(engine.rulesFor(7, true), 0);
+}
+
+void TestSchedulerEngine::testFiresOnTimeAmongHundredThousandRules()
+{
+    const QDateTime minute = targetMinute();
+    addBulkRules(100000, minute);
+    for (int id = 1; id <= 5; ++id)
+        addRule(id, minute, true);
+    addRule(6, minute, false);
+    addRule(8, minute.addSecs(60), true);   // the minute after: must wait
+
+    // The engine's clock reaches the target minute 3 s from now, loading
+    // the table included
+    const qint64 offset = minute.toMSecsSinceEpoch() - QDateTime::currentMSecsSinceEpoch() - 3000;
+    const SchedulerEngine::Clock clock = shiftedClock(offset);
+
+    SchedulerEngine engine(m_database);
+    engine.setClock(clock);
+    QList<Fired> fired;
+    connect(&engine, &SchedulerEngine::ruleDue, this, [&](const SchedulerEngine::Event& event) {
+        fired.append({event, clock()});
+    });
+    QVERIFY(engine.start());
+    QCOMPARE(engine.nextFireTime(), minute);
+
+    QTRY_COMPARE_WITH_TIMEOUT(fired.size(), 6, 8000);
+    QTest::qWait(200);
+    QCOMPARE(fired.size(), 6);
+
+    qint64 worst = 0;
+    for (const Fired& f : fired) {
+        QCOMPARE(f.event.scheduledAt, minute);
+        QVERIFY(f.clockMs >= minute.toMSecsSinceEpoch());
+        worst = qMax(worst, f.clockMs - minute.toMSecsSinceEpoch());
+    }
+    qDebug() << "6 rules fired among 100k, worst latency" << worst << "ms";
+    QVERIFY2(worst < 250, qPrintable(QString("fired %1 ms late").arg(worst)));
+
+    // Once rules are gone from the table, the weekly one is due next week
+    QCOMPARE(value("SELECT COUNT(*) FROM scheduler WHERE id BETWEEN 1 AND 5").toInt(), 0);
+    QCOMPARE(value("SELECT COUNT(*) FROM scheduler WHERE id = 6").toInt(), 1);
+    QCOMPARE(engine.rulesFor(3, false), 0);
+    QCOMPARE(engine.rulesFor(6, false), 1);
+    QCOMPARE(engine.nextFireTime(), minute.addSecs(60));
+    QCOMPARE(engine.statistics().fired, 6);
+}
+
+void TestSchedulerEngine::testPreRoll()
+{
+    const QDateTime minute = targetMinute();
+    addRule(1, minute, true);
+
+    const qint64 offset = minute.toMSecsSinceEpoch() - QDateTime::currentMSecsSinceEpoch() - 2000;
+    const SchedulerEngine::Clock clock = shiftedClock(offset);
+
+    SchedulerEngine engine(m_database);
+    engine.setClock(clock);
+    engine.setPreRoll(1000);
+    QList<Fired> fired;
+    connect(&engine, &SchedulerEngine::ruleDue, this, [&](const SchedulerEngine::Event& event) {
+        fired.append({event, clock()});
+    });
+    QVERIFY(engine.start());
+
+    QTRY_COMPARE_WITH_TIMEOUT(fired.size(), 1, 4000);
+    const qint64 early = minute.toMSecsSinceEpoch() - fired.first().clockMs;
+    qDebug() << "pre-roll of 1000 ms fired" << early << "ms early";
+    QVERIFY2(early > 750 && early <= 1000, qPrintable(QString("fired %1 ms early").arg(early)));
+    QCOMPARE(fired.first().event.scheduledAt, minute);
+}
+
+void TestSchedulerEngine::testGracePeriod()
+{
+    // Started halfway through a rule's minute: it still plays, as it did
+    // when the table was polled; five minutes late it does not
+    const QDateTime minute = targetMinute();
+    addRule(1, minute, true);
+    addRule(2, minute.addSecs(-5 * 60), true);
+
+    const qint64 offset = minute.toMSecsSinceEpoch() + 30000 - QDateTime::currentMSecsSinceEpoch();
+    SchedulerEngine engine(m_database);
+    engine.setClock(shiftedClock(offset));
+    QList<SchedulerEngine::Event> fired;
+    connect(&engine, &SchedulerEngine::ruleDue, this, [&](const SchedulerEngine::Event& event) {
+        fired.append(event);
+    });
+    QVERIFY(engine.start());
+
+    QTRY_COMPARE_WITH_TIMEOUT(fired.size(), 1, 2000);
+    QCOMPARE(fired.first().rule.id, 1);
+    QVERIFY(fired.first().latenessMs >= 30000);
+    QTest::qWait(100);
+    QCOMPARE(fired.size(), 1);
+    QCOMPARE(engine.rulesFor(2, false), 1);
+}
+
+void TestSchedulerEngine::testIncrementalChanges()
+{
+    const QDateTime base = targetMinute();
+    for (int id = 1; id <= 10; ++id)
+        addRule(id, base.addSecs(3600 * id), true);
+
+    SchedulerEngine engine(m_database);
+    QVERIFY(engine.start());
+    QCOMPARE(engine.nextFireTime(), base.addSecs(3600));
+
+    // A dialog adds an earlier rule
+    addRule(20, base, false);
+    QCOMPARE(engine.refresh(), 1);
+    QCOMPARE(engine.nextFireTime(), base);
+    QCOMPARE(engine.rulesFor(20, false), 1);
+
+    // ... moves it
+    QSqlQuery query(m_database);
+    QVERIFY(query.exec("UPDATE scheduler SET hora = hora + 2 WHERE id = 1"));
+    QVERIFY(query.exec("UPDATE scheduler SET week_day = 'Nonday' WHERE id = 20"));
+    QCOMPARE(engine.refresh(), 2);
+    QCOMPARE(engine.nextFireTime(), base.addSecs(2 * 3600));
+
+    // ... and deletes rules
+    QVERIFY(query.exec("DELETE FROM scheduler WHERE id IN (1, 2, 20)"));
+    QCOMPARE(engine.refresh(), 3);
+    QCOMPARE(engine.nextFireTime(), base.addSecs(3 * 3600));
+    QCOMPARE(engine.rulesFor(20, false), 0);
+    QCOMPARE(engine.refresh(), 0);
+
+    const SchedulerEngine::Statistics stats = engine.statistics();
+    QCOMPARE(stats.reloads, 1);
+    QCOMPARE(stats.changesApplied, 6);
+    QCOMPARE(stats.rules, 8);
+    QCOMPARE(value("SELECT COUNT(*) FROM scheduler_changes").toInt(), 0);
+
+    // Clearing the schedule is one reload, not a lookup per row
+    addBulkRules(2000, base);
+    QVERIFY(query.exec("DELETE FROM scheduler"));
+    engine.refresh();
+    QCOMPARE(engine.statistics().reloads, 2);
+    QCOMPARE(engine.statistics().rules, 0);
+    QVERIFY(!engine.nextFireTime().isValid());
+}
+
+void TestSchedulerEngine::testFollowsWritesOnTheConnection()
+{
+    const QDateTime base = targetMinute();
+    addRule(1, base.addSecs(3600), true);
+
+    SchedulerEngine engine(m_database);
+    QVERIFY(engine.start());
+    QCOMPARE(engine.nextFireTime(), base.addSecs(3600));
+
+    // A dialog writes on the same connection: picked up without refresh()
+    addRule(2, base, true);
+    QTRY_COMPARE_WITH_TIMEOUT(engine.nextFireTime(), base, 1000);
+    QCOMPARE(engine.statistics().changesApplied, 1);
+
+    // A bulk edit is read once
+    QVERIFY(m_database.transaction());
+    for (int id = 10; id < 20; ++id)
+        addRule(id, base.addSecs(60 * id), true);
+    QVERIFY(m_database.commit());
+    QTRY_COMPARE_WITH_TIMEOUT(engine.statistics().rules, 12, 1000);
+    QCOMPARE(engine.statistics().changesApplied, 11);
+
+    // A VACUUM keeps the keys the engine holds
+    QSqlQuery query(m_database);
+    QVERIFY(query.exec("DELETE FROM scheduler WHERE id = 1"));
+    QTRY_COMPARE_WITH_TIMEOUT(engine.statistics().rules, 11, 1000);
+    const qint64 key = value("SELECT rule_id FROM scheduler WHERE id = 2").toLongLong();
+    QVERIFY2(query.exec("VACUUM"), qPrintable(query.lastError().text()));
+    QCOMPARE(value("SELECT rule_id FROM scheduler WHERE id = 2").toLongLong(), key);
+
+    // Stopped, it no longer follows
+    engine.stop();
+    addRule(30, base.addSecs(-60), true);
+    QTest::qWait(300);
+    QCOMPARE(engine.statistics().rules, 11);
+}
+
+QTEST_MAIN(TestSchedulerEngine)
@@ -0,0 +1,44 @@
+#ifndef TESTSCHEDULERENGINE_H
+#define TESTSCHEDULERENGINE_H
+
+#include <QtTest/QtTest>
+#include <QTemporaryDir>
+#include <QSqlDatabase>
+#include <memory>
+
+/**
+ * @brief Unit tests for SchedulerEngine class
+ *
+ * Tests next fire times, loading and firing against a 100k-rule scheduler
+ * table (latency measured against the rule's own time), pre-roll, the
+ * grace period and incremental updates through the change log, read
+ * when the connection reports a write.
+ */
+class TestSchedulerEngine : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void init();
+    void cleanup();
+
+    void testNextFire();
+    void testWeekDayFromName();
+    void testLoadsHundredThousandRules();
+    void testFiresOnTimeAmongHundredThousandRules();
+    void testPreRoll();
+    void testGracePeriod();
+    void testIncrementalChanges();
+    void testFollowsWritesOnTheConnection();
+
+private:
+    void addRule(int id, const QDateTime& at, bool once);
+    void addBulkRules(int count, const QDateTime& from);
+    QVariant value(const QString& sql);
+
+    std::unique_ptr<QTemporaryDir> m_tempDir;
+    QSqlDatabase m_database;
+    QString m_connectionName;
+};
+
+#endif // TESTSCHEDULERENGINE_H
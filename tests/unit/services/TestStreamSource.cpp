@@ -0,0 +1,294 @@
+#include "TestStreamSource.h"
+#include "../../../src/services/StreamSource.h"
+#include <QElapsedTimer>
+#include <QScopeGuard>
+#include <QThread>
+#include <atomic>
+#include <vector>
+
+namespace {
+
+const QByteArray kHeader("HDR!");
+
+std::atomic<int> encodersOpened{0};
+// Cleared to hold the write() of encoders at stalledKbps
+std::atomic<bool> stalledReleased{true};
+constexpr int stalledKbps = 64;
+
+/**
+ * Pass-through "codec": a header, then the float PCM as it came in
+ */
+class FakeEncoder : public FxEncoder
+{
+public:
+    explicit FakeEncoder(bool stalls) : m_stalls(stalls) { m_out = kHeader; }
+
+    size_t write(const float* interleaved, size_t frames) override
+    {
+        while (m_stalls && !stalledReleased)
+            QThread::msleep(1);
+        m_out.append(reinterpret_cast<const char*>(interleaved),
+                     static_cast<qsizetype>(frames * 2 * sizeof(float)));
+        return frames;
+    }
+    qint64 takeEncoded(QByteArray& out) override
+    {
+        const qint64 n = m_out.size();
+        out += m_out;
+        m_out.clear();
+        return n;
+    }
+    void finish() override {}
+    qint64 queuedFrames() const override { return 0; }
+    bool failed() const override { return false; }
+    QString errorString() const override { return QString(); }
+
+private:
+    bool m_stalls;
+    QByteArray m_out;
+};
+
+std::unique_ptr<FxEncoder> openFake(const FxEncoder::Settings& settings, QString*)
+{
+    ++encodersOpened;
+    return std::make_unique<FakeEncoder>(settings.bitrateKbps == stalledKbps);
+}
+
+StreamSource::MountStats mountStats(const StreamSource& source)
+{
+    const StreamSource::Stats stats = source.stats();
+    return stats.mounts.isEmpty() ? StreamSource::MountStats() : stats.mounts.first();
+}
+
+} // namespace
+
+void TestStreamSource::init()
+{
+    encodersOpened = 0;
+    stalledReleased = true;
+    m_server = std::make_unique<QTcpServer>();
+    QVERIFY(m_server->listen(QHostAddress::LocalHost));
+}
+
+void TestStreamSource::cleanup()
+{
+    m_server.reset();
+}
+
+StreamMount TestStreamSource::mount(int protocol) const
+{
+    StreamMount m;
+    m.name = "test";
+    m.protocol = static_cast<StreamMount::Protocol>(protocol);
+    m.host = "127.0.0.1";
+    m.port = m_server->serverPort();
+    m.mount = "/live.mp3";
+    m.password = "hackme";
+    m.encoder.codec = FxEncoder::Codec::Mp3;
+    m.encoder.bitrateKbps = 128;
+    m.streamName = "XFB Radio";
+    m.genre = "Rock";
+    return m;
+}
+
+QTcpSocket* TestStreamSource::nextClient(int timeoutMs)
+{
+    if (!m_server->hasPendingConnections() && !m_server->waitForNewConnection(timeoutMs))
+        return nullptr;
+    return m_server->nextPendingConnection();
+}
+
+QByteArray TestStreamSource::readUntil(QTcpSocket* client, const QByteArray& marker, int timeoutMs)
+{
+    QByteArray data;
+    QElapsedTimer timer;
+    timer.start();
+    while (!data.contains(marker) && timer.elapsed() < timeoutMs) {
+        if (client->bytesAvailable() > 0 || client->waitForReadyRead(50))
+            data += client->readAll();
+    }
+    return data;
+}
+
+void TestStreamSource::testIcecastRequest()
+{
+    StreamSource source(&openFake);
+    source.start({mount(StreamMount::Icecast)});
+
+    QTcpSocket* client = nextClient();
+    QVERIFY(client);
+    const QByteArray request = readUntil(client, "\r\n\r\n");
+    const QList<QByteArray> lines = request.left(request.indexOf("\r\n\r\n")).split('\n');
+    QCOMPARE(lines.first().trimmed(), QByteArray("PUT /live.mp3 HTTP/1.1"));
+    QVERIFY(request.contains("Authorization: Basic " + QByteArray("source:hackme").toBase64() + "\r\n"));
+    QVERIFY(request.contains("Content-Type: audio/mpeg\r\n"));
+    QVERIFY(request.contains("Ice-Name: XFB Radio\r\n"));
+    QVERIFY(request.contains("Expect: 100-continue\r\n"));
+    // Nothing but the request before the server agrees
+    QCOMPARE(request.size(), request.indexOf("\r\n\r\n") + 4);
+
+    client->write("HTTP/1.1 100 Continue\r\n\r\n");
+    QTRY_COMPARE(mountStats(source).state, StreamSource::Streaming);
+
+    std::vector<float> block(2 * 4800, 0.5f);
+    source.tap()->push(block.data(), 4800, 0.5f);
+    const float quarter = 0.25f;
+    const QByteArray audio = readUntil(client, QByteArray(reinterpret_cast<const char*>(&quarter), sizeof(float)));
+    QVERIFY(audio.contains(QByteArray(reinterpret_cast<const char*>(&quarter), sizeof(float))));
+    QTRY_VERIFY(source.stats().bytesSent >= 4800 * 8);
+    QCOMPARE(source.stats().droppedFrames, quint64(0));
+
+    source.stop();
+    QTRY_COMPARE(mountStats(source).state, StreamSource::Stopped);
+}
+
+void TestStreamSource::testShoutcastHandshake()
+{
+    StreamSource source(&openFake);
+    source.start({mount(StreamMount::Shoutcast)});
+
+    QTcpSocket* client = nextClient();
+    QVERIFY(client);
+    QCOMPARE(readUntil(client, "\r\n"), QByteArray("hackme\r\n"));
+    QCOMPARE(mountStats(source).state, StreamSource::Connecting);
+
+    client->write("OK2\r\nicy-caps:11\r\n\r\n");
+    const QByteArray headers = readUntil(client, "\r\n\r\n");
+    QVERIFY(headers.contains("icy-name: XFB Radio\r\n"));
+    QVERIFY(headers.contains("icy-br: 128\r\n"));
+    QVERIFY(headers.contains("content-type: audio/mpeg\r\n"));
+
+    // Nothing is playing: the mount is kept alive with silence
+    const QByteArray audio = headers.mid(headers.indexOf("\r\n\r\n") + 4)
+                             + readUntil(client, QByteArray(64, '\0'));
+    QVERIFY(audio.contains(QByteArray(64, '\0')));
+}
+
+void TestStreamSource::testReconnectsAfterDrop()
+{
+    StreamSource source(&openFake);
+    source.start({mount(StreamMount::Icecast)});
+
+    QTcpSocket* first = nextClient();
+    QVERIFY(first);
+    readUntil(first, "\r\n\r\n");
+    first->write("HTTP/1.0 200 OK\r\n\r\n");
+    QTRY_COMPARE(mountStats(source).state, StreamSource::Streaming);
+
+    first->abort();
+    QTRY_COMPARE(mountStats(source).state, StreamSource::Retrying);
+    QVERIFY(!mountStats(source).lastError.isEmpty());
+
+    // Back after the first backoff step, joining the running MP3 encoder
+    QTcpSocket* second = nextClient(5000);
+    QVERIFY(second);
+    QVERIFY(readUntil(second, "\r\n\r\n").startsWith("PUT /live.mp3"));
+    second->write("HTTP/1.1 100 Continue\r\n\r\n");
+    QTRY_COMPARE(mountStats(source).state, StreamSource::Streaming);
+    QCOMPARE(mountStats(source).reconnects, 1);
+    QCOMPARE(encodersOpened.load(), 1);
+    QVERIFY(!readUntil(second, QByteArray(64, '\0')).isEmpty());
+}
+
+void TestStreamSource::testRefusedPasswordRetries()
+{
+    StreamSource source(&openFake);
+    QSignalSpy states(&source, &StreamSource::mountStateChanged);
+    source.start({mount(StreamMount::Icecast)});
+
+    QTcpSocket* client = nextClient();
+    QVERIFY(client);
+    readUntil(client, "\r\n\r\n");
+    client->write("HTTP/1.1 401 Unauthorized\r\n\r\n");
+
+    QTRY_COMPARE(mountStats(source).state, StreamSource::Retrying);
+    QVERIFY(mountStats(source).lastError.contains("/live.mp3"));
+    // The encoder runs from the start; retrying does not reopen it
+    QTRY_COMPARE(encodersOpened.load(), 1);
+    QTRY_VERIFY(!states.isEmpty()
+                && states.last().at(1).value<StreamSource::MountState>() == StreamSource::Retrying);
+}
+
+void TestStreamSource::testOggMountRestartsEncoder()
+{
+    StreamMount ogg = mount(StreamMount::Icecast);
+    ogg.mount = "/live.ogg";
+    ogg.encoder.codec = FxEncoder::Codec::Opus;
+    StreamSource source(&openFake);
+    source.start({ogg});
+
+    for (int session = 1; session <= 2; ++session) {
+        QTcpSocket* client = nextClient();
+        QVERIFY(client);
+        readUntil(client, "\r\n\r\n");
+        client->write("HTTP/1.1 100 Continue\r\n\r\n");
+        QTRY_COMPARE(mountStats(source).state, StreamSource::Streaming);
+
+        // Every session begins at a fresh chain with its headers
+        QVERIFY(readUntil(client, kHeader).startsWith(kHeader));
+        QCOMPARE(encodersOpened.load(), 1 + session);
+        client->abort();
+        QTRY_COMPARE(mountStats(source).state, StreamSource::Retrying);
+    }
+}
+
+void TestStreamSource::testMountsShareEncoder()
+{
+    StreamMount a = mount(StreamMount::Icecast);
+    StreamMount b = mount(StreamMount::Icecast);
+    a.name = "a";
+    b.name = "b";
+    b.mount = "/relay.mp3";
+    StreamSource source(&openFake);
+    source.start({a, b});
+
+    QList<QTcpSocket*> clients;
+    for (int i = 0; i < 2; ++i) {
+        QTcpSocket* client = nextClient();
+        QVERIFY(client);
+        readUntil(client, "\r\n\r\n");
+        client->write("HTTP/1.1 100 Continue\r\n\r\n");
+        clients << client;
+    }
+    QTRY_VERIFY(source.stats().mounts.size() == 2
+                && source.stats().mounts.at(0).state == StreamSource::Streaming
+                && source.stats().mounts.at(1).state == StreamSource::Streaming);
+
+    std::vector<float> block(2 * 4800, 0.5f);
+    source.tap()->push(block.data(), 4800, 0.5f);
+    const float quarter = 0.25f;
+    const QByteArray marker(reinterpret_cast<const char*>(&quarter), sizeof(float));
+    for (QTcpSocket* client : clients)
+        QVERIFY(readUntil(client, marker).contains(marker));
+
+    QCOMPARE(encodersOpened.load(), 1);
+    QCOMPARE(source.stats().encoders.size(), 1);
+}
+
+void TestStreamSource::testStalledEncoderDropsOnlyItsOwn()
+{
+    StreamMount fast = mount(StreamMount::Icecast);
+    StreamMount stalled = mount(StreamMount::Icecast);
+    stalled.name = "stalled";
+    stalled.mount = "/low.mp3";
+    stalled.encoder.bitrateKbps = stalledKbps;
+    stalledReleased = false;
+    StreamSource source(&openFake);
+    // Let the lane thread go before the source waits for it
+    const auto release = qScopeGuard([] { stalledReleased = true; });
+    source.start({fast, stalled});
+
+    // Three seconds of audio, more than an encoder's queue holds
+    std::vector<float> block(2 * 4800, 0.5f);
+    for (int i = 0; i < 30; ++i) {
+        source.tap()->push(block.data(), 4800, 1.0f);
+        QTest::qWait(10);
+    }
+    QTRY_VERIFY(source.stats().encoders.size() == 2 && source.stats().encoders.at(1).droppedFrames > 0);
+    const StreamSource::Stats stats = source.stats();
+    QCOMPARE(stats.encoders.at(0).settings.bitrateKbps, 128);
+    QCOMPARE(stats.encoders.at(0).droppedFrames, quint64(0));
+    QVERIFY(stats.encoders.at(1).lagMs >= 1000);
+}
+
+QTEST_MAIN(TestStreamSource)
@@ -0,0 +1,44 @@
+#ifndef TESTSTREAMSOURCE_H
+#define TESTSTREAMSOURCE_H
+
+#include <QtTest/QtTest>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <memory>
+
+struct StreamMount;
+
+/**
+ * @brief Unit tests for StreamSource class
+ *
+ * Runs the source client against a local server standing in for Icecast
+ * and Shoutcast: the PUT request and its headers, the Shoutcast password
+ * handshake, audio reaching the server, silence while nothing plays,
+ * reconnecting after a dropped connection and a refused password, mounts
+ * sharing one encoder and a stalled encoder losing only its own audio.
+ */
+class TestStreamSource : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void init();
+    void cleanup();
+
+    void testIcecastRequest();
+    void testShoutcastHandshake();
+    void testReconnectsAfterDrop();
+    void testRefusedPasswordRetries();
+    void testOggMountRestartsEncoder();
+    void testMountsShareEncoder();
+    void testStalledEncoderDropsOnlyItsOwn();
+
+private:
+    StreamMount mount(int protocol) const;
+    QTcpSocket* nextClient(int timeoutMs = 5000);
+    QByteArray readUntil(QTcpSocket* client, const QByteArray& marker, int timeoutMs = 5000);
+
+    std::unique_ptr<QTcpServer> m_server;
+};
+
+#endif // TESTSTREAMSOURCE_H
@@ -0,0 +1,303 @@
+#include "TestTrackTrimmer.h"
+#include "../../../src/services/TrackTrimmer.h"
+#include "../../../src/audio/WaveformScanner.h"
+#include "../../../src/repositories/LibraryMigrations.h"
+#include "../LibraryTestSchema.h"
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSqlError>
+#include <QSqlQuery>
+#include <QtEndian>
+#include <atomic>
+
+namespace {
+
+std::atomic<int> scans{0};
+std::atomic<int> cuts{0};
+
+int peaksFor(qint64 ms)
+{
+    return int(ms / WaveformData::MsPerPeak);
+}
+
+/**
+ * Builds the peaks a file describes as "<silent ms> <loud ms> <silent ms>"
+ */
+bool fakeScan(const QString& path, const std::atomic<bool>&, WaveformData* data, QString* error)
+{
+    ++scans;
+    QFile file(path);
+    const QList<QByteArray> parts = file.open(QIODevice::ReadOnly) ? file.readAll().split(' ') : QList<QByteArray>();
+    if (parts.size() != 3) {
+        *error = "not audio";
+        return false;
+    }
+    data->peaks.fill(0, peaksFor(parts[0].toLongLong()));
+    data->peaks.append(QVector<quint8>(peaksFor(parts[1].toLongLong()), 100));
+    data->peaks.append(QVector<quint8>(peaksFor(parts[2].toLongLong()), 0));
+    data->durationMs = qint64(data->peaks.size()) * WaveformData::MsPerPeak;
+    return true;
+}
+
+/**
+ * Writes what is left of the file, in fakeScan's terms; fails for files named "bad.*"
+ */
+bool fakeCut(const QString& source, const QString& output, const TrackTrimmer::Trim& trim,
+             const std::atomic<bool>&, QString* error)
+{
+    ++cuts;
+    if (QFileInfo(source).completeBaseName() == "bad") {
+        *error = "cannot cut";
+        return false;
+    }
+    QFile file(output);
+    if (!file.open(QIODevice::WriteOnly))
+        return false;
+    file.write("0 " + QByteArray::number(trim.endMs - trim.startMs) + " 0");
+    return true;
+}
+
+TrackTrimmer::Statistics runTrimmer(const QSqlDatabase& database, TrackTrimmer::Mode mode)
+{
+    TrackTrimmer trimmer(database, fakeScan, fakeCut);
+    TrackTrimmer::Options options;
+    options.mode = mode;
+    options.batchSize = 1;
+    if (!trimmer.start(options) || !trimmer.waitForFinished(10000))
+        return TrackTrimmer::Statistics();
+    return trimmer.statistics();
+}
+
+} // namespace
+
+void TestTrackTrimmer::initTestCase()
+{
+    qRegisterMetaType<TrackTrimmer::Statistics>("TrackTrimmer::Statistics");
+}
+
+void TestTrackTrimmer::init()
+{
+    scans = 0;
+    cuts = 0;
+    m_tempDir = std::make_unique<QTemporaryDir>();
+    QVERIFY(m_tempDir->isValid());
+
+    m_root = m_tempDir->path() + "/library";
+    QVERIFY(QDir().mkpath(m_root));
+
+    m_connectionName = "test_track_trimmer";
+    m_database = LibraryTestSchema::openDatabase(m_connectionName, m_tempDir->path() + "/adb.db");
+    QVERIFY(m_database.isOpen());
+
+    QString error;
+    QVERIFY2(LibraryTestSchema::createMusicsTable(m_database, &error), qPrintable(error));
+    QVERIFY(LibraryMigrations::apply(m_database));
+}
+
+void TestTrackTrimmer::cleanup()
+{
+    LibraryTestSchema::closeDatabase(m_database, m_connectionName);
+    m_tempDir.reset();
+}
+
+QString TestTrackTrimmer::addTrack(const QString& name, const QByteArray& recipe)
+{
+    const QString path = m_root + "/" + name;
+    writeFile(path, recipe);
+    QSqlQuery query(m_database);
+    query.prepare("INSERT INTO musics (artist, song, genre1, path, played_times) VALUES ('A', ?, 'Pop', ?, 0)");
+    query.addBindValue(name);
+    query.addBindValue(path);
+    if (!query.exec())
+        qWarning() << query.lastError().text();
+    return path;
+}
+
+void TestTrackTrimmer::writeFile(const QString& path, const QByteArray& content)
+{
+    QFile file(path);
+    QVERIFY(file.open(QIODevice::WriteOnly | QIODevice::Truncate));
+    QCOMPARE(file.write(content), qint64(content.size()));
+}
+
+QByteArray TestTrackTrimmer::readFile(const QString& path)
+{
+    QFile file(path);
+    return file.open(QIODevice::ReadOnly) ? file.readAll() : QByteArray();
+}
+
+void TestTrackTrimmer::testScannerReducesPcm()
+{
+    // 100 ms of silence, 100 ms at half scale, 30 ms of silence: the last
+    // 10 ms are no whole peak and never show
+    QByteArray pcm(2 * WaveformScanner::SampleRate * 230 / 1000, '\0');
+    const int loudFrom = WaveformScanner::SampleRate / 10;
+    for (int i = loudFrom; i < 2 * loudFrom; ++i)
+        qToLittleEndian<qint16>(i % 2 ? 16384 : -16384, pcm.data() + i * 2);
+
+    // Fed in odd pieces, as a pipe delivers it
+    WaveformScanner scanner;
+    for (int offset = 0; offset < pcm.size(); offset += 333)
+        scanner.consume(pcm.mid(offset, 333));
+    const WaveformData data = scanner.take();
+
+    QCOMPARE(data.peaks.size(), 11);
+    QCOMPARE(data.durationMs, qint64(220));
+    QCOMPARE(data.peaks.mid(0, 5), QVector<quint8>(5, 0));
+    QCOMPARE(data.peaks.mid(5, 5), QVector<quint8>(5, 128));
+    QCOMPARE(data.peaks[10], quint8(0));
+    QCOMPARE(data.levels.size(), WaveformData::LevelCount);
+    QCOMPARE(data.quietHeadMs(3), qint64(100));
+    QCOMPARE(data.quietTailMs(3), qint64(20));
+    QVERIFY(scanner.isEmpty());
+}
+
+void TestTrackTrimmer::testFindTrim()
+{
+    WaveformData data;
+    data.peaks.fill(0, peaksFor(1000));
+    data.peaks.append(QVector<quint8>(peaksFor(5000), 100));
+    data.peaks.append(QVector<quint8>(peaksFor(2000), 2));  // hiss below 1%
+    data.peaks[peaksFor(7000)] = 200;                        // a click in it
+    data.durationMs = 8000;
+
+    // Rounded outwards by the margin, the click ignored
+    TrackTrimmer::Trim trim = TrackTrimmer::findTrim(data);
+    QCOMPARE(trim.startMs, qint64(960));
+    QCOMPARE(trim.endMs, qint64(6040));
+    QCOMPARE(trim.durationMs, qint64(8000));
+    QCOMPARE(trim.tailMs(), qint64(1960));
+
+    // Loud from end to end
+    data.peaks.fill(100);
+    trim = TrackTrimmer::findTrim(data);
+    QCOMPARE(trim.headMs(), qint64(0));
+    QCOMPARE(trim.tailMs(), qint64(0));
+
+    // A quiet piece is left whole
+    data.peaks.fill(2);
+    trim = TrackTrimmer::findTrim(data);
+    QCOMPARE(trim.startMs, qint64(0));
+    QCOMPARE(trim.endMs, qint64(8000));
+}
+
+void TestTrackTrimmer::testStoresTrims()
+{
+    const QString song = addTrack("song.mp3", "1000 5000 2000");
+    const QString clean = addTrack("clean.ogg", "0 3000 0");
+    const QString broken = addTrack("broken.mp3", "garbage");
+    const QString missing = addTrack("missing.mp3", "0 1000 0");
+    QFile::remove(missing);
+
+    const TrackTrimmer::Statistics stats = runTrimmer(m_database, TrackTrimmer::Mode::Analyze);
+    QCOMPARE(stats.total, 4);
+    QCOMPARE(stats.analyzed, 2);
+    QCOMPARE(stats.failed, 2);
+    QCOMPARE(stats.rewritten, 0);
+    QCOMPARE(stats.silenceMs, qint64(1960 + 960));
+    QCOMPARE(scans.load(), 3);
+    QCOMPARE(cuts.load(), 0);
+
+    TrackTrimmer::Trim trim;
+    QVERIFY(TrackTrimmer::storedTrim(m_database, song, &trim));
+    QCOMPARE(trim.startMs, qint64(960));
+    QCOMPARE(trim.endMs, qint64(6040));
+    QVERIFY(TrackTrimmer::storedTrim(m_database, clean, &trim));
+    QCOMPARE(trim.headMs(), qint64(0));
+    QCOMPARE(trim.tailMs(), qint64(0));
+    QVERIFY(!TrackTrimmer::storedTrim(m_database, broken, &trim));
+
+    // As playback cues them: no tail leaves the end open
+    qint64 startMs = -1;
+    qint64 endMs = -1;
+    QVERIFY(TrackTrimmer::storedCut(m_database, song, &startMs, &endMs));
+    QCOMPARE(startMs, qint64(960));
+    QCOMPARE(endMs, qint64(6040));
+    QVERIFY(TrackTrimmer::storedCut(m_database, clean, &startMs, &endMs));
+    QCOMPARE(startMs, qint64(0));
+    QCOMPARE(endMs, qint64(0));
+    QVERIFY(!TrackTrimmer::storedCut(m_database, broken, &startMs, &endMs));
+
+    // The files are left alone
+    QCOMPARE(readFile(song), QByteArray("1000 5000 2000"));
+    QCOMPARE(QDir(m_root).entryList(QDir::Files | QDir::Hidden).size(), 3);
+}
+
+void TestTrackTrimmer::testRescansChangedFiles()
+{
+    const QString song = addTrack("song.mp3", "1000 5000 2000");
+    const QString other = addTrack("other.mp3", "500 5000 500");
+    QCOMPARE(runTrimmer(m_database, TrackTrimmer::Mode::Analyze).analyzed, 2);
+    QCOMPARE(scans.load(), 2);
+
+    // Nothing changed: nothing scanned
+    TrackTrimmer::Statistics stats = runTrimmer(m_database, TrackTrimmer::Mode::Analyze);
+    QCOMPARE(stats.total, 0);
+    QCOMPARE(stats.unchanged, 2);
+    QCOMPARE(scans.load(), 2);
+
+    // A file replaced outside XFB has its old trim ignored and is scanned again
+    writeFile(song, "3000 5000 0");
+    TrackTrimmer::Trim trim;
+    QVERIFY(!TrackTrimmer::storedTrim(m_database, song, &trim));
+    stats = runTrimmer(m_database, TrackTrimmer::Mode::Analyze);
+    QCOMPARE(stats.analyzed, 1);
+    QCOMPARE(stats.unchanged, 1);
+    QCOMPARE(scans.load(), 3);
+    QVERIFY(TrackTrimmer::storedTrim(m_database, song, &trim));
+    QCOMPARE(trim.startMs, qint64(2960));
+
+    // Trims of files that left the library go
+    QSqlQuery query(m_database);
+    query.prepare("DELETE FROM musics WHERE path = ?");
+    query.addBindValue(other);
+    QVERIFY(query.exec());
+    runTrimmer(m_database, TrackTrimmer::Mode::Analyze);
+    QVERIFY(!TrackTrimmer::storedTrim(m_database, other, &trim));
+    QVERIFY(query.exec("SELECT COUNT(*) FROM track_trims") && query.next());
+    QCOMPARE(query.value(0).toInt(), 1);
+}
+
+void TestTrackTrimmer::testRewriteCutsFiles()
+{
+    const QString song = addTrack("song.mp3", "1000 5000 2000");
+    const QString tight = addTrack("tight.mp3", "100 5000 100");
+    const QString bad = addTrack("bad.mp3", "1000 5000 2000");
+
+    TrackTrimmer::Statistics stats = runTrimmer(m_database, TrackTrimmer::Mode::Rewrite);
+    QCOMPARE(stats.total, 3);
+    QCOMPARE(stats.rewritten, 1);
+    QCOMPARE(stats.analyzed, 1);
+    QCOMPARE(stats.failed, 1);
+    QCOMPARE(cuts.load(), 2);
+
+    // Cut and swapped in, with a trim that matches the new file
+    QCOMPARE(readFile(song), QByteArray("0 5080 0"));
+    TrackTrimmer::Trim trim;
+    QVERIFY(TrackTrimmer::storedTrim(m_database, song, &trim));
+    QCOMPARE(trim.startMs, qint64(0));
+    QCOMPARE(trim.endMs, qint64(5080));
+    QCOMPARE(trim.tailMs(), qint64(0));
+
+    // Too little silence to be worth a rewrite
+    QCOMPARE(readFile(tight), QByteArray("100 5000 100"));
+    QVERIFY(TrackTrimmer::storedTrim(m_database, tight, &trim));
+    QCOMPARE(trim.startMs, qint64(60));
+
+    // A failed cut leaves the original, and still stores its trim
+    QCOMPARE(readFile(bad), QByteArray("1000 5000 2000"));
+    QVERIFY(TrackTrimmer::storedTrim(m_database, bad, &trim));
+    QCOMPARE(trim.startMs, qint64(960));
+    QCOMPARE(QDir(m_root).entryList(QDir::Files | QDir::Hidden).size(), 3);
+
+    // Again: only the failed cut is retried, from its stored trim
+    stats = runTrimmer(m_database, TrackTrimmer::Mode::Rewrite);
+    QCOMPARE(stats.total, 1);
+    QCOMPARE(stats.unchanged, 2);
+    QCOMPARE(stats.failed, 1);
+    QCOMPARE(scans.load(), 3);
+    QCOMPARE(cuts.load(), 3);
+}
+
+QTEST_MAIN(TestTrackTrimmer)
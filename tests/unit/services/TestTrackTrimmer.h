@@ -0,0 +1,44 @@
+#ifndef TESTTRACKTRIMMER_H
+#define TESTTRACKTRIMMER_H
+
+#include <QtTest/QtTest>
+#include <QTemporaryDir>
+#include <QSqlDatabase>
+#include <memory>
+
+/**
+ * @brief Unit tests for TrackTrimmer class
+ *
+ * Runs the trimmer with a fake scanner and cutter against a real directory
+ * and library database: trims are found on the shared waveform peaks and
+ * stored without touching the files, a repeated run only scans what
+ * changed, and a rewrite replaces the files it cuts while a failed cut
+ * leaves the original as it was.
+ */
+class TestTrackTrimmer : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void init();
+    void cleanup();
+
+    void testScannerReducesPcm();
+    void testFindTrim();
+    void testStoresTrims();
+    void testRescansChangedFiles();
+    void testRewriteCutsFiles();
+
+private:
+    QString addTrack(const QString& name, const QByteArray& recipe);
+    void writeFile(const QString& path, const QByteArray& content);
+    QByteArray readFile(const QString& path);
+
+    std::unique_ptr<QTemporaryDir> m_tempDir;
+    QString m_root;
+    QSqlDatabase m_database;
+    QString m_connectionName;
+};
+
+#endif // TESTTRACKTRIMMER_H
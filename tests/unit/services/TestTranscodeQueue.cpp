@@ -0,0 +1,256 @@
+#include "TestTranscodeQueue.h"
+#include "../../../src/services/TranscodeQueue.h"
+#include "../../../src/repositories/LibraryMigrations.h"
+#include "../LibraryTestSchema.h"
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSqlError>
+#include <QSqlQuery>
+#include <QThread>
+#include <atomic>
+
+namespace {
+
+std::atomic<int> transcodes{0};
+
+/**
+ * Writes "<extension>:<source file name>"; fails for sources named "bad.*"
+ */
+bool fakeTranscode(const QString& source, const QString& output, TranscodeQueue::Format format,
+                   const std::atomic<bool>&, QString* error)
+{
+    ++transcodes;
+    if (QFileInfo(source).completeBaseName() == "bad") {
+        *error = "unsupported input";
+        return false;
+    }
+    QFile file(output);
+    if (!file.open(QIODevice::WriteOnly))
+        return false;
+    file.write(TranscodeQueue::extension(format).toUtf8() + ':' + QFileInfo(source).fileName().toUtf8());
+    return true;
+}
+
+} // namespace
+
+void TestTranscodeQueue::initTestCase()
+{
+    qRegisterMetaType<TranscodeQueue::Statistics>("TranscodeQueue::Statistics");
+}
+
+void TestTranscodeQueue::init()
+{
+    transcodes = 0;
+    m_tempDir = std::make_unique<QTemporaryDir>();
+    QVERIFY(m_tempDir->isValid());
+
+    m_root = m_tempDir->path() + "/library";
+    QVERIFY(QDir().mkpath(m_root));
+
+    m_connectionName = "test_transcode_queue";
+    m_database = LibraryTestSchema::openDatabase(m_connectionName, m_tempDir->path() + "/adb.db");
+    QVERIFY(m_database.isOpen());
+
+    QString error;
+    QVERIFY2(LibraryTestSchema::createMusicsTable(m_database, &error), qPrintable(error));
+    QVERIFY(LibraryMigrations::apply(m_database));
+}
+
+void TestTranscodeQueue::cleanup()
+{
+    LibraryTestSchema::closeDatabase(m_database, m_connectionName);
+    m_tempDir.reset();
+}
+
+QString TestTranscodeQueue::addTrack(const QString& name)
+{
+    const QString path = m_root + "/" + name;
+    writeFile(path, "original " + name.toUtf8());
+    QSqlQuery query(m_database);
+    query.prepare("INSERT INTO musics (artist, song, genre1, path, played_times) VALUES ('A', ?, 'Pop', ?, 3)");
+    query.addBindValue(name);
+    query.addBindValue(path);
+    if (!query.exec())
+        qWarning() << query.lastError().text();
+    return path;
+}
+
+void TestTranscodeQueue::writeFile(const QString& path, const QByteArray& content)
+{
+    QFile file(path);
+    QVERIFY(file.open(QIODevice::WriteOnly | QIODevice::Truncate));
+    QCOMPARE(file.write(content), qint64(content.size()));
+}
+
+QByteArray TestTranscodeQueue::readFile(const QString& path)
+{
+    QFile file(path);
+    return file.open(QIODevice::ReadOnly) ? file.readAll() : QByteArray();
+}
+
+QStringList TestTranscodeQueue::libraryPaths()
+{
+    QStringList paths;
+    QSqlQuery query(m_database);
+    if (query.exec("SELECT path FROM musics ORDER BY path")) {
+        while (query.next())
+            paths << query.value(0).toString();
+    }
+    return paths;
+}
+
+QVariant TestTranscodeQueue::value(const QString& sql)
+{
+    QSqlQuery query(m_database);
+    if (!query.exec(sql) || !query.next())
+        return QVariant();
+    return query.value(0);
+}
+
+void TestTranscodeQueue::testConvertsLibrary()
+{
+    const QString wav = addTrack("one.wav");
+    const QString flac = addTrack("two.live.flac");
+    const QString mp3 = addTrack("three.mp3");
+
+    TranscodeQueue queue(m_database, fakeTranscode);
+    QSignalSpy finishedSpy(&queue, &TranscodeQueue::finished);
+    TranscodeQueue::Options options;
+    options.enqueueLibrary = true;
+    options.format = TranscodeQueue::Format::Mp3;
+    options.batchSize = 1;
+    QVERIFY(queue.start(options));
+    QVERIFY(queue.waitForFinished(10000));
+    QCOMPARE(finishedSpy.count(), 1);
+
+    const TranscodeQueue::Statistics stats = queue.statistics();
+    QCOMPARE(stats.total, 2);
+    QCOMPARE(stats.converted, 2);
+    QCOMPARE(stats.failed, 0);
+    QCOMPARE(stats.skipped, 1);
+    QCOMPARE(transcodes.load(), 2);
+
+    QCOMPARE(libraryPaths(), QStringList({m_root + "/one.mp3", mp3, m_root + "/two.live.mp3"}));
+    QVERIFY(!QFile::exists(wav));
+    QVERIFY(!QFile::exists(flac));
+    QCOMPARE(readFile(m_root + "/one.mp3"), QByteArray("mp3:one.wav"));
+    QCOMPARE(readFile(mp3), QByteArray("original three.mp3"));
+    QCOMPARE(value("SELECT SUM(played_times) FROM musics").toInt(), 9);
+
+    // Nothing left behind: no temporary files, no jobs
+    QCOMPARE(QDir(m_root).entryList(QDir::Files | QDir::Hidden).size(), 3);
+    QCOMPARE(value("SELECT COUNT(*) FROM transcode_jobs").toInt(), 0);
+    QCOMPARE(TranscodeQueue::unfinishedJobs(m_database), 0);
+}
+
+void TestTranscodeQueue::testFailuresKeepOriginals()
+{
+    const QString bad = addTrack("bad.wav");
+    const QString clash = addTrack("clash.wav");
+    writeFile(m_root + "/clash.ogg", "someone else's file");
+    const QString missing = addTrack("missing.wav");
+    QFile::remove(missing);
+
+    TranscodeQueue queue(m_database, fakeTranscode);
+    TranscodeQueue::Options options;
+    options.enqueueLibrary = true;
+    options.format = TranscodeQueue::Format::Ogg;
+    QVERIFY(queue.start(options));
+    QVERIFY(queue.waitForFinished(10000));
+
+    const TranscodeQueue::Statistics stats = queue.statistics();
+    QCOMPARE(stats.converted, 0);
+    QCOMPARE(stats.failed, 3);
+    QCOMPARE(transcodes.load(), 1);
+
+    QCOMPARE(libraryPaths(), QStringList({bad, clash, missing}));
+    QCOMPARE(readFile(bad), QByteArray("original bad.wav"));
+    QCOMPARE(readFile(m_root + "/clash.ogg"), QByteArray("someone else's file"));
+    QVERIFY(!QFile::exists(m_root + "/bad.ogg"));
+
+    QCOMPARE(value("SELECT COUNT(*) FROM transcode_jobs WHERE state = 2").toInt(), 3);
+    QCOMPARE(value("SELECT error FROM transcode_jobs WHERE source LIKE '%bad.wav'").toString(),
+             QString("unsupported input"));
+    QCOMPARE(TranscodeQueue::unfinishedJobs(m_database), 0);
+}
+
+void TestTranscodeQueue::testResumesInterruptedRun()
+{
+    const QString renamed = addTrack("renamed.wav");
+    const QString waiting = addTrack("waiting.wav");
+    const QString taken = addTrack("taken.wav");
+
+    // XFB stopped after renamed.mp3 was moved into place, before its batch
+    writeFile(m_root + "/renamed.mp3", "mp3:renamed.wav");
+    // ...and before taken.mp3 was, and then someone put a file there
+    writeFile(m_root + "/taken.mp3", "someone else's");
+    const QFileInfo output(m_root + "/renamed.mp3");
+
+    QSqlQuery query(m_database);
+    query.prepare("INSERT INTO transcode_jobs (source, target, format, state, output_size, output_mtime, updated) "
+                  "VALUES (?, ?, 'mp3', ?, ?, ?, 0)");
+    const auto addJob = [&](const QString& source, TranscodeQueue::JobState state) {
+        query.addBindValue(source);
+        query.addBindValue(QFileInfo(source).path() + "/" + QFileInfo(source).completeBaseName() + ".mp3");
+        query.addBindValue(int(state));
+        query.addBindValue(output.size());
+        query.addBindValue(output.lastModified().toMSecsSinceEpoch());
+        return query.exec();
+    };
+    QVERIFY2(addJob(renamed, TranscodeQueue::JobState::Renaming), qPrintable(query.lastError().text()));
+    QVERIFY2(addJob(waiting, TranscodeQueue::JobState::Pending), qPrintable(query.lastError().text()));
+    QVERIFY2(addJob(taken, TranscodeQueue::JobState::Renaming), qPrintable(query.lastError().text()));
+    QCOMPARE(TranscodeQueue::unfinishedJobs(m_database), 3);
+
+    TranscodeQueue queue(m_database, fakeTranscode);
+    QVERIFY(queue.start(TranscodeQueue::Options()));
+    QVERIFY(queue.waitForFinished(10000));
+
+    QCOMPARE(queue.statistics().converted, 2);
+    QCOMPARE(queue.statistics().failed, 1);
+    QCOMPARE(transcodes.load(), 2);
+    QCOMPARE(libraryPaths(), QStringList({m_root + "/renamed.mp3", taken, m_root + "/waiting.mp3"}));
+    QVERIFY(!QFile::exists(renamed));
+    QVERIFY(!QFile::exists(waiting));
+
+    // A file at the target that is not the recorded output is never
+    // taken for one: the original and the stranger both stay
+    QCOMPARE(readFile(taken), QByteArray("original taken.wav"));
+    QCOMPARE(readFile(m_root + "/taken.mp3"), QByteArray("someone else's"));
+    QCOMPARE(TranscodeQueue::unfinishedJobs(m_database), 0);
+}
+
+void TestTranscodeQueue::testCancelLeavesJobsQueued()
+{
+    const QStringList originals = {addTrack("a.wav"), addTrack("b.wav"), addTrack("c.wav")};
+
+    // Holds each conversion until it is cancelled
+    TranscodeQueue queue(m_database, [](const QString&, const QString&, TranscodeQueue::Format,
+                                        const std::atomic<bool>& cancelled, QString* error) {
+        ++transcodes;
+        while (!cancelled)
+            QThread::msleep(5);
+        *error = "cancelled";
+        return false;
+    });
+    TranscodeQueue::Options options;
+    options.enqueueLibrary = true;
+    options.workers = 1;
+    QVERIFY(queue.start(options));
+    QTRY_COMPARE(transcodes.load(), 1);
+    queue.cancel();
+    QVERIFY(queue.waitForFinished(10000));
+
+    const TranscodeQueue::Statistics stats = queue.statistics();
+    QVERIFY(stats.cancelled);
+    QCOMPARE(stats.failed, 0);
+    QCOMPARE(transcodes.load(), 1);
+    QCOMPARE(TranscodeQueue::unfinishedJobs(m_database), 3);
+    QCOMPARE(libraryPaths(), originals);
+    for (const QString& path : originals)
+        QVERIFY(QFile::exists(path));
+    QCOMPARE(QDir(m_root).entryList(QDir::Files | QDir::Hidden).size(), 3);
+}
+
+QTEST_MAIN(TestTranscodeQueue)
@@ -0,0 +1,44 @@
+#ifndef TESTTRANSCODEQUEUE_H
+#define TESTTRANSCODEQUEUE_H
+
+#include <QtTest/QtTest>
+#include <QTemporaryDir>
+#include <QSqlDatabase>
+#include <memory>
+
+/**
+ * @brief Unit tests for TranscodeQueue class
+ *
+ * Runs the queue with a fake transcoder against a real directory and
+ * library database: converted files replace their originals and rows,
+ * failures and name clashes leave everything as it was, an interrupted
+ * run is finished on the next start and a cancelled one stays queued.
+ */
+class TestTranscodeQueue : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void init();
+    void cleanup();
+
+    void testConvertsLibrary();
+    void testFailuresKeepOriginals();
+    void testResumesInterruptedRun();
+    void testCancelLeavesJobsQueued();
+
+private:
+    QString addTrack(const QString& name);
+    void writeFile(const QString& path, const QByteArray& content);
+    QByteArray readFile(const QString& path);
+    QStringList libraryPaths();
+    QVariant value(const QString& sql);
+
+    std::unique_ptr<QTemporaryDir> m_tempDir;
+    QString m_root;
+    QSqlDatabase m_database;
+    QString m_connectionName;
+};
+
+#endif // TESTTRANSCODEQUEUE_H